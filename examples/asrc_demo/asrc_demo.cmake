@@ -43,6 +43,7 @@ set(APP_COMMON_LINK_LIBRARIES
     rtos::freertos_usb
     rtos::drivers::custom_i2s_with_rate_calc
     lib_src
+    sln_voice::app::audio_format
 )
 
 #**********************
@@ -11,7 +11,6 @@
 #define appconfDEVICE_CONTROL_USB_PORT 3
 #define appconfDEVICE_CONTROL_I2C_PORT 4
 #define appconfSPI_AUDIO_PORT          5
-#define appconfUSB_RATE_NOTIFY_PORT    6
 #define appconfAUDIOPIPELINE_PORT      7
 #define appconfI2S_OUTPUT_SLAVE_PORT   8
 #define appconfI2S_RATE_NOTIFY_PORT    9
@@ -151,4 +150,22 @@
 
 #define NUM_I2S_CHANS (2)
 
+/* Number of threads, including the I2S receive task, that share the I2S -> USB ASRC processing. Channels are split as
+ * evenly as possible between them */
+#ifndef appconfI2S_TO_USB_ASRC_NUM_WORKERS
+#define appconfI2S_TO_USB_ASRC_NUM_WORKERS      (2)
+#endif
+
+/* Number of threads, including the USB audio out task, that share the USB -> I2S ASRC processing */
+#ifndef appconfUSB_TO_I2S_ASRC_NUM_WORKERS
+#define appconfUSB_TO_I2S_ASRC_NUM_WORKERS      (2)
+#endif
+
+/* When the nominal I2S rate equals the USB rate, replace the ASRC by a copy that absorbs the clock drift with occasional
+ * sample drops and inserts. The full ASRC is used again if the rate ratio drifts too far from 1.0. Off by default, as the
+ * slips lower the audio quality and the bypass SNR is only checked in the ASRC simulator, see test/asrc_sim/run.sh */
+#ifndef appconfASRC_BYPASS_ENABLED
+#define appconfASRC_BYPASS_ENABLED              (0)
+#endif
+
 #endif /* APP_CONF_H_ */
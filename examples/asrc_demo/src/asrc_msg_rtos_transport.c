@@ -0,0 +1,44 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include <stddef.h>
+#include <xcore/assert.h>
+
+#include "FreeRTOS.h"
+#include "rtos_intertile.h"
+#include "asrc_msg_rtos_transport.h"
+
+static void rtos_transport_tx(const asrc_msg_transport_t *transport, const void *msg, size_t len)
+{
+    rtos_intertile_tx(
+        (rtos_intertile_t *)transport->ctx,
+        (uint8_t)transport->port,
+        (void *)msg,
+        len);
+}
+
+static size_t rtos_transport_rx(const asrc_msg_transport_t *transport, void *msg, size_t max_len)
+{
+    size_t bytes_received = rtos_intertile_rx_len(
+        (rtos_intertile_t *)transport->ctx,
+        (uint8_t)transport->port,
+        portMAX_DELAY);
+
+    // The data has to be read out of the intertile channel whatever its length
+    xassert(bytes_received <= max_len);
+
+    rtos_intertile_rx_data(
+        (rtos_intertile_t *)transport->ctx,
+        msg,
+        bytes_received);
+
+    return bytes_received;
+}
+
+void asrc_msg_rtos_transport_init(asrc_msg_transport_t *transport, rtos_intertile_t *ctx, uint8_t port)
+{
+    transport->tx = rtos_transport_tx;
+    transport->rx = rtos_transport_rx;
+    transport->ctx = ctx;
+    transport->port = port;
+}
@@ -0,0 +1,15 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef ASRC_MSG_RTOS_TRANSPORT_H
+#define ASRC_MSG_RTOS_TRANSPORT_H
+
+#include "rtos_intertile.h"
+#include "asrc_intertile_msg.h"
+
+/// @brief Initialise a transport that sends and receives asrc_intertile_msg messages over an intertile context
+/// @param transport    Transport to initialise
+/// @param ctx          Intertile context
+/// @param port         Intertile port used in both directions
+void asrc_msg_rtos_transport_init(asrc_msg_transport_t *transport, rtos_intertile_t *ctx, uint8_t port);
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <xcore/hwtimer.h>
+#include "rtos_printf.h"
 
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
@@ -18,6 +19,8 @@
 #include "src.h"
 #include "asrc_utils.h"
 
+#define REF_CLOCK_TICKS_PER_SECOND 100000000
+
 //Helper function for converting sample to fs index value
 fs_code_t samp_rate_to_code(unsigned samp_rate){
     unsigned samp_code = 0xdead;
@@ -45,17 +48,307 @@ fs_code_t samp_rate_to_code(unsigned samp_rate){
 }
 
 
-void asrc_one_channel_task(void *args)
+// Carry the path that was playing before a switch on over this frame, into the channel's output buffer as scratch, and
+// keep the start of it, at the new output rate, to crossfade from. Must run before the channel's ASRC is reinitialised.
+static void asrc_pool_carry_on_old_path(asrc_pool_t *pool, unsigned ch, int32_t *input, int32_t *prev_input, int32_t *output)
+{
+    int32_t *old_input = input;
+    unsigned n_old = 0;
+
+    if(pool->old_fs_in != pool->fs_in)
+    {
+        // The input is now at the new rate. Carry on from a mirror image of the last input at the old rate instead
+        old_input = prev_input;
+        if(old_input != NULL)
+        {
+            asrc_xfade_reverse(old_input, pool->n_in_samples);
+        }
+    }
+
+    if(old_input != NULL)
+    {
+        if(pool->old_path == ASRC_POOL_PATH_BYPASS)
+        {
+            n_old = asrc_bypass_process(old_input, output, pool->n_in_samples, 0);
+        }
+        else
+        {
+            n_old = asrc_process((int *)old_input, (int *)output, pool->old_fs_ratio, pool->asrc_ctrl[ch]);
+        }
+        if(old_input != input)
+        {
+            asrc_xfade_reverse(old_input, pool->n_in_samples);
+        }
+    }
+
+    if(n_old > 0)
+    {
+        asrc_xfade_resample(pool->xfade_old[ch], ASRC_XFADE_LENGTH, output, n_old, pool->old_fs_out, pool->fs_out);
+    }
+    else
+    {
+        // Nothing to carry on from, so fade from the last output sample
+        for(unsigned i = 0; i < ASRC_XFADE_LENGTH; i++)
+        {
+            pool->xfade_old[ch][i] = pool->last_output[ch];
+        }
+    }
+}
+
+// Reinitialise a channel's ASRC after a rate switch, or after running the bypass path since the ASRC history is then
+// stale, and prime it so that it starts with a full history. The priming output is discarded.
+static void asrc_pool_reinit_channel(asrc_pool_t *pool, unsigned ch, int32_t *input, int32_t *prev_input, int32_t *output, uint64_t fs_ratio)
+{
+    (void) asrc_init(samp_rate_to_code(pool->fs_in), samp_rate_to_code(pool->fs_out), pool->asrc_ctrl[ch], ASRC_CHANNELS_PER_INSTANCE, pool->n_in_samples, ASRC_DITHER_SETTING);
+
+    if((prev_input != NULL) && (pool->last_fs_in == pool->fs_in))
+    {
+        (void) asrc_process((int *)prev_input, (int *)output, fs_ratio, pool->asrc_ctrl[ch]);
+    }
+    else
+    {
+        // No previous input at this rate. Prime with the mirror image of this frame's input, which is continuous with it
+        asrc_xfade_reverse(input, pool->n_in_samples);
+        (void) asrc_process((int *)input, (int *)output, fs_ratio, pool->asrc_ctrl[ch]);
+        asrc_xfade_reverse(input, pool->n_in_samples);
+    }
+}
+
+static unsigned asrc_pool_process_channel(asrc_pool_t *pool, unsigned ch, const asrc_process_frame_ctx_t *frame)
+{
+    int32_t *input = &frame->input_samples[ch * frame->input_stride];
+    int32_t *output = &frame->output_samples[ch * frame->output_stride];
+    int32_t *prev_input = (frame->prev_input_samples != NULL) ? &frame->prev_input_samples[ch * frame->input_stride] : NULL;
+    unsigned n_samps_out;
+
+    if(pool->old_path != ASRC_POOL_PATH_NONE)
+    {
+        asrc_pool_carry_on_old_path(pool, ch, input, prev_input, output);
+    }
+
+    if(pool->bypass.active)
+    {
+        n_samps_out = asrc_bypass_process(input, output, pool->n_in_samples, pool->bypass_slip);
+    }
+    else
+    {
+        if(pool->reinit_pending)
+        {
+            asrc_pool_reinit_channel(pool, ch, input, prev_input, output, frame->fs_ratio);
+        }
+        n_samps_out = asrc_process((int *)input, (int *)output, frame->fs_ratio, pool->asrc_ctrl[ch]);
+    }
+
+    if(n_samps_out > 0)
+    {
+        if(pool->xfade_pending)
+        {
+            asrc_xfade(output, n_samps_out, pool->xfade_old[ch], ASRC_XFADE_LENGTH);
+        }
+        pool->last_output[ch] = output[n_samps_out - 1];
+    }
+    return n_samps_out;
+}
+
+static unsigned asrc_process_channel_group(const asrc_channel_group_t *group, const asrc_process_frame_ctx_t *frame)
+{
+    unsigned n_samps_out = 0;
+
+    // Each group reinitialises, primes and carries on its own channels, in parallel
+    for(unsigned ch = group->first_ch; ch < group->first_ch + group->num_ch; ch++)
+    {
+        unsigned n_samps_out_ch = asrc_pool_process_channel(group->pool, ch, frame);
+        if((ch != group->first_ch) && (n_samps_out_ch != n_samps_out))
+        {
+            rtos_printf("Error: ASRC. ch%u and ch%u returned different number of samples: %u, %u\n", group->first_ch, ch, n_samps_out, n_samps_out_ch);
+            xassert(0);
+        }
+        n_samps_out = n_samps_out_ch;
+    }
+    return n_samps_out;
+}
+
+// Note the path that is playing, to carry it on over the next frame and crossfade from it
+static void asrc_pool_start_xfade(asrc_pool_t *pool, asrc_pool_path_t old_path)
+{
+    if((pool->last_fs_in == 0) || (pool->old_path != ASRC_POOL_PATH_NONE))
+    {
+        // Nothing has played yet, or the next frame already carries on an older path
+        return;
+    }
+    pool->old_path = old_path;
+    pool->old_fs_in = pool->fs_in;
+    pool->old_fs_out = pool->fs_out;
+    pool->old_fs_ratio = pool->last_fs_ratio;
+    pool->xfade_pending = true;
+}
+
+void asrc_pool_worker_task(void *args)
 {
-    asrc_init_t *asrc_init_ctx = args;
+    asrc_channel_group_t *group = args;
 
     for(;;)
     {
-        asrc_process_frame_ctx_t *asrc_ctx = NULL;
-        (void) rtos_osal_queue_receive(&asrc_init_ctx->asrc_queue, &asrc_ctx, RTOS_OSAL_WAIT_FOREVER);
+        const asrc_process_frame_ctx_t *frame = NULL;
+        (void) rtos_osal_queue_receive(&group->start_queue, &frame, RTOS_OSAL_WAIT_FOREVER);
 
-        unsigned n_samps_out = asrc_process((int *)asrc_ctx->input_samples, (int *)asrc_ctx->output_samples, asrc_ctx->fs_ratio, asrc_init_ctx->asrc_ctrl_ptr);
+        unsigned n_samps_out = asrc_process_channel_group(group, frame);
 
-        (void) rtos_osal_queue_send(&asrc_init_ctx->asrc_ret_queue, &n_samps_out, RTOS_OSAL_WAIT_FOREVER);
+        (void) rtos_osal_queue_send(&group->pool->done_queue, &n_samps_out, RTOS_OSAL_WAIT_FOREVER);
+    }
+}
+
+void asrc_pool_init(asrc_pool_t *pool, asrc_ctrl_t **asrc_ctrl, unsigned num_channels, unsigned num_workers, uint32_t n_in_samples, unsigned priority)
+{
+    xassert((num_channels > 0) && (num_channels <= ASRC_POOL_MAX_CHANNELS));
+    if(num_workers > num_channels)
+    {
+        num_workers = num_channels;
+    }
+    if(num_workers > ASRC_POOL_MAX_WORKERS)
+    {
+        num_workers = ASRC_POOL_MAX_WORKERS;
+    }
+    if(num_workers == 0)
+    {
+        num_workers = 1;
+    }
+
+    memset(pool, 0, sizeof(asrc_pool_t));
+    pool->n_in_samples = n_in_samples;
+    pool->num_channels = num_channels;
+    pool->num_workers = num_workers;
+    pool->asrc_ctrl = asrc_ctrl;
+
+    // Split the channels into groups of consecutive channels. The first (num_channels % num_workers) groups get one extra channel
+    unsigned first_ch = 0;
+    for(unsigned w = 0; w < num_workers; w++)
+    {
+        asrc_channel_group_t *group = &pool->group[w];
+        group->pool = pool;
+        group->first_ch = first_ch;
+        group->num_ch = (num_channels / num_workers) + ((w < (num_channels % num_workers)) ? 1 : 0);
+        first_ch += group->num_ch;
+    }
+
+    if(num_workers > 1)
+    {
+        (void) rtos_osal_queue_create(&pool->done_queue, "asrc_done_q", num_workers - 1, sizeof(unsigned));
+    }
+    for(unsigned w = 1; w < num_workers; w++)
+    {
+        asrc_channel_group_t *group = &pool->group[w];
+        (void) rtos_osal_queue_create(&group->start_queue, "asrc_start_q", 1, sizeof(asrc_process_frame_ctx_t*));
+        (void) rtos_osal_thread_create(
+            NULL,
+            (char *) "ASRC_worker",
+            (rtos_osal_entry_function_t) asrc_pool_worker_task,
+            (void *) group,
+            (size_t) RTOS_THREAD_STACK_SIZE(asrc_pool_worker_task),
+            (unsigned int) priority);
+    }
+}
+
+uint64_t asrc_pool_switch_rates(asrc_pool_t *pool, uint32_t fs_in, uint32_t fs_out)
+{
+    asrc_pool_start_xfade(pool, pool->bypass.active ? ASRC_POOL_PATH_BYPASS : ASRC_POOL_PATH_ASRC);
+    pool->fs_in = fs_in;
+    pool->fs_out = fs_out;
+    pool->reinit_pending = true;
+    init_asrc_bypass_state(&pool->bypass, pool->bypass.max_deviation);
+
+    rate_info_t in = {fs_in, 1};
+    rate_info_t out = {fs_out, 1};
+    return rate_ratio_fixed_output_q_format(in, out, 28+32);
+}
+
+void asrc_pool_enable_bypass(asrc_pool_t *pool, int64_t max_deviation)
+{
+    pool->bypass_enabled = true;
+    init_asrc_bypass_state(&pool->bypass, max_deviation);
+}
+
+unsigned asrc_pool_process(asrc_pool_t *pool, const asrc_process_frame_ctx_t *frame)
+{
+    uint32_t start = get_reference_time();
+
+    if(pool->bypass_enabled)
+    {
+        bool was_bypassed = pool->bypass.active;
+        bool bypass = asrc_bypass_update(&pool->bypass, pool->fs_in, pool->fs_out, frame->fs_ratio);
+        if(bypass != was_bypassed)
+        {
+            // The ASRC and the bypass path have different delays, so crossfade at the switch
+            asrc_pool_start_xfade(pool, was_bypassed ? ASRC_POOL_PATH_BYPASS : ASRC_POOL_PATH_ASRC);
+        }
+        if(bypass)
+        {
+            pool->bypass_slip = asrc_bypass_plan_block(&pool->bypass, frame->fs_ratio, pool->n_in_samples);
+        }
+        else
+        {
+            pool->reinit_pending |= was_bypassed;
+        }
+    }
+
+    bool switching = (pool->old_path != ASRC_POOL_PATH_NONE) || (pool->reinit_pending && !pool->bypass.active);
+    unsigned n_samps_out = 0;
+
+    if(pool->bypass.active && (pool->old_path == ASRC_POOL_PATH_NONE))
+    {
+        // The bypass path is a copy, so there's no point in fanning out
+        for(unsigned ch = 0; ch < pool->num_channels; ch++)
+        {
+            n_samps_out = asrc_pool_process_channel(pool, ch, frame);
+        }
+    }
+    else
+    {
+        // Fan out to the worker threads
+        for(unsigned w = 1; w < pool->num_workers; w++)
+        {
+            (void) rtos_osal_queue_send(&pool->group[w].start_queue, &frame, RTOS_OSAL_WAIT_FOREVER);
+        }
+
+        n_samps_out = asrc_process_channel_group(&pool->group[0], frame);
+
+        // Fan in. Wait for every worker thread to finish this frame
+        for(unsigned w = 1; w < pool->num_workers; w++)
+        {
+            unsigned n_samps_out_worker;
+            (void) rtos_osal_queue_receive(&pool->done_queue, &n_samps_out_worker, RTOS_OSAL_WAIT_FOREVER);
+            if(n_samps_out_worker != n_samps_out)
+            {
+                rtos_printf("Error: ASRC. Channel groups returned different number of samples: %u, %u\n", n_samps_out, n_samps_out_worker);
+                xassert(0);
+            }
+        }
+    }
+
+    if(!pool->bypass.active)
+    {
+        pool->reinit_pending = false;
+    }
+    pool->old_path = ASRC_POOL_PATH_NONE;
+    if(n_samps_out > 0)
+    {
+        pool->xfade_pending = false;
+    }
+    pool->last_fs_in = pool->fs_in;
+    pool->last_fs_ratio = frame->fs_ratio;
+
+    if(switching)
+    {
+        pool->switch_ticks = get_reference_time() - start;
+#if PROFILE_ASRC
+        // The switch must fit in a block period, or the input buffer has to absorb the overrun
+        uint32_t block_period = (uint32_t)(((uint64_t)pool->n_in_samples * REF_CLOCK_TICKS_PER_SECOND) / pool->fs_in);
+        rtos_printf("ASRC switch to fs_in %lu, fs_out %lu took %lu ticks. Block period %lu ticks\n", pool->fs_in, pool->fs_out, pool->switch_ticks, block_period);
+        if(pool->switch_ticks > block_period)
+        {
+            rtos_printf("Warning: ASRC switch took longer than a block period\n");
+        }
+#endif
     }
+    return n_samps_out;
 }
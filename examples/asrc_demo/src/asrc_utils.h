@@ -7,34 +7,137 @@
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "rtos_osal.h"
 #include "src.h"
+#include "asrc_bypass.h"
+#include "asrc_xfade.h"
+#include "rate_window.h"
 
+#ifndef USB_TO_I2S_ASRC_BLOCK_LENGTH
+#define USB_TO_I2S_ASRC_BLOCK_LENGTH (96)
+#endif
+#ifndef I2S_TO_USB_ASRC_BLOCK_LENGTH
+#define I2S_TO_USB_ASRC_BLOCK_LENGTH (244)  // Found out from simulation. Relatively jitter free average buffer levels seen with 244 samples block than 240 samples block size
+#endif
+#define ASRC_N_CHANNELS              (1)
+#define ASRC_CHANNELS_PER_INSTANCE   (1)
+#define ASRC_DITHER_SETTING          OFF
+
+#define ASRC_POOL_MAX_WORKERS        (8)    // Maximum number of threads, including the calling thread, that an ASRC pool can spread its channels across
+#define ASRC_POOL_MAX_CHANNELS       (16)   // Maximum number of channels in an ASRC pool
+
+/// @brief One block of ASRC input and output for all the channels in a pool. Each channel's samples are contiguous,
+/// with consecutive channels input_stride (output_stride) samples apart.
 typedef struct
 {
-    /* data */
-    int32_t *input_samples;
-    int32_t *output_samples;
-    uint64_t fs_ratio;
-    unsigned i2s_sampling_rate;
+    int32_t *input_samples;     /// Deinterleaved input block, n_in_samples per channel
+    int32_t *output_samples;    /// Deinterleaved output block
+    unsigned input_stride;      /// Distance in samples between the start of consecutive channels in input_samples
+    unsigned output_stride;     /// Distance in samples between the start of consecutive channels in output_samples
+    int32_t *prev_input_samples;    /// Optional input block before this one, laid out like input_samples and at the input rate of the last block the pool processed. Used on a switch to prime the new ASRC instances or to carry the old stream on. Left unchanged, though reversed in place while in use. NULL if not available
+    uint64_t fs_ratio;          /// Rate ratio to use for all channels for this block
 }asrc_process_frame_ctx_t;
 
+/// @brief Processing path of an ASRC pool's output stream
+typedef enum
+{
+    ASRC_POOL_PATH_NONE,    /// No stream
+    ASRC_POOL_PATH_ASRC,    /// The ASRC instances
+    ASRC_POOL_PATH_BYPASS,  /// The bypass path
+}asrc_pool_path_t;
 
-typedef struct {
-    uint32_t fs_in;
-    uint32_t fs_out;
-    uint32_t n_in_samples;
-    asrc_ctrl_t *asrc_ctrl_ptr;
-    rtos_osal_queue_t asrc_queue;
-    rtos_osal_queue_t asrc_ret_queue;
-}asrc_init_t;
+struct asrc_pool_struct;
 
-#define USB_TO_I2S_ASRC_BLOCK_LENGTH (96)
-#define I2S_TO_USB_ASRC_BLOCK_LENGTH (244)  // Found out from simulation. Relatively jitter free average buffer levels seen with 244 samples block than 240 samples block size
-#define ASRC_N_CHANNELS              (1)
-#define ASRC_CHANNELS_PER_INSTANCE   (1)
-#define ASRC_DITHER_SETTING          OFF
+/// @brief A group of consecutive channels processed by one thread of the pool
+typedef struct
+{
+    struct asrc_pool_struct *pool;  /// Pool this group belongs to
+    unsigned first_ch;              /// First channel in the group
+    unsigned num_ch;                /// Number of channels in the group
+    rtos_osal_queue_t start_queue;  /// Fan-out. Receives the frame to process. Unused for group 0, which runs in the calling thread
+}asrc_channel_group_t;
+
+/// @brief Pool of threads sharing the ASRC processing of a multichannel block
+typedef struct asrc_pool_struct
+{
+    uint32_t fs_in;                 /// Nominal input sampling rate. 0 if not yet known
+    uint32_t fs_out;                /// Nominal output sampling rate. 0 if not yet known
+    uint32_t n_in_samples;          /// ASRC input block length, per channel
+    unsigned num_channels;          /// Number of channels processed by the pool
+    unsigned num_workers;           /// Number of threads processing the channels, including the calling thread
+    asrc_ctrl_t **asrc_ctrl;        /// Per channel ASRC control structure
+    asrc_channel_group_t group[ASRC_POOL_MAX_WORKERS];  /// Channel group of each thread. group[0] is the calling thread
+    rtos_osal_queue_t done_queue;   /// Fan-in. Each worker thread posts its output sample count here when done with a frame
+    bool bypass_enabled;            /// Flag indicating whether the bypass path may be used when fs_in == fs_out
+    asrc_bypass_state_t bypass;     /// Bypass path state
+    int32_t bypass_slip;            /// Slip of the current frame on the bypass path
+    bool reinit_pending;            /// Flag indicating that every channel's ASRC must be reinitialised before processing the current frame
+    uint32_t last_fs_in;            /// Nominal input sampling rate of the last frame processed. 0 if none yet
+    uint64_t last_fs_ratio;         /// Rate ratio of the last frame processed
+    asrc_pool_path_t old_path;      /// Path that was playing before a switch, to carry on over the current frame for the crossfade. ASRC_POOL_PATH_NONE if none
+    uint32_t old_fs_in;             /// Nominal input sampling rate of old_path
+    uint32_t old_fs_out;            /// Nominal output sampling rate of old_path
+    uint64_t old_fs_ratio;          /// Rate ratio to carry old_path on with
+    bool xfade_pending;             /// Flag indicating that the next output block must be crossfaded from xfade_old
+    int32_t last_output[ASRC_POOL_MAX_CHANNELS];    /// Last output sample of each channel
+    int32_t xfade_old[ASRC_POOL_MAX_CHANNELS][ASRC_XFADE_LENGTH];   /// Start of the old stream of each channel over the current frame, at the new output rate
+    uint32_t switch_ticks;          /// Reference timer ticks taken by the last frame with a switch in it
+}asrc_pool_t;
 
 fs_code_t samp_rate_to_code(unsigned samp_rate);
-void asrc_one_channel_task(void *args);
+
+/// @brief Initialise an ASRC pool and create its worker threads. Channels are split into num_workers groups of
+/// consecutive channels, as evenly as possible. Group 0 is processed by the thread calling asrc_pool_process(), the
+/// others by num_workers-1 worker threads created here.
+///
+/// The ASRC control structures must already have their state, stack and coefficient pointers set, with each stack sized
+/// for n_in_samples. asrc_pool_switch_rates() must be called before the first asrc_pool_process() call.
+///
+/// @param pool         Pointer to the pool state
+/// @param asrc_ctrl    Array of num_channels pointers to per channel ASRC control structures
+/// @param num_channels Number of channels
+/// @param num_workers  Number of threads, including the calling thread. Limited to num_channels and ASRC_POOL_MAX_WORKERS
+/// @param n_in_samples ASRC input block length, per channel
+/// @param priority     Priority of the worker threads
+void asrc_pool_init(asrc_pool_t *pool, asrc_ctrl_t **asrc_ctrl, unsigned num_channels, unsigned num_workers, uint32_t n_in_samples, unsigned priority);
+
+/// @brief Switch the pool to a new pair of nominal sampling rates. The ASRC instances are reinitialised by the pool
+/// threads in parallel at the start of the next asrc_pool_process() call, which then processes its frame as normal, so
+/// no frame needs to be skipped.
+///
+/// Each new instance is primed before its first frame, so that it starts with a full history: the frame's
+/// prev_input_samples are run through it if they are at the new input rate, and otherwise the frame's own input,
+/// reversed. The output of the priming is discarded.
+///
+/// If the pool was already running, the old instances first carry on over the same frame, on its input if the input
+/// rate is unchanged or otherwise on its prev_input_samples reversed. The first ASRC_XFADE_LENGTH output samples of the
+/// new instances are crossfaded from the old ones (see asrc_xfade.h). Without prev_input_samples when needed, the
+/// crossfade is from the last output sample instead.
+///
+/// The frame with the switch in it costs up to three ASRC passes and an asrc_init() per channel. Its time is kept in
+/// switch_ticks. When built with PROFILE_ASRC set, it is also printed, with a warning if it is longer than one block period.
+/// Must not be called while a frame is being processed.
+/// @param pool     Pointer to the pool state
+/// @param fs_in    Nominal input sampling rate
+/// @param fs_out   Nominal output sampling rate
+/// @return uint64_t Nominal rate ratio, fs_in/fs_out in the Q60 rate ratio format
+uint64_t asrc_pool_switch_rates(asrc_pool_t *pool, uint32_t fs_in, uint32_t fs_out);
+
+/// @brief Allow the pool to replace the ASRC by the bypass path (see asrc_bypass.h) while the nominal input and output
+/// rates are equal and the rate ratio stays close to 1.0. Switches between the ASRC and the bypass path are crossfaded
+/// the same way as rate switches.
+/// @param pool             Pointer to the pool state
+/// @param max_deviation    Maximum deviation of the rate ratio from 1.0 for which bypass is used, in the Q60 rate ratio format
+void asrc_pool_enable_bypass(asrc_pool_t *pool, int64_t max_deviation);
+
+/// @brief Process one block of all the channels in the pool. Hands the frame to every worker thread, processes group
+/// 0 in the calling thread and returns once every worker has finished. While the bypass path is in use, all the channels
+/// are processed in the calling thread and the worker threads stay idle, except for the frame that switches to it.
+/// @param pool     Pointer to the pool state
+/// @param frame    Input, output and rate ratio for this block
+/// @return unsigned Number of output samples per channel. Asserts if the channels disagree.
+unsigned asrc_pool_process(asrc_pool_t *pool, const asrc_process_frame_ctx_t *frame);
+
+void asrc_pool_worker_task(void *args);
 
 #endif
@@ -25,8 +25,11 @@
 #include "platform/driver_instances.h"
 #include "src.h"
 #include "asrc_utils.h"
+#include "audio_format.h"
 #include "i2s_audio.h"
 #include "rate_server.h"
+#include "asrc_intertile_msg.h"
+#include "asrc_msg_rtos_transport.h"
 #include "tusb_config.h"
 
 static void recv_frame_from_i2s(int32_t *i2s_rx_data, size_t frame_count)
@@ -45,14 +48,12 @@ static void i2s_audio_recv_task(void *args)
 {
     (void)args;
 
-    // Create the 2nd channel ASRC task
-    asrc_process_frame_ctx_t asrc_ctx;
-
-    // 1 ASRC instance per channel, so 2 for 2 channels. Each ASRC instance processes one channel
+    // 1 ASRC instance per channel. Each ASRC instance processes one channel
     asrc_state_t     asrc_state[NUM_I2S_CHANS][ASRC_CHANNELS_PER_INSTANCE]; //ASRC state machine state
     int              asrc_stack[NUM_I2S_CHANS][ASRC_CHANNELS_PER_INSTANCE][ASRC_STACK_LENGTH_MULT * I2S_TO_USB_ASRC_BLOCK_LENGTH]; //Buffer between filter stages
     asrc_ctrl_t      asrc_ctrl[NUM_I2S_CHANS][ASRC_CHANNELS_PER_INSTANCE];  //Control structure
     asrc_adfir_coefs_t asrc_adfir_coefs[NUM_I2S_CHANS];
+    asrc_ctrl_t      *asrc_ctrl_ptrs[NUM_I2S_CHANS];
 
     for(int ch=0; ch<NUM_I2S_CHANS; ch++)
     {
@@ -63,41 +64,39 @@ static void i2s_audio_recv_task(void *args)
             asrc_ctrl[ch][ui].piStack                   = asrc_stack[ch][ui];
             asrc_ctrl[ch][ui].piADCoefs                 = asrc_adfir_coefs[ch].iASRCADFIRCoefs;
         }
+        asrc_ctrl_ptrs[ch] = &asrc_ctrl[ch][0];
     }
 
-    //Initialise ASRC
-
-    // Create init ctx for the ch1 asrc running in another thread
-    asrc_init_t asrc_init_ctx;
-    asrc_init_ctx.fs_in = 0; // I2S rate is detected at runtime
-    asrc_init_ctx.fs_out = appconfUSB_AUDIO_SAMPLE_RATE;
-    asrc_init_ctx.n_in_samples = I2S_TO_USB_ASRC_BLOCK_LENGTH;
-    asrc_init_ctx.asrc_ctrl_ptr = &asrc_ctrl[1][0];
-    (void) rtos_osal_queue_create(&asrc_init_ctx.asrc_queue, "asrc_q", 1, sizeof(asrc_process_frame_ctx_t*));
-    (void) rtos_osal_queue_create(&asrc_init_ctx.asrc_ret_queue, "asrc_ret_q", 1, sizeof(int));
-
-    rtos_osal_thread_t asrc_ch1_thread;
-    // Create 2nd channel ASRC task
-    (void) rtos_osal_thread_create(
-        (rtos_osal_thread_t *) &asrc_ch1_thread,
-        (char *) "ASRC_1ch",
-        (rtos_osal_entry_function_t) asrc_one_channel_task,
-        (void *) (&asrc_init_ctx),
-        (size_t) RTOS_THREAD_STACK_SIZE(asrc_one_channel_task),
-        (unsigned int) appconfAUDIO_PIPELINE_TASK_PRIORITY);
+    // Spread the channels across this thread and appconfI2S_TO_USB_ASRC_NUM_WORKERS-1 worker threads
+    asrc_pool_t asrc_pool;
+    asrc_pool_init(&asrc_pool, asrc_ctrl_ptrs, NUM_I2S_CHANS, appconfI2S_TO_USB_ASRC_NUM_WORKERS, I2S_TO_USB_ASRC_BLOCK_LENGTH, appconfAUDIO_PIPELINE_TASK_PRIORITY);
+#if appconfASRC_BYPASS_ENABLED
+    asrc_pool_enable_bypass(&asrc_pool, ASRC_BYPASS_DEFAULT_MAX_DEVIATION);
+#endif
 
     // Keep receiving and discarding from I2S till we get a valid sampling rate
     int32_t input_data[I2S_TO_USB_ASRC_BLOCK_LENGTH][NUM_I2S_CHANS];
-    int32_t input_data_deinterleaved[NUM_I2S_CHANS][I2S_TO_USB_ASRC_BLOCK_LENGTH];
+    // Double buffered so that, on a switch, the last block processed at the old rate can carry the old ASRC instances on
+    int32_t input_data_deinterleaved[2][NUM_I2S_CHANS][I2S_TO_USB_ASRC_BLOCK_LENGTH];
+    unsigned cur_block = 0;
+    bool prev_block_valid = false;
     uint32_t i2s_sampling_rate = 0;
     uint32_t new_i2s_sampling_rate = 0;
 
-    // Initialise CH0 ASRC context
-    fs_code_t in_fs_code;
-    fs_code_t out_fs_code;
-
     int32_t frame_samples[NUM_I2S_CHANS][I2S_TO_USB_ASRC_BLOCK_LENGTH*2];
-    int32_t frame_samples_interleaved[I2S_TO_USB_ASRC_BLOCK_LENGTH*2][NUM_I2S_CHANS];
+    // The ASRC output is interleaved straight into the message sent to the USB tile, after the header
+    struct
+    {
+        asrc_msg_header_t hdr;
+        int32_t frames[I2S_TO_USB_ASRC_BLOCK_LENGTH*2][NUM_I2S_CHANS];
+    }i2s_to_usb_msg;
+    asrc_msg_transport_t i2s_to_usb_transport;
+    asrc_msg_rtos_transport_init(&i2s_to_usb_transport, intertile_i2s_audio_ctx, appconfAUDIOPIPELINE_PORT);
+
+    asrc_process_frame_ctx_t asrc_ctx;
+    asrc_ctx.output_samples = &frame_samples[0][0];
+    asrc_ctx.input_stride = I2S_TO_USB_ASRC_BLOCK_LENGTH;
+    asrc_ctx.output_stride = I2S_TO_USB_ASRC_BLOCK_LENGTH*2;
 #if PROFILE_ASRC
     uint32_t max_time = 0;
 #endif
@@ -116,16 +115,11 @@ static void i2s_audio_recv_task(void *args)
             set_i2s_to_usb_rate_ratio(0); // Since this is updated only at rate monitor trigger interval, set it to 0 so
                                          //we don't end up using the wrong ratio till its updated in the rate monitor
             i2s_sampling_rate = new_i2s_sampling_rate;
-            asrc_init_ctx.fs_in = i2s_sampling_rate;
-            in_fs_code = samp_rate_to_code(asrc_init_ctx.fs_in);  //Sample rate code 0..5
-            out_fs_code = samp_rate_to_code(asrc_init_ctx.fs_out);
 
-            // Reinitialise both channel ASRCs
-            nominal_fs_ratio = asrc_init(in_fs_code, out_fs_code, &asrc_ctrl[0][0], ASRC_CHANNELS_PER_INSTANCE, asrc_init_ctx.n_in_samples, ASRC_DITHER_SETTING);
-            nominal_fs_ratio = asrc_init(in_fs_code, out_fs_code, &asrc_ctrl[1][0], ASRC_CHANNELS_PER_INSTANCE, asrc_init_ctx.n_in_samples, ASRC_DITHER_SETTING);
-
-            // We're too late to do the asrc_process(), skip this frame
-            continue;
+            // The pool reinitialises all channel ASRCs in parallel as part of processing this frame. The previous input block
+            // was at the old I2S rate, so the new instances are primed with this frame reversed, and the old instances
+            // carry on over the previous block reversed, to crossfade from.
+            nominal_fs_ratio = asrc_pool_switch_rates(&asrc_pool, i2s_sampling_rate, appconfUSB_AUDIO_SAMPLE_RATE);
         }
         uint64_t current_rate_ratio = nominal_fs_ratio;
         uint64_t rate_ratio = get_i2s_to_usb_rate_ratio();
@@ -134,46 +128,20 @@ static void i2s_audio_recv_task(void *args)
             current_rate_ratio = rate_ratio;
         }
 
-        for(int ch=0; ch<NUM_I2S_CHANS; ch++)
-        {
-            for(int sample=0; sample<I2S_TO_USB_ASRC_BLOCK_LENGTH; sample++)
-            {
-                input_data_deinterleaved[ch][sample] = input_data[sample][ch];
-            }
-        }
+        audio_format_deinterleave(&input_data_deinterleaved[cur_block][0][0], I2S_TO_USB_ASRC_BLOCK_LENGTH, &input_data[0][0], NUM_I2S_CHANS, I2S_TO_USB_ASRC_BLOCK_LENGTH);
 
-        // Send to the other channel ASRC task
-        asrc_ctx.input_samples = &input_data_deinterleaved[1][0];
-        asrc_ctx.output_samples = &frame_samples[1][0];
+        asrc_ctx.input_samples = &input_data_deinterleaved[cur_block][0][0];
+        asrc_ctx.prev_input_samples = prev_block_valid ? &input_data_deinterleaved[cur_block ^ 1][0][0] : NULL;
         asrc_ctx.fs_ratio = current_rate_ratio;
-        asrc_ctx.i2s_sampling_rate = i2s_sampling_rate;
-        asrc_process_frame_ctx_t *ptr = &asrc_ctx;
 
 #if PROFILE_ASRC
         uint32_t start = get_reference_time();
 #endif
-        (void) rtos_osal_queue_send(&asrc_init_ctx.asrc_queue, &ptr, RTOS_OSAL_WAIT_FOREVER);
-
-        // Call asrc on this block of samples. Reuse frame_samples now that its copied into aec_reference_audio_samples
-        unsigned n_samps_out = asrc_process((int *)&input_data_deinterleaved[0][0], (int *)&frame_samples[0][0], current_rate_ratio, &asrc_ctrl[0][0]);
+        unsigned n_samps_out = asrc_pool_process(&asrc_pool, &asrc_ctx);
+        cur_block ^= 1;
+        prev_block_valid = true;
 
-        // Wait for 2nd channel ASRC to finish
-        unsigned n_samps_out_ch1;
-        rtos_osal_queue_receive(&asrc_init_ctx.asrc_ret_queue, &n_samps_out_ch1, RTOS_OSAL_WAIT_FOREVER);
-
-        if(n_samps_out != n_samps_out_ch1)
-        {
-            rtos_printf("Error: I2S to USB ASRC. ch0 and ch1 returned different number of samples: ch0 %u, ch1 %u\n", n_samps_out, n_samps_out_ch1);
-            xassert(0);
-        }
-
-        for(int i=0; i<n_samps_out; i++)
-        {
-            for(int ch=0; ch<NUM_I2S_CHANS; ch++)
-            {
-                frame_samples_interleaved[i][ch] = frame_samples[ch][i];
-            }
-        }
+        audio_format_interleave(&i2s_to_usb_msg.frames[0][0], &frame_samples[0][0], asrc_ctx.output_stride, NUM_I2S_CHANS, n_samps_out);
 
 #if PROFILE_ASRC
         uint32_t end = get_reference_time();
@@ -186,69 +154,69 @@ static void i2s_audio_recv_task(void *args)
 #endif
 
         if (n_samps_out > 0) {
-            // Send nominal I2S sampling rate
-            rtos_intertile_tx(
-                intertile_i2s_audio_ctx,
-                appconfAUDIOPIPELINE_PORT,
-                &i2s_sampling_rate,
-                sizeof(uint32_t));
-
-            // Send ASRC output data
-            rtos_intertile_tx(
-                    intertile_i2s_audio_ctx,
-                    appconfAUDIOPIPELINE_PORT,
-                    frame_samples_interleaved,
-                    n_samps_out*NUM_I2S_CHANS*sizeof(int32_t));
+            // Send the ASRC output data, with the nominal I2S sampling rate and, if the rate server has worked out a new
+            // one since the last block, the usb_to_i2s rate ratio in the header
+            i2s_to_usb_rate_info_t i2s_rate_info;
+            asrc_msg_init_header(&i2s_to_usb_msg.hdr, i2s_sampling_rate);
+            if(rate_server_get_i2s_rate_info(&i2s_rate_info, i2s_sampling_rate))
+            {
+                asrc_msg_attach_i2s_rate_info(&i2s_to_usb_msg.hdr, &i2s_rate_info);
+            }
+            asrc_msg_send(&i2s_to_usb_transport, &i2s_to_usb_msg.hdr, NUM_I2S_CHANS, n_samps_out);
         }
     }
 }
 
-static unsigned usb_audio_recv(rtos_intertile_t *intertile_ctx,
+static unsigned usb_audio_recv(const asrc_msg_transport_t *transport,
                         int32_t **frame_buffers)
 {
-    static int32_t frame_samples_interleaved[(USB_TO_I2S_ASRC_BLOCK_LENGTH * 4) + 10][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX]; //+1 should be okay but +10 just in case
-
-    size_t bytes_received;
-
-    bytes_received = rtos_intertile_rx_len(
-        intertile_ctx,
-        appconfUSB_AUDIO_PORT,
-        portMAX_DELAY);
-
-    if (bytes_received > 0)
+    static struct
     {
-        xassert(bytes_received <= sizeof(frame_samples_interleaved));
+        asrc_msg_header_t hdr;
+        int32_t frames[(USB_TO_I2S_ASRC_BLOCK_LENGTH * 4) + 10][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX]; //+1 should be okay but +10 just in case
+    }usb_to_i2s_msg;
 
-        rtos_intertile_rx_data(
-            intertile_ctx,
-            frame_samples_interleaved,
-            bytes_received);
+    unsigned num_frames;
+    bool msg_ok = asrc_msg_recv(transport, &usb_to_i2s_msg.hdr, sizeof(usb_to_i2s_msg), CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, &num_frames);
+    xassert(msg_ok);
 
-        *frame_buffers = &frame_samples_interleaved[0][0];
-        return bytes_received >> 3; // Return number of 32bit samples per channel. 4bytes per samples and 2 channels
-    }
-    else
+    // Rate information for the rate server travels in the header. The message may carry no audio at all when the host
+    // isn't playing
+    if(usb_to_i2s_msg.hdr.flags & ASRC_MSG_HAS_USB_RATE_INFO)
     {
-        return 0;
+        rate_server_post_usb_rate_info(&usb_to_i2s_msg.hdr.usb_rate_info);
     }
+
+    *frame_buffers = &usb_to_i2s_msg.frames[0][0];
+    return num_frames; // Number of 32bit samples per channel
 }
 
 
+// Minimum I2S send buffer level, per channel, to resume sending at after an I2S sampling rate switch. Two ASRC output
+// blocks at the new rate.
+static inline int32_t i2s_send_buffer_min_start_level(uint32_t i2s_sampling_rate)
+{
+    return (2 * USB_TO_I2S_ASRC_BLOCK_LENGTH * i2s_sampling_rate) / appconfUSB_AUDIO_SAMPLE_RATE;
+}
+
 // USB audio recv -> ASRC -> |to other tile| -> usb_to_i2s_intertile -> I2S send
 static void usb_to_i2s_intertile(void *args) {
     (void) args;
     int32_t *usb_to_i2s_samps;
+    asrc_msg_transport_t usb_to_i2s_transport;
+    asrc_msg_rtos_transport_init(&usb_to_i2s_transport, intertile_usb_audio_ctx, appconfUSB_AUDIO_PORT);
 
     init_calc_i2s_buffer_level_state();
 
     for(;;)
     {
         // Receive USB recv + ASRC data frame from the other tile
-        unsigned num_samps = usb_audio_recv(intertile_usb_audio_ctx,
+        unsigned num_samps = usb_audio_recv(&usb_to_i2s_transport,
                                             &usb_to_i2s_samps
                                         );
 
         static uint32_t prev_i2s_sampling_rate = 0;
+        static bool rate_switch_pending = false;
 
         if(num_samps)
         {
@@ -271,19 +239,21 @@ static void usb_to_i2s_intertile(void *args) {
                 rtos_i2s_set_okay_to_send(i2s_ctx, false); // We wait for buffer to be half full before resuming send on I2S
             }
             uint32_t i2s_nominal_sampling_rate = rtos_i2s_get_nominal_sampling_rate(i2s_ctx);
-            // Similarly, If there's a change in I2S sampling rate, empty the buffer, then stop sending over I2S till buffer is half full and start sending again
+            // On the first valid I2S sampling rate, stop sending over I2S till the buffer is half full and start sending again.
+            // On a later change in I2S sampling rate, keep playing what's in the buffer so there's no gap, and append the
+            // new rate samples after it. The ASRC output is crossfaded across the switch.
             if((i2s_nominal_sampling_rate != 0) && (prev_i2s_sampling_rate != i2s_nominal_sampling_rate))
             {
-                if(i2s_send_buffer_unread > 0)
+                rtos_printf("I2S sampling rate change detected. prev = %u, current = %u. i2s_send_buffer_unread = %d\n", prev_i2s_sampling_rate, i2s_nominal_sampling_rate, i2s_send_buffer_unread);
+                if(prev_i2s_sampling_rate == 0)
                 {
-                    rtos_i2s_set_okay_to_send(i2s_ctx, true);
-                    rtos_printf("I2S sampling rate change detected. prev = %u, current = %u. i2s_send_buffer_unread = %d\n", prev_i2s_sampling_rate, i2s_nominal_sampling_rate, i2s_send_buffer_unread);
-                    // Wait for i2s send buffer to drain fully before refilling it, so there's no chance we start at a fill level greater than 0
-                    continue;
+                    rtos_i2s_set_okay_to_send(i2s_ctx, false);
+                }
+                else
+                {
+                    rate_switch_pending = true;
                 }
-                rtos_printf("I2S sampling rate change detected. prev = %u, current = %u. i2s_send_buffer_unread = %d\n", prev_i2s_sampling_rate, i2s_nominal_sampling_rate, i2s_send_buffer_unread);
                 prev_i2s_sampling_rate = i2s_nominal_sampling_rate;
-                rtos_i2s_set_okay_to_send(i2s_ctx, false);
             }
 
             rtos_i2s_tx(i2s_ctx,
@@ -294,6 +264,27 @@ static void usb_to_i2s_intertile(void *args) {
             bool okay_to_send = rtos_i2s_get_okay_to_send(i2s_ctx);
             int32_t i2s_buffer_level_from_half = rtos_i2s_get_send_buffer_level_wrt_half(i2s_ctx) / 2; // Per channel
 
+            if(rate_switch_pending)
+            {
+                // The buffer may have drained while the new rate was being detected. If there's enough in the buffer to absorb
+                // the jitter, keep sending. Otherwise stop till it refills to that level, which is much shorter than refilling
+                // to half. Either way, the buffer level controller carries on with its setpoint moved to the current level,
+                // instead of relearning a stable average from scratch.
+                int32_t i2s_buffer_level = rtos_i2s_get_send_buffer_unread(i2s_ctx) / 2; // Per channel
+                if(i2s_buffer_level >= i2s_send_buffer_min_start_level(i2s_nominal_sampling_rate))
+                {
+                    rtos_i2s_set_okay_to_send(i2s_ctx, true);
+                    retarget_i2s_send_buffer_level(i2s_buffer_level_from_half);
+                    rate_switch_pending = false;
+                    rtos_printf("Resume sending over I2S after rate switch. I2S send buffer fill level = %d\n", i2s_buffer_level_from_half);
+                }
+                else
+                {
+                    rtos_i2s_set_okay_to_send(i2s_ctx, false);
+                }
+                continue;
+            }
+
             calc_avg_i2s_send_buffer_level(i2s_buffer_level_from_half, !okay_to_send);
 
             // If we're not sending and buffer has become half full start sending again so we start at a very stable point
@@ -310,6 +301,9 @@ static void usb_to_i2s_intertile(void *args) {
 
 void i2s_audio_init()
 {
+    // Create the rate server mailboxes before any of the tasks that use them
+    rate_server_init();
+
     // I2S audio recv + ASRC task
     (void) rtos_osal_thread_create(
         NULL,
@@ -27,7 +27,7 @@
 #include "rate_server.h"
 #include "avg_buffer_level.h"
 #include "tusb.h"
-#include "div.h"
+#include "rate_window.h"
 
 #define LOG_I2S_TO_USB_SIDE (0)
 #define LOG_USB_TO_I2S_SIDE (0)
@@ -39,6 +39,17 @@ static bool g_spkr_itf_close_to_open = false; // Flag tracking if a USB spkr int
                                        // USB. Cleared in usb_to_i2s_intertile, after it resets the i2s send buffer
 
 static buffer_calc_state_t g_i2s_send_buf_state;
+static pi_control_state_t g_i2s_send_buf_pi_state;
+
+static QueueHandle_t usb_rate_info_mailbox; // Latest usb_rate_info received from the USB tile. Posted by usb_to_i2s_intertile, consumed by rate_server
+static QueueHandle_t i2s_rate_info_mailbox; // Latest result of rate_server. Consumed by i2s_audio_recv_task, which sends it to the USB tile
+
+// A result of rate_server, and the nominal I2S rate it was worked out at
+typedef struct
+{
+    i2s_to_usb_rate_info_t i2s_rate_info;
+    uint32_t i2s_nominal_sampling_rate;
+}rate_server_result_t;
 
 bool get_spkr_itf_close_open_event()
 {
@@ -62,6 +73,34 @@ void set_i2s_to_usb_rate_ratio(uint64_t ratio)
 
 }
 
+void rate_server_init(void)
+{
+    usb_rate_info_mailbox = xQueueCreate(1, sizeof(usb_rate_info_t));
+    i2s_rate_info_mailbox = xQueueCreate(1, sizeof(rate_server_result_t));
+}
+
+void rate_server_post_usb_rate_info(const usb_rate_info_t *usb_rate_info)
+{
+    (void)xQueueOverwrite(usb_rate_info_mailbox, usb_rate_info);
+}
+
+bool rate_server_get_i2s_rate_info(i2s_to_usb_rate_info_t *i2s_rate_info, uint32_t i2s_nominal_sampling_rate)
+{
+    rate_server_result_t result;
+    if(xQueueReceive(i2s_rate_info_mailbox, &result, 0) != pdTRUE)
+    {
+        return false;
+    }
+    // A ratio worked out before an I2S rate switch is for the old rate. Drop it and let the USB tile carry on from the
+    // nominal ratio until the next one
+    if(result.i2s_nominal_sampling_rate != i2s_nominal_sampling_rate)
+    {
+        return false;
+    }
+    *i2s_rate_info = result.i2s_rate_info;
+    return true;
+}
+
 // Wrapper functions to avoid having g_i2s_send_buf_state visible in i2s_audio.c
 void init_calc_i2s_buffer_level_state(void)
 {
@@ -76,15 +115,19 @@ void calc_avg_i2s_send_buffer_level(int32_t current_buffer_level, bool reset)
     calc_avg_buffer_level(&g_i2s_send_buf_state, current_buffer_level, reset);
 }
 
-static float_s32_t determine_avg_I2S_rate_from_driver()
+void retarget_i2s_send_buffer_level(int32_t stable_level)
+{
+    retarget_avg_buffer_level(&g_i2s_send_buf_state, stable_level);
+}
+
+static rate_info_t determine_avg_I2S_rate_from_driver()
 {
     #define TOTAL_STORED_AVG_I2S_RATE (16)
+    #define CALLS_PER_AVG_I2S_RATE_BUCKET (16)
     static uint32_t data_lengths[TOTAL_STORED_AVG_I2S_RATE];
     static uint32_t time_buckets[TOTAL_STORED_AVG_I2S_RATE];
+    static rate_window_state_t rate_window_state;
     static uint32_t current_data_bucket_size;
-    static bool buckets_full;
-    static uint32_t times_overflowed;
-    static float_s32_t previous_result = {.mant = 0, .exp = 0};
     static uint32_t prev_nominal_sampling_rate = 0;
     static uint32_t counter = 0;
     static uint32_t timespan_current_bucket = 0;
@@ -96,45 +139,23 @@ static float_s32_t determine_avg_I2S_rate_from_driver()
     uint32_t i2s_nominal_sampling_rate = rtos_i2s_get_nominal_sampling_rate(i2s_ctx);
     if(i2s_nominal_sampling_rate == 0)
     {
-        float_s32_t t = {.mant=0, .exp=0};
-        return t;
+        return (rate_info_t){0, 0};
     }
     else if(i2s_nominal_sampling_rate != prev_nominal_sampling_rate)
     {
         rtos_printf("determine_avg_I2S_rate_from_driver() I2S SR change detected, new_sr = %lu, prev_sr = %lu\n", i2s_nominal_sampling_rate, prev_nominal_sampling_rate);
         counter = 0;
         timespan_current_bucket = 0;
-
-        // Because we use "first_time" to also reset the rate determinator,
-        // reset all the static variables to default.
         current_data_bucket_size = 0;
-        times_overflowed = 0;
-        buckets_full = false;
 
-        for (int i = 0; i < TOTAL_STORED_AVG_I2S_RATE; i++)
-        {
-            data_lengths[i] = 0;
-            time_buckets[i] = 0;
-        }
+        init_rate_window_state(&rate_window_state, data_lengths, time_buckets, TOTAL_STORED_AVG_I2S_RATE);
         prev_nominal_sampling_rate = i2s_nominal_sampling_rate;
-        float_s32_t a = {.mant=i2s_nominal_sampling_rate, .exp=0};
-        float_s32_t b = {.mant=REF_CLOCK_TICKS_PER_SECOND, .exp=0};
 
-        float_s32_t rate = float_div(a, b);
-        previous_result = rate;
-
-        return previous_result;
+        return (rate_info_t){i2s_nominal_sampling_rate, REF_CLOCK_TICKS_PER_SECOND};
     }
     else if(timespan == 0)
     {
-        float_s32_t a = {.mant=prev_nominal_sampling_rate, .exp=0};
-        float_s32_t b = {.mant=REF_CLOCK_TICKS_PER_SECOND, .exp=0};
-
-        float_s32_t rate = float_div(a, b);
-        previous_result = rate;
-
-        return previous_result;
-
+        return (rate_info_t){prev_nominal_sampling_rate, REF_CLOCK_TICKS_PER_SECOND};
     }
 
     counter += 1;
@@ -142,96 +163,35 @@ static float_s32_t determine_avg_I2S_rate_from_driver()
     current_data_bucket_size += num_samples;
     timespan_current_bucket += timespan;
 
-    uint32_t total_data_intermed = current_data_bucket_size + sum_array(data_lengths, TOTAL_STORED_AVG_I2S_RATE);
-    uint32_t total_timespan = timespan_current_bucket + sum_array(time_buckets, TOTAL_STORED_AVG_I2S_RATE);
+    rate_info_t result = rate_window_get_rate(&rate_window_state, current_data_bucket_size, timespan_current_bucket);
 
-    float_s32_t data_per_sample = float_div((float_s32_t){total_data_intermed, 0}, (float_s32_t){total_timespan, 0});
-
-    //float_s32_t data_per_sample1 = float_div((float_s32_t){num_samples, 0}, (float_s32_t){timespan, 0});
-
-    float_s32_t result = data_per_sample;
-
-    if (counter >= 16)
+    if (counter >= CALLS_PER_AVG_I2S_RATE_BUCKET)
     {
-        if (buckets_full)
-        {
-            // We've got enough data for a new bucket - replace the oldest bucket data with this new data
-            uint32_t oldest_bucket = times_overflowed % TOTAL_STORED_AVG_I2S_RATE;
+        // We've got enough data for this bucket - replace the oldest bucket data with this one and start the next one
+        rate_window_push_bucket(&rate_window_state, current_data_bucket_size, timespan_current_bucket);
 
-            time_buckets[oldest_bucket] = timespan_current_bucket;
-            data_lengths[oldest_bucket] = current_data_bucket_size;
-
-            current_data_bucket_size = 0;
-            counter = 0;
-            timespan_current_bucket = 0;
-
-            times_overflowed++;
-        }
-        else
-        {
-            // We've got enough data for this bucket - save this one and start the next one
-            time_buckets[times_overflowed] = timespan_current_bucket;
-            data_lengths[times_overflowed] = current_data_bucket_size;
-
-            current_data_bucket_size = 0;
-            counter = 0;
-            timespan_current_bucket = 0;
-
-            times_overflowed++;
-            if (times_overflowed == TOTAL_STORED_AVG_I2S_RATE)
-            {
-                buckets_full = true;
-            }
-        }
+        current_data_bucket_size = 0;
+        counter = 0;
+        timespan_current_bucket = 0;
     }
-    previous_result = result;
     return result;
 }
 
-static inline sw_pll_q24_t get_Kp_for_i2s_buffer_control(int32_t nominal_i2s_rate)
-{
-    // The Kp constants are generated using the simulation framework empirically, to get values using which
-    // the calculated correction factor stablises the buffer level.
-    sw_pll_q24_t Kp = 0;
-    if(((int)nominal_i2s_rate == (int)44100) || ((int)nominal_i2s_rate == (int)48000))
-    {
-        Kp = KP_I2S_BUF_CONTROL_FS48;
-    }
-    else if(((int)nominal_i2s_rate == (int)88200) || ((int)nominal_i2s_rate == (int)96000))
-    {
-        Kp = KP_I2S_BUF_CONTROL_FS96;
-    }
-    else if(((int)nominal_i2s_rate == (int)176400) || ((int)nominal_i2s_rate == (int)192000))
-    {
-        Kp = KP_I2S_BUF_CONTROL_FS192;
-    }
-    return Kp;
-}
-
 void rate_server(void *args)
 {
     static bool prev_spkr_itf_open = false;
+    uint32_t prev_i2s_nominal_sampling_rate = 0;
     uint64_t usb_to_i2s_rate_ratio = 0;
     usb_rate_info_t usb_rate_info;
-    i2s_to_usb_rate_info_t i2s_rate_info;
+    rate_server_result_t result;
 
     for(;;)
     {
-        // Get usb_rate_info from the other tile
-        size_t bytes_received;
-        float_s32_t usb_rate;
-        bytes_received = rtos_intertile_rx_len(
-                    intertile_ctx,
-                    appconfUSB_RATE_NOTIFY_PORT,
-                    portMAX_DELAY);
-        xassert(bytes_received == sizeof(usb_rate_info));
-
-        rtos_intertile_rx_data(
-                        intertile_ctx,
-                        &usb_rate_info,
-                        bytes_received);
-
-        usb_rate = usb_rate_info.usb_data_rate;
+        // Wait for the next usb_rate_info from the other tile. It arrives in the header of the USB -> I2S audio messages
+        rate_info_t usb_rate;
+        (void)xQueueReceive(usb_rate_info_mailbox, &usb_rate_info, portMAX_DELAY);
+
+        usb_rate = usb_rate_info.usb_rate;
 
         if((prev_spkr_itf_open == false) && (usb_rate_info.spkr_itf_open == true))
         {
@@ -240,12 +200,13 @@ void rate_server(void *args)
         prev_spkr_itf_open = usb_rate_info.spkr_itf_open;
 
         // Compute I2S rate
-        float_s32_t i2s_rate = determine_avg_I2S_rate_from_driver();
+        result.i2s_nominal_sampling_rate = rtos_i2s_get_nominal_sampling_rate(i2s_ctx);
+        rate_info_t i2s_rate = determine_avg_I2S_rate_from_driver();
 
         // Calculate g_i2s_to_usb_rate_ratio only when the host is recording data from the device
-        if((i2s_rate.mant != 0) && (usb_rate.mant != 0) && (usb_rate_info.mic_itf_open))
+        if((i2s_rate.ticks != 0) && (usb_rate.ticks != 0) && (usb_rate_info.mic_itf_open))
         {
-            uint64_t fs_ratio_u64 = float_div_u64_fixed_output_q_format(i2s_rate, usb_rate, 28+32);
+            uint64_t fs_ratio_u64 = rate_ratio_fixed_output_q_format(i2s_rate, usb_rate, 28+32);
             fs_ratio_u64 = fs_ratio_u64 + usb_rate_info.buffer_based_correction;
 
 #if LOG_I2S_TO_USB_SIDE
@@ -264,32 +225,29 @@ void rate_server(void *args)
         }
 
         // Calculate usb_to_i2s_rate_ratio only when the host is playing data to the device
-        if((i2s_rate.mant != 0) && (usb_rate.mant != 0) && (usb_rate_info.spkr_itf_open))
+        if((i2s_rate.ticks != 0) && (usb_rate.ticks != 0) && (usb_rate_info.spkr_itf_open))
         {
-            const sw_pll_q24_t Kp = get_Kp_for_i2s_buffer_control(rtos_i2s_get_nominal_sampling_rate(i2s_ctx));
-            int64_t max_allowed_correction = (int64_t)1500 << 32;
-            int64_t total_error = 0;
+            uint32_t i2s_nominal_sampling_rate = rtos_i2s_get_nominal_sampling_rate(i2s_ctx);
+            if(i2s_nominal_sampling_rate != prev_i2s_nominal_sampling_rate)
+            {
+                // Pick up the gains for the new rate. The controller keeps running across a rate switch, with its integral
+                // term rescaled to the new rate
+                retarget_i2s_buffer_pi_control_state(&g_i2s_send_buf_pi_state, prev_i2s_nominal_sampling_rate, i2s_nominal_sampling_rate);
+                prev_i2s_nominal_sampling_rate = i2s_nominal_sampling_rate;
+            }
 
-            uint64_t fs_ratio64 = float_div_u64_fixed_output_q_format(usb_rate, i2s_rate, 28+32);
+            uint64_t fs_ratio64 = rate_ratio_fixed_output_q_format(usb_rate, i2s_rate, 28+32);
 
+            int64_t total_error = pi_control(&g_i2s_send_buf_pi_state, g_i2s_send_buf_state.flag_stable_avg,
+                                             g_i2s_send_buf_state.avg_buffer_level - g_i2s_send_buf_state.stable_avg_level);
+#if LOG_USB_TO_I2S_SIDE
             if(g_i2s_send_buf_state.flag_stable_avg)
             {
-                int64_t error_p = ((int64_t)Kp * (int64_t)(g_i2s_send_buf_state.avg_buffer_level - g_i2s_send_buf_state.stable_avg_level));
-                total_error = (int64_t)(error_p << 8);
-                if(total_error > max_allowed_correction)
-                {
-                    total_error = max_allowed_correction;
-                }
-                else if(total_error < -(max_allowed_correction))
-                {
-                    total_error = -(max_allowed_correction);
-                }
-#if LOG_USB_TO_I2S_SIDE
-            printint(g_i2s_send_buf_state.avg_buffer_level);
-            printchar(',');
-            printintln((int32_t)(total_error >> 32)); // Print the upper 32 bits of the correction
-#endif
+                printint(g_i2s_send_buf_state.avg_buffer_level);
+                printchar(',');
+                printintln((int32_t)(total_error >> 32)); // Print the upper 32 bits of the correction
             }
+#endif
             usb_to_i2s_rate_ratio = fs_ratio64 + total_error;
 
         }
@@ -298,24 +256,8 @@ void rate_server(void *args)
             usb_to_i2s_rate_ratio = (uint64_t)0;
         }
 
-        // Notify USB tile of the usb_to_i2s rate ratio
-        i2s_rate_info.usb_to_i2s_rate_ratio = usb_to_i2s_rate_ratio;
-
-        rtos_intertile_tx(
-            intertile_ctx,
-            appconfUSB_RATE_NOTIFY_PORT,
-            &i2s_rate_info,
-            sizeof(i2s_rate_info));
-    }
-}
-
-
-uint32_t sum_array(uint32_t * array_to_sum, uint32_t array_length)
-{
-    uint32_t acc = 0;
-    for (uint32_t i = 0; i < array_length; i++)
-    {
-        acc += array_to_sum[i];
+        // Hand the usb_to_i2s rate ratio to i2s_audio_recv_task, which sends it to the USB tile with the next I2S -> USB audio block
+        result.i2s_rate_info.usb_to_i2s_rate_ratio = usb_to_i2s_rate_ratio;
+        (void)xQueueOverwrite(i2s_rate_info_mailbox, &result);
     }
-    return acc;
 }
@@ -0,0 +1,94 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "asrc_bypass.h"
+
+void init_asrc_bypass_state(asrc_bypass_state_t *state, int64_t max_deviation)
+{
+    memset(state, 0, sizeof(asrc_bypass_state_t));
+    state->max_deviation = max_deviation;
+}
+
+bool asrc_bypass_update(asrc_bypass_state_t *state, uint32_t fs_in, uint32_t fs_out, uint64_t fs_ratio)
+{
+    int64_t deviation = (int64_t)fs_ratio - ASRC_BYPASS_RATIO_ONE;
+    if(deviation < 0)
+    {
+        deviation = -deviation;
+    }
+
+    if((fs_in == 0) || (fs_in != fs_out))
+    {
+        state->active = false;
+    }
+    else if(state->active)
+    {
+        if(deviation > 2 * state->max_deviation)
+        {
+            state->active = false;
+        }
+    }
+    else if(deviation <= state->max_deviation)
+    {
+        state->active = true;
+        state->slip_acc = 0;
+    }
+    return state->active;
+}
+
+int32_t asrc_bypass_plan_block(asrc_bypass_state_t *state, uint64_t fs_ratio, uint32_t n_in_samples)
+{
+    // Each output sample ideally consumes fs_ratio input samples. Copying the block consumes n_in_samples while producing
+    // n_in_samples outputs, so the ideal consumption runs ahead by n_in_samples * (fs_ratio - 1). The deviation is
+    // limited by max_deviation, so the product can't overflow.
+    int64_t deviation = (int64_t)fs_ratio - ASRC_BYPASS_RATIO_ONE;
+    int64_t acc = state->slip_acc + ((int64_t)n_in_samples * deviation);
+    int32_t slip = 0;
+
+    if(acc >= (ASRC_BYPASS_RATIO_ONE >> 1))
+    {
+        // Input is arriving faster than the output consumes it. Drop a sample.
+        slip = -1;
+        acc = acc - deviation - ASRC_BYPASS_RATIO_ONE;
+    }
+    else if(acc <= -(ASRC_BYPASS_RATIO_ONE >> 1))
+    {
+        // Input is arriving slower than the output consumes it. Insert a sample.
+        slip = 1;
+        acc = acc + deviation + ASRC_BYPASS_RATIO_ONE;
+    }
+    state->slip_acc = acc;
+    return slip;
+}
+
+static inline int32_t average(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a + b) >> 1);
+}
+
+unsigned asrc_bypass_process(const int32_t *input_samples, int32_t *output_samples, uint32_t n_in_samples, int32_t slip)
+{
+    uint32_t mid = n_in_samples >> 1;
+
+    if(slip == 0)
+    {
+        memcpy(output_samples, input_samples, n_in_samples * sizeof(int32_t));
+    }
+    else if(slip < 0)
+    {
+        // Merge input samples mid-1 and mid into one output sample
+        memcpy(output_samples, input_samples, (mid - 1) * sizeof(int32_t));
+        output_samples[mid - 1] = average(input_samples[mid - 1], input_samples[mid]);
+        memcpy(&output_samples[mid], &input_samples[mid + 1], (n_in_samples - mid - 1) * sizeof(int32_t));
+    }
+    else
+    {
+        // Interpolate a new output sample between input samples mid-1 and mid
+        memcpy(output_samples, input_samples, mid * sizeof(int32_t));
+        output_samples[mid] = average(input_samples[mid - 1], input_samples[mid]);
+        memcpy(&output_samples[mid + 1], &input_samples[mid], (n_in_samples - mid) * sizeof(int32_t));
+    }
+    return n_in_samples + slip;
+}
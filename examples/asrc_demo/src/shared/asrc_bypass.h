@@ -0,0 +1,66 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef ASRC_BYPASS_H
+#define ASRC_BYPASS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// This file contains the ASRC bypass path shared between the ASRC example application and the ASRC simulator code.
+//
+// When the nominal input and output rates are equal, the full ASRC is replaced by a copy of the input block. The drift
+// between the two clocks is absorbed by dropping or inserting one sample in the middle of a block whenever the accumulated
+// drift reaches half a sample. The sample either side of the slip is replaced by the average of the two, so a dropped
+// sample merges two samples into one and an inserted sample is interpolated between its neighbours.
+
+#define ASRC_BYPASS_RATIO_ONE               ((int64_t)1 << (28+32))   // Rate ratio of 1.0, in the Q60 rate ratio format
+#define ASRC_BYPASS_PPM_TO_Q60(ppm)         ((int64_t)(ppm) * (ASRC_BYPASS_RATIO_ONE / 1000000))
+#define ASRC_BYPASS_DEFAULT_MAX_DEVIATION   ASRC_BYPASS_PPM_TO_Q60(1000)  // Rate ratio deviation from 1.0 above which the full ASRC is used
+
+/// @brief Structure containing persistant variables that make up the ASRC bypass state
+typedef struct
+{
+    int64_t max_deviation;  /// Bypass is entered when |rate ratio - 1.0| <= max_deviation and left when it exceeds 2*max_deviation
+    int64_t slip_acc;       /// Accumulated difference between the ideal and the actual number of input samples consumed, Q60
+    bool active;            /// Flag indicating whether the bypass path is in use
+}asrc_bypass_state_t;
+
+/// @brief Initialise the ASRC bypass state. The bypass starts inactive.
+/// @param state            Pointer to the asrc_bypass_state_t state structure
+/// @param max_deviation    Maximum deviation of the rate ratio from 1.0 for which bypass is used, in the Q60 rate ratio format
+void init_asrc_bypass_state(asrc_bypass_state_t *state, int64_t max_deviation);
+
+/// @brief Decide whether the next block can use the bypass path. Bypass requires equal nominal rates and a rate ratio
+/// within the deviation limit, with hysteresis so that it does not toggle on a ratio close to the limit.
+/// The slip accumulator is cleared on entry to bypass.
+/// @param state    Pointer to the asrc_bypass_state_t state structure
+/// @param fs_in    Nominal input sampling rate
+/// @param fs_out   Nominal output sampling rate
+/// @param fs_ratio Rate ratio to be used for the next block, fs_in/fs_out in the Q60 rate ratio format
+/// @return bool    true if the next block should be processed by the bypass path
+bool asrc_bypass_update(asrc_bypass_state_t *state, uint32_t fs_in, uint32_t fs_out, uint64_t fs_ratio);
+
+/// @brief Decide the sample slip for the next block and update the slip accumulator. Called once per block, with the
+/// result passed to asrc_bypass_process() for every channel.
+/// @param state        Pointer to the asrc_bypass_state_t state structure
+/// @param fs_ratio     Rate ratio for the block, fs_in/fs_out in the Q60 rate ratio format
+/// @param n_in_samples Input block length
+/// @return int32_t     -1 to drop a sample, 1 to insert a sample, 0 to copy the block unchanged
+int32_t asrc_bypass_plan_block(asrc_bypass_state_t *state, uint64_t fs_ratio, uint32_t n_in_samples);
+
+/// @brief Process one block of one channel through the bypass path
+/// @param input_samples    Input block
+/// @param output_samples   Output block, with space for n_in_samples + 1 samples
+/// @param n_in_samples     Input block length. Must be at least 2
+/// @param slip             Value returned by asrc_bypass_plan_block() for this block
+/// @return unsigned        Number of output samples, n_in_samples + slip
+unsigned asrc_bypass_process(const int32_t *input_samples, int32_t *output_samples, uint32_t n_in_samples, int32_t slip);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
@@ -0,0 +1,48 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+#include "asrc_intertile_msg.h"
+
+void asrc_msg_init_header(asrc_msg_header_t *msg, uint32_t i2s_nominal_rate)
+{
+    memset(msg, 0, sizeof(asrc_msg_header_t));
+    msg->i2s_nominal_rate = i2s_nominal_rate;
+}
+
+void asrc_msg_attach_usb_rate_info(asrc_msg_header_t *msg, const usb_rate_info_t *info)
+{
+    msg->usb_rate_info = *info;
+    msg->flags |= ASRC_MSG_HAS_USB_RATE_INFO;
+}
+
+void asrc_msg_attach_i2s_rate_info(asrc_msg_header_t *msg, const i2s_to_usb_rate_info_t *info)
+{
+    msg->i2s_rate_info = *info;
+    msg->flags |= ASRC_MSG_HAS_I2S_RATE_INFO;
+}
+
+void asrc_msg_send(const asrc_msg_transport_t *transport, const asrc_msg_header_t *msg, unsigned num_ch, unsigned num_frames)
+{
+    transport->tx(transport, msg, asrc_msg_size(num_ch, num_frames));
+}
+
+bool asrc_msg_recv(const asrc_msg_transport_t *transport, asrc_msg_header_t *msg, size_t max_size, unsigned num_ch, unsigned *num_frames)
+{
+    size_t len = transport->rx(transport, msg, max_size);
+    const size_t frame_size = num_ch * sizeof(int32_t);
+
+    if((len < sizeof(asrc_msg_header_t)) || (len > max_size))
+    {
+        return false;
+    }
+    if(((len - sizeof(asrc_msg_header_t)) % frame_size) != 0)
+    {
+        return false;
+    }
+    if((msg->flags & ~(uint32_t)(ASRC_MSG_HAS_USB_RATE_INFO | ASRC_MSG_HAS_I2S_RATE_INFO)) != 0)
+    {
+        return false;
+    }
+    *num_frames = (len - sizeof(asrc_msg_header_t)) / frame_size;
+    return true;
+}
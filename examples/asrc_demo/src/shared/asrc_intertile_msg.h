@@ -0,0 +1,125 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef ASRC_INTERTILE_MSG_H
+#define ASRC_INTERTILE_MSG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "rate_window.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// This file contains the framing of the audio block messages exchanged between the USB and the I2S tiles of the ASRC
+// example application, shared with the unit tests.
+//
+// Every message starts with an asrc_msg_header_t, followed by zero or more interleaved int32_t frames. The header always
+// carries the nominal I2S sampling rate, and optionally the rate information that the rate server on the I2S tile works
+// from (usb_rate_info_t, USB -> I2S) or its result (i2s_to_usb_rate_info_t, I2S -> USB). Piggybacking the rate
+// information on the audio blocks means neither tile ever waits for the other to answer a rate request. A message with
+// no frames can be sent to deliver rate information on its own when there's no audio flowing in that direction.
+//
+// The messages go through an asrc_msg_transport_t, so that the same code runs over an rtos_intertile_t in the
+// application and over a loopback in the host unit tests.
+
+#define ASRC_MSG_HAS_USB_RATE_INFO  (1 << 0)    // usb_rate_info in the header is valid
+#define ASRC_MSG_HAS_I2S_RATE_INFO  (1 << 1)    // i2s_rate_info in the header is valid
+
+/// @brief Rate information sent from the USB tile to the rate server on the I2S tile
+typedef struct
+{
+    /* data */
+    int64_t buffer_based_correction;
+    rate_info_t usb_rate;
+    int32_t samples_to_host_buf_fill_level;
+
+    bool mic_itf_open;
+    bool spkr_itf_open;
+
+}usb_rate_info_t;
+
+/// @brief Rate information sent from the rate server on the I2S tile to the USB tile
+typedef struct
+{
+    /* data */
+    uint64_t usb_to_i2s_rate_ratio;
+}i2s_to_usb_rate_info_t;
+
+/// @brief Header at the start of every audio block message
+typedef struct
+{
+    uint32_t flags;                         /// Combination of ASRC_MSG_HAS_* flags indicating which rate info fields are valid
+    uint32_t i2s_nominal_rate;              /// Nominal I2S sampling rate. Only filled in on the I2S -> USB messages
+    usb_rate_info_t usb_rate_info;          /// Valid if flags has ASRC_MSG_HAS_USB_RATE_INFO set
+    i2s_to_usb_rate_info_t i2s_rate_info;   /// Valid if flags has ASRC_MSG_HAS_I2S_RATE_INFO set
+}asrc_msg_header_t;
+
+// The frames follow the header directly, so a struct of a header followed by an int32_t array has the message layout
+_Static_assert((sizeof(asrc_msg_header_t) % sizeof(int64_t)) == 0, "asrc_msg_header_t must not need padding before the frames");
+
+typedef struct asrc_msg_transport asrc_msg_transport_t;
+
+/// @brief Transport over which messages are sent and received. Each call to tx() sends one message, which is returned
+/// whole by one call to rx() on the other end.
+struct asrc_msg_transport
+{
+    void (*tx)(const asrc_msg_transport_t *transport, const void *msg, size_t len);  /// Send a message of len bytes
+    size_t (*rx)(const asrc_msg_transport_t *transport, void *msg, size_t max_len);  /// Wait for the next message and copy up to max_len bytes of it into msg. Returns the message length
+    void *ctx;                                                                       /// Transport specific context
+    unsigned port;                                                                   /// Transport specific port
+};
+
+/// @brief Pointer to the frames of a message
+/// @param msg          Message buffer, starting with the header
+/// @return int32_t*    Interleaved frames following the header
+static inline int32_t *asrc_msg_frames(asrc_msg_header_t *msg)
+{
+    return (int32_t *)(msg + 1);
+}
+
+/// @brief Size in bytes of a message
+/// @param num_ch       Number of channels in each frame
+/// @param num_frames   Number of frames following the header
+/// @return size_t      Size of the message in bytes
+static inline size_t asrc_msg_size(unsigned num_ch, unsigned num_frames)
+{
+    return sizeof(asrc_msg_header_t) + ((size_t)num_ch * num_frames * sizeof(int32_t));
+}
+
+/// @brief Clear a header so that it carries no rate information
+/// @param msg              Message header
+/// @param i2s_nominal_rate Nominal I2S sampling rate, or 0 when it isn't known by the sender
+void asrc_msg_init_header(asrc_msg_header_t *msg, uint32_t i2s_nominal_rate);
+
+/// @brief Attach USB rate information to a message
+/// @param msg      Message header
+/// @param info     Rate information to attach
+void asrc_msg_attach_usb_rate_info(asrc_msg_header_t *msg, const usb_rate_info_t *info);
+
+/// @brief Attach I2S rate information to a message
+/// @param msg      Message header
+/// @param info     Rate information to attach
+void asrc_msg_attach_i2s_rate_info(asrc_msg_header_t *msg, const i2s_to_usb_rate_info_t *info);
+
+/// @brief Send a message. The frames must already be in place after the header.
+/// @param transport    Transport to send the message over
+/// @param msg          Message buffer, starting with the header
+/// @param num_ch       Number of channels in each frame
+/// @param num_frames   Number of frames following the header. May be 0 for a message that only carries rate information
+void asrc_msg_send(const asrc_msg_transport_t *transport, const asrc_msg_header_t *msg, unsigned num_ch, unsigned num_frames);
+
+/// @brief Wait for and receive the next message
+/// @param transport    Transport to receive the message from
+/// @param msg          Message buffer, starting with the header
+/// @param max_size     Size of the message buffer in bytes
+/// @param num_ch       Number of channels in each frame
+/// @param num_frames   Set to the number of frames received following the header
+/// @return bool        true if a well formed message was received. On false, msg and num_frames must not be used
+bool asrc_msg_recv(const asrc_msg_transport_t *transport, asrc_msg_header_t *msg, size_t max_size, unsigned num_ch, unsigned *num_frames);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
@@ -0,0 +1,50 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include "asrc_xfade.h"
+
+void asrc_xfade(int32_t *samples, unsigned n_samples, const int32_t *old_samples, unsigned xfade_len)
+{
+    unsigned n = (n_samples < xfade_len) ? n_samples : xfade_len;
+    for(unsigned i = 0; i < n; i++)
+    {
+        int64_t acc = ((int64_t)old_samples[i] * (int64_t)(xfade_len - i)) + ((int64_t)samples[i] * (int64_t)i);
+        samples[i] = (int32_t)(acc / (int64_t)xfade_len);
+    }
+}
+
+void asrc_xfade_resample(int32_t *xfade_samples, unsigned xfade_len, const int32_t *samples, unsigned n_samples, uint32_t fs_from, uint32_t fs_to)
+{
+    // Input position of each output sample, in Q32
+    uint64_t step = ((uint64_t)fs_from << 32) / fs_to;
+    uint64_t pos = 0;
+    for(unsigned i = 0; i < xfade_len; i++)
+    {
+        unsigned idx = (unsigned)(pos >> 32);
+        if(idx + 1 >= n_samples)
+        {
+            xfade_samples[i] = samples[n_samples - 1];
+        }
+        else
+        {
+            int64_t frac = (int64_t)((pos >> 1) & 0x7fffffff); // Q31
+            int64_t diff = (int64_t)samples[idx + 1] - (int64_t)samples[idx];
+            xfade_samples[i] = (int32_t)((int64_t)samples[idx] + ((diff * frac) >> 31));
+        }
+        pos += step;
+    }
+}
+
+void asrc_xfade_reverse(int32_t *samples, unsigned n_samples)
+{
+    if(n_samples < 2)
+    {
+        return;
+    }
+    for(unsigned i = 0, j = n_samples - 1; i < j; i++, j--)
+    {
+        int32_t tmp = samples[i];
+        samples[i] = samples[j];
+        samples[j] = tmp;
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef ASRC_XFADE_H
+#define ASRC_XFADE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// This file contains the splice crossfade shared between the ASRC example application and the ASRC simulator code.
+//
+// When the ASRC output stream restarts, for example after an ASRC reinitialisation on a sampling rate change or a switch
+// between the ASRC and the bypass path, the old stream is carried on over the first block of the new one and the two
+// are crossfaded. The old stream may be at a different output rate, so it is first resampled to the new output rate
+// over the length of the crossfade.
+
+#define ASRC_XFADE_LENGTH   (32)    // Default crossfade length, in output samples
+
+/// @brief Crossfade the start of a block from an old stream.
+///
+/// samples[i] = (old_samples[i] * (xfade_len - i) + samples[i] * i) / xfade_len, for i < xfade_len. Samples beyond the
+/// crossfade are left unchanged. If n_samples < xfade_len, only the first n_samples are faded and the rest of the ramp
+/// is lost.
+///
+/// @param samples      Block of the new stream to fade, in place
+/// @param n_samples    Number of samples in the block
+/// @param old_samples  Old stream over the same time as the start of the block, xfade_len samples at the block's rate
+/// @param xfade_len    Crossfade length in samples
+void asrc_xfade(int32_t *samples, unsigned n_samples, const int32_t *old_samples, unsigned xfade_len);
+
+/// @brief Resample the start of a block of the old stream to the new stream's rate, by linear interpolation, to get
+/// the old_samples for asrc_xfade(). Output sample i is taken at input position i * fs_from / fs_to. Positions beyond
+/// the end of the input hold its last sample.
+///
+/// @param xfade_samples    Resampled old stream, xfade_len samples
+/// @param xfade_len        Crossfade length in samples
+/// @param samples          Old stream block
+/// @param n_samples        Number of samples in the old stream block. Must not be 0
+/// @param fs_from          Nominal rate of the old stream
+/// @param fs_to            Nominal rate of the new stream
+void asrc_xfade_resample(int32_t *xfade_samples, unsigned xfade_len, const int32_t *samples, unsigned n_samples, uint32_t fs_from, uint32_t fs_to);
+
+/// @brief Reverse a block in place. Running a block reversed through an ASRC carries the ASRC's history on as a mirror
+/// image of the block, which is continuous with the block's first sample. Used to prime a new ASRC instance when there
+/// is no previous input block at its input rate, and to carry an old stream on when its input has stopped.
+///
+/// @param samples      Block to reverse
+/// @param n_samples    Number of samples in the block
+void asrc_xfade_reverse(int32_t *samples, unsigned n_samples);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
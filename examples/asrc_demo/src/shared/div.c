@@ -25,7 +25,7 @@ float_s32_t float_div(float_s32_t dividend, float_s32_t divisor)
 
     uint32_t h_divisor = ((uint32_t)divisor.mant) << (divisor_hr);
 
-    uint32_t lhs = (h_dividend > h_divisor) ? 31 : 32;
+    uint32_t lhs = (h_dividend >= h_divisor) ? 31 : 32; // Keeps the quotient below 2**32, including when the mantissas are equal
 
     uint64_t normalised_dividend = h_dividend << lhs;
 
@@ -0,0 +1,143 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "pi_control.h"
+
+static void init_pi_control_state(pi_control_state_t *state, sw_pll_q24_t Kp, sw_pll_q24_t Ki)
+{
+    memset(state, 0, sizeof(pi_control_state_t));
+    state->Kp = Kp;
+    state->Ki = Ki;
+    state->max_correction = PI_CONTROL_MAX_CORRECTION;
+}
+
+void init_i2s_buffer_pi_control_state(pi_control_state_t *state, int32_t nominal_i2s_rate)
+{
+    // The gain constants are generated using the simulation framework empirically, to get values using which
+    // the calculated correction factor stablises the buffer level.
+    sw_pll_q24_t Kp = 0;
+    sw_pll_q24_t Ki = 0;
+    if((nominal_i2s_rate == 44100) || (nominal_i2s_rate == 48000))
+    {
+        Kp = KP_I2S_BUF_CONTROL_FS48;
+        Ki = KI_I2S_BUF_CONTROL_FS48;
+    }
+    else if((nominal_i2s_rate == 88200) || (nominal_i2s_rate == 96000))
+    {
+        Kp = KP_I2S_BUF_CONTROL_FS96;
+        Ki = KI_I2S_BUF_CONTROL_FS96;
+    }
+    else if((nominal_i2s_rate == 176400) || (nominal_i2s_rate == 192000))
+    {
+        Kp = KP_I2S_BUF_CONTROL_FS192;
+        Ki = KI_I2S_BUF_CONTROL_FS192;
+    }
+    init_pi_control_state(state, Kp, Ki);
+}
+
+void retarget_i2s_buffer_pi_control_state(pi_control_state_t *state, int32_t prev_nominal_i2s_rate, int32_t nominal_i2s_rate)
+{
+    int64_t integral = 0;
+    if((prev_nominal_i2s_rate != 0) && (nominal_i2s_rate != 0))
+    {
+        // |integral| <= PI_CONTROL_MAX_CORRECTION, so this can't overflow for any supported rate
+        integral = (state->integral * prev_nominal_i2s_rate) / nominal_i2s_rate;
+    }
+    init_i2s_buffer_pi_control_state(state, nominal_i2s_rate);
+    if(integral > state->max_correction)
+    {
+        integral = state->max_correction;
+    }
+    else if(integral < -state->max_correction)
+    {
+        integral = -state->max_correction;
+    }
+    state->integral = integral;
+}
+
+void init_usb_buffer_pi_control_state(pi_control_state_t *state, int32_t nominal_i2s_rate)
+{
+    // The gain constants are generated using the simulation framework, largely through trial and error, to get values using which
+    // the calculated correction factor stablises the buffer level.
+    sw_pll_q24_t Kp = 0;
+    sw_pll_q24_t Ki = 0;
+    if((nominal_i2s_rate == 44100) || (nominal_i2s_rate == 48000))
+    {
+        Kp = KP_USB_BUF_CONTROL_FS48;
+        Ki = KI_USB_BUF_CONTROL_FS48;
+    }
+    else if((nominal_i2s_rate == 88200) || (nominal_i2s_rate == 96000))
+    {
+        Kp = KP_USB_BUF_CONTROL_FS96;
+        Ki = KI_USB_BUF_CONTROL_FS96;
+    }
+    else if((nominal_i2s_rate == 176400) || (nominal_i2s_rate == 192000))
+    {
+        Kp = KP_USB_BUF_CONTROL_FS192;
+        Ki = KI_USB_BUF_CONTROL_FS192;
+    }
+    init_pi_control_state(state, Kp, Ki);
+}
+
+static inline int64_t clamp_correction(int64_t val, int64_t max_correction)
+{
+    if(val > max_correction)
+    {
+        return max_correction;
+    }
+    else if(val < -max_correction)
+    {
+        return -max_correction;
+    }
+    return val;
+}
+
+int64_t pi_control(pi_control_state_t *state, bool error_valid, int32_t error)
+{
+    if(error_valid == false)
+    {
+        // No setpoint yet, or the buffer level averaging has been reset. Start integrating afresh once it's stable.
+        state->integral = 0;
+        return 0;
+    }
+
+    int64_t error_p = ((int64_t)state->Kp * (int64_t)error) << 8;
+    int64_t error_i = ((int64_t)state->Ki * (int64_t)error) << 8;
+
+    int64_t integral = clamp_correction(state->integral + error_i, state->max_correction);
+    int64_t total_error = error_p + integral;
+
+    // Anti-windup: only let the integral move if that doesn't push a saturated output further into saturation
+    if(((total_error > state->max_correction) && (error_i > 0)) ||
+       ((total_error < -state->max_correction) && (error_i < 0)))
+    {
+        total_error = error_p + state->integral;
+    }
+    else
+    {
+        state->integral = integral;
+    }
+
+    return clamp_correction(total_error, state->max_correction);
+}
+
+int64_t calc_usb_buffer_based_correction(pi_control_state_t *state, bool long_term_valid, int32_t long_term_error,
+                                         bool short_term_valid, int32_t short_term_level)
+{
+    // Correct based on short term average only when creeping outside the guard band. The integral is held meanwhile.
+    if(short_term_valid == true)
+    {
+        if(short_term_level > USB_BUF_CONTROL_GUARD_BAND)
+        {
+            return state->max_correction;
+        }
+        else if(short_term_level < -USB_BUF_CONTROL_GUARD_BAND)
+        {
+            return -(state->max_correction);
+        }
+    }
+
+    return pi_control(state, long_term_valid, long_term_error);
+}
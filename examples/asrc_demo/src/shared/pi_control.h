@@ -0,0 +1,99 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef PI_CONTROL_H
+#define PI_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// This file contains the buffer level PI controller shared between the ASRC example application and the ASRC simulator code
+
+typedef int32_t sw_pll_q24_t; // Type for 8.24 signed fixed point
+#define SW_PLL_NUM_FRAC_BITS 24
+#define SW_PLL_Q24(val) ((sw_pll_q24_t)((double)val * (1 << SW_PLL_NUM_FRAC_BITS)))
+
+// The gains are in units of (rate ratio correction per sample of buffer level error) * (2**28), in Q24.
+// The correction they produce is in the same Q60 format as the rate ratio it is added to.
+
+// Kp constants for I2S buffer based control for the USB -> ASRC -> (buffer) -> I2S direction.
+#define KP_I2S_BUF_CONTROL_FS48     (SW_PLL_Q24(11.542724608))      // 0.000000043 * (2**28)
+#define KP_I2S_BUF_CONTROL_FS96     (SW_PLL_Q24(5.905580032))       // 0.000000022 * (2**28)
+#define KP_I2S_BUF_CONTROL_FS192    (SW_PLL_Q24(3.2749125632))      // 0.0000000122 * (2**28)
+
+// Kp constants for USB buffer based control for the I2S -> ASRC -> (buffer) -> USB direction.
+#define KP_USB_BUF_CONTROL_FS48     (SW_PLL_Q24(4.563402752))      // 0.000000017 * (2**28)
+#define KP_USB_BUF_CONTROL_FS96     (SW_PLL_Q24(9.39524096))       // 0.000000035 * (2**28)
+#define KP_USB_BUF_CONTROL_FS192    (SW_PLL_Q24(18.79048192))      // 0.00000007* (2**28)
+
+// Ki constants, applied per controller update. Set to Kp/256, i.e. an integral time constant of 256 updates, by sweeping
+// Ki from 0 to Kp/8 with test/asrc_sim/python/sweep.py. Kp/256 locked in every run of both apps at all rates. Kp/64 and
+// faster left some runs out of lock or relocking late. With no I term, a steady state error of up to 12 samples remained.
+#define KI_I2S_BUF_CONTROL_FS48     (SW_PLL_Q24(0.045088768))       // Kp/256
+#define KI_I2S_BUF_CONTROL_FS96     (SW_PLL_Q24(0.023068672))       // Kp/256
+#define KI_I2S_BUF_CONTROL_FS192    (SW_PLL_Q24(0.0127926272))      // Kp/256
+
+#define KI_USB_BUF_CONTROL_FS48     (SW_PLL_Q24(0.017825792))       // Kp/256
+#define KI_USB_BUF_CONTROL_FS96     (SW_PLL_Q24(0.03670016))        // Kp/256
+#define KI_USB_BUF_CONTROL_FS192    (SW_PLL_Q24(0.07340032))        // Kp/256
+
+#define PI_CONTROL_MAX_CORRECTION   ((int64_t)1500 << 32)           // Maximum correction, in the Q60 rate ratio format
+#define USB_BUF_CONTROL_GUARD_BAND  (300)                           // Short term average buffer level beyond which the USB buffer control applies full correction
+
+/// @brief Structure containing persistant variables that make up the PI controller state
+typedef struct
+{
+    sw_pll_q24_t Kp;            /// Proportional gain
+    sw_pll_q24_t Ki;            /// Integral gain
+    int64_t max_correction;     /// Limit on the magnitude of the correction and of the integral term
+    int64_t integral;           /// Accumulated integral term, in the Q60 rate ratio format
+}pi_control_state_t;
+
+/// @brief Initialise a PI controller for the I2S send buffer, which corrects the USB -> I2S rate ratio
+/// @param state            Pointer to the pi_control_state_t state structure
+/// @param nominal_i2s_rate Nominal I2S sampling rate, used to pick the gains
+void init_i2s_buffer_pi_control_state(pi_control_state_t *state, int32_t nominal_i2s_rate);
+
+/// @brief Pick up the I2S send buffer controller gains for a new nominal I2S rate while keeping the controller running.
+/// The integral term is a correction to the USB/I2S rate ratio, so it is rescaled by prev_nominal_i2s_rate/nominal_i2s_rate.
+/// @param state                    Pointer to the pi_control_state_t state structure
+/// @param prev_nominal_i2s_rate    Nominal I2S sampling rate the controller was running at. 0 to start afresh
+/// @param nominal_i2s_rate         New nominal I2S sampling rate
+void retarget_i2s_buffer_pi_control_state(pi_control_state_t *state, int32_t prev_nominal_i2s_rate, int32_t nominal_i2s_rate);
+
+/// @brief Initialise a PI controller for the samples to host buffer, which corrects the I2S -> USB rate ratio
+/// @param state            Pointer to the pi_control_state_t state structure
+/// @param nominal_i2s_rate Nominal I2S sampling rate, used to pick the gains
+void init_usb_buffer_pi_control_state(pi_control_state_t *state, int32_t nominal_i2s_rate);
+
+/// @brief Run one PI controller update on the buffer level error, the difference between the average and the stable
+/// buffer level.
+///
+/// The integral term is clamped to the maximum correction and stops accumulating while the output is saturated in the
+/// direction of the error (anti-windup). Until the buffer level average is stable, the integral is held at 0 and no
+/// correction is applied.
+///
+/// @param state        Pointer to the pi_control_state_t state structure
+/// @param error_valid  Whether the buffer level average is stable, so that there is an error to act on
+/// @param error        Average buffer level minus the stable buffer level, in samples
+/// @return int64_t     Correction to add to the rate ratio, in the Q60 rate ratio format
+int64_t pi_control(pi_control_state_t *state, bool error_valid, int32_t error);
+
+/// @brief Calculate the correction for the samples to host buffer. Applies full correction when the short term average
+/// goes outside the guard band and otherwise runs the PI controller on the long term average.
+/// @param state                Pointer to the pi_control_state_t state structure
+/// @param long_term_valid      Whether the long term buffer level average is stable
+/// @param long_term_error      Long term average buffer level minus its stable level, in samples
+/// @param short_term_valid     Whether the short term buffer level average is stable
+/// @param short_term_level     Short term average buffer level, in samples
+/// @return int64_t             Correction to add to the rate ratio, in the Q60 rate ratio format
+int64_t calc_usb_buffer_based_correction(pi_control_state_t *state, bool long_term_valid, int32_t long_term_error,
+                                         bool short_term_valid, int32_t short_term_level);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
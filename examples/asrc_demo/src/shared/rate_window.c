@@ -0,0 +1,150 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+#include "rate_window.h"
+
+static inline int clz_u64(uint64_t x)
+{
+    uint32_t hi = (uint32_t)(x >> 32);
+    uint32_t lo = (uint32_t)x;
+    if(hi != 0)
+    {
+        return __builtin_clz(hi);
+    }
+    else if(lo != 0)
+    {
+        return 32 + __builtin_clz(lo);
+    }
+    return 64;
+}
+
+void init_rate_window_state(rate_window_state_t *state, uint32_t *sample_buckets, uint32_t *tick_buckets, uint32_t num_buckets)
+{
+    memset(state, 0, sizeof(rate_window_state_t));
+    memset(sample_buckets, 0, num_buckets * sizeof(uint32_t));
+    memset(tick_buckets, 0, num_buckets * sizeof(uint32_t));
+    state->sample_buckets = sample_buckets;
+    state->tick_buckets = tick_buckets;
+    state->num_buckets = num_buckets;
+}
+
+void rate_window_seed(rate_window_state_t *state, uint32_t num_seed_buckets, uint32_t samples_per_bucket, uint32_t ticks_per_bucket)
+{
+    for(uint32_t i = state->num_buckets - num_seed_buckets; i < state->num_buckets; i++)
+    {
+        state->total_samples += samples_per_bucket - state->sample_buckets[i];
+        state->total_ticks += ticks_per_bucket - state->tick_buckets[i];
+        state->sample_buckets[i] = samples_per_bucket;
+        state->tick_buckets[i] = ticks_per_bucket;
+    }
+}
+
+void rate_window_push_bucket(rate_window_state_t *state, uint32_t samples, uint32_t ticks)
+{
+    uint32_t oldest_bucket = state->next_bucket;
+
+    // Swap the oldest bucket out of the running sums and the new one in
+    state->total_samples = state->total_samples - state->sample_buckets[oldest_bucket] + samples;
+    state->total_ticks = state->total_ticks - state->tick_buckets[oldest_bucket] + ticks;
+    state->sample_buckets[oldest_bucket] = samples;
+    state->tick_buckets[oldest_bucket] = ticks;
+
+    oldest_bucket += 1;
+    if(oldest_bucket == state->num_buckets)
+    {
+        oldest_bucket = 0;
+    }
+    state->next_bucket = oldest_bucket;
+}
+
+rate_info_t rate_window_get_rate(const rate_window_state_t *state, uint32_t partial_samples, uint32_t partial_ticks)
+{
+    rate_info_t rate;
+    rate.samples = state->total_samples + partial_samples;
+    rate.ticks = state->total_ticks + partial_ticks;
+    return rate;
+}
+
+// Reduce a count to at most 32 bits, returning the number of bits it was shifted right by. Sample counts fit in 32 bits
+// for any window the application uses, so in practice only the reference clock tick counts lose low bits, which is a
+// relative error of under 2**-31 of the tick count.
+static inline int reduce_to_32_bits(uint64_t x, uint32_t *reduced)
+{
+    int rsh = 32 - clz_u64(x);
+    if(rsh < 0)
+    {
+        rsh = 0;
+    }
+    *reduced = (uint32_t)(x >> rsh);
+    return rsh;
+}
+
+// One step of a long division, (hi:lo) / divisor for hi < divisor, which is a single ldivu instruction on xcore
+static inline uint32_t long_div_step(uint32_t hi, uint32_t lo, uint32_t divisor, uint32_t *remainder)
+{
+    uint32_t quotient;
+#if __xcore__
+    uint32_t r;
+    asm("ldivu %0,%1,%2,%3,%4":"=r"(quotient),"=r"(r):"r"(hi),"r"(lo),"r"(divisor));
+    *remainder = r;
+#else
+    uint64_t dividend = ((uint64_t)hi << 32) | lo;
+    quotient = (uint32_t)(dividend / divisor);
+    *remainder = (uint32_t)(dividend % divisor);
+#endif
+    return quotient;
+}
+
+// Divide a 128 bit number, as 4 words most significant first, by a 32 bit number in place
+static inline void long_div_128(uint32_t words[4], uint32_t divisor)
+{
+    uint32_t remainder = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        words[i] = long_div_step(remainder, words[i], divisor, &remainder);
+    }
+}
+
+uint64_t rate_ratio_fixed_output_q_format(rate_info_t numerator, rate_info_t denominator, int32_t output_q_format)
+{
+    uint32_t a_samples, a_ticks, b_samples, b_ticks;
+    // Each count is reduced separately, so a small sample count never loses bits because its tick count is large
+    int exp = reduce_to_32_bits(numerator.samples, &a_samples)
+            + reduce_to_32_bits(denominator.ticks, &b_ticks)
+            - reduce_to_32_bits(numerator.ticks, &a_ticks)
+            - reduce_to_32_bits(denominator.samples, &b_samples);
+    if((a_samples == 0) || (a_ticks == 0) || (b_samples == 0) || (b_ticks == 0))
+    {
+        return 0;
+    }
+
+    // (a_samples * b_ticks) / a_ticks / b_samples, as an integer part of up to 64 bits and a 64 bit fraction. Dividing
+    // by the two 32 bit divisors in turn needs eight 64 by 32 bit divides, and truncating the fraction in between is
+    // an error of under 2**-64.
+    uint64_t product = (uint64_t)a_samples * b_ticks;
+    uint32_t words[4] = {(uint32_t)(product >> 32), (uint32_t)product, 0, 0};
+    long_div_128(words, a_ticks);
+    long_div_128(words, b_samples);
+
+    // The ratio is words * 2**(exp - 64). Shift it to the output Q format and round to nearest. The caller is expected
+    // to pick an output_q_format that leaves enough integer bits for the ratio.
+    uint64_t hi = ((uint64_t)words[0] << 32) | words[1];
+    uint64_t lo = ((uint64_t)words[2] << 32) | words[3];
+    int rsh = 64 - output_q_format - exp;
+    if(rsh <= 0)
+    {
+        return (rsh > -64) ? (lo << -rsh) : 0;
+    }
+    else if(rsh < 64)
+    {
+        uint64_t quotient = (hi << (64 - rsh)) | (lo >> rsh);
+        return quotient + ((lo >> (rsh - 1)) & 1);
+    }
+    else if(rsh < 128)
+    {
+        uint64_t quotient = hi >> (rsh - 64);
+        uint64_t round = (rsh == 64) ? (lo >> 63) : ((hi >> (rsh - 65)) & 1);
+        return quotient + round;
+    }
+    return 0;
+}
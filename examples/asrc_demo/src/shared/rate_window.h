@@ -0,0 +1,78 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef RATE_WINDOW_H
+#define RATE_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// This file contains the sliding window rate estimator shared between the ASRC example application and the ASRC simulator code
+
+/// @brief Sampling rate expressed as an exact rational number, samples counted over a span of reference clock ticks
+typedef struct
+{
+    uint64_t samples;   /// Number of samples counted
+    uint64_t ticks;     /// Number of reference clock ticks over which the samples were counted
+}rate_info_t;
+
+/// @brief Structure containing persistant variables that make up the sliding window rate estimator state
+typedef struct
+{
+    uint32_t *sample_buckets;   /// Samples counted in each bucket. Caller provided storage of num_buckets entries
+    uint32_t *tick_buckets;     /// Reference clock ticks spanned by each bucket. Caller provided storage of num_buckets entries
+    uint32_t num_buckets;       /// Number of buckets that make up the window
+    uint32_t next_bucket;       /// Index of the bucket that gets replaced on the next rate_window_push_bucket() call
+    uint64_t total_samples;     /// Running sum of sample_buckets
+    uint64_t total_ticks;       /// Running sum of tick_buckets
+}rate_window_state_t;
+
+/// @brief Initialise an instance of a sliding window rate estimator. All buckets are cleared.
+/// @param state            Pointer to the rate_window_state_t state structure
+/// @param sample_buckets   Storage for num_buckets sample counts
+/// @param tick_buckets     Storage for num_buckets tick counts
+/// @param num_buckets      Number of buckets in the window
+void init_rate_window_state(rate_window_state_t *state, uint32_t *sample_buckets, uint32_t *tick_buckets, uint32_t num_buckets);
+
+/// @brief Seed the most recently replaced buckets of the window with a known rate, so the estimate starts close to nominal.
+/// @param state                Pointer to the rate_window_state_t state structure
+/// @param num_seed_buckets     Number of buckets, counting back from the end of the window, to seed
+/// @param samples_per_bucket   Samples per seeded bucket
+/// @param ticks_per_bucket     Ticks per seeded bucket
+void rate_window_seed(rate_window_state_t *state, uint32_t num_seed_buckets, uint32_t samples_per_bucket, uint32_t ticks_per_bucket);
+
+/// @brief Replace the oldest bucket in the window with a newly completed one. The running sums are updated in O(1).
+/// @param state    Pointer to the rate_window_state_t state structure
+/// @param samples  Samples counted in the completed bucket
+/// @param ticks    Ticks spanned by the completed bucket
+void rate_window_push_bucket(rate_window_state_t *state, uint32_t samples, uint32_t ticks);
+
+/// @brief Get the rate over the whole window plus the bucket currently being filled.
+/// @param state            Pointer to the rate_window_state_t state structure
+/// @param partial_samples  Samples counted so far in the bucket currently being filled
+/// @param partial_ticks    Ticks spanned so far by the bucket currently being filled
+/// @return rate_info_t     Total samples and ticks
+rate_info_t rate_window_get_rate(const rate_window_state_t *state, uint32_t partial_samples, uint32_t partial_ticks);
+
+/**
+ * @brief Calculate the ratio of two rates, (numerator.samples * denominator.ticks) / (numerator.ticks * denominator.samples),
+ * with the output in a fixed Q format.
+ *
+ * Unlike dividing each rate down to a float_s32_t first and then dividing the two results, the ratio is computed from the
+ * rationals directly, with a single rounding at the end. Counts of more than 32 bits, which in practice are only tick
+ * counts, are shifted down to 32 bits first. The division is done with 64 by 32 bit divides, the ldivu instruction on xcore.
+ *
+ * @param numerator     Rate in the numerator of the ratio
+ * @param denominator   Rate in the denominator of the ratio
+ * @param output_q_format Q format of the output. for example, if the output is desired in Q60 format, set output_q_format to 60
+ * @return uint64_t 64 bit mantissa of the ratio. Returns 0 if either rate has zero samples or ticks
+ */
+uint64_t rate_ratio_fixed_output_q_format(rate_info_t numerator, rate_info_t denominator, int32_t output_q_format);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
@@ -40,7 +40,7 @@ typedef struct usb_audio_rate_packet_desc {
 } usb_audio_rate_packet_desc_t;
 
 static QueueHandle_t data_event_queue = NULL;
-usb_rate_calc_info_t g_usb_rate_calc_info[2] = {{0,0}, {0,0}};
+rate_info_t g_usb_rate_calc_info[2] = {{0,0}, {0,0}};
 
 static uint32_t timestamp_from_sofs = 0;
 
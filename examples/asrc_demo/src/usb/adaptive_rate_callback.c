@@ -28,21 +28,15 @@ void reset_state(uint32_t direction)
 }
 
 
-usb_rate_calc_info_t determine_USB_audio_rate(uint32_t timestamp,
+rate_info_t determine_USB_audio_rate(uint32_t timestamp,
                                     uint32_t data_length,
-                                    uint32_t direction
-#ifdef DEBUG_ADAPTIVE
-                                                ,
-                                    uint32_t * debug
-#endif
-)
+                                    uint32_t direction)
 {
     static uint32_t data_lengths[2][TOTAL_STORED];
     static uint32_t time_buckets[2][TOTAL_STORED];
+    static rate_window_state_t rate_window_state[2];
     static uint32_t current_data_bucket_size[2];
     static uint32_t first_timestamp[2];
-    static bool buckets_full[2];
-    static uint32_t times_overflowed[2];
 
     data_length = data_length / (CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX); // Number of samples per channels per transaction
 
@@ -60,78 +54,33 @@ usb_rate_calc_info_t determine_USB_audio_rate(uint32_t timestamp,
         // Because we use "first_time" to also reset the rate determinator,
         // reset all the static variables to default.
         current_data_bucket_size[direction] = 0;
-        times_overflowed[direction] = 0;
-        buckets_full[direction] = false;
+        init_rate_window_state(&rate_window_state[direction], data_lengths[direction], time_buckets[direction], TOTAL_STORED);
 
-        for (int i = 0; i < TOTAL_STORED; i++)
-        {
-            data_lengths[direction][i] = 0;
-            time_buckets[direction][i] = 0;
-        }
-
-        return (usb_rate_calc_info_t){appconfUSB_AUDIO_SAMPLE_RATE, REF_CLOCK_TICKS_PER_SECOND};
+        return (rate_info_t){appconfUSB_AUDIO_SAMPLE_RATE, REF_CLOCK_TICKS_PER_SECOND};
     }
 
     current_data_bucket_size[direction] += data_length;
 
 
 
-    // total_timespan is always correct regardless of whether the reference clock has overflowed.
+    // timespan is always correct regardless of whether the reference clock has overflowed.
     // The point at which it becomes incorrect is the point at which it would overflow - the
     // point at which timestamp == first_timestamp again. This will be at 42.95 seconds of operation.
     // If current_data_bucket_size overflows we have bigger issues, so this case is not guarded.
 
     uint32_t timespan = timestamp - first_timestamp[direction];
 
-
-    usb_rate_calc_info_t result = {0, 0};
-    uint32_t total_data_intermed = current_data_bucket_size[direction] + sum_array(data_lengths[direction], TOTAL_STORED);
-    uint32_t total_timespan = timespan + sum_array(time_buckets[direction], TOTAL_STORED);
-    result.total_data_samples = total_data_intermed;
-    result.total_ticks = total_timespan;
-
+    rate_info_t result = rate_window_get_rate(&rate_window_state[direction], current_data_bucket_size[direction], timespan);
 
     if (timespan >= REF_CLOCK_TICKS_PER_STORED_AVG)
     {
-        if (buckets_full[direction])
-        {
-            // We've got enough data for a new bucket - replace the oldest bucket data with this new data
-            uint32_t oldest_bucket = times_overflowed[direction] % TOTAL_STORED;
+        // We've got enough data for this bucket - replace the oldest bucket data with this one and start the next one
+        rate_window_push_bucket(&rate_window_state[direction], current_data_bucket_size[direction], timespan);
 
-            time_buckets[direction][oldest_bucket] = timespan;
-            data_lengths[direction][oldest_bucket] = current_data_bucket_size[direction];
-
-            current_data_bucket_size[direction] = 0;
-            first_timestamp[direction] = timestamp;
-
-            times_overflowed[direction]++;
-        }
-        else
-        {
-            // We've got enough data for this bucket - save this one and start the next one
-            time_buckets[direction][times_overflowed[direction]] = timespan;
-            data_lengths[direction][times_overflowed[direction]] = current_data_bucket_size[direction];
-
-            current_data_bucket_size[direction] = 0;
-            first_timestamp[direction] = timestamp;
-
-            times_overflowed[direction]++;
-            if (times_overflowed[direction] == TOTAL_STORED)
-            {
-                buckets_full[direction] = true;
-            }
-        }
+        current_data_bucket_size[direction] = 0;
+        first_timestamp[direction] = timestamp;
     }
 
-#ifdef DEBUG_ADAPTIVE
-    #define DEBUG_QUANT 4
-
-    uint32_t debug_out[DEBUG_QUANT] = {result, data_per_sample, total_data_intermed, total_timespan};
-    for (int i = 0; i < DEBUG_QUANT; i++)
-    {
-        debug[i] = debug_out[i];
-    }
-#endif
     return result;
 }
 
@@ -6,13 +6,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <xmath/xmath.h>
+#include "rate_window.h"
 
-typedef struct {
-    uint32_t total_data_samples;
-    uint32_t total_ticks;
-}usb_rate_calc_info_t;
-
-usb_rate_calc_info_t determine_USB_audio_rate(uint32_t timestamp,
+rate_info_t determine_USB_audio_rate(uint32_t timestamp,
                                     uint32_t data_length,
                                     uint32_t direction);
 void reset_state();
@@ -37,6 +37,7 @@
 
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
+#include "queue.h"
 
 #include "usb_descriptors.h"
 #include "tusb.h"
@@ -48,10 +49,14 @@
 #include "usb_audio.h"
 #include "asrc_utils.h"
 #include "rate_server.h"
+#include "asrc_intertile_msg.h"
+#include "asrc_msg_rtos_transport.h"
 #include "dbcalc.h"
 #include "avg_buffer_level.h"
+#include "pi_control.h"
 #include "adaptive_rate_callback.h"
-#include "div.h"
+#include "audio_format.h"
+#include "audio_gain_ramp.h"
 
 // Audio controls
 // Current states
@@ -73,13 +78,15 @@ static StreamBufferHandle_t samples_to_host_stream_buf;
 static StreamBufferHandle_t samples_from_host_stream_buf;
 static StreamBufferHandle_t rx_buffer;
 static TaskHandle_t usb_audio_out_asrc_handle;
+static QueueHandle_t usb_rate_info_mailbox; // Latest usb_rate_info from usb_audio_send, waiting to go to the I2S tile with the next USB -> I2S audio block
+static asrc_msg_transport_t usb_to_i2s_transport;
 
 static uint64_t g_usb_to_i2s_rate_ratio = 0;
 static uint32_t samples_to_host_stream_buf_size_bytes = 0;
 static bool g_i2s_sr_change_detected = false;
 static bool samples_to_host_buf_ready_to_read = false;
 
-extern usb_rate_calc_info_t g_usb_rate_calc_info[2];
+extern rate_info_t g_usb_rate_calc_info[2];
 
 
 #define USB_FRAMES_PER_ASRC_INPUT_FRAME (USB_TO_I2S_ASRC_BLOCK_LENGTH / (appconfUSB_AUDIO_SAMPLE_RATE / 1000))
@@ -186,12 +193,17 @@ void tud_resume_cb(void)
 #define USB_AUDIO_MAX_VOLUME_DB     ((int16_t)0  << USB_AUDIO_VOLUME_FRAC_BITS)
 #define USB_AUDIO_VOLUME_STEP_DB    ((int16_t)1  << USB_AUDIO_VOLUME_FRAC_BITS)
 
+// Volume and mute changes are ramped over this many samples at the USB rate (5ms) so they don't click
+#define USB_AUDIO_VOLUME_RAMP_LENGTH    (appconfUSB_AUDIO_SAMPLE_RATE / 200)
+
 static bool mute_d2h[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1] = {0};                         // +1 for master channel 0
 static bool mute_h2d[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX + 1] = {0};                         // +1 for master channel 0
 static int16_t volume_d2h[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1] = {0};                    // +1 for master channel 0. These are dB val in 8.8
 static int16_t volume_h2d[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX + 1] = {0};                    // +1 for master channel 0
 static uint32_t vol_mul_d2h[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX] = {0};                      // No +1 because master channel is included already. These are the volume scaling vals
 static uint32_t vol_mul_h2d[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX] = {0};                      // No +1 because master channel is included already
+static audio_gain_ramp_t gain_ramp_d2h;                                                     // Applies vol_mul_d2h, ramping to each new value
+static audio_gain_ramp_t gain_ramp_h2d;                                                     // Applies vol_mul_h2d, ramping to each new value
 
 
 static void update_vol_mul(const unsigned chan, const unsigned num_audio_chan, const int16_t volumes[], const bool mutes[], uint32_t vol_muls[])
@@ -237,11 +249,8 @@ static void init_volume_multipliers(void)
     {
         update_vol_mul(chan, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, volume_h2d, mute_h2d, vol_mul_h2d);
     }
-}
-
-static inline int32_t volume_scale(const uint32_t mul, const int32_t samp){
-    int64_t result = (int64_t)samp * (int64_t)mul;
-    return (int32_t)(result >> USB_AUDIO_VOL_MUL_FRAC_BITS);
+    audio_gain_ramp_init(&gain_ramp_d2h, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX, USB_AUDIO_VOLUME_RAMP_LENGTH, USB_AUDIO_VOL_MUL_FRAC_BITS, vol_mul_d2h);
+    audio_gain_ramp_init(&gain_ramp_h2d, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, USB_AUDIO_VOLUME_RAMP_LENGTH, USB_AUDIO_VOL_MUL_FRAC_BITS, vol_mul_h2d);
 }
 
 //--------------------------------------------------------------------+
@@ -250,8 +259,10 @@ static inline int32_t volume_scale(const uint32_t mul, const int32_t samp){
 
 #if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
 typedef int16_t samp_t;
+#define USB_AUDIO_SAMP_FORMAT   AUDIO_FORMAT_S16
 #elif CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 4
 typedef int32_t samp_t;
+#define USB_AUDIO_SAMP_FORMAT   AUDIO_FORMAT_S32
 #else
 #error CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX must be either 2 or 4
 #endif
@@ -280,65 +291,6 @@ static inline int32_t get_avg_window_size_log2(uint32_t i2s_rate)
 }
 
 
-static inline sw_pll_q24_t get_Kp_for_usb_buffer_control(int32_t nominal_i2s_rate)
-{
-    // The Kp constants are generated using the simulation framework, largely through trial and error, to get values using which
-    // the calculated correction factor stablises the buffer level.
-    sw_pll_q24_t Kp = 0;
-    if(((int)nominal_i2s_rate == (int)44100) || ((int)nominal_i2s_rate == (int)48000))
-    {
-        Kp = KP_USB_BUF_CONTROL_FS48;
-    }
-    else if(((int)nominal_i2s_rate == (int)88200) || ((int)nominal_i2s_rate == (int)96000))
-    {
-        Kp = KP_USB_BUF_CONTROL_FS96;
-    }
-    else if(((int)nominal_i2s_rate == (int)176400) || ((int)nominal_i2s_rate == (int)192000))
-    {
-        Kp = KP_USB_BUF_CONTROL_FS192;
-    }
-    return Kp;
-}
-
-static inline int64_t calc_usb_buffer_based_correction(int32_t nominal_i2s_rate, buffer_calc_state_t *long_term_buf_state, buffer_calc_state_t *short_term_buf_state)
-{
-    sw_pll_q24_t Kp = get_Kp_for_usb_buffer_control(nominal_i2s_rate);
-    int64_t max_allowed_correction = (int64_t)1500 << 32;
-    int64_t total_error = 0;
-
-    // Correct based on short term average only when creeping outside the guard band
-    if(short_term_buf_state->flag_stable_avg == true)
-    {
-        if(short_term_buf_state->avg_buffer_level > 200)
-        {
-            total_error = max_allowed_correction;
-            return total_error;
-        }
-        else if(short_term_buf_state->avg_buffer_level < -200)
-        {
-            total_error = -(max_allowed_correction);
-            return total_error;
-        }
-    }
-    if(long_term_buf_state->flag_stable_avg == true)
-    {
-        int64_t error_p = ((int64_t)Kp * (int64_t)(long_term_buf_state->avg_buffer_level - long_term_buf_state->stable_avg_level));
-
-        total_error = (int64_t)(error_p << 8);
-        if(total_error > max_allowed_correction)
-        {
-            total_error = max_allowed_correction;
-        }
-        else if(total_error < -(max_allowed_correction))
-        {
-            total_error = -(max_allowed_correction);
-        }
-    }
-
-    return total_error;
-
-}
-
 void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved samples [samps][ch] format
                     size_t frame_count,
                     size_t num_chans)
@@ -349,25 +301,18 @@ void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved
     static uint32_t num_dummy_writes = 0;
     static buffer_calc_state_t long_term_buf_state;
     static buffer_calc_state_t short_term_buf_state;
+    static pi_control_state_t usb_buf_pi_state;
 #if CHECK_SAMPLES_TO_HOST_BUF_WRITE_TIME
     static uint32_t prev_ts = 0;
 #endif
 
     samp_t usb_audio_in_frame[I2S_TO_USB_ASRC_BLOCK_LENGTH * 2][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX];
-#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
-    const int src_32_shift = 16;
-#elif CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 4
-    const int src_32_shift = 0;
-#endif
 
+    xassert(num_chans == CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX);
     memset(usb_audio_in_frame, 0, sizeof(usb_audio_in_frame));
-    for (int i = 0; i < frame_count; i++)
-    {
-        for (int ch = 0; ch < num_chans; ch++)
-        {
-            usb_audio_in_frame[i][ch] = (volume_scale(vol_mul_d2h[ch % CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX], frame_buffer_ptr[i * 2 + ch])) >> src_32_shift;
-        }
-    }
+    // Picks up any volume change made by the host since the last block
+    audio_gain_ramp_set_targets(&gain_ramp_d2h, vol_mul_d2h);
+    audio_gain_ramp_pack_interleaved(&gain_ramp_d2h, usb_audio_in_frame, USB_AUDIO_SAMP_FORMAT, frame_buffer_ptr, frame_count);
     size_t usb_audio_in_size_bytes = frame_count * num_chans * sizeof(samp_t);
 
     usb_rate_info_t usb_rate_info;
@@ -388,6 +333,7 @@ void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved
             int32_t window_len_log2 = get_avg_window_size_log2(current_i2s_rate);
             init_calc_buffer_level_state(&long_term_buf_state, window_len_log2, 4);
             init_calc_buffer_level_state(&short_term_buf_state, 9, 4);
+            init_usb_buffer_pi_control_state(&usb_buf_pi_state, current_i2s_rate);
 
             rtos_printf("I2S SR change detected in usb_audio_send(). prev SR %d, new SR %d\n", prev_i2s_sampling_rate, current_i2s_rate);
             // Set this flag and wait for it to be cleared from tud_audio_tx_done_pre_load_cb(), which it will, after resetting the samples_to_host_stream_buf. We wait
@@ -420,7 +366,11 @@ void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved
 
 #endif
                     usb_rate_info.samples_to_host_buf_fill_level = usb_buffer_level_from_half;
-                    usb_rate_info.buffer_based_correction = calc_usb_buffer_based_correction(current_i2s_rate, &long_term_buf_state, &short_term_buf_state);
+                    usb_rate_info.buffer_based_correction = calc_usb_buffer_based_correction(&usb_buf_pi_state,
+                                                                    long_term_buf_state.flag_stable_avg,
+                                                                    long_term_buf_state.avg_buffer_level - long_term_buf_state.stable_avg_level,
+                                                                    short_term_buf_state.flag_stable_avg,
+                                                                    short_term_buf_state.avg_buffer_level);
                     intertile_send = true; // Trigger rate monitoring on the other tile
                 }
             }
@@ -440,40 +390,45 @@ void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved
     }
     if(intertile_send == true)
     {
-        usb_rate_info.usb_data_rate = (float_s32_t){0,0};
-        if((usb_rate_info.spkr_itf_open) && (g_usb_rate_calc_info[TUSB_DIR_OUT].total_ticks != 0)) // Calculate rate from the TUSB_DIR_OUT if spkr_itf is open otherwise calculate from the TUSB_DIR_IN direction
+        usb_rate_info.usb_rate = (rate_info_t){0,0};
+        if((usb_rate_info.spkr_itf_open) && (g_usb_rate_calc_info[TUSB_DIR_OUT].ticks != 0)) // Calculate rate from the TUSB_DIR_OUT if spkr_itf is open otherwise calculate from the TUSB_DIR_IN direction
         {
-            usb_rate_info.usb_data_rate = float_div((float_s32_t){g_usb_rate_calc_info[TUSB_DIR_OUT].total_data_samples, 0}, (float_s32_t){g_usb_rate_calc_info[TUSB_DIR_OUT].total_ticks, 0});
+            usb_rate_info.usb_rate = g_usb_rate_calc_info[TUSB_DIR_OUT];
         }
-        else if(usb_rate_info.mic_itf_open && g_usb_rate_calc_info[TUSB_DIR_IN].total_ticks != 0)
+        else if(usb_rate_info.mic_itf_open && g_usb_rate_calc_info[TUSB_DIR_IN].ticks != 0)
         {
-            usb_rate_info.usb_data_rate = float_div((float_s32_t){g_usb_rate_calc_info[TUSB_DIR_IN].total_data_samples, 0}, (float_s32_t){g_usb_rate_calc_info[TUSB_DIR_IN].total_ticks, 0});
+            usb_rate_info.usb_rate = g_usb_rate_calc_info[TUSB_DIR_IN];
         }
 
-        i2s_to_usb_rate_info_t i2s_rate_info;
-        size_t bytes_received;
-
-        rtos_intertile_tx(
-        intertile_ctx,
-            appconfUSB_RATE_NOTIFY_PORT,
-            &usb_rate_info,
-            sizeof(usb_rate_info));
-
-
-        bytes_received = rtos_intertile_rx_len(
-            intertile_ctx,
-            appconfUSB_RATE_NOTIFY_PORT,
-            portMAX_DELAY);
-        xassert(bytes_received == sizeof(i2s_rate_info));
-
-        rtos_intertile_rx_data(
-            intertile_ctx,
-            &i2s_rate_info,
-            bytes_received);
-
-        // Update ratio only when both rates are valid
-        g_usb_to_i2s_rate_ratio = i2s_rate_info.usb_to_i2s_rate_ratio;
-
+#if PROFILE_ASRC
+        static uint32_t max_rate_info_time = 0;
+        uint32_t start = get_reference_time();
+#endif
+        // Hand the rate info to usb_audio_out_asrc, which sends it to the rate server on the I2S tile in the header of the
+        // next USB -> I2S audio block. The resulting usb_to_i2s rate ratio comes back in the header of a later I2S -> USB
+        // block, so this never waits for the other tile. If the speaker path isn't sending blocks, shown by the previous
+        // rate info still being in the mailbox, send it in a message of its own instead.
+        usb_rate_info_t unsent_rate_info;
+        if((spkr_interface_open == false) || (xQueueReceive(usb_rate_info_mailbox, &unsent_rate_info, 0) == pdTRUE))
+        {
+            asrc_msg_header_t rate_info_msg;
+            asrc_msg_init_header(&rate_info_msg, 0);
+            asrc_msg_attach_usb_rate_info(&rate_info_msg, &usb_rate_info);
+            asrc_msg_send(&usb_to_i2s_transport, &rate_info_msg, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, 0);
+        }
+        else
+        {
+            (void)xQueueOverwrite(usb_rate_info_mailbox, &usb_rate_info);
+        }
+#if PROFILE_ASRC
+        uint32_t end = get_reference_time();
+        if(max_rate_info_time < (end - start))
+        {
+            max_rate_info_time = end - start;
+            printchar('r');
+            printuintln(max_rate_info_time);
+        }
+#endif
     }
 }
 
@@ -482,24 +437,18 @@ void usb_audio_send(int32_t *frame_buffer_ptr, // buffer containing interleaved
  * @brief Task that performs ASRC on the USB OUT data and send the ASRC output frame to the I2S tile
  *
  * Runs on the USB tile.
- * @param arg Handle to the intertile ctx over which ASRC output is sent to the I2S tile
+ * @param arg Transport over which ASRC output is sent to the I2S tile
  */
 void usb_audio_out_asrc(void *arg)
 {
+    const asrc_msg_transport_t *transport = (const asrc_msg_transport_t *)arg;
 
-#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
-    const int src_32_shift = 16;
-#elif CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 4
-    const int src_32_shift = 0;
-#endif
-
-    rtos_intertile_t *intertile_ctx = (rtos_intertile_t *)arg;
-
-    // Initialise channel 0 ASRC instance
+    // 1 ASRC instance per channel. Each ASRC instance processes one channel
     asrc_state_t asrc_state[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][ASRC_CHANNELS_PER_INSTANCE];                                               // ASRC state machine state
     int asrc_stack[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][ASRC_CHANNELS_PER_INSTANCE][ASRC_STACK_LENGTH_MULT * USB_TO_I2S_ASRC_BLOCK_LENGTH]; // Buffer between filter stages
     asrc_ctrl_t asrc_ctrl[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][ASRC_CHANNELS_PER_INSTANCE];                                                 // Control structure
     asrc_adfir_coefs_t asrc_adfir_coefs[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX];
+    asrc_ctrl_t *asrc_ctrl_ptrs[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX];
 
     for (int ch = 0; ch < CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX; ch++)
     {
@@ -510,44 +459,40 @@ void usb_audio_out_asrc(void *arg)
             asrc_ctrl[ch][ui].piStack = asrc_stack[ch][ui];
             asrc_ctrl[ch][ui].piADCoefs = asrc_adfir_coefs[ch].iASRCADFIRCoefs;
         }
+        asrc_ctrl_ptrs[ch] = &asrc_ctrl[ch][0];
     }
 
-    // Initialise ASRC
-    //  Create init ctx for the ch1 asrc running in another thread
-    asrc_init_t asrc_init_ctx;
-    asrc_init_ctx.fs_in = appconfUSB_AUDIO_SAMPLE_RATE;
-    asrc_init_ctx.fs_out = 0; // Will be notified at runtime
-    asrc_init_ctx.n_in_samples = USB_TO_I2S_ASRC_BLOCK_LENGTH;
-    asrc_init_ctx.asrc_ctrl_ptr = &asrc_ctrl[1][0];
-    (void)rtos_osal_queue_create(&asrc_init_ctx.asrc_queue, "asrc_q", 1, sizeof(asrc_process_frame_ctx_t *));
-    (void)rtos_osal_queue_create(&asrc_init_ctx.asrc_ret_queue, "asrc_ret_q", 1, sizeof(int));
-
-    rtos_osal_thread_t asrc_ch1_thread;
-
-    // Create 2nd channel ASRC task
-    (void)rtos_osal_thread_create(
-        (rtos_osal_thread_t *)&asrc_ch1_thread,
-        (char *)"ASRC_1ch",
-        (rtos_osal_entry_function_t)asrc_one_channel_task,
-        (void *)(&asrc_init_ctx),
-        (size_t)RTOS_THREAD_STACK_SIZE(asrc_one_channel_task),
-        (unsigned int)appconfAUDIO_PIPELINE_TASK_PRIORITY);
-
-    fs_code_t in_fs_code;
-    fs_code_t out_fs_code;
+    // Spread the channels across this thread and appconfUSB_TO_I2S_ASRC_NUM_WORKERS-1 worker threads
+    asrc_pool_t asrc_pool;
+    asrc_pool_init(&asrc_pool, asrc_ctrl_ptrs, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, appconfUSB_TO_I2S_ASRC_NUM_WORKERS, USB_TO_I2S_ASRC_BLOCK_LENGTH, appconfAUDIO_PIPELINE_TASK_PRIORITY);
+#if appconfASRC_BYPASS_ENABLED
+    asrc_pool_enable_bypass(&asrc_pool, ASRC_BYPASS_DEFAULT_MAX_DEVIATION);
+#endif
+
     uint64_t nominal_fs_ratio;
 #if PROFILE_ASRC
     uint32_t max_time = 0;
 #endif
 
     int32_t frame_samples[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][USB_TO_I2S_ASRC_BLOCK_LENGTH * 4 + USB_TO_I2S_ASRC_BLOCK_LENGTH];             // TODO calculate size properly
-    int32_t frame_samples_interleaved[USB_TO_I2S_ASRC_BLOCK_LENGTH * 4 + USB_TO_I2S_ASRC_BLOCK_LENGTH][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX]; // TODO calculate size properly
-
+    // The ASRC output is interleaved straight into the message sent to the I2S tile, after the header
+    struct
+    {
+        asrc_msg_header_t hdr;
+        int32_t frames[USB_TO_I2S_ASRC_BLOCK_LENGTH * 4 + USB_TO_I2S_ASRC_BLOCK_LENGTH][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX]; // TODO calculate size properly
+    }usb_to_i2s_msg;
+
+    // Double buffered so that, on a switch, the previous block can be used to prime the new ASRC instances
+    int32_t usb_audio_out_frame_deinterleaved[2][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][USB_TO_I2S_ASRC_BLOCK_LENGTH];
+    unsigned cur_block = 0;
+    bool prev_block_valid = false;
     asrc_process_frame_ctx_t asrc_ctx;
+    asrc_ctx.output_samples = &frame_samples[0][0];
+    asrc_ctx.input_stride = USB_TO_I2S_ASRC_BLOCK_LENGTH;
+    asrc_ctx.output_stride = USB_TO_I2S_ASRC_BLOCK_LENGTH * 4 + USB_TO_I2S_ASRC_BLOCK_LENGTH;
     for (;;)
     {
         samp_t usb_audio_out_frame[USB_TO_I2S_ASRC_BLOCK_LENGTH][CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX];
-        int32_t usb_audio_out_frame_deinterleaved[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX][USB_TO_I2S_ASRC_BLOCK_LENGTH];
         size_t bytes_received = 0;
 
         /*
@@ -556,26 +501,35 @@ void usb_audio_out_asrc(void *arg)
          */
         (void)ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
         bytes_received = xStreamBufferReceive(samples_from_host_stream_buf, usb_audio_out_frame, sizeof(usb_audio_out_frame), 0);
+
+#if PROFILE_ASRC
+        uint32_t start = get_reference_time();
+#endif
+
+        // Deinterleave every block, even when it's dropped below, so the previous block is always available for priming
+        cur_block ^= 1;
+        audio_gain_ramp_set_targets(&gain_ramp_h2d, vol_mul_h2d);
+        audio_gain_ramp_unpack_deinterleave(&gain_ramp_h2d, &usb_audio_out_frame_deinterleaved[cur_block][0][0], USB_TO_I2S_ASRC_BLOCK_LENGTH,
+                                            usb_audio_out_frame, USB_AUDIO_SAMP_FORMAT, USB_TO_I2S_ASRC_BLOCK_LENGTH);
+        asrc_ctx.input_samples = &usb_audio_out_frame_deinterleaved[cur_block][0][0];
+        asrc_ctx.prev_input_samples = prev_block_valid ? &usb_audio_out_frame_deinterleaved[cur_block ^ 1][0][0] : NULL;
+        prev_block_valid = true;
+
         uint32_t current_i2s_rate = get_i2s_nominal_sampling_rate();
 
         if(current_i2s_rate == 0)
         {
             continue;
         }
-        if (asrc_init_ctx.fs_out != current_i2s_rate)
+        if (asrc_pool.fs_out != current_i2s_rate)
         {
-            // Time to initialise asrc
             g_usb_to_i2s_rate_ratio = (uint64_t)0;
-            asrc_init_ctx.fs_out = current_i2s_rate;
-            in_fs_code = samp_rate_to_code(asrc_init_ctx.fs_in); // Sample rate code 0..5
-            out_fs_code = samp_rate_to_code(asrc_init_ctx.fs_out);
-            rtos_printf("USB tile initialising ASRC for fs_in %lu, fs_out %lu\n", asrc_init_ctx.fs_in, asrc_init_ctx.fs_out);
-
-            // Initialise both channel ASRCs
-            nominal_fs_ratio = asrc_init(in_fs_code, out_fs_code, &asrc_ctrl[0][0], ASRC_CHANNELS_PER_INSTANCE, asrc_init_ctx.n_in_samples, ASRC_DITHER_SETTING);
-            nominal_fs_ratio = asrc_init(in_fs_code, out_fs_code, &asrc_ctrl[1][0], ASRC_CHANNELS_PER_INSTANCE, asrc_init_ctx.n_in_samples, ASRC_DITHER_SETTING);
-            // Skip this frame since we're too late anayway from 2 asrc_init() calls, each taking 12500 cycles
-            continue;
+            rtos_printf("USB tile switching ASRC to fs_in %lu, fs_out %lu\n", (uint32_t)appconfUSB_AUDIO_SAMPLE_RATE, current_i2s_rate);
+
+            // The pool reinitialises all channel ASRCs in parallel as part of processing this frame, primed with the
+            // previous USB block, which is at the same USB rate as this one, and crossfades from the old ASRC instances
+            // carried on over this frame. So there's no need to skip this frame.
+            nominal_fs_ratio = asrc_pool_switch_rates(&asrc_pool, appconfUSB_AUDIO_SAMPLE_RATE, current_i2s_rate);
         }
 
         uint64_t current_rate_ratio = nominal_fs_ratio;
@@ -584,50 +538,10 @@ void usb_audio_out_asrc(void *arg)
             current_rate_ratio = g_usb_to_i2s_rate_ratio;
         }
 
-#if PROFILE_ASRC
-        uint32_t start = get_reference_time();
-#endif
-
-        for (int ch = 0; ch < CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX; ch++)
-        {
-            for (int i = 0; i < USB_TO_I2S_ASRC_BLOCK_LENGTH; i++)
-            {
-                usb_audio_out_frame_deinterleaved[ch][i] = usb_audio_out_frame[i][ch] << src_32_shift;
-                // This is taking 4 MIPS. Can be optimised if needed.
-                usb_audio_out_frame_deinterleaved[ch][i] = volume_scale(vol_mul_h2d[ch % CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX], usb_audio_out_frame_deinterleaved[ch][i]);
-            }
-        }
-
-        // Send to the other channel ASRC task
-        asrc_ctx.input_samples = &usb_audio_out_frame_deinterleaved[1][0];
-        asrc_ctx.output_samples = &frame_samples[1][0];
         asrc_ctx.fs_ratio = current_rate_ratio;
-        asrc_process_frame_ctx_t *ptr = &asrc_ctx;
-
-
-        (void)rtos_osal_queue_send(&asrc_init_ctx.asrc_queue, &ptr, RTOS_OSAL_WAIT_FOREVER);
-
-        // Call asrc on this block of samples. Reuse frame_samples now that its copied into aec_reference_audio_samples
-
-        unsigned n_samps_out = asrc_process((int *)&usb_audio_out_frame_deinterleaved[0][0], (int *)&frame_samples[0][0], current_rate_ratio, &asrc_ctrl[0][0]);
-
+        unsigned n_samps_out = asrc_pool_process(&asrc_pool, &asrc_ctx);
 
-        unsigned n_samps_out_ch1;
-        rtos_osal_queue_receive(&asrc_init_ctx.asrc_ret_queue, &n_samps_out_ch1, RTOS_OSAL_WAIT_FOREVER);
-
-        if (n_samps_out != n_samps_out_ch1)
-        {
-            rtos_printf("Error: USB to I2S ASRC. ch0 and ch1 returned different number of samples: ch0 %u, ch1 %u\n", n_samps_out, n_samps_out_ch1);
-            xassert(0);
-        }
-
-        for (int ch = 0; ch < CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX; ch++)
-        {
-            for (int i = 0; i < n_samps_out; i++)
-            {
-                frame_samples_interleaved[i][ch] = frame_samples[ch][i];
-            }
-        }
+        audio_format_interleave(&usb_to_i2s_msg.frames[0][0], &frame_samples[0][0], asrc_ctx.output_stride, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, n_samps_out);
 #if PROFILE_ASRC
         uint32_t end = get_reference_time();
         if(max_time < (end - start))
@@ -638,17 +552,21 @@ void usb_audio_out_asrc(void *arg)
         }
 #endif
 
+        // Pick up the latest rate info from usb_audio_send, if there's any it hasn't sent yet
+        usb_rate_info_t usb_rate_info;
+        asrc_msg_init_header(&usb_to_i2s_msg.hdr, 0);
+        if(xQueueReceive(usb_rate_info_mailbox, &usb_rate_info, 0) == pdTRUE)
+        {
+            asrc_msg_attach_usb_rate_info(&usb_to_i2s_msg.hdr, &usb_rate_info);
+        }
+
         /*
          * This shouldn't normally be zero, but it could be possible that
          * the stream buffer is reset after this task has been notified.
          */
-        if (n_samps_out > 0)
+        if ((n_samps_out > 0) || (usb_to_i2s_msg.hdr.flags != 0))
         {
-            rtos_intertile_tx(
-                intertile_ctx,
-                appconfUSB_AUDIO_PORT,
-                frame_samples_interleaved,
-                n_samps_out * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX * sizeof(int32_t));
+            asrc_msg_send(transport, &usb_to_i2s_msg.hdr, CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, n_samps_out);
         }
     }
 }
@@ -1307,42 +1225,31 @@ static void i2s_to_usb_intertile(void *args)
     // less than I2S_TO_USB_ASRC_BLOCK_LENGTH except for the 44.1 -> 48 case, so we let this decide the buffer size.
     (void) args;
     #define BUFFER_SIZE (((I2S_TO_USB_ASRC_BLOCK_LENGTH * 48000)/44100) + 10) // +1 should be enough but just in case
-    int32_t i2s_to_usb_samps_interleaved[BUFFER_SIZE][NUM_I2S_CHANS];
-    uint32_t i2s_nominal_sampling_rate;
-
+    struct
+    {
+        asrc_msg_header_t hdr;
+        int32_t frames[BUFFER_SIZE][NUM_I2S_CHANS];
+    }i2s_to_usb_msg;
+    asrc_msg_transport_t i2s_to_usb_transport;
+    asrc_msg_rtos_transport_init(&i2s_to_usb_transport, intertile_i2s_audio_ctx, appconfAUDIOPIPELINE_PORT);
 
     for(;;)
     {
-        size_t bytes_received;
-        // Get I2S nominal sampling rate from I2S tile to USB tile
-        bytes_received = rtos_intertile_rx_len(
-                intertile_i2s_audio_ctx,
-                appconfAUDIOPIPELINE_PORT,
-                portMAX_DELAY);
-        xassert(bytes_received <= sizeof(i2s_nominal_sampling_rate));
-
-        rtos_intertile_rx_data(
-                    intertile_i2s_audio_ctx,
-                    &i2s_nominal_sampling_rate,
-                    bytes_received);
-
-        update_i2s_nominal_sampling_rate(i2s_nominal_sampling_rate);
-
-        // Get the ASRC output data
-        bytes_received = rtos_intertile_rx_len(
-                intertile_i2s_audio_ctx,
-                appconfAUDIOPIPELINE_PORT,
-                portMAX_DELAY);
-
-        if (bytes_received > 0) {
-            xassert(bytes_received <= sizeof(i2s_to_usb_samps_interleaved));
-
-            rtos_intertile_rx_data(
-                    intertile_i2s_audio_ctx,
-                    i2s_to_usb_samps_interleaved,
-                    bytes_received);
-
-            usb_audio_send(&i2s_to_usb_samps_interleaved[0][0], (bytes_received >> 3), 2);
+        // Get the I2S nominal sampling rate, the ASRC output data and, every so often, the usb_to_i2s rate ratio from
+        // the rate server, all in one message
+        unsigned num_frames;
+        bool msg_ok = asrc_msg_recv(&i2s_to_usb_transport, &i2s_to_usb_msg.hdr, sizeof(i2s_to_usb_msg), NUM_I2S_CHANS, &num_frames);
+        xassert(msg_ok);
+
+        update_i2s_nominal_sampling_rate(i2s_to_usb_msg.hdr.i2s_nominal_rate);
+
+        if(i2s_to_usb_msg.hdr.flags & ASRC_MSG_HAS_I2S_RATE_INFO)
+        {
+            g_usb_to_i2s_rate_ratio = i2s_to_usb_msg.hdr.i2s_rate_info.usb_to_i2s_rate_ratio;
+        }
+
+        if (num_frames > 0) {
+            usb_audio_send(&i2s_to_usb_msg.frames[0][0], num_frames, NUM_I2S_CHANS);
         }
 
     }
@@ -1383,7 +1290,10 @@ void usb_audio_init(rtos_intertile_t *intertile_ctx,
 
     samples_to_host_stream_buf = xStreamBufferCreate(samples_to_host_stream_buf_size_bytes, 0);
 
-    xTaskCreate((TaskFunction_t)usb_audio_out_asrc, "usb_audio_out_asrc", portTASK_STACK_DEPTH(usb_audio_out_asrc), intertile_ctx, priority, &usb_audio_out_asrc_handle);
+    usb_rate_info_mailbox = xQueueCreate(1, sizeof(usb_rate_info_t));
+    asrc_msg_rtos_transport_init(&usb_to_i2s_transport, intertile_ctx, appconfUSB_AUDIO_PORT);
+
+    xTaskCreate((TaskFunction_t)usb_audio_out_asrc, "usb_audio_out_asrc", portTASK_STACK_DEPTH(usb_audio_out_asrc), &usb_to_i2s_transport, priority, &usb_audio_out_asrc_handle);
 
 
     // Task for receiving audio from the i2s to usb tile
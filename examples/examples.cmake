@@ -20,4 +20,10 @@ else()
 
     add_subdirectory(modules/xscope_fileio/xscope_fileio/host)
     install(TARGETS xscope_host_endpoint DESTINATION ${HOST_INSTALL_DIR})
+
+    include(${CMAKE_CURRENT_LIST_DIR}/ffva/host/dfu_delta_mkimage/dfu_delta_mkimage.cmake)
+    install(TARGETS dfu_delta_mkimage DESTINATION ${HOST_INSTALL_DIR})
+
+    include(${CMAKE_CURRENT_LIST_DIR}/ffva/host/dfu_lz_mkimage/dfu_lz_mkimage.cmake)
+    install(TARGETS dfu_lz_mkimage DESTINATION ${HOST_INSTALL_DIR})
 endif()
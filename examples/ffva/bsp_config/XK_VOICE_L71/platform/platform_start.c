@@ -19,8 +19,6 @@
 #include "servicer.h"
 #include "device_control_i2c.h"
 
-extern void i2s_rate_conversion_enable(void);
-
 static void gpio_start(void)
 {
     rtos_gpio_rpc_config(gpio_ctx_t0, appconfGPIO_T0_RPC_PORT, appconfGPIO_RPC_PRIORITY);
@@ -115,16 +113,12 @@ static void i2s_start(void)
     rtos_i2s_rpc_config(i2s_ctx, appconfI2S_RPC_PORT, appconfI2S_RPC_PRIORITY);
 #endif
 #if ON_TILE(I2S_TILE_NO)
-    if (appconfI2S_AUDIO_SAMPLE_RATE == 3*appconfAUDIO_PIPELINE_SAMPLE_RATE) {
-        i2s_rate_conversion_enable();
-    }
-
     rtos_i2s_start(
             i2s_ctx,
             rtos_i2s_mclk_bclk_ratio(appconfAUDIO_CLOCK_FREQUENCY, appconfI2S_AUDIO_SAMPLE_RATE),
             I2S_MODE_I2S,
-            2.2 * appconfAUDIO_PIPELINE_FRAME_ADVANCE,
-            1.2 * appconfAUDIO_PIPELINE_FRAME_ADVANCE * (appconfI2S_TDM_ENABLED ? 3 : 1),
+            2.2 * appconfI2S_FRAME_ADVANCE,
+            1.2 * appconfI2S_FRAME_ADVANCE,
             appconfI2S_INTERRUPT_CORE);
 #endif
 #endif
@@ -8,6 +8,8 @@ set(APP_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/src
     ${CMAKE_CURRENT_LIST_DIR}/src/control
     ${CMAKE_CURRENT_LIST_DIR}/src/dfu_int
+    ${CMAKE_CURRENT_LIST_DIR}/src/telemetry
+    ${CMAKE_CURRENT_LIST_DIR}/src/tuning
     ${CMAKE_CURRENT_LIST_DIR}/src/usb
 )
 
@@ -48,6 +50,7 @@ set(APP_COMMON_LINK_LIBRARIES
     rtos::sw_services::device_control
     lib_src
     lib_sw_pll
+    sln_voice::app::audio_format
 )
 
 #**********************
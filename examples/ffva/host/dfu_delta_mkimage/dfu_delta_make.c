@@ -0,0 +1,121 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfu_delta_make.h"
+
+#define MAX_RECORD_COUNT    (0xFFFF)
+
+typedef struct {
+    uint8_t *delta;
+    size_t len;
+    dfu_delta_record_t record;      // Record being extended, count 0 if none
+    size_t record_pos;              // Offset of record in delta
+} delta_writer_t;
+
+static void flush_record(delta_writer_t *w)
+{
+    if (w->record.count > 0) {
+        dfu_delta_write_record(&w->delta[w->record_pos], &w->record);
+        w->record.count = 0;
+    }
+}
+
+/* Adds a sector to the current record if it continues it, or starts a new record */
+static void add_sector(delta_writer_t *w, dfu_delta_op_t op, unsigned src)
+{
+    int continues = (w->record.count > 0) && (w->record.count < MAX_RECORD_COUNT) && (w->record.op == op) &&
+                    ((op != DFU_DELTA_OP_COPY) || (w->record.src + w->record.count == src));
+    if (!continues) {
+        flush_record(w);
+        w->record.op = op;
+        w->record.src = (op == DFU_DELTA_OP_COPY) ? src : 0;
+        w->record.reserved = 0;
+        w->record_pos = w->len;
+        w->len += DFU_DELTA_RECORD_SIZE;
+    }
+    w->record.count++;
+}
+
+static size_t sector_len(size_t len, unsigned sector)
+{
+    size_t offset = (size_t)sector * DFU_DELTA_SECTOR_SIZE;
+    return (len - offset < DFU_DELTA_SECTOR_SIZE) ? len - offset : DFU_DELTA_SECTOR_SIZE;
+}
+
+/* Returns the factory sector holding the len bytes of data, preferring same_sector, or -1 if there isn't one */
+static int find_factory_sector(const uint8_t *factory, size_t factory_len, const uint32_t *factory_crcs,
+                               const uint8_t *data, size_t len, unsigned same_sector)
+{
+    unsigned factory_sectors = factory_len / DFU_DELTA_SECTOR_SIZE;
+    uint32_t crc = dfu_delta_crc32(0, data, len);
+
+    for (unsigned i = 0; i < factory_sectors; i++) {
+        unsigned sector = (same_sector + i) % factory_sectors;
+        /* A short last sector of the new image can only match on its own bytes, so it can't use the CRC */
+        if (((len < DFU_DELTA_SECTOR_SIZE) || (factory_crcs[sector] == crc)) &&
+            (memcmp(&factory[sector * DFU_DELTA_SECTOR_SIZE], data, len) == 0)) {
+            return sector;
+        }
+    }
+    return -1;
+}
+
+size_t dfu_delta_max_size(size_t image_len)
+{
+    /* At worst every sector starts a new record */
+    return DFU_DELTA_HEADER_SIZE +
+           DFU_DELTA_RECORD_SIZE * ((image_len + DFU_DELTA_SECTOR_SIZE - 1) / DFU_DELTA_SECTOR_SIZE) + image_len;
+}
+
+size_t dfu_delta_make(uint8_t *delta,
+                      const uint8_t *image, size_t image_len,
+                      const uint8_t *current, size_t current_len,
+                      const uint8_t *factory, size_t factory_len,
+                      dfu_delta_stats_t *stats)
+{
+    delta_writer_t w = { .delta = delta, .len = DFU_DELTA_HEADER_SIZE };
+    dfu_delta_stats_t s = { .sectors = (image_len + DFU_DELTA_SECTOR_SIZE - 1) / DFU_DELTA_SECTOR_SIZE };
+    dfu_delta_header_t header = {
+        .magic = DFU_DELTA_MAGIC,
+        .image_size = image_len,
+        .image_crc = dfu_delta_crc32(0, image, image_len),
+    };
+    unsigned factory_sectors = (factory != NULL) ? factory_len / DFU_DELTA_SECTOR_SIZE : 0;
+    uint32_t *factory_crcs = calloc(factory_sectors + 1, sizeof(uint32_t));
+
+    for (unsigned i = 0; i < factory_sectors; i++) {
+        factory_crcs[i] = dfu_delta_crc32(0, &factory[i * DFU_DELTA_SECTOR_SIZE], DFU_DELTA_SECTOR_SIZE);
+    }
+
+    dfu_delta_write_header(delta, &header);
+    for (unsigned sector = 0; sector < s.sectors; sector++) {
+        const uint8_t *data = &image[sector * DFU_DELTA_SECTOR_SIZE];
+        size_t len = sector_len(image_len, sector);
+        size_t offset = (size_t)sector * DFU_DELTA_SECTOR_SIZE;
+        int src = -1;
+
+        if ((current != NULL) && (offset + len <= current_len) && (memcmp(&current[offset], data, len) == 0)) {
+            add_sector(&w, DFU_DELTA_OP_KEEP, 0);
+            s.kept++;
+        } else if ((factory_sectors > 0) &&
+                   ((src = find_factory_sector(factory, factory_len, factory_crcs, data, len, sector)) >= 0)) {
+            add_sector(&w, DFU_DELTA_OP_COPY, src);
+            s.copied++;
+        } else {
+            add_sector(&w, DFU_DELTA_OP_DATA, 0);
+            /* The sectors of a data record follow it */
+            memcpy(&delta[w.len], data, len);
+            w.len += len;
+            s.sent++;
+        }
+    }
+    flush_record(&w);
+    free(factory_crcs);
+
+    if (stats != NULL) {
+        *stats = s;
+    }
+    return w.len;
+}
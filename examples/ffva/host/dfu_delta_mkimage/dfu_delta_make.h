@@ -0,0 +1,36 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfu_delta.h"
+
+#define DFU_DELTA_SECTOR_SIZE   (4096)  // DFU_FLASH_SECTOR_SIZE of the device
+
+typedef struct {
+    unsigned sectors;           // Sectors in the new image
+    unsigned kept;              // Sectors already in the partition
+    unsigned copied;            // Sectors copied from the factory image
+    unsigned sent;              // Sectors sent in the delta image
+} dfu_delta_stats_t;
+
+/// @brief Make a delta image
+/// @param delta            Set to the delta image. At most dfu_delta_max_size(image_len) bytes.
+/// @param image            New image
+/// @param image_len        Bytes in image
+/// @param current          Image now in the partition that the delta image will be downloaded to, or NULL if unknown
+/// @param current_len      Bytes in current
+/// @param factory          Factory image on the device, or NULL to not copy from it
+/// @param factory_len      Bytes in factory
+/// @param stats            If not NULL, set to how the sectors of the new image are made
+/// @return size_t          Bytes in the delta image
+size_t dfu_delta_make(uint8_t *delta,
+                      const uint8_t *image, size_t image_len,
+                      const uint8_t *current, size_t current_len,
+                      const uint8_t *factory, size_t factory_len,
+                      dfu_delta_stats_t *stats);
+
+/// @brief Largest delta image for a new image of image_len bytes, when every sector is sent
+size_t dfu_delta_max_size(size_t image_len);
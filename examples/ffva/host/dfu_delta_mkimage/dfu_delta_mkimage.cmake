@@ -0,0 +1,13 @@
+
+# Host tool that makes delta DFU images for the FFVA example
+add_executable(dfu_delta_mkimage
+    ${CMAKE_CURRENT_LIST_DIR}/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/dfu_delta_make.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../src/dfu_int/dfu_delta.c
+)
+
+target_include_directories(dfu_delta_mkimage
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}
+        ${CMAKE_CURRENT_LIST_DIR}/../../src/dfu_int
+)
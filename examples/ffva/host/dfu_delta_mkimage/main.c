@@ -0,0 +1,94 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfu_delta_make.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [--current <file>] [--factory <file>] <new image> <delta image>\n"
+            "\n"
+            "Makes a delta DFU image of <new image>, to download in its place to the same alt setting.\n"
+            "\n"
+            "  --current <file>   Image now in the partition to be written, for example read back with an upload.\n"
+            "                     Sectors that it already has are not sent, erased or programmed.\n"
+            "  --factory <file>   Factory image on the device. Sectors that it has are copied on the device.\n",
+            name);
+    exit(1);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: can't open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len + 1);
+    if ((data == NULL) || (fread(data, 1, *len, f) != *len)) {
+        fprintf(stderr, "Error: can't read %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *current_path = NULL;
+    const char *factory_path = NULL;
+    uint8_t *current = NULL;
+    uint8_t *factory = NULL;
+    size_t current_len = 0;
+    size_t factory_len = 0;
+    size_t image_len;
+    int arg = 1;
+
+    for (; (arg + 1 < argc) && (strncmp(argv[arg], "--", 2) == 0); arg += 2) {
+        if (strcmp(argv[arg], "--current") == 0) {
+            current_path = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--factory") == 0) {
+            factory_path = argv[arg + 1];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (argc - arg != 2) {
+        usage(argv[0]);
+    }
+
+    uint8_t *image = read_file(argv[arg], &image_len);
+    if (current_path != NULL) {
+        current = read_file(current_path, &current_len);
+    }
+    if (factory_path != NULL) {
+        factory = read_file(factory_path, &factory_len);
+    }
+
+    dfu_delta_stats_t stats;
+    uint8_t *delta = malloc(dfu_delta_max_size(image_len));
+    size_t delta_len = dfu_delta_make(delta, image, image_len, current, current_len, factory, factory_len, &stats);
+
+    FILE *f = fopen(argv[arg + 1], "wb");
+    if ((f == NULL) || (fwrite(delta, 1, delta_len, f) != delta_len)) {
+        fprintf(stderr, "Error: can't write %s\n", argv[arg + 1]);
+        return 1;
+    }
+    fclose(f);
+
+    printf("%u sectors: %u kept, %u copied from the factory image, %u sent\n",
+           stats.sectors, stats.kept, stats.copied, stats.sent);
+    printf("Delta image %zu bytes, %.1f%% of the new image\n", delta_len, 100.0 * delta_len / image_len);
+
+    free(delta);
+    free(image);
+    free(current);
+    free(factory);
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfu_lz_compress.h"
+
+#define HASH_BITS       (14)
+#define HASH_SIZE       (1 << HASH_BITS)
+#define MAX_CHAIN       (256)   // Earlier positions with the same hash tried for each match
+#define NO_POS          (-1)
+
+static unsigned hash4(const uint8_t *p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static size_t flush_literals(uint8_t *out, size_t out_len, const uint8_t *literals, size_t count)
+{
+    while (count > 0) {
+        size_t run = (count < DFU_LZ_MAX_LITERALS) ? count : DFU_LZ_MAX_LITERALS;
+        out[out_len++] = run - 1;
+        memcpy(&out[out_len], literals, run);
+        out_len += run;
+        literals += run;
+        count -= run;
+    }
+    return out_len;
+}
+
+size_t dfu_lz_max_compressed_size(size_t len)
+{
+    return len + (len + DFU_LZ_MAX_LITERALS - 1) / DFU_LZ_MAX_LITERALS;
+}
+
+size_t dfu_lz_compress(uint8_t *out, const uint8_t *in, size_t len)
+{
+    /* Greedy matching over hash chains of the positions of each DFU_LZ_MIN_MATCH byte sequence */
+    long *head = malloc(HASH_SIZE * sizeof(long));
+    long *prev = malloc(DFU_LZ_WINDOW_SIZE * sizeof(long));
+    size_t out_len = 0;
+    size_t literal_start = 0;
+    size_t pos = 0;
+
+    for (unsigned i = 0; i < HASH_SIZE; i++) {
+        head[i] = NO_POS;
+    }
+
+    while (pos < len) {
+        size_t best_len = 0;
+        size_t best_dist = 0;
+
+        if (pos + DFU_LZ_MIN_MATCH <= len) {
+            size_t max_len = (len - pos < DFU_LZ_MAX_MATCH) ? len - pos : DFU_LZ_MAX_MATCH;
+            long candidate = head[hash4(&in[pos])];
+            for (unsigned chain = 0; (candidate != NO_POS) && (chain < MAX_CHAIN); chain++) {
+                size_t dist = pos - candidate;
+                if (dist > DFU_LZ_WINDOW_SIZE) {
+                    break;
+                }
+                size_t n = 0;
+                while ((n < max_len) && (in[candidate + n] == in[pos + n])) {
+                    n++;
+                }
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = dist;
+                    if (n == max_len) {
+                        break;
+                    }
+                }
+                candidate = prev[candidate % DFU_LZ_WINDOW_SIZE];
+            }
+        }
+
+        size_t advance = (best_len >= DFU_LZ_MIN_MATCH) ? best_len : 1;
+        if (best_len >= DFU_LZ_MIN_MATCH) {
+            out_len = flush_literals(out, out_len, &in[literal_start], pos - literal_start);
+            out[out_len++] = DFU_LZ_MATCH_FLAG | (best_len - DFU_LZ_MIN_MATCH);
+            out[out_len++] = (best_dist - 1) & 0xFF;
+            out[out_len++] = (best_dist - 1) >> 8;
+            literal_start = pos + best_len;
+        }
+        for (size_t end = pos + advance; pos < end; pos++) {
+            if (pos + DFU_LZ_MIN_MATCH <= len) {
+                unsigned h = hash4(&in[pos]);
+                prev[pos % DFU_LZ_WINDOW_SIZE] = head[h];
+                head[h] = pos;
+            }
+        }
+    }
+    out_len = flush_literals(out, out_len, &in[literal_start], len - literal_start);
+
+    free(head);
+    free(prev);
+    return out_len;
+}
@@ -0,0 +1,18 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfu_lz.h"
+
+/// @brief Compress data for a compressed DFU download, see dfu_lz.h
+/// @param out      Set to the compressed data. At most dfu_lz_max_compressed_size(len) bytes.
+/// @param in       Data to compress
+/// @param len      Bytes in in
+/// @return size_t  Bytes of compressed data
+size_t dfu_lz_compress(uint8_t *out, const uint8_t *in, size_t len);
+
+/// @brief Largest compressed size of len bytes, when nothing matches
+size_t dfu_lz_max_compressed_size(size_t len);
@@ -0,0 +1,12 @@
+
+# Host tool that compresses images for compressed I2C DFU downloads to the FFVA example
+add_executable(dfu_lz_mkimage
+    ${CMAKE_CURRENT_LIST_DIR}/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/dfu_lz_compress.c
+)
+
+target_include_directories(dfu_lz_mkimage
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}
+        ${CMAKE_CURRENT_LIST_DIR}/../../src/dfu_int
+)
@@ -0,0 +1,50 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dfu_lz_compress.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr,
+                "Usage: %s <image> <compressed image>\n"
+                "\n"
+                "Compresses <image> for an I2C DFU download with DFU_PAYLOADFORMAT set to compressed.\n",
+                argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: can't open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *image = malloc(len + 1);
+    if ((image == NULL) || (fread(image, 1, len, f) != len)) {
+        fprintf(stderr, "Error: can't read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    uint8_t *compressed = malloc(dfu_lz_max_compressed_size(len));
+    size_t compressed_len = dfu_lz_compress(compressed, image, len);
+
+    f = fopen(argv[2], "wb");
+    if ((f == NULL) || (fwrite(compressed, 1, compressed_len, f) != compressed_len)) {
+        fprintf(stderr, "Error: can't write %s\n", argv[2]);
+        return 1;
+    }
+    fclose(f);
+
+    printf("%zu bytes compressed to %zu bytes, %.1f%%\n", len, compressed_len,
+           100.0 * compressed_len / len);
+
+    free(image);
+    free(compressed);
+    return 0;
+}
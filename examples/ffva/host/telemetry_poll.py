@@ -0,0 +1,130 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+"""
+Poll the FFVA-INT audio pipeline telemetry over I2C, from a Linux host such as
+a Raspberry Pi, and print it once per poll.
+
+Reads the ALL command of the telemetry resource, 0xF2, which returns every
+value of the same frame. Only the Python standard library is used: the I2C
+transfers are made with the i2c-dev I2C_RDWR ioctl.
+
+Example:
+    python3 telemetry_poll.py --bus 1 --interval 0.5
+"""
+
+import argparse
+import ctypes
+import fcntl
+import struct
+import sys
+import time
+
+I2C_RDWR = 0x0707
+I2C_M_RD = 0x0001
+
+TELEMETRY_SERVICER_RESID = 242
+TELEMETRY_SERVICER_RESID_ALL = 3
+TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES = 68
+
+STAGES = ("AEC", "IC", "NS", "AGC")
+REFERENCE_CLOCK_HZ = 100000000
+
+
+class I2cMsg(ctypes.Structure):
+    _fields_ = [
+        ("addr", ctypes.c_uint16),
+        ("flags", ctypes.c_uint16),
+        ("len", ctypes.c_uint16),
+        ("buf", ctypes.POINTER(ctypes.c_uint8)),
+    ]
+
+
+class I2cRdwrIoctlData(ctypes.Structure):
+    _fields_ = [
+        ("msgs", ctypes.POINTER(I2cMsg)),
+        ("nmsgs", ctypes.c_uint32),
+    ]
+
+
+def read_cmd(fd, address, resid, cmd, payload_len):
+    """Run a device control read command, and return its payload"""
+    read_len = 1 + payload_len  # Status byte, then the payload
+    header = (ctypes.c_uint8 * 3)(resid, cmd | 0x80, read_len)
+    response = (ctypes.c_uint8 * read_len)()
+    msgs = (I2cMsg * 2)(
+        I2cMsg(address, 0, len(header), header),
+        I2cMsg(address, I2C_M_RD, read_len, response),
+    )
+    fcntl.ioctl(fd, I2C_RDWR, I2cRdwrIoctlData(msgs, 2))
+
+    status = response[0]
+    if status != 0:
+        raise IOError(f"command {cmd} of resource {resid} failed, status {status}")
+    return bytes(response[1:])
+
+
+def decode(payload, frame_ticks):
+    """Decode the ALL payload into a dictionary of values in natural units"""
+    words = struct.unpack("<2I7i8I", payload)
+    telemetry = {
+        "frames": words[0],
+        "dropped_frames": words[1],
+        "aec_erle_db": words[2] / 256,
+        "ic_attenuation_db": words[3] / 256,
+        "ns_attenuation_db": words[4] / 256,
+        "agc_gain_db": words[5] / 256,
+        "vnr_input": words[6] / 65536,
+        "vnr_output": words[7] / 65536,
+        "mic_delay_samples": words[8],
+    }
+    for i, stage in enumerate(STAGES):
+        telemetry[f"{stage.lower()}_load"] = words[9 + i] / frame_ticks
+        telemetry[f"{stage.lower()}_peak_load"] = words[13 + i] / frame_ticks
+    return telemetry
+
+
+def print_header():
+    stages = " ".join(f"{stage + ' %':>9} {'peak':>5}" for stage in STAGES)
+    print(f"{'frames':>8} {'dropped':>7} {'ERLE dB':>7} {'IC dB':>6} {'NS dB':>6} {'AGC dB':>6} "
+          f"{'VNR in':>6} {'out':>5} {'delay':>5} {stages}")
+
+
+def print_telemetry(telemetry):
+    stages = " ".join(f"{100 * telemetry[stage.lower() + '_load']:9.1f} "
+                      f"{100 * telemetry[stage.lower() + '_peak_load']:5.1f}" for stage in STAGES)
+    print(f"{telemetry['frames']:8d} {telemetry['dropped_frames']:7d} {telemetry['aec_erle_db']:7.2f} "
+          f"{telemetry['ic_attenuation_db']:6.2f} {telemetry['ns_attenuation_db']:6.2f} "
+          f"{telemetry['agc_gain_db']:6.2f} {telemetry['vnr_input']:6.3f} {telemetry['vnr_output']:5.3f} "
+          f"{telemetry['mic_delay_samples']:5d} {stages}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Poll the FFVA-INT audio pipeline telemetry over I2C")
+    parser.add_argument("--bus", type=int, default=1, help="I2C bus number, for /dev/i2c-<bus>")
+    parser.add_argument("--address", type=lambda x: int(x, 0), default=0x42, help="device I2C address")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between polls")
+    parser.add_argument("--count", type=int, default=0, help="number of polls, or 0 to poll until interrupted")
+    parser.add_argument("--frame-advance", type=int, default=240, help="samples per pipeline frame")
+    parser.add_argument("--sample-rate", type=int, default=16000, help="pipeline sample rate")
+    args = parser.parse_args()
+
+    # Stage times are reported as a percentage of the frame period
+    frame_ticks = args.frame_advance * REFERENCE_CLOCK_HZ / args.sample_rate
+
+    with open(f"/dev/i2c-{args.bus}", "r+b", buffering=0) as i2c:
+        print_header()
+        polls = 0
+        while args.count == 0 or polls < args.count:
+            payload = read_cmd(i2c.fileno(), args.address, TELEMETRY_SERVICER_RESID,
+                               TELEMETRY_SERVICER_RESID_ALL, TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES)
+            print_telemetry(decode(payload, frame_ticks))
+            sys.stdout.flush()
+            polls += 1
+            time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
@@ -29,6 +29,7 @@
 #define appconfWW_SAMPLES_PORT         6
 #define appconfAUDIOPIPELINE_PORT      7
 #define appconfI2S_OUTPUT_SLAVE_PORT   8
+#define appconfAUDIO_PIPELINE_TUNING_PORT 9
 
 #ifndef appconfINTENT_ENGINE_READY_SYNC_PORT
 #define appconfINTENT_ENGINE_READY_SYNC_PORT      18
@@ -174,6 +175,49 @@
 #define appconfI2S_TDM_ENABLED     0
 #endif
 
+/*
+ * TDM slot map, one I2S_TDM_SLOT(channel, lsb_tag) per slot, see
+ * i2s_tdm_output.h. The channel indexes the pipeline output frame:
+ *   0, 1: processed audio
+ *   2, 3: reference audio
+ *   4, 5: raw mic audio
+ * The processed audio slots are tagged with a set LSB, all others with a
+ * clear LSB. Each channel must be below 3 * appconfAUDIO_PIPELINE_CHANNELS,
+ * and there must be 2 slots for every I2S sample per pipeline sample, so 6
+ * slots at 48 KHz. Both are checked at compile time.
+ */
+#ifndef appconfI2S_TDM_SLOT_MAP
+#define appconfI2S_TDM_SLOT_MAP { \
+    I2S_TDM_SLOT(4, 0),     /* mic 0 */  \
+    I2S_TDM_SLOT(5, 0),     /* mic 1 */  \
+    I2S_TDM_SLOT(2, 0),     /* ref 0 */  \
+    I2S_TDM_SLOT(3, 0),     /* ref 1 */  \
+    I2S_TDM_SLOT(0, 1),     /* proc 0 */ \
+    I2S_TDM_SLOT(1, 1),     /* proc 1 */ \
+}
+#endif
+
+/*
+ * Set to 1 to print the maximum number of reference clock ticks spent
+ * sending a frame over I2S in audio_pipeline_output().
+ */
+#ifndef appconfI2S_OUTPUT_PROFILE
+#define appconfI2S_OUTPUT_PROFILE  0
+#endif
+
+/*
+ * When the I2S sampling rate is 3x the pipeline sampling rate, the I2S audio
+ * is converted between the two rates a whole frame at a time by the audio
+ * pipeline input and output functions, see i2s_rate_conversion.h.
+ * appconfI2S_FRAME_ADVANCE is the number of I2S samples per pipeline frame.
+ */
+#define appconfI2S_RATE_CONVERSION_ENABLED (appconfI2S_AUDIO_SAMPLE_RATE == 3*appconfAUDIO_PIPELINE_SAMPLE_RATE)
+#if appconfI2S_RATE_CONVERSION_ENABLED
+#define appconfI2S_FRAME_ADVANCE   (3 * appconfAUDIO_PIPELINE_FRAME_ADVANCE)
+#else
+#define appconfI2S_FRAME_ADVANCE   appconfAUDIO_PIPELINE_FRAME_ADVANCE
+#endif
+
 #ifndef appconfI2S_MODE_MASTER
 #define appconfI2S_MODE_MASTER     0
 #endif
@@ -6,11 +6,15 @@
 #endif
 #include "debug_print.h"
 #include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
 #include <platform.h>
 #include "platform/platform_conf.h"
 #include "device_control_i2c.h"
 #include "servicer.h"
 #include "dfu_servicer.h"
+#include "tuning_servicer.h"
+#include "telemetry_servicer.h"
 
 #if appconfI2C_DFU_ENABLED && ON_TILE(I2C_CTRL_TILE_NO)
 static device_control_t device_control_i2c_ctx_s;
@@ -21,97 +25,234 @@ device_control_t *device_control_ctxs[APP_CONTROL_TRANSPORT_COUNT] = {
 #endif
 
 //-----------------Servicer read write callback functions-----------------------//
-DEVICE_CONTROL_CALLBACK_ATTR
-control_ret_t read_cmd(control_resid_t resid, control_cmd_t cmd, uint8_t *payload, size_t payload_len, void *app_data)
+// Run a read command for one of the servicer's resources. payload[0] is reserved for the status.
+static control_ret_t servicer_dispatch_read(servicer_t *servicer, control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
 {
     control_ret_t ret = CONTROL_SUCCESS;
-    servicer_t *servicer = (servicer_t*)app_data;
 
     // For read commands, payload[0] is reserved from status. So payload_len is one more than the payload_len stored in the resource command map
     payload_len -= 1;
     uint8_t *payload_ptr = &payload[1]; //Excluding the status byte, which is updated later.
 
-    debug_printf("Servicer ID %d on tile %d received READ command %02x for resid %02x\n\t",servicer->id, THIS_XCORE_TILE, cmd, resid);
-    debug_printf("The command is requesting %d bytes\n\t", payload_len);
-
-
-    control_resource_info_t *current_res_info = get_res_info(resid, servicer);
-    xassert(current_res_info != NULL); // This should never happen
     control_cmd_info_t *current_cmd_info;
-    ret = validate_cmd(&current_cmd_info, current_res_info, cmd, payload_ptr, payload_len);
+    ret = validate_cmd(&current_cmd_info, res_info, cmd, payload_ptr, payload_len);
     if(ret != CONTROL_SUCCESS)
     {
         payload[0] = ret; // Update status in byte 0
         return ret;
     }
     // Check if command is for the servicer itself
-    if(current_res_info->resource == servicer->res_info[0].resource)
+    if(res_info->resource == servicer->res_info[0].resource)
     {
-        ret = servicer_read_cmd(current_res_info, cmd, payload_ptr, payload_len);
+        ret = servicer_read_cmd(res_info, cmd, payload_ptr, payload_len);
         payload[0] = ret;
         return ret;
     }
+    payload[0] = CONTROL_ERROR;
     return CONTROL_ERROR;
 }
 
-DEVICE_CONTROL_CALLBACK_ATTR
-control_ret_t write_cmd(control_resid_t resid, control_cmd_t cmd, const uint8_t *payload, size_t payload_len, void *app_data)
+// Run a write command for one of the servicer's resources
+static control_ret_t servicer_dispatch_write(servicer_t *servicer, control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
 {
     control_ret_t ret = CONTROL_SUCCESS;
-    servicer_t *servicer = (servicer_t*)app_data;
-    //debug_printf("Device control WRITE. Servicer ID %d\n\t", servicer->id);
 
-    debug_printf("Servicer ID %d on tile %d received WRITE command %02x for resid %02x\n\t", servicer->id, THIS_XCORE_TILE, cmd, resid);
-    debug_printf("The command has %d bytes\n\t", payload_len);
-
-    control_resource_info_t *current_res_info = get_res_info(resid, servicer);
-    xassert(current_res_info != NULL);
     control_cmd_info_t *current_cmd_info;
-    ret = validate_cmd(&current_cmd_info, current_res_info, cmd, payload, payload_len);
+    ret = validate_cmd(&current_cmd_info, res_info, cmd, payload, payload_len);
     if(ret != CONTROL_SUCCESS)
     {
         return ret;
     }
     // Check if command is for the servicer itself
-    if(current_res_info->resource == servicer->res_info[0].resource)
+    if(res_info->resource == servicer->res_info[0].resource)
     {
-        ret = servicer_write_cmd(current_res_info, cmd, payload, payload_len);
+        ret = servicer_write_cmd(res_info, cmd, payload, payload_len);
         return ret;
     }
     return CONTROL_ERROR;
 }
 
+static bool is_batch_cmd(const servicer_t *servicer, control_resid_t resid, control_cmd_t cmd)
+{
+    return (resid == servicer->res_info[0].resource) && (CONTROL_CMD_CLEAR_READ(cmd) == SERVICER_CMD_BATCH);
+}
+
+// Run each command in a batch list in order, and keep their results for the batch read command. The whole list is
+// checked first, so a list that is cut short or has too long a result runs none of its commands.
+static control_ret_t servicer_batch_write(servicer_t *servicer, const uint8_t *payload, size_t payload_len)
+{
+    size_t pos = 0;
+    size_t result_len = 0;
+
+    servicer->batch_result_len = 0;
+    while(pos < payload_len)
+    {
+        if(payload_len - pos < SERVICER_BATCH_ITEM_HEADER_BYTES)
+        {
+            return CONTROL_DATA_LENGTH_ERROR;
+        }
+        control_cmd_t cmd = payload[pos + 1];
+        uint8_t len = payload[pos + 2];
+        pos += SERVICER_BATCH_ITEM_HEADER_BYTES;
+        if(cmd & 0x80)
+        {
+            result_len += 1 + len;
+        }
+        else
+        {
+            result_len += 1;
+            pos += len;
+        }
+        if((pos > payload_len) || (result_len > SERVICER_BATCH_MAX_BYTES))
+        {
+            return CONTROL_DATA_LENGTH_ERROR;
+        }
+    }
+
+    uint8_t *result = servicer->batch_result;
+    pos = 0;
+    while(pos < payload_len)
+    {
+        control_resid_t resid = payload[pos];
+        control_cmd_t cmd = payload[pos + 1];
+        uint8_t len = payload[pos + 2];
+        pos += SERVICER_BATCH_ITEM_HEADER_BYTES;
+
+        control_resource_info_t *res_info = get_res_info(resid, servicer);
+        if(cmd & 0x80)
+        {
+            memset(result, 0, 1 + len);
+            if(res_info == NULL)
+            {
+                result[0] = SERVICER_RESOURCE_ERROR;
+            }
+            else if(is_batch_cmd(servicer, resid, cmd))
+            {
+                result[0] = SERVICER_WRONG_COMMAND_ID;
+            }
+            else
+            {
+                servicer_dispatch_read(servicer, res_info, cmd, result, 1 + len);
+            }
+            result += 1 + len;
+        }
+        else
+        {
+            if(res_info == NULL)
+            {
+                *result = SERVICER_RESOURCE_ERROR;
+            }
+            else if(is_batch_cmd(servicer, resid, cmd))
+            {
+                *result = SERVICER_WRONG_COMMAND_ID;
+            }
+            else
+            {
+                *result = servicer_dispatch_write(servicer, res_info, cmd, &payload[pos], len);
+            }
+            result += 1;
+            pos += len;
+        }
+    }
+    servicer->batch_result_len = result - servicer->batch_result;
+    debug_printf("Servicer ID %d ran a batch with %d result bytes\n\t", servicer->id, servicer->batch_result_len);
+    return CONTROL_SUCCESS;
+}
+
+// Return the results of the last batch command written. The host reads exactly their length.
+static control_ret_t servicer_batch_read(servicer_t *servicer, uint8_t *payload, size_t payload_len)
+{
+    if(payload_len != 1 + servicer->batch_result_len)
+    {
+        payload[0] = SERVICER_WRONG_COMMAND_LEN;
+        return SERVICER_WRONG_COMMAND_LEN;
+    }
+    memcpy(&payload[1], servicer->batch_result, servicer->batch_result_len);
+    payload[0] = CONTROL_SUCCESS;
+    return CONTROL_SUCCESS;
+}
+
+DEVICE_CONTROL_CALLBACK_ATTR
+control_ret_t read_cmd(control_resid_t resid, control_cmd_t cmd, uint8_t *payload, size_t payload_len, void *app_data)
+{
+    servicer_t *servicer = (servicer_t*)app_data;
+
+    debug_printf("Servicer ID %d on tile %d received READ command %02x for resid %02x\n\t",servicer->id, THIS_XCORE_TILE, cmd, resid);
+    debug_printf("The command is requesting %d bytes\n\t", payload_len - 1);
+
+    if(is_batch_cmd(servicer, resid, cmd))
+    {
+        return servicer_batch_read(servicer, payload, payload_len);
+    }
+
+    control_resource_info_t *current_res_info = get_res_info(resid, servicer);
+    xassert(current_res_info != NULL); // This should never happen
+    return servicer_dispatch_read(servicer, current_res_info, cmd, payload, payload_len);
+}
+
+DEVICE_CONTROL_CALLBACK_ATTR
+control_ret_t write_cmd(control_resid_t resid, control_cmd_t cmd, const uint8_t *payload, size_t payload_len, void *app_data)
+{
+    servicer_t *servicer = (servicer_t*)app_data;
+    //debug_printf("Device control WRITE. Servicer ID %d\n\t", servicer->id);
+
+    debug_printf("Servicer ID %d on tile %d received WRITE command %02x for resid %02x\n\t", servicer->id, THIS_XCORE_TILE, cmd, resid);
+    debug_printf("The command has %d bytes\n\t", payload_len);
+
+    if(is_batch_cmd(servicer, resid, cmd))
+    {
+        return servicer_batch_write(servicer, payload, payload_len);
+    }
+
+    control_resource_info_t *current_res_info = get_res_info(resid, servicer);
+    xassert(current_res_info != NULL);
+    return servicer_dispatch_write(servicer, current_res_info, cmd, payload, payload_len);
+}
+
 // Initialise packet payload pointers to point to valid memory.
 
 
 //-----------------Servicer helper functions-----------------------//
+void servicer_index_init(servicer_t *servicer)
+{
+    memset(servicer->res_index, 0, sizeof(servicer->res_index));
+    xassert(servicer->num_resources < 0x100);
+    for(int res=0; res<servicer->num_resources; res++)
+    {
+        control_resource_info_t *res_info = &servicer->res_info[res];
+        servicer->res_index[res_info->resource] = res + 1;
+
+        memset(res_info->cmd_index, 0, sizeof(res_info->cmd_index));
+        xassert(res_info->command_map.num_commands < 0x100);
+        for(int i=0; i<res_info->command_map.num_commands; i++)
+        {
+            uint8_t cmd_id = res_info->command_map.commands[i].cmd_id;
+            xassert(cmd_id < SERVICER_NUM_CMD_IDS);
+            res_info->cmd_index[cmd_id] = i + 1;
+        }
+    }
+}
+
 // Return a pointer to the control_cmd_info_t structure for a given command ID. Return NULL if command not found in the
 // command map for the resource.
 control_cmd_info_t* get_cmd_info(uint8_t cmd_id, const control_resource_info_t *res_info)
 {
-    for(int i=0; i<res_info->command_map.num_commands; i++)
+    if(cmd_id >= SERVICER_NUM_CMD_IDS || res_info->cmd_index[cmd_id] == 0)
     {
-        if(res_info->command_map.commands[i].cmd_id == cmd_id)
-        {
-            return &res_info->command_map.commands[i];
-        }
+        return NULL;
     }
-    return NULL;
+    return &res_info->command_map.commands[res_info->cmd_index[cmd_id] - 1];
 }
 
 // Return a pointer to the servicer's control_resource_info_t structure for a given resource ID.
 // Return NULL if the resource ID is not found in the list of resources serviced by the servicer.
 control_resource_info_t* get_res_info(control_resid_t resource, const servicer_t *servicer)
 {
-    for(int res=0; res<servicer->num_resources; res++)
+    if(servicer->res_index[resource] == 0)
     {
-        // Get the cmd_info for the current command
-        if(servicer->res_info[res].resource == resource)
-        {
-            return &servicer->res_info[res];
-        }
+        return NULL;
     }
-    return NULL;
+    return &servicer->res_info[servicer->res_index[resource] - 1];
 }
 
 // Validate the command from the host against that commands information in the stored command_map
@@ -149,6 +290,12 @@ control_ret_t servicer_write_cmd(control_resource_info_t *res_info, control_cmd_
         case DFU_CONTROLLER_SERVICER_RESID:
             return dfu_servicer_write_cmd(res_info, cmd, payload, payload_len);
         break;
+        case TUNING_SERVICER_RESID:
+            return tuning_servicer_write_cmd(res_info, cmd, payload, payload_len);
+        break;
+        case TELEMETRY_SERVICER_RESID:
+            return CONTROL_BAD_COMMAND; // Read only
+        break;
     }
     return CONTROL_SUCCESS;
 }
@@ -163,6 +310,12 @@ control_ret_t servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t
         case DFU_CONTROLLER_SERVICER_RESID:
             ret = dfu_servicer_read_cmd(res_info, cmd, payload, payload_len);
             break;
+        case TUNING_SERVICER_RESID:
+            ret = tuning_servicer_read_cmd(res_info, cmd, payload, payload_len);
+            break;
+        case TELEMETRY_SERVICER_RESID:
+            ret = telemetry_servicer_read_cmd(res_info, cmd, payload, payload_len);
+            break;
     }
     return ret;
 }
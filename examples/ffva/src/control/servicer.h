@@ -4,7 +4,7 @@
 #include "device_control.h"
 #include "cmd_map.h"
 
-#define NUM_TILE_0_SERVICERS            (1) // only DFU servicer is used
+#define NUM_TILE_0_SERVICERS            (3) // DFU, audio pipeline tuning and telemetry servicers
 #define NUM_TILE_1_SERVICERS            (0) // no control servicer
 
 extern device_control_t *device_control_i2c_ctx;
@@ -17,11 +17,48 @@ extern device_control_t *device_control_ctxs[1];
  */
 #define CONTROL_CMD_CLEAR_READ(c) ((c) & ~0x80)
 
+/**
+ * Number of command IDs, once the read bit is cleared
+ */
+#define SERVICER_NUM_CMD_IDS (0x80)
+
+/**
+ * Number of resource IDs
+ */
+#define SERVICER_NUM_RES_IDS (0x100)
+
+/**
+ * Command ID of the batch command, directed to the servicer's own resource.
+ *
+ * Writing the batch command runs a list of commands for the servicer's
+ * resources in order, and reading it returns their results. Each item of the
+ * list written is the resource ID, the command ID and a length byte. For a
+ * write command the length is that of the payload that follows, and for a read
+ * command (the read bit set in the command ID) it is the length to read. The
+ * result read back is, for each item in order, its control_ret_t status byte,
+ * followed for a read command by the payload read.
+ */
+#define SERVICER_CMD_BATCH (SHARED_COMMANDS_START_OFFSET)
+
+/**
+ * Bytes in the resource ID, command ID and length of each batch item
+ */
+#define SERVICER_BATCH_ITEM_HEADER_BYTES (3)
+
+/**
+ * Largest batch list, and batch result. The device control I2C transport
+ * sends the length of a command in one byte, so the payload and the command
+ * header must fit in 255 bytes.
+ */
+#define SERVICER_BATCH_MAX_BYTES (250)
+
 // Structure encapsulating all the information about a resource
 typedef struct
 {
     control_resid_t resource;
     command_map_t command_map;
+    // Position in the command map + 1 of each command ID, 0 for IDs not in the map
+    uint8_t cmd_index[SERVICER_NUM_CMD_IDS];
 }control_resource_info_t;
 
 typedef struct {
@@ -31,6 +68,11 @@ typedef struct {
     int32_t num_resources;
     // Resource ID and command map for every resource
     control_resource_info_t *res_info;
+    // Position in res_info + 1 of each resource ID, 0 for resources the servicer doesn't have
+    uint8_t res_index[SERVICER_NUM_RES_IDS];
+    // Result of the last batch command written, read back with the batch read command
+    uint8_t batch_result[SERVICER_BATCH_MAX_BYTES];
+    size_t batch_result_len;
 }servicer_t;
 
 // Servicer device_control callback functions
@@ -63,6 +105,14 @@ extern DEVICE_CONTROL_CALLBACK_ATTR
 control_ret_t write_cmd(control_resid_t resid, control_cmd_t cmd, const uint8_t *payload, size_t payload_len, void *app_data);
 
 // Servicer helper functions
+/**
+ * @brief Index the servicer's resources and their command maps, so that get_res_info() and get_cmd_info() look them
+ * up directly. Called once the resources and command maps are set up, and again if any resource or command ID changes.
+ *
+ * @param servicer      Pointer to the servicer state structure that holds all the resource info objects for the servicer.
+ */
+void servicer_index_init(servicer_t *servicer);
+
 /**
  * @brief Check if a command exists in the command map for a given resource and return the pointer to the cmd info object for the given command
  *
@@ -39,13 +39,19 @@ enum e_dfu_controller_servicer_resid_cmds
 #ifndef DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK
     DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK = 65,
 #endif
+#ifndef DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE
+    DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE = 66,
+#endif
+#ifndef DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT
+    DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT = 67,
+#endif
 #ifndef DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION
     DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION = 88,
 #endif
 #ifndef DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT
     DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT = 89,
 #endif
-    NUM_DFU_CONTROLLER_SERVICER_RESID_CMDS = 11
+    NUM_DFU_CONTROLLER_SERVICER_RESID_CMDS = 13
 };
 
 // DFU_CONTROLLER_SERVICER_RESID number of elements
@@ -67,6 +73,10 @@ enum e_dfu_controller_servicer_resid_cmds
 #define DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE_NUM_VALUES (1)
 // number of values of type dfu_controller_servicer_resid_dfu_transferblock_t expected by DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK
 #define DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK_NUM_VALUES (2)
+// number of values of type dfu_controller_servicer_resid_dfu_transfersize_t expected by DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE
+#define DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE_NUM_VALUES (2)
+// number of values of type dfu_controller_servicer_resid_dfu_payloadformat_t expected by DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT
+#define DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT_NUM_VALUES (1)
 // number of values of type dfu_controller_servicer_resid_dfu_getversion_t expected by DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION
 #define DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION_NUM_VALUES (3)
 // number of values of type dfu_controller_servicer_resid_dfu_reboot_t expected by DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT
@@ -91,6 +101,10 @@ typedef uint8_t dfu_controller_servicer_resid_dfu_abort_t;
 typedef uint8_t dfu_controller_servicer_resid_dfu_setalternate_t;
 // type expected by DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK
 typedef uint8_t dfu_controller_servicer_resid_dfu_transferblock_t;
+// type expected by DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE
+typedef uint8_t dfu_controller_servicer_resid_dfu_transfersize_t;
+// type expected by DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT
+typedef uint8_t dfu_controller_servicer_resid_dfu_payloadformat_t;
 // type expected by DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION
 typedef uint8_t dfu_controller_servicer_resid_dfu_getversion_t;
 // type expected by DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT
@@ -18,6 +18,8 @@ static control_cmd_info_t dfu_controller_servicer_resid_cmd_map[] =
     { DFU_CONTROLLER_SERVICER_RESID_DFU_ABORT, 1, sizeof(uint8_t), CMD_WRITE_ONLY },
     { DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE, 1, sizeof(uint8_t), CMD_WRITE_ONLY },
     { DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK, 2, sizeof(uint8_t), CMD_READ_WRITE },
+    { DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE, 2, sizeof(uint8_t), CMD_READ_WRITE },
+    { DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT, 1, sizeof(uint8_t), CMD_READ_WRITE },
     { DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION, 3, sizeof(uint8_t), CMD_READ_ONLY },
     { DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT, 1, sizeof(uint8_t), CMD_WRITE_ONLY },
 };
@@ -6,11 +6,14 @@
 #endif
 #include "debug_print.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include "quadflashlib.h"
 
 #include "dfu_common.h"
+#include "dfu_delta.h"
 #include "rtos_dfu_image.h"
 #include "rtos_qspi_flash.h"
 #include "platform/driver_instances.h"
@@ -20,20 +23,32 @@ static size_t bytes_avail = 0;
 static uint32_t dn_base_addr = 0;
 static size_t total_len = 0;
 
-uint32_t dfu_common_write_to_flash(uint8_t alt,
-                                   uint16_t block_num,
-                                   uint8_t const *data,
-                                   uint16_t length)
-{
-    rtos_printf("Received Alt %d BlockNum %d of length %d\n", alt, block_num, length);
-    uint32_t return_value = 0; // DFU_STATUS_OK
+/* Sector erased by dfu_common_pre_erase(), ready to be programmed */
+static bool pre_erased = false;
+static uint32_t pre_erased_addr = 0;
+
+/* Used to assemble, copy and check the sectors of a delta image */
+static uint8_t sector_buf[DFU_FLASH_SECTOR_SIZE];
 
+/* Delta image being applied, see dfu_delta.h */
+static struct {
+    bool active;
+    dfu_delta_header_t header;
+    uint8_t record[DFU_DELTA_RECORD_SIZE];
+    unsigned record_fill;           // Bytes of the next record received so far
+    unsigned sector;                // Next sector of the new image
+    unsigned data_sectors;          // Sectors of the current DFU_DELTA_OP_DATA record still to come
+    unsigned data_fill;             // Bytes of the current data sector received so far
+} delta;
+
+/* Sets up the download partition for alt on the first block of a download. Returns false if alt can't be written. */
+static bool dfu_common_select_partition(uint8_t alt)
+{
     unsigned data_partition_base_addr = rtos_dfu_image_get_data_partition_addr(dfu_image_ctx);
     switch(alt) {
         default:
         case 0:
-            return_value = 3; //DFU_STATUS_ERR_WRITE
-            break;
+            return false;
         case 1:
             if (dn_base_addr == 0) {
                 total_len = 0;
@@ -48,48 +63,230 @@ uint32_t dfu_common_write_to_flash(uint8_t alt,
                 bytes_avail = rtos_qspi_flash_size_get(qspi_flash_ctx) - dn_base_addr;
             }
             rtos_printf("Using addr 0x%x\nsize %u\n", dn_base_addr, bytes_avail);
-            if(length > 0) {
-                unsigned cur_addr = dn_base_addr + (block_num * length);
-                if((bytes_avail - total_len) >= length) {
-                    rtos_printf("write %d at 0x%x\n", length, cur_addr);
-
-                    size_t sector_size = rtos_qspi_flash_sector_size_get(qspi_flash_ctx);
-                    xassert(length == sector_size);
-
-                    uint8_t *tmp_buf = rtos_osal_malloc( sizeof(uint8_t) * sector_size);
-                    rtos_qspi_flash_lock(qspi_flash_ctx);
-                    {
-                        rtos_qspi_flash_read(
-                                qspi_flash_ctx,
-                                tmp_buf,
-                                cur_addr,
-                                sector_size);
-                        memcpy(tmp_buf, data, length);
-                        rtos_qspi_flash_erase(
-                                qspi_flash_ctx,
-                                cur_addr,
-                                sector_size);
-                        rtos_qspi_flash_write(
-                                qspi_flash_ctx,
-                                (uint8_t *) tmp_buf,
-                                cur_addr,
-                                sector_size);
-                    }
-                    rtos_qspi_flash_unlock(qspi_flash_ctx);
-                    rtos_osal_free(tmp_buf);
-                    total_len += length;
-                } else {
-                    rtos_printf("Insufficient space\n");
-                    return_value = 8; //DFU_STATUS_ERR_ADDRESS;
-                }
+            return true;
+    }
+}
+
+static unsigned delta_sector_len(unsigned sector)
+{
+    unsigned offset = sector * DFU_FLASH_SECTOR_SIZE;
+    return (delta.header.image_size - offset < DFU_FLASH_SECTOR_SIZE) ? delta.header.image_size - offset
+                                                                       : DFU_FLASH_SECTOR_SIZE;
+}
+
+/* Erases a sector of the new image and programs it from sector_buf */
+static void delta_write_sector(unsigned sector)
+{
+    unsigned addr = dn_base_addr + sector * DFU_FLASH_SECTOR_SIZE;
+
+    rtos_qspi_flash_lock(qspi_flash_ctx);
+    rtos_qspi_flash_erase(qspi_flash_ctx, addr, DFU_FLASH_SECTOR_SIZE);
+    rtos_qspi_flash_write(qspi_flash_ctx, sector_buf, addr, delta_sector_len(sector));
+    rtos_qspi_flash_unlock(qspi_flash_ctx);
+}
+
+/* Checks a complete record and applies it, if its sectors don't follow it in the download */
+static uint32_t delta_apply_record(void)
+{
+    dfu_delta_record_t record;
+    unsigned image_sectors = (delta.header.image_size + DFU_FLASH_SECTOR_SIZE - 1) / DFU_FLASH_SECTOR_SIZE;
+
+    dfu_delta_parse_record(&record, delta.record);
+    delta.record_fill = 0;
+    if (record.count > image_sectors - delta.sector) {
+        rtos_printf("Delta record past the end of the image\n");
+        return 8; //DFU_STATUS_ERR_ADDRESS
+    }
+
+    switch (record.op) {
+        case DFU_DELTA_OP_KEEP:
+            delta.sector += record.count;
+            return 0; // DFU_STATUS_OK
+        case DFU_DELTA_OP_COPY:
+            if ((record.src + record.count) * DFU_FLASH_SECTOR_SIZE > rtos_dfu_image_get_factory_size(dfu_image_ctx)) {
+                rtos_printf("Delta copy past the end of the factory image\n");
+                return 2; //DFU_STATUS_ERR_FILE
             }
+            for (unsigned i = 0; i < record.count; i++, delta.sector++) {
+                rtos_qspi_flash_read(
+                        qspi_flash_ctx,
+                        sector_buf,
+                        rtos_dfu_image_get_factory_addr(dfu_image_ctx) + (record.src + i) * DFU_FLASH_SECTOR_SIZE,
+                        delta_sector_len(delta.sector));
+                delta_write_sector(delta.sector);
+            }
+            return 0; // DFU_STATUS_OK
+        case DFU_DELTA_OP_DATA:
+            delta.data_sectors = record.count;
+            delta.data_fill = 0;
+            return 0; // DFU_STATUS_OK
+        default:
+            rtos_printf("Unknown delta record %d\n", record.op);
+            return 2; //DFU_STATUS_ERR_FILE
+    }
+}
 
+/* Consumes the next length bytes of a delta image, and writes the sectors that they complete */
+static uint32_t delta_write(uint8_t const *data, size_t length)
+{
+    uint32_t return_value = 0; // DFU_STATUS_OK
+    unsigned image_sectors = (delta.header.image_size + DFU_FLASH_SECTOR_SIZE - 1) / DFU_FLASH_SECTOR_SIZE;
+
+    while ((length > 0) && (return_value == 0)) {
+        size_t n;
+        if (delta.sector == image_sectors) {
+            /* Padding after the last sector */
             break;
+        } else if (delta.data_sectors == 0) {
+            n = DFU_DELTA_RECORD_SIZE - delta.record_fill;
+            n = (length < n) ? length : n;
+            memcpy(&delta.record[delta.record_fill], data, n);
+            delta.record_fill += n;
+            if (delta.record_fill == DFU_DELTA_RECORD_SIZE) {
+                return_value = delta_apply_record();
+            }
+        } else {
+            unsigned sector_len = delta_sector_len(delta.sector);
+            n = sector_len - delta.data_fill;
+            n = (length < n) ? length : n;
+            memcpy(&sector_buf[delta.data_fill], data, n);
+            delta.data_fill += n;
+            if (delta.data_fill == sector_len) {
+                delta_write_sector(delta.sector);
+                delta.sector++;
+                delta.data_sectors--;
+                delta.data_fill = 0;
+            }
+        }
+        data += n;
+        length -= n;
+    }
+    return return_value;
+}
+
+/* Checks that the whole new image has been written and that its CRC matches the delta header */
+static uint32_t delta_verify(void)
+{
+    unsigned image_sectors = (delta.header.image_size + DFU_FLASH_SECTOR_SIZE - 1) / DFU_FLASH_SECTOR_SIZE;
+    uint32_t crc = 0;
+
+    if (delta.sector != image_sectors) {
+        rtos_printf("Delta image incomplete\n");
+        return 9; //DFU_STATUS_ERR_NOTDONE
+    }
+    for (unsigned sector = 0; sector < image_sectors; sector++) {
+        unsigned len = delta_sector_len(sector);
+        rtos_qspi_flash_read(qspi_flash_ctx, sector_buf, dn_base_addr + sector * DFU_FLASH_SECTOR_SIZE, len);
+        crc = dfu_delta_crc32(crc, sector_buf, len);
+    }
+    if (crc != delta.header.image_crc) {
+        rtos_printf("Delta image CRC 0x%x, expected 0x%x\n", crc, delta.header.image_crc);
+        return 7; //DFU_STATUS_ERR_VERIFY
+    }
+    return 0; // DFU_STATUS_OK
+}
+
+uint32_t dfu_common_write_to_flash(uint8_t alt,
+                                   uint16_t block_num,
+                                   uint8_t const *data,
+                                   uint16_t length)
+{
+    rtos_printf("Received Alt %d BlockNum %d of length %d\n", alt, block_num, length);
+    uint32_t return_value = 0; // DFU_STATUS_OK
+
+    if (!dfu_common_select_partition(alt)) {
+        return 3; //DFU_STATUS_ERR_WRITE
+    }
+    if ((block_num == 0) && (length >= DFU_DELTA_HEADER_SIZE) &&
+        dfu_delta_parse_header(&delta.header, data)) {
+        if (delta.header.image_size > bytes_avail) {
+            rtos_printf("Insufficient space\n");
+            return 8; //DFU_STATUS_ERR_ADDRESS;
+        }
+        rtos_printf("Delta image of %u bytes\n", delta.header.image_size);
+        delta.active = true;
+        delta.record_fill = 0;
+        delta.sector = 0;
+        delta.data_sectors = 0;
+        data += DFU_DELTA_HEADER_SIZE;
+        length -= DFU_DELTA_HEADER_SIZE;
+    }
+    if (delta.active) {
+        return delta_write(data, length);
+    }
+    if(length > 0) {
+        size_t sector_size = rtos_qspi_flash_sector_size_get(qspi_flash_ctx);
+        xassert(sector_size == DFU_FLASH_SECTOR_SIZE);
+        xassert(length <= sector_size);
+
+        /* Every block but the last is a whole sector */
+        unsigned cur_addr = dn_base_addr + (block_num * sector_size);
+        if((bytes_avail - total_len) >= length) {
+            rtos_printf("write %d at 0x%x\n", length, cur_addr);
+
+            rtos_qspi_flash_lock(qspi_flash_ctx);
+            if (!pre_erased || (pre_erased_addr != cur_addr)) {
+                rtos_qspi_flash_erase(
+                        qspi_flash_ctx,
+                        cur_addr,
+                        sector_size);
+            }
+            /* The rest of a partial last sector is left erased, so there is nothing to read back */
+            rtos_qspi_flash_write(
+                    qspi_flash_ctx,
+                    data,
+                    cur_addr,
+                    length);
+            rtos_qspi_flash_unlock(qspi_flash_ctx);
+            pre_erased = false;
+            total_len += length;
+        } else {
+            rtos_printf("Insufficient space\n");
+            return_value = 8; //DFU_STATUS_ERR_ADDRESS;
+        }
     }
 
     return return_value;
 }
 
+uint32_t dfu_common_pre_erase(uint8_t alt,
+                              uint16_t block_num)
+{
+    rtos_printf("Pre-erase Alt %d BlockNum %d\n", alt, block_num);
+
+    if (!dfu_common_select_partition(alt)) {
+        return 3; //DFU_STATUS_ERR_WRITE
+    }
+    if ((block_num == 0) || delta.active) {
+        /*
+         * The first block may be the header of a delta image, which decides which sectors are erased. It is erased
+         * when it is written instead.
+         */
+        return 0; // DFU_STATUS_OK
+    }
+    size_t sector_size = rtos_qspi_flash_sector_size_get(qspi_flash_ctx);
+    if ((block_num + 1) * sector_size > bytes_avail) {
+        rtos_printf("Insufficient space\n");
+        return 8; //DFU_STATUS_ERR_ADDRESS;
+    }
+    pre_erased_addr = dn_base_addr + (block_num * sector_size);
+    rtos_qspi_flash_lock(qspi_flash_ctx);
+    rtos_qspi_flash_erase(
+            qspi_flash_ctx,
+            pre_erased_addr,
+            sector_size);
+    rtos_qspi_flash_unlock(qspi_flash_ctx);
+    pre_erased = true;
+    return 0; // DFU_STATUS_OK
+}
+
+void dfu_common_abort_download()
+{
+    dn_base_addr = 0;
+    pre_erased = false;
+    delta.active = false;
+}
+
 uint32_t dfu_common_make_manifest()
 {
     debug_printf("Download completed, enter manifestation\n");
@@ -102,13 +299,29 @@ uint32_t dfu_common_make_manifest()
         0,
         sizeof(dummy));
 
+    uint32_t return_value = 0; // DFU_STATUS_OK
+    if (delta.active) {
+        return_value = delta_verify();
+        if (return_value != 0) {
+            /* Leave no valid image header behind, so the bad image is never booted */
+            rtos_qspi_flash_lock(qspi_flash_ctx);
+            rtos_qspi_flash_erase(
+                    qspi_flash_ctx,
+                    dn_base_addr,
+                    DFU_FLASH_SECTOR_SIZE);
+            rtos_qspi_flash_unlock(qspi_flash_ctx);
+        }
+    }
+
     /* Reset download */
     dn_base_addr = 0;
+    pre_erased = false;
+    delta.active = false;
 
-    // flashing op for manifest is complete without error
-    // Application can perform checksum.
+    // flashing op for manifest is complete
+    // Application can perform checksum of full images.
     // Should it fail, return appropriate status such as errVERIFY.
-    return 0; // DFU_STATUS_OK
+    return return_value;
 }
 
 uint16_t dfu_common_read_from_flash(uint8_t alt,
@@ -146,6 +359,10 @@ uint16_t dfu_common_read_from_flash(uint8_t alt,
     }
 
     if (addr < endaddr) {
+        if (length > endaddr - addr) {
+            /* A short last block marks the end of the image */
+            length = endaddr - addr;
+        }
         rtos_qspi_flash_read(qspi_flash_ctx, data, addr, length);
         retval = length;
     }
@@ -13,6 +13,9 @@
 #define DOWNLOAD_TIMEOUT_WRITE_MS 3
 #define DOWNLOAD_TIMEOUT_BUFFER_MS 1
 
+// Size of the flash sectors written by dfu_common_write_to_flash()
+#define DFU_FLASH_SECTOR_SIZE 4096
+
 /**
  * \brief Handle a DFU request to write some data to the flash memory.
  *
@@ -21,6 +24,15 @@
  *   the value of \p alt. The data is written to the flash memory at the
  *   address specified by \p block_num.
  *
+ * Every block except the last one of a download must be a whole flash sector.
+ *   Each block is programmed directly from \p data into an erased sector. The
+ *   rest of the sector after a shorter last block is left erased, whether or
+ *   not the sector was erased ahead by dfu_common_pre_erase().
+ *
+ * A download that starts with a delta image header is applied as a delta
+ *   image instead, see dfu_delta.h. Its blocks may then be of any length,
+ *   and only the sectors that it changes are erased and programmed.
+ *
  * \param[in] alt           Interface to identify the memory partition to write to.
  * \param[in] block_num     The block number used to calculate the address to write to.
  * \param[in] data          Buffer containing \p length valid bytes of data.
@@ -33,6 +45,33 @@ uint32_t dfu_common_write_to_flash(uint8_t alt,
                                    uint8_t const *data,
                                    uint16_t length);
 
+/**
+ * \brief Erase the flash sector that a block will be written to, ahead of the write.
+ *
+ * The next call to dfu_common_write_to_flash() for \p block_num then only
+ *   programs the sector. This lets the erase overlap the transfer of the
+ *   block. Any part of the sector after a partial block is left erased.
+ *
+ * The first block, and every block of a delta image, is not erased ahead
+ *   of the write, as only the header of the download decides which sectors
+ *   are erased.
+ *
+ * \param[in] alt           Interface to identify the memory partition to write to.
+ * \param[in] block_num     The block number used to calculate the address to erase.
+ *
+ * \return                  0 if the erase operation was successful, a non-zero error value otherwise.
+ */
+uint32_t dfu_common_pre_erase(uint8_t alt,
+                              uint16_t block_num);
+
+/**
+ * \brief Abandon a download without manifesting it.
+ *
+ * The next download starts again from the start of the partition selected by
+ *   its \p alt.
+ */
+void dfu_common_abort_download();
+
 /**
  * \brief Handle a DFU request to perform a manifestation phase.
  *
@@ -40,6 +79,10 @@ uint32_t dfu_common_write_to_flash(uint8_t alt,
  *   are flushed, and it resets the necessary variables to prepare for the next
  *   download operation.
  *
+ * For a delta image it checks the CRC-32 of the new image against the one in
+ *   the delta header. If they differ, or the delta image was incomplete, the
+ *   first sector of the partition is erased so the image is never booted.
+ *
  * \return                  0 if the write operation was successful, a non-zero error value otherwise.
 */
 uint32_t dfu_common_make_manifest();
@@ -57,7 +100,8 @@ uint32_t dfu_common_make_manifest();
  * \param[in] data          Buffer to store the data read from the memory.
  * \param[in] length        The number of bytes to copy to \p data.
  *
- * \return                  0 if the write operation was successful, a non-zero error value otherwise.
+ * \return                  The number of bytes read. This is less than \p length for the last block of the
+ *                          partition, and 0 past its end.
  */
 uint16_t dfu_common_read_from_flash(uint8_t alt,
                                     uint16_t block_num,
@@ -0,0 +1,75 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include "dfu_delta.h"
+
+static uint32_t get_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static void put_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static void put_le16(uint8_t *data, uint16_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+int dfu_delta_parse_header(dfu_delta_header_t *header, const uint8_t *data)
+{
+    header->magic = get_le32(&data[0]);
+    header->image_size = get_le32(&data[4]);
+    header->image_crc = get_le32(&data[8]);
+    return header->magic == DFU_DELTA_MAGIC;
+}
+
+void dfu_delta_parse_record(dfu_delta_record_t *record, const uint8_t *data)
+{
+    record->op = get_le16(&data[0]);
+    record->count = get_le16(&data[2]);
+    record->src = get_le16(&data[4]);
+    record->reserved = get_le16(&data[6]);
+}
+
+void dfu_delta_write_header(uint8_t *data, const dfu_delta_header_t *header)
+{
+    put_le32(&data[0], header->magic);
+    put_le32(&data[4], header->image_size);
+    put_le32(&data[8], header->image_crc);
+}
+
+void dfu_delta_write_record(uint8_t *data, const dfu_delta_record_t *record)
+{
+    put_le16(&data[0], record->op);
+    put_le16(&data[2], record->count);
+    put_le16(&data[4], record->src);
+    put_le16(&data[6], record->reserved);
+}
+
+uint32_t dfu_delta_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    /* Reflected 0xEDB88320 polynomial, a nibble at a time to keep the table small */
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+    }
+    return ~crc;
+}
@@ -0,0 +1,73 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Delta DFU images, shared by the device and the host tool that makes them.
+ *
+ * A delta image is downloaded in place of a full image, to the same alt setting. It describes the new image sector by
+ * sector against what the device already has, so only the sectors that changed are sent, erased and programmed:
+ *
+ *   dfu_delta_header_t                 DFU_DELTA_HEADER_SIZE bytes
+ *   records, in target sector order    DFU_DELTA_RECORD_SIZE bytes each
+ *   padding                            Ignored
+ *
+ * Each record covers the next count sectors of the new image:
+ *
+ *   DFU_DELTA_OP_KEEP      The sectors already in the partition are unchanged. They are not touched.
+ *   DFU_DELTA_OP_COPY      The sectors are the same as the factory image sectors from src on.
+ *   DFU_DELTA_OP_DATA      The sectors follow the record. The last sector of the image is cut short at image_size.
+ *
+ * All the fields are little endian. The device checks the CRC-32 of the whole new image at manifestation, and
+ * erases the first sector of the partition if it doesn't match, so a bad delta never leaves a bootable image.
+ */
+
+#define DFU_DELTA_MAGIC         (0x31544C44)    // "DLT1"
+#define DFU_DELTA_HEADER_SIZE   (12)
+#define DFU_DELTA_RECORD_SIZE   (8)
+
+typedef enum {
+    DFU_DELTA_OP_KEEP = 0,
+    DFU_DELTA_OP_COPY = 1,
+    DFU_DELTA_OP_DATA = 2,
+} dfu_delta_op_t;
+
+typedef struct {
+    uint32_t magic;         // DFU_DELTA_MAGIC
+    uint32_t image_size;    // Bytes in the new image
+    uint32_t image_crc;     // dfu_delta_crc32() of the new image
+} dfu_delta_header_t;
+
+typedef struct {
+    uint16_t op;            // dfu_delta_op_t
+    uint16_t count;         // Sectors covered by the record
+    uint16_t src;           // First factory image sector, for DFU_DELTA_OP_COPY
+    uint16_t reserved;
+} dfu_delta_record_t;
+
+/// @brief Parse a delta image header
+/// @param header   Set to the header
+/// @param data     DFU_DELTA_HEADER_SIZE bytes from the start of a download
+/// @return int     1 if data is the header of a delta image, 0 otherwise
+int dfu_delta_parse_header(dfu_delta_header_t *header, const uint8_t *data);
+
+/// @brief Parse a delta image record
+/// @param record   Set to the record
+/// @param data     DFU_DELTA_RECORD_SIZE bytes
+void dfu_delta_parse_record(dfu_delta_record_t *record, const uint8_t *data);
+
+/// @brief Serialise a delta image header, for the host tool
+void dfu_delta_write_header(uint8_t *data, const dfu_delta_header_t *header);
+
+/// @brief Serialise a delta image record, for the host tool
+void dfu_delta_write_record(uint8_t *data, const dfu_delta_record_t *record);
+
+/// @brief Update a CRC-32, the same as zlib's crc32()
+/// @param crc      CRC of the data so far, 0 to start
+/// @param data     Next data
+/// @param len      Bytes in data
+/// @return uint32_t CRC including data
+uint32_t dfu_delta_crc32(uint32_t crc, const uint8_t *data, size_t len);
@@ -0,0 +1,110 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include "dfu_lz.h"
+
+void dfu_lz_init(dfu_lz_t *lz)
+{
+    lz->window_pos = 0;
+    lz->total_out = 0;
+    lz->header_fill = 0;
+    lz->literals = 0;
+    lz->match = 0;
+    lz->distance = 0;
+}
+
+static unsigned header_len(uint8_t token)
+{
+    return (token & DFU_LZ_MATCH_FLAG) ? 3 : 1;
+}
+
+static inline void output(dfu_lz_t *lz, uint8_t byte, uint8_t *out)
+{
+    *out = byte;
+    lz->window[lz->window_pos] = byte;
+    lz->window_pos = (lz->window_pos + 1) % DFU_LZ_WINDOW_SIZE;
+    if (lz->total_out < DFU_LZ_WINDOW_SIZE) {
+        lz->total_out++;
+    }
+}
+
+bool dfu_lz_decode(dfu_lz_t *lz, const uint8_t **in, size_t *in_len, uint8_t *out, size_t *out_len)
+{
+    const uint8_t *data = *in;
+    size_t data_len = *in_len;
+    size_t space = *out_len;
+    size_t n = 0;
+    bool valid = true;
+
+    while (n < space) {
+        if (lz->match > 0) {
+            unsigned from = (lz->window_pos + DFU_LZ_WINDOW_SIZE - lz->distance) % DFU_LZ_WINDOW_SIZE;
+            output(lz, lz->window[from], &out[n++]);
+            lz->match--;
+        } else if (data_len == 0) {
+            break;
+        } else if (lz->literals > 0) {
+            output(lz, *data++, &out[n++]);
+            data_len--;
+            lz->literals--;
+        } else {
+            lz->header[lz->header_fill++] = *data++;
+            data_len--;
+            if (lz->header_fill < header_len(lz->header[0])) {
+                continue;
+            }
+            lz->header_fill = 0;
+            if (lz->header[0] & DFU_LZ_MATCH_FLAG) {
+                lz->distance = (lz->header[1] | (lz->header[2] << 8)) + 1;
+                if (lz->distance > lz->total_out) {
+                    valid = false;
+                    break;
+                }
+                lz->match = (lz->header[0] & ~DFU_LZ_MATCH_FLAG) + DFU_LZ_MIN_MATCH;
+            } else {
+                lz->literals = lz->header[0] + 1;
+            }
+        }
+    }
+
+    *in = data;
+    *in_len = data_len;
+    *out_len = n;
+    return valid;
+}
+
+size_t dfu_lz_decoded_length(const dfu_lz_t *lz, const uint8_t *in, size_t in_len)
+{
+    size_t n = lz->match;
+    unsigned literals = lz->literals;
+    uint8_t token = lz->header[0];
+    unsigned header_fill = lz->header_fill;
+
+    for (size_t i = 0; i < in_len; i++) {
+        if (literals > 0) {
+            /* The rest of the run, or as much of it as there is */
+            size_t run = (in_len - i < literals) ? in_len - i : literals;
+            n += run;
+            literals -= run;
+            i += run - 1;
+            continue;
+        }
+        if (header_fill == 0) {
+            token = in[i];
+        }
+        if (++header_fill < header_len(token)) {
+            continue;
+        }
+        header_fill = 0;
+        if (token & DFU_LZ_MATCH_FLAG) {
+            n += (token & ~DFU_LZ_MATCH_FLAG) + DFU_LZ_MIN_MATCH;
+        } else {
+            literals = token + 1;
+        }
+    }
+    return n;
+}
+
+bool dfu_lz_complete(const dfu_lz_t *lz)
+{
+    return (lz->header_fill == 0) && (lz->literals == 0) && (lz->match == 0);
+}
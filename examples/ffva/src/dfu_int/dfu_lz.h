@@ -0,0 +1,61 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compressed DFU payloads, shared by the device and the host tool that makes them.
+ *
+ * The compressed stream is a sequence of tokens, each starting with a token byte t:
+ *
+ *   t < 0x80       A literal run. The next t + 1 bytes are copied to the output.
+ *   t >= 0x80      A match. The next 2 bytes, little endian, are the distance d - 1. The (t & 0x7F) +
+ *                  DFU_LZ_MIN_MATCH bytes starting d bytes back in the output are copied to the output, so a match
+ *                  may overlap its own output.
+ *
+ * Distances are at most DFU_LZ_WINDOW_SIZE, which is all the history the decoder keeps, so it decodes a stream
+ * of any length in DFU_LZ_WINDOW_SIZE bytes of RAM. A match token is 3 bytes, so a match must be longer than that
+ * to save anything.
+ */
+
+#define DFU_LZ_WINDOW_SIZE      (2048)
+#define DFU_LZ_MIN_MATCH        (4)
+#define DFU_LZ_MAX_MATCH        (0x7F + DFU_LZ_MIN_MATCH)
+#define DFU_LZ_MAX_LITERALS     (0x80)
+#define DFU_LZ_MATCH_FLAG       (0x80)
+
+typedef struct {
+    uint8_t window[DFU_LZ_WINDOW_SIZE];    // The last DFU_LZ_WINDOW_SIZE bytes of output
+    uint16_t window_pos;                    // Where the next byte of output goes in window
+    uint32_t total_out;                     // Bytes output so far, up to a window, to check distances
+    uint8_t header[3];                      // Token byte and distance of the token being received
+    uint8_t header_fill;
+    uint8_t literals;                       // Bytes of the literal run still to come
+    uint8_t match;                          // Bytes of the match still to copy
+    uint16_t distance;
+} dfu_lz_t;
+
+/// @brief Start decoding a new stream
+void dfu_lz_init(dfu_lz_t *lz);
+
+/// @brief Decode as much of the input as fits in the output
+/// @param lz       Decoder state
+/// @param in       Input, advanced past the bytes consumed
+/// @param in_len   Bytes of input, reduced by the bytes consumed
+/// @param out      Output
+/// @param out_len  Space in out, set to the bytes decoded into it
+/// @return bool    false if the stream is invalid
+bool dfu_lz_decode(dfu_lz_t *lz, const uint8_t **in, size_t *in_len, uint8_t *out, size_t *out_len);
+
+/// @brief Bytes that decoding in_len bytes of input will output, without decoding them
+/// @param lz       Decoder state, unchanged
+/// @param in       Input
+/// @param in_len   Bytes of input
+/// @return size_t  Bytes of output
+size_t dfu_lz_decoded_length(const dfu_lz_t *lz, const uint8_t *in, size_t in_len);
+
+/// @brief Whether the stream so far ends at the end of a token
+bool dfu_lz_complete(const dfu_lz_t *lz);
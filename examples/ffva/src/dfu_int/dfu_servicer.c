@@ -21,6 +21,14 @@
 #include "dfu_common.h"
 #include "dfu_state_machine.h"
 
+// Size the DNLOAD and UPLOAD commands in the command map, and so the length checks in validate_cmd(), for payloads of
+// the 2 byte length marker followed by xfer_size bytes of data
+static void dfu_servicer_set_xfer_size(control_resource_info_t *res_info, uint16_t xfer_size)
+{
+    get_cmd_info(DFU_CONTROLLER_SERVICER_RESID_DFU_DNLOAD, res_info)->num_vals = 2 + xfer_size;
+    get_cmd_info(DFU_CONTROLLER_SERVICER_RESID_DFU_UPLOAD, res_info)->num_vals = 2 + xfer_size;
+}
+
 void dfu_servicer_init(servicer_t *servicer)
 {
     #include "dfu_cmds_map.h" // Included instead of directly adding code since this file is autogenerated.
@@ -37,6 +45,8 @@ void dfu_servicer_init(servicer_t *servicer)
     servicer->res_info[0].resource = DFU_CONTROLLER_SERVICER_RESID;
     servicer->res_info[0].command_map.num_commands = NUM_DFU_CONTROLLER_SERVICER_RESID_CMDS;
     servicer->res_info[0].command_map.commands = dfu_controller_servicer_resid_cmd_map;
+    servicer_index_init(servicer);
+    dfu_servicer_set_xfer_size(&servicer->res_info[0], DFU_DATA_XFER_SIZE);
 }
 
 void dfu_servicer(void *args) {
@@ -90,7 +100,7 @@ control_ret_t dfu_servicer_read_cmd(control_resource_info_t *res_info, control_c
     case DFU_CONTROLLER_SERVICER_RESID_DFU_UPLOAD:
     {
         debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_UPLOAD\n");
-        size_t upload_len = dfu_int_upload(&payload[2], DFU_DATA_XFER_SIZE);
+        size_t upload_len = dfu_int_upload(&payload[2], payload_len - 2);
 
         payload[0] = upload_len & 0xFF;
         payload[1] = (upload_len >> 8) & 0xFF;
@@ -141,6 +151,24 @@ control_ret_t dfu_servicer_read_cmd(control_resource_info_t *res_info, control_c
         break;
     }
 
+    case DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE:
+    {
+        debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE\n");
+        uint16_t transfersize = dfu_int_get_transfer_size();
+
+        payload[0] = (uint8_t)(transfersize & 0xFF);
+        payload[1] = (uint8_t)((transfersize >> 8) & 0xFF);
+
+        break;
+    }
+
+    case DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT:
+    {
+        debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT\n");
+        payload[0] = dfu_int_get_payload_format();
+        break;
+    }
+
     case DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION:
     {
         debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION\n");
@@ -178,6 +206,11 @@ control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_
         debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_DNLOAD\n");
         uint16_t dnload_length = payload[0] + (payload[1] << 8);
         const uint8_t * dnload_data = &payload[2];
+        if (dnload_length > payload_len - 2)
+        {
+            ret = CONTROL_DATA_LENGTH_ERROR;
+            break;
+        }
         dfu_int_download(dnload_length, dnload_data);
         break;
 
@@ -194,6 +227,7 @@ control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_
     case DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE:
         debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE\n");
         dfu_int_set_alternate(payload[0]);
+        dfu_servicer_set_xfer_size(res_info, DFU_DATA_XFER_SIZE);
         break;
 
     case DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERBLOCK:
@@ -202,6 +236,27 @@ control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_
         dfu_int_set_transfer_block(transferblock);
         break;
 
+    case DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE:
+        debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE\n");
+        uint16_t const transfersize = (payload[1] << 8) + payload[0];
+        if (dfu_int_set_transfer_size(transfersize))
+        {
+            dfu_servicer_set_xfer_size(res_info, transfersize);
+        }
+        else
+        {
+            ret = CONTROL_ERROR;
+        }
+        break;
+
+    case DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT:
+        debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT\n");
+        if (!dfu_int_set_payload_format(payload[0]))
+        {
+            ret = CONTROL_ERROR;
+        }
+        break;
+
     case DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT:
         debug_printf("DFU_CONTROLLER_SERVICER_RESID_DFU_REBOOT\n");
         reboot();
@@ -15,11 +15,13 @@
 // Application includes
 #include "dfu_state_machine.h"
 #include "dfu_common.h"
+#include "dfu_lz.h"
 
 // FreeRTOS includes
 #include "FreeRTOS.h"
 #include "rtos_osal.h"
 #include "task.h"
+#include "queue.h"
 
 #define XCORE_MS_TO_TICKS(ms) (XS1_TIMER_KHZ * ms);
 
@@ -38,27 +40,92 @@
 #define DFU_INT_TASK_BIT_ABORT 0b00100000
 #define DFU_INT_TASK_BIT_SETALTERNATE 0b10000000 // not a DFU spec. command
 
+#if DFU_INT_PIPELINED_WRITE
+// One buffer is filled by the host while the other is programmed
+#define DFU_INT_NUM_BUFFERS 2
+#define DFU_INT_FLASH_JOB_QUEUE_LENGTH 8
+#else
+#define DFU_INT_NUM_BUFFERS 1
+#endif
+
 typedef struct dfu_int_dfu_data_t
 {
     TaskHandle_t task_handle;
     SemaphoreHandle_t upload_semaphore;
     dfu_int_alt_setting_t alt_setting;
+    dfu_int_alt_setting_t requested_alt_setting; // Set by the servicer, applied by the state machine
     dfu_int_state_t current_state;
     dfu_int_status_t current_status;
     bool download_or_manifest_in_progress;
     bool move_to_error;
     dfu_int_status_t move_to_error_status;
     uint16_t transfer_block;
+    uint16_t xfer_size;
     uint16_t data_xfer_length;
+    uint8_t xfer_buffer[DFU_DATA_XFER_MAX_SIZE]; // The last DNLOAD payload
+    dfu_int_payload_format_t payload_format;
+    dfu_lz_t lz; // Decompresses DFU_INT_PAYLOAD_FORMAT_LZ payloads
     uint16_t download_block_number;
-    uint8_t frag_number;
-    uint8_t dfu_data_buffer[DFU_SECTOR_SIZE];
+    uint16_t fill_level; // Bytes of the block in the buffer being filled
+    uint8_t *dfu_data_buffer; // The buffer being filled
+    uint8_t fill_buffer;
+    uint8_t dfu_data_buffers[DFU_INT_NUM_BUFFERS][DFU_SECTOR_SIZE];
+    uint32_t download_generation; // Incremented whenever a download is abandoned
     uint32_t previous_timeout_ms;
     uint32_t timeout_start;
 } dfu_int_dfu_data_t;
 
 static dfu_int_dfu_data_t dfu_data;
 
+#if DFU_INT_PIPELINED_WRITE
+typedef enum dfu_int_flash_op_t
+{
+    DFU_INT_FLASH_ERASE,
+    DFU_INT_FLASH_PROGRAM,
+    DFU_INT_FLASH_ABORT,
+    DFU_INT_FLASH_FLUSH
+} dfu_int_flash_op_t;
+
+typedef struct dfu_int_flash_job_t
+{
+    dfu_int_flash_op_t op;
+    uint8_t alt_setting;
+    uint16_t block_number;
+    const uint8_t *data;
+    uint16_t length; // Bytes of data to program, less than a sector for the last block of a download
+    uint32_t download_generation;
+} dfu_int_flash_job_t;
+
+/*
+ * The flash writer task runs the flash jobs queued by the state machine in
+ * order, so an abandoned download's jobs always finish before the next
+ * download's. A job's error is kept until the state machine next checks, as
+ * long as the download it belongs to has not been abandoned.
+ */
+typedef struct dfu_int_flash_writer_t
+{
+    QueueHandle_t job_queue;
+    SemaphoreHandle_t free_buffer; // Given when a programmed buffer can be refilled
+    SemaphoreHandle_t flushed;     // Given when all the jobs before a flush are done
+    volatile dfu_int_status_t status;
+    volatile uint32_t status_generation;
+} dfu_int_flash_writer_t;
+
+static dfu_int_flash_writer_t flash_writer;
+#endif
+
+/* Bytes of image that the last DNLOAD payload holds */
+static uint32_t dfu_int_payload_image_length()
+{
+    if (dfu_data.payload_format == DFU_INT_PAYLOAD_FORMAT_LZ)
+    {
+        return dfu_lz_decoded_length(&dfu_data.lz,
+                                     dfu_data.xfer_buffer,
+                                     dfu_data.data_xfer_length);
+    }
+    return dfu_data.data_xfer_length;
+}
+
 /* DFU INT functions. These are called by the DFU servicer, and run on its RTOS
  * task and thread of control.*/
 
@@ -88,17 +155,18 @@ void dfu_int_detach()
 void dfu_int_download(uint16_t length, const uint8_t *download_data)
 {
     debug_printf("Download %d bytes\n", length);
-    xassert(length <= DFU_DATA_XFER_SIZE);
-
-    // frag_addr takes values [0, 128]
-    uint16_t frag_addr = dfu_data.frag_number * DFU_DATA_XFER_SIZE;
+    /*
+     * The servicer has checked the length against its transfer size, which a
+     * SETALTERNATE resets before the state machine resets its own
+     */
+    xassert(length <= DFU_DATA_XFER_MAX_SIZE);
 
-    // Buffer starts empty and is cleared by state machine on write
+    // The state machine assembles the payload into the download buffer
 
     dfu_data.data_xfer_length = length;
     if (length > 0)
     {
-        memcpy(&(dfu_data.dfu_data_buffer[frag_addr]), download_data, length);
+        memcpy(dfu_data.xfer_buffer, download_data, length);
     }
     // else ZLP, so end of download. Buffer is cleared by state machine on reset
 
@@ -115,7 +183,7 @@ size_t dfu_int_upload(uint8_t *upload_buffer, size_t upload_buffer_length)
     // Now we wait for the state machine to populate the buffer and tell us.
     xSemaphoreTake(dfu_data.upload_semaphore, RTOS_OSAL_WAIT_FOREVER);
     // Eat the data. This will be padded to the length of dfu_data_buffer.
-    // Note - we are only using the first 64 bytes of the 256-wide data_buffer.
+    // Note - we are only using the first transfer size bytes of the buffer.
     memcpy(upload_buffer, dfu_data.dfu_data_buffer, upload_buffer_length);
     // And return the number of bytes that were actually read.
     debug_printf("Upload %d bytes\n", dfu_data.data_xfer_length);
@@ -237,18 +305,33 @@ void dfu_int_get_status(dfu_int_get_status_packet_t *get_status_packet)
         {
             get_status_packet->next_state = DFU_INT_DFU_DNBUSY;
             get_status_packet->current_status = dfu_data.current_status;
-            if (dfu_data.frag_number == (DFU_NUM_FRAGMENTS - 1))
+            // A compressed payload may complete more than one block
+            uint32_t blocks = (dfu_data.fill_level + dfu_int_payload_image_length()) / DFU_SECTOR_SIZE;
+            if (blocks > 0)
             {
+#if DFU_INT_PIPELINED_WRITE
+                if (uxSemaphoreGetCount(flash_writer.free_buffer) == 0 || blocks > 1)
+                {
+                    // We will wait for the previous blocks to be written
+                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_WRITE_MS * blocks;
+                }
+                else
+                {
+                    // We will just be handing the buffer to the flash writer
+                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_BUFFER_MS;
+                }
+#else
                 if (dfu_data.download_block_number % 16 == 0) // SECTOR / PAGE
                 {
                     // On this download, we will be erasing a sector and writing
-                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_ERASE_MS;
+                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_ERASE_MS * blocks;
                 }
                 else
                 {
                     // On this download, we will be writing
-                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_WRITE_MS;
+                    get_status_packet->timeout_ms = DOWNLOAD_TIMEOUT_WRITE_MS * blocks;
                 }
+#endif
             }
             else
             {
@@ -327,7 +410,7 @@ void dfu_int_abort()
 void dfu_int_set_alternate(dfu_int_alt_setting_t alt)
 {
     debug_printf("Set Alternate: %d\n", alt);
-    dfu_data.alt_setting = alt;
+    dfu_data.requested_alt_setting = alt;
     xTaskNotifyGiveIndexed(dfu_data.task_handle, REQUEST_COUNTER_INDEX);
     xTaskNotify(dfu_data.task_handle, DFU_INT_TASK_BIT_SETALTERNATE, eSetBits);
 }
@@ -344,14 +427,133 @@ uint16_t dfu_int_get_transfer_block()
     return dfu_data.transfer_block;
 }
 
+bool dfu_int_set_transfer_size(uint16_t size)
+{
+    debug_printf("Set Transfer Size: %d\n", size);
+    if (size == 0 || size > DFU_DATA_XFER_MAX_SIZE ||
+        dfu_data.current_state != DFU_INT_DFU_IDLE)
+    {
+        return false;
+    }
+    dfu_data.xfer_size = size;
+    return true;
+}
+
+uint16_t dfu_int_get_transfer_size()
+{
+    debug_printf("Get Transfer Size: %d\n", dfu_data.xfer_size);
+    return dfu_data.xfer_size;
+}
+
+bool dfu_int_set_payload_format(uint8_t format)
+{
+    debug_printf("Set Payload Format: %d\n", format);
+    if (format >= DFU_INT_NUM_PAYLOAD_FORMATS ||
+        dfu_data.current_state != DFU_INT_DFU_IDLE)
+    {
+        return false;
+    }
+    dfu_data.payload_format = format;
+    return true;
+}
+
+dfu_int_payload_format_t dfu_int_get_payload_format()
+{
+    debug_printf("Get Payload Format: %d\n", dfu_data.payload_format);
+    return dfu_data.payload_format;
+}
+
+#if DFU_INT_PIPELINED_WRITE
+/* Flash writer functions. The writer is a separate RTOS task. */
+
+static void dfu_int_flash_writer_queue(dfu_int_flash_op_t op, const uint8_t *data, uint16_t length)
+{
+    dfu_int_flash_job_t job = {
+        .op = op,
+        .alt_setting = dfu_data.alt_setting,
+        .block_number = dfu_data.download_block_number,
+        .data = data,
+        .length = length,
+        .download_generation = dfu_data.download_generation
+    };
+    xQueueSend(flash_writer.job_queue, &job, RTOS_OSAL_WAIT_FOREVER);
+}
+
+static dfu_int_status_t dfu_int_flash_writer_status()
+{
+    if (flash_writer.status_generation == dfu_data.download_generation)
+    {
+        return flash_writer.status;
+    }
+    return DFU_INT_DFU_STATUS_OK;
+}
+
+static dfu_int_status_t dfu_int_flash_writer_flush()
+{
+    dfu_int_flash_writer_queue(DFU_INT_FLASH_FLUSH, NULL, 0);
+    xSemaphoreTake(flash_writer.flushed, RTOS_OSAL_WAIT_FOREVER);
+    return dfu_int_flash_writer_status();
+}
+
+static void dfu_int_flash_writer(void *args)
+{
+    (void) args;
+    while (1)
+    {
+        dfu_int_flash_job_t job;
+        dfu_int_status_t retval = DFU_INT_DFU_STATUS_OK;
+        xQueueReceive(flash_writer.job_queue, &job, RTOS_OSAL_WAIT_FOREVER);
+
+        switch (job.op)
+        {
+        case DFU_INT_FLASH_ERASE:
+            retval = dfu_common_pre_erase(job.alt_setting, job.block_number);
+            break;
+        case DFU_INT_FLASH_PROGRAM:
+            retval = dfu_common_write_to_flash(
+                job.alt_setting,
+                job.block_number,
+                job.data,
+                job.length);
+            break;
+        case DFU_INT_FLASH_ABORT:
+            dfu_common_abort_download();
+            break;
+        case DFU_INT_FLASH_FLUSH:
+        default:
+            break;
+        }
+
+        if (retval != DFU_INT_DFU_STATUS_OK &&
+            (flash_writer.status_generation != job.download_generation ||
+             flash_writer.status == DFU_INT_DFU_STATUS_OK))
+        {
+            // Keep the first error of each download
+            flash_writer.status = retval;
+            flash_writer.status_generation = job.download_generation;
+        }
+
+        if (job.op == DFU_INT_FLASH_PROGRAM)
+        {
+            xSemaphoreGive(flash_writer.free_buffer);
+        }
+        else if (job.op == DFU_INT_FLASH_FLUSH)
+        {
+            xSemaphoreGive(flash_writer.flushed);
+        }
+    }
+}
+#endif
+
 /* Some readability functions */
 
 static void dfu_int_reset_download_buffer()
 {
     dfu_data.data_xfer_length = 0;
-    dfu_data.frag_number = 0;
+    dfu_data.fill_level = 0;
     dfu_data.download_block_number = 0;
     memset(dfu_data.dfu_data_buffer, 0, DFU_SECTOR_SIZE);
+    dfu_lz_init(&dfu_data.lz);
 }
 
 static void dfu_int_reset_state()
@@ -362,6 +564,13 @@ static void dfu_int_reset_state()
     dfu_data.move_to_error = false;
     dfu_data.move_to_error_status = DFU_INT_DFU_STATUS_OK;
     dfu_int_reset_download_buffer();
+    // Any download in progress is abandoned
+#if DFU_INT_PIPELINED_WRITE
+    dfu_int_flash_writer_queue(DFU_INT_FLASH_ABORT, NULL, 0);
+#else
+    dfu_common_abort_download();
+#endif
+    dfu_data.download_generation += 1;
 }
 
 static void dfu_int_error(dfu_int_status_t status)
@@ -371,6 +580,121 @@ static void dfu_int_error(dfu_int_status_t status)
     dfu_data.current_status = status;
 }
 
+/*
+ * Assembles the last DNLOAD payload into the download buffer, decompressing it
+ * first if it is compressed. The payload may complete one block and start the
+ * next, as the transfer size need not divide the sector size, and a compressed
+ * payload may complete several. Each complete block is written to flash.
+ */
+static dfu_int_status_t dfu_int_store_payload()
+{
+    dfu_int_status_t retval = DFU_INT_DFU_STATUS_OK;
+    const uint8_t *data = dfu_data.xfer_buffer;
+    size_t length = dfu_data.data_xfer_length;
+    const bool compressed = (dfu_data.payload_format == DFU_INT_PAYLOAD_FORMAT_LZ);
+
+    // The decoder may still have the end of a match to copy once the payload is consumed
+    while ((length > 0 || (compressed && !dfu_lz_complete(&dfu_data.lz))) &&
+           retval == DFU_INT_DFU_STATUS_OK)
+    {
+        uint16_t start = dfu_data.fill_level;
+        size_t copy_length = DFU_SECTOR_SIZE - start;
+
+        if (compressed)
+        {
+            if (!dfu_lz_decode(&dfu_data.lz, &data, &length,
+                               &dfu_data.dfu_data_buffer[start], &copy_length))
+            {
+                retval = DFU_INT_DFU_STATUS_ERR_FILE;
+            }
+            else if (copy_length == 0)
+            {
+                // The payload ended part way through a token
+                break;
+            }
+        }
+        else
+        {
+            copy_length = (length < copy_length) ? length : copy_length;
+            memcpy(&dfu_data.dfu_data_buffer[start], data, copy_length);
+            data += copy_length;
+            length -= copy_length;
+        }
+        dfu_data.fill_level += copy_length;
+
+#if DFU_INT_PIPELINED_WRITE
+        if (start == 0 && copy_length > 0)
+        {
+            // Erase the sector for this block while it arrives
+            dfu_int_flash_writer_queue(DFU_INT_FLASH_ERASE, NULL, 0);
+        }
+#endif
+
+        if (dfu_data.fill_level == DFU_SECTOR_SIZE)
+        {
+#if DFU_INT_PIPELINED_WRITE
+            /*
+             * We've assembled a full download buffer. Once the previous block
+             * has been programmed from the other buffer, hand this one to the
+             * flash writer and carry on filling the other one.
+             */
+            xSemaphoreTake(flash_writer.free_buffer, RTOS_OSAL_WAIT_FOREVER);
+            dfu_int_flash_writer_queue(DFU_INT_FLASH_PROGRAM, dfu_data.dfu_data_buffer, DFU_SECTOR_SIZE);
+            dfu_data.fill_buffer ^= 1;
+            dfu_data.dfu_data_buffer = dfu_data.dfu_data_buffers[dfu_data.fill_buffer];
+#else
+            // We've assembled a full download buffer. Write it.
+            retval = dfu_common_write_to_flash(
+                dfu_data.alt_setting,
+                dfu_data.download_block_number,
+                dfu_data.dfu_data_buffer,
+                DFU_SECTOR_SIZE);
+#endif
+            memset(dfu_data.dfu_data_buffer, 0, DFU_SECTOR_SIZE);
+            dfu_data.fill_level = 0;
+            dfu_data.download_block_number += 1;
+        }
+    }
+#if DFU_INT_PIPELINED_WRITE
+    if (retval == DFU_INT_DFU_STATUS_OK)
+    {
+        // Pick up any error from the blocks written so far
+        retval = dfu_int_flash_writer_status();
+    }
+#endif
+    return retval;
+}
+
+/*
+ * Writes the last block of the download if it is shorter than a sector, as
+ * the image need not be a whole number of sectors. The rest of its sector is
+ * left erased.
+ */
+static dfu_int_status_t dfu_int_store_final_block()
+{
+    dfu_int_status_t retval = DFU_INT_DFU_STATUS_OK;
+
+    if (dfu_data.fill_level > 0)
+    {
+#if DFU_INT_PIPELINED_WRITE
+        // The sector was erased when the block's first payload arrived
+        xSemaphoreTake(flash_writer.free_buffer, RTOS_OSAL_WAIT_FOREVER);
+        dfu_int_flash_writer_queue(DFU_INT_FLASH_PROGRAM, dfu_data.dfu_data_buffer, dfu_data.fill_level);
+        dfu_data.fill_buffer ^= 1;
+        dfu_data.dfu_data_buffer = dfu_data.dfu_data_buffers[dfu_data.fill_buffer];
+#else
+        retval = dfu_common_write_to_flash(
+            dfu_data.alt_setting,
+            dfu_data.download_block_number,
+            dfu_data.dfu_data_buffer,
+            dfu_data.fill_level);
+#endif
+    }
+    // Fully reset the download buffer, just to be neat.
+    dfu_int_reset_download_buffer();
+    return retval;
+}
+
 /*
  * State machine function. This is a separate RTOS task.
  * Has three notification boxes: "what event has occured", "how many events have
@@ -389,6 +713,26 @@ void dfu_int_state_machine(void *args)
     /* Initialise the state machine */
     dfu_data.task_handle = xTaskGetCurrentTaskHandle();
     dfu_data.alt_setting = DFU_INT_ALTERNATE_FACTORY;
+    dfu_data.requested_alt_setting = DFU_INT_ALTERNATE_FACTORY;
+    dfu_data.xfer_size = DFU_DATA_XFER_SIZE;
+    dfu_data.payload_format = DFU_INT_PAYLOAD_FORMAT_RAW;
+    dfu_data.fill_buffer = 0;
+    dfu_data.dfu_data_buffer = dfu_data.dfu_data_buffers[0];
+#if DFU_INT_PIPELINED_WRITE
+    /* Start the flash writer, with the buffer not being filled free */
+    flash_writer.job_queue = xQueueCreate(DFU_INT_FLASH_JOB_QUEUE_LENGTH, sizeof(dfu_int_flash_job_t));
+    flash_writer.free_buffer = xSemaphoreCreateBinary();
+    flash_writer.flushed = xSemaphoreCreateBinary();
+    xSemaphoreGive(flash_writer.free_buffer);
+    xTaskCreate(
+        dfu_int_flash_writer,
+        "DFU flash writer task",
+        RTOS_THREAD_STACK_SIZE(dfu_int_flash_writer),
+        NULL,
+        uxTaskPriorityGet(NULL),
+        NULL
+    );
+#endif
     dfu_int_reset_state();
     /* Sit in a loop and wait for mail */
     while (1)
@@ -443,11 +787,12 @@ void dfu_int_state_machine(void *args)
              * If in dfuDNLOAD-IDLE and length > 0, pushes to dfuDNLOAD-SYNC.
              * If in dfuDNLOAD-IDLE and length is 0, pushes to dfuMANIFEST-SYNC.
              *
-             * TODO: There is provision in the specification that if in
+             * There is provision in the specification that if in
              *  dfuDNLOAD-IDLE and length is 0, but the device does not think
              *  that it has enough data, then we can push to dfuERROR with
-             *  status errNOTDONE. We do not currently implement this behaviour
-             *  in INT or in USB.
+             *  status errNOTDONE. We only do this for a compressed download
+             *  that ends part way through a token. It is not implemented for
+             *  raw downloads in INT, or in USB.
              *
              *                   Any other state
              *                         or X
@@ -492,12 +837,16 @@ void dfu_int_state_machine(void *args)
                     dfu_data.current_state = DFU_INT_DFU_DNLOAD_SYNC;
                     // We don't do anything else until we get a GETSTATUS
                 }
-                else // fill_level == 0, so end of download phase
+                else if (dfu_data.payload_format == DFU_INT_PAYLOAD_FORMAT_LZ &&
+                         !dfu_lz_complete(&dfu_data.lz))
+                {
+                    dfu_int_error(DFU_INT_DFU_STATUS_ERR_NOTDONE);
+                }
+                else // Zero length packet, so end of download phase
                 {
                     // Time to manifest. Set the "in progress" flag.
+                    // The manifest writes any partial last block first.
                     dfu_data.download_or_manifest_in_progress = true;
-                    // Fully reset the download buffer, just to be neat.
-                    dfu_int_reset_download_buffer();
                     // Then move to the sync state
                     dfu_data.current_state = DFU_INT_DFU_MANIFEST_SYNC;
                     // We don't do anything else until we get a GETSTATUS
@@ -550,9 +899,9 @@ void dfu_int_state_machine(void *args)
                     dfu_data.alt_setting,
                     dfu_data.transfer_block,
                     dfu_data.dfu_data_buffer,
-                    DFU_DATA_XFER_SIZE);
+                    dfu_data.xfer_size);
 
-                if (dfu_data.data_xfer_length < DFU_DATA_XFER_SIZE)
+                if (dfu_data.data_xfer_length < dfu_data.xfer_size)
                 {
                     debug_printf("Fill level %d, resetting!\n",
                                  dfu_data.data_xfer_length);
@@ -647,31 +996,7 @@ void dfu_int_state_machine(void *args)
                      * another block or to move to manifestation.
                      */
                     dfu_data.current_state = DFU_INT_DFU_DNBUSY;
-                    /*
-                     * From here on, we assume that DFU_DATA_XFER_SIZE is an
-                     * integer factor of DFU_SECTOR_SIZE. I'm not going to
-                     * waste cycles asserting on this, so reader beware, please
-                     * make sure this is always the case (unless you want to do
-                     * some horrible maths!)
-                     */
-                    dfu_int_status_t retval = DFU_INT_DFU_STATUS_OK;
-
-                    if (dfu_data.frag_number == (DFU_NUM_FRAGMENTS - 1))
-                    {
-                        // We've assembled a full download buffer. Write it.
-                        retval = dfu_common_write_to_flash(
-                            dfu_data.alt_setting,
-                            dfu_data.download_block_number,
-                            dfu_data.dfu_data_buffer,
-                            DFU_SECTOR_SIZE);
-                        memset(dfu_data.dfu_data_buffer, 0, DFU_SECTOR_SIZE);
-                        dfu_data.frag_number = 0;
-                        dfu_data.download_block_number += 1;
-                    }
-                    else
-                    {
-                        dfu_data.frag_number += 1;
-                    }
+                    dfu_int_status_t retval = dfu_int_store_payload();
                     dfu_data.download_or_manifest_in_progress = false;
                     if (dfu_data.move_to_error)
                     {
@@ -720,7 +1045,18 @@ void dfu_int_state_machine(void *args)
                      * as a result of that.
                      */
                     dfu_data.current_state = DFU_INT_DFU_MANIFEST;
-                    dfu_int_status_t retval = dfu_common_make_manifest();
+                    dfu_int_status_t retval = dfu_int_store_final_block();
+#if DFU_INT_PIPELINED_WRITE
+                    if (retval == DFU_INT_DFU_STATUS_OK)
+                    {
+                        // Wait for the last blocks to be written
+                        retval = dfu_int_flash_writer_flush();
+                    }
+#endif
+                    if (retval == DFU_INT_DFU_STATUS_OK)
+                    {
+                        retval = dfu_common_make_manifest();
+                    }
                     dfu_data.download_or_manifest_in_progress = false;
                     if (dfu_data.move_to_error)
                     {
@@ -850,15 +1186,21 @@ void dfu_int_state_machine(void *args)
         {
             /*
              * dfu_int_reset_state() purposefully doesn't change the alternate
-             * setting, so we use it here, regardless of the fact the servicer
-             * has updated this already
+             * setting, so we use it here.
              *
              * To match the USB implementation, this request resets the state
              * machine. Therefore, set the alternate setting, and then we call
              * reset_state(). Moving to error resets everything else about the
              * state machine, so no need to do anything else here in that
              * instance.
+             *
+             * The alternate, transfer size and payload format are changed
+             * here rather than by the servicer, so a block of a transfer in
+             * progress is never handled with some of them changed.
              */
+            dfu_data.alt_setting = dfu_data.requested_alt_setting;
+            dfu_data.xfer_size = DFU_DATA_XFER_SIZE;
+            dfu_data.payload_format = DFU_INT_PAYLOAD_FORMAT_RAW;
             dfu_int_reset_state();
             break;
         } // end of case DFU_INT_TASK_BIT_SETALTERNATE
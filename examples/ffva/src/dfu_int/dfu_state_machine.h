@@ -12,20 +12,35 @@
 #include "dfu_common.h"
 
 /**
- * \brief Defines the size of the internal data buffer. Should match the size
- *   of the payload transmitted over device control.
+ * \brief Defines the default size of the data in a DNLOAD or UPLOAD payload.
+ *   This is the size used until the host negotiates another one with
+ *   dfu_int_set_transfer_size(), so hosts that do not negotiate keep working.
  */
 #define DFU_DATA_XFER_SIZE 128
+/**
+ * \brief Defines the largest size of the data in a DNLOAD or UPLOAD payload
+ *   that may be negotiated. The device control I2C transport sends the length
+ *   of a command in one byte, so the data, its 2 byte length marker and the
+ *   command header must fit in 255 bytes.
+ */
+#define DFU_DATA_XFER_MAX_SIZE 248
 /**
  * \brief Defines the size of a flash sector; used to assemble multiple payloads
- *   into one write operation.
+ *   into one write operation. Payloads need not divide it evenly; a payload
+ *   may complete one sector and start the next.
  */
-#define DFU_SECTOR_SIZE 4096
+#define DFU_SECTOR_SIZE DFU_FLASH_SECTOR_SIZE
+
 /**
- * \brief Defines the number of payloads required to fill one flash sector. It is
- *   assumed that #DFU_DATA_XFER_SIZE is an integer factor of #DFU_SECTOR_SIZE.
+ * \brief Set non-zero to overlap flash operations with the download. Each
+ *   sector is erased in the background once its first payload arrives, and a
+ *   complete sector is programmed in the background from one of two buffers
+ *   while the next sector is assembled in the other. Set to zero to erase and
+ *   program each sector in the DNBUSY state once it is complete.
  */
-#define DFU_NUM_FRAGMENTS (DFU_SECTOR_SIZE / DFU_DATA_XFER_SIZE)
+#ifndef DFU_INT_PIPELINED_WRITE
+#define DFU_INT_PIPELINED_WRITE 1
+#endif
 
 /**
  * \enum dfu_int_alt_setting_t
@@ -45,6 +60,24 @@ typedef enum dfu_int_alt_setting_t
     DFU_INT_ALTERNATE_UPGRADE
 } dfu_int_alt_setting_t;
 
+/**
+ * \enum dfu_int_payload_format_t
+ * \brief Sets up identifiers for the formats of the data in DNLOAD payloads.
+ *
+ * \var dfu_int_payload_format_t::DFU_INT_PAYLOAD_FORMAT_RAW
+ *   The payloads are the image itself.
+ * \var dfu_int_payload_format_t::DFU_INT_PAYLOAD_FORMAT_LZ
+ *   The payloads are the image compressed as described in dfu_lz.h. They are
+ *   decompressed as they arrive into the sectors written to flash.
+ *
+ */
+typedef enum dfu_int_payload_format_t
+{
+    DFU_INT_PAYLOAD_FORMAT_RAW,
+    DFU_INT_PAYLOAD_FORMAT_LZ,
+    DFU_INT_NUM_PAYLOAD_FORMATS
+} dfu_int_payload_format_t;
+
 /**
  * \enum dfu_int_state_t
  * \brief Sets up identifiers for the different states in the DFU state machine.
@@ -135,7 +168,7 @@ void dfu_int_detach();
  *
  * This function will copy \p length bytes of the \p download_data buffer
  *   into a buffer internal to dfu_state_machine.c, before notifying the state
- *   machine and returning. If \p length is given as 0, the state machine will
+ *   machine and returning. \p length must not be more than the transfer size. If \p length is given as 0, the state machine will
  *   regard this as the end of the download process and will move to the
  *   manifestation phase.
  *
@@ -198,7 +231,9 @@ void dfu_int_abort();
 /**
  * \brief Sets the alternate interface used in UPLOAD and DNLOAD operations.
  *
- * This request will also always reset the state machine.
+ * This request will also always reset the state machine, the transfer size
+ *   to #DFU_DATA_XFER_SIZE and the payload format to
+ *   #DFU_INT_PAYLOAD_FORMAT_RAW.
  *
  * \param[in] alt Alternate setting to change to.
  */
@@ -208,7 +243,7 @@ void dfu_int_set_alternate(dfu_int_alt_setting_t alt);
  * \brief Sets the transfer block number for use in an UPLOAD operation.
  *
  * The DFU_UPLOAD request will return the data found at this transfer block.
- *   The transfer block size for this implementation is 64 bytes.
+ *   The transfer block size is the transfer size.
  *   This number will automatically increment on every successful DFU_UPLOAD.
  *   This number will default to 0. Therefore, to read the entire image, it is
  *   not necessary to first set this value.
@@ -228,6 +263,47 @@ void dfu_int_set_transfer_block(uint16_t transferblock);
  */
 uint16_t dfu_int_get_transfer_block();
 
+/**
+ * \brief Sets the size of the data in each DNLOAD and UPLOAD payload.
+ *
+ * The size may only be changed in the dfuIDLE state, and is reset to
+ *   #DFU_DATA_XFER_SIZE by dfu_int_set_alternate(). Larger payloads take fewer
+ *   DNLOAD, UPLOAD and GETSTATUS requests to transfer an image.
+ *
+ * \param[in] size Bytes of data in each payload, from 1 to
+ *                 #DFU_DATA_XFER_MAX_SIZE.
+ * \return         bool true if the size was set, false if it is out of range
+ *                 or the state machine is not in the dfuIDLE state.
+ */
+bool dfu_int_set_transfer_size(uint16_t size);
+
+/**
+ * \brief Retrieves the size of the data in each DNLOAD and UPLOAD payload.
+ *
+ * \return uint16_t Current transfer size.
+ */
+uint16_t dfu_int_get_transfer_size();
+
+/**
+ * \brief Sets the format of the data in DNLOAD payloads.
+ *
+ * The format may only be changed in the dfuIDLE state, and is reset to
+ *   #DFU_INT_PAYLOAD_FORMAT_RAW by dfu_int_set_alternate(). A compressed image
+ *   takes fewer DNLOAD requests to transfer. Uploads are not compressed.
+ *
+ * \param[in] format A dfu_int_payload_format_t.
+ * \return           bool true if the format was set, false if it is unknown
+ *                   or the state machine is not in the dfuIDLE state.
+ */
+bool dfu_int_set_payload_format(uint8_t format);
+
+/**
+ * \brief Retrieves the format of the data in DNLOAD payloads.
+ *
+ * \return dfu_int_payload_format_t Current payload format.
+ */
+dfu_int_payload_format_t dfu_int_get_payload_format();
+
 /**
  * \brief RTOS task running the DFU state machine.
  *
@@ -237,7 +313,8 @@ uint16_t dfu_int_get_transfer_block();
  *   read a value in notification index 1 to determine how many requests have
  *   been issued since the last time the task awoke; must be exactly 1 or the
  *   state machine will move to the error state. Notification index 2 is
- *   currently unused.
+ *   currently unused. If #DFU_INT_PIPELINED_WRITE is set, this task also
+ *   creates the flash writer task, which erases and programs the flash.
  *
  * \param[in] args Unused
  */
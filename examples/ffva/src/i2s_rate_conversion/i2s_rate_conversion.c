@@ -0,0 +1,53 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "i2s_rate_conversion.h"
+
+void i2s_upsampler_init(i2s_upsampler_t *state)
+{
+    memset(state, 0, sizeof(i2s_upsampler_t));
+}
+
+void i2s_downsampler_init(i2s_downsampler_t *state)
+{
+    memset(state, 0, sizeof(i2s_downsampler_t));
+}
+
+void i2s_upsample_frame(i2s_upsampler_t *state,
+                        int32_t output[][I2S_RATE_CONVERSION_CHANNELS],
+                        const int32_t *input[I2S_RATE_CONVERSION_CHANNELS],
+                        size_t frame_count)
+{
+    /*
+     * Each input sample is pushed into the filter history with the last
+     * phase, the other two phases reuse the same history.
+     */
+    for (int i = 0; i < frame_count; i++) {
+        for (int ch = 0; ch < I2S_RATE_CONVERSION_CHANNELS; ch++) {
+            output[3*i + 0][ch] = src_us3_voice_input_sample(state->data[ch], src_ff3v_fir_coefs[2], input[ch][i]);
+            output[3*i + 1][ch] = src_us3_voice_get_next_sample(state->data[ch], src_ff3v_fir_coefs[1]);
+            output[3*i + 2][ch] = src_us3_voice_get_next_sample(state->data[ch], src_ff3v_fir_coefs[0]);
+        }
+    }
+}
+
+void i2s_downsample_frame(i2s_downsampler_t *state,
+                          int32_t *output[I2S_RATE_CONVERSION_CHANNELS],
+                          const int32_t input[][I2S_RATE_CONVERSION_CHANNELS],
+                          size_t frame_count)
+{
+    /*
+     * Each phase has its own filter history. The three input samples that
+     * make up one output sample are accumulated phase by phase.
+     */
+    for (int i = 0; i < frame_count; i++) {
+        for (int ch = 0; ch < I2S_RATE_CONVERSION_CHANNELS; ch++) {
+            int64_t sum = 0;
+            sum = src_ds3_voice_add_sample(sum, state->data[ch][0], src_ff3v_fir_coefs[0], input[3*i + 0][ch]);
+            sum = src_ds3_voice_add_sample(sum, state->data[ch][1], src_ff3v_fir_coefs[1], input[3*i + 1][ch]);
+            output[ch][i] = src_ds3_voice_add_final_sample(sum, state->data[ch][2], src_ff3v_fir_coefs[2], input[3*i + 2][ch]);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef I2S_RATE_CONVERSION_H_
+#define I2S_RATE_CONVERSION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "src.h"
+
+/*
+ * Frame based conversion of stereo I2S audio between the pipeline sampling
+ * rate and 3x the pipeline sampling rate, using the lib_src fixed factor of 3
+ * voice filters.
+ *
+ * The output is bit exact with running the same filters one I2S sample at a
+ * time, in the order the I2S send and receive filter callbacks used to run
+ * them. A whole pipeline frame is converted in one call from the audio
+ * pipeline input and output functions, so the I2S driver only copies samples.
+ */
+
+#define I2S_RATE_CONVERSION_CHANNELS   2
+
+typedef struct {
+    int32_t data[I2S_RATE_CONVERSION_CHANNELS][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned(8)));
+} i2s_upsampler_t;
+
+typedef struct {
+    int32_t data[I2S_RATE_CONVERSION_CHANNELS][SRC_FF3V_FIR_NUM_PHASES][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned(8)));
+} i2s_downsampler_t;
+
+void i2s_upsampler_init(i2s_upsampler_t *state);
+
+void i2s_downsampler_init(i2s_downsampler_t *state);
+
+/*
+ * Upsamples frame_count samples of each channel by 3.
+ *
+ * input holds I2S_RATE_CONVERSION_CHANNELS pointers to frame_count
+ * samples each, in channel sample format.
+ * output receives 3 * frame_count samples in sample channel format, as
+ * expected by rtos_i2s_tx().
+ */
+void i2s_upsample_frame(i2s_upsampler_t *state,
+                        int32_t output[][I2S_RATE_CONVERSION_CHANNELS],
+                        const int32_t *input[I2S_RATE_CONVERSION_CHANNELS],
+                        size_t frame_count);
+
+/*
+ * Downsamples 3 * frame_count samples of each channel by 3.
+ *
+ * input holds 3 * frame_count samples in sample channel format, as
+ * received by rtos_i2s_rx().
+ * output holds I2S_RATE_CONVERSION_CHANNELS pointers that each receive
+ * frame_count samples, in channel sample format.
+ */
+void i2s_downsample_frame(i2s_downsampler_t *state,
+                          int32_t *output[I2S_RATE_CONVERSION_CHANNELS],
+                          const int32_t input[][I2S_RATE_CONVERSION_CHANNELS],
+                          size_t frame_count);
+
+#endif /* I2S_RATE_CONVERSION_H_ */
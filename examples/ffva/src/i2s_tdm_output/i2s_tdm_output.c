@@ -0,0 +1,26 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include "i2s_tdm_output.h"
+
+void i2s_tdm_output_pack(int32_t *output,
+                         const int32_t *frame,
+                         size_t frame_count,
+                         const i2s_tdm_slot_t *slot_map,
+                         size_t num_slots)
+{
+    /*
+     * One pass per slot, so the slot map is resolved once per frame rather
+     * than once per sample.
+     */
+    for (int s = 0; s < num_slots; s++) {
+        const int32_t *slot_input = frame + (slot_map[s].channel * frame_count);
+        const int32_t slot_tag = slot_map[s].lsb_tag & 0x1;
+        int32_t *slot_output = output + s;
+
+        for (int i = 0; i < frame_count; i++) {
+            *slot_output = (slot_input[i] & ~0x1) | slot_tag;
+            slot_output += num_slots;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef I2S_TDM_OUTPUT_H_
+#define I2S_TDM_OUTPUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Packs a whole pipeline frame into the TDM slot order expected by the I2S
+ * driver, so that it can be sent with a single rtos_i2s_tx() call.
+ *
+ * Each TDM slot carries one channel of the pipeline output frame, with its
+ * LSB replaced by a tag so the receiver can find the slot alignment.
+ */
+
+typedef struct {
+    uint8_t channel;    /* Channel of the pipeline output frame carried by this slot */
+    uint8_t lsb_tag;    /* Value, 0 or 1, written to the LSB of every sample in this slot */
+} i2s_tdm_slot_t;
+
+/* Initializer for one entry of a slot map */
+#define I2S_TDM_SLOT(CHANNEL, LSB_TAG) { .channel = (CHANNEL), .lsb_tag = (LSB_TAG) }
+
+/*
+ * frame holds the pipeline output frame in channel sample format, with
+ * frame_count samples per channel.
+ * output receives num_slots * frame_count samples, slot by slot for each
+ * pipeline sample. Sent as I2S frames of 2 samples, this is
+ * (num_slots / 2) * frame_count I2S frames.
+ */
+void i2s_tdm_output_pack(int32_t *output,
+                         const int32_t *frame,
+                         size_t frame_count,
+                         const i2s_tdm_slot_t *slot_map,
+                         size_t num_slots);
+
+#endif /* I2S_TDM_OUTPUT_H_ */
@@ -4,6 +4,7 @@
 #include <platform.h>
 #include <xs1.h>
 #include <xcore/channel.h>
+#include <xcore/hwtimer.h>
 
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
@@ -24,6 +25,8 @@
 #include "usb_audio.h"
 #include "audio_pipeline.h"
 #include "dfu_servicer.h"
+#include "tuning_servicer.h"
+#include "telemetry_servicer.h"
 
 /* Headers used for the WW intent engine */
 #if appconfINTENT_ENABLED
@@ -34,6 +37,9 @@
 #include "leds.h"
 #endif
 #include "gpio_test/gpio_test.h"
+#include "i2s_rate_conversion/i2s_rate_conversion.h"
+#include "i2s_tdm_output/i2s_tdm_output.h"
+#include "audio_format.h"
 
 /* Config headers for sw_pll */
 #include "sw_pll.h"
@@ -44,7 +50,7 @@ volatile int aec_ref_source = appconfAEC_REF_DEFAULT;
 #if appconfI2S_ENABLED && (appconfI2S_MODE == appconfI2S_MODE_SLAVE)
 void i2s_slave_intertile(void *args) {
     (void) args;
-    int32_t tmp[appconfAUDIO_PIPELINE_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
+    int32_t tmp[appconfI2S_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
 
     while(1) {
         memset(tmp, 0x00, sizeof(tmp));
@@ -64,7 +70,7 @@ void i2s_slave_intertile(void *args) {
 
         rtos_i2s_tx(i2s_ctx,
                     (int32_t*) tmp,
-                    appconfAUDIO_PIPELINE_FRAME_ADVANCE,
+                    appconfI2S_FRAME_ADVANCE,
                     portMAX_DELAY);
 
 
@@ -90,6 +96,12 @@ void audio_pipeline_input(void *input_app_data,
     (void) input_app_data;
     int32_t **mic_ptr = (int32_t **)(input_audio_frames + (2 * frame_count));
 
+    /* The sources may be changed by the tuning servicer or the buttons at any time, so only switch between frames */
+    const int frame_mic_from_usb = mic_from_usb;
+    const int frame_aec_ref_source = aec_ref_source;
+    (void) frame_mic_from_usb;
+    (void) frame_aec_ref_source;
+
     static int flushed;
     while (!flushed) {
         size_t received;
@@ -121,11 +133,11 @@ void audio_pipeline_input(void *input_app_data,
     int32_t **usb_mic_audio_frame = NULL;
     size_t ch_cnt = 2;  /* ref frames */
 
-    if (aec_ref_source == appconfAEC_REF_USB) {
+    if (frame_aec_ref_source == appconfAEC_REF_USB) {
         usb_mic_audio_frame = input_audio_frames;
     }
 
-    if (mic_from_usb) {
+    if (frame_mic_from_usb) {
         ch_cnt += 2;  /* mic frames */
     }
 
@@ -140,26 +152,30 @@ void audio_pipeline_input(void *input_app_data,
 #endif
 
 #if appconfI2S_ENABLED
-    if (!appconfUSB_ENABLED || aec_ref_source == appconfAEC_REF_I2S) {
+    if (!appconfUSB_ENABLED || frame_aec_ref_source == appconfAEC_REF_I2S) {
         /* This shouldn't need to block given it shares a clock with the PDM mics */
 
         xassert(frame_count == appconfAUDIO_PIPELINE_FRAME_ADVANCE);
         /* I2S provides sample channel format */
-        int32_t tmp[appconfAUDIO_PIPELINE_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
+        static int32_t tmp[appconfI2S_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
         int32_t *tmpptr = (int32_t *)input_audio_frames;
 
         size_t rx_count =
         rtos_i2s_rx(i2s_ctx,
                     (int32_t*) tmp,
-                    frame_count,
+                    appconfI2S_FRAME_ADVANCE,
                     portMAX_DELAY);
-        xassert(rx_count == frame_count);
+        xassert(rx_count == appconfI2S_FRAME_ADVANCE);
 
-        for (int i=0; i<frame_count; i++) {
-            /* ref is first */
-            *(tmpptr + i) = tmp[i][0];
-            *(tmpptr + i + frame_count) = tmp[i][1];
-        }
+#if appconfI2S_RATE_CONVERSION_ENABLED
+        static i2s_downsampler_t downsampler;
+        /* ref is first */
+        int32_t *ref_ptr[I2S_RATE_CONVERSION_CHANNELS] = {tmpptr, tmpptr + frame_count};
+        i2s_downsample_frame(&downsampler, ref_ptr, tmp, frame_count);
+#else
+        /* ref is first */
+        audio_format_deinterleave(tmpptr, frame_count, &tmp[0][0], appconfAUDIO_PIPELINE_CHANNELS, frame_count);
+#endif
     }
 #endif
 
@@ -172,55 +188,84 @@ int audio_pipeline_output(void *output_app_data,
 {
     (void) output_app_data;
 #if appconfI2S_ENABLED
+#if appconfI2S_OUTPUT_PROFILE
+    static uint32_t max_time = 0;
+    uint32_t start = get_reference_time();
+#endif
 #if appconfI2S_MODE == appconfI2S_MODE_MASTER
 #if !appconfI2S_TDM_ENABLED
     xassert(frame_count == appconfAUDIO_PIPELINE_FRAME_ADVANCE);
     /* I2S expects sample channel format */
-    int32_t tmp[appconfAUDIO_PIPELINE_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
+    static int32_t tmp[appconfI2S_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
     int32_t *tmpptr = (int32_t *)output_audio_frames;
-    for (int j=0; j<frame_count; j++) {
-        /* ASR output is first */
-        tmp[j][0] = *(tmpptr+j+(2*frame_count));    // ref 0
-        tmp[j][1] = *(tmpptr+j+(3*frame_count));    // ref 1
-    }
+#if appconfI2S_RATE_CONVERSION_ENABLED
+    static i2s_upsampler_t upsampler;
+    const int32_t *ref_ptr[I2S_RATE_CONVERSION_CHANNELS] = {
+        tmpptr + (2*frame_count),   // ref 0
+        tmpptr + (3*frame_count)    // ref 1
+    };
+    i2s_upsample_frame(&upsampler, tmp, ref_ptr, frame_count);
+#else
+    /* ref 0 and ref 1 */
+    audio_format_interleave(&tmp[0][0], tmpptr + (2*frame_count), frame_count, appconfAUDIO_PIPELINE_CHANNELS, frame_count);
+#endif
 
     rtos_i2s_tx(i2s_ctx,
                 (int32_t*) tmp,
-                frame_count,
+                appconfI2S_FRAME_ADVANCE,
                 portMAX_DELAY);
 #else
-    int32_t *tmpptr = (int32_t *)output_audio_frames;
-    for (int i = 0; i < frame_count; i++) {
-        /* output_audio_frames format is
-         *   processed_audio_frame
-         *   reference_audio_frame
-         *   raw_mic_audio_frame
-         */
-        int32_t tdm_output[6];
-
-        tdm_output[0] = *(tmpptr + i + (4 * frame_count)) & ~0x1;   // mic 0
-        tdm_output[1] = *(tmpptr + i + (5 * frame_count)) & ~0x1;   // mic 1
-        tdm_output[2] = *(tmpptr + i + (2 * frame_count)) & ~0x1;   // ref 0
-        tdm_output[3] = *(tmpptr + i + (3 * frame_count)) & ~0x1;   // ref 1
-        tdm_output[4] = *(tmpptr + i) | 0x1;                        // proc 0
-        tdm_output[5] = *(tmpptr + i + frame_count) | 0x1;          // proc 1
+    /* output_audio_frames format is
+     *   processed_audio_frame
+     *   reference_audio_frame
+     *   raw_mic_audio_frame
+     */
+    static const i2s_tdm_slot_t slot_map[] = appconfI2S_TDM_SLOT_MAP;
+    #define TDM_NUM_SLOTS (sizeof(slot_map) / sizeof(slot_map[0]))
+    #define TDM_FRAME_CHANNELS (3 * appconfAUDIO_PIPELINE_CHANNELS)
+    static int32_t tdm_output[appconfAUDIO_PIPELINE_FRAME_ADVANCE * TDM_NUM_SLOTS];
+
+    /* Each pipeline sample is sent as TDM_NUM_SLOTS / 2 I2S frames, which only keeps up if that is the I2S rate over the pipeline rate */
+    _Static_assert((appconfI2S_AUDIO_SAMPLE_RATE % appconfAUDIO_PIPELINE_SAMPLE_RATE) == 0, "appconfI2S_AUDIO_SAMPLE_RATE must be a multiple of appconfAUDIO_PIPELINE_SAMPLE_RATE for TDM");
+    _Static_assert(TDM_NUM_SLOTS == 2 * (appconfI2S_AUDIO_SAMPLE_RATE / appconfAUDIO_PIPELINE_SAMPLE_RATE), "appconfI2S_TDM_SLOT_MAP must have 2 slots per I2S frame sent for each pipeline sample");
+
+    /* slot_map[i].channel isn't a constant expression, so expand the slot map again with each slot checking its channel */
+    #pragma push_macro("I2S_TDM_SLOT")
+    #undef I2S_TDM_SLOT
+    #define I2S_TDM_SLOT(CHANNEL, LSB_TAG) sizeof(struct { _Static_assert((CHANNEL) < TDM_FRAME_CHANNELS, "appconfI2S_TDM_SLOT_MAP channel must be less than the number of pipeline output channels"); char c; })
+    _Static_assert(sizeof((size_t[])appconfI2S_TDM_SLOT_MAP) == TDM_NUM_SLOTS * sizeof(size_t), "appconfI2S_TDM_SLOT_MAP channel check must cover every slot");
+    #pragma pop_macro("I2S_TDM_SLOT")
 
-        rtos_i2s_tx(i2s_ctx,
-                    tdm_output,
-                    appconfI2S_AUDIO_SAMPLE_RATE / appconfAUDIO_PIPELINE_SAMPLE_RATE,
-                    portMAX_DELAY);
-    }
+    xassert(frame_count == appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    i2s_tdm_output_pack(tdm_output,
+                        (const int32_t *)output_audio_frames,
+                        frame_count,
+                        slot_map,
+                        TDM_NUM_SLOTS);
+
+    /* The I2S driver sends 2 slots per I2S frame */
+    rtos_i2s_tx(i2s_ctx,
+                tdm_output,
+                frame_count * (TDM_NUM_SLOTS / 2),
+                portMAX_DELAY);
 #endif
 
 #elif appconfI2S_MODE == appconfI2S_MODE_SLAVE
     /* I2S expects sample channel format */
-    int32_t tmp[appconfAUDIO_PIPELINE_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
+    static int32_t tmp[appconfI2S_FRAME_ADVANCE][appconfAUDIO_PIPELINE_CHANNELS];
     int32_t *tmpptr = (int32_t *)output_audio_frames;
-    for (int j=0; j<appconfAUDIO_PIPELINE_FRAME_ADVANCE; j++) {
-        /* ASR output is first */
-        tmp[j][0] = *(tmpptr+j);
-        tmp[j][1] = *(tmpptr+j+appconfAUDIO_PIPELINE_FRAME_ADVANCE);
-    }
+#if appconfI2S_RATE_CONVERSION_ENABLED
+    static i2s_upsampler_t upsampler;
+    /* ASR output is first */
+    const int32_t *asr_ptr[I2S_RATE_CONVERSION_CHANNELS] = {
+        tmpptr,
+        tmpptr + appconfAUDIO_PIPELINE_FRAME_ADVANCE
+    };
+    i2s_upsample_frame(&upsampler, tmp, asr_ptr, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+#else
+    /* ASR output is first */
+    audio_format_interleave(&tmp[0][0], tmpptr, appconfAUDIO_PIPELINE_FRAME_ADVANCE, appconfAUDIO_PIPELINE_CHANNELS, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+#endif
 
     rtos_intertile_tx(intertile_ctx,
                       appconfI2S_OUTPUT_SLAVE_PORT,
@@ -229,6 +274,13 @@ int audio_pipeline_output(void *output_app_data,
 #else
     #error "Invalid I2S mode"
 #endif
+#if appconfI2S_OUTPUT_PROFILE
+    uint32_t end = get_reference_time();
+    if (max_time < (end - start)) {
+        max_time = end - start;
+        rtos_printf("I2S output max time per frame: %u\n", max_time);
+    }
+#endif
 #endif
 
 #if appconfUSB_ENABLED
@@ -252,87 +304,6 @@ int audio_pipeline_output(void *output_app_data,
     return AUDIO_PIPELINE_FREE_FRAME;
 }
 
-RTOS_I2S_APP_SEND_FILTER_CALLBACK_ATTR
-size_t i2s_send_upsample_cb(rtos_i2s_t *ctx, void *app_data, int32_t *i2s_frame, size_t i2s_frame_size, int32_t *send_buf, size_t samples_available)
-{
-    static int i;
-    static int32_t src_data[2][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned(8)));
-
-    xassert(i2s_frame_size == 2);
-
-    switch (i) {
-    case 0:
-        i = 1;
-        if (samples_available >= 2) {
-            i2s_frame[0] = src_us3_voice_input_sample(src_data[0], src_ff3v_fir_coefs[2], send_buf[0]);
-            i2s_frame[1] = src_us3_voice_input_sample(src_data[1], src_ff3v_fir_coefs[2], send_buf[1]);
-            return 2;
-        } else {
-            i2s_frame[0] = src_us3_voice_input_sample(src_data[0], src_ff3v_fir_coefs[2], 0);
-            i2s_frame[1] = src_us3_voice_input_sample(src_data[1], src_ff3v_fir_coefs[2], 0);
-            return 0;
-        }
-    case 1:
-        i = 2;
-        i2s_frame[0] = src_us3_voice_get_next_sample(src_data[0], src_ff3v_fir_coefs[1]);
-        i2s_frame[1] = src_us3_voice_get_next_sample(src_data[1], src_ff3v_fir_coefs[1]);
-        return 0;
-    case 2:
-        i = 0;
-        i2s_frame[0] = src_us3_voice_get_next_sample(src_data[0], src_ff3v_fir_coefs[0]);
-        i2s_frame[1] = src_us3_voice_get_next_sample(src_data[1], src_ff3v_fir_coefs[0]);
-        return 0;
-    default:
-        xassert(0);
-        return 0;
-    }
-}
-
-RTOS_I2S_APP_RECEIVE_FILTER_CALLBACK_ATTR
-size_t i2s_send_downsample_cb(rtos_i2s_t *ctx, void *app_data, int32_t *i2s_frame, size_t i2s_frame_size, int32_t *receive_buf, size_t sample_spaces_free)
-{
-    static int i;
-    static int64_t sum[2];
-    static int32_t src_data[2][SRC_FF3V_FIR_NUM_PHASES][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned (8)));
-
-    xassert(i2s_frame_size == 2);
-
-    switch (i) {
-    case 0:
-        i = 1;
-        sum[0] = src_ds3_voice_add_sample(0, src_data[0][0], src_ff3v_fir_coefs[0], i2s_frame[0]);
-        sum[1] = src_ds3_voice_add_sample(0, src_data[1][0], src_ff3v_fir_coefs[0], i2s_frame[1]);
-        return 0;
-    case 1:
-        i = 2;
-        sum[0] = src_ds3_voice_add_sample(sum[0], src_data[0][1], src_ff3v_fir_coefs[1], i2s_frame[0]);
-        sum[1] = src_ds3_voice_add_sample(sum[1], src_data[1][1], src_ff3v_fir_coefs[1], i2s_frame[1]);
-        return 0;
-    case 2:
-        i = 0;
-        if (sample_spaces_free >= 2) {
-            receive_buf[0] = src_ds3_voice_add_final_sample(sum[0], src_data[0][2], src_ff3v_fir_coefs[2], i2s_frame[0]);
-            receive_buf[1] = src_ds3_voice_add_final_sample(sum[1], src_data[1][2], src_ff3v_fir_coefs[2], i2s_frame[1]);
-            return 2;
-        } else {
-            (void) src_ds3_voice_add_final_sample(sum[0], src_data[0][2], src_ff3v_fir_coefs[2], i2s_frame[0]);
-            (void) src_ds3_voice_add_final_sample(sum[1], src_data[1][2], src_ff3v_fir_coefs[2], i2s_frame[1]);
-            return 0;
-        }
-    default:
-        xassert(0);
-        return 0;
-    }
-}
-
-void i2s_rate_conversion_enable(void)
-{
-#if !appconfI2S_TDM_ENABLED
-    rtos_i2s_send_filter_cb_set(i2s_ctx, i2s_send_upsample_cb, NULL);
-#endif
-    rtos_i2s_receive_filter_cb_set(i2s_ctx, i2s_send_downsample_cb, NULL);
-}
-
 void vApplicationMallocFailedHook(void)
 {
     rtos_printf("Malloc Failed on tile %d!\n", THIS_XCORE_TILE);
@@ -389,6 +360,41 @@ void startup_task(void *arg)
         appconfDEVICE_CONTROL_I2C_PRIORITY,
         NULL
     );
+
+    servicer_t servicer_tuning;
+    tuning_servicer_init(&servicer_tuning);
+
+    xTaskCreate(
+        tuning_servicer,
+        "Tuning servicer",
+        RTOS_THREAD_STACK_SIZE(tuning_servicer),
+        &servicer_tuning,
+        appconfDEVICE_CONTROL_I2C_PRIORITY,
+        NULL
+    );
+
+    servicer_t servicer_telemetry;
+    telemetry_servicer_init(&servicer_telemetry);
+
+    xTaskCreate(
+        telemetry_servicer,
+        "Telemetry servicer",
+        RTOS_THREAD_STACK_SIZE(telemetry_servicer),
+        &servicer_telemetry,
+        appconfDEVICE_CONTROL_I2C_PRIORITY,
+        NULL
+    );
+#endif
+
+#if appconfI2C_DFU_ENABLED && ON_TILE(MICARRAY_TILE_NO)
+    xTaskCreate(
+        tuning_servicer_rx,
+        "Tuning rx",
+        RTOS_THREAD_STACK_SIZE(tuning_servicer_rx),
+        NULL,
+        appconfDEVICE_CONTROL_I2C_PRIORITY,
+        NULL
+    );
 #endif
 
 #if appconfINTENT_ENABLED && ON_TILE(0)
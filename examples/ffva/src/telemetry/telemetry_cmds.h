@@ -0,0 +1,47 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#pragma once
+
+#include <stdint.h>
+
+// Note: The enums are wrapped around a #ifndef block to keep the cmd_map files common between device and host,
+// the same as the DFU servicer commands.
+
+// TELEMETRY_SERVICER_RESID commands
+enum e_telemetry_servicer_resid_cmds
+{
+#ifndef TELEMETRY_SERVICER_RESID_COUNTERS
+    TELEMETRY_SERVICER_RESID_COUNTERS = 0,
+#endif
+#ifndef TELEMETRY_SERVICER_RESID_LEVELS
+    TELEMETRY_SERVICER_RESID_LEVELS = 1,
+#endif
+#ifndef TELEMETRY_SERVICER_RESID_STAGE_TICKS
+    TELEMETRY_SERVICER_RESID_STAGE_TICKS = 2,
+#endif
+#ifndef TELEMETRY_SERVICER_RESID_ALL
+    TELEMETRY_SERVICER_RESID_ALL = 3,
+#endif
+    NUM_TELEMETRY_SERVICER_RESID_CMDS = 4
+};
+
+// TELEMETRY_SERVICER_RESID number of elements
+// number of values of type telemetry_servicer_resid_counters_t expected by TELEMETRY_SERVICER_RESID_COUNTERS
+#define TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES (8)
+// number of values of type telemetry_servicer_resid_levels_t expected by TELEMETRY_SERVICER_RESID_LEVELS
+#define TELEMETRY_SERVICER_RESID_LEVELS_NUM_VALUES (28)
+// number of values of type telemetry_servicer_resid_stage_ticks_t expected by TELEMETRY_SERVICER_RESID_STAGE_TICKS
+#define TELEMETRY_SERVICER_RESID_STAGE_TICKS_NUM_VALUES (32)
+// number of values of type telemetry_servicer_resid_all_t expected by TELEMETRY_SERVICER_RESID_ALL
+#define TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES (68)
+
+// TELEMETRY_SERVICER_RESID types
+// type expected by TELEMETRY_SERVICER_RESID_COUNTERS
+typedef uint8_t telemetry_servicer_resid_counters_t;
+// type expected by TELEMETRY_SERVICER_RESID_LEVELS
+typedef uint8_t telemetry_servicer_resid_levels_t;
+// type expected by TELEMETRY_SERVICER_RESID_STAGE_TICKS
+typedef uint8_t telemetry_servicer_resid_stage_ticks_t;
+// type expected by TELEMETRY_SERVICER_RESID_ALL
+typedef uint8_t telemetry_servicer_resid_all_t;
@@ -0,0 +1,17 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-variable"
+
+// TELEMETRY_SERVICER_RESID command map
+// This array may be unused as servicers can be moved between tiles
+// Unused variable warnings are suppressed in this header file
+static control_cmd_info_t telemetry_servicer_resid_cmd_map[] =
+{
+    { TELEMETRY_SERVICER_RESID_COUNTERS, 8, sizeof(uint8_t), CMD_READ_ONLY },
+    { TELEMETRY_SERVICER_RESID_LEVELS, 28, sizeof(uint8_t), CMD_READ_ONLY },
+    { TELEMETRY_SERVICER_RESID_STAGE_TICKS, 32, sizeof(uint8_t), CMD_READ_ONLY },
+    { TELEMETRY_SERVICER_RESID_ALL, 68, sizeof(uint8_t), CMD_READ_ONLY },
+};
+#pragma clang diagnostic pop
@@ -0,0 +1,150 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#define DEBUG_UNIT TELEMETRY_SERVICER
+#ifndef DEBUG_PRINT_ENABLE_TELEMETRY_SERVICER
+#define DEBUG_PRINT_ENABLE_TELEMETRY_SERVICER 0
+#endif
+#include "debug_print.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <platform.h>
+#include <xassert.h>
+
+#include "platform/platform_conf.h"
+#include "servicer.h"
+#include "telemetry_servicer.h"
+
+#include "telemetry_cmds.h"
+#include "device_control_i2c.h"
+
+#include "audio_pipeline_telemetry.h"
+
+static void put_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static uint8_t *put_counters(uint8_t *data, const audio_pipeline_telemetry_t *telemetry)
+{
+    put_le32(&data[0], telemetry->frames);
+    put_le32(&data[4], telemetry->dropped_frames);
+    return &data[TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES];
+}
+
+static uint8_t *put_levels(uint8_t *data, const audio_pipeline_telemetry_t *telemetry)
+{
+    put_le32(&data[0], telemetry->aec_erle_db_q8);
+    put_le32(&data[4], telemetry->ic_attenuation_db_q8);
+    put_le32(&data[8], telemetry->ns_attenuation_db_q8);
+    put_le32(&data[12], telemetry->agc_gain_db_q8);
+    put_le32(&data[16], telemetry->vnr_input_q16);
+    put_le32(&data[20], telemetry->vnr_output_q16);
+    put_le32(&data[24], telemetry->mic_delay_samples);
+    return &data[TELEMETRY_SERVICER_RESID_LEVELS_NUM_VALUES];
+}
+
+static uint8_t *put_stage_ticks(uint8_t *data, const audio_pipeline_telemetry_t *telemetry)
+{
+    for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+        put_le32(&data[4 * i], telemetry->stage_ticks[i]);
+        put_le32(&data[4 * (AUDIO_PIPELINE_NUM_STAGES + i)], telemetry->stage_ticks_peak[i]);
+    }
+    return &data[TELEMETRY_SERVICER_RESID_STAGE_TICKS_NUM_VALUES];
+}
+
+void telemetry_servicer_init(servicer_t *servicer)
+{
+    #include "telemetry_cmds_map.h" // Included instead of directly adding code since this file is autogenerated.
+    // Servicer resource info
+    static control_resource_info_t telemetry_res_info[NUM_RESOURCES_TELEMETRY_SERVICER];
+
+    memset(servicer, 0, sizeof(servicer_t));
+    servicer->id = TELEMETRY_SERVICER_RESID;
+    servicer->start_io = 0;
+    servicer->num_resources = NUM_RESOURCES_TELEMETRY_SERVICER;
+
+    servicer->res_info = &telemetry_res_info[0];
+    // Servicer resource
+    servicer->res_info[0].resource = TELEMETRY_SERVICER_RESID;
+    servicer->res_info[0].command_map.num_commands = NUM_TELEMETRY_SERVICER_RESID_CMDS;
+    servicer->res_info[0].command_map.commands = telemetry_servicer_resid_cmd_map;
+    servicer_index_init(servicer);
+}
+
+void telemetry_servicer(void *args) {
+    device_control_servicer_t servicer_ctx;
+
+    servicer_t *servicer = (servicer_t*)args;
+    xassert(servicer != NULL);
+
+    control_resid_t *resources = (control_resid_t*)pvPortMalloc(servicer->num_resources * sizeof(control_resid_t));
+    for(int i=0; i<servicer->num_resources; i++)
+    {
+        resources[i] = servicer->res_info[i].resource;
+    }
+
+    control_ret_t dc_ret;
+    debug_printf("Calling device_control_servicer_register(), servicer ID %d, on tile %d, core %d.\n", servicer->id, THIS_XCORE_TILE, rtos_core_id_get());
+
+    dc_ret = device_control_servicer_register(&servicer_ctx,
+                                            device_control_ctxs,
+                                            1,
+                                            resources, servicer->num_resources);
+    debug_printf("Out of device_control_servicer_register(), servicer ID %d, on tile %d. servicer_ctx address = 0x%x\n", servicer->id, THIS_XCORE_TILE, &servicer_ctx);
+
+    vPortFree(resources);
+
+    for(;;){
+        device_control_servicer_cmd_recv(&servicer_ctx, read_cmd, write_cmd, servicer, RTOS_OSAL_WAIT_FOREVER);
+    }
+}
+
+control_ret_t telemetry_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    control_ret_t ret = CONTROL_SUCCESS;
+    uint8_t cmd_id = CONTROL_CMD_CLEAR_READ(cmd);
+    audio_pipeline_telemetry_t telemetry;
+    uint8_t *data = &payload[0];
+
+    memset(payload, 0, payload_len);
+
+    debug_printf("telemetry_servicer_read_cmd, cmd_id: %d.\n", cmd_id);
+
+    audio_pipeline_telemetry_read(&telemetry);
+
+    switch (cmd_id)
+    {
+    case TELEMETRY_SERVICER_RESID_COUNTERS:
+        debug_printf("TELEMETRY_SERVICER_RESID_COUNTERS\n");
+        put_counters(data, &telemetry);
+        break;
+
+    case TELEMETRY_SERVICER_RESID_LEVELS:
+        debug_printf("TELEMETRY_SERVICER_RESID_LEVELS\n");
+        put_levels(data, &telemetry);
+        break;
+
+    case TELEMETRY_SERVICER_RESID_STAGE_TICKS:
+        debug_printf("TELEMETRY_SERVICER_RESID_STAGE_TICKS\n");
+        put_stage_ticks(data, &telemetry);
+        break;
+
+    case TELEMETRY_SERVICER_RESID_ALL:
+        debug_printf("TELEMETRY_SERVICER_RESID_ALL\n");
+        data = put_counters(data, &telemetry);
+        data = put_levels(data, &telemetry);
+        put_stage_ticks(data, &telemetry);
+        break;
+
+    default:
+        debug_printf("TELEMETRY_SERVICER UNHANDLED COMMAND!!!\n");
+        ret = CONTROL_BAD_COMMAND;
+        break;
+    }
+
+    return ret;
+}
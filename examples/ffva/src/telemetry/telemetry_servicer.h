@@ -0,0 +1,41 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include "servicer.h"
+
+#define TELEMETRY_SERVICER_RESID            (242)
+#define NUM_RESOURCES_TELEMETRY_SERVICER    (1) // Audio pipeline telemetry servicer
+
+/**
+ * @brief Audio pipeline telemetry servicer task.
+ *
+ * This task handles the audio pipeline telemetry commands from the device
+ * control interface. It must run on the pipeline output tile.
+ *
+ * \param args      Pointer to the Servicer's state data structure
+ */
+void telemetry_servicer(void *args);
+
+// Servicer initialization functions
+/**
+ * @brief Audio pipeline telemetry servicer initialisation function.
+ * \param servicer      Pointer to the Servicer's state data structure
+ */
+void telemetry_servicer_init(servicer_t *servicer);
+
+/**
+ * @brief Audio pipeline telemetry servicer read command handler
+ *
+ * Handles read commands dedicated to the telemetry servicer resource. Each
+ * command reads the telemetry as of the last frame output, and all the values
+ * read by one command are of the same frame. Values are little endian.
+ *
+ * @param res_info          Resource info of the current command
+ * @param cmd               Command ID of this command
+ * @param payload           Pointer to the payload that is updated with the read data
+ * @param payload_len       Length in bytes of the read command payload
+ * @return control_ret_t    CONTROL_SUCCESS if command handled successfully,
+ *                          otherwise control_ret_t error status indicating the error.
+ */
+control_ret_t telemetry_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len);
@@ -0,0 +1,82 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#pragma once
+
+#include <stdint.h>
+
+// Note: The enums are wrapped around a #ifndef block to keep the cmd_map files common between device and host,
+// the same as the DFU servicer commands.
+
+// TUNING_SERVICER_RESID commands
+enum e_tuning_servicer_resid_cmds
+{
+#ifndef TUNING_SERVICER_RESID_BYPASS
+    TUNING_SERVICER_RESID_BYPASS = 0,
+#endif
+#ifndef TUNING_SERVICER_RESID_ADEC_MODE
+    TUNING_SERVICER_RESID_ADEC_MODE = 1,
+#endif
+#ifndef TUNING_SERVICER_RESID_ADEC_FORCE
+    TUNING_SERVICER_RESID_ADEC_FORCE = 2,
+#endif
+#ifndef TUNING_SERVICER_RESID_AGC_GAIN
+    TUNING_SERVICER_RESID_AGC_GAIN = 3,
+#endif
+#ifndef TUNING_SERVICER_RESID_SETTINGS
+    TUNING_SERVICER_RESID_SETTINGS = 4,
+#endif
+#ifndef TUNING_SERVICER_RESID_MIC_SOURCE
+    TUNING_SERVICER_RESID_MIC_SOURCE = 5,
+#endif
+#ifndef TUNING_SERVICER_RESID_AEC_REF_SOURCE
+    TUNING_SERVICER_RESID_AEC_REF_SOURCE = 6,
+#endif
+#ifndef TUNING_SERVICER_RESID_AEC_ADAPTION
+    TUNING_SERVICER_RESID_AEC_ADAPTION = 7,
+#endif
+#ifndef TUNING_SERVICER_RESID_AGC_LIMITS
+    TUNING_SERVICER_RESID_AGC_LIMITS = 8,
+#endif
+    NUM_TUNING_SERVICER_RESID_CMDS = 9
+};
+
+// TUNING_SERVICER_RESID number of elements
+// number of values of type tuning_servicer_resid_bypass_t expected by TUNING_SERVICER_RESID_BYPASS
+#define TUNING_SERVICER_RESID_BYPASS_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_adec_mode_t expected by TUNING_SERVICER_RESID_ADEC_MODE
+#define TUNING_SERVICER_RESID_ADEC_MODE_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_adec_force_t expected by TUNING_SERVICER_RESID_ADEC_FORCE
+#define TUNING_SERVICER_RESID_ADEC_FORCE_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_agc_gain_t expected by TUNING_SERVICER_RESID_AGC_GAIN
+#define TUNING_SERVICER_RESID_AGC_GAIN_NUM_VALUES (4)
+// number of values of type tuning_servicer_resid_settings_t expected by TUNING_SERVICER_RESID_SETTINGS
+#define TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES (6)
+// number of values of type tuning_servicer_resid_mic_source_t expected by TUNING_SERVICER_RESID_MIC_SOURCE
+#define TUNING_SERVICER_RESID_MIC_SOURCE_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_aec_ref_source_t expected by TUNING_SERVICER_RESID_AEC_REF_SOURCE
+#define TUNING_SERVICER_RESID_AEC_REF_SOURCE_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_aec_adaption_t expected by TUNING_SERVICER_RESID_AEC_ADAPTION
+#define TUNING_SERVICER_RESID_AEC_ADAPTION_NUM_VALUES (1)
+// number of values of type tuning_servicer_resid_agc_limits_t expected by TUNING_SERVICER_RESID_AGC_LIMITS
+#define TUNING_SERVICER_RESID_AGC_LIMITS_NUM_VALUES (16)
+
+// TUNING_SERVICER_RESID types
+// type expected by TUNING_SERVICER_RESID_BYPASS
+typedef uint8_t tuning_servicer_resid_bypass_t;
+// type expected by TUNING_SERVICER_RESID_ADEC_MODE
+typedef uint8_t tuning_servicer_resid_adec_mode_t;
+// type expected by TUNING_SERVICER_RESID_ADEC_FORCE
+typedef uint8_t tuning_servicer_resid_adec_force_t;
+// type expected by TUNING_SERVICER_RESID_AGC_GAIN
+typedef uint8_t tuning_servicer_resid_agc_gain_t;
+// type expected by TUNING_SERVICER_RESID_SETTINGS
+typedef uint8_t tuning_servicer_resid_settings_t;
+// type expected by TUNING_SERVICER_RESID_MIC_SOURCE
+typedef uint8_t tuning_servicer_resid_mic_source_t;
+// type expected by TUNING_SERVICER_RESID_AEC_REF_SOURCE
+typedef uint8_t tuning_servicer_resid_aec_ref_source_t;
+// type expected by TUNING_SERVICER_RESID_AEC_ADAPTION
+typedef uint8_t tuning_servicer_resid_aec_adaption_t;
+// type expected by TUNING_SERVICER_RESID_AGC_LIMITS
+typedef uint8_t tuning_servicer_resid_agc_limits_t;
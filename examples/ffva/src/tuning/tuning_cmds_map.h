@@ -0,0 +1,22 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-variable"
+
+// TUNING_SERVICER_RESID command map
+// This array may be unused as servicers can be moved between tiles
+// Unused variable warnings are suppressed in this header file
+static control_cmd_info_t tuning_servicer_resid_cmd_map[] =
+{
+    { TUNING_SERVICER_RESID_BYPASS, 1, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_ADEC_MODE, 1, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_ADEC_FORCE, 1, sizeof(uint8_t), CMD_WRITE_ONLY },
+    { TUNING_SERVICER_RESID_AGC_GAIN, 4, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_SETTINGS, 6, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_MIC_SOURCE, 1, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_AEC_REF_SOURCE, 1, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_AEC_ADAPTION, 1, sizeof(uint8_t), CMD_READ_WRITE },
+    { TUNING_SERVICER_RESID_AGC_LIMITS, 16, sizeof(uint8_t), CMD_READ_WRITE },
+};
+#pragma clang diagnostic pop
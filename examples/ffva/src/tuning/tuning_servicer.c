@@ -0,0 +1,344 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#define DEBUG_UNIT TUNING_SERVICER
+#ifndef DEBUG_PRINT_ENABLE_TUNING_SERVICER
+#define DEBUG_PRINT_ENABLE_TUNING_SERVICER 0
+#endif
+#include "debug_print.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <platform.h>
+#include <xassert.h>
+
+#include "platform/platform_conf.h"
+#include "platform/driver_instances.h"
+#include "servicer.h"
+#include "tuning_servicer.h"
+
+#include "tuning_cmds.h"
+#include "device_control_i2c.h"
+
+#include "audio_pipeline_tuning.h"
+
+// Sources read by audio_pipeline_input(), on the pipeline input tile
+extern volatile int mic_from_usb;
+extern volatile int aec_ref_source;
+
+// Settings last written, on the tuning servicer's tile
+static audio_pipeline_tuning_t tuning;
+static uint8_t mic_source;
+static uint8_t ref_source;
+
+static uint32_t get_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void put_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static int bypass_valid(uint8_t bypass)
+{
+    return (bypass & ~AUDIO_PIPELINE_BYPASS_ALL) == 0;
+}
+
+static int adec_mode_valid(uint8_t adec_mode)
+{
+    return adec_mode < AUDIO_PIPELINE_NUM_ADEC_MODES;
+}
+
+static int mic_source_valid(uint8_t source)
+{
+    return (source == appconfMIC_SRC_MICS) || (appconfUSB_ENABLED && (source == appconfMIC_SRC_USB));
+}
+
+static int ref_source_valid(uint8_t source)
+{
+    return (appconfI2S_ENABLED && (source == appconfAEC_REF_I2S)) || (appconfUSB_ENABLED && (source == appconfAEC_REF_USB));
+}
+
+// Each limit may be 0 for the AGC profile's value, so they are only checked against each other when both are set
+static int agc_limits_valid(uint32_t max_gain, uint32_t min_gain, uint32_t upper_threshold, uint32_t lower_threshold)
+{
+    return ((max_gain == 0) || (min_gain <= max_gain)) && ((upper_threshold == 0) || (lower_threshold <= upper_threshold));
+}
+
+void tuning_servicer_init(servicer_t *servicer)
+{
+    #include "tuning_cmds_map.h" // Included instead of directly adding code since this file is autogenerated.
+    // Servicer resource info
+    static control_resource_info_t tuning_res_info[NUM_RESOURCES_TUNING_SERVICER];
+
+    memset(servicer, 0, sizeof(servicer_t));
+    servicer->id = TUNING_SERVICER_RESID;
+    servicer->start_io = 0;
+    servicer->num_resources = NUM_RESOURCES_TUNING_SERVICER;
+
+    servicer->res_info = &tuning_res_info[0];
+    // Servicer resource
+    servicer->res_info[0].resource = TUNING_SERVICER_RESID;
+    servicer->res_info[0].command_map.num_commands = NUM_TUNING_SERVICER_RESID_CMDS;
+    servicer->res_info[0].command_map.commands = tuning_servicer_resid_cmd_map;
+    servicer_index_init(servicer);
+
+    memset(&tuning, 0, sizeof(tuning));
+    mic_source = appconfMIC_SRC_DEFAULT;
+    ref_source = appconfAEC_REF_DEFAULT;
+}
+
+void tuning_servicer(void *args) {
+    device_control_servicer_t servicer_ctx;
+
+    servicer_t *servicer = (servicer_t*)args;
+    xassert(servicer != NULL);
+
+    control_resid_t *resources = (control_resid_t*)pvPortMalloc(servicer->num_resources * sizeof(control_resid_t));
+    for(int i=0; i<servicer->num_resources; i++)
+    {
+        resources[i] = servicer->res_info[i].resource;
+    }
+
+    control_ret_t dc_ret;
+    debug_printf("Calling device_control_servicer_register(), servicer ID %d, on tile %d, core %d.\n", servicer->id, THIS_XCORE_TILE, rtos_core_id_get());
+
+    dc_ret = device_control_servicer_register(&servicer_ctx,
+                                            device_control_ctxs,
+                                            1,
+                                            resources, servicer->num_resources);
+    debug_printf("Out of device_control_servicer_register(), servicer ID %d, on tile %d. servicer_ctx address = 0x%x\n", servicer->id, THIS_XCORE_TILE, &servicer_ctx);
+
+    vPortFree(resources);
+
+    for(;;){
+        device_control_servicer_cmd_recv(&servicer_ctx, read_cmd, write_cmd, servicer, RTOS_OSAL_WAIT_FOREVER);
+    }
+}
+
+void tuning_servicer_apply(const tuning_servicer_msg_t *msg)
+{
+    if (msg->set_sources) {
+        mic_from_usb = (msg->mic_source == appconfMIC_SRC_USB);
+        aec_ref_source = msg->aec_ref_source;
+    }
+    audio_pipeline_tuning_request(&msg->pipeline);
+}
+
+void tuning_servicer_rx(void *args)
+{
+    (void) args;
+    tuning_servicer_msg_t msg;
+
+    for (;;) {
+        size_t bytes_received = rtos_intertile_rx_len(
+                intertile_ctx,
+                appconfAUDIO_PIPELINE_TUNING_PORT,
+                portMAX_DELAY);
+
+        xassert(bytes_received == sizeof(msg));
+
+        rtos_intertile_rx_data(
+                intertile_ctx,
+                &msg,
+                bytes_received);
+
+        tuning_servicer_apply(&msg);
+    }
+}
+
+control_ret_t tuning_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    control_ret_t ret = CONTROL_SUCCESS;
+    uint8_t cmd_id = CONTROL_CMD_CLEAR_READ(cmd);
+
+    memset(payload, 0, payload_len);
+
+    debug_printf("tuning_servicer_read_cmd, cmd_id: %d.\n", cmd_id);
+
+    switch (cmd_id)
+    {
+    case TUNING_SERVICER_RESID_BYPASS:
+        debug_printf("TUNING_SERVICER_RESID_BYPASS\n");
+        payload[0] = tuning.bypass;
+        break;
+
+    case TUNING_SERVICER_RESID_ADEC_MODE:
+        debug_printf("TUNING_SERVICER_RESID_ADEC_MODE\n");
+        payload[0] = tuning.adec_mode;
+        break;
+
+    case TUNING_SERVICER_RESID_AGC_GAIN:
+        debug_printf("TUNING_SERVICER_RESID_AGC_GAIN\n");
+        put_le32(&payload[0], tuning.agc_gain_q16);
+        break;
+
+    case TUNING_SERVICER_RESID_SETTINGS:
+        debug_printf("TUNING_SERVICER_RESID_SETTINGS\n");
+        payload[0] = tuning.bypass;
+        payload[1] = tuning.adec_mode;
+        put_le32(&payload[2], tuning.agc_gain_q16);
+        break;
+
+    case TUNING_SERVICER_RESID_MIC_SOURCE:
+        debug_printf("TUNING_SERVICER_RESID_MIC_SOURCE\n");
+        payload[0] = mic_source;
+        break;
+
+    case TUNING_SERVICER_RESID_AEC_REF_SOURCE:
+        debug_printf("TUNING_SERVICER_RESID_AEC_REF_SOURCE\n");
+        payload[0] = ref_source;
+        break;
+
+    case TUNING_SERVICER_RESID_AEC_ADAPTION:
+        debug_printf("TUNING_SERVICER_RESID_AEC_ADAPTION\n");
+        payload[0] = tuning.aec_adaption;
+        break;
+
+    case TUNING_SERVICER_RESID_AGC_LIMITS:
+        debug_printf("TUNING_SERVICER_RESID_AGC_LIMITS\n");
+        put_le32(&payload[0], tuning.agc_max_gain_q16);
+        put_le32(&payload[4], tuning.agc_min_gain_q16);
+        put_le32(&payload[8], tuning.agc_upper_threshold_q16);
+        put_le32(&payload[12], tuning.agc_lower_threshold_q16);
+        break;
+
+    default:
+        debug_printf("TUNING_SERVICER UNHANDLED COMMAND!!!\n");
+        ret = CONTROL_BAD_COMMAND;
+        break;
+    }
+
+    return ret;
+}
+
+control_ret_t tuning_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    control_ret_t ret = CONTROL_SUCCESS;
+    audio_pipeline_tuning_t new_tuning = tuning;
+    uint8_t new_mic_source = mic_source;
+    uint8_t new_ref_source = ref_source;
+    uint32_t set_sources = 0;
+
+    uint8_t cmd_id = CONTROL_CMD_CLEAR_READ(cmd);
+    debug_printf("tuning_servicer_write_cmd cmd_id %d.\n", cmd_id);
+
+    switch (cmd_id)
+    {
+    case TUNING_SERVICER_RESID_BYPASS:
+        debug_printf("TUNING_SERVICER_RESID_BYPASS\n");
+        if (!bypass_valid(payload[0]))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_tuning.bypass = payload[0];
+        break;
+
+    case TUNING_SERVICER_RESID_ADEC_MODE:
+        debug_printf("TUNING_SERVICER_RESID_ADEC_MODE\n");
+        if (!adec_mode_valid(payload[0]))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_tuning.adec_mode = payload[0];
+        break;
+
+    case TUNING_SERVICER_RESID_ADEC_FORCE:
+        debug_printf("TUNING_SERVICER_RESID_ADEC_FORCE\n");
+        new_tuning.adec_force_count++;
+        break;
+
+    case TUNING_SERVICER_RESID_AGC_GAIN:
+        debug_printf("TUNING_SERVICER_RESID_AGC_GAIN\n");
+        new_tuning.agc_gain_q16 = get_le32(&payload[0]);
+        break;
+
+    case TUNING_SERVICER_RESID_SETTINGS:
+        debug_printf("TUNING_SERVICER_RESID_SETTINGS\n");
+        if (!bypass_valid(payload[0]) || !adec_mode_valid(payload[1]))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_tuning.bypass = payload[0];
+        new_tuning.adec_mode = payload[1];
+        new_tuning.agc_gain_q16 = get_le32(&payload[2]);
+        break;
+
+    case TUNING_SERVICER_RESID_MIC_SOURCE:
+        debug_printf("TUNING_SERVICER_RESID_MIC_SOURCE\n");
+        if (!mic_source_valid(payload[0]))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_mic_source = payload[0];
+        set_sources = 1;
+        break;
+
+    case TUNING_SERVICER_RESID_AEC_REF_SOURCE:
+        debug_printf("TUNING_SERVICER_RESID_AEC_REF_SOURCE\n");
+        if (!ref_source_valid(payload[0]))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_ref_source = payload[0];
+        set_sources = 1;
+        break;
+
+    case TUNING_SERVICER_RESID_AEC_ADAPTION:
+        debug_printf("TUNING_SERVICER_RESID_AEC_ADAPTION\n");
+        if (payload[0] >= AUDIO_PIPELINE_NUM_AEC_ADAPTIONS)
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_tuning.aec_adaption = payload[0];
+        break;
+
+    case TUNING_SERVICER_RESID_AGC_LIMITS:
+        debug_printf("TUNING_SERVICER_RESID_AGC_LIMITS\n");
+        if (!agc_limits_valid(get_le32(&payload[0]), get_le32(&payload[4]), get_le32(&payload[8]), get_le32(&payload[12])))
+        {
+            ret = CONTROL_ERROR;
+            break;
+        }
+        new_tuning.agc_max_gain_q16 = get_le32(&payload[0]);
+        new_tuning.agc_min_gain_q16 = get_le32(&payload[4]);
+        new_tuning.agc_upper_threshold_q16 = get_le32(&payload[8]);
+        new_tuning.agc_lower_threshold_q16 = get_le32(&payload[12]);
+        break;
+
+    default:
+        debug_printf("TUNING_SERVICER UNHANDLED COMMAND!!!\n");
+        ret = CONTROL_BAD_COMMAND;
+        break;
+    }
+
+    if (ret == CONTROL_SUCCESS)
+    {
+        tuning_servicer_msg_t msg = {
+            .pipeline = new_tuning,
+            .set_sources = set_sources,
+            .mic_source = new_mic_source,
+            .aec_ref_source = new_ref_source,
+        };
+
+        tuning = new_tuning;
+        mic_source = new_mic_source;
+        ref_source = new_ref_source;
+        rtos_intertile_tx(intertile_ctx,
+                          appconfAUDIO_PIPELINE_TUNING_PORT,
+                          &msg,
+                          sizeof(msg));
+    }
+
+    return ret;
+}
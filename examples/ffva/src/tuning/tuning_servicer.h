@@ -0,0 +1,95 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include "servicer.h"
+#include "audio_pipeline_tuning.h"
+
+#define TUNING_SERVICER_RESID           (241)
+#define NUM_RESOURCES_TUNING_SERVICER   (1) // Audio pipeline tuning servicer
+
+/**
+ * @brief Message sent by the tuning servicer to the pipeline input tile for
+ * each command written.
+ *
+ * The sources are only set by the source commands, so that the other commands
+ * leave the sources that the GPIO buttons may have changed.
+ */
+typedef struct {
+    audio_pipeline_tuning_t pipeline;
+    uint32_t set_sources;       // Set mic_from_usb and aec_ref_source to the values below
+    uint32_t mic_source;        // appconfMIC_SRC_MICS or appconfMIC_SRC_USB
+    uint32_t aec_ref_source;    // appconfAEC_REF_I2S or appconfAEC_REF_USB
+} tuning_servicer_msg_t;
+
+/**
+ * @brief Audio pipeline tuning servicer task.
+ *
+ * This task handles the audio pipeline tuning commands from the device control
+ * interface, and sends the settings to tuning_servicer_rx() on the pipeline
+ * input tile.
+ *
+ * \param args      Pointer to the Servicer's state data structure
+ */
+void tuning_servicer(void *args);
+
+/**
+ * @brief Audio pipeline tuning receive task.
+ *
+ * This task runs on the pipeline input tile, and requests the settings sent
+ * by the tuning servicer. They are latched by the next frame input, so take
+ * effect at a frame boundary.
+ *
+ * \param args      Unused
+ */
+void tuning_servicer_rx(void *args);
+
+/**
+ * @brief Apply a message from the tuning servicer, on the pipeline input tile.
+ *
+ * Called by tuning_servicer_rx() for each message. The pipeline input reads
+ * the sources once at the start of each frame, so a change of source also
+ * takes effect at a frame boundary.
+ *
+ * \param msg       The message
+ */
+void tuning_servicer_apply(const tuning_servicer_msg_t *msg);
+
+// Servicer initialization functions
+/**
+ * @brief Audio pipeline tuning servicer initialisation function.
+ * \param servicer      Pointer to the Servicer's state data structure
+ */
+void tuning_servicer_init(servicer_t *servicer);
+
+/**
+ * @brief Audio pipeline tuning servicer read command handler
+ *
+ * Handles read commands dedicated to the tuning servicer resource
+ *
+ * @param res_info          Resource info of the current command
+ * @param cmd               Command ID of this command
+ * @param payload           Pointer to the payload that is updated with the read data
+ * @param payload_len       Length in bytes of the read command payload
+ * @return control_ret_t    CONTROL_SUCCESS if command handled successfully,
+ *                          otherwise control_ret_t error status indicating the error.
+ */
+control_ret_t tuning_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len);
+
+/**
+ * @brief Audio pipeline tuning servicer write command handler
+ *
+ * Handles write commands dedicated to the tuning servicer resource. Every
+ * command that is written sends all the pipeline settings, so the settings
+ * written by one TUNING_SERVICER_RESID_SETTINGS or TUNING_SERVICER_RESID_AGC_LIMITS
+ * command take effect in the same frame. A source that the build has not
+ * enabled is refused with CONTROL_ERROR.
+ *
+ * @param res_info          Resource info of the current command
+ * @param cmd               Command ID of this command
+ * @param payload           Pointer to the payload that contains the write data
+ * @param payload_len       Length in bytes of the write command payload
+ * @return control_ret_t    CONTROL_SUCCESS if command handled successfully,
+ *                          otherwise control_ret_t error status indicating the error.
+ */
+control_ret_t tuning_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len);
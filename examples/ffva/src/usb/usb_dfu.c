@@ -92,6 +92,7 @@ void tud_dfu_abort_cb(uint8_t alt)
 {
     (void) alt;
     rtos_printf("Host aborted transfer\n");
+    dfu_common_abort_download();
 }
 
 // Invoked when a DFU_DETACH request is received
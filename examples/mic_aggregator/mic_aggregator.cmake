@@ -76,19 +76,24 @@ set(APP_COMMON_LINK_LIBRARIES
 #*************************
 # Create Targets
 #*************************
+foreach(MIC_COUNT 16 32)
 foreach(CONFIG tdm usb)
-    set(TARGET_NAME example_mic_aggregator_${CONFIG})
+    if(${MIC_COUNT} EQUAL 16)
+        set(TARGET_NAME example_mic_aggregator_${CONFIG})
+    else()
+        set(TARGET_NAME example_mic_aggregator_${CONFIG}_${MIC_COUNT})
+    endif()
     add_executable(${TARGET_NAME} EXCLUDE_FROM_ALL )
     target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES} ${XUA_SOURCES})
     target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES})
     string(TOUPPER ${CONFIG} CONFIG_UPPER)
-    target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} CONFIG_${CONFIG_UPPER}=1)
+    target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} CONFIG_${CONFIG_UPPER}=1 MIC_ARRAY_CONFIG_MIC_COUNT=${MIC_COUNT})
     target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
     target_link_libraries(${TARGET_NAME} PUBLIC ${APP_COMMON_LINK_LIBRARIES})
     target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
-    unset(TARGET_NAME)
 
     # Copy output to a handy location
     install(FILES ${CMAKE_CURRENT_BINARY_DIR}/${TARGET_NAME}.xe DESTINATION ${CMAKE_INSTALL_PREFIX}/bin)
     unset(TARGET_NAME)
 endforeach()
+endforeach()
@@ -10,10 +10,26 @@
 #define MIC_ARRAY_CONFIG_USE_DDR            1
 #define MIC_ARRAY_CONFIG_PORT_MCLK          XS1_PORT_1D // X0D11, J14 - Pin 15, '11'
 #define MIC_ARRAY_CONFIG_PORT_PDM_CLK       XS1_PORT_1A // X0D00, J14 - Pin 2, '00'
+#ifndef MIC_ARRAY_CONFIG_MIC_COUNT
+#define MIC_ARRAY_CONFIG_MIC_COUNT          16          // 16 or 32. Two mics per data line
+#endif
+#if MIC_ARRAY_CONFIG_MIC_COUNT > 16
+// Not yet verified on hardware. X0D04..X0D07 of this port are also port 4B, the QSPI data lines of the boot flash, and
+// DDR PDM receive on a 16 bit port depends on lib_mic_array support
+#define MIC_ARRAY_CONFIG_PORT_PDM_DATA      XS1_PORT_16A // X0D02..X0D09 and X0D14..X0D21
+#else
 #define MIC_ARRAY_CONFIG_PORT_PDM_DATA      XS1_PORT_8B // X0D14..X0D21 | J14 - Pin 3,5,12,14 and Pin 6,7,10,11
-#define MIC_ARRAY_CONFIG_MIC_COUNT          16          // Application is currently hard coded to 16
-#define MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME  1           // Application is currently hard coded to 1
+#endif
+#ifndef MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME
+#define MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME  1           // Samples per channel passed from the decimators to TDM/USB at a time. 1 for lowest latency
+#endif
+#ifndef MIC_ARRAY_NUM_DECIMATOR_TASKS
+#if MIC_ARRAY_CONFIG_MIC_COUNT > 16
+#define MIC_ARRAY_NUM_DECIMATOR_TASKS       6           // Defines the number of subtasks to perform the decimation process on.
+#else
 #define MIC_ARRAY_NUM_DECIMATOR_TASKS       3           // Defines the number of subtasks to perform the decimation process on.
+#endif
+#endif
 #define MIC_ARRAY_PDM_RX_OWN_THREAD         1           // Use dedicated thread for PDM Rx task
 #define MIC_ARRAY_CLK1                      XS1_CLKBLK_1
 #define MIC_ARRAY_CLK2                      XS1_CLKBLK_2
@@ -25,6 +41,14 @@
 #define TDM_SLAVETX_OFFSET                  1           // How many BCLK cycles after FSYNCH rising edge data is driver
 #define TDM_SLAVESAMPLE_MODE                I2S_SLAVE_SAMPLE_ON_BCLK_RISING
 
+// With 32 mics, mics 16..31 are sent on a second TDM16 data line from a second TDM slave. Its BCLK and FSYNCH
+// inputs are wired to the same signals as the first slave's.
+#define TDM_SLAVE_NUM_DATA_LINES            ((MIC_ARRAY_CONFIG_MIC_COUNT + 15) / 16)
+#define TDM_SLAVEPORT_OUT_2                 XS1_PORT_1E // X1D12
+#define TDM_SLAVEPORT_FSYNCH_2              XS1_PORT_1F // X1D13
+#define TDM_SLAVEPORT_BCLK_2                XS1_PORT_1G // X1D22
+#define TDM_SLAVEPORT_CLK_BLK_2             XS1_CLKBLK_4
+
 #define TDM_SIMPLE_MASTER_FSYNCH            XS1_PORT_1M // X1D36, J10 - pin 2, '36'
 #define TDM_SIMPLE_MASTER_DATA              XS1_PORT_1O // X1D38, J10 - pin 15, '38'
 #define TDM_SIMPLE_MASTER_CLK_BLK           XS1_CLKBLK_2
@@ -45,7 +69,16 @@
 #error "MIC_ARRAY_NUM_DECIMATOR_TASKS: Unsupported value"
 #endif
 
-#if !(MIC_ARRAY_CONFIG_MIC_COUNT == 8 || MIC_ARRAY_CONFIG_MIC_COUNT == 16)
+#if MIC_ARRAY_CONFIG_MIC_COUNT > 16 && MIC_ARRAY_NUM_DECIMATOR_TASKS < 6
+#error "MIC_ARRAY_NUM_DECIMATOR_TASKS: Unsupported value"
+#endif
+
+// tile[0] also runs the I2C control task in the TDM build
+#if MIC_ARRAY_PDM_RX_OWN_THREAD + MIC_ARRAY_NUM_DECIMATOR_TASKS + 1 > 8
+#error "MIC_ARRAY_NUM_DECIMATOR_TASKS: Too many threads for tile[0]"
+#endif
+
+#if !(MIC_ARRAY_CONFIG_MIC_COUNT == 8 || MIC_ARRAY_CONFIG_MIC_COUNT == 16 || MIC_ARRAY_CONFIG_MIC_COUNT == 32)
 #error "MIC_ARRAY_CONFIG_MIC_COUNT: Unsupported value"
 #endif
 
@@ -53,6 +86,11 @@
 #error "MIC_ARRAY_NUM_DECIMATOR_TASKS must be less than or equal to MIC_ARRAY_CONFIG_MIC_COUNT"
 #endif
 
+#if !(MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME == 1 || MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME == 2 || MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME == 4 \
+      || MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME == 8 || MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME == 16)
+#error "MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME: Unsupported value"
+#endif
+
 #if MIC_ARRAY_CONFIG_USE_DDR != 1
 #error "MIC_ARRAY_CONFIG_USE_DDR: This application only supports DDR"
 #endif
@@ -2,7 +2,6 @@
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
 #include <stdio.h>
-#include <limits.h>
 
 #include <xcore/channel.h>
 #include <xcore/channel_streaming.h>
@@ -23,9 +22,9 @@
 #include "xua_conf.h"
 
 
-DECLARE_JOB(pdm_mic_16, (chanend_t));
-void pdm_mic_16(chanend_t c_mic_array) {
-    printf("pdm_mic_16 running: %d threads total\n", MIC_ARRAY_PDM_RX_OWN_THREAD + MIC_ARRAY_NUM_DECIMATOR_TASKS);
+DECLARE_JOB(pdm_mic, (chanend_t));
+void pdm_mic(chanend_t c_mic_array) {
+    printf("pdm_mic running: %d threads total\n", MIC_ARRAY_PDM_RX_OWN_THREAD + MIC_ARRAY_NUM_DECIMATOR_TASKS);
 
     app_mic_array_init();
     // app_mic_array_assertion_disable();
@@ -33,46 +32,40 @@ void pdm_mic_16(chanend_t c_mic_array) {
     app_mic_array_task(c_mic_array);
 }
 
-DECLARE_JOB(pdm_mic_16_front_end, (void));
-void pdm_mic_16_front_end(void) {
-    printf("pdm_mic_16_front_end\n");
+DECLARE_JOB(pdm_mic_front_end, (void));
+void pdm_mic_front_end(void) {
+    printf("pdm_mic_front_end\n");
 
     if(MIC_ARRAY_PDM_RX_OWN_THREAD){
         app_pdm_rx_task();
     }
 }
 
-static inline int32_t scalar_gain(int32_t samp, int32_t gain){
-    int64_t accum = (int64_t)samp * (int32_t)gain;
-    accum = accum > INT_MAX ? INT_MAX : accum;
-    accum = accum < INT_MIN ? INT_MIN : accum;
-
-    return (int32_t)accum;
-}
-
-
 DECLARE_JOB(hub, (chanend_t, chanend_t, chanend_t, audio_frame_t **));
 void hub(chanend_t c_mic_array, chanend_t c_i2c_reg, chanend_t c_aud, audio_frame_t **read_buffer_ptr) {
     printf("hub\n");
 
     unsigned write_buffer_idx = 0;
+    mic_frame_t mic_frame;
     audio_frame_t audio_frames[NUM_AUDIO_BUFFERS] = {{{{0}}}};
 
-    uint16_t gains[MIC_ARRAY_CONFIG_MIC_COUNT] = {MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT,
-                                                  MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT,
-                                                  MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT,
-                                                  MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT, MIC_GAIN_INIT};  
+    uint16_t gains[MIC_ARRAY_CONFIG_MIC_COUNT];
+    for(int ch = 0; ch < MIC_ARRAY_CONFIG_MIC_COUNT; ch++){
+        gains[ch] = MIC_GAIN_INIT;
+    }
     while(1){
-        ma_frame_rx((int32_t*)&audio_frames[write_buffer_idx], c_mic_array, MIC_ARRAY_CONFIG_MIC_COUNT, MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME);
+        ma_frame_rx((int32_t*)&mic_frame, c_mic_array, MIC_ARRAY_CONFIG_MIC_COUNT, MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME);
+        audio_frame_t *frame = &audio_frames[write_buffer_idx];
 
-        // Apply gain
-        for(int ch = 0; ch < MIC_ARRAY_CONFIG_MIC_COUNT; ch++){
-            audio_frames[write_buffer_idx].data[ch][0] = scalar_gain(audio_frames[write_buffer_idx].data[ch][0], gains[ch]);
-        }
+        hub_apply_gains(frame, &mic_frame, gains);
 #if CONFIG_USB
-        xua_exchange(c_aud, &audio_frames[write_buffer_idx].data[0][0]);
+        // XUA takes one sample per exchange. These complete before the next frame arrives as XUA and the mics run
+        // from the same clock
+        for(int s = 0; s < MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME; s++){
+            xua_exchange(c_aud, frame->data[s]);
+        }
 #endif
-        *read_buffer_ptr = &audio_frames[write_buffer_idx];  // update read buffer for TDM
+        *read_buffer_ptr = frame;  // update read buffer for TDM
 
         write_buffer_idx++;
         if(write_buffer_idx == NUM_AUDIO_BUFFERS){
@@ -103,7 +96,8 @@ void hub(chanend_t c_mic_array, chanend_t c_i2c_reg, chanend_t c_aud, audio_fram
             }
             break;
         }
-        // There are currently around 1600 ticks (16us) of slack at the end of this loop in TDM mode
+        // There are currently around 1600 ticks (16us) of slack at the end of this loop in TDM mode with one sample
+        // per frame
     }
 }
 
@@ -113,8 +107,8 @@ void hub(chanend_t c_mic_array, chanend_t c_i2c_reg, chanend_t c_aud, audio_fram
 
 void main_tile_0(chanend_t c_cross_tile[2]){
     PAR_JOBS(
-        PJOB(pdm_mic_16, (c_cross_tile[0])), // Note spawns MIC_ARRAY_NUM_DECIMATOR_TASKS threads
-        PJOB(pdm_mic_16_front_end, ())
+        PJOB(pdm_mic, (c_cross_tile[0])), // Note spawns MIC_ARRAY_NUM_DECIMATOR_TASKS threads
+        PJOB(pdm_mic_front_end, ())
 #if CONFIG_TDM
         ,PJOB(i2c_control, (c_cross_tile[1]))
 #endif
@@ -134,10 +128,19 @@ void main_tile_1(chanend_t c_cross_tile[2]){
 
     channel_t c_aud = chan_alloc();
 
+#if CONFIG_TDM
+    // One snapshot of the read buffer for all the TDM data lines
+    tdm_share_t tdm_share;
+    tdm_share_init(&tdm_share, read_buffer_ptr);
+#endif
+
     PAR_JOBS(
         PJOB(hub, (c_cross_tile[0], c_cross_tile[1], c_aud.end_b, read_buffer_ptr)),
 #if CONFIG_TDM
-        PJOB(tdm16_slave, (read_buffer_ptr)),
+        PJOB(tdm16_slave, (&tdm_share, 0)),
+#if TDM_SLAVE_NUM_DATA_LINES > 1
+        PJOB(tdm16_slave, (&tdm_share, 1)),
+#endif
         PJOB(tdm16_master_simple, ()),
         PJOB(tdm_master_monitor, ()) // Temp monitor for checking reception of TDM frames. Separate task so non-intrusive
 #else
@@ -4,14 +4,90 @@
 #pragma once
 
 #include <stdint.h>
+#include <limits.h>
 #include "app_config.h"
 
 #define NUM_AUDIO_BUFFERS   3
 
-typedef struct audio_frame_t{
+// Frame as received from the mic_array, one row of samples per channel
+typedef struct mic_frame_t{
     int32_t data[MIC_ARRAY_CONFIG_MIC_COUNT][MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME];
+} mic_frame_t;
+
+// Frame as sent to TDM/USB, one row of channels per sample so that each TDM/USB sample is contiguous in memory
+typedef struct audio_frame_t{
+    int32_t data[MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME][MIC_ARRAY_CONFIG_MIC_COUNT];
 } audio_frame_t;
 
+static inline int32_t scalar_gain(int32_t samp, int32_t gain){
+    int64_t accum = (int64_t)samp * (int32_t)gain;
+    accum = accum > INT_MAX ? INT_MAX : accum;
+    accum = accum < INT_MIN ? INT_MIN : accum;
+
+    return (int32_t)accum;
+}
+
+// Apply gain, reordering the frame so that the channels of each sample are contiguous
+static inline void hub_apply_gains(audio_frame_t *frame, const mic_frame_t *mic_frame, const uint16_t gains[MIC_ARRAY_CONFIG_MIC_COUNT]){
+    for(int ch = 0; ch < MIC_ARRAY_CONFIG_MIC_COUNT; ch++){
+        for(int s = 0; s < MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME; s++){
+            frame->data[s][ch] = scalar_gain(mic_frame->data[ch][s], gains[ch]);
+        }
+    }
+}
+
+// Reads the frames published by the hub one sample at a time. A new frame is picked up once all the samples of the
+// current one have been read, so the reader works through one buffer while the hub fills the next.
+typedef struct frame_reader_t{
+    audio_frame_t **read_buffer_ptr;    // Last frame completed by the hub, NULL until the first one
+    audio_frame_t *frame;               // Frame currently being read
+    unsigned sample_idx;                // Next sample of frame to read
+} frame_reader_t;
+
+static inline void frame_reader_init(frame_reader_t *reader, audio_frame_t **read_buffer_ptr){
+    reader->read_buffer_ptr = read_buffer_ptr;
+    reader->frame = NULL;
+    reader->sample_idx = MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME;
+}
+
+// Returns the channels of the next sample, or NULL if the hub hasn't completed a frame yet
+static inline const int32_t *frame_reader_next(frame_reader_t *reader){
+    if(reader->sample_idx == MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME){
+        reader->frame = *reader->read_buffer_ptr; // Take a copy so the hub moving on mid frame doesn't affect this one
+        if(reader->frame == NULL){
+            return NULL;
+        }
+        reader->sample_idx = 0;
+    }
+    return reader->frame->data[reader->sample_idx++];
+}
+
+// One frame reader shared by the TDM data lines, so that every line sends the same sample of the same frame. The first
+// line to get to a sample takes it from the reader and the other lines use the same one. The last two samples are
+// kept, so a line can be up to one sample ahead of the others. Calls from different lines must not overlap.
+typedef struct frame_snapshot_t{
+    frame_reader_t reader;
+    const int32_t *samples[2];          // Samples taken from reader, indexed by sample number modulo 2
+    unsigned count;                     // Number of samples taken from reader
+} frame_snapshot_t;
+
+static inline void frame_snapshot_init(frame_snapshot_t *snapshot, audio_frame_t **read_buffer_ptr){
+    frame_reader_init(&snapshot->reader, read_buffer_ptr);
+    snapshot->samples[0] = NULL;
+    snapshot->samples[1] = NULL;
+    snapshot->count = 0;
+}
+
+// Returns the channels of sample number sample_num of a line, counting from 0, or NULL if the hub hadn't completed a
+// frame yet when the sample was taken
+static inline const int32_t *frame_snapshot_get(frame_snapshot_t *snapshot, unsigned sample_num){
+    if(sample_num == snapshot->count){
+        snapshot->samples[sample_num & 1] = frame_reader_next(&snapshot->reader);
+        snapshot->count++;
+    }
+    return snapshot->samples[sample_num & 1];
+}
+
 // Macro to adjust input pad timing for the round trip delay. Supports 0 (default) to 5 core clock cycles.
 // Larger numbers increase hold time but reduce setup time.
 #define PORT_DELAY      0x7007
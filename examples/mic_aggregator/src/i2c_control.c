@@ -10,26 +10,9 @@
 #include "app_main.h"
 #include "i2c.h"
 
-// 16 pairs of 8b registers. MSB first LSB last (Little endian)
-// Initial gain = 1
-uint8_t i2c_slave_registers[I2C_CONTROL_NUM_REGISTERS] = {
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), // Ch 0
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), // Ch 7
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), // Ch 8
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT),
-        UPPER_BYTE_FROM_U16(MIC_GAIN_INIT), UPPER_BYTE_FROM_U16(MIC_GAIN_INIT) // Ch 15
-    };
+// One pair of 8b registers per mic. MSB first LSB last (Little endian)
+// Initialised to MIC_GAIN_INIT by i2c_control()
+uint8_t i2c_slave_registers[I2C_CONTROL_NUM_REGISTERS];
 
 // This variable is set to -1 if no current register has been selected.
 // If the I2C master does a write transaction to select the register then
@@ -139,6 +122,11 @@ DECLARE_JOB(i2c_control, (chanend_t));
 void i2c_control(chanend_t c_i2c_reg) {
     printf("i2c_control\n");
 
+    for(int ch = 0; ch < MIC_ARRAY_CONFIG_MIC_COUNT; ch++){
+        i2c_slave_registers[ch << 1] = UPPER_BYTE_FROM_U16(MIC_GAIN_INIT);
+        i2c_slave_registers[(ch << 1) + 1] = LOWER_BYTE_FROM_U16(MIC_GAIN_INIT);
+    }
+
     port_t p_scl = I2C_CONTROL_SLAVE_SCL;
     port_t p_sda = I2C_CONTROL_SLAVE_SDA;
 
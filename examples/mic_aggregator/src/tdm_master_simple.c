@@ -10,7 +10,7 @@
 #include "app_config.h"
 #include "app_main.h"
 
-// Global for now to allow the monitor to function
+// Global for now to allow the monitor to function. Only the first TDM data line (mics 0..15) is received
 int32_t rx_data[16] = {0};
 
 
@@ -7,6 +7,18 @@
 #include "app_main.h"
 #include "tdm_slave_wrapper.h"
 
+typedef struct tdm_line_t{
+    tdm_share_t *share;
+    unsigned sample_num;    // Next sample to send on this data line
+    unsigned first_ch;      // First mic sent on this data line
+} tdm_line_t;
+
+void tdm_share_init(tdm_share_t *share, audio_frame_t **read_buffer_ptr)
+{
+    frame_snapshot_init(&share->snapshot, read_buffer_ptr);
+    share->lock = lock_alloc();
+}
+
 I2S_CALLBACK_ATTR
 void i2s_init(void *app_data, i2s_config_t *i2s_config)
 {
@@ -35,14 +47,15 @@ void tdm_post_port_init(void *ctx)
 I2S_CALLBACK_ATTR
 void i2s_send(void *app_data, size_t n, int32_t *send_data)
 {
-    audio_frame_t **read_buffer_ptr = (audio_frame_t **)app_data;
-    audio_frame_t *read_buffer = *read_buffer_ptr; // Make copy just in case mics move on buffer halfway through frame
-
-    if(read_buffer != NULL){
-        // for(int ch = 0; ch < 16; ch++){
-        //     send_data[ch] = read_buffer->data[ch][0];
-        // }
-        memcpy(send_data, &read_buffer->data[0][0], 16 * sizeof(*send_data)); // We can do this because samples are contiguous in memory for framesize == 1
+    tdm_line_t *tdm_line = (tdm_line_t *)app_data;
+
+    // Every line takes its samples from the same snapshot, so the lines can't be a frame apart
+    lock_acquire(tdm_line->share->lock);
+    const int32_t *samples = frame_snapshot_get(&tdm_line->share->snapshot, tdm_line->sample_num++);
+    lock_release(tdm_line->share->lock);
+
+    if(samples != NULL){
+        memcpy(send_data, &samples[tdm_line->first_ch], 16 * sizeof(*send_data)); // Channels of a sample are contiguous in audio_frame_t
     } else {
         memset(send_data, 0, 16 * sizeof(*send_data));
     }
@@ -55,23 +68,25 @@ i2s_restart_t i2s_restart_check(void *app_data)
 }
 
 
-void tdm16_slave(audio_frame_t **read_buffer_ptr) {
-    printf("tdm16_slave\n");
+void tdm16_slave(tdm_share_t *share, unsigned line) {
+    printf("tdm16_slave %u\n", line);
 
     i2s_tdm_ctx_t ctx;
+    tdm_line_t tdm_line = {.share = share, .sample_num = 0, .first_ch = 16 * line};
+
     i2s_callback_group_t i_i2s = {
             .init = (i2s_init_t) i2s_init,
             .restart_check = (i2s_restart_check_t) i2s_restart_check,
             .receive = NULL,
             .send = (i2s_send_t) i2s_send,
-            .app_data = (void*)read_buffer_ptr,
+            .app_data = (void*)&tdm_line,
     };
 
-    port_t p_bclk = TDM_SLAVEPORT_BCLK;
-    port_t p_fsync = TDM_SLAVEPORT_FSYNCH;
-    port_t p_dout = TDM_SLAVEPORT_OUT;
+    port_t p_bclk = (line == 0) ? TDM_SLAVEPORT_BCLK : TDM_SLAVEPORT_BCLK_2;
+    port_t p_fsync = (line == 0) ? TDM_SLAVEPORT_FSYNCH : TDM_SLAVEPORT_FSYNCH_2;
+    port_t p_dout = (line == 0) ? TDM_SLAVEPORT_OUT : TDM_SLAVEPORT_OUT_2;
 
-    xclock_t bclk = TDM_SLAVEPORT_CLK_BLK;
+    xclock_t bclk = (line == 0) ? TDM_SLAVEPORT_CLK_BLK : TDM_SLAVEPORT_CLK_BLK_2;
 
     i2s_tdm_slave_tx_16_init(
         &ctx,
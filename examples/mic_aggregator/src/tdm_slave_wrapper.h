@@ -3,9 +3,18 @@
 
 #pragma once
 
-#include "app_main.h"           // audio_frame_t
+#include <xcore/lock.h>
+#include "app_main.h"           // audio_frame_t, frame_snapshot_t
 #include "i2s_tdm_slave.h"
 
+// Frame snapshot shared by the TDM16 data lines, and the lock its users take turns with
+typedef struct tdm_share_t{
+    frame_snapshot_t snapshot;
+    lock_t lock;
+} tdm_share_t;
 
-DECLARE_JOB(tdm16_slave, (audio_frame_t **));
-void tdm16_slave(audio_frame_t **read_buffer);
\ No newline at end of file
+void tdm_share_init(tdm_share_t *share, audio_frame_t **read_buffer_ptr);
+
+// Sends mics (16 * line)..(16 * line + 15) on the TDM16 data line
+DECLARE_JOB(tdm16_slave, (tdm_share_t *, unsigned));
+void tdm16_slave(tdm_share_t *share, unsigned line);
\ No newline at end of file
@@ -0,0 +1,216 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include "audio_format.h"
+#include "audio_format_impl.h"
+
+// The kernels below take the channel count and sample width as arguments, but are always inlined into a call with
+// constants for both. For the common channel counts this fully unrolls the loop over channels, so every frame is a
+// straight run of loads and stores with constant offsets, and removes the per sample width switch. Any other channel
+// count goes to the reference implementation.
+
+#define AUDIO_FORMAT_MAX_SPECIALISED_CH   (8)
+
+#define SPECIALISE_CH(NUM_CH, CALL) \
+    switch(NUM_CH) \
+    { \
+    case 2: CALL(2); return; \
+    case 4: CALL(4); return; \
+    case 6: CALL(6); return; \
+    case 8: CALL(8); return; \
+    default: break; \
+    }
+
+#define SPECIALISE_WIDTH(WIDTH, CALL) \
+    switch(WIDTH) \
+    { \
+    case AUDIO_FORMAT_S16: CALL(AUDIO_FORMAT_S16); return; \
+    case AUDIO_FORMAT_S24: CALL(AUDIO_FORMAT_S24); return; \
+    default: CALL(AUDIO_FORMAT_S32); return; \
+    }
+
+AUDIO_FORMAT_INLINE void interleave_kernel(int32_t *dst, const int32_t *src, size_t src_stride, unsigned num_ch, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            dst[ch] = src[ch*src_stride];
+        }
+        dst += num_ch;
+        src++;
+    }
+}
+
+AUDIO_FORMAT_INLINE void deinterleave_kernel(int32_t *dst, size_t dst_stride, const int32_t *src, unsigned num_ch, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            dst[ch*dst_stride] = src[ch];
+        }
+        dst++;
+        src += num_ch;
+    }
+}
+
+AUDIO_FORMAT_INLINE void pack_kernel(void *dst, audio_format_width_t width, const int32_t *src, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        audio_format_store(dst, i, width, src[i]);
+    }
+}
+
+AUDIO_FORMAT_INLINE void unpack_kernel(int32_t *dst, const void *src, audio_format_width_t width, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        dst[i] = audio_format_load(src, i, width);
+    }
+}
+
+AUDIO_FORMAT_INLINE void gain_pack_interleaved_kernel(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    uint32_t g[AUDIO_FORMAT_MAX_SPECIALISED_CH];
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        g[ch] = gains[ch];
+    }
+    for(size_t i=0; i<n*num_ch; i+=num_ch)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            audio_format_store(dst, i + ch, width, audio_format_apply_gain(src[i + ch], g[ch], frac_bits));
+        }
+    }
+}
+
+AUDIO_FORMAT_INLINE void pack_interleaved_kernel(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n)
+{
+    pack_kernel(dst, width, src, n*num_ch);
+}
+
+AUDIO_FORMAT_INLINE void unpack_deinterleave_gain_kernel(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    uint32_t g[AUDIO_FORMAT_MAX_SPECIALISED_CH];
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        g[ch] = gains[ch];
+    }
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            dst[ch*dst_stride + i] = audio_format_apply_gain(audio_format_load(src, i*num_ch + ch, width), g[ch], frac_bits);
+        }
+    }
+}
+
+AUDIO_FORMAT_INLINE void unpack_deinterleave_kernel(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            dst[ch*dst_stride + i] = audio_format_load(src, i*num_ch + ch, width);
+        }
+    }
+}
+
+AUDIO_FORMAT_INLINE void deinterleave_pack_kernel(void *dst, size_t dst_stride, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            audio_format_store(dst, ch*dst_stride + i, width, src[i*num_ch + ch]);
+        }
+    }
+}
+
+void audio_format_interleave(int32_t *dst, const int32_t *src, size_t src_stride, unsigned num_ch, size_t n)
+{
+#define CALL(NUM_CH) interleave_kernel(dst, src, src_stride, NUM_CH, n)
+    SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+    audio_format_interleave_ref(dst, src, src_stride, num_ch, n);
+}
+
+void audio_format_deinterleave(int32_t *dst, size_t dst_stride, const int32_t *src, unsigned num_ch, size_t n)
+{
+#define CALL(NUM_CH) deinterleave_kernel(dst, dst_stride, src, NUM_CH, n)
+    SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+    audio_format_deinterleave_ref(dst, dst_stride, src, num_ch, n);
+}
+
+void audio_format_pack(void *dst, audio_format_width_t width, const int32_t *src, size_t n)
+{
+#define CALL(WIDTH) pack_kernel(dst, WIDTH, src, n)
+    SPECIALISE_WIDTH(width, CALL);
+#undef CALL
+}
+
+void audio_format_unpack(int32_t *dst, const void *src, audio_format_width_t width, size_t n)
+{
+#define CALL(WIDTH) unpack_kernel(dst, src, WIDTH, n)
+    SPECIALISE_WIDTH(width, CALL);
+#undef CALL
+}
+
+void audio_format_gain(int32_t *dst, const int32_t *src, size_t n, uint32_t gain, unsigned frac_bits)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        dst[i] = audio_format_apply_gain(src[i], gain, frac_bits);
+    }
+}
+
+void audio_format_gain_pack_interleaved(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    if(gains == NULL)
+    {
+        // Without a gain the channels don't need telling apart
+#define CALL(WIDTH) pack_interleaved_kernel(dst, WIDTH, src, num_ch, n)
+        SPECIALISE_WIDTH(width, CALL);
+#undef CALL
+    }
+#define CALL_WIDTH(WIDTH) gain_pack_interleaved_kernel(dst, WIDTH, src, num_ch_const, n, gains, frac_bits)
+#define CALL(NUM_CH) do { const unsigned num_ch_const = NUM_CH; SPECIALISE_WIDTH(width, CALL_WIDTH); } while(0)
+    SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+#undef CALL_WIDTH
+    audio_format_gain_pack_interleaved_ref(dst, width, src, num_ch, n, gains, frac_bits);
+}
+
+void audio_format_unpack_deinterleave_gain(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    if(gains == NULL)
+    {
+#define CALL_WIDTH(WIDTH) unpack_deinterleave_kernel(dst, dst_stride, src, WIDTH, num_ch_const, n)
+#define CALL(NUM_CH) do { const unsigned num_ch_const = NUM_CH; SPECIALISE_WIDTH(width, CALL_WIDTH); } while(0)
+        SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+#undef CALL_WIDTH
+    }
+    else
+    {
+#define CALL_WIDTH(WIDTH) unpack_deinterleave_gain_kernel(dst, dst_stride, src, WIDTH, num_ch_const, n, gains, frac_bits)
+#define CALL(NUM_CH) do { const unsigned num_ch_const = NUM_CH; SPECIALISE_WIDTH(width, CALL_WIDTH); } while(0)
+        SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+#undef CALL_WIDTH
+    }
+    audio_format_unpack_deinterleave_gain_ref(dst, dst_stride, src, width, num_ch, n, gains, frac_bits);
+}
+
+void audio_format_deinterleave_pack(void *dst, size_t dst_stride, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n)
+{
+#define CALL_WIDTH(WIDTH) deinterleave_pack_kernel(dst, dst_stride, WIDTH, src, num_ch_const, n)
+#define CALL(NUM_CH) do { const unsigned num_ch_const = NUM_CH; SPECIALISE_WIDTH(width, CALL_WIDTH); } while(0)
+    SPECIALISE_CH(num_ch, CALL);
+#undef CALL
+#undef CALL_WIDTH
+    audio_format_deinterleave_pack_ref(dst, dst_stride, width, src, num_ch, n);
+}
@@ -0,0 +1,115 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef AUDIO_FORMAT_H
+#define AUDIO_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Sample layout and format conversion kernels shared by the example applications and tests.
+//
+// Deinterleaved ("[ch][n]") buffers hold each channel's samples contiguously, with consecutive channels stride samples
+// apart. Interleaved ("[n][ch]") buffers hold num_ch samples per frame. Packed buffers hold samples of one of the widths
+// in audio_format_width_t; internally samples are always left justified int32_t.
+//
+// The audio_format_*() functions are specialised for 2, 4, 6 and 8 channels and fall back to the portable reference
+// implementation, audio_format_*_ref(), for other channel counts. Both produce bit identical output.
+
+/// @brief Width of a packed sample
+typedef enum
+{
+    AUDIO_FORMAT_S16 = 2,   /// int16_t, the top 16 bits of the int32_t sample
+    AUDIO_FORMAT_S24 = 3,   /// 3 byte little endian, the top 24 bits of the int32_t sample
+    AUDIO_FORMAT_S32 = 4,   /// int32_t
+}audio_format_width_t;
+
+/// @brief Interleave num_ch channels of n samples each
+/// @param dst          Interleaved output, n * num_ch samples
+/// @param src          Deinterleaved input
+/// @param src_stride   Distance in samples between the start of consecutive channels in src
+/// @param num_ch       Number of channels
+/// @param n            Number of samples per channel
+void audio_format_interleave(int32_t *dst, const int32_t *src, size_t src_stride, unsigned num_ch, size_t n);
+
+/// @brief Deinterleave n frames of num_ch channels
+/// @param dst          Deinterleaved output
+/// @param dst_stride   Distance in samples between the start of consecutive channels in dst
+/// @param src          Interleaved input, n * num_ch samples
+/// @param num_ch       Number of channels
+/// @param n            Number of samples per channel
+void audio_format_deinterleave(int32_t *dst, size_t dst_stride, const int32_t *src, unsigned num_ch, size_t n);
+
+/// @brief Pack n int32_t samples to the given width by truncation, keeping the most significant bits
+/// @param dst      Packed output
+/// @param width    Width of the packed samples
+/// @param src      Input samples
+/// @param n        Number of samples
+void audio_format_pack(void *dst, audio_format_width_t width, const int32_t *src, size_t n);
+
+/// @brief Unpack n samples of the given width to left justified int32_t samples
+/// @param dst      Output samples
+/// @param src      Packed input
+/// @param width    Width of the packed samples
+/// @param n        Number of samples
+void audio_format_unpack(int32_t *dst, const void *src, audio_format_width_t width, size_t n);
+
+/// @brief Apply a gain to n samples. Each output is ((int64_t)src * gain) >> frac_bits, saturated to int32_t.
+/// dst may be equal to src.
+/// @param dst          Output samples
+/// @param src          Input samples
+/// @param n            Number of samples
+/// @param gain         Gain, with frac_bits fractional bits
+/// @param frac_bits    Number of fractional bits in gain
+void audio_format_gain(int32_t *dst, const int32_t *src, size_t n, uint32_t gain, unsigned frac_bits);
+
+/// @brief Apply a per channel gain to n interleaved frames and pack them to the given width, keeping them interleaved.
+/// Equivalent to audio_format_gain() on each channel followed by audio_format_pack().
+/// @param dst          Interleaved packed output, n * num_ch samples
+/// @param width        Width of the packed samples
+/// @param src          Interleaved input, n * num_ch samples
+/// @param num_ch       Number of channels
+/// @param n            Number of frames
+/// @param gains        num_ch per channel gains, or NULL for unity gain
+/// @param frac_bits    Number of fractional bits in gains
+void audio_format_gain_pack_interleaved(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits);
+
+/// @brief Unpack n interleaved frames of the given width, deinterleave them and apply a per channel gain.
+/// Equivalent to audio_format_unpack() followed by audio_format_deinterleave() and audio_format_gain() on each channel.
+/// @param dst          Deinterleaved output
+/// @param dst_stride   Distance in samples between the start of consecutive channels in dst
+/// @param src          Interleaved packed input, n * num_ch samples
+/// @param width        Width of the packed samples
+/// @param num_ch       Number of channels
+/// @param n            Number of frames
+/// @param gains        num_ch per channel gains, or NULL for unity gain
+/// @param frac_bits    Number of fractional bits in gains
+void audio_format_unpack_deinterleave_gain(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits);
+
+/// @brief Deinterleave n frames of num_ch channels and pack them to the given width.
+/// Equivalent to audio_format_deinterleave() followed by audio_format_pack() on each channel.
+/// @param dst          Deinterleaved packed output
+/// @param dst_stride   Distance in samples between the start of consecutive channels in dst
+/// @param width        Width of the packed samples
+/// @param src          Interleaved input, n * num_ch samples
+/// @param num_ch       Number of channels
+/// @param n            Number of samples per channel
+void audio_format_deinterleave_pack(void *dst, size_t dst_stride, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n);
+
+// Portable reference implementations. Same arguments and output as the functions above, for any channel count.
+void audio_format_interleave_ref(int32_t *dst, const int32_t *src, size_t src_stride, unsigned num_ch, size_t n);
+void audio_format_deinterleave_ref(int32_t *dst, size_t dst_stride, const int32_t *src, unsigned num_ch, size_t n);
+void audio_format_pack_ref(void *dst, audio_format_width_t width, const int32_t *src, size_t n);
+void audio_format_unpack_ref(int32_t *dst, const void *src, audio_format_width_t width, size_t n);
+void audio_format_gain_ref(int32_t *dst, const int32_t *src, size_t n, uint32_t gain, unsigned frac_bits);
+void audio_format_gain_pack_interleaved_ref(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits);
+void audio_format_unpack_deinterleave_gain_ref(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits);
+void audio_format_deinterleave_pack_ref(void *dst, size_t dst_stride, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
@@ -0,0 +1,65 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef AUDIO_FORMAT_IMPL_H
+#define AUDIO_FORMAT_IMPL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_format.h"
+
+// Per sample helpers shared by the reference and the specialised implementations
+
+#define AUDIO_FORMAT_INLINE static inline __attribute__((always_inline))
+
+AUDIO_FORMAT_INLINE int32_t audio_format_apply_gain(int32_t samp, uint32_t gain, unsigned frac_bits)
+{
+    int64_t prod = ((int64_t)samp * (int64_t)gain) >> frac_bits;
+    if(prod > INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    else if(prod < INT32_MIN)
+    {
+        return INT32_MIN;
+    }
+    return (int32_t)prod;
+}
+
+AUDIO_FORMAT_INLINE void audio_format_store(void *dst, size_t index, audio_format_width_t width, int32_t samp)
+{
+    switch(width)
+    {
+    case AUDIO_FORMAT_S16:
+        ((int16_t *)dst)[index] = (int16_t)(samp >> 16);
+        break;
+    case AUDIO_FORMAT_S24:
+    {
+        uint8_t *p = (uint8_t *)dst + 3*index;
+        p[0] = (uint8_t)((uint32_t)samp >> 8);
+        p[1] = (uint8_t)((uint32_t)samp >> 16);
+        p[2] = (uint8_t)((uint32_t)samp >> 24);
+        break;
+    }
+    default:
+        ((int32_t *)dst)[index] = samp;
+        break;
+    }
+}
+
+AUDIO_FORMAT_INLINE int32_t audio_format_load(const void *src, size_t index, audio_format_width_t width)
+{
+    switch(width)
+    {
+    case AUDIO_FORMAT_S16:
+        return (int32_t)((uint32_t)(uint16_t)((const int16_t *)src)[index] << 16);
+    case AUDIO_FORMAT_S24:
+    {
+        const uint8_t *p = (const uint8_t *)src + 3*index;
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+    }
+    default:
+        return ((const int32_t *)src)[index];
+    }
+}
+
+#endif
@@ -0,0 +1,93 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include "audio_format.h"
+#include "audio_format_impl.h"
+
+void audio_format_interleave_ref(int32_t *dst, const int32_t *src, size_t src_stride, unsigned num_ch, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            dst[i*num_ch + ch] = src[ch*src_stride + i];
+        }
+    }
+}
+
+void audio_format_deinterleave_ref(int32_t *dst, size_t dst_stride, const int32_t *src, unsigned num_ch, size_t n)
+{
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        for(size_t i=0; i<n; i++)
+        {
+            dst[ch*dst_stride + i] = src[i*num_ch + ch];
+        }
+    }
+}
+
+void audio_format_pack_ref(void *dst, audio_format_width_t width, const int32_t *src, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        audio_format_store(dst, i, width, src[i]);
+    }
+}
+
+void audio_format_unpack_ref(int32_t *dst, const void *src, audio_format_width_t width, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        dst[i] = audio_format_load(src, i, width);
+    }
+}
+
+void audio_format_gain_ref(int32_t *dst, const int32_t *src, size_t n, uint32_t gain, unsigned frac_bits)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        dst[i] = audio_format_apply_gain(src[i], gain, frac_bits);
+    }
+}
+
+void audio_format_gain_pack_interleaved_ref(void *dst, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            int32_t samp = src[i*num_ch + ch];
+            if(gains != NULL)
+            {
+                samp = audio_format_apply_gain(samp, gains[ch], frac_bits);
+            }
+            audio_format_store(dst, i*num_ch + ch, width, samp);
+        }
+    }
+}
+
+void audio_format_unpack_deinterleave_gain_ref(int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, unsigned num_ch, size_t n, const uint32_t *gains, unsigned frac_bits)
+{
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        for(size_t i=0; i<n; i++)
+        {
+            int32_t samp = audio_format_load(src, i*num_ch + ch, width);
+            if(gains != NULL)
+            {
+                samp = audio_format_apply_gain(samp, gains[ch], frac_bits);
+            }
+            dst[ch*dst_stride + i] = samp;
+        }
+    }
+}
+
+void audio_format_deinterleave_pack_ref(void *dst, size_t dst_stride, audio_format_width_t width, const int32_t *src, unsigned num_ch, size_t n)
+{
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        for(size_t i=0; i<n; i++)
+        {
+            audio_format_store(dst, ch*dst_stride + i, width, src[i*num_ch + ch]);
+        }
+    }
+}
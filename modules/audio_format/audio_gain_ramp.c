@@ -0,0 +1,117 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+#if __xcore__
+#include <xcore/assert.h>
+#else
+#include <assert.h>
+#define xassert assert
+#endif
+#include "audio_gain_ramp.h"
+#include "audio_format_impl.h"
+
+void audio_gain_ramp_init(audio_gain_ramp_t *state, unsigned num_ch, unsigned ramp_length, unsigned frac_bits, const uint32_t *gains)
+{
+    xassert(num_ch <= AUDIO_GAIN_RAMP_MAX_CH);
+    memset(state, 0, sizeof(audio_gain_ramp_t));
+    state->num_ch = num_ch;
+    state->ramp_length = ramp_length;
+    state->frac_bits = frac_bits;
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        state->gain[ch] = gains[ch];
+        state->target[ch] = gains[ch];
+    }
+}
+
+void audio_gain_ramp_set_targets(audio_gain_ramp_t *state, const uint32_t *targets)
+{
+    for(unsigned ch=0; ch<state->num_ch; ch++)
+    {
+        uint32_t target = targets[ch];
+        if(target == state->target[ch])
+        {
+            continue;
+        }
+        state->target[ch] = target;
+        if(state->ramp_length == 0)
+        {
+            state->gain[ch] = target;
+            state->ramp_remaining[ch] = 0;
+            continue;
+        }
+        // Restart from wherever the channel is now, which may be part way through a previous ramp
+        state->ramp_acc[ch] = (int64_t)state->gain[ch] << AUDIO_GAIN_RAMP_ACC_FRAC_BITS;
+        state->ramp_step[ch] = (((int64_t)target << AUDIO_GAIN_RAMP_ACC_FRAC_BITS) - state->ramp_acc[ch]) / (int64_t)state->ramp_length;
+        state->ramp_remaining[ch] = state->ramp_length;
+    }
+}
+
+bool audio_gain_ramp_active(const audio_gain_ramp_t *state)
+{
+    for(unsigned ch=0; ch<state->num_ch; ch++)
+    {
+        if(state->ramp_remaining[ch] != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Gain for the next sample of a channel. The last sample of a ramp lands exactly on the target, so the truncated step
+// doesn't leave the channel slightly off.
+static inline uint32_t next_gain(audio_gain_ramp_t *state, unsigned ch)
+{
+    if(state->ramp_remaining[ch] != 0)
+    {
+        state->ramp_remaining[ch]--;
+        if(state->ramp_remaining[ch] == 0)
+        {
+            state->gain[ch] = state->target[ch];
+        }
+        else
+        {
+            state->ramp_acc[ch] += state->ramp_step[ch];
+            state->gain[ch] = (uint32_t)(state->ramp_acc[ch] >> AUDIO_GAIN_RAMP_ACC_FRAC_BITS);
+        }
+    }
+    return state->gain[ch];
+}
+
+void audio_gain_ramp_pack_interleaved(audio_gain_ramp_t *state, void *dst, audio_format_width_t width, const int32_t *src, size_t n)
+{
+    const unsigned num_ch = state->num_ch;
+    if(!audio_gain_ramp_active(state))
+    {
+        audio_format_gain_pack_interleaved(dst, width, src, num_ch, n, state->gain, state->frac_bits);
+        return;
+    }
+    for(size_t i=0; i<n; i++)
+    {
+        for(unsigned ch=0; ch<num_ch; ch++)
+        {
+            int32_t samp = audio_format_apply_gain(src[i*num_ch + ch], next_gain(state, ch), state->frac_bits);
+            audio_format_store(dst, i*num_ch + ch, width, samp);
+        }
+    }
+}
+
+void audio_gain_ramp_unpack_deinterleave(audio_gain_ramp_t *state, int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, size_t n)
+{
+    const unsigned num_ch = state->num_ch;
+    if(!audio_gain_ramp_active(state))
+    {
+        audio_format_unpack_deinterleave_gain(dst, dst_stride, src, width, num_ch, n, state->gain, state->frac_bits);
+        return;
+    }
+    audio_format_unpack_deinterleave_gain(dst, dst_stride, src, width, num_ch, n, NULL, state->frac_bits);
+    for(unsigned ch=0; ch<num_ch; ch++)
+    {
+        int32_t *ch_samples = &dst[ch*dst_stride];
+        for(size_t i=0; i<n; i++)
+        {
+            ch_samples[i] = audio_format_apply_gain(ch_samples[i], next_gain(state, ch), state->frac_bits);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef AUDIO_GAIN_RAMP_H
+#define AUDIO_GAIN_RAMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "audio_format.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Per channel block gain stage. When a channel's target gain changes, its gain moves linearly from the current value to
+// the new target over ramp_length samples instead of jumping, so volume and mute changes don't click. While no channel is
+// ramping, blocks go straight through the fused audio_format kernels and the output is the same as audio_format_gain().
+
+#define AUDIO_GAIN_RAMP_MAX_CH          (8)
+#define AUDIO_GAIN_RAMP_ACC_FRAC_BITS   (16)    // Extra fractional bits kept in the ramp accumulator
+
+/// @brief Structure containing persistant variables that make up the gain stage state
+typedef struct
+{
+    unsigned num_ch;                                /// Number of channels
+    unsigned ramp_length;                           /// Number of samples over which a gain change is ramped
+    unsigned frac_bits;                             /// Number of fractional bits in the gains
+    uint32_t gain[AUDIO_GAIN_RAMP_MAX_CH];          /// Gain applied to the most recent sample of each channel
+    uint32_t target[AUDIO_GAIN_RAMP_MAX_CH];        /// Gain each channel is ramping towards
+    int64_t ramp_acc[AUDIO_GAIN_RAMP_MAX_CH];       /// Ramp gain, with AUDIO_GAIN_RAMP_ACC_FRAC_BITS extra fractional bits
+    int64_t ramp_step[AUDIO_GAIN_RAMP_MAX_CH];      /// Per sample increment of ramp_acc
+    unsigned ramp_remaining[AUDIO_GAIN_RAMP_MAX_CH];/// Samples left in the ramp. 0 once the channel has reached its target
+}audio_gain_ramp_t;
+
+/// @brief Initialise a gain stage, with every channel steady at its initial gain
+/// @param state        Pointer to the gain stage state
+/// @param num_ch       Number of channels. At most AUDIO_GAIN_RAMP_MAX_CH
+/// @param ramp_length  Number of samples over which a gain change is ramped. 0 to apply changes instantly
+/// @param frac_bits    Number of fractional bits in the gains
+/// @param gains        num_ch initial gains
+void audio_gain_ramp_init(audio_gain_ramp_t *state, unsigned num_ch, unsigned ramp_length, unsigned frac_bits, const uint32_t *gains);
+
+/// @brief Set the target gain of every channel. A channel whose target changes starts a new ramp from the gain it is at
+/// now, so changes arriving mid-ramp don't cause a step either. Typically called once per block with the latest gains.
+/// @param state    Pointer to the gain stage state
+/// @param targets  num_ch target gains
+void audio_gain_ramp_set_targets(audio_gain_ramp_t *state, const uint32_t *targets);
+
+/// @brief Check whether any channel is ramping
+/// @param state    Pointer to the gain stage state
+/// @return bool    true if at least one channel has not reached its target yet
+bool audio_gain_ramp_active(const audio_gain_ramp_t *state);
+
+/// @brief Apply the gains to n interleaved frames and pack them to the given width, keeping them interleaved.
+/// Same output as audio_format_gain_pack_interleaved() while no channel is ramping.
+/// @param state    Pointer to the gain stage state
+/// @param dst      Interleaved packed output, n * num_ch samples
+/// @param width    Width of the packed samples
+/// @param src      Interleaved input, n * num_ch samples
+/// @param n        Number of frames
+void audio_gain_ramp_pack_interleaved(audio_gain_ramp_t *state, void *dst, audio_format_width_t width, const int32_t *src, size_t n);
+
+/// @brief Unpack and deinterleave n frames of the given width and apply the gains.
+/// Same output as audio_format_unpack_deinterleave_gain() while no channel is ramping.
+/// @param state        Pointer to the gain stage state
+/// @param dst          Deinterleaved output
+/// @param dst_stride   Distance in samples between the start of consecutive channels in dst
+/// @param src          Interleaved packed input, n * num_ch samples
+/// @param width        Width of the packed samples
+/// @param n            Number of frames
+void audio_gain_ramp_unpack_deinterleave(audio_gain_ramp_t *state, int32_t *dst, size_t dst_stride, const void *src, audio_format_width_t width, size_t n);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
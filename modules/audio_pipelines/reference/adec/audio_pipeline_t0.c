@@ -67,6 +67,11 @@ static void *audio_pipeline_input_i(void *input_app_data)
 static int audio_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
+    audio_pipeline_telemetry_update(&frame_data->telemetry,
+                                    get_reference_time(),
+                                    AUDIO_PIPELINE_TELEMETRY_FRAME_TICKS(appconfAUDIO_PIPELINE_FRAME_ADVANCE,
+                                                                         appconfAUDIO_PIPELINE_SAMPLE_RATE));
+
     return audio_pipeline_output(output_app_data,
                                (int32_t **)frame_data->samples,
                                6,
@@ -78,6 +83,9 @@ static void stage_vnr_and_ic(frame_data_t *frame_data)
 #if appconfAUDIO_PIPELINE_SKIP_IC_AND_VNR
 #else
     int32_t DWORD_ALIGNED ic_output[appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+
+    ic_stage_state.state.config_params.bypass = (frame_data->tuning.bypass & AUDIO_PIPELINE_BYPASS_IC) != 0;
+
     ic_filter(&ic_stage_state.state,
               frame_data->samples[0],
               frame_data->samples[1],
@@ -85,6 +93,8 @@ static void stage_vnr_and_ic(frame_data_t *frame_data)
 
     vnr_pred_state_t *vnr_pred_state = &vnr_pred_stage_state.vnr_pred_state;
     ic_calc_vnr_pred(&ic_stage_state.state, &vnr_pred_state->input_vnr_pred, &vnr_pred_state->output_vnr_pred);
+    frame_data->telemetry.vnr_input = float_s32_to_float(vnr_pred_state->input_vnr_pred);
+    frame_data->telemetry.vnr_output = float_s32_to_float(vnr_pred_state->output_vnr_pred);
 
     float_s32_t agc_vnr_threshold = f32_to_float_s32(VNR_AGC_THRESHOLD);
     frame_data->vnr_pred_flag = float_s32_gt(vnr_pred_stage_state.vnr_pred_state.output_vnr_pred, agc_vnr_threshold);
@@ -102,6 +112,11 @@ static void stage_ns(frame_data_t *frame_data)
 #else
     int32_t DWORD_ALIGNED ns_output[appconfAUDIO_PIPELINE_FRAME_ADVANCE];
     configASSERT(NS_FRAME_ADVANCE == appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+
+    if (frame_data->tuning.bypass & AUDIO_PIPELINE_BYPASS_NS) {
+        return;
+    }
+
     ns_process_frame(
                 &ns_stage_state.state,
                 ns_output,
@@ -110,13 +125,44 @@ static void stage_ns(frame_data_t *frame_data)
 #endif
 }
 
+#if appconfAUDIO_PIPELINE_SKIP_AGC
+#else
+/* A tuned AGC limit in Q16.16, or the profile's limit if it is 0 */
+static float_s32_t agc_limit(uint32_t value_q16, float_s32_t profile_value)
+{
+    return (value_q16 == 0) ? profile_value : f32_to_float_s32(value_q16 / 65536.0f);
+}
+#endif
+
 static void stage_agc(frame_data_t *frame_data)
 {
 #if appconfAUDIO_PIPELINE_SKIP_AGC
 #else
+    static uint32_t agc_gain_q16 = 0;
     int32_t DWORD_ALIGNED agc_output[appconfAUDIO_PIPELINE_FRAME_ADVANCE];
     configASSERT(AGC_FRAME_ADVANCE == appconfAUDIO_PIPELINE_FRAME_ADVANCE);
 
+    if (frame_data->tuning.agc_gain_q16 != agc_gain_q16) {
+        agc_gain_q16 = frame_data->tuning.agc_gain_q16;
+        if (agc_gain_q16 == 0) {
+            // Adapt again, from the last fixed gain
+            agc_stage_state.state.config.adapt = AGC_PROFILE_ASR.adapt;
+        } else {
+            agc_stage_state.state.config.adapt = 0;
+            agc_stage_state.state.config.gain = f32_to_float_s32(agc_gain_q16 / 65536.0f);
+        }
+    }
+
+    agc_stage_state.state.config.max_gain = agc_limit(frame_data->tuning.agc_max_gain_q16, AGC_PROFILE_ASR.max_gain);
+    agc_stage_state.state.config.min_gain = agc_limit(frame_data->tuning.agc_min_gain_q16, AGC_PROFILE_ASR.min_gain);
+    agc_stage_state.state.config.upper_threshold = agc_limit(frame_data->tuning.agc_upper_threshold_q16, AGC_PROFILE_ASR.upper_threshold);
+    agc_stage_state.state.config.lower_threshold = agc_limit(frame_data->tuning.agc_lower_threshold_q16, AGC_PROFILE_ASR.lower_threshold);
+
+    if (frame_data->tuning.bypass & AUDIO_PIPELINE_BYPASS_AGC) {
+        frame_data->telemetry.agc_gain = 1.0f;
+        return;
+    }
+
     agc_stage_state.md.vnr_flag = frame_data->vnr_pred_flag;
     agc_stage_state.md.aec_ref_power = frame_data->max_ref_energy;
     agc_stage_state.md.aec_corr_factor = frame_data->aec_corr_factor;
@@ -126,12 +172,19 @@ static void stage_agc(frame_data_t *frame_data)
             agc_output,
             frame_data->samples[0],
             &agc_stage_state.md);
+    frame_data->telemetry.agc_gain = float_s32_to_float(agc_stage_state.state.config.gain);
     memcpy(frame_data->samples, agc_output, appconfAUDIO_PIPELINE_FRAME_ADVANCE * sizeof(int32_t));
 #endif
 }
 
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_vnr_and_ic, AUDIO_PIPELINE_STAGE_IC)
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_ns, AUDIO_PIPELINE_STAGE_NS)
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_agc, AUDIO_PIPELINE_STAGE_AGC)
+
 static void initialize_pipeline_stages(void)
 {
+    audio_pipeline_telemetry_reset();
+
     ic_init(&ic_stage_state.state);
 
     ns_init(&ns_stage_state.state);
@@ -148,15 +201,15 @@ void audio_pipeline_init(
     const int stage_count = 3;
 
     const pipeline_stage_t stages[] = {
-        (pipeline_stage_t)stage_vnr_and_ic,
-        (pipeline_stage_t)stage_ns,
-        (pipeline_stage_t)stage_agc,
+        (pipeline_stage_t)stage_vnr_and_ic_timed,
+        (pipeline_stage_t)stage_ns_timed,
+        (pipeline_stage_t)stage_agc_timed,
     };
 
     const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_vnr_and_ic) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i),
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_ns),
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_agc) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_vnr_and_ic_timed) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_ns_timed),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_agc_timed) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i),
     };
 
     initialize_pipeline_stages();
@@ -42,11 +42,22 @@ static void *audio_pipeline_input_i(void *input_app_data)
     frame_data = pvPortMalloc(sizeof(frame_data_t));
     memset(frame_data, 0x00, sizeof(frame_data_t));
 
+    audio_pipeline_tuning_latch(&frame_data->tuning);
+
     audio_pipeline_input(input_app_data,
                        (int32_t **)frame_data->aec_reference_audio_samples,
                        4,
                        appconfAUDIO_PIPELINE_FRAME_ADVANCE);
 
+    frame_data->telemetry.mic_energy = audio_pipeline_telemetry_energy(
+                                            frame_data->mic_samples_passthrough[0],
+                                            appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    for (int ch = 0; ch < AP_MAX_X_CHANNELS; ch++) {
+        frame_data->telemetry.ref_energy += audio_pipeline_telemetry_energy(
+                                                frame_data->aec_reference_audio_samples[ch],
+                                                appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    }
+
     frame_data->vnr_pred_flag = 0;
 
     memcpy(frame_data->samples, frame_data->mic_samples_passthrough, sizeof(frame_data->samples));
@@ -68,8 +79,31 @@ static void stage_aec(frame_data_t *frame_data)
 {
 #if appconfAUDIO_PIPELINE_SKIP_AEC
 #else
+    static uint32_t adec_force_count = 0;
     int32_t DWORD_ALIGNED stage_1_out[AEC_MAX_Y_CHANNELS][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
 
+    stage_1_state.adec_state.adec_config.bypass = (frame_data->tuning.adec_mode != AUDIO_PIPELINE_ADEC_AUTO);
+    if (frame_data->tuning.adec_force_count != adec_force_count) {
+        // Cleared by stage_1_process_frame() once ADEC has requested the delay estimation cycle
+        stage_1_state.adec_state.adec_config.force_de_cycle_trigger = 1;
+        adec_force_count = frame_data->tuning.adec_force_count;
+    }
+    frame_data->telemetry.mic_delay_samples = stage_1_state.delay_state.delay_samples;
+
+    if (frame_data->tuning.bypass & AUDIO_PIPELINE_BYPASS_AEC) {
+        frame_data->max_ref_energy = AGC_META_DATA_NO_AEC;
+        frame_data->aec_corr_factor = AGC_META_DATA_NO_AEC;
+        return;
+    }
+
+    if (!stage_1_state.delay_estimator_enabled) {
+        // Delay estimation cycles force the adaption on, and the AEC is reinitialised when they end
+        stage_1_state.aec_main_state.shared_state->config_params.coh_mu_conf.adaption_config =
+            (frame_data->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_ON) ? AEC_ADAPTION_FORCE_ON :
+            (frame_data->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_OFF) ? AEC_ADAPTION_FORCE_OFF :
+            AEC_ADAPTION_AUTO;
+    }
+
     stage_1_process_frame(&stage_1_state,
                           &stage_1_out[0],
                           &frame_data->max_ref_energy,
@@ -82,6 +116,8 @@ static void stage_aec(frame_data_t *frame_data)
 #endif
 }
 
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_aec, AUDIO_PIPELINE_STAGE_AEC)
+
 static void initialize_pipeline_stages(void)
 {
     aec_non_de_mode_conf.num_y_channels = 2;
@@ -107,11 +143,11 @@ void audio_pipeline_init(
     const int stage_count = 1;
 
     const pipeline_stage_t stages[] = {
-        (pipeline_stage_t)stage_aec,
+        (pipeline_stage_t)stage_aec_timed,
     };
 
     const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_aec) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_aec_timed) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i),
 
     };
 
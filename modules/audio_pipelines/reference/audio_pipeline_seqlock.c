@@ -0,0 +1,44 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* STD headers */
+#include <stdint.h>
+#include <string.h>
+
+/* App headers */
+#include "audio_pipeline_seqlock.h"
+
+void audio_pipeline_seqlock_write(audio_pipeline_seqlock_t *lock, const void *value)
+{
+    const uint8_t *bytes = value;
+    uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&lock->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < lock->num_words; i++) {
+        uint32_t word;
+        memcpy(&word, &bytes[i * sizeof(uint32_t)], sizeof(word));
+        __atomic_store_n(&lock->words[i], word, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&lock->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+bool audio_pipeline_seqlock_try_read(audio_pipeline_seqlock_t *lock, void *value)
+{
+    uint8_t *bytes = value;
+    uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE);
+
+    for (size_t i = 0; i < lock->num_words; i++) {
+        uint32_t word = __atomic_load_n(&lock->words[i], __ATOMIC_RELAXED);
+        memcpy(&bytes[i * sizeof(uint32_t)], &word, sizeof(word));
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return ((seq & 1) == 0) && (__atomic_load_n(&lock->seq, __ATOMIC_RELAXED) == seq);
+}
+
+void audio_pipeline_seqlock_read(audio_pipeline_seqlock_t *lock, void *value)
+{
+    while (!audio_pipeline_seqlock_try_read(lock, value)) {
+    }
+}
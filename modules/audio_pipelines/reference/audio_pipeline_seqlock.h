@@ -0,0 +1,48 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef AUDIO_PIPELINE_SEQLOCK_H_
+#define AUDIO_PIPELINE_SEQLOCK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A value shared between one writer and any number of readers, on any
+ * threads or cores of a tile, without either side ever blocking the other.
+ *
+ * The value is stored as words guarded by a sequence count, which is odd
+ * while the writer is copying a new value in. A reader's copy is consistent
+ * if the count was even and did not change while it copied the words.
+ */
+
+typedef struct {
+    uint32_t seq;
+    uint32_t *words;
+    size_t num_words;
+} audio_pipeline_seqlock_t;
+
+/// @brief Words of storage for a value of the given type, which must be a whole number of words
+#define AUDIO_PIPELINE_SEQLOCK_WORDS(type) (sizeof(type) / sizeof(uint32_t))
+
+/// @brief Static initialiser of a seqlock over storage words, an array of AUDIO_PIPELINE_SEQLOCK_WORDS()
+#define AUDIO_PIPELINE_SEQLOCK_INIT(storage) { .seq = 0, .words = (storage), .num_words = sizeof(storage) / sizeof(uint32_t) }
+
+/// @brief Publish a new value. Only one thread may write a seqlock.
+/// @param lock     The seqlock
+/// @param value    The value, of lock->num_words words
+void audio_pipeline_seqlock_write(audio_pipeline_seqlock_t *lock, const void *value);
+
+/// @brief Copy the published value once, without waiting
+/// @param lock     The seqlock
+/// @param value    Set to the value, of lock->num_words words. Undefined if false is returned.
+/// @return bool    false if the writer was publishing during the copy
+bool audio_pipeline_seqlock_try_read(audio_pipeline_seqlock_t *lock, void *value);
+
+/// @brief Copy the published value, retrying until the copy is consistent
+/// @param lock     The seqlock
+/// @param value    Set to the value, of lock->num_words words
+void audio_pipeline_seqlock_read(audio_pipeline_seqlock_t *lock, void *value);
+
+#endif /* AUDIO_PIPELINE_SEQLOCK_H_ */
@@ -0,0 +1,169 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* STD headers */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/* App headers */
+#include "audio_pipeline_seqlock.h"
+#include "audio_pipeline_telemetry.h"
+
+#define SMOOTHING       (0.125f)    // Weight of each frame in the smoothed values, a time constant of about 8 frames
+#define MIN_ENERGY      (1e-12f)    // Floor of the energies compared in dB, -120 dB relative to full scale
+
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped_frames;
+    float erle_mic_energy;
+    float erle_aec_energy;
+    float stage_energy[AUDIO_PIPELINE_NUM_STAGES];
+    float vnr_input;
+    float vnr_output;
+    float agc_gain;
+    int32_t mic_delay_samples;
+    float stage_ticks[AUDIO_PIPELINE_NUM_STAGES];
+    uint32_t stage_ticks_peak[AUDIO_PIPELINE_NUM_STAGES];
+    audio_pipeline_telemetry_frame_t frame;    // The last frame's own measurements
+} telemetry_state_t;
+
+/*
+ * Only the pipeline output updates the state, and it publishes a copy for the
+ * readers after each frame.
+ */
+static telemetry_state_t state;
+static uint32_t window_peak[2][AUDIO_PIPELINE_NUM_STAGES];
+static uint32_t window_frames;
+static uint32_t last_output_time;
+
+static uint32_t published[AUDIO_PIPELINE_SEQLOCK_WORDS(telemetry_state_t)];
+static audio_pipeline_seqlock_t published_lock = AUDIO_PIPELINE_SEQLOCK_INIT(published);
+
+float audio_pipeline_telemetry_energy(const int32_t *samples, unsigned count)
+{
+    int64_t sum = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        int32_t x = samples[i] >> 8;
+        sum += (int64_t)x * x;
+    }
+
+    // Each square is of a sample scaled by 2^-8, so full scale is 2^46
+    return ((float)sum / (float)(1LL << 46)) / count;
+}
+
+static float smooth(float smoothed, float value)
+{
+    return smoothed + SMOOTHING * (value - smoothed);
+}
+
+static void publish(void)
+{
+    audio_pipeline_seqlock_write(&published_lock, &state);
+}
+
+void audio_pipeline_telemetry_reset(void)
+{
+    memset(&state, 0, sizeof(state));
+    memset(window_peak, 0, sizeof(window_peak));
+    window_frames = 0;
+    publish();
+}
+
+void audio_pipeline_telemetry_update(const audio_pipeline_telemetry_frame_t *frame,
+                                     uint32_t output_time,
+                                     uint32_t frame_ticks)
+{
+    if (state.frames == 0) {
+        // Start the smoothed values from the first frame
+        memcpy(state.stage_energy, frame->stage_energy, sizeof(state.stage_energy));
+        state.vnr_input = frame->vnr_input;
+        state.vnr_output = frame->vnr_output;
+        for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+            state.stage_ticks[i] = frame->stage_ticks[i];
+        }
+    } else {
+        uint32_t interval = output_time - last_output_time;
+
+        if (interval > frame_ticks + frame_ticks / 2) {
+            state.dropped_frames += (interval + frame_ticks / 2) / frame_ticks - 1;
+        }
+        for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+            state.stage_energy[i] = smooth(state.stage_energy[i], frame->stage_energy[i]);
+            state.stage_ticks[i] = smooth(state.stage_ticks[i], frame->stage_ticks[i]);
+        }
+        state.vnr_input = smooth(state.vnr_input, frame->vnr_input);
+        state.vnr_output = smooth(state.vnr_output, frame->vnr_output);
+    }
+    last_output_time = output_time;
+    state.frames++;
+
+    // The smoothed energies both start from 0, so their ratio needs no starting value
+    if (frame->ref_energy > AUDIO_PIPELINE_TELEMETRY_REF_ACTIVE_ENERGY) {
+        state.erle_mic_energy = smooth(state.erle_mic_energy, frame->mic_energy);
+        state.erle_aec_energy = smooth(state.erle_aec_energy, frame->stage_energy[AUDIO_PIPELINE_STAGE_AEC]);
+    }
+
+    state.agc_gain = frame->agc_gain;
+    state.mic_delay_samples = frame->mic_delay_samples;
+    state.frame = *frame;
+
+    // Each peak is held for the rest of its window and all of the next one
+    if (window_frames == AUDIO_PIPELINE_TELEMETRY_PEAK_FRAMES) {
+        memcpy(window_peak[0], window_peak[1], sizeof(window_peak[0]));
+        memset(window_peak[1], 0, sizeof(window_peak[1]));
+        window_frames = 0;
+    }
+    window_frames++;
+    for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+        if (frame->stage_ticks[i] > window_peak[1][i]) {
+            window_peak[1][i] = frame->stage_ticks[i];
+        }
+        state.stage_ticks_peak[i] = (window_peak[0][i] > window_peak[1][i]) ? window_peak[0][i] : window_peak[1][i];
+    }
+
+    publish();
+}
+
+static int32_t ratio_db_q8(float numerator, float denominator)
+{
+    return (int32_t)lroundf(256.0f * 10.0f * log10f((numerator + MIN_ENERGY) / (denominator + MIN_ENERGY)));
+}
+
+static void read_published(telemetry_state_t *copy)
+{
+    // The pipeline output takes far less than a frame to publish, so a retry is rare
+    audio_pipeline_seqlock_read(&published_lock, copy);
+}
+
+void audio_pipeline_telemetry_read(audio_pipeline_telemetry_t *telemetry)
+{
+    telemetry_state_t copy;
+
+    read_published(&copy);
+
+    telemetry->frames = copy.frames;
+    telemetry->dropped_frames = copy.dropped_frames;
+    telemetry->aec_erle_db_q8 = ratio_db_q8(copy.erle_mic_energy, copy.erle_aec_energy);
+    telemetry->ic_attenuation_db_q8 = ratio_db_q8(copy.stage_energy[AUDIO_PIPELINE_STAGE_AEC],
+                                                  copy.stage_energy[AUDIO_PIPELINE_STAGE_IC]);
+    telemetry->ns_attenuation_db_q8 = ratio_db_q8(copy.stage_energy[AUDIO_PIPELINE_STAGE_IC],
+                                                  copy.stage_energy[AUDIO_PIPELINE_STAGE_NS]);
+    telemetry->agc_gain_db_q8 = ratio_db_q8(copy.agc_gain * copy.agc_gain, 1.0f);
+    telemetry->vnr_input_q16 = (int32_t)lroundf(copy.vnr_input * 65536.0f);
+    telemetry->vnr_output_q16 = (int32_t)lroundf(copy.vnr_output * 65536.0f);
+    telemetry->mic_delay_samples = copy.mic_delay_samples;
+    for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+        telemetry->stage_ticks[i] = (uint32_t)lroundf(copy.stage_ticks[i]);
+        telemetry->stage_ticks_peak[i] = copy.stage_ticks_peak[i];
+    }
+}
+
+void audio_pipeline_telemetry_read_frame(audio_pipeline_telemetry_frame_t *frame)
+{
+    telemetry_state_t copy;
+
+    read_published(&copy);
+    *frame = copy.frame;
+}
@@ -0,0 +1,124 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef AUDIO_PIPELINE_TELEMETRY_H_
+#define AUDIO_PIPELINE_TELEMETRY_H_
+
+#include <stdint.h>
+
+/*
+ * Live telemetry of the reference pipelines.
+ *
+ * Each stage records its measurements of a frame in the frame's own record,
+ * which travels with the frame through every stage, on both tiles. The
+ * pipeline output folds the record into the telemetry once per frame, and a
+ * control task reads the telemetry at any time without holding up the
+ * pipeline. Levels are kept as smoothed energies, and only converted to dB
+ * when the telemetry is read.
+ */
+
+/* Stages that are timed, and whose output level is measured */
+typedef enum {
+    AUDIO_PIPELINE_STAGE_AEC = 0,
+    AUDIO_PIPELINE_STAGE_IC = 1,
+    AUDIO_PIPELINE_STAGE_NS = 2,
+    AUDIO_PIPELINE_STAGE_AGC = 3,
+    AUDIO_PIPELINE_NUM_STAGES
+} audio_pipeline_stage_t;
+
+/* Reference energy above which the AEC's ERLE is measured, -60 dB relative to full scale */
+#define AUDIO_PIPELINE_TELEMETRY_REF_ACTIVE_ENERGY  (1e-6f)
+
+/* Frames over which each stage's peak time is held */
+#define AUDIO_PIPELINE_TELEMETRY_PEAK_FRAMES        (64)
+
+/* Reference clock ticks in one frame */
+#define AUDIO_PIPELINE_TELEMETRY_FRAME_TICKS(frame_advance, sample_rate) \
+    ((uint32_t)(((uint64_t)(frame_advance) * 100000000) / (sample_rate)))
+
+/* One frame's measurements, recorded by the stages */
+typedef struct {
+    float mic_energy;           // Energy of mic 0 into the first stage
+    float ref_energy;           // Energy of the reference channels
+    float stage_energy[AUDIO_PIPELINE_NUM_STAGES];  // Energy of channel 0 out of each stage
+    float vnr_input;            // VNR estimate of the IC input, 0 to 1
+    float vnr_output;           // VNR estimate of the IC output, 0 to 1
+    float agc_gain;             // Gain applied by the AGC
+    int32_t mic_delay_samples;  // Delay of the mics relative to the reference, negative if the reference is delayed
+    uint32_t stage_ticks[AUDIO_PIPELINE_NUM_STAGES];    // Reference clock ticks taken by each stage
+} audio_pipeline_telemetry_frame_t;
+
+/* The telemetry, as read */
+typedef struct {
+    uint32_t frames;            // Frames output since startup
+    uint32_t dropped_frames;    // Frame periods in which the output had no frame
+    int32_t aec_erle_db_q8;     // Echo return loss enhancement of the AEC, while the reference is active
+    int32_t ic_attenuation_db_q8;
+    int32_t ns_attenuation_db_q8;
+    int32_t agc_gain_db_q8;
+    int32_t vnr_input_q16;
+    int32_t vnr_output_q16;
+    int32_t mic_delay_samples;
+    uint32_t stage_ticks[AUDIO_PIPELINE_NUM_STAGES];        // Smoothed ticks per frame
+    uint32_t stage_ticks_peak[AUDIO_PIPELINE_NUM_STAGES];   // Peak ticks per frame in the last 1 to 2 peak periods
+} audio_pipeline_telemetry_t;
+
+/*
+ * Defines <stage>_timed(), which runs <stage>() on a frame, and records the
+ * ticks it took and the energy of channel 0 that it output.
+ */
+#define AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage, index)                      \
+    static void stage##_timed(frame_data_t *frame_data)                         \
+    {                                                                           \
+        uint32_t start = get_reference_time();                                  \
+        stage(frame_data);                                                      \
+        frame_data->telemetry.stage_ticks[index] = get_reference_time() - start; \
+        frame_data->telemetry.stage_energy[index] = audio_pipeline_telemetry_energy( \
+                frame_data->samples[0], appconfAUDIO_PIPELINE_FRAME_ADVANCE);  \
+    }
+
+/**
+ * Measure the energy of a channel of samples.
+ *
+ * \param samples   The samples
+ * \param count     Number of samples
+ * \returns         Mean square of the samples, relative to full scale
+ */
+float audio_pipeline_telemetry_energy(const int32_t *samples, unsigned count);
+
+/**
+ * Restart the telemetry from no frames. Called by the pipeline output tile
+ * before the pipeline starts.
+ */
+void audio_pipeline_telemetry_reset(void);
+
+/**
+ * Fold a frame's measurements into the telemetry. Called by the pipeline
+ * output, once per frame.
+ *
+ * \param frame         The frame's measurements
+ * \param output_time   Reference time of the frame's output
+ * \param frame_ticks   Reference clock ticks in one frame
+ */
+void audio_pipeline_telemetry_update(const audio_pipeline_telemetry_frame_t *frame,
+                                     uint32_t output_time,
+                                     uint32_t frame_ticks);
+
+/**
+ * Read the telemetry, as of the last frame output. Never holds up the
+ * pipeline output, and can be called from any task on its tile.
+ *
+ * \param telemetry     Set to the telemetry
+ */
+void audio_pipeline_telemetry_read(audio_pipeline_telemetry_t *telemetry);
+
+/**
+ * Read the measurements of the last frame output, as recorded by the stages.
+ * Like audio_pipeline_telemetry_read(), can be called from any task on its
+ * tile.
+ *
+ * \param frame         Set to the last frame's measurements
+ */
+void audio_pipeline_telemetry_read_frame(audio_pipeline_telemetry_frame_t *frame);
+
+#endif /* AUDIO_PIPELINE_TELEMETRY_H_ */
@@ -0,0 +1,32 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* STD headers */
+#include <stdint.h>
+
+/* App headers */
+#include "audio_pipeline_seqlock.h"
+#include "audio_pipeline_tuning.h"
+
+/*
+ * The pipeline input never waits for a request: it keeps the settings it
+ * latched last if a request is being written while it copies them.
+ */
+static uint32_t requested[AUDIO_PIPELINE_SEQLOCK_WORDS(audio_pipeline_tuning_t)];
+static audio_pipeline_seqlock_t requested_lock = AUDIO_PIPELINE_SEQLOCK_INIT(requested);
+static audio_pipeline_tuning_t latched;
+
+void audio_pipeline_tuning_request(const audio_pipeline_tuning_t *tuning)
+{
+    audio_pipeline_seqlock_write(&requested_lock, tuning);
+}
+
+void audio_pipeline_tuning_latch(audio_pipeline_tuning_t *tuning)
+{
+    audio_pipeline_tuning_t request;
+
+    if (audio_pipeline_seqlock_try_read(&requested_lock, &request)) {
+        latched = request;
+    }
+    *tuning = latched;
+}
@@ -0,0 +1,78 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef AUDIO_PIPELINE_TUNING_H_
+#define AUDIO_PIPELINE_TUNING_H_
+
+#include <stdint.h>
+
+/*
+ * Runtime tuning of the reference pipelines.
+ *
+ * Settings are requested at any time from a control task, and latched by the
+ * pipeline input once per frame. The latched settings travel with the frame
+ * through every stage, on both tiles, so a change takes effect from one frame
+ * onwards in every stage at once and never part way through a frame.
+ *
+ * All zero is the default: every stage runs, ADEC only corrects the delay at
+ * startup, the AEC decides when to adapt its filters, and the AGC adapts
+ * within the limits of its profile.
+ *
+ * The NS can only be bypassed: fwk_voice's NS has no parameters that can be
+ * changed while it runs.
+ */
+
+/* Stage bypass bits */
+#define AUDIO_PIPELINE_BYPASS_AEC   (1 << 0)    // The mics pass through, and the AGC runs as if there is no reference
+#define AUDIO_PIPELINE_BYPASS_IC    (1 << 1)
+#define AUDIO_PIPELINE_BYPASS_NS    (1 << 2)
+#define AUDIO_PIPELINE_BYPASS_AGC   (1 << 3)
+#define AUDIO_PIPELINE_BYPASS_ALL   (0xF)
+
+typedef enum {
+    AUDIO_PIPELINE_ADEC_STARTUP = 0,    // Correct the delay once at startup, and when forced
+    AUDIO_PIPELINE_ADEC_AUTO = 1,       // Also correct whenever ADEC detects that the delay has changed
+    AUDIO_PIPELINE_NUM_ADEC_MODES
+} audio_pipeline_adec_mode_t;
+
+typedef enum {
+    AUDIO_PIPELINE_AEC_ADAPTION_AUTO = 0,       // Adapt the filters when the AEC detects echo without near-end speech
+    AUDIO_PIPELINE_AEC_ADAPTION_FORCE_ON = 1,   // Always adapt the filters
+    AUDIO_PIPELINE_AEC_ADAPTION_FORCE_OFF = 2,  // Freeze the filters
+    AUDIO_PIPELINE_NUM_AEC_ADAPTIONS
+} audio_pipeline_aec_adaption_t;
+
+typedef struct {
+    uint32_t bypass;            // AUDIO_PIPELINE_BYPASS_ bits
+    uint32_t adec_mode;         // audio_pipeline_adec_mode_t, in the ADEC pipelines
+    uint32_t adec_force_count;  // Each change forces a delay estimation cycle, in the ADEC pipelines
+    uint32_t agc_gain_q16;      // Fixed AGC gain in Q16.16, or 0 for the AGC to adapt its gain
+    uint32_t aec_adaption;      // audio_pipeline_aec_adaption_t. Delay estimation cycles in the ADEC pipelines override it.
+
+    /* Limits of the adapting AGC, in Q16.16, each 0 for the AGC profile's own value */
+    uint32_t agc_max_gain_q16;
+    uint32_t agc_min_gain_q16;
+    uint32_t agc_upper_threshold_q16;   // Output level, as a fraction of full scale, above which the gain decreases
+    uint32_t agc_lower_threshold_q16;   // Output level below which the gain increases
+} audio_pipeline_tuning_t;
+
+/**
+ * Request new settings, to be latched by the next frame input.
+ *
+ * Requests must come from one task at a time. Requests made while a frame is
+ * being latched are picked up by a later frame.
+ *
+ * \param tuning    The settings
+ */
+void audio_pipeline_tuning_request(const audio_pipeline_tuning_t *tuning);
+
+/**
+ * Latch the settings for the next frame. Called by the pipeline input, once
+ * per frame.
+ *
+ * \param tuning    Set to the settings of the last complete request, or to
+ *                  those of the previous frame if a request is being written.
+ */
+void audio_pipeline_tuning_latch(audio_pipeline_tuning_t *tuning);
+
+#endif /* AUDIO_PIPELINE_TUNING_H_ */
@@ -33,6 +33,8 @@
 #include "ns_api.h"
 #include "vnr_features_api.h"
 #include "vnr_inference_api.h"
+#include "audio_pipeline_tuning.h"
+#include "audio_pipeline_telemetry.h"
 
 
 /* Note: Changing the order here will effect the channel order for
@@ -48,6 +50,8 @@ typedef struct {
     float_s32_t max_ref_energy;
     float_s32_t aec_corr_factor;
     int32_t ref_active_flag;
+    audio_pipeline_tuning_t tuning;   // Latched by the pipeline input for this frame
+    audio_pipeline_telemetry_frame_t telemetry;   // Measured by the stages for this frame
 } frame_data_t;
 
 typedef struct stage_delay_ctx {
@@ -38,11 +38,22 @@ static void *audio_pipeline_input_i(void *input_app_data)
     frame_data = pvPortMalloc(sizeof(frame_data_t));
     memset(frame_data, 0x00, sizeof(frame_data_t));
 
+    audio_pipeline_tuning_latch(&frame_data->tuning);
+
     audio_pipeline_input(input_app_data,
                        (int32_t **)frame_data->aec_reference_audio_samples,
                        4,
                        appconfAUDIO_PIPELINE_FRAME_ADVANCE);
 
+    frame_data->telemetry.mic_energy = audio_pipeline_telemetry_energy(
+                                            frame_data->mic_samples_passthrough[0],
+                                            appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    for (int ch = 0; ch < AP_MAX_X_CHANNELS; ch++) {
+        frame_data->telemetry.ref_energy += audio_pipeline_telemetry_energy(
+                                                frame_data->aec_reference_audio_samples[ch],
+                                                appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    }
+
     frame_data->vnr_pred_flag = 0;
 
     memcpy(frame_data->samples, frame_data->mic_samples_passthrough, sizeof(frame_data->samples));
@@ -66,6 +77,8 @@ static void stage_delay(frame_data_t *frame_data)
 {
 #if appconfAUDIO_PIPELINE_SKIP_STATIC_DELAY
 #else
+    frame_data->telemetry.mic_delay_samples = 16000 * appconfINPUT_SAMPLES_MIC_DELAY_MS / 1000;
+
 #if (appconfINPUT_SAMPLES_MIC_DELAY_MS > 0) /* Delay mics */
     size_t bytes_sent = xStreamBufferSend(
                                 delay_buf_state.delay_buf,
@@ -113,6 +126,17 @@ static void stage_aec(frame_data_t *frame_data)
 #else
     int32_t DWORD_ALIGNED stage1_output[AEC_MAX_Y_CHANNELS][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
 
+    if (frame_data->tuning.bypass & AUDIO_PIPELINE_BYPASS_AEC) {
+        frame_data->max_ref_energy = AGC_META_DATA_NO_AEC;
+        frame_data->aec_corr_factor = AGC_META_DATA_NO_AEC;
+        return;
+    }
+
+    aec_state.aec_main_state.shared_state->config_params.coh_mu_conf.adaption_config =
+            (frame_data->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_ON) ? AEC_ADAPTION_FORCE_ON :
+            (frame_data->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_OFF) ? AEC_ADAPTION_FORCE_OFF :
+            AEC_ADAPTION_AUTO;
+
     aec_process_frame_1thread(
             &aec_state.aec_main_state,
             &aec_state.aec_shadow_state,
@@ -129,6 +153,8 @@ static void stage_aec(frame_data_t *frame_data)
 #endif
 }
 
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_aec, AUDIO_PIPELINE_STAGE_AEC)
+
 static void initialize_pipeline_stages(void)
 {
 #if (appconfINPUT_SAMPLES_MIC_DELAY_MS != 0)
@@ -155,12 +181,12 @@ void audio_pipeline_init(
     const int stage_count = 2;
     const pipeline_stage_t stages[] = {
         (pipeline_stage_t)stage_delay,
-        (pipeline_stage_t)stage_aec,
+        (pipeline_stage_t)stage_aec_timed,
     };
 
     const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
         configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_delay) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i),
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_aec) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_aec_timed) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i),
     };
 
     initialize_pipeline_stages();
@@ -101,6 +101,7 @@ set(APP_LINK_OPTIONS
 set(APP_COMMON_LINK_LIBRARIES
     rtos::freertos
     xscope_fileio
+    sln_voice::app::audio_format
     sln_voice_test_asr_board_support_xk_voice_l71
 )
 
@@ -20,6 +20,7 @@
 #include "wav_utils.h"
 #include "xscope_fileio_task.h"
 #include "xscope_io_device.h"
+#include "audio_format.h"
 
 #ifndef DWORD_ALIGNED
 #define DWORD_ALIGNED     __attribute__ ((aligned(8)))
@@ -170,11 +171,8 @@ void xscope_fileio_task(void *arg) {
 
         // De-interleave input and convert to 16-bit
         //  wav files are in frame-major order, pipeline expects sample-major order
-        for(unsigned f=0; f<appconfASR_BRICK_SIZE_SAMPLES; f++){
-            for(unsigned ch=0; ch<appconfINPUT_CHANNELS; ch++) {
-                in_buf_int_16[ch * appconfASR_BRICK_SIZE_SAMPLES + f] = in_buf_raw_32[f * appconfINPUT_CHANNELS + ch] >> 16;
-            }
-        }
+        audio_format_deinterleave_pack(in_buf_int_16, appconfASR_BRICK_SIZE_SAMPLES, AUDIO_FORMAT_S16,
+                                       (const int32_t *)in_buf_raw_32, appconfINPUT_CHANNELS, appconfASR_BRICK_SIZE_SAMPLES);
 
         // Send audio to ASR
         asr_error = asr_process(asr_ctx, in_buf_int_16, appconfASR_BRICK_SIZE_SAMPLES);
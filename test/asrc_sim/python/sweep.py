@@ -0,0 +1,164 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+# Parameter sweep and Monte-Carlo runner for the ASRC simulator.
+#
+# Runs many fast mode simulator instances in parallel, one per combination of app, I2S rate and controller setting,
+# repeated with randomised USB clock drift, SOF jitter and I2S rate switches. The buffer level statistics that each run
+# prints at the end are written to a CSV file with one row per run, and aggregated into one row per configuration in a
+# summary CSV file and a table on the screen.
+#
+# From the test/asrc_sim directory, after building the simulator, for example:
+# python python/sweep.py --rates 48000 96000 192000 --kp-scales 0.5 1 2 --runs 20 --time 600
+
+import argparse
+import csv
+import itertools
+import os
+import random
+import re
+import statistics
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+
+supported_rates = [44100, 48000, 88200, 96000, 176400, 192000]
+
+stats_fields = ["max_excursion", "max_avg_excursion", "lock_time", "underflows", "overflows", "min_level", "max_level"]
+config_fields = ["app", "i2s_rate", "kp_scale", "ki_scale", "window_log2", "stable_threshold", "ratio_delay"]
+run_fields = ["run", "seed", "drift_ppm", "sof_jitter_us", "switch_time", "switch_rate", "status"]
+
+
+def parse_stats(output):
+    m = re.search(r"^Stats: (.*)$", output, re.MULTILINE)
+    if m is None:
+        return None
+    stats = {}
+    for item in m.group(1).split():
+        key, value = item.split("=")
+        stats[key] = float(value) if key == "lock_time" else int(value)
+    return stats
+
+
+def make_runs(args):
+    rng = random.Random(args.seed)
+    runs = []
+    for app, rate, kp, ki, window, threshold, delay in itertools.product(args.apps, args.rates, args.kp_scales, args.ki_scales,
+                                                                         args.window_log2, args.stable_thresholds,
+                                                                         args.ratio_delays):
+        for run in range(args.runs):
+            params = {"app": app, "i2s_rate": rate, "kp_scale": kp, "ki_scale": ki, "window_log2": window,
+                      "stable_threshold": threshold, "ratio_delay": delay, "run": run, "seed": rng.randrange(1 << 31),
+                      "drift_ppm": round(rng.uniform(-args.ppm, args.ppm), 3),
+                      "sof_jitter_us": round(rng.uniform(0, args.sof_jitter), 3),
+                      "switch_time": 0, "switch_rate": 0}
+            # Rate switches are only simulated in the USB -> I2S direction
+            if (app == "usb_in_i2s_out") and (rng.random() < args.switch_prob):
+                params["switch_time"] = round(rng.uniform(args.time / 4, 3 * args.time / 4), 3)
+                params["switch_rate"] = rng.choice([r for r in supported_rates if r != rate])
+            runs.append(params)
+    return runs
+
+
+def run_one(args, params):
+    cmd = [os.path.join(args.build_dir, params["app"]), str(params["i2s_rate"]), "--fast",
+           "--time", str(args.time),
+           "--drift-ppm", str(params["drift_ppm"]),
+           "--sof-jitter", str(params["sof_jitter_us"]),
+           "--seed", str(params["seed"]),
+           "--kp-scale", str(params["kp_scale"]),
+           "--ki-scale", str(params["ki_scale"])]
+    if not args.full_asrc:
+        cmd += ["--asrc-count-model"]
+    if params["window_log2"] != 0:
+        cmd += ["--window-log2", str(params["window_log2"])]
+    if params["stable_threshold"] != 0:
+        cmd += ["--stable-threshold", str(params["stable_threshold"])]
+    if params["ratio_delay"] != 0:
+        cmd += ["--ratio-delay-blocks", str(params["ratio_delay"])]
+    if params["switch_time"] != 0:
+        cmd += ["--switch-time", str(params["switch_time"]), "--switch-rate", str(params["switch_rate"])]
+
+    result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    stats = parse_stats(result.stdout)
+    row = dict(params)
+    if (result.returncode != 0) or (stats is None):
+        row["status"] = "failed"
+    else:
+        row["status"] = "ok"
+        row.update(stats)
+    return row
+
+
+def summarise(rows):
+    summary = []
+    for key, group in itertools.groupby(rows, key=lambda r: tuple(r[f] for f in config_fields)):
+        group = list(group)
+        ok = [r for r in group if r["status"] == "ok"]
+        locked = [r["lock_time"] for r in ok if r["lock_time"] >= 0]
+        s = dict(zip(config_fields, key))
+        s["runs"] = len(group)
+        s["failed"] = len(group) - len(ok)
+        s["unlocked"] = len(ok) - len(locked)
+        s["mean_max_excursion"] = round(statistics.mean([r["max_excursion"] for r in ok]), 1) if ok else ""
+        s["max_excursion"] = max([r["max_excursion"] for r in ok]) if ok else ""
+        s["max_avg_excursion"] = max([r["max_avg_excursion"] for r in ok]) if ok else ""
+        s["mean_lock_time"] = round(statistics.mean(locked), 3) if locked else ""
+        s["max_lock_time"] = max(locked) if locked else ""
+        s["underflows"] = sum([r["underflows"] for r in ok])
+        s["overflows"] = sum([r["overflows"] for r in ok])
+        summary.append(s)
+    return summary
+
+
+def write_csv(fname, rows, fields):
+    with open(fname, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=fields, restval="")
+        writer.writeheader()
+        writer.writerows(rows)
+
+
+def print_table(summary):
+    if not summary:
+        return
+    fields = list(summary[0].keys())
+    widths = [max(len(f), max(len(str(s[f])) for s in summary)) for f in fields]
+    print("  ".join(f.rjust(w) for f, w in zip(fields, widths)))
+    for s in summary:
+        print("  ".join(str(s[f]).rjust(w) for f, w in zip(fields, widths)))
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description="Parallel parameter sweep and Monte-Carlo runner for the ASRC simulator")
+    parser.add_argument("--build-dir", default="build", help="Directory containing the simulator executables")
+    parser.add_argument("--apps", nargs="+", default=["usb_in_i2s_out", "i2s_in_usb_out"], choices=["usb_in_i2s_out", "i2s_in_usb_out"])
+    parser.add_argument("--rates", nargs="+", type=int, default=[48000, 96000, 192000], choices=supported_rates, help="I2S rates")
+    parser.add_argument("--kp-scales", nargs="+", type=float, default=[1.0], help="Scale factors applied to the controller Kp")
+    parser.add_argument("--ki-scales", nargs="+", type=float, default=[1.0], help="Scale factors applied to the controller Ki")
+    parser.add_argument("--window-log2", nargs="+", type=int, default=[0], help="Averaging window sizes log2. 0 for the default")
+    parser.add_argument("--stable-thresholds", nargs="+", type=int, default=[0], help="Averaging windows before the average is stable. 0 for the default")
+    parser.add_argument("--ratio-delays", nargs="+", type=int, default=[0], help="ASRC blocks between a controller update and the ASRC using the new ratio")
+    parser.add_argument("--runs", type=int, default=10, help="Randomised runs per configuration")
+    parser.add_argument("--time", type=float, default=600, help="Simulated time of each run in seconds")
+    parser.add_argument("--ppm", type=float, default=100, help="Max USB clock drift in ppm. Each run draws from +-ppm")
+    parser.add_argument("--sof-jitter", type=float, default=10, help="Max SOF jitter in us. Each run draws from 0 to this")
+    parser.add_argument("--switch-prob", type=float, default=0.25, help="Probability of a usb_in_i2s_out run having an I2S rate switch")
+    parser.add_argument("--full-asrc", action="store_true", help="Run the ASRC emulator instead of the output count model")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="Number of simulations run in parallel")
+    parser.add_argument("--seed", type=int, default=1, help="Seed for the randomised parameters")
+    parser.add_argument("--csv", default="sweep_runs.csv", help="Output CSV file with one row per run")
+    parser.add_argument("--summary", default="sweep_summary.csv", help="Output CSV file with one row per configuration")
+    return parser.parse_args()
+
+
+if __name__ == "__main__":
+    args = parse_arguments()
+    runs = make_runs(args)
+    print(f"Running {len(runs)} simulations, {args.jobs} at a time")
+
+    with ThreadPoolExecutor(max_workers=args.jobs) as executor:
+        rows = list(executor.map(lambda p: run_one(args, p), runs))
+
+    write_csv(args.csv, rows, config_fields + run_fields + stats_fields)
+    summary = summarise(rows)
+    write_csv(args.summary, summary, list(summary[0].keys()))
+    print_table(summary)
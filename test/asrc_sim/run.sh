@@ -4,6 +4,13 @@
 # From the test/asrc_sim directory, do
 # pip install -r ./requirements.txt
 # ./run.sh
+# A different SOF timestamps file can be given with SOFS_FILE=<file> ./run.sh
+
+sofs_file=${SOFS_FILE:-log_sofs_1hr}
+if [ ! -f "$sofs_file" ]; then
+    echo "SOF timestamps file $sofs_file not found"
+    exit -1
+fi
 
 cmake -S . -B ./build
 cmake --build build --target usb_in_i2s_out -j8
@@ -40,7 +47,7 @@ fi
 
 # With SOF timestamps file
 i2srate=176400
-build/usb_in_i2s_out $i2srate log_sofs_1hr 2>&1 > log
+build/usb_in_i2s_out $i2srate $sofs_file 2>&1 > log
 output=$(python python/calc_snr.py asrc_output.bin $i2srate -p $dir_name/plot_sof_usb_in_i2s_out_$i2srate.png 2>&1)
 snr=$(echo $output | sed -E 's/.*SNR = ([0-9]+).*/\1/g' | bc -l)
 if [ $((snr)) -ge 100 ]; then
@@ -51,7 +58,7 @@ else
 fi
 
 i2srate=96000
-build/i2s_in_usb_out $i2srate log_sofs_1hr 2>&1 >  log
+build/i2s_in_usb_out $i2srate $sofs_file 2>&1 >  log
 output=$(python python/calc_snr.py asrc_output.bin $usbrate -p $dir_name/plot_sof_i2s_in_usb_out_$usbrate.png 2>&1)
 snr=$(echo $output | sed -E 's/.*SNR = ([0-9]+).*/\1/g' | bc -l)
 if [ $((snr)) -ge 100 ]; then
@@ -61,4 +68,35 @@ else
     exit -1
 fi
 
+# Equal nominal rates, full ASRC against the bypass path. The bypass path is held to the same SNR limit as the full ASRC
+i2srate=48000
+for bypass in "" "--bypass"; do
+    build/usb_in_i2s_out $i2srate $bypass 2>&1 > log
+    output=$(python python/calc_snr.py asrc_output.bin $i2srate -p $dir_name/plot_usb_in_i2s_out_$i2srate$bypass.png 2>&1)
+    snr=$(echo $output | sed -E 's/.*SNR = ([0-9]+).*/\1/g' | bc -l)
+    if [ $((snr)) -ge 120 ]; then
+        echo "usb_in_i2s_out $i2srate $bypass SNR $snr PASS"
+    else
+        echo "usb_in_i2s_out $i2srate $bypass SNR $snr FAIL"
+        exit -1
+    fi
+done
+
+# The fast simulation core must follow the same buffer level trajectory as the SystemC model. Compare the buffer level
+# lines printed by both over a short run, with and without SOF timestamps
+for app in usb_in_i2s_out i2s_in_usb_out; do
+    for sofs in "" "$sofs_file"; do
+        build/$app 96000 $sofs --time 60 > log_systemc 2>&1 || { echo "$app $sofs SystemC run failed"; exit -1; }
+        build/$app 96000 $sofs --time 60 --fast > log_fast 2>&1 || { echo "$app $sofs fast run failed"; exit -1; }
+        grep -E '^-?[0-9]+,-?[0-9]+$' log_systemc > levels_systemc
+        grep -E '^-?[0-9]+,-?[0-9]+$' log_fast > levels_fast
+        if [ -s levels_systemc ] && cmp -s levels_systemc levels_fast; then
+            echo "$app $sofs fast simulation PASS, $(wc -l < levels_systemc) buffer levels match"
+        else
+            echo "$app $sofs fast simulation FAIL"
+            exit -1
+        fi
+    done
+done
+
 #python plot_csv.py log $dir_name/test_correct_$i.png 2
@@ -0,0 +1,64 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <cstdio>
+#include <vector>
+#include "buffer.h"
+#include "ASRC_wrapper.h"
+#include "config.h"
+#include "avg_buffer_level.h"
+#include "pi_control.h"
+#include "asrc_bypass.h"
+#include "asrc_count_model.h"
+#include "asrc_pool_model.h"
+
+// ASRC block processing and the USB receive buffer level control loop, without any timing. Called once per ASRC input
+// block by the SystemC ASRC module and by the fast simulation core.
+class AsrcCore
+{
+    public:
+        AsrcCore(uint32_t fs_in, uint32_t fs_out, uint32_t block_size, double actual_rate_ratio, Buffer* buffer, config_t *config, FILE *output_file);
+
+    private:
+        Buffer* m_buffer = nullptr;
+        config_t *m_config = nullptr;
+        FILE *m_output_file = nullptr;
+        double m_nominal_rate_ratio_f;
+        uint64_t m_nominal_rate_ratio;
+
+        double m_actual_rate_ratio_f;
+        uint64_t m_actual_rate_ratio;
+
+        uint32_t m_block_size;
+        uint32_t m_fs_in;
+        uint32_t m_fs_out;
+
+        ASRCCtrl_profile_only_t *m_profile_info_ptr[MAX_ASRC_N_IO_CHANNELS];
+
+        std::vector<int32_t> m_output;
+        uint64_t m_rate_ratio;
+        uint64_t m_pending_rate_ratio = 0;
+        uint32_t m_pending_rate_ratio_blocks = 0;
+        bool m_rate_ratio_pending = false;
+        uint32_t m_buffer_writes_count = 0;
+        buffer_calc_state_t m_long_term_buf_state;
+        buffer_calc_state_t m_short_term_buf_state;
+        pi_control_state_t m_pi_state;
+        asrc_bypass_state_t m_bypass_state;
+        asrc_count_model_state_t m_count_model_state;
+        AsrcPoolModel *m_pool = nullptr;
+
+        void update_rate_ratio(uint64_t rate_ratio);
+        void apply_pending_rate_ratio();
+
+    public:
+        /// @brief Process one ASRC input block of asrc_block_size samples and write the output to the buffer
+        void process_block(int32_t *input);
+
+        /// @brief Count the output samples of every channel in a modelled ASRC pool when using the ASRC count model
+        void set_pool(AsrcPoolModel *pool) { m_pool = pool; }
+
+        /// @brief Averaging state of the buffer level the controller works on
+        const buffer_calc_state_t *control_buf_state() const { return &m_long_term_buf_state; }
+};
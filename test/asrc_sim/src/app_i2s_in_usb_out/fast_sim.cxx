@@ -0,0 +1,169 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include "fast_sim.h"
+#include "event_sim.h"
+#include "buffer.h"
+#include "asrc_core.h"
+#include "usb_rate_calc.h"
+#include "helpers.h"
+#include "sim_stats.h"
+#include "asrc_pool_model.h"
+
+// Same time units as the SystemC model, where one time unit (SC_US) is one I2S sample period. Events at the same time
+// are ordered as in the SystemC model: the USB SOF first, then the I2S block, which runs the ASRC straight away, unless
+// an ASRC pool with compute time is modelled.
+#define USB_PRIORITY    (0)
+#define I2S_PRIORITY    (1)
+#define ASRC_PRIORITY   (2)
+
+extern rate_info_t g_usb_rate_info;
+
+int run_fast_sim(config_t *config, double actual_rate_ratio, double sof_period, double i2s_asrc_input_block_period)
+{
+    const double nominal_timer_tick_rate = 100e6; // Hz
+    const bool use_timestamps = (config->usb_timestamps[0].size() != 0);
+    const sim_time_t end_time = sim_time_from_us(config->sim_time_secs * config->nominal_i2s_rate);
+
+    if(config->switch_time_secs != 0)
+    {
+        printf("ERROR: I2S rate switches are only simulated in usb_in_i2s_out\n");
+        return -1;
+    }
+
+    // There's no audio to listen to, so the ASRC is fed silence
+    memset(config->asrc_input_samples, 0, config->asrc_block_size * sizeof(int));
+
+    Buffer buffer("buffer");
+    buffer.set_count_xruns(true);
+    AsrcCore asrc((uint32_t)config->nominal_i2s_rate, (uint32_t)config->nominal_usb_rate, config->asrc_block_size, actual_rate_ratio, &buffer, config, nullptr);
+    EventSim sim;
+    SimStats stats;
+    std::mt19937 rng(config->seed);
+
+    std::unique_ptr<AsrcPoolModel> pool;
+    if(use_asrc_pool_model(config))
+    {
+        pool.reset(new AsrcPoolModel(config->asrc_channels, config->asrc_workers, config->asrc_compute_us * 1e-6 * config->nominal_i2s_rate,
+                                     config->asrc_compute_jitter, config->asrc_dispatch_us * 1e-6 * config->nominal_i2s_rate,
+                                     config->asrc_worker_ratio_read, config->ratio_latency_us * 1e-6 * config->nominal_i2s_rate,
+                                     config->seed));
+        asrc.set_pool(pool.get());
+    }
+
+    // The ASRC writes its output to the buffer straight away, or with the pool model, once the last worker has finished
+    // with the block
+    auto asrc_block = [&]()
+    {
+        stats.update(sim.now(), buffer.fill_level(), asrc.control_buf_state());
+        if(pool)
+        {
+            pool->finish_block();
+        }
+        asrc.process_block(&config->asrc_input_samples[0]);
+        stats.update(sim.now(), buffer.fill_level(), asrc.control_buf_state());
+    };
+
+    // ASRC input blocks at multiples of the block period, like the posedges of an sc_clock
+    const sim_time_t block_period = sim_time_from_us(i2s_asrc_input_block_period);
+    uint64_t num_blocks = 0;
+    std::function<void(void)> i2s_block = [&]()
+    {
+        if(pool)
+        {
+            sim.schedule(pool->start_block(sim.now()), ASRC_PRIORITY, asrc_block);
+        }
+        else
+        {
+            asrc_block();
+        }
+        num_blocks += 1;
+        sim.schedule(num_blocks * block_period, I2S_PRIORITY, i2s_block);
+    };
+    sim.schedule(0, I2S_PRIORITY, i2s_block);
+
+    std::function<void(void)> usb_sof;
+    // Position in the logged timestamps. Outlives the usb_sof calls, which run after this scope has been set up
+    size_t ts = 0;
+    uint32_t prev_ts = 0;
+    bool prev_ts_valid = false;
+    // SOF period, jitter and count when not using logged timestamps, declared here for the same reason
+    const sim_time_t period = sim_time_from_us(sof_period);
+    const double jitter = config->sof_jitter_us * 1e-6 * config->nominal_i2s_rate;
+    std::uniform_real_distribution<double> jitter_dist(-jitter, jitter);
+    uint64_t num_sofs = 0;
+    if(use_timestamps)
+    {
+        // Schedule USB from logged timestamps
+        usb_sof = [&]()
+        {
+            const std::vector<uint32_t> &timestamps = config->usb_timestamps[0];
+            if(prev_ts_valid)
+            {
+                g_usb_rate_info = determine_USB_audio_rate(timestamps[ts], timestamps[ts+1], 0, true);
+            }
+
+            double wait_time;
+            if(prev_ts_valid == true)
+            {
+                uint32_t ts_diff = timestamps[ts] - prev_ts;
+                wait_time = ((double)(ts_diff) / nominal_timer_tick_rate) * config->nominal_i2s_rate;
+            }
+            else
+            {
+                wait_time = ((double)(100000) / nominal_timer_tick_rate) * config->nominal_i2s_rate;
+            }
+            prev_ts = timestamps[ts];
+            prev_ts_valid = true;
+            ts += 2;
+
+            buffer.read(48);
+
+            if(ts < timestamps.size())
+            {
+                sim.schedule(sim.now() + sim_time_from_us(wait_time), USB_PRIORITY, usb_sof);
+            }
+            else
+            {
+                sim.schedule(sim.now() + sim_time_from_us(wait_time), USB_PRIORITY, [&]()
+                {
+                    printf("End of logged timestamps. Stop simulation\n");
+                    sim.stop();
+                });
+            }
+        };
+    }
+    else
+    {
+        // SOFs at multiples of the clock period, like the posedges of an sc_clock, plus any random jitter
+        usb_sof = [&]()
+        {
+            buffer.read(48);
+            num_sofs += 1;
+            sim_time_t next_sof = num_sofs * period;
+            if(jitter != 0)
+            {
+                next_sof += (int64_t)(jitter_dist(rng) * 1e6);
+            }
+            sim.schedule(next_sof, USB_PRIORITY, usb_sof);
+        };
+    }
+    sim.schedule(0, USB_PRIORITY, usb_sof);
+
+    auto start = std::chrono::steady_clock::now();
+    sim.run(end_time);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("Fast simulation: %.1f s simulated in %.1f s, %llu events\n", (double)sim.now() / 1e6 / config->nominal_i2s_rate,
+           elapsed.count(), (unsigned long long)sim.num_events());
+    stats.print(buffer, config->nominal_i2s_rate);
+    if(pool)
+    {
+        pool->print(config->nominal_usb_rate / config->nominal_i2s_rate);
+    }
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include "asrc.h"
 #include "config.h"
 #include "helpers.h"
+#include "fast_sim.h"
 
 #define DEFAULT_NOMINAL_USB_RATE (48000) // Do not change!! Only 48000KHz USB supported
 #define DEFAULT_USB_DRIFT_PPM    (10)
@@ -17,18 +18,28 @@
 #define ASRC_BLOCK_SIZE          (244)   // Number of samples that make the ASRC input block
 
 // Usage. From the build directory, run: ./i2s_in_usb_out <i2s_rate> ../log_sofs_1hr 2>&1 | tee log
+// Add --bypass to use the ASRC bypass path when the I2S rate is 48000
+// Add --fast to run the event stepped core instead of SystemC. See README.txt for the other options
 int sc_main(int argc, char* argv[])
 {
     config_t *app_config = new config_t;
     app_config->nominal_usb_rate = DEFAULT_NOMINAL_USB_RATE;
     app_config->usb_drift_ppm = DEFAULT_USB_DRIFT_PPM;
     app_config->asrc_block_size = ASRC_BLOCK_SIZE;
+    app_config->sim_time_secs = DEFAULT_SIM_TIME_MINS*60;
+
+    if(take_sim_options(&argc, argv, app_config) != 0)
+    {
+        return -1;
+    }
+
     // Choose the frequency of the sine tone used as ASRC input such that there are an integer no. of periods in a 128 point FFT on the asrc output, which is at the USB rate
     app_config->asrc_input_sine_freq = 6000;
 
     if(argc < 2)
     {
-        printf("Usage:\ni2s_in_usb_out <i2s_rate> \nor\ni2s_in_usb_out <i2s_rate> <USB timestamps file>\nExiting\n");
+        printf("Usage:\ni2s_in_usb_out <i2s_rate> [options]\nor\ni2s_in_usb_out <i2s_rate> <USB timestamps file> [options]\n"
+               SIM_OPTIONS_USAGE "Exiting\n");
         return -1;
     }
     app_config->nominal_i2s_rate = (double)(atoi(argv[1]));
@@ -40,7 +51,10 @@ int sc_main(int argc, char* argv[])
     if(argc == 3) // If SOF timestamps file is provided, parse the timestamps into a std::vector
     {
         printf("argv[2] = %s\n", argv[2]);
-        parse_sof_timestamps(argv[2], app_config);
+        if(parse_sof_timestamps(argv[2], app_config) != 0)
+        {
+            return -1;
+        }
     }
 
     app_config->actual_usb_rate = (double)app_config->nominal_usb_rate * (1 + app_config->usb_drift_ppm/1000000);
@@ -51,11 +65,16 @@ int sc_main(int argc, char* argv[])
 
     double actual_rate_ratio = app_config->nominal_i2s_rate / app_config->actual_usb_rate;
 
+    app_config->asrc_input_samples = new int[app_config->asrc_block_size * 2];
+
+    if(app_config->fast_sim)
+    {
+        return run_fast_sim(app_config, actual_rate_ratio, sof_period, i2s_asrc_input_block_period);
+    }
+
     sc_clock usb_clk("usb_clk", sof_period, SC_US);
     sc_clock i2s_clk("i2s_clk", i2s_asrc_input_block_period, SC_US);
 
-    app_config->asrc_input_samples = new int[app_config->asrc_block_size * 2];
-
     Buffer buffer("buffer");
     USB usb("usb", &buffer, app_config);
     I2S i2s("i2s", &buffer, app_config);
@@ -70,7 +89,7 @@ int sc_main(int argc, char* argv[])
 
 
     // Simulate for N seconds.
-    sc_start(DEFAULT_SIM_TIME_MINS*60*app_config->nominal_i2s_rate, SC_US);
+    sc_start(app_config->sim_time_secs*app_config->nominal_i2s_rate, SC_US);
 
     delete app_config->asrc_input_samples;
     delete app_config;
@@ -4,7 +4,7 @@
 
 #include "systemc.h"
 #include "buffer.h"
-#include "ASRC_wrapper.h"
+#include "asrc_core.h"
 #include "config.h"
 
 SC_MODULE(ASRC)
@@ -17,17 +17,8 @@ SC_MODULE(ASRC)
         sc_event& m_trigger;
 
     private:
-        Buffer* m_buffer = nullptr;
         config_t *m_config = nullptr;
-        double m_nominal_rate_ratio_f;
-        uint64_t m_nominal_rate_ratio;
-
-        double m_actual_rate_ratio_f;
-        uint64_t m_actual_rate_ratio;
-
-        uint32_t m_block_size;
-
-        ASRCCtrl_profile_only_t *m_profile_info_ptr[MAX_ASRC_N_IO_CHANNELS];
+        AsrcCore m_core;
 
     public:
         void process();
@@ -0,0 +1,182 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include "asrc_core.h"
+#include "usb_rate_calc.h"
+#include "helpers.h"
+
+rate_info_t g_usb_rate_info = {0, 0};
+rate_info_t g_i2s_rate_info;
+
+
+AsrcCore::AsrcCore(uint32_t fs_in, uint32_t fs_out, uint32_t block_size, double actual_rate_ratio, Buffer* buffer, config_t *config, FILE *output_file)
+    : m_buffer(buffer)
+    , m_config(config)
+    , m_output_file(output_file)
+{
+    uint32_t rand_seed[MAX_ASRC_N_IO_CHANNELS] = {0};
+
+    m_nominal_rate_ratio = wrapper_asrc_init(&m_profile_info_ptr, fs_in, fs_out, block_size, 1, 1, ASRC_DITHER_OFF, rand_seed);
+    m_nominal_rate_ratio_f = (double)m_nominal_rate_ratio/(uint64_t)((uint64_t)1<<(28+32));
+    m_block_size = block_size;
+    m_fs_in = fs_in;
+    m_fs_out = fs_out;
+
+    printf("nominal_rate_ratio = %f, block_size = %u\n", m_nominal_rate_ratio_f, m_block_size);
+
+    m_actual_rate_ratio_f = actual_rate_ratio;// + 1e-8;    // Optionally, add an extra drift
+    m_actual_rate_ratio = uint64_t(m_actual_rate_ratio_f * ((uint64_t)1 << (28+32)));
+
+    g_i2s_rate_info.samples = m_config->nominal_i2s_rate;
+    g_i2s_rate_info.ticks = 100000000;
+
+    printf("I2S rate = (%llu, %llu), %.10f\n", (unsigned long long)g_i2s_rate_info.samples, (unsigned long long)g_i2s_rate_info.ticks, (double)g_i2s_rate_info.samples / g_i2s_rate_info.ticks);
+
+    m_output.resize(int(2*(m_block_size/m_nominal_rate_ratio_f)) * 2);
+
+    if(m_config->usb_timestamps[0].size() != 0)
+    {
+        m_rate_ratio = m_nominal_rate_ratio;
+    }
+    else
+    {
+        m_rate_ratio = m_actual_rate_ratio;
+    }
+
+    int32_t window_len_log2 = (m_config->avg_window_log2 != 0) ? m_config->avg_window_log2 : 10;
+    int32_t stable_threshold = (m_config->avg_stable_threshold != 0) ? m_config->avg_stable_threshold : 8;
+
+    init_calc_buffer_level_state(&m_buf_state, window_len_log2, stable_threshold);
+    init_i2s_buffer_pi_control_state(&m_pi_state, m_config->nominal_i2s_rate);
+    scale_pi_control_gains(&m_pi_state, m_config);
+    init_asrc_bypass_state(&m_bypass_state, ASRC_BYPASS_DEFAULT_MAX_DEVIATION);
+    asrc_count_model_init(&m_count_model_state);
+}
+
+// A new rate ratio reaches the ASRC config->ratio_delay_blocks blocks after the controller update that worked it out. In
+// the application, the ratio and the rate information it's worked out from travel between the tiles in the headers of
+// the audio blocks, which delays them by up to a block each way.
+void AsrcCore::update_rate_ratio(uint64_t rate_ratio)
+{
+    m_pending_rate_ratio = rate_ratio;
+    m_pending_rate_ratio_blocks = m_config->ratio_delay_blocks;
+    m_rate_ratio_pending = true;
+    if(m_pool != nullptr)
+    {
+        m_pool->publish_ratio(rate_ratio);
+    }
+}
+
+void AsrcCore::apply_pending_rate_ratio()
+{
+    if(m_rate_ratio_pending)
+    {
+        if(m_pending_rate_ratio_blocks == 0)
+        {
+            m_rate_ratio = m_pending_rate_ratio;
+            m_rate_ratio_pending = false;
+        }
+        else
+        {
+            m_pending_rate_ratio_blocks -= 1;
+        }
+    }
+}
+
+void AsrcCore::process_block(int32_t *input)
+{
+    uint32_t num_out_samples;
+    apply_pending_rate_ratio();
+    if(m_config->asrc_bypass && asrc_bypass_update(&m_bypass_state, m_fs_in, m_fs_out, m_rate_ratio))
+    {
+        int32_t slip = asrc_bypass_plan_block(&m_bypass_state, m_rate_ratio, m_block_size);
+        num_out_samples = asrc_bypass_process(input, &m_output[0], m_block_size, slip);
+    }
+    else if(m_config->asrc_count_model && (m_pool != nullptr))
+    {
+        num_out_samples = m_pool->process_counts(m_rate_ratio, m_block_size);
+    }
+    else if(m_config->asrc_count_model)
+    {
+        num_out_samples = asrc_count_model_process(&m_count_model_state, m_rate_ratio, m_block_size);
+    }
+    else
+    {
+        num_out_samples = wrapper_asrc_process(input, &m_output[0], m_rate_ratio);
+    }
+
+    if((m_output_file != nullptr) && !m_config->asrc_count_model)
+    {
+        fwrite(&m_output[0], sizeof(int32_t), num_out_samples, m_output_file);
+    }
+
+    //unsigned int asrc_delay = 60 + (rand() % 20);
+    //wait(asrc_delay, SC_US);
+    m_buffer->write(num_out_samples);
+
+    if(m_retarget_pending)
+    {
+        // Like the application after a rate switch, restart the averaging from the level after the first write at the new rate
+        retarget_avg_buffer_level(&m_buf_state, m_buffer->fill_level());
+        m_retarget_pending = false;
+        return;
+    }
+
+    calc_avg_buffer_level(&m_buf_state, m_buffer->fill_level(), false);
+
+    // After 16 writes
+    m_buffer_writes_count += 1;
+
+    if(m_buffer_writes_count == RATE_RATIO_UPDATE_BLOCKS)
+    {
+        int64_t error = pi_control(&m_pi_state, m_buf_state.flag_stable_avg, m_buf_state.avg_buffer_level - m_buf_state.stable_avg_level);
+        if(m_config->usb_timestamps[0].size() != 0)
+        {
+            uint64_t rate_ratio = rate_ratio_fixed_output_q_format(g_usb_rate_info, g_i2s_rate_info, 28+32);
+            // Uncomment to apply a fixed correction instead of the pi_control() code.
+            //double correction = 0.000000043;
+            //uint64_t correction_i = (uint64_t)(correction * ((uint64_t)1 << (28+32)));
+            //rate_ratio = rate_ratio - correction_i;
+            update_rate_ratio(rate_ratio + error);
+        }
+        else
+        {
+            update_rate_ratio(m_actual_rate_ratio + error);
+        }
+
+        m_buffer_writes_count = 0;
+
+        if(m_buf_state.flag_stable_avg)
+        {
+            printf("%d,%d\n",m_buffer->fill_level(),m_buf_state.avg_buffer_level);
+        }
+    }
+}
+
+void AsrcCore::switch_i2s_rate(uint32_t fs_out, double actual_rate_ratio)
+{
+    uint32_t rand_seed[MAX_ASRC_N_IO_CHANNELS] = {0};
+    uint32_t prev_fs_out = m_fs_out;
+
+    m_nominal_rate_ratio = wrapper_asrc_init(&m_profile_info_ptr, m_fs_in, fs_out, m_block_size, 1, 1, ASRC_DITHER_OFF, rand_seed);
+    m_nominal_rate_ratio_f = (double)m_nominal_rate_ratio/(uint64_t)((uint64_t)1<<(28+32));
+    m_fs_out = fs_out;
+    m_output.resize(int(2*(m_block_size/m_nominal_rate_ratio_f)) * 2);
+
+    m_actual_rate_ratio_f = actual_rate_ratio;
+    m_actual_rate_ratio = uint64_t(m_actual_rate_ratio_f * ((uint64_t)1 << (28+32)));
+    g_i2s_rate_info.samples = fs_out;
+
+    // Carry on from the current ratio at the new rate until the next controller update, like the rate server does. A
+    // ratio still on its way was worked out for the old rate, so it's dropped, like the application does
+    m_rate_ratio = (uint64_t)(((double)m_rate_ratio * prev_fs_out) / fs_out);
+    m_rate_ratio_pending = false;
+    if(m_pool != nullptr)
+    {
+        m_pool->reset_ratio(m_rate_ratio);
+    }
+
+    retarget_i2s_buffer_pi_control_state(&m_pi_state, prev_fs_out, fs_out);
+    scale_pi_control_gains(&m_pi_state, m_config);
+    m_retarget_pending = true;
+    printf("I2S rate switched from %u to %u, nominal_rate_ratio = %f\n", prev_fs_out, fs_out, m_nominal_rate_ratio_f);
+}
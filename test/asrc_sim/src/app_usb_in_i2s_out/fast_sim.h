@@ -0,0 +1,12 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include "config.h"
+
+/// @brief Run the usb_in_i2s_out simulation on the event stepped core instead of the SystemC model
+/// @param config               Application config
+/// @param actual_rate_ratio    Actual USB to I2S rate ratio
+/// @param sof_period           USB SOF period, in simulation time units (I2S sample periods), when not using timestamps
+/// @return int                 0 on success
+int run_fast_sim(config_t *config, double actual_rate_ratio, double sof_period);
@@ -10,6 +10,7 @@
 #include "asrc.h"
 #include "config.h"
 #include "helpers.h"
+#include "fast_sim.h"
 
 #define DEFAULT_NOMINAL_USB_RATE (48000) // Do not change!! Only 48000KHz USB supported
 #define DEFAULT_USB_DRIFT_PPM    (10)
@@ -18,17 +19,26 @@
 
 
 // Usage. From the build directory, run: ./usb_in_i2s_out <i2s_rate> ../log_sofs_1hr 2>&1 | tee log
+// Add --bypass to use the ASRC bypass path when the I2S rate is 48000
+// Add --fast to run the event stepped core instead of SystemC. See README.txt for the other options
 int sc_main(int argc, char* argv[])
 {
     config_t *app_config = new config_t;
     app_config->nominal_usb_rate = DEFAULT_NOMINAL_USB_RATE;
     app_config->usb_drift_ppm = DEFAULT_USB_DRIFT_PPM;
     app_config->asrc_block_size = ASRC_BLOCK_SIZE;
+    app_config->sim_time_secs = DEFAULT_SIM_TIME_MINS*60;
+
+    if(take_sim_options(&argc, argv, app_config) != 0)
+    {
+        return -1;
+    }
 
 
     if(argc < 2)
     {
-        printf("Usage:\nusb_in_i2s_out <i2s_rate> \nor\nusb_in_i2s_out <i2s_rate> <USB timestamps file>\nExiting\n");
+        printf("Usage:\nusb_in_i2s_out <i2s_rate> [options]\nor\nusb_in_i2s_out <i2s_rate> <USB timestamps file> [options]\n"
+               SIM_OPTIONS_USAGE "Exiting\n");
         return -1;
     }
     app_config->nominal_i2s_rate = (double)(atoi(argv[1]));
@@ -56,7 +66,10 @@ int sc_main(int argc, char* argv[])
     if(argc == 3) // If SOF timestamps file is provided, parse the timestamps into a std::vector
     {
         printf("argv[2] = %s\n", argv[2]);
-        parse_sof_timestamps(argv[2], app_config);
+        if(parse_sof_timestamps(argv[2], app_config) != 0)
+        {
+            return -1;
+        }
     }
 
     app_config->actual_usb_rate = (double)app_config->nominal_usb_rate * (1 + app_config->usb_drift_ppm/1000000);
@@ -65,11 +78,16 @@ int sc_main(int argc, char* argv[])
 
     double actual_rate_ratio =  app_config->actual_usb_rate / app_config->nominal_i2s_rate;
 
+    app_config->asrc_input_samples = new int[app_config->asrc_block_size];
+
+    if(app_config->fast_sim)
+    {
+        return run_fast_sim(app_config, actual_rate_ratio, sof_period);
+    }
+
     sc_clock usb_clk("usb_clk", sof_period, SC_US);
     sc_clock i2s_clk("i2s_clk", 1, SC_US);
 
-    app_config->asrc_input_samples = new int[app_config->asrc_block_size];
-
     Buffer buffer("buffer");
     USB usb("usb", &buffer, app_config);
     ASRC asrc("asrc", (uint32_t)app_config->nominal_usb_rate, (uint32_t)app_config->nominal_i2s_rate, app_config->asrc_block_size, actual_rate_ratio, &buffer, usb.trigger, app_config);
@@ -82,7 +100,7 @@ int sc_main(int argc, char* argv[])
     sc_start(0, SC_SEC);
 
     // Simulate for N seconds
-    sc_start(DEFAULT_SIM_TIME_MINS*60*app_config->nominal_i2s_rate, SC_US);
+    sc_start(app_config->sim_time_secs*app_config->nominal_i2s_rate, SC_US);
 
     return 0;
 }
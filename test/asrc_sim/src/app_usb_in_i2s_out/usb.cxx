@@ -6,7 +6,7 @@
 #include "NumCpp.hpp"
 
 
-float_s32_t g_avg_usb_rate = {.mant=0, .exp=0};
+extern rate_info_t g_usb_rate_info;
 
 USB::USB(sc_module_name name, Buffer* buffer, config_t *config)
     : sc_module(name)
@@ -65,9 +65,9 @@ void USB::process()
 
             if (prev_ts_valid)
             {
-                g_avg_usb_rate = determine_USB_audio_rate(*ts, *(ts+1), 0, true);
-                //printf("usb_timestamp = %u, g_avg_usb_rate = (0x%x, %d), %.10f\n", *ts, g_avg_usb_rate.mant, g_avg_usb_rate.exp,
-                //                                                                ((uint32_t)g_avg_usb_rate.mant)*(pow(2, g_avg_usb_rate.exp))*100000);
+                g_usb_rate_info = determine_USB_audio_rate(*ts, *(ts+1), 0, true);
+                //printf("usb_timestamp = %u, g_usb_rate_info = (%llu, %llu), %.10f\n", *ts, g_usb_rate_info.samples, g_usb_rate_info.ticks,
+                //                                                                ((double)g_usb_rate_info.samples / g_usb_rate_info.ticks)*100000000);
                 //ts_count += 2;
             }
             count += 1;
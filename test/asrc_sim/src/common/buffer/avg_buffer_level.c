@@ -60,3 +60,13 @@ void calc_avg_buffer_level(buffer_calc_state_t *state, int current_level, bool r
         }
     }
 }
+
+void retarget_avg_buffer_level(buffer_calc_state_t *state, int32_t stable_level)
+{
+    init_calc_buffer_level_state(state, state->window_len_log2, state->buffer_level_stable_threshold);
+    state->avg_buffer_level = stable_level;
+    state->stable_avg_level = stable_level;
+    state->flag_first_done = true;
+    state->flag_stable_avg = true;
+    rtos_printf("Stable average level retargeted to %d\n", state->stable_avg_level);
+}
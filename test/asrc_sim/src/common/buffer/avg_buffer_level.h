@@ -37,6 +37,13 @@ void init_calc_buffer_level_state(buffer_calc_state_t *p_calc_state, int32_t win
 /// @param reset            Flag indicating whether the buffer averaging state needs to reset
 void calc_avg_buffer_level(buffer_calc_state_t *state, int current_level, bool reset);
 
+/// @brief Restart the averaging with a given stable level, without waiting for a new stable average. Used when the buffer
+/// keeps running across an event that makes the current average meaningless, such as a sampling rate switch, so that the
+/// controller acting on the average can carry on.
+/// @param state            Pointer to the buffer_calc_state_t state structure
+/// @param stable_level     New stable level
+void retarget_avg_buffer_level(buffer_calc_state_t *state, int32_t stable_level);
+
 #ifdef __cplusplus
  }
  #endif
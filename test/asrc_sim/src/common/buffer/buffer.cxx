@@ -1,33 +1,54 @@
 // Copyright 2023 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <cassert>
 #include "buffer.h"
 
-Buffer::Buffer(sc_module_name name)
-    : sc_module(name)
+Buffer::Buffer(const char *name)
 {
+    (void)name;
 }
 
 void Buffer::write(unsigned int num_samples)
 {
+    int prev_level = m_buffer_level;
     m_buffer_level += num_samples;
     m_samples_written += num_samples;
+    if(m_count_xruns)
+    {
+        if((m_buffer_level >= MAX_LEVEL) && (prev_level < MAX_LEVEL))
+        {
+            m_overflows += 1;
+        }
+        return;
+    }
     assert(m_buffer_level < MAX_LEVEL);
 }
 
+// Reading several samples at once leaves the same level as reading them one at a time, and the level only falls while
+// reading, so checking the final level is enough
 void Buffer::read(unsigned int num_samples)
 {
+    int prev_level = m_buffer_level;
     m_buffer_level -= num_samples;
     //printf("m_buffer_level = %d\n", m_buffer_level);
     m_samples_read += num_samples;
+    if(m_count_xruns)
+    {
+        if((m_buffer_level <= -MAX_LEVEL) && (prev_level > -MAX_LEVEL))
+        {
+            m_underflows += 1;
+        }
+        return;
+    }
     assert(m_buffer_level > -MAX_LEVEL);
 }
 
-int Buffer::fill_level()
+void Buffer::set_count_xruns(bool count_xruns)
 {
-    return m_buffer_level;
+    m_count_xruns = count_xruns;
 }
 
-void sc_trace(sc_trace_file* f, const Buffer& val, const std::string &name)
+int Buffer::fill_level()
 {
-    sc_trace(f, val.m_buffer_level, name + ".buffer_level");
+    return m_buffer_level;
 }
@@ -2,22 +2,28 @@
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 #pragma once
 
-#include "systemc.h"
-
-SC_MODULE(Buffer)
+// Buffer fill level model. Not a SystemC module, so that it's shared by the SystemC model and the fast simulation core.
+class Buffer
 {
     public:
-        SC_CTOR(Buffer);
-        friend void sc_trace(sc_trace_file* f, const Buffer& val, const std::string &name);
+        Buffer(const char *name);
 
     private:
         int m_buffer_level = 0;
         const int MAX_LEVEL = 240*4;
         int m_samples_written = 0;
         int m_samples_read = 0;
+        bool m_count_xruns = false;
+        unsigned m_overflows = 0;
+        unsigned m_underflows = 0;
 
     public:
         void write(unsigned int num_samples);
         void read(unsigned int num_samples);
         int fill_level(void);
+
+        /// @brief Count the times the level goes beyond the buffer limits instead of asserting, so that a run carries on
+        void set_count_xruns(bool count_xruns);
+        unsigned overflows(void) const { return m_overflows; }
+        unsigned underflows(void) const { return m_underflows; }
 };
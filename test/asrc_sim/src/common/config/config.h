@@ -2,6 +2,9 @@
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 typedef struct
 {
     /* data */
@@ -14,4 +17,25 @@ typedef struct
     int asrc_block_size;
     std::vector<uint32_t> usb_timestamps[2]; // 2 in case OUT and IN timestamps are present.
     int *asrc_input_samples;
+    bool asrc_bypass; // Use the ASRC bypass path when the nominal rates are equal
+    bool fast_sim; // Run the event stepped simulation core instead of the SystemC model
+    bool asrc_count_model; // Count the ASRC output samples instead of running the ASRC. No audio is produced
+    double sim_time_secs; // Simulated time in seconds
+    double kp_scale; // Scale factor applied to the buffer level controller Kp, for tuning sweeps
+    double ki_scale; // Scale factor applied to the buffer level controller Ki, for tuning sweeps
+    int avg_window_log2; // Buffer level averaging window size log2 used by the controller. 0 for the default
+    int avg_stable_threshold; // No. of averaging windows before the average is declared stable. 0 for the default
+    double sof_jitter_us; // Fast simulation only. Max random jitter added to each SOF when not using timestamps, in us
+    unsigned seed; // Fast simulation only. Seed for the random jitter
+    double switch_time_secs; // Fast simulation only. Time of an I2S rate switch in seconds, or 0 for none
+    double switch_i2s_rate; // Fast simulation only. I2S rate to switch to at switch_time_secs
+    double switch_us; // Fast simulation only. Extra time taken by the first ASRC block after the switch, in us
+    unsigned asrc_channels; // Fast simulation only. Number of channels in the modelled ASRC pool
+    unsigned asrc_workers; // Fast simulation only. Number of workers in the modelled ASRC pool, including the pool owner
+    double asrc_compute_us; // Fast simulation only. Modelled ASRC compute time per channel per block, in us
+    double asrc_compute_jitter; // Fast simulation only. Random variation of the compute time, as a fraction of it
+    double asrc_dispatch_us; // Fast simulation only. Modelled time of each queue handoff between the pool owner and a worker, in us
+    bool asrc_worker_ratio_read; // Fast simulation only. Each pool worker reads the latest rate ratio instead of the frame's
+    double ratio_latency_us; // Fast simulation only. Time for a new rate ratio to become visible to the pool workers, in us
+    unsigned ratio_delay_blocks; // No. of ASRC blocks after a rate ratio update before the ASRC uses the new ratio
 }config_t;
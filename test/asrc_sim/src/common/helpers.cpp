@@ -6,6 +6,7 @@
 #include <fstream>
 #include "systemc.h"
 #include "config.h"
+#include "helpers.h"
 
 #include <cstdlib>
 #include <iostream>
@@ -13,12 +14,18 @@
 
 
 
-void parse_sof_timestamps(const char *fname, config_t *app_config)
+int parse_sof_timestamps(const char *fname, config_t *app_config)
 {
     ifstream myfile;
     std::ifstream infile(fname);
     std::string line;
 
+    if(!infile.is_open())
+    {
+        printf("ERROR: Could not open SOF timestamps file %s\n", fname);
+        return -1;
+    }
+
     std::string token;
     std::vector<uint32_t> only_timestamps;
     while (std::getline(infile, line))
@@ -48,7 +55,7 @@ void parse_sof_timestamps(const char *fname, config_t *app_config)
     {
         app_config->average_usb_rate_from_sofs = 48000;
     }
-
+    return 0;
 }
 
 int verify_i2s_rate(int i2s_rate)
@@ -63,3 +70,139 @@ int verify_i2s_rate(int i2s_rate)
     printf("nominal_i2s_rate = %d\n", (int)i2s_rate);
     return 0;
 }
+
+// Remove flag from the argument list if present, so the positional arguments can be parsed as before
+bool take_flag(int *argc, char *argv[], const char *flag)
+{
+    for(int i=1; i<*argc; i++)
+    {
+        if(std::string(argv[i]) == flag)
+        {
+            for(int j=i; j<*argc-1; j++)
+            {
+                argv[j] = argv[j+1];
+            }
+            *argc -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Remove option and the value following it from the argument list if present
+bool take_option(int *argc, char *argv[], const char *option, double *value)
+{
+    for(int i=1; i<*argc-1; i++)
+    {
+        if(std::string(argv[i]) == option)
+        {
+            *value = atof(argv[i+1]);
+            for(int j=i; j<*argc-2; j++)
+            {
+                argv[j] = argv[j+2];
+            }
+            *argc -= 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Remove the optional settings from the argument list, so the positional arguments can be parsed as before, and set
+// them in app_config. Settings not given are left at their defaults. sim_time_secs and usb_drift_ppm must already be set
+// to their defaults. Returns -1 if the settings can't be used together.
+int take_sim_options(int *argc, char *argv[], config_t *app_config)
+{
+    double value;
+
+    app_config->asrc_bypass = take_flag(argc, argv, "--bypass");
+    app_config->fast_sim = take_flag(argc, argv, "--fast");
+    app_config->asrc_count_model = take_flag(argc, argv, "--asrc-count-model");
+    take_option(argc, argv, "--time", &app_config->sim_time_secs);
+    take_option(argc, argv, "--drift-ppm", &app_config->usb_drift_ppm);
+
+    app_config->kp_scale = 1.0;
+    app_config->ki_scale = 1.0;
+    take_option(argc, argv, "--kp-scale", &app_config->kp_scale);
+    take_option(argc, argv, "--ki-scale", &app_config->ki_scale);
+
+    app_config->avg_window_log2 = take_option(argc, argv, "--window-log2", &value) ? (int)value : 0;
+    app_config->avg_stable_threshold = take_option(argc, argv, "--stable-threshold", &value) ? (int)value : 0;
+
+    app_config->sof_jitter_us = 0;
+    take_option(argc, argv, "--sof-jitter", &app_config->sof_jitter_us);
+    app_config->seed = take_option(argc, argv, "--seed", &value) ? (unsigned)value : 0;
+    app_config->switch_time_secs = 0;
+    app_config->switch_i2s_rate = 0;
+    app_config->switch_us = 0;
+    take_option(argc, argv, "--switch-time", &app_config->switch_time_secs);
+    take_option(argc, argv, "--switch-rate", &app_config->switch_i2s_rate);
+    take_option(argc, argv, "--switch-us", &app_config->switch_us);
+
+    // --pair is the baseline topology, the main task and asrc_one_channel_task with a channel each
+    bool pair = take_flag(argc, argv, "--pair");
+    app_config->asrc_channels = take_option(argc, argv, "--channels", &value) ? (unsigned)value : (pair ? 2 : 1);
+    app_config->asrc_workers = take_option(argc, argv, "--workers", &value) ? (unsigned)value : (pair ? 2 : 1);
+    app_config->asrc_compute_us = 0;
+    app_config->asrc_compute_jitter = 0;
+    app_config->asrc_dispatch_us = 0;
+    app_config->ratio_latency_us = 0;
+    take_option(argc, argv, "--compute-us", &app_config->asrc_compute_us);
+    take_option(argc, argv, "--compute-jitter", &app_config->asrc_compute_jitter);
+    take_option(argc, argv, "--dispatch-us", &app_config->asrc_dispatch_us);
+    app_config->asrc_worker_ratio_read = take_flag(argc, argv, "--worker-ratio-read");
+    take_option(argc, argv, "--ratio-latency-us", &app_config->ratio_latency_us);
+    app_config->ratio_delay_blocks = take_option(argc, argv, "--ratio-delay-blocks", &value) ? (unsigned)value : 0;
+
+    if(!app_config->fast_sim && ((app_config->sof_jitter_us != 0) || (app_config->switch_time_secs != 0) || use_asrc_pool_model(app_config)))
+    {
+        printf("ERROR: --sof-jitter, --switch-time and the ASRC pool options are only supported with --fast\n");
+        return -1;
+    }
+    if((app_config->switch_us != 0) && (app_config->switch_time_secs == 0))
+    {
+        printf("ERROR: --switch-us is only supported with --switch-time\n");
+        return -1;
+    }
+    if(pair && ((app_config->asrc_channels != 2) || (app_config->asrc_workers != 2)))
+    {
+        printf("ERROR: --pair is 2 channels and 2 workers\n");
+        return -1;
+    }
+    if((app_config->ratio_latency_us != 0) && !app_config->asrc_worker_ratio_read)
+    {
+        printf("ERROR: --ratio-latency-us is only supported with --worker-ratio-read\n");
+        return -1;
+    }
+    if(app_config->asrc_worker_ratio_read && (app_config->ratio_delay_blocks != 0))
+    {
+        printf("ERROR: --worker-ratio-read delays the rate ratio with --ratio-latency-us instead of --ratio-delay-blocks\n");
+        return -1;
+    }
+    if(app_config->ratio_delay_blocks >= RATE_RATIO_UPDATE_BLOCKS)
+    {
+        printf("ERROR: --ratio-delay-blocks must be less than the %d block interval between rate ratio updates\n", RATE_RATIO_UPDATE_BLOCKS);
+        return -1;
+    }
+    if((app_config->asrc_channels == 0) || ((app_config->asrc_channels > 1) && !app_config->asrc_count_model))
+    {
+        printf("ERROR: More than one channel is only supported with --asrc-count-model\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Apply the --kp-scale and --ki-scale settings to a controller just initialised with the gains for its rate
+void scale_pi_control_gains(pi_control_state_t *state, const config_t *app_config)
+{
+    state->Kp = (sw_pll_q24_t)(state->Kp * app_config->kp_scale);
+    state->Ki = (sw_pll_q24_t)(state->Ki * app_config->ki_scale);
+}
+
+// Whether the fast simulation models the ASRC as a multichannel pool of workers, rather than a single channel processed
+// in no time
+bool use_asrc_pool_model(const config_t *app_config)
+{
+    return (app_config->asrc_channels != 1) || (app_config->asrc_workers != 1) || (app_config->asrc_compute_us != 0) ||
+           (app_config->asrc_dispatch_us != 0) || app_config->asrc_worker_ratio_read;
+}
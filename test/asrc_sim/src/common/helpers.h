@@ -2,5 +2,20 @@
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 #pragma once
 
-void parse_sof_timestamps(const char *fname, config_t *app_config);
+#include "pi_control.h"
+
+#define SIM_OPTIONS_USAGE "Options: --bypass --time <seconds> --drift-ppm <ppm> --kp-scale <scale> --ki-scale <scale> " \
+                          "--window-log2 <n> --stable-threshold <n> --fast --asrc-count-model --sof-jitter <us> --seed <n> " \
+                          "--switch-time <seconds> --switch-rate <i2s_rate> --switch-us <us> --channels <n> --workers <n> --compute-us <us> " \
+                          "--compute-jitter <fraction> --pair --dispatch-us <us> --worker-ratio-read --ratio-latency-us <us> " \
+                          "--ratio-delay-blocks <n>\n"
+
+int parse_sof_timestamps(const char *fname, config_t *app_config);
 int verify_i2s_rate(int i2s_rate);
+bool take_flag(int *argc, char *argv[], const char *flag);
+bool take_option(int *argc, char *argv[], const char *option, double *value);
+int take_sim_options(int *argc, char *argv[], config_t *app_config);
+void scale_pi_control_gains(pi_control_state_t *state, const config_t *app_config);
+bool use_asrc_pool_model(const config_t *app_config);
+
+#define RATE_RATIO_UPDATE_BLOCKS (16) // No. of ASRC blocks between rate ratio updates of the controller
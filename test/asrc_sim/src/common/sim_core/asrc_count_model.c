@@ -0,0 +1,30 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <assert.h>
+#include <string.h>
+#include "asrc_count_model.h"
+
+#define Q60_FRAC_MASK   (((uint64_t)1 << 60) - 1)
+
+void asrc_count_model_init(asrc_count_model_state_t *state)
+{
+    memset(state, 0, sizeof(asrc_count_model_state_t));
+}
+
+unsigned asrc_count_model_process(asrc_count_model_state_t *state, uint64_t fs_ratio, uint32_t n_in_samples)
+{
+    assert(fs_ratio != 0);
+    const uint32_t step_int = (uint32_t)(fs_ratio >> 60);
+    const uint64_t step_frac = fs_ratio & Q60_FRAC_MASK;
+
+    unsigned n_out = 0;
+    while(state->next_out_int < n_in_samples)
+    {
+        n_out++;
+        state->next_out_frac += step_frac;
+        state->next_out_int += step_int + (uint32_t)(state->next_out_frac >> 60);
+        state->next_out_frac &= Q60_FRAC_MASK;
+    }
+    state->next_out_int -= n_in_samples;
+    return n_out;
+}
@@ -0,0 +1,39 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef ASRC_COUNT_MODEL_H
+#define ASRC_COUNT_MODEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Stand-in for the ASRC that only works out how many output samples each input block produces, for simulating long
+// stretches of clock drift where only the buffer levels matter. An output sample is produced for every fs_ratio input
+// samples, tracking the fractional position of the next output sample across blocks, so over many blocks the output
+// count follows the rate ratio exactly. Block by block, it may differ by a sample from the ASRC, whose output is delayed
+// by its filters.
+
+/// @brief Structure containing persistant variables that make up the count model state
+typedef struct
+{
+    uint32_t next_out_int;  /// Integer part of the position of the next output sample, in input samples from the start of the next block
+    uint64_t next_out_frac; /// Fractional part of the position of the next output sample, Q60
+}asrc_count_model_state_t;
+
+/// @brief Initialise the count model state
+/// @param state    Pointer to the asrc_count_model_state_t state structure
+void asrc_count_model_init(asrc_count_model_state_t *state);
+
+/// @brief Count the output samples for one input block
+/// @param state        Pointer to the asrc_count_model_state_t state structure
+/// @param fs_ratio     Rate ratio, fs_in/fs_out in the Q60 rate ratio format. Must not be 0
+/// @param n_in_samples Input block length
+/// @return unsigned    Number of output samples
+unsigned asrc_count_model_process(asrc_count_model_state_t *state, uint64_t fs_ratio, uint32_t n_in_samples);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif
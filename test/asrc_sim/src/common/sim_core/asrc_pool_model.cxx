@@ -0,0 +1,166 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include "asrc_pool_model.h"
+
+AsrcPoolModel::AsrcPoolModel(unsigned num_channels, unsigned num_workers, double compute_time, double compute_jitter,
+                             double dispatch_time, bool worker_ratio_read, double ratio_latency, unsigned seed)
+    : m_num_channels(num_channels)
+    , m_compute_time(compute_time)
+    , m_compute_jitter(compute_jitter)
+    , m_dispatch_time(sim_time_from_us(dispatch_time))
+    , m_worker_ratio_read(worker_ratio_read)
+    , m_ratio_latency(sim_time_from_us(ratio_latency))
+    , m_rng(seed)
+    , m_count_state(num_channels)
+    , m_total_out(num_channels, 0)
+{
+    assert(num_channels > 0);
+    num_workers = std::min(num_workers, num_channels);
+    num_workers = std::min(num_workers, (unsigned)ASRC_POOL_MODEL_MAX_WORKERS);
+    m_num_workers = std::max(num_workers, 1u);
+
+    // Same split as asrc_pool_init(). The first (num_channels % num_workers) groups get one extra channel
+    for(unsigned w = 0; w < m_num_workers; w++)
+    {
+        m_group_num_ch[w] = (num_channels / m_num_workers) + ((w < (num_channels % m_num_workers)) ? 1 : 0);
+    }
+    for(auto &state : m_count_state)
+    {
+        asrc_count_model_init(&state);
+    }
+    printf("ASRC pool: %u channels, %u workers, rate ratio read %s\n", m_num_channels, m_num_workers,
+           m_worker_ratio_read ? "by each worker" : "from the frame");
+}
+
+sim_time_t AsrcPoolModel::start_block(sim_time_t trigger_time)
+{
+    sim_time_t start = trigger_time;
+    if(m_busy_until > trigger_time)
+    {
+        start = m_busy_until;
+        m_late_blocks++;
+    }
+
+    std::uniform_real_distribution<double> jitter_dist(-m_compute_jitter, m_compute_jitter);
+    block_t block;
+    sim_time_t first_done = UINT64_MAX;
+    sim_time_t last_done = 0;
+    for(unsigned w = 0; w < m_num_workers; w++)
+    {
+        double compute = 0;
+        for(unsigned ch = 0; ch < m_group_num_ch[w]; ch++)
+        {
+            compute += m_compute_time * (1 + ((m_compute_jitter != 0) ? jitter_dist(m_rng) : 0));
+        }
+        // The owner sends the frame to the workers in turn before starting on group 0. Each send takes the dispatch
+        // time, and the worker takes it again to wake up and receive the frame. Each worker replies over the done queue
+        sim_time_t read = start + (m_dispatch_time * ((w == 0) ? (m_num_workers - 1) : (w + 1)));
+        sim_time_t done = read + sim_time_from_us(compute) + ((w == 0) ? 0 : m_dispatch_time);
+        block.read_time[w] = read;
+        first_done = std::min(first_done, done);
+        last_done = std::max(last_done, done);
+    }
+    block.done_time = last_done;
+    m_started.push_back(block);
+
+    m_worst_skew = std::max(m_worst_skew, last_done - first_done);
+    m_worst_latency = std::max(m_worst_latency, last_done - trigger_time);
+    m_busy_until = last_done;
+    return last_done;
+}
+
+void AsrcPoolModel::finish_block()
+{
+    assert(!m_started.empty());
+    m_block = m_started.front();
+    m_started.pop_front();
+}
+
+uint64_t AsrcPoolModel::read_ratio(sim_time_t time) const
+{
+    uint64_t ratio = m_visible_ratio;
+    for(const auto &published : m_published)
+    {
+        if(published.first > time)
+        {
+            break;
+        }
+        ratio = published.second;
+    }
+    return ratio;
+}
+
+unsigned AsrcPoolModel::process_counts(uint64_t fs_ratio, uint32_t n_in_samples)
+{
+    if(!m_visible_ratio_valid)
+    {
+        // Nothing published yet, so the workers start from the initial ratio
+        m_visible_ratio = fs_ratio;
+        m_visible_ratio_valid = true;
+    }
+
+    uint64_t min_total = UINT64_MAX;
+    uint64_t max_total = 0;
+    unsigned n_out = 0;
+    unsigned ch = 0;
+    bool split = false;
+    uint64_t owner_ratio = m_worker_ratio_read ? read_ratio(m_block.read_time[0]) : fs_ratio;
+    for(unsigned w = 0; w < m_num_workers; w++)
+    {
+        uint64_t ratio = m_worker_ratio_read ? read_ratio(m_block.read_time[w]) : fs_ratio;
+        split |= (ratio != owner_ratio);
+        for(unsigned i = 0; i < m_group_num_ch[w]; i++, ch++)
+        {
+            unsigned n_out_ch = asrc_count_model_process(&m_count_state[ch], ratio, n_in_samples);
+            if(ch == 0)
+            {
+                n_out = n_out_ch;
+            }
+            m_total_out[ch] += n_out_ch;
+            min_total = std::min(min_total, m_total_out[ch]);
+            max_total = std::max(max_total, m_total_out[ch]);
+        }
+    }
+    m_split_blocks += split ? 1 : 0;
+    m_max_divergence = std::max(m_max_divergence, max_total - min_total);
+
+    // Later blocks read no earlier than this block's output was written, so older ratios are no longer needed
+    while(!m_published.empty() && (m_published.front().first <= m_block.done_time))
+    {
+        m_visible_ratio = m_published.front().second;
+        m_published.pop_front();
+    }
+    return n_out;
+}
+
+void AsrcPoolModel::publish_ratio(uint64_t fs_ratio)
+{
+    if(m_worker_ratio_read)
+    {
+        // The ratio comes from the controller asynchronously to the ASRC blocks, so it arrives any time up to the latency
+        std::uniform_int_distribution<sim_time_t> latency_dist(0, m_ratio_latency);
+        m_published.push_back({m_block.done_time + latency_dist(m_rng), fs_ratio});
+    }
+}
+
+void AsrcPoolModel::reset_ratio(uint64_t fs_ratio)
+{
+    m_published.clear();
+    m_visible_ratio = fs_ratio;
+    m_visible_ratio_valid = true;
+}
+
+void AsrcPoolModel::print(double out_samples_per_unit)
+{
+    // Times are in ps of simulation time. The extra buffering is what the output buffer needs on top of a pool with no
+    // compute time, so that the last worker's output still arrives in time
+    double skew_units = (double)m_worst_skew / 1e6;
+    double latency_units = (double)m_worst_latency / 1e6;
+    printf("Pool: max_divergence=%llu split_blocks=%llu worst_skew_samples=%.2f worst_latency_samples=%.2f extra_buffer_samples=%u late_blocks=%llu\n",
+           (unsigned long long)m_max_divergence, (unsigned long long)m_split_blocks, skew_units * out_samples_per_unit, latency_units * out_samples_per_unit,
+           (unsigned)ceil(latency_units * out_samples_per_unit), (unsigned long long)m_late_blocks);
+}
@@ -0,0 +1,110 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+#include "event_sim.h"
+#include "asrc_count_model.h"
+
+// Model of the ASRC demo's multichannel ASRC pool (asrc_pool_t in asrc_utils.h), for the fast simulation core.
+//
+// The channels are split into groups of consecutive channels the same way as asrc_pool_init(), one group per worker,
+// with group 0 processed by the thread that owns the pool. On every block, the owner hands the frame to workers 1 to
+// W-1 in turn over their queues and then processes group 0 itself, each worker takes a modelled compute time per channel
+// in its group and replies over the done queue, and the output is written once the last reply is in. A block can't
+// start before the previous one has finished, so if the workers can't keep up, blocks start late. The baseline
+// topology, the main task and asrc_one_channel_task with a channel each, is the same as a pool of 2 channels and 2
+// workers.
+//
+// Each channel runs its own ASRC output count model. Like asrc_pool_process(), all the workers normally use the rate
+// ratio the owner put in the frame, so the channels can't diverge. Alternatively, each worker reads the latest rate
+// ratio the controller has published when it starts on the block, and a new ratio only becomes visible a random
+// latency after the controller update. A ratio published between the first and the last worker's read is then used by some
+// channels and not others. The per channel output counts are compared like asrc_pool_process() does, and any
+// divergence is reported instead of asserting.
+
+#define ASRC_POOL_MODEL_MAX_WORKERS (8)
+
+class AsrcPoolModel
+{
+    public:
+        /// @param num_channels         Number of channels
+        /// @param num_workers          Number of workers, including the pool owner. Limited to num_channels
+        /// @param compute_time         Compute time per channel per block, in simulation time units (SC_US)
+        /// @param compute_jitter       Random variation of each channel's compute time, as a fraction of compute_time
+        /// @param dispatch_time        Time of each queue send, and of the receiver waking up to it, between the owner
+        ///                             and a worker, in simulation time units
+        /// @param worker_ratio_read    Whether each worker reads the latest published rate ratio when it starts, rather
+        ///                             than using the frame's
+        /// @param ratio_latency        Longest time from a controller update to the new ratio being visible to the
+        ///                             workers, in simulation time units. Each update takes a random time up to it.
+        ///                             Only used with worker_ratio_read
+        /// @param seed                 Seed for the compute time variation
+        AsrcPoolModel(unsigned num_channels, unsigned num_workers, double compute_time, double compute_jitter,
+                      double dispatch_time, bool worker_ratio_read, double ratio_latency, unsigned seed);
+
+        /// @brief Start a block whose frame is ready at trigger_time
+        /// @return sim_time_t  Time at which every worker has finished and the block's output can be written
+        sim_time_t start_block(sim_time_t trigger_time);
+
+        /// @brief Take the oldest started block as the one being written. Called once per block, at the time
+        /// start_block() returned, before the block is processed
+        void finish_block();
+
+        /// @brief Count the output samples of every channel for the block being written
+        /// @param fs_ratio     Rate ratio in the frame
+        /// @return unsigned    Number of output samples of channel 0, which the pool owner returns
+        unsigned process_counts(uint64_t fs_ratio, uint32_t n_in_samples);
+
+        /// @brief Publish a new rate ratio from the controller, after processing the block being written. With
+        /// worker_ratio_read, the workers see it from a random time up to ratio_latency after that block's output was
+        /// written
+        void publish_ratio(uint64_t fs_ratio);
+
+        /// @brief Make a rate ratio visible to the workers straight away, dropping any still on its way. Used when the
+        /// owner restarts the ASRC at a new rate
+        void reset_ratio(uint64_t fs_ratio);
+
+        /// @brief Print the pool statistics line
+        /// @param out_samples_per_unit Output samples per simulation time unit, to express the timings in output samples
+        void print(double out_samples_per_unit);
+
+    private:
+        struct block_t
+        {
+            std::array<sim_time_t, ASRC_POOL_MODEL_MAX_WORKERS> read_time;  // Time each worker starts on the block
+            sim_time_t done_time;                                           // Time the block's output is written
+        };
+
+        uint64_t read_ratio(sim_time_t time) const;
+
+        unsigned m_num_channels;
+        unsigned m_num_workers;
+        unsigned m_group_num_ch[ASRC_POOL_MODEL_MAX_WORKERS];
+        double m_compute_time;
+        double m_compute_jitter;
+        sim_time_t m_dispatch_time;
+        bool m_worker_ratio_read;
+        sim_time_t m_ratio_latency;
+        std::mt19937 m_rng;
+
+        std::deque<block_t> m_started;      // Blocks started and not yet written
+        block_t m_block = {};               // Block being written
+        std::deque<std::pair<sim_time_t, uint64_t>> m_published;  // Published ratios and the times they become visible
+        uint64_t m_visible_ratio = 0;       // Ratio visible before the first m_published entry
+        bool m_visible_ratio_valid = false;
+
+        std::vector<asrc_count_model_state_t> m_count_state;
+        std::vector<uint64_t> m_total_out;
+
+        sim_time_t m_busy_until = 0;
+        sim_time_t m_worst_skew = 0;        // Largest difference between the first and the last worker to finish a block
+        sim_time_t m_worst_latency = 0;     // Largest time from a frame being ready to its output being written
+        uint64_t m_late_blocks = 0;         // Blocks that had to wait for the previous block to finish
+        uint64_t m_max_divergence = 0;      // Largest difference between the total output counts of any two channels
+        uint64_t m_split_blocks = 0;        // Blocks whose workers didn't all use the same rate ratio
+};
@@ -0,0 +1,27 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <cassert>
+#include "event_sim.h"
+
+void EventSim::schedule(sim_time_t time, int priority, handler_t handler)
+{
+    assert(time >= m_now);
+    m_events.push(event_t{time, priority, m_seq++, handler});
+}
+
+void EventSim::run(sim_time_t end_time)
+{
+    while(!m_stopped && !m_events.empty() && (m_events.top().time <= end_time))
+    {
+        event_t event = m_events.top();
+        m_events.pop();
+        m_now = event.time;
+        m_num_events++;
+        event.handler();
+    }
+}
+
+void EventSim::stop()
+{
+    m_stopped = true;
+}
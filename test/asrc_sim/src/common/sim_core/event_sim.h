@@ -0,0 +1,66 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Minimal discrete event scheduler for the fast simulation core. Time only advances to the next scheduled event, so the
+// idle time between events costs nothing.
+//
+// Times are in picoseconds of simulation time, the SystemC default time resolution, and are rounded the same way as
+// sc_time so that both models put events at the same times. Events at the same time run in increasing priority order,
+// then in the order they were scheduled.
+
+typedef uint64_t sim_time_t;
+
+/// @brief Convert a time in SystemC SC_US units to sim_time_t, rounded like sc_time(v, SC_US)
+inline sim_time_t sim_time_from_us(double v)
+{
+    volatile double tmp = v * 1e6 + 0.5;
+    return (sim_time_t)tmp;
+}
+
+class EventSim
+{
+    public:
+        typedef std::function<void(void)> handler_t;
+
+        /// @brief Schedule handler to run at time. time must not be earlier than now()
+        void schedule(sim_time_t time, int priority, handler_t handler);
+
+        /// @brief Run events up to and including end_time, or until stop() is called
+        void run(sim_time_t end_time);
+
+        /// @brief Stop the simulation after the event being run
+        void stop();
+
+        sim_time_t now() const { return m_now; }
+        uint64_t num_events() const { return m_num_events; }
+
+    private:
+        struct event_t
+        {
+            sim_time_t time;
+            int priority;
+            uint64_t seq;
+            handler_t handler;
+        };
+        struct later_t
+        {
+            bool operator()(const event_t &a, const event_t &b) const
+            {
+                if(a.time != b.time) return a.time > b.time;
+                if(a.priority != b.priority) return a.priority > b.priority;
+                return a.seq > b.seq;
+            }
+        };
+
+        std::priority_queue<event_t, std::vector<event_t>, later_t> m_events;
+        sim_time_t m_now = 0;
+        uint64_t m_seq = 0;
+        uint64_t m_num_events = 0;
+        bool m_stopped = false;
+};
@@ -0,0 +1,76 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <cstdio>
+#include <cstdlib>
+#include "sim_stats.h"
+
+void SimStats::update(sim_time_t now, int fill_level, const buffer_calc_state_t *buf_state)
+{
+    if(fill_level < m_min_level) m_min_level = fill_level;
+    if(fill_level > m_max_level) m_max_level = fill_level;
+    if(m_switch_gap && (fill_level < m_switch_min_level)) m_switch_min_level = fill_level;
+
+    if(!buf_state->flag_stable_avg)
+    {
+        m_lock_time = now;
+        m_locked = false;
+        return;
+    }
+
+    int excursion = abs(fill_level - buf_state->stable_avg_level);
+    if(excursion > m_max_excursion) m_max_excursion = excursion;
+
+    int avg_excursion = abs(buf_state->avg_buffer_level - buf_state->stable_avg_level);
+    if(avg_excursion > m_max_avg_excursion) m_max_avg_excursion = avg_excursion;
+
+    if(avg_excursion > SIM_STATS_LOCK_TOLERANCE)
+    {
+        m_lock_time = now;
+        m_locked = false;
+    }
+    else
+    {
+        m_locked = true;
+    }
+}
+
+void SimStats::rate_switch(sim_time_t now, int fill_level, sim_time_t i2s_period)
+{
+    m_switched = true;
+    m_switch_gap = true;
+    m_switch_time = now;
+    m_switch_i2s_period = i2s_period;
+    m_switch_level = fill_level;
+    m_switch_min_level = fill_level;
+}
+
+void SimStats::switch_block_written(sim_time_t now)
+{
+    if(m_switch_gap)
+    {
+        m_switch_gap_time = now - m_switch_time;
+        m_switch_gap = false;
+    }
+}
+
+void SimStats::print(const Buffer &buffer, double time_scale)
+{
+    // A run that ends out of lock reports a lock time of -1
+    double lock_time = m_locked ? ((double)m_lock_time / 1e6 / time_scale) : -1.0;
+    printf("Stats: max_excursion=%d max_avg_excursion=%d lock_time=%.3f underflows=%u overflows=%u min_level=%d max_level=%d\n",
+           m_max_excursion, m_max_avg_excursion, lock_time, buffer.underflows(), buffer.overflows(), m_min_level, m_max_level);
+
+    if(m_switched)
+    {
+        // The gap is in I2S samples at the new rate, or -1 if no block after the switch was written. level_drop is how far
+        // the I2S read into the buffer during the gap. relock_time is the time from the switch until the average
+        // settled back within tolerance, or -1 if the run ends out of lock
+        double gap_samples = m_switch_gap ? -1.0 : ((double)m_switch_gap_time / m_switch_i2s_period);
+        double relock_time = -1.0;
+        if(m_locked)
+        {
+            relock_time = (m_lock_time > m_switch_time) ? ((double)(m_lock_time - m_switch_time) / 1e6 / time_scale) : 0.0;
+        }
+        printf("Switch: gap_samples=%.1f level_drop=%d relock_time=%.3f\n", gap_samples, m_switch_level - m_switch_min_level, relock_time);
+    }
+}
@@ -0,0 +1,50 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <cstdint>
+#include "avg_buffer_level.h"
+#include "buffer.h"
+#include "event_sim.h"
+
+// Buffer level statistics of a fast simulation run, printed at the end of the run as a single line of key=value pairs
+// that the parameter sweep script picks up.
+
+#define SIM_STATS_LOCK_TOLERANCE    (4) // Max distance in samples of the average from the stable level to count as locked
+
+class SimStats
+{
+    public:
+        /// @brief Update with the buffer level and the controller's averaging state. Called around every buffer write
+        void update(sim_time_t now, int fill_level, const buffer_calc_state_t *buf_state);
+
+        /// @brief Note an I2S rate switch, to measure the gap in the buffer writes that follows it
+        /// @param now          Time of the switch
+        /// @param fill_level   Buffer level at the switch
+        /// @param i2s_period   I2S sample period at the new rate
+        void rate_switch(sim_time_t now, int fill_level, sim_time_t i2s_period);
+
+        /// @brief Called when the first ASRC block triggered after the switch has written its output, ending the gap
+        void switch_block_written(sim_time_t now);
+
+        /// @brief Print the statistics line, followed by a line of switch statistics if there was a switch
+        /// @param buffer       Buffer, for the under and overflow counts
+        /// @param time_scale   Simulation time units (SC_US) per second
+        void print(const Buffer &buffer, double time_scale);
+
+    private:
+        int m_min_level = 0;
+        int m_max_level = 0;
+        int m_max_excursion = 0;        // Max distance of the level from the stable level, once stable
+        int m_max_avg_excursion = 0;    // Max distance of the average level from the stable level, once stable
+        sim_time_t m_lock_time = 0;     // Last time the average was away from the stable level, or not stable yet
+        bool m_locked = false;
+
+        bool m_switched = false;
+        bool m_switch_gap = false;      // Switched and the first block after the switch not written yet
+        sim_time_t m_switch_time = 0;
+        sim_time_t m_switch_i2s_period = 0;
+        sim_time_t m_switch_gap_time = 0;   // Time from the switch to the first block after it being written
+        int m_switch_level = 0;
+        int m_switch_min_level = 0;     // Lowest level during the gap
+};
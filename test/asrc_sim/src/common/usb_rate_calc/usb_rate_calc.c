@@ -44,89 +44,11 @@
 #define EXPECTED_IN_SAMPLES_PER_BUCKET ((EXPECTED_IN_SAMPLES_PER_TRANSACTION * 1000) / STORED_PER_SECOND)
 
 
-rate_info_t g_usb_rate_info;
-
-
 bool first_time[2] = {true, true};
 volatile static bool data_seen = false;
 volatile static bool hold_average = false;
 uint32_t bucket_expected[2] = {EXPECTED_OUT_SAMPLES_PER_BUCKET, EXPECTED_IN_SAMPLES_PER_BUCKET};
 
-uint64_t sum_array(uint32_t * array_to_sum, uint32_t array_length)
-{
-    uint64_t acc = 0;
-    for (uint32_t i = 0; i < array_length; i++)
-    {
-        acc += array_to_sum[i];
-    }
-    return acc;
-}
-
-#define CLZ_U64(X)    ( (__builtin_clz((uint32_t)(((uint64_t)(X))>>32)) == 32)?                                             \
-                        (__builtin_clz((uint32_t)(((uint64_t)(X))>>16)) == 32)?    32 + __builtin_clz((uint32_t)(X))                   \
-                                                                  :    16 + __builtin_clz((uint32_t)(((uint64_t)(X))>>16))  \
-                                                                  :    __builtin_clz((uint32_t)(((uint64_t)(X))>>32))   )
-
-uint64_t test_mult_div(rate_info_t numerator, rate_info_t denominator)
-{
-    uint32_t a_samples = numerator.samples;
-    uint32_t a_ticks = numerator.ticks;
-    uint32_t b_samples = denominator.samples;
-    uint32_t b_ticks = denominator.ticks;
-
-    // (a_samples * b_ticks) / (a_ticks * b_samples)
-    uint64_t ab_num = (uint64_t)a_samples * b_ticks;
-    uint32_t ab_num_hr = CLZ_U64(ab_num);
-
-    //printf("ab_num = %llu, ab_num_hr = %d\n",ab_num, ab_num_hr);
-    int32_t ab_num_exp = 0;
-    ab_num_exp = ab_num_exp - ab_num_hr;
-
-    int32_t b_samples_hr = __builtin_clz(b_samples);
-    int32_t b_samples_exp = 0;
-    b_samples_exp = b_samples_exp - b_samples_hr;
-
-    uint64_t h_dividend = (uint64_t)(ab_num << ab_num_hr);
-
-    uint32_t h_divisor = ((uint32_t)b_samples << b_samples_hr);
-
-    uint64_t quotient = h_dividend / h_divisor;
-
-    int32_t quotient_exp = ab_num_exp  - b_samples_exp;
-
-
-    uint64_t q_hr = CLZ_U64(quotient);
-    h_dividend = quotient << q_hr;
-    quotient_exp = quotient_exp - q_hr;
-
-    int32_t a_ticks_hr = __builtin_clz(a_ticks);
-    int32_t a_ticks_exp = 0;
-    a_ticks_exp = a_ticks_exp - a_ticks_hr;
-    h_divisor = a_ticks << a_ticks_hr;
-
-    quotient = h_dividend / h_divisor;
-
-    quotient_exp = quotient_exp - a_ticks_exp;
-
-    //printf("Quotient = %llu, exp = %d\n", quotient, quotient_exp);
-
-    int op_q = -(28+32);
-    if(quotient_exp < op_q)
-    {
-        int rsh = op_q - quotient_exp;
-        quotient = ((uint64_t)quotient >> rsh) + (((uint64_t)quotient >> (rsh-1)) & 0x1);
-    }
-    else
-    {
-        int lsh = quotient_exp - op_q;
-        quotient = (uint64_t)quotient << lsh;
-    }
-
-    //printf("Quotient = %llu\n", quotient);
-
-    return quotient;
-}
-
 void reset_state()
 {
     for (int direction = 0; direction < 2; direction++)
@@ -135,15 +57,10 @@ void reset_state()
     }
 }
 
-float_s32_t determine_USB_audio_rate(uint32_t timestamp,
+rate_info_t determine_USB_audio_rate(uint32_t timestamp,
                                     uint32_t data_length,
                                     uint32_t direction,
-                                    bool update
-#ifdef DEBUG_ADAPTIVE
-                                                ,
-                                    uint32_t * debug
-#endif
-)
+                                    bool update)
 {
     /*printuint(direction);
     printchar(',');
@@ -153,16 +70,12 @@ float_s32_t determine_USB_audio_rate(uint32_t timestamp,
 
     static uint32_t data_lengths[2][TOTAL_STORED];
     static uint32_t time_buckets[2][TOTAL_STORED];
+    static rate_window_state_t rate_window_state[2];
     static uint32_t current_data_bucket_size[2];
     static uint32_t first_timestamp[2];
-    static bool buckets_full[2];
-    static uint32_t times_overflowed[2];
-    static float_s32_t previous_result[2];
-
-    const float_s32_t nominal_samples_per_transaction = float_div((float_s32_t){appconfUSB_AUDIO_SAMPLE_RATE, 0}, (float_s32_t){REF_CLOCK_TICKS_PER_SECOND});
+    static rate_info_t previous_result[2];
 
-    previous_result[0] = nominal_samples_per_transaction;
-    previous_result[1] = nominal_samples_per_transaction;
+    const rate_info_t nominal_rate = {appconfUSB_AUDIO_SAMPLE_RATE, REF_CLOCK_TICKS_PER_SECOND};
 
     data_length = data_length / (CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX); // Number of samples per channels per transaction
 
@@ -187,26 +100,13 @@ float_s32_t determine_USB_audio_rate(uint32_t timestamp,
         // Because we use "first_time" to also reset the rate determinator,
         // reset all the static variables to default.
         current_data_bucket_size[direction] = 0;
-        times_overflowed[direction] = 0;
-        buckets_full[direction] = false;
+        init_rate_window_state(&rate_window_state[direction], data_lengths[direction], time_buckets[direction], TOTAL_STORED);
 
-        for (int i = 0; i < TOTAL_STORED - STORED_PER_SECOND; i++)
-        {
-            data_lengths[direction][i] = 0;
-            time_buckets[direction][i] = 0;
-        }
         // Seed the final second of initialised data with a "perfect" second - should make the start a bit more stable
-        for (int i = TOTAL_STORED - STORED_PER_SECOND; i < TOTAL_STORED; i++)
-        {
-            data_lengths[direction][i] = bucket_expected[direction];
-            time_buckets[direction][i] = REF_CLOCK_TICKS_PER_STORED_AVG;
-        }
+        rate_window_seed(&rate_window_state[direction], STORED_PER_SECOND, bucket_expected[direction], REF_CLOCK_TICKS_PER_STORED_AVG);
 
-        g_usb_rate_info.samples = appconfUSB_AUDIO_SAMPLE_RATE;
-        g_usb_rate_info.ticks = REF_CLOCK_TICKS_PER_SECOND;
-
-
-        return nominal_samples_per_transaction;
+        previous_result[direction] = nominal_rate;
+        return nominal_rate;
     }
 
     if (update)
@@ -214,75 +114,23 @@ float_s32_t determine_USB_audio_rate(uint32_t timestamp,
         current_data_bucket_size[direction] += data_length;
     }
 
-    // total_timespan is always correct regardless of whether the reference clock has overflowed.
+    // timespan is always correct regardless of whether the reference clock has overflowed.
     // The point at which it becomes incorrect is the point at which it would overflow - the
     // point at which timestamp == first_timestamp again. This will be at 42.95 seconds of operation.
     // If current_data_bucket_size overflows we have bigger issues, so this case is not guarded.
 
     uint32_t timespan = timestamp - first_timestamp[direction];
 
-    uint32_t total_data_intermed = current_data_bucket_size[direction] + sum_array(data_lengths[direction], TOTAL_STORED);
-    uint64_t total_timespan = timespan + sum_array(time_buckets[direction], TOTAL_STORED);
-
-    int hr_total_timespan = __builtin_clz((uint32_t)(total_timespan >> 32));
-    if(hr_total_timespan < 32)
-    {
-        int shift = 32 - hr_total_timespan;
-        //printf("1...total_timespan = %llx shift = %d, total_data_intermed = 0x%lx\n", total_timespan, shift, total_data_intermed);
-        total_timespan = total_timespan >> shift;
-        total_data_intermed = total_data_intermed >> shift;
-        //printf("total_timespan = %llx shift = %d, total_data_intermed = 0x%lx\n", total_timespan, shift, total_data_intermed);
-    }
-
-    float_s32_t float_s32_data_per_sample = float_div((float_s32_t){total_data_intermed, 0}, (float_s32_t){(uint32_t)total_timespan, 0});
-
-    g_usb_rate_info.samples = total_data_intermed;
-    g_usb_rate_info.ticks = total_timespan;
-
-    float_s32_t result = float_s32_data_per_sample;
-
+    rate_info_t result = rate_window_get_rate(&rate_window_state[direction], current_data_bucket_size[direction], timespan);
 
     if (update && (timespan >= REF_CLOCK_TICKS_PER_STORED_AVG))
     {
-        if (buckets_full[direction])
-        {
-            // We've got enough data for a new bucket - replace the oldest bucket data with this new data
-            uint32_t oldest_bucket = times_overflowed[direction] % TOTAL_STORED;
-
-            time_buckets[direction][oldest_bucket] = timespan;
-            data_lengths[direction][oldest_bucket] = current_data_bucket_size[direction];
-
-            current_data_bucket_size[direction] = 0;
-            first_timestamp[direction] = timestamp;
-
-            times_overflowed[direction]++;
-        }
-        else
-        {
-            // We've got enough data for this bucket - save this one and start the next one
-            time_buckets[direction][times_overflowed[direction]] = timespan;
-            data_lengths[direction][times_overflowed[direction]] = current_data_bucket_size[direction];
-
-            current_data_bucket_size[direction] = 0;
-            first_timestamp[direction] = timestamp;
-
-            times_overflowed[direction]++;
-            if (times_overflowed[direction] == TOTAL_STORED)
-            {
-                buckets_full[direction] = true;
-            }
-        }
-    }
-
-#ifdef DEBUG_ADAPTIVE
-    #define DEBUG_QUANT 4
+        // We've got enough data for this bucket - replace the oldest bucket data with this one and start the next one
+        rate_window_push_bucket(&rate_window_state[direction], current_data_bucket_size[direction], timespan);
 
-    uint32_t debug_out[DEBUG_QUANT] = {result, data_per_sample, total_data_intermed, total_timespan};
-    for (int i = 0; i < DEBUG_QUANT; i++)
-    {
-        debug[i] = debug_out[i];
+        current_data_bucket_size[direction] = 0;
+        first_timestamp[direction] = timestamp;
     }
-#endif
 
     previous_result[direction] = result;
 
@@ -10,23 +10,14 @@
 #endif
 
 #include "div.h"
+#include "rate_window.h"
 
-typedef struct
-{
-    uint32_t samples;
-    uint32_t ticks;
-}rate_info_t;
-
-float_s32_t determine_USB_audio_rate(uint32_t timestamp,
+rate_info_t determine_USB_audio_rate(uint32_t timestamp,
                                     uint32_t data_length,
                                     uint32_t direction,
                                     bool update
                                     );
 
-uint64_t test_mult_div(rate_info_t numerator, rate_info_t denominator);
-
-
-
 #ifdef __cplusplus
  }
 #endif
@@ -7,13 +7,21 @@ set(CMAKE_OSX_ARCHITECTURES "" CACHE INTERNAL "")
 add_executable(test_asrc_div
     ${CMAKE_CURRENT_LIST_DIR}/src/main.c
     ${CMAKE_CURRENT_LIST_DIR}/src/pseudo_rand.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/loopback_transport.c
+    ${ASRC_EXAMPLE_PATH}/src/avg_buffer_level.c
     ${ASRC_EXAMPLE_PATH}/src/shared/div.c
+    ${ASRC_EXAMPLE_PATH}/src/shared/rate_window.c
+    ${ASRC_EXAMPLE_PATH}/src/shared/pi_control.c
+    ${ASRC_EXAMPLE_PATH}/src/shared/asrc_bypass.c
+    ${ASRC_EXAMPLE_PATH}/src/shared/asrc_xfade.c
+    ${ASRC_EXAMPLE_PATH}/src/shared/asrc_intertile_msg.c
 )
 
 target_include_directories(test_asrc_div
     PRIVATE
         ${CMAKE_CURRENT_LIST_DIR}/src
         ${ASRC_EXAMPLE_PATH}/src/shared
+        ${ASRC_EXAMPLE_PATH}/src
 )
 
 
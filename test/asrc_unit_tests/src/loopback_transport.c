@@ -0,0 +1,50 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+
+#if !X86_BUILD
+    #include <xcore/assert.h>
+#else
+    #include <assert.h>
+    #define xassert assert
+#endif
+#include "loopback_transport.h"
+
+static void loopback_tx(const asrc_msg_transport_t *transport, const void *msg, size_t len)
+{
+    loopback_t *loopback = (loopback_t *)transport->ctx;
+    xassert(loopback->count < LOOPBACK_MAX_MSGS);
+    xassert(len <= LOOPBACK_MAX_MSG_SIZE);
+
+    unsigned tail = (loopback->head + loopback->count) % LOOPBACK_MAX_MSGS;
+    memcpy(loopback->msgs[tail], msg, len);
+    loopback->lens[tail] = len;
+    loopback->count++;
+    loopback->num_sent++;
+}
+
+static size_t loopback_rx(const asrc_msg_transport_t *transport, void *msg, size_t max_len)
+{
+    loopback_t *loopback = (loopback_t *)transport->ctx;
+    xassert(loopback->count > 0); // Would block forever
+
+    size_t len = loopback->lens[loopback->head];
+    memcpy(msg, loopback->msgs[loopback->head], (len < max_len) ? len : max_len);
+    loopback->head = (loopback->head + 1) % LOOPBACK_MAX_MSGS;
+    loopback->count--;
+    return len;
+}
+
+void loopback_transport_init(asrc_msg_transport_t *transport, loopback_t *loopback)
+{
+    memset(loopback, 0, sizeof(loopback_t));
+    transport->tx = loopback_tx;
+    transport->rx = loopback_rx;
+    transport->ctx = loopback;
+    transport->port = 0;
+}
+
+unsigned loopback_pending(const loopback_t *loopback)
+{
+    return loopback->count;
+}
@@ -0,0 +1,27 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "asrc_intertile_msg.h"
+
+// Host stand-in for the intertile context that the ASRC example application sends its asrc_intertile_msg messages
+// over. Messages sent on a loopback are queued in order and returned by the receive calls on the same loopback. Since
+// the tests run on a single thread, receiving from an empty loopback, which would wait forever on the device, is a
+// test failure.
+
+#define LOOPBACK_MAX_MSGS       (8)
+#define LOOPBACK_MAX_MSG_SIZE   (2048)
+
+typedef struct
+{
+    uint8_t msgs[LOOPBACK_MAX_MSGS][LOOPBACK_MAX_MSG_SIZE];
+    size_t lens[LOOPBACK_MAX_MSGS];
+    unsigned head;          // Index of the oldest queued message
+    unsigned count;         // Number of queued messages
+    unsigned num_sent;      // Total number of messages sent since initialisation
+}loopback_t;
+
+void loopback_transport_init(asrc_msg_transport_t *transport, loopback_t *loopback);
+unsigned loopback_pending(const loopback_t *loopback);
@@ -5,18 +5,28 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 #if !X86_BUILD
     #include <platform.h>
     #include <xs1.h>
     #include <xcore/assert.h>
+    #include <xcore/hwtimer.h>
 #else
     #include <assert.h>
+    #include <time.h>
     #define xassert assert
 #endif
 #include <xmath/xmath.h>
 #include "pseudo_rand.h"
 #include "div.h"
+#include "rate_window.h"
+#include "pi_control.h"
+#include "avg_buffer_level.h"
+#include "asrc_bypass.h"
+#include "asrc_xfade.h"
+#include "asrc_intertile_msg.h"
+#include "loopback_transport.h"
 
 void test_float_div(unsigned seed, bool verbose)
 {
@@ -100,6 +110,1153 @@ void test_div_fixed_output_q_format(unsigned seed, bool verbose)
     }
 }
 
+void test_rate_ratio_fixed_output_q_format(unsigned seed, bool verbose)
+{
+
+    for(int itt=0; itt<(1<<8); itt++)
+    {
+        // Rates as seen on the device: up to 16 seconds worth of samples at up to 192KHz, over 16 seconds worth of 100MHz ticks
+        uint32_t ticks_num = pseudo_rand_uint(&seed, 1000000, 1600000000);
+        uint32_t ticks_den = pseudo_rand_uint(&seed, 1000000, 1600000000);
+        rate_info_t numerator = {(uint64_t)((double)ticks_num * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_num};
+        rate_info_t denominator = {(uint64_t)((double)ticks_den * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_den};
+
+        // reference
+        double ref = ((double)numerator.samples * denominator.ticks) / ((double)numerator.ticks * denominator.samples);
+
+        // rate_ratio_fixed_output_q_format()
+        int32_t output_q_format = 28+32;
+        uint64_t res = rate_ratio_fixed_output_q_format(numerator, denominator, output_q_format);
+        double dut = ldexp(res, -output_q_format);
+
+        double abs_diff = fabs(ref - dut);
+        double rel_error = fabs(abs_diff/(ref + ldexp(1, -40)));
+        double thresh = ldexp(1, -50);
+
+        if(verbose)
+        {
+            printf("rate_ratio_fixed_output_q_format: itt %d: res = %.15f. ref = %.15f, rel_error = %.15e, thresh = %.15e \n", itt, dut, ref, rel_error, thresh);
+        }
+
+        if(rel_error > thresh)
+        {
+            printf("FAIL, test_rate_ratio_fixed_output_q_format(): itt %d: dut = %.15f. ref = %.15f, rel_error = %.15e, thresh = %.15e\n", itt, dut, ref, rel_error, thresh);
+            xassert(0);
+        }
+    }
+}
+
+void test_rate_window(unsigned seed, bool verbose)
+{
+    #define TEST_NUM_BUCKETS (16)
+    uint32_t sample_buckets[TEST_NUM_BUCKETS];
+    uint32_t tick_buckets[TEST_NUM_BUCKETS];
+    uint32_t ref_sample_buckets[TEST_NUM_BUCKETS] = {0};
+    uint32_t ref_tick_buckets[TEST_NUM_BUCKETS] = {0};
+    rate_window_state_t state;
+
+    init_rate_window_state(&state, sample_buckets, tick_buckets, TEST_NUM_BUCKETS);
+    rate_window_seed(&state, 4, 12000, 25000000);
+    for(int i=TEST_NUM_BUCKETS-4; i<TEST_NUM_BUCKETS; i++)
+    {
+        ref_sample_buckets[i] = 12000;
+        ref_tick_buckets[i] = 25000000;
+    }
+
+    for(int itt=0; itt<(1<<8); itt++)
+    {
+        uint32_t samples = pseudo_rand_uint(&seed, 11000, 49000);
+        uint32_t ticks = pseudo_rand_uint(&seed, 24000000, 26000000);
+        uint32_t partial_samples = pseudo_rand_uint(&seed, 0, 49000);
+        uint32_t partial_ticks = pseudo_rand_uint(&seed, 0, 26000000);
+
+        rate_window_push_bucket(&state, samples, ticks);
+        ref_sample_buckets[itt % TEST_NUM_BUCKETS] = samples;
+        ref_tick_buckets[itt % TEST_NUM_BUCKETS] = ticks;
+
+        // reference, summing over all the buckets
+        rate_info_t ref = {partial_samples, partial_ticks};
+        for(int i=0; i<TEST_NUM_BUCKETS; i++)
+        {
+            ref.samples += ref_sample_buckets[i];
+            ref.ticks += ref_tick_buckets[i];
+        }
+
+        rate_info_t dut = rate_window_get_rate(&state, partial_samples, partial_ticks);
+
+        if(verbose)
+        {
+            printf("rate_window: itt %d: dut = (%llu, %llu). ref = (%llu, %llu)\n", itt, (unsigned long long)dut.samples, (unsigned long long)dut.ticks, (unsigned long long)ref.samples, (unsigned long long)ref.ticks);
+        }
+
+        if((dut.samples != ref.samples) || (dut.ticks != ref.ticks))
+        {
+            printf("FAIL, test_rate_window(): itt %d: dut = (%llu, %llu). ref = (%llu, %llu)\n", itt, (unsigned long long)dut.samples, (unsigned long long)dut.ticks, (unsigned long long)ref.samples, (unsigned long long)ref.ticks);
+            xassert(0);
+        }
+    }
+}
+void test_pi_control(unsigned seed, bool verbose)
+{
+    pi_control_state_t pi_state;
+
+    init_i2s_buffer_pi_control_state(&pi_state, 48000);
+
+    // No correction till the buffer level average is stable
+    int64_t correction = pi_control(&pi_state, false, pseudo_rand_int(&seed, -100, 100));
+    xassert((correction == 0) && (pi_state.integral == 0));
+
+    // With a small constant error, the correction is the P term plus a linearly growing I term
+    int32_t error = pseudo_rand_int(&seed, 1, 20);
+    for(int itt=1; itt<=16; itt++)
+    {
+        correction = pi_control(&pi_state, true, error);
+        int64_t ref = (((int64_t)pi_state.Kp * error) << 8) + ((((int64_t)pi_state.Ki * error) << 8) * itt);
+        if(verbose)
+        {
+            printf("pi_control: itt %d: dut = %lld, ref = %lld\n", itt, (long long)correction, (long long)ref);
+        }
+        if(correction != ref)
+        {
+            printf("FAIL, test_pi_control(): itt %d: dut = %lld, ref = %lld\n", itt, (long long)correction, (long long)ref);
+            xassert(0);
+        }
+    }
+
+    // Drive the output into saturation for a long time. The integral must stop growing (anti-windup)
+    int64_t integral_at_saturation = 0;
+    for(int itt=0; itt<(1<<12); itt++)
+    {
+        correction = pi_control(&pi_state, true, 1000);
+        xassert(correction == pi_state.max_correction);
+        xassert(pi_state.integral <= pi_state.max_correction);
+        if(itt == 0)
+        {
+            integral_at_saturation = pi_state.integral;
+        }
+    }
+    if(pi_state.integral != integral_at_saturation)
+    {
+        printf("FAIL, test_pi_control(): integral wound up while saturated: %lld, %lld\n", (long long)pi_state.integral, (long long)integral_at_saturation);
+        xassert(0);
+    }
+
+    // Once the error reverses, the output must come out of saturation straight away
+    correction = pi_control(&pi_state, true, -10);
+    xassert(correction < pi_state.max_correction);
+
+    // A reset of the buffer level averaging clears the integral
+    correction = pi_control(&pi_state, false, -10);
+    xassert((correction == 0) && (pi_state.integral == 0));
+
+    // A rate switch keeps the integral, rescaled by the ratio of the old to the new rate, and picks up the new gains
+    pi_state.integral = (int64_t)pseudo_rand_int(&seed, -1000, 1000) << 32;
+    int64_t integral_before_switch = pi_state.integral;
+    retarget_i2s_buffer_pi_control_state(&pi_state, 48000, 96000);
+    xassert(pi_state.integral == integral_before_switch / 2);
+    xassert((pi_state.Kp == KP_I2S_BUF_CONTROL_FS96) && (pi_state.Ki == KI_I2S_BUF_CONTROL_FS96));
+    retarget_i2s_buffer_pi_control_state(&pi_state, 96000, 48000);
+    xassert(pi_state.integral == (integral_before_switch / 2) * 2);
+
+    // Rescaling must not take the integral beyond the correction limit
+    pi_state.integral = pi_state.max_correction;
+    retarget_i2s_buffer_pi_control_state(&pi_state, 192000, 48000);
+    xassert(pi_state.integral == pi_state.max_correction);
+
+    // Starting afresh clears it
+    retarget_i2s_buffer_pi_control_state(&pi_state, 0, 48000);
+    xassert(pi_state.integral == 0);
+}
+
+void test_asrc_bypass(unsigned seed, bool verbose)
+{
+    asrc_bypass_state_t state;
+    const uint32_t n_in = 96;
+    int32_t input[96];
+    int32_t output[96 + 1];
+
+    init_asrc_bypass_state(&state, ASRC_BYPASS_DEFAULT_MAX_DEVIATION);
+
+    // Bypass needs equal nominal rates
+    xassert(asrc_bypass_update(&state, 48000, 96000, (uint64_t)ASRC_BYPASS_RATIO_ONE) == false);
+    xassert(asrc_bypass_update(&state, 0, 0, (uint64_t)ASRC_BYPASS_RATIO_ONE) == false);
+
+    // Hysteresis. Enter within max_deviation, stay in up to 2*max_deviation, leave beyond that
+    xassert(asrc_bypass_update(&state, 48000, 48000, ASRC_BYPASS_RATIO_ONE + (3 * state.max_deviation / 2)) == false);
+    xassert(asrc_bypass_update(&state, 48000, 48000, ASRC_BYPASS_RATIO_ONE - state.max_deviation) == true);
+    xassert(asrc_bypass_update(&state, 48000, 48000, ASRC_BYPASS_RATIO_ONE + (3 * state.max_deviation / 2)) == true);
+    xassert(asrc_bypass_update(&state, 48000, 48000, ASRC_BYPASS_RATIO_ONE - (5 * state.max_deviation / 2)) == false);
+
+    for(int test=0; test<20; test++)
+    {
+        // Random ratio within the deviation limit. Over many blocks, the number of output samples must track the ideal
+        // number, n_in/ratio per block, to within a sample.
+        int32_t ppm = pseudo_rand_int(&seed, -1000, 1001);
+        int64_t deviation = ASRC_BYPASS_PPM_TO_Q60(ppm);
+        uint64_t fs_ratio = ASRC_BYPASS_RATIO_ONE + deviation;
+        init_asrc_bypass_state(&state, ASRC_BYPASS_DEFAULT_MAX_DEVIATION);
+        xassert(asrc_bypass_update(&state, 48000, 48000, fs_ratio) == true);
+
+        int64_t total_out = 0;
+        int num_blocks = 20000;
+        for(int block=0; block<num_blocks; block++)
+        {
+            for(int i=0; i<n_in; i++)
+            {
+                input[i] = pseudo_rand_int32(&seed);
+            }
+            int32_t slip = asrc_bypass_plan_block(&state, fs_ratio, n_in);
+            unsigned n_out = asrc_bypass_process(input, output, n_in, slip);
+            xassert(n_out == n_in + slip);
+            total_out += n_out;
+
+            // Everything outside the slip is a copy of the input
+            uint32_t mid = n_in >> 1;
+            for(int i=0; i<mid-1; i++)
+            {
+                xassert(output[i] == input[i]);
+            }
+            for(int i=mid+1; i<n_out; i++)
+            {
+                xassert(output[i] == input[i - slip]);
+            }
+            int32_t avg = (int32_t)(((int64_t)input[mid - 1] + input[mid]) >> 1);
+            if(slip == 0)
+            {
+                xassert((output[mid - 1] == input[mid - 1]) && (output[mid] == input[mid]));
+            }
+            else if(slip < 0)
+            {
+                xassert(output[mid - 1] == avg);
+            }
+            else
+            {
+                xassert((output[mid - 1] == input[mid - 1]) && (output[mid] == avg));
+            }
+        }
+        double ideal_out = (double)num_blocks * n_in / (1.0 + ((double)deviation / ASRC_BYPASS_RATIO_ONE));
+        if(verbose)
+        {
+            printf("asrc_bypass: ppm %d, total_out %lld, ideal %f\n", ppm, (long long)total_out, ideal_out);
+        }
+        if(fabs((double)total_out - ideal_out) > 1.0)
+        {
+            printf("FAIL, test_asrc_bypass(): ppm %d, total_out %lld, ideal %f\n", ppm, (long long)total_out, ideal_out);
+            xassert(0);
+        }
+    }
+}
+
+// Largest first difference across a splice of the last sample of an old block and a new block. A step at the splice shows
+// up as a first difference larger than the signal's own.
+static double splice_peak_diff(int32_t old_last, const int32_t *new, unsigned n)
+{
+    double peak = 0.0;
+    int32_t prev = old_last;
+    for(unsigned i = 0; i < n; i++)
+    {
+        double diff = fabs((double)new[i] - (double)prev);
+        peak = (diff > peak) ? diff : peak;
+        prev = new[i];
+    }
+    return peak;
+}
+
+// Energy of the error of a block against a reference
+static double error_energy(const int32_t *block, const int32_t *ref, unsigned n)
+{
+    double energy = 0.0;
+    for(unsigned i = 0; i < n; i++)
+    {
+        double error = (double)block[i] - (double)ref[i];
+        energy += error * error;
+    }
+    return energy;
+}
+
+void test_asrc_xfade(unsigned seed, bool verbose)
+{
+    const unsigned n = 96;
+    int32_t old_block[96], new_block[96], faded_block[96], held_block[96], continuous_block[96], hold_block[ASRC_XFADE_LENGTH];
+
+    // Constant to constant: the crossfade output is an exact linear ramp from the old stream to the new one
+    int32_t hold = pseudo_rand_int(&seed, -(1 << 30), (1 << 30));
+    int32_t target = pseudo_rand_int(&seed, -(1 << 30), (1 << 30));
+    for(int i=0; i<ASRC_XFADE_LENGTH; i++)
+    {
+        hold_block[i] = hold;
+    }
+    for(int i=0; i<n; i++)
+    {
+        new_block[i] = target;
+    }
+    asrc_xfade(new_block, n, hold_block, ASRC_XFADE_LENGTH);
+    for(int i=0; i<n; i++)
+    {
+        int32_t ref = (i < ASRC_XFADE_LENGTH) ? (int32_t)((((int64_t)hold * (ASRC_XFADE_LENGTH - i)) + ((int64_t)target * i)) / ASRC_XFADE_LENGTH) : target;
+        xassert(new_block[i] == ref);
+    }
+    xassert(new_block[0] == hold);
+
+    // Blocks shorter than the crossfade are faded as far as they go
+    for(int i=0; i<n; i++)
+    {
+        new_block[i] = target;
+    }
+    asrc_xfade(new_block, 8, hold_block, ASRC_XFADE_LENGTH);
+    xassert(new_block[8] == target);
+    xassert(new_block[7] == (int32_t)((((int64_t)hold * (ASRC_XFADE_LENGTH - 7)) + ((int64_t)target * 7)) / ASRC_XFADE_LENGTH));
+
+    for(int test=0; test<40; test++)
+    {
+        // The old stream carried on over the first block of a new stream that restarts with an offset. For the first half
+        // of the tests, a random phase jump, as from an unprimed ASRC: crossfading from the old stream must take out the
+        // step at the splice, leaving no first difference larger than the streams' own plus the ramp's share of the
+        // distance between them. For the second half, a time offset of up to a sample, as from a primed ASRC: crossfading
+        // from the old stream must stay much closer to it over the crossfade than a crossfade from the last old sample does.
+        double freq = (double)pseudo_rand_int(&seed, 100, 2000) / 48000.0;
+        double amplitude = (double)(1 << 30);
+        bool primed = (test >= 20);
+        double phase_jump = primed ? (2 * M_PI * freq * (double)pseudo_rand_int(&seed, -1000, 1000) / 1000.0)
+                                   : ((double)pseudo_rand_int(&seed, 1000, 5000) / 1000.0);
+        for(int i=0; i<n; i++)
+        {
+            old_block[i] = (int32_t)(amplitude * sin(2 * M_PI * freq * i));
+            continuous_block[i] = (int32_t)(amplitude * sin(2 * M_PI * freq * (n + i)));
+            new_block[i] = (int32_t)(amplitude * sin((2 * M_PI * freq * (n + i)) + phase_jump));
+        }
+        memcpy(faded_block, new_block, sizeof(faded_block));
+        asrc_xfade(faded_block, n, continuous_block, ASRC_XFADE_LENGTH);
+        for(int i=0; i<ASRC_XFADE_LENGTH; i++)
+        {
+            hold_block[i] = old_block[n - 1];
+        }
+        memcpy(held_block, new_block, sizeof(held_block));
+        asrc_xfade(held_block, n, hold_block, ASRC_XFADE_LENGTH);
+
+        double peak_step = splice_peak_diff(old_block[n - 1], new_block, n);
+        double peak_max = amplitude * ((2 * M_PI * freq) + (2.0 / ASRC_XFADE_LENGTH)) + 2.0;
+        double peak_faded = splice_peak_diff(old_block[n - 1], faded_block, n);
+        double e_held = error_energy(held_block, continuous_block, ASRC_XFADE_LENGTH);
+        double e_faded = error_energy(faded_block, continuous_block, ASRC_XFADE_LENGTH);
+        if(verbose)
+        {
+            printf("asrc_xfade: freq %f, phase jump %f, peak diff step %e, crossfaded %e, error energy from hold %e, crossfaded %e\n", freq * 48000.0, phase_jump, peak_step, peak_faded, e_held, e_faded);
+        }
+        if(primed ? (e_faded > e_held * 0.1) : (peak_faded > peak_max))
+        {
+            printf("FAIL, test_asrc_xfade(): freq %f, phase jump %f, peak diff step %e, crossfaded %e, error energy from hold %e, crossfaded %e\n", freq * 48000.0, phase_jump, peak_step, peak_faded, e_held, e_faded);
+            xassert(0);
+        }
+    }
+
+    // Resampling the old stream to the new rate for the crossfade. The same rate is an exact copy, and linear interpolation
+    // of a tone well below both rates is within 1% of full scale, where the old block covers the crossfade.
+    const uint32_t rates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+    int32_t resampled[ASRC_XFADE_LENGTH];
+    for(int test=0; test<36; test++)
+    {
+        uint32_t fs_from = rates[test % 6];
+        uint32_t fs_to = rates[test / 6];
+        if((uint64_t)ASRC_XFADE_LENGTH * fs_from > (uint64_t)(n - 1) * fs_to)
+        {
+            continue;
+        }
+        double freq = (double)pseudo_rand_int(&seed, 100, 2000);
+        double amplitude = (double)(1 << 30);
+        for(int i=0; i<n; i++)
+        {
+            old_block[i] = (int32_t)(amplitude * sin(2 * M_PI * freq * i / fs_from));
+        }
+        asrc_xfade_resample(resampled, ASRC_XFADE_LENGTH, old_block, n, fs_from, fs_to);
+        for(int i=0; i<ASRC_XFADE_LENGTH; i++)
+        {
+            double ref = amplitude * sin(2 * M_PI * freq * i / fs_to);
+            if(((fs_from == fs_to) && (resampled[i] != old_block[i])) || (fabs(resampled[i] - ref) > amplitude * 0.01))
+            {
+                printf("FAIL, test_asrc_xfade(): resample %u -> %u, freq %f, i %d: dut %d, ref %f\n", (unsigned)fs_from, (unsigned)fs_to, freq, i, (int)resampled[i], ref);
+                xassert(0);
+            }
+        }
+    }
+
+    // Positions beyond the end of the old block hold its last sample
+    asrc_xfade_resample(resampled, ASRC_XFADE_LENGTH, old_block, 4, 192000, 44100);
+    xassert((resampled[0] == old_block[0]) && (resampled[ASRC_XFADE_LENGTH - 1] == old_block[3]));
+
+    // Reversing a block twice gives it back
+    for(unsigned len=0; len<8; len++)
+    {
+        for(unsigned i=0; i<len; i++)
+        {
+            old_block[i] = new_block[i] = pseudo_rand_int(&seed, -(1 << 30), (1 << 30));
+        }
+        asrc_xfade_reverse(new_block, len);
+        for(unsigned i=0; i<len; i++)
+        {
+            xassert(new_block[i] == old_block[len - 1 - i]);
+        }
+        asrc_xfade_reverse(new_block, len);
+        xassert(memcmp(new_block, old_block, len * sizeof(int32_t)) == 0);
+    }
+}
+
+// Message buffer of the same layout as the ones in the application, a header followed by interleaved frames
+typedef struct
+{
+    asrc_msg_header_t hdr;
+    int32_t frames[64][2];
+}test_msg_t;
+
+static void random_usb_rate_info(unsigned *seed, usb_rate_info_t *info)
+{
+    info->buffer_based_correction = pseudo_rand_int64(seed);
+    info->usb_rate.samples = pseudo_rand_uint64(seed);
+    info->usb_rate.ticks = pseudo_rand_uint64(seed);
+    info->samples_to_host_buf_fill_level = pseudo_rand_int32(seed);
+    info->mic_itf_open = pseudo_rand_uint32(seed) & 1;
+    info->spkr_itf_open = pseudo_rand_uint32(seed) & 1;
+}
+
+static bool usb_rate_info_equal(const usb_rate_info_t *a, const usb_rate_info_t *b)
+{
+    return (a->buffer_based_correction == b->buffer_based_correction) &&
+           (a->usb_rate.samples == b->usb_rate.samples) && (a->usb_rate.ticks == b->usb_rate.ticks) &&
+           (a->samples_to_host_buf_fill_level == b->samples_to_host_buf_fill_level) &&
+           (a->mic_itf_open == b->mic_itf_open) && (a->spkr_itf_open == b->spkr_itf_open);
+}
+
+// Single entry mailboxes standing in for the length 1 FreeRTOS queues of the application. Posting overwrites.
+typedef struct { bool full; usb_rate_info_t info; }usb_rate_info_mailbox_t;
+typedef struct { bool full; i2s_to_usb_rate_info_t info; }i2s_rate_info_mailbox_t;
+
+void test_asrc_intertile_msg(unsigned seed, bool verbose)
+{
+    const unsigned num_ch = 2;
+    asrc_msg_transport_t usb_to_i2s, i2s_to_usb;
+    loopback_t usb_to_i2s_loopback, i2s_to_usb_loopback;
+    test_msg_t tx_msg, rx_msg;
+    unsigned num_frames;
+
+    loopback_transport_init(&usb_to_i2s, &usb_to_i2s_loopback);
+    loopback_transport_init(&i2s_to_usb, &i2s_to_usb_loopback);
+
+    // Header and frames round trip, with any combination of rate info and any number of frames, including none
+    for(int itt=0; itt<1000; itt++)
+    {
+        unsigned n = pseudo_rand_uint(&seed, 0, 65);
+        usb_rate_info_t usb_info;
+        i2s_to_usb_rate_info_t i2s_info = {pseudo_rand_uint64(&seed)};
+        random_usb_rate_info(&seed, &usb_info);
+
+        asrc_msg_init_header(&tx_msg.hdr, pseudo_rand_uint32(&seed));
+        xassert(tx_msg.hdr.flags == 0);
+        uint32_t which = pseudo_rand_uint32(&seed);
+        if(which & 1)
+        {
+            asrc_msg_attach_usb_rate_info(&tx_msg.hdr, &usb_info);
+        }
+        if(which & 2)
+        {
+            asrc_msg_attach_i2s_rate_info(&tx_msg.hdr, &i2s_info);
+        }
+        xassert(asrc_msg_frames(&tx_msg.hdr) == &tx_msg.frames[0][0]);
+        for(unsigned i=0; i<n; i++)
+        {
+            for(unsigned ch=0; ch<num_ch; ch++)
+            {
+                tx_msg.frames[i][ch] = pseudo_rand_int32(&seed);
+            }
+        }
+        asrc_msg_send(&usb_to_i2s, &tx_msg.hdr, num_ch, n);
+
+        memset(&rx_msg, 0x5a, sizeof(rx_msg));
+        xassert(asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+        xassert(num_frames == n);
+        xassert(rx_msg.hdr.flags == (which & 3));
+        xassert(rx_msg.hdr.i2s_nominal_rate == tx_msg.hdr.i2s_nominal_rate);
+        if(which & 1)
+        {
+            xassert(usb_rate_info_equal(&rx_msg.hdr.usb_rate_info, &usb_info));
+        }
+        if(which & 2)
+        {
+            xassert(rx_msg.hdr.i2s_rate_info.usb_to_i2s_rate_ratio == i2s_info.usb_to_i2s_rate_ratio);
+        }
+        xassert(memcmp(rx_msg.frames, tx_msg.frames, n * num_ch * sizeof(int32_t)) == 0);
+    }
+
+    // Malformed messages are rejected: shorter than the header, a partial frame, unknown flags, too long for the buffer
+    asrc_msg_init_header(&tx_msg.hdr, 48000);
+    usb_to_i2s.tx(&usb_to_i2s, &tx_msg, sizeof(asrc_msg_header_t) - 4);
+    xassert(!asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+    usb_to_i2s.tx(&usb_to_i2s, &tx_msg, asrc_msg_size(num_ch, 3) + sizeof(int32_t));
+    xassert(!asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+    tx_msg.hdr.flags = 1 << 7;
+    asrc_msg_send(&usb_to_i2s, &tx_msg.hdr, num_ch, 3);
+    xassert(!asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+    asrc_msg_init_header(&tx_msg.hdr, 48000);
+    asrc_msg_send(&usb_to_i2s, &tx_msg.hdr, num_ch, 4);
+    xassert(!asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, asrc_msg_size(num_ch, 3), num_ch, &num_frames));
+    xassert(loopback_pending(&usb_to_i2s_loopback) == 0);
+
+    // Both tiles of the application, one block each way per iteration, with the host playing audio to the device for the
+    // first half and not for the second. The USB tile never receives anything that isn't already waiting for it (the
+    // loopback asserts otherwise), so it never blocks for the rate ratio, and the ratio worked out from each usb_rate_info
+    // reaches it within a couple of blocks either way.
+    #define RATE_MONITOR_TRIGGER_INTERVAL (16)
+    usb_rate_info_mailbox_t usb_side_mailbox = {0}, rate_server_mailbox = {0};
+    i2s_rate_info_mailbox_t i2s_side_mailbox = {0};
+    uint64_t usb_tile_ratio = 0;
+    int64_t last_trigger_id = -1;
+    unsigned last_trigger_block = 0;
+    unsigned num_triggers = 0;
+    const unsigned num_blocks = 1024;
+    loopback_transport_init(&usb_to_i2s, &usb_to_i2s_loopback);
+    loopback_transport_init(&i2s_to_usb, &i2s_to_usb_loopback);
+    for(unsigned block=0; block<num_blocks; block++)
+    {
+        bool host_playing = block < (num_blocks / 2);
+
+        // USB tile, usb_audio_send(): every so often, hand new rate info over without waiting for an answer
+        if((block % RATE_MONITOR_TRIGGER_INTERVAL) == 0)
+        {
+            usb_rate_info_t info;
+            random_usb_rate_info(&seed, &info);
+            info.buffer_based_correction = block; // Identifies the trigger the ratio comes from
+            if(!host_playing || usb_side_mailbox.full)
+            {
+                usb_side_mailbox.full = false;
+                asrc_msg_init_header(&tx_msg.hdr, 0);
+                asrc_msg_attach_usb_rate_info(&tx_msg.hdr, &info);
+                asrc_msg_send(&usb_to_i2s, &tx_msg.hdr, num_ch, 0);
+            }
+            else
+            {
+                usb_side_mailbox.info = info;
+                usb_side_mailbox.full = true;
+            }
+            last_trigger_id = block;
+            last_trigger_block = block;
+            num_triggers++;
+        }
+
+        // USB tile, usb_audio_out_asrc(): send the block, with the rate info if there's any waiting
+        if(host_playing)
+        {
+            unsigned n = pseudo_rand_uint(&seed, 44, 52);
+            asrc_msg_init_header(&tx_msg.hdr, 0);
+            if(usb_side_mailbox.full)
+            {
+                asrc_msg_attach_usb_rate_info(&tx_msg.hdr, &usb_side_mailbox.info);
+                usb_side_mailbox.full = false;
+            }
+            for(unsigned i=0; i<n; i++)
+            {
+                tx_msg.frames[i][0] = block;
+                tx_msg.frames[i][1] = -(int32_t)block;
+            }
+            asrc_msg_send(&usb_to_i2s, &tx_msg.hdr, num_ch, n);
+        }
+
+        // I2S tile, usb_to_i2s_intertile(): pass the rate info to the rate server and play the audio
+        while(loopback_pending(&usb_to_i2s_loopback))
+        {
+            xassert(asrc_msg_recv(&usb_to_i2s, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+            if(rx_msg.hdr.flags & ASRC_MSG_HAS_USB_RATE_INFO)
+            {
+                rate_server_mailbox.info = rx_msg.hdr.usb_rate_info;
+                rate_server_mailbox.full = true;
+            }
+            for(unsigned i=0; i<num_frames; i++)
+            {
+                xassert((rx_msg.frames[i][0] == block) && (rx_msg.frames[i][1] == -(int32_t)block));
+            }
+        }
+
+        // I2S tile, rate_server()
+        if(rate_server_mailbox.full)
+        {
+            rate_server_mailbox.full = false;
+            i2s_side_mailbox.info.usb_to_i2s_rate_ratio = ASRC_BYPASS_RATIO_ONE + rate_server_mailbox.info.buffer_based_correction;
+            i2s_side_mailbox.full = true;
+        }
+
+        // I2S tile, i2s_audio_recv_task(): one message per block, carrying the nominal rate and the ratio if there's a new one
+        unsigned n = pseudo_rand_uint(&seed, 44, 52);
+        asrc_msg_init_header(&tx_msg.hdr, 48000);
+        if(i2s_side_mailbox.full)
+        {
+            asrc_msg_attach_i2s_rate_info(&tx_msg.hdr, &i2s_side_mailbox.info);
+            i2s_side_mailbox.full = false;
+        }
+        asrc_msg_send(&i2s_to_usb, &tx_msg.hdr, num_ch, n);
+
+        // USB tile, i2s_to_usb_intertile()
+        xassert(loopback_pending(&i2s_to_usb_loopback) == 1);
+        xassert(asrc_msg_recv(&i2s_to_usb, &rx_msg.hdr, sizeof(rx_msg), num_ch, &num_frames));
+        xassert((num_frames == n) && (rx_msg.hdr.i2s_nominal_rate == 48000));
+        if(rx_msg.hdr.flags & ASRC_MSG_HAS_I2S_RATE_INFO)
+        {
+            usb_tile_ratio = rx_msg.hdr.i2s_rate_info.usb_to_i2s_rate_ratio;
+        }
+
+        // Rate info handed over in this block has made it there and back
+        if(block - last_trigger_block >= 1)
+        {
+            xassert(usb_tile_ratio == (uint64_t)(ASRC_BYPASS_RATIO_ONE + last_trigger_id));
+        }
+    }
+
+    // Each rate update used to take a request and a reply message of its own, with the USB tile blocked in between, and
+    // the nominal I2S rate went in a message of its own ahead of every I2S -> USB block
+    unsigned num_msgs = usb_to_i2s_loopback.num_sent + i2s_to_usb_loopback.num_sent;
+    unsigned num_msgs_before = (num_blocks / 2) + (2 * num_blocks) + (2 * num_triggers);
+    if(verbose)
+    {
+        printf("asrc_intertile_msg: %u blocks, %u rate updates. %u messages, %u before. USB tile waits for the I2S tile %u times, %u before\n",
+               num_blocks, num_triggers, num_msgs, num_msgs_before, 0, num_triggers);
+    }
+    xassert(i2s_to_usb_loopback.num_sent == num_blocks);
+    xassert(num_msgs == (num_blocks / 2) + num_blocks + (num_triggers / 2));
+}
+
+// Mantissas and exponents at the ends of their ranges, and mantissas with every bit or alternate bits set
+void test_div_edge_cases(unsigned seed, bool verbose)
+{
+    const uint32_t mants[] = {1, 2, 3, 0x55555555, 0x7fffffff, 0x80000000, 0x80000001, 0xaaaaaaaa, 0xfffffffe, 0xffffffff};
+    const int32_t exps[] = {-16, -1, 0, 1, 16};
+    const int num_mants = sizeof(mants) / sizeof(mants[0]);
+    const int num_exps = sizeof(exps) / sizeof(exps[0]);
+    const double thresh = ldexp(1, -31);
+    (void) seed;
+
+    for(int itt=0; itt<num_mants * num_mants * num_exps * num_exps; itt++)
+    {
+        float_s32_t dividend = {(int32_t)mants[itt % num_mants], exps[(itt / num_mants) % num_exps]};
+        float_s32_t divisor = {(int32_t)mants[(itt / (num_mants * num_exps)) % num_mants], exps[itt / (num_mants * num_mants * num_exps)]};
+
+        // reference
+        double ref = ldexp((unsigned)dividend.mant, dividend.exp) / ldexp((unsigned)divisor.mant, divisor.exp);
+
+        float_s32_t res = float_div(dividend, divisor);
+        double dut = ldexp((unsigned)res.mant, res.exp);
+        double rel_error = fabs((ref - dut) / ref);
+
+        int32_t output_q_format = -f64_to_float_s32(ref).exp;
+        double dut_fixed = ldexp(float_div_u64_fixed_output_q_format(dividend, divisor, output_q_format), -output_q_format);
+        double rel_error_fixed = fabs((ref - dut_fixed) / ref);
+
+        if(verbose)
+        {
+            printf("div_edge_cases: itt %d: ref = %.15e, float_div rel_error = %.3e, fixed rel_error = %.3e\n", itt, ref, rel_error, rel_error_fixed);
+        }
+
+        if((rel_error > thresh) || (rel_error_fixed > thresh))
+        {
+            printf("FAIL, test_div_edge_cases(): itt %d: (%u, %d) / (%u, %d): ref = %.15e, dut = %.15e, dut fixed = %.15e\n", itt,
+                   (unsigned)dividend.mant, dividend.exp, (unsigned)divisor.mant, divisor.exp, ref, dut, dut_fixed);
+            xassert(0);
+        }
+    }
+}
+
+// Relative error of a rate from reducing each of its counts to 32 bits, as rate_ratio_fixed_output_q_format() does
+static double count_reduction_error(uint64_t count)
+{
+    int bits = 0;
+    while((bits < 64) && ((count >> bits) != 0))
+    {
+        bits++;
+    }
+    return (bits <= 32) ? 0.0 : ldexp(1, bits - 32) / (double)count;
+}
+
+static double rate_reduction_error(rate_info_t rate)
+{
+    return count_reduction_error(rate.samples) + count_reduction_error(rate.ticks);
+}
+
+void test_rate_ratio_edge_cases(unsigned seed, bool verbose)
+{
+    const uint32_t nominal_rates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+    const int num_rates = sizeof(nominal_rates) / sizeof(nominal_rates[0]);
+    const int32_t output_q_format = 28+32;
+
+    // Nominal rate pairs, as on a rate switch. The ratios of equal rates, and of rates a power of two apart, are exact
+    for(int i=0; i<num_rates; i++)
+    {
+        for(int j=0; j<num_rates; j++)
+        {
+            rate_info_t in = {nominal_rates[i], 1};
+            rate_info_t out = {nominal_rates[j], 1};
+            uint64_t res = rate_ratio_fixed_output_q_format(in, out, output_q_format);
+            double ref = (double)nominal_rates[i] / nominal_rates[j];
+            int exp;
+            bool exact = frexp(ref, &exp) == 0.5;
+            double rel_error = fabs((ref - ldexp(res, -output_q_format)) / ref);
+
+            if((exact && (res != (uint64_t)ldexp(ref, output_q_format))) || (rel_error > ldexp(1, -50)))
+            {
+                printf("FAIL, test_rate_ratio_edge_cases(): %u / %u: dut = 0x%llx, ref = %.15f, rel_error = %.3e\n",
+                       (unsigned)nominal_rates[i], (unsigned)nominal_rates[j], (unsigned long long)res, ref, rel_error);
+                xassert(0);
+            }
+        }
+    }
+
+    // Nothing counted yet in either rate
+    rate_info_t nominal = {48000, 1};
+    rate_info_t empty[] = {{0, 0}, {0, 100000000}, {48000, 0}};
+    for(int i=0; i<3; i++)
+    {
+        xassert(rate_ratio_fixed_output_q_format(empty[i], nominal, output_q_format) == 0);
+        xassert(rate_ratio_fixed_output_q_format(nominal, empty[i], output_q_format) == 0);
+    }
+
+    // Rates counted over windows far longer than the ones the application uses, up to hours of 100MHz ticks. Reducing the
+    // tick counts to 32 bits is the only loss of precision beyond the final rounding.
+    for(int itt=0; itt<(1<<10); itt++)
+    {
+        int ticks_bits = pseudo_rand_int(&seed, 24, 41);
+        uint64_t ticks_num = ((uint64_t)pseudo_rand_uint32(&seed) << 32 | pseudo_rand_uint32(&seed)) >> (64 - ticks_bits);
+        uint64_t ticks_den = ((uint64_t)pseudo_rand_uint32(&seed) << 32 | pseudo_rand_uint32(&seed)) >> (64 - ticks_bits);
+        ticks_num |= (uint64_t)1 << (ticks_bits - 1);
+        ticks_den |= (uint64_t)1 << (ticks_bits - 1);
+        rate_info_t numerator = {(uint64_t)((double)ticks_num * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_num};
+        rate_info_t denominator = {(uint64_t)((double)ticks_den * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_den};
+
+        // reference
+        double ref = ((double)numerator.samples / numerator.ticks) / ((double)denominator.samples / denominator.ticks);
+        double thresh = rate_reduction_error(numerator) + rate_reduction_error(denominator) + ldexp(1, -50);
+
+        uint64_t res = rate_ratio_fixed_output_q_format(numerator, denominator, output_q_format);
+        double dut = ldexp(res, -output_q_format);
+        double rel_error = fabs((ref - dut) / ref);
+
+        if(verbose)
+        {
+            printf("rate_ratio_edge_cases: itt %d: %d bit ticks, dut = %.15f. ref = %.15f, rel_error = %.3e, thresh = %.3e\n", itt, ticks_bits, dut, ref, rel_error, thresh);
+        }
+
+        if(rel_error > thresh)
+        {
+            printf("FAIL, test_rate_ratio_edge_cases(): itt %d: %d bit ticks, dut = %.15f. ref = %.15f, rel_error = %.3e, thresh = %.3e\n", itt, ticks_bits, dut, ref, rel_error, thresh);
+            xassert(0);
+        }
+    }
+}
+
+// SNR of a tone resampled with the ratio from rate_ratio_fixed_output_q_format(), against the same tone resampled with
+// the exact ratio. An error in the ratio shows as a phase drift that grows over the output, so the SNR is measured over
+// seconds of output, and must meet the 120dB that run.sh requires of the simulator's ASRC output.
+void test_rate_ratio_snr(unsigned seed, bool verbose)
+{
+    const int num_samples = 1 << 17;
+    const double tone = 2 * M_PI * 1000 / 48000;   // 1KHz at the nominal input rate, in radians per input sample
+    const int32_t output_q_format = 28+32;
+
+    for(int itt=0; itt<8; itt++)
+    {
+        // Windows of up to 32 bits of 100MHz ticks, 42 seconds, which covers the application's 16 second windows with
+        // no loss of precision in the counts
+        int ticks_bits = pseudo_rand_int(&seed, 24, 33);
+        uint64_t ticks_num = (((uint64_t)pseudo_rand_uint32(&seed) << 32 | pseudo_rand_uint32(&seed)) >> (64 - ticks_bits)) | ((uint64_t)1 << (ticks_bits - 1));
+        uint64_t ticks_den = (((uint64_t)pseudo_rand_uint32(&seed) << 32 | pseudo_rand_uint32(&seed)) >> (64 - ticks_bits)) | ((uint64_t)1 << (ticks_bits - 1));
+        rate_info_t numerator = {(uint64_t)((double)ticks_num * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_num};
+        rate_info_t denominator = {(uint64_t)((double)ticks_den * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_den};
+
+        double ref = ((double)numerator.samples / numerator.ticks) / ((double)denominator.samples / denominator.ticks);
+        double dut = ldexp(rate_ratio_fixed_output_q_format(numerator, denominator, output_q_format), -output_q_format);
+
+        // Output sample n is at input sample n * ratio
+        double signal = 0, noise = 0;
+        for(int n=0; n<num_samples; n++)
+        {
+            double x_ref = sin(tone * n * ref);
+            double x_dut = sin(tone * n * dut);
+            signal += x_ref * x_ref;
+            noise += (x_ref - x_dut) * (x_ref - x_dut);
+        }
+        double snr = (noise > 0) ? 10 * log10(signal / noise) : INFINITY;
+
+        if(verbose)
+        {
+            printf("rate_ratio_snr: itt %d: %d bit ticks, ratio = %.15f, SNR = %.1f dB\n", itt, ticks_bits, ref, snr);
+        }
+
+        if(snr < 120)
+        {
+            printf("FAIL, test_rate_ratio_snr(): itt %d: %d bit ticks, dut = %.15f, ref = %.15f, SNR = %.1f dB\n", itt, ticks_bits, dut, ref, snr);
+            xassert(0);
+        }
+    }
+}
+
+// Double precision model of the windowed buffer level average
+typedef struct
+{
+    double sum;
+    int count;
+    bool first_done;
+    double avg;
+    int stable_count;
+    bool stable;
+    double stable_level;
+}avg_buffer_level_model_t;
+
+static void avg_buffer_level_model_update(avg_buffer_level_model_t *model, int window_len_log2, int threshold, int32_t level)
+{
+    model->sum += level;
+    model->count++;
+    if(model->count == (1 << window_len_log2))
+    {
+        // The window average rounds down, and the average with the last window rounds toward zero
+        double avg = floor(model->sum / (1 << window_len_log2));
+        if(model->first_done)
+        {
+            avg = trunc((avg + model->avg) / 2);
+            if(!model->stable && (++model->stable_count > threshold))
+            {
+                model->stable = true;
+                model->stable_level = avg;
+            }
+        }
+        model->avg = avg;
+        model->first_done = true;
+        model->sum = 0;
+        model->count = 0;
+    }
+}
+
+void test_avg_buffer_level(unsigned seed, bool verbose)
+{
+    buffer_calc_state_t state;
+
+    for(int test=0; test<64; test++)
+    {
+        int32_t window_len_log2 = pseudo_rand_int(&seed, 0, 7);
+        int32_t threshold = pseudo_rand_int(&seed, 0, 5);
+        int32_t centre = pseudo_rand_int(&seed, -(1 << 20), (1 << 20));
+        int32_t level = centre;
+        avg_buffer_level_model_t model = {0};
+        unsigned num_resets = 0, num_retargets = 0;
+
+        init_calc_buffer_level_state(&state, window_len_log2, threshold);
+
+        for(int itt=0; itt<(1<<12); itt++)
+        {
+            // The top bits, as the low bits of the generator have short periods
+            uint32_t event = pseudo_rand_uint32(&seed) >> 23;
+            if(event == 0)
+            {
+                // Reset, which drops the level passed with it
+                calc_avg_buffer_level(&state, level, true);
+                memset(&model, 0, sizeof(model));
+                num_resets++;
+            }
+            else if(event == 1)
+            {
+                retarget_avg_buffer_level(&state, level);
+                memset(&model, 0, sizeof(model));
+                model.first_done = model.stable = true;
+                model.avg = model.stable_level = level;
+                num_retargets++;
+            }
+            else
+            {
+                // A random walk around the centre, with the odd level at either end of the range the sums can hold
+                if(event < 16)
+                {
+                    level = (event & 1) ? ((1 << 30) - 1) : -((1 << 30) - 1);
+                }
+                else
+                {
+                    level = centre + ((level - centre) / 2) + pseudo_rand_int(&seed, -64, 65);
+                }
+                calc_avg_buffer_level(&state, level, false);
+                avg_buffer_level_model_update(&model, window_len_log2, threshold, level);
+            }
+
+            if((state.count != model.count) || (state.flag_first_done != model.first_done) ||
+               (state.flag_stable_avg != model.stable) ||
+               (model.first_done && (state.avg_buffer_level != model.avg)) ||
+               (model.stable && (state.stable_avg_level != model.stable_level)))
+            {
+                printf("FAIL, test_avg_buffer_level(): test %d, itt %d, window 2^%d, threshold %d: dut = (%d, %d, %d, %d), ref = (%.0f, %d, %d, %.0f)\n",
+                       test, itt, (int)window_len_log2, (int)threshold, (int)state.avg_buffer_level, state.flag_first_done, state.flag_stable_avg,
+                       (int)state.stable_avg_level, model.avg, model.first_done, model.stable, model.stable_level);
+                xassert(0);
+            }
+        }
+
+        if(verbose)
+        {
+            printf("avg_buffer_level: test %d, window 2^%d, threshold %d, %u resets, %u retargets, average %d\n",
+                   test, (int)window_len_log2, (int)threshold, num_resets, num_retargets, (int)state.avg_buffer_level);
+        }
+    }
+}
+
+// Double precision model of pi_control(), in units of the rate ratio
+typedef struct
+{
+    double kp;
+    double ki;
+    double max_correction;
+    double integral;
+}pi_control_model_t;
+
+static double clamp_double(double x, double limit)
+{
+    return (x > limit) ? limit : ((x < -limit) ? -limit : x);
+}
+
+static double pi_control_model(pi_control_model_t *model, int32_t error)
+{
+    double error_p = model->kp * error;
+    double error_i = model->ki * error;
+    double integral = clamp_double(model->integral + error_i, model->max_correction);
+    double total = error_p + integral;
+    if(((total > model->max_correction) && (error_i > 0)) || ((total < -model->max_correction) && (error_i < 0)))
+    {
+        total = error_p + model->integral;
+    }
+    else
+    {
+        model->integral = integral;
+    }
+    return clamp_double(total, model->max_correction);
+}
+
+void test_pi_control_random(unsigned seed, bool verbose)
+{
+    const int32_t nominal_rates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+    pi_control_state_t state;
+
+    for(int test=0; test<24; test++)
+    {
+        int32_t rate = nominal_rates[test % 6];
+        if(test < 12)
+        {
+            init_i2s_buffer_pi_control_state(&state, rate);
+        }
+        else
+        {
+            init_usb_buffer_pi_control_state(&state, rate);
+        }
+
+        // The gains are Q24 and scaled up by 2**28, and the correction is Q60
+        pi_control_model_t model = {ldexp(state.Kp, -24-28), ldexp(state.Ki, -24-28), ldexp((double)state.max_correction, -60), 0.0};
+
+        int32_t error = 0;
+        unsigned num_saturated = 0;
+
+        for(int itt=0; itt<(1<<12); itt++)
+        {
+            // Mostly a random walk in the error back towards 0, with jumps big enough to saturate the output
+            if((pseudo_rand_uint32(&seed) >> 26) == 0)
+            {
+                error = pseudo_rand_int(&seed, -1000, 1001);
+            }
+            else
+            {
+                error += pseudo_rand_int(&seed, -8, 9) - (error / 16);
+            }
+            int64_t correction = pi_control(&state, true, error);
+            double dut = ldexp((double)correction, -60);
+            double ref = pi_control_model(&model, error);
+            num_saturated += (fabs(ref) == model.max_correction);
+
+            if(fabs(dut - ref) > ldexp(1, -60))
+            {
+                printf("FAIL, test_pi_control_random(): test %d, itt %d, error %d: dut = %.15e, ref = %.15e\n", test, itt, (int)error, dut, ref);
+                xassert(0);
+            }
+        }
+
+        if(verbose)
+        {
+            printf("pi_control_random: test %d, rate %d, %u of %u updates saturated\n", test, (int)rate, num_saturated, 1 << 12);
+        }
+    }
+
+    // The samples to host buffer correction is full scale once the short term average goes beyond the guard band
+    init_usb_buffer_pi_control_state(&state, 48000);
+    int64_t ref = ((int64_t)state.Kp * 10) << 8;
+    xassert(calc_usb_buffer_based_correction(&state, true, 10, false, USB_BUF_CONTROL_GUARD_BAND + 1) != state.max_correction); // Short term average not stable yet
+    xassert(calc_usb_buffer_based_correction(&state, true, 10, true, USB_BUF_CONTROL_GUARD_BAND + 1) == state.max_correction);
+    xassert(calc_usb_buffer_based_correction(&state, true, 10, true, -USB_BUF_CONTROL_GUARD_BAND - 1) == -state.max_correction);
+    for(int32_t level = -USB_BUF_CONTROL_GUARD_BAND; level <= USB_BUF_CONTROL_GUARD_BAND; level += USB_BUF_CONTROL_GUARD_BAND)
+    {
+        // Within the guard band, the PI controller runs, and its integral keeps growing
+        int64_t integral = state.integral;
+        xassert(calc_usb_buffer_based_correction(&state, true, 10, true, level) == ref + integral + (((int64_t)state.Ki * 10) << 8));
+    }
+}
+
+#if X86_BUILD
+#define BENCHMARK_CALLS (1 << 20)
+#define BENCHMARK_NS_PER_TICK (1)
+static uint32_t benchmark_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec);
+}
+#else
+#define BENCHMARK_CALLS (1 << 12)
+#define BENCHMARK_NS_PER_TICK (10) // 100MHz reference clock
+static uint32_t benchmark_time(void)
+{
+    return get_reference_time();
+}
+#endif
+
+#define BENCHMARK_INPUTS (256)
+
+static volatile uint64_t benchmark_sink;
+
+static void benchmark_report(const char *name, uint32_t start)
+{
+    uint32_t elapsed = benchmark_time() - start;
+    printf("benchmark: %-40s %10.1f ns/call\n", name, (double)elapsed * BENCHMARK_NS_PER_TICK / BENCHMARK_CALLS);
+}
+
+// Time each helper over a set of random inputs. Includes the loop and the input lookup, which are the same for every helper.
+void benchmark_helpers(unsigned seed)
+{
+    static float_s32_t dividends[BENCHMARK_INPUTS], divisors[BENCHMARK_INPUTS];
+    static rate_info_t numerators[BENCHMARK_INPUTS], denominators[BENCHMARK_INPUTS];
+    static int32_t levels[BENCHMARK_INPUTS];
+    uint32_t sample_buckets[TEST_NUM_BUCKETS], tick_buckets[TEST_NUM_BUCKETS];
+    rate_window_state_t window_state;
+    buffer_calc_state_t buf_state;
+    pi_control_state_t pi_state;
+    uint32_t start;
+
+    for(int i=0; i<BENCHMARK_INPUTS; i++)
+    {
+        dividends[i] = (float_s32_t){(int32_t)pseudo_rand_uint32(&seed), pseudo_rand_int(&seed, -16, 16)};
+        divisors[i] = (float_s32_t){(int32_t)pseudo_rand_uint32(&seed), pseudo_rand_int(&seed, -16, 16)};
+        uint32_t ticks_num = pseudo_rand_uint(&seed, 1000000, 1600000000);
+        uint32_t ticks_den = pseudo_rand_uint(&seed, 1000000, 1600000000);
+        numerators[i] = (rate_info_t){(uint64_t)((double)ticks_num * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_num};
+        denominators[i] = (rate_info_t){(uint64_t)((double)ticks_den * pseudo_rand_uint(&seed, 44000, 193000) / 100000000), ticks_den};
+        levels[i] = pseudo_rand_int(&seed, -300, 300);
+    }
+
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        float_s32_t res = float_div(dividends[i % BENCHMARK_INPUTS], divisors[i % BENCHMARK_INPUTS]);
+        benchmark_sink += res.mant;
+    }
+    benchmark_report("float_div", start);
+
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        benchmark_sink += float_div_u64_fixed_output_q_format(dividends[i % BENCHMARK_INPUTS], divisors[i % BENCHMARK_INPUTS], 32);
+    }
+    benchmark_report("float_div_u64_fixed_output_q_format", start);
+
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        benchmark_sink += rate_ratio_fixed_output_q_format(numerators[i % BENCHMARK_INPUTS], denominators[i % BENCHMARK_INPUTS], 28+32);
+    }
+    benchmark_report("rate_ratio_fixed_output_q_format", start);
+
+    init_rate_window_state(&window_state, sample_buckets, tick_buckets, TEST_NUM_BUCKETS);
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        rate_window_push_bucket(&window_state, (uint32_t)numerators[i % BENCHMARK_INPUTS].samples, (uint32_t)numerators[i % BENCHMARK_INPUTS].ticks);
+    }
+    benchmark_report("rate_window_push_bucket", start);
+
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        rate_info_t rate = rate_window_get_rate(&window_state, i % BENCHMARK_INPUTS, i);
+        benchmark_sink += rate.samples;
+    }
+    benchmark_report("rate_window_get_rate", start);
+
+    init_calc_buffer_level_state(&buf_state, 4, 2);
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        calc_avg_buffer_level(&buf_state, levels[i % BENCHMARK_INPUTS], false);
+    }
+    benchmark_sink += buf_state.avg_buffer_level;
+    benchmark_report("calc_avg_buffer_level", start);
+
+    init_i2s_buffer_pi_control_state(&pi_state, 48000);
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        benchmark_sink += pi_control(&pi_state, true, levels[i % BENCHMARK_INPUTS]);
+    }
+    benchmark_report("pi_control", start);
+
+    init_usb_buffer_pi_control_state(&pi_state, 48000);
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        benchmark_sink += calc_usb_buffer_based_correction(&pi_state, true, levels[i % BENCHMARK_INPUTS],
+                                                           true, levels[(i + 1) % BENCHMARK_INPUTS]);
+    }
+    benchmark_report("calc_usb_buffer_based_correction", start);
+
+    // The CPU work of the ratio handoff in usb_audio_send(). It used to send the usb_rate_info to the rate server and
+    // wait for the ratio to come back. It now posts the usb_rate_info to a mailbox that the next USB -> I2S block picks
+    // up, and the ratio comes back in an I2S -> USB block header. Neither time includes the intertile transfers or the
+    // rate server getting a core, so they are not the time the USB tile blocks, which only the device shows.
+    asrc_msg_transport_t usb_to_i2s, i2s_to_usb;
+    loopback_t usb_to_i2s_loopback, i2s_to_usb_loopback;
+    test_msg_t msg;
+    unsigned num_frames;
+    usb_rate_info_t usb_rate_info;
+    usb_rate_info_mailbox_t usb_side_mailbox = {0};
+    random_usb_rate_info(&seed, &usb_rate_info);
+    loopback_transport_init(&usb_to_i2s, &usb_to_i2s_loopback);
+    loopback_transport_init(&i2s_to_usb, &i2s_to_usb_loopback);
+    init_i2s_buffer_pi_control_state(&pi_state, 48000);
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        usb_rate_info.samples_to_host_buf_fill_level = levels[i % BENCHMARK_INPUTS];
+        asrc_msg_init_header(&msg.hdr, 0);
+        asrc_msg_attach_usb_rate_info(&msg.hdr, &usb_rate_info);
+        asrc_msg_send(&usb_to_i2s, &msg.hdr, 2, 0);
+
+        // Rate server
+        (void)asrc_msg_recv(&usb_to_i2s, &msg.hdr, sizeof(msg), 2, &num_frames);
+        rate_info_t i2s_rate = rate_window_get_rate(&window_state, i % BENCHMARK_INPUTS, i);
+        i2s_to_usb_rate_info_t i2s_rate_info;
+        i2s_rate_info.usb_to_i2s_rate_ratio = rate_ratio_fixed_output_q_format(numerators[i % BENCHMARK_INPUTS], i2s_rate, 28+32) +
+                                              pi_control(&pi_state, true, msg.hdr.usb_rate_info.samples_to_host_buf_fill_level);
+        asrc_msg_init_header(&msg.hdr, 48000);
+        asrc_msg_attach_i2s_rate_info(&msg.hdr, &i2s_rate_info);
+        asrc_msg_send(&i2s_to_usb, &msg.hdr, 2, 0);
+
+        (void)asrc_msg_recv(&i2s_to_usb, &msg.hdr, sizeof(msg), 2, &num_frames);
+        benchmark_sink += msg.hdr.i2s_rate_info.usb_to_i2s_rate_ratio;
+    }
+    benchmark_report("handoff CPU, request and reply (before)", start);
+
+    start = benchmark_time();
+    for(int i=0; i<BENCHMARK_CALLS; i++)
+    {
+        usb_rate_info.samples_to_host_buf_fill_level = levels[i % BENCHMARK_INPUTS];
+        usb_side_mailbox.info = usb_rate_info;
+        usb_side_mailbox.full = true;
+        benchmark_sink += usb_side_mailbox.info.samples_to_host_buf_fill_level;
+    }
+    benchmark_report("handoff CPU, mailbox post (after)", start);
+}
 
 int main(int argc, char *argv[])
 {
@@ -107,9 +1264,38 @@ int main(int argc, char *argv[])
 
     bool verbose = false;
 
+    // -b also times each helper
+    bool benchmark = (argc > 1) && (strcmp(argv[1], "-b") == 0);
+
     test_float_div(seed, verbose);
 
     test_div_fixed_output_q_format(seed, verbose);
 
+    test_rate_ratio_fixed_output_q_format(seed, verbose);
+
+    test_rate_window(seed, verbose);
+
+    test_pi_control(seed, verbose);
+
+    test_asrc_bypass(seed, verbose);
+
+    test_asrc_xfade(seed, verbose);
+
+    test_asrc_intertile_msg(seed, verbose);
+
+    test_div_edge_cases(seed, verbose);
+
+    test_rate_ratio_edge_cases(seed, verbose);
+
+    test_rate_ratio_snr(seed, verbose);
+
+    test_avg_buffer_level(seed, verbose);
+
+    test_pi_control_random(seed, verbose);
+
+    if(benchmark)
+    {
+        benchmark_helpers(seed);
+    }
 
 }
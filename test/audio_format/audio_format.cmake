@@ -0,0 +1,28 @@
+
+add_executable(test_audio_format
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src/pseudo_rand.c
+)
+
+target_include_directories(test_audio_format
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/src
+        ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src
+)
+
+target_link_libraries(test_audio_format
+    PRIVATE
+        sln_voice::app::audio_format
+)
+
+if(${CMAKE_SYSTEM_NAME} STREQUAL XCORE_XS3A)
+    target_compile_options(test_audio_format
+        PRIVATE "-target=XCORE-AI-EXPLORER")
+
+    target_link_options(test_audio_format
+        PRIVATE
+            "-target=XCORE-AI-EXPLORER"
+            "-report")
+else()
+    target_compile_definitions(test_audio_format PRIVATE X86_BUILD=1)
+endif()
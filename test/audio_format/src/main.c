@@ -0,0 +1,663 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if !X86_BUILD
+    #include <platform.h>
+    #include <xs1.h>
+    #include <xcore/assert.h>
+    #include <xcore/hwtimer.h>
+#else
+    #include <assert.h>
+    #include <time.h>
+    #define xassert assert
+#endif
+#include "pseudo_rand.h"
+#include "audio_format.h"
+#include "audio_gain_ramp.h"
+
+#define MAX_CH          (12)    // Beyond the specialised channel counts, to cover the fallback to the reference
+#define MAX_N           (61)
+#define MAX_STRIDE      (MAX_N + 3)
+#define BUF_WORDS       (MAX_CH * MAX_STRIDE + 4)   // Room for a guard after the largest output
+#define SENTINEL        (0xA5)
+
+#define BENCH_N         (240)
+#define BENCH_REPS      (4)
+
+static const size_t test_n[] = {0, 1, 2, 3, 7, 16, MAX_N};
+static const size_t stride_pad[] = {0, 1, 3};
+static const audio_format_width_t widths[] = {AUDIO_FORMAT_S16, AUDIO_FORMAT_S24, AUDIO_FORMAT_S32};
+static const unsigned frac_bits_list[] = {0, 16, 29, 31};
+
+static int32_t src[BUF_WORDS];
+static int32_t dut_out[BUF_WORDS];
+static int32_t ref_out[BUF_WORDS];
+static int32_t tmp[BUF_WORDS];
+
+/*
+ * Models written independently of the implementation. Packing keeps the
+ * most significant bytes of the little endian int32_t.
+ */
+static void model_store(void *dst, size_t index, audio_format_width_t width, int32_t samp)
+{
+    memcpy((uint8_t *)dst + index * width, (uint8_t *)&samp + (4 - width), width);
+}
+
+static int32_t model_load(const void *src, size_t index, audio_format_width_t width)
+{
+    int32_t samp = 0;
+    memcpy((uint8_t *)&samp + (4 - width), (const uint8_t *)src + index * width, width);
+    return samp;
+}
+
+static int32_t model_truncate(int32_t samp, audio_format_width_t width)
+{
+    uint8_t packed[4];
+    model_store(packed, 0, width, samp);
+    return model_load(packed, 0, width);
+}
+
+static int32_t model_gain(int32_t samp, uint32_t gain, unsigned frac_bits)
+{
+    int64_t prod = (int64_t)samp * gain;
+    int64_t div = (int64_t)1 << frac_bits;
+    int64_t q = prod / div;
+    if ((prod % div != 0) && (prod < 0)) {
+        q -= 1;     // Round towards minus infinity, like an arithmetic right shift
+    }
+    if (q > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (q < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)q;
+}
+
+static void random_src(unsigned *seed)
+{
+    static const int32_t edges[] = {INT32_MIN, INT32_MAX, 0, -1, 1, 0x7FFF8000, (int32_t)0x80007FFF};
+    for (int i = 0; i < BUF_WORDS; i++) {
+        if (pseudo_rand_uint(seed, 0, 8) == 0) {
+            src[i] = edges[pseudo_rand_uint(seed, 0, sizeof(edges) / sizeof(edges[0]))];
+        } else {
+            src[i] = pseudo_rand_int32(seed);
+        }
+    }
+}
+
+static uint32_t random_gain(unsigned *seed, unsigned frac_bits)
+{
+    uint32_t unity = (uint32_t)1 << frac_bits;
+    switch (pseudo_rand_uint(seed, 0, 8)) {
+    case 0: return 0;
+    case 1: return 1;
+    case 2: return unity - 1;
+    case 3: return unity;
+    case 4: return unity + 1;
+    case 5: return 2 * unity;
+    case 6: return UINT32_MAX;
+    default: return pseudo_rand_uint32(seed) >> pseudo_rand_uint(seed, 0, 32);
+    }
+}
+
+static void clear_outputs(void)
+{
+    memset(dut_out, SENTINEL, sizeof(dut_out));
+    memset(ref_out, SENTINEL, sizeof(ref_out));
+}
+
+static void check_outputs(const char *name, unsigned num_ch, size_t n, int width)
+{
+    if (memcmp(dut_out, ref_out, sizeof(dut_out)) != 0) {
+        printf("FAIL, %s: num_ch %u, n %u, width %d differs from the reference\n", name, num_ch, (unsigned)n, width);
+        xassert(0);
+    }
+}
+
+void test_interleave(unsigned seed, bool verbose)
+{
+    for (unsigned num_ch = 1; num_ch <= MAX_CH; num_ch++) {
+        for (int t = 0; t < sizeof(test_n) / sizeof(test_n[0]); t++) {
+            for (int p = 0; p < sizeof(stride_pad) / sizeof(stride_pad[0]); p++) {
+                size_t n = test_n[t];
+                size_t stride = n + stride_pad[p];
+                random_src(&seed);
+                clear_outputs();
+                audio_format_interleave(dut_out, src, stride, num_ch, n);
+                audio_format_interleave_ref(ref_out, src, stride, num_ch, n);
+                check_outputs("test_interleave()", num_ch, n, 4);
+
+                for (size_t i = 0; i < n; i++) {
+                    for (unsigned ch = 0; ch < num_ch; ch++) {
+                        xassert(dut_out[i * num_ch + ch] == src[ch * stride + i]);
+                    }
+                }
+            }
+        }
+    }
+    if (verbose) {
+        printf("interleave passes\n");
+    }
+}
+
+void test_deinterleave(unsigned seed, bool verbose)
+{
+    for (unsigned num_ch = 1; num_ch <= MAX_CH; num_ch++) {
+        for (int t = 0; t < sizeof(test_n) / sizeof(test_n[0]); t++) {
+            for (int p = 0; p < sizeof(stride_pad) / sizeof(stride_pad[0]); p++) {
+                size_t n = test_n[t];
+                size_t stride = n + stride_pad[p];
+                random_src(&seed);
+                clear_outputs();
+                audio_format_deinterleave(dut_out, stride, src, num_ch, n);
+                audio_format_deinterleave_ref(ref_out, stride, src, num_ch, n);
+                /* This also checks that the gaps between channels are left untouched */
+                check_outputs("test_deinterleave()", num_ch, n, 4);
+
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    for (size_t i = 0; i < n; i++) {
+                        xassert(dut_out[ch * stride + i] == src[i * num_ch + ch]);
+                    }
+                }
+            }
+        }
+    }
+    if (verbose) {
+        printf("deinterleave passes\n");
+    }
+}
+
+void test_pack_unpack(unsigned seed, bool verbose)
+{
+    for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        audio_format_width_t width = widths[w];
+        for (size_t n = 0; n <= MAX_N; n++) {
+            random_src(&seed);
+            clear_outputs();
+            audio_format_pack(dut_out, width, src, n);
+            audio_format_pack_ref(ref_out, width, src, n);
+            check_outputs("test_pack_unpack() pack", 1, n, width);
+            for (size_t i = 0; i < n; i++) {
+                xassert(model_load(dut_out, i, width) == model_truncate(src[i], width));
+            }
+
+            /* Unpacking a packed buffer gives back the input, truncated to the width */
+            memcpy(tmp, dut_out, sizeof(tmp));
+            clear_outputs();
+            audio_format_unpack(dut_out, tmp, width, n);
+            audio_format_unpack_ref(ref_out, tmp, width, n);
+            check_outputs("test_pack_unpack() unpack", 1, n, width);
+            for (size_t i = 0; i < n; i++) {
+                int32_t truncated = (width == 4) ? src[i] : (int32_t)((uint32_t)src[i] & ~((1u << (32 - 8 * width)) - 1));
+                xassert(dut_out[i] == truncated);
+                xassert(dut_out[i] == model_truncate(src[i], width));
+            }
+        }
+    }
+    if (verbose) {
+        printf("pack and unpack pass\n");
+    }
+}
+
+void test_gain(unsigned seed, bool verbose)
+{
+    for (int f = 0; f < sizeof(frac_bits_list) / sizeof(frac_bits_list[0]); f++) {
+        unsigned frac_bits = frac_bits_list[f];
+        for (int test = 0; test < 100; test++) {
+            uint32_t gain = random_gain(&seed, frac_bits);
+            size_t n = pseudo_rand_uint(&seed, 0, MAX_N + 1);
+            random_src(&seed);
+            clear_outputs();
+            audio_format_gain(dut_out, src, n, gain, frac_bits);
+            audio_format_gain_ref(ref_out, src, n, gain, frac_bits);
+            check_outputs("test_gain()", 1, n, 4);
+            for (size_t i = 0; i < n; i++) {
+                int32_t model = model_gain(src[i], gain, frac_bits);
+                if (dut_out[i] != model) {
+                    printf("FAIL, test_gain(): %ld * %lu >> %u: dut = %ld, model = %ld\n", (long)src[i], (unsigned long)gain, frac_bits, (long)dut_out[i], (long)model);
+                    xassert(0);
+                }
+            }
+
+            /* In place */
+            memcpy(tmp, src, sizeof(tmp));
+            audio_format_gain(tmp, tmp, n, gain, frac_bits);
+            xassert(memcmp(tmp, dut_out, n * sizeof(int32_t)) == 0);
+        }
+    }
+
+    /* Bit exact with the USB audio volume_scale() it replaces, for gains up to unity */
+    for (int test = 0; test < 1000; test++) {
+        uint32_t gain = pseudo_rand_uint(&seed, 0, (1 << 29) + 1);
+        int32_t samp = pseudo_rand_int32(&seed);
+        audio_format_gain(dut_out, &samp, 1, gain, 29);
+        xassert(dut_out[0] == (int32_t)(((int64_t)samp * gain) >> 29));
+    }
+    if (verbose) {
+        printf("gain passes\n");
+    }
+}
+
+void test_gain_pack_interleaved(unsigned seed, bool verbose)
+{
+    uint32_t gains[MAX_CH];
+
+    for (unsigned num_ch = 1; num_ch <= MAX_CH; num_ch++) {
+        for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+            for (int t = 0; t < sizeof(test_n) / sizeof(test_n[0]); t++) {
+                audio_format_width_t width = widths[w];
+                size_t n = test_n[t];
+                unsigned frac_bits = frac_bits_list[pseudo_rand_uint(&seed, 0, sizeof(frac_bits_list) / sizeof(frac_bits_list[0]))];
+                bool unity = (pseudo_rand_uint(&seed, 0, 4) == 0);
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    gains[ch] = random_gain(&seed, frac_bits);
+                }
+                random_src(&seed);
+                clear_outputs();
+                audio_format_gain_pack_interleaved(dut_out, width, src, num_ch, n, unity ? NULL : gains, frac_bits);
+                audio_format_gain_pack_interleaved_ref(ref_out, width, src, num_ch, n, unity ? NULL : gains, frac_bits);
+                check_outputs("test_gain_pack_interleaved()", num_ch, n, width);
+
+                for (size_t i = 0; i < n; i++) {
+                    for (unsigned ch = 0; ch < num_ch; ch++) {
+                        int32_t samp = src[i * num_ch + ch];
+                        if (!unity) {
+                            samp = model_gain(samp, gains[ch], frac_bits);
+                        }
+                        xassert(model_load(dut_out, i * num_ch + ch, width) == model_truncate(samp, width));
+                    }
+                }
+            }
+        }
+    }
+    if (verbose) {
+        printf("gain, pack and interleave passes\n");
+    }
+}
+
+void test_unpack_deinterleave_gain(unsigned seed, bool verbose)
+{
+    uint32_t gains[MAX_CH];
+
+    for (unsigned num_ch = 1; num_ch <= MAX_CH; num_ch++) {
+        for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+            for (int t = 0; t < sizeof(test_n) / sizeof(test_n[0]); t++) {
+                audio_format_width_t width = widths[w];
+                size_t n = test_n[t];
+                size_t stride = n + stride_pad[pseudo_rand_uint(&seed, 0, sizeof(stride_pad) / sizeof(stride_pad[0]))];
+                unsigned frac_bits = frac_bits_list[pseudo_rand_uint(&seed, 0, sizeof(frac_bits_list) / sizeof(frac_bits_list[0]))];
+                bool unity = (pseudo_rand_uint(&seed, 0, 4) == 0);
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    gains[ch] = random_gain(&seed, frac_bits);
+                }
+                random_src(&seed);
+                clear_outputs();
+                audio_format_unpack_deinterleave_gain(dut_out, stride, src, width, num_ch, n, unity ? NULL : gains, frac_bits);
+                audio_format_unpack_deinterleave_gain_ref(ref_out, stride, src, width, num_ch, n, unity ? NULL : gains, frac_bits);
+                check_outputs("test_unpack_deinterleave_gain()", num_ch, n, width);
+
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    for (size_t i = 0; i < n; i++) {
+                        int32_t samp = model_load(src, i * num_ch + ch, width);
+                        if (!unity) {
+                            samp = model_gain(samp, gains[ch], frac_bits);
+                        }
+                        xassert(dut_out[ch * stride + i] == samp);
+                    }
+                }
+            }
+        }
+    }
+    if (verbose) {
+        printf("unpack, deinterleave and gain passes\n");
+    }
+}
+
+void test_deinterleave_pack(unsigned seed, bool verbose)
+{
+    for (unsigned num_ch = 1; num_ch <= MAX_CH; num_ch++) {
+        for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+            for (int t = 0; t < sizeof(test_n) / sizeof(test_n[0]); t++) {
+                audio_format_width_t width = widths[w];
+                size_t n = test_n[t];
+                size_t stride = n + stride_pad[pseudo_rand_uint(&seed, 0, sizeof(stride_pad) / sizeof(stride_pad[0]))];
+                random_src(&seed);
+                clear_outputs();
+                audio_format_deinterleave_pack(dut_out, stride, width, src, num_ch, n);
+                audio_format_deinterleave_pack_ref(ref_out, stride, width, src, num_ch, n);
+                check_outputs("test_deinterleave_pack()", num_ch, n, width);
+
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    for (size_t i = 0; i < n; i++) {
+                        xassert(model_load(dut_out, ch * stride + i, width) == model_truncate(src[i * num_ch + ch], width));
+                    }
+                }
+            }
+        }
+    }
+    if (verbose) {
+        printf("deinterleave and pack passes\n");
+    }
+}
+
+#define RAMP_FRAC_BITS  (29)    // As used for the USB volume
+#define RAMP_UNITY      ((uint32_t)1 << RAMP_FRAC_BITS)
+
+static void random_gains(unsigned *seed, uint32_t *gains, unsigned num_ch)
+{
+    for (unsigned ch = 0; ch < num_ch; ch++) {
+        gains[ch] = pseudo_rand_uint(seed, 0, RAMP_UNITY + 1);
+    }
+}
+
+void test_gain_ramp_steady(unsigned seed, bool verbose)
+{
+    audio_gain_ramp_t ramp;
+    uint32_t gains[AUDIO_GAIN_RAMP_MAX_CH];
+
+    for (unsigned num_ch = 1; num_ch <= AUDIO_GAIN_RAMP_MAX_CH; num_ch++) {
+        random_gains(&seed, gains, num_ch);
+        audio_gain_ramp_init(&ramp, num_ch, 240, RAMP_FRAC_BITS, gains);
+        for (int test = 0; test < 10; test++) {
+            audio_format_width_t width = widths[pseudo_rand_uint(&seed, 0, 3)];
+            size_t n = pseudo_rand_uint(&seed, 0, (MAX_CH * MAX_STRIDE) / AUDIO_GAIN_RAMP_MAX_CH);
+            random_src(&seed);
+
+            /* Setting the same targets again doesn't start a ramp */
+            audio_gain_ramp_set_targets(&ramp, gains);
+            xassert(!audio_gain_ramp_active(&ramp));
+
+            clear_outputs();
+            audio_gain_ramp_pack_interleaved(&ramp, dut_out, width, src, n);
+            audio_format_gain_pack_interleaved(ref_out, width, src, num_ch, n, gains, RAMP_FRAC_BITS);
+            check_outputs("test_gain_ramp_steady() pack", num_ch, n, width);
+
+            /* The same as the per sample volume_scale() math it replaces */
+            if (width == AUDIO_FORMAT_S32) {
+                for (size_t i = 0; i < n * num_ch; i++) {
+                    xassert(dut_out[i] == (int32_t)(((int64_t)src[i] * gains[i % num_ch]) >> RAMP_FRAC_BITS));
+                }
+            }
+
+            clear_outputs();
+            audio_gain_ramp_unpack_deinterleave(&ramp, dut_out, n, src, width, n);
+            audio_format_unpack_deinterleave_gain(ref_out, n, src, width, num_ch, n, gains, RAMP_FRAC_BITS);
+            check_outputs("test_gain_ramp_steady() unpack", num_ch, n, width);
+        }
+    }
+    if (verbose) {
+        printf("steady gain ramp passes\n");
+    }
+}
+
+/*
+ * Runs a constant full scale input through a ramp in randomly sized blocks
+ * and checks the gain trajectory it reveals.
+ */
+void test_gain_ramp_length(unsigned seed, bool verbose)
+{
+    audio_gain_ramp_t ramp;
+    uint32_t from[AUDIO_GAIN_RAMP_MAX_CH];
+    uint32_t to[AUDIO_GAIN_RAMP_MAX_CH];
+    static int32_t trajectory[AUDIO_GAIN_RAMP_MAX_CH][1024];
+    const int32_t input = INT32_MAX;
+
+    for (int test = 0; test < 50; test++) {
+        unsigned num_ch = pseudo_rand_uint(&seed, 1, AUDIO_GAIN_RAMP_MAX_CH + 1);
+        unsigned ramp_length = pseudo_rand_uint(&seed, 1, 512);
+        bool deinterleaved = pseudo_rand_uint(&seed, 0, 2);
+        random_gains(&seed, from, num_ch);
+        random_gains(&seed, to, num_ch);
+        to[0] = (from[0] < RAMP_UNITY / 2) ? RAMP_UNITY : 0;    /* At least one channel changes by a lot */
+
+        audio_gain_ramp_init(&ramp, num_ch, ramp_length, RAMP_FRAC_BITS, from);
+        audio_gain_ramp_set_targets(&ramp, to);
+        xassert(audio_gain_ramp_active(&ramp));
+
+        size_t total = 0;
+        while (total < ramp_length + 16) {
+            size_t n = pseudo_rand_uint(&seed, 1, 64);
+            for (size_t i = 0; i < n * num_ch; i++) {
+                src[i] = input;
+            }
+            if (deinterleaved) {
+                audio_gain_ramp_unpack_deinterleave(&ramp, dut_out, n, src, AUDIO_FORMAT_S32, n);
+                for (unsigned ch = 0; ch < num_ch; ch++) {
+                    memcpy(&trajectory[ch][total], &dut_out[ch * n], n * sizeof(int32_t));
+                }
+            } else {
+                audio_gain_ramp_pack_interleaved(&ramp, dut_out, AUDIO_FORMAT_S32, src, n);
+                for (size_t i = 0; i < n; i++) {
+                    for (unsigned ch = 0; ch < num_ch; ch++) {
+                        trajectory[ch][total + i] = dut_out[i * num_ch + ch];
+                    }
+                }
+            }
+            total += n;
+            /* Active until exactly ramp_length samples have gone through */
+            xassert(audio_gain_ramp_active(&ramp) == (total < ramp_length));
+        }
+
+        for (unsigned ch = 0; ch < num_ch; ch++) {
+            int32_t start = (int32_t)(((int64_t)input * from[ch]) >> RAMP_FRAC_BITS);
+            int32_t end = (int32_t)(((int64_t)input * to[ch]) >> RAMP_FRAC_BITS);
+            int32_t lo = (start < end) ? start : end;
+            int32_t hi = (start < end) ? end : start;
+            int64_t max_step = ((int64_t)hi - lo) / ramp_length + 8;   /* Plus the rounding of the gain to frac_bits */
+
+            int32_t prev = start;
+            for (size_t i = 0; i < total; i++) {
+                int32_t out = trajectory[ch][i];
+                /* Bounded by the start and end levels, and monotonic */
+                xassert((out >= lo) && (out <= hi));
+                xassert((start <= end) ? (out >= prev) : (out <= prev));
+                /* No step bigger than an even share of the change */
+                if (llabs((int64_t)out - prev) > max_step) {
+                    printf("FAIL, test_gain_ramp_length(): test %d, ch %u, sample %u: step %lld, max %lld\n", test, ch, (unsigned)i, (long long)out - prev, (long long)max_step);
+                    xassert(0);
+                }
+                /* Reaches the target on the last sample of the ramp, and stays there */
+                if (i >= ramp_length - 1) {
+                    xassert(out == end);
+                }
+                prev = out;
+            }
+        }
+        /* Channel 0 is still short of its target one sample before the end of the ramp */
+        if (ramp_length > 1) {
+            int32_t end = (int32_t)(((int64_t)input * to[0]) >> RAMP_FRAC_BITS);
+            xassert(trajectory[0][ramp_length - 2] != end);
+        }
+    }
+    if (verbose) {
+        printf("gain ramp length passes\n");
+    }
+}
+
+void test_gain_ramp_retarget(unsigned seed, bool verbose)
+{
+    audio_gain_ramp_t ramp;
+    uint32_t gains[AUDIO_GAIN_RAMP_MAX_CH];
+    const unsigned num_ch = 2;
+    const unsigned ramp_length = 240;
+
+    /* A new target part way through a ramp restarts it from the current gain, without a step */
+    gains[0] = 0;
+    gains[1] = RAMP_UNITY;
+    audio_gain_ramp_init(&ramp, num_ch, ramp_length, RAMP_FRAC_BITS, gains);
+    gains[0] = RAMP_UNITY;
+    gains[1] = 0;
+    audio_gain_ramp_set_targets(&ramp, gains);
+
+    int32_t prev[2] = {0, INT32_MAX - 1};
+    for (int block = 0; block < 20; block++) {
+        size_t n = 32;
+        for (size_t i = 0; i < n * num_ch; i++) {
+            src[i] = INT32_MAX;
+        }
+        audio_gain_ramp_pack_interleaved(&ramp, dut_out, AUDIO_FORMAT_S32, src, n);
+        for (size_t i = 0; i < n; i++) {
+            for (unsigned ch = 0; ch < num_ch; ch++) {
+                int32_t out = dut_out[i * num_ch + ch];
+                xassert(llabs((int64_t)out - prev[ch]) <= ((int64_t)INT32_MAX / ramp_length) + 8);
+                prev[ch] = out;
+            }
+        }
+        if (block == 3) {
+            /* Reverse both channels mid-ramp */
+            gains[0] = RAMP_UNITY / 4;
+            gains[1] = RAMP_UNITY;
+            audio_gain_ramp_set_targets(&ramp, gains);
+        }
+    }
+    xassert(!audio_gain_ramp_active(&ramp));
+    xassert(ramp.gain[0] == RAMP_UNITY / 4);
+    xassert(ramp.gain[1] == RAMP_UNITY);
+
+    /* With a 0 ramp length, changes apply straight away */
+    audio_gain_ramp_init(&ramp, num_ch, 0, RAMP_FRAC_BITS, gains);
+    random_gains(&seed, gains, num_ch);
+    audio_gain_ramp_set_targets(&ramp, gains);
+    xassert(!audio_gain_ramp_active(&ramp));
+    xassert((ramp.gain[0] == gains[0]) && (ramp.gain[1] == gains[1]));
+
+    /* Gains above unity saturate rather than wrap */
+    gains[0] = 4 * RAMP_UNITY;
+    gains[1] = 4 * RAMP_UNITY;
+    audio_gain_ramp_init(&ramp, num_ch, ramp_length, RAMP_FRAC_BITS, gains);
+    gains[1] = 8 * RAMP_UNITY;
+    audio_gain_ramp_set_targets(&ramp, gains);
+    src[0] = INT32_MIN;
+    src[1] = INT32_MAX / 2 + 1;
+    audio_gain_ramp_pack_interleaved(&ramp, dut_out, AUDIO_FORMAT_S32, src, 1);
+    xassert((dut_out[0] == INT32_MIN) && (dut_out[1] == INT32_MAX));
+
+    if (verbose) {
+        printf("gain ramp retarget passes\n");
+    }
+}
+
+/*
+ * Benchmark table, in time per sample (one channel of one frame) x 100,
+ * for the reference and the specialised implementations. On xcore the time
+ * is in 100MHz reference clock ticks, on x86 in ns.
+ */
+#if !X86_BUILD
+static inline uint32_t bench_time(void) { return get_reference_time(); }
+#define BENCH_UNIT "ticks"
+#else
+static inline uint32_t bench_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+#define BENCH_UNIT "ns"
+#endif
+
+typedef enum {
+    BENCH_INTERLEAVE,
+    BENCH_DEINTERLEAVE,
+    BENCH_GAIN_PACK_INTERLEAVED,
+    BENCH_UNPACK_DEINTERLEAVE_GAIN,
+    BENCH_DEINTERLEAVE_PACK,
+    BENCH_NUM_KERNELS
+} bench_kernel_t;
+
+static const char *bench_names[BENCH_NUM_KERNELS] = {
+    "interleave",
+    "deinterleave",
+    "gain_pack_interleaved",
+    "unpack_deinterleave_gain",
+    "deinterleave_pack",
+};
+
+static uint32_t bench_run(bench_kernel_t kernel, bool ref, unsigned num_ch, audio_format_width_t width)
+{
+    static int32_t bench_in[8 * BENCH_N];
+    static int32_t bench_out[8 * BENCH_N];
+    static const uint32_t gains[8] = {1 << 28, 1 << 28, 1 << 28, 1 << 28, 1 << 28, 1 << 28, 1 << 28, 1 << 28};
+
+    uint32_t start = bench_time();
+    for (int rep = 0; rep < BENCH_REPS; rep++) {
+        switch (kernel) {
+        case BENCH_INTERLEAVE:
+            (ref ? audio_format_interleave_ref : audio_format_interleave)(bench_out, bench_in, BENCH_N, num_ch, BENCH_N);
+            break;
+        case BENCH_DEINTERLEAVE:
+            (ref ? audio_format_deinterleave_ref : audio_format_deinterleave)(bench_out, BENCH_N, bench_in, num_ch, BENCH_N);
+            break;
+        case BENCH_GAIN_PACK_INTERLEAVED:
+            (ref ? audio_format_gain_pack_interleaved_ref : audio_format_gain_pack_interleaved)(bench_out, width, bench_in, num_ch, BENCH_N, gains, 29);
+            break;
+        case BENCH_UNPACK_DEINTERLEAVE_GAIN:
+            (ref ? audio_format_unpack_deinterleave_gain_ref : audio_format_unpack_deinterleave_gain)(bench_out, BENCH_N, bench_in, width, num_ch, BENCH_N, gains, 29);
+            break;
+        default:
+            (ref ? audio_format_deinterleave_pack_ref : audio_format_deinterleave_pack)(bench_out, BENCH_N, width, bench_in, num_ch, BENCH_N);
+            break;
+        }
+    }
+    uint32_t elapsed = bench_time() - start;
+    return (uint32_t)(((uint64_t)elapsed * 100) / (BENCH_REPS * BENCH_N * num_ch));
+}
+
+void benchmark(void)
+{
+    printf("%-26s %3s %6s %10s %10s   (" BENCH_UNIT " per sample x100)\n", "kernel", "ch", "width", "reference", "optimised");
+    for (int k = 0; k < BENCH_NUM_KERNELS; k++) {
+        bool has_width = (k != BENCH_INTERLEAVE) && (k != BENCH_DEINTERLEAVE);
+        for (unsigned num_ch = 2; num_ch <= 8; num_ch += 2) {
+            for (int w = 0; w < (has_width ? 3 : 1); w++) {
+                audio_format_width_t width = has_width ? widths[w] : AUDIO_FORMAT_S32;
+                uint32_t ref_time = bench_run(k, true, num_ch, width);
+                uint32_t opt_time = bench_run(k, false, num_ch, width);
+                printf("%-26s %3u %6d %10lu %10lu\n", bench_names[k], num_ch, 8 * (int)width, (unsigned long)ref_time, (unsigned long)opt_time);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned seed = 13579;
+
+    bool verbose = false;
+
+    test_interleave(seed, verbose);
+
+    test_deinterleave(seed, verbose);
+
+    test_pack_unpack(seed, verbose);
+
+    test_gain(seed, verbose);
+
+    test_gain_pack_interleaved(seed, verbose);
+
+    test_unpack_deinterleave_gain(seed, verbose);
+
+    test_deinterleave_pack(seed, verbose);
+
+    test_gain_ramp_steady(seed, verbose);
+
+    test_gain_ramp_length(seed, verbose);
+
+    test_gain_ramp_retarget(seed, verbose);
+
+#if !X86_BUILD
+    benchmark();
+#else
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) {
+        benchmark();
+    }
+#endif
+
+    printf("PASS\n");
+    return 0;
+}
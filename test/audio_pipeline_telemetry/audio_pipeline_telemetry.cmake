@@ -0,0 +1,28 @@
+
+# Host only test of the live audio pipeline telemetry: the counters and levels measured from known inputs through
+# stand-in stages, consistent reads while the telemetry is updated, and the FFVA telemetry servicer's commands
+find_package(Threads REQUIRED)
+
+add_executable(test_audio_pipeline_telemetry
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference/audio_pipeline_seqlock.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference/audio_pipeline_telemetry.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/telemetry/telemetry_servicer.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control/servicer.c
+)
+
+target_include_directories(test_audio_pipeline_telemetry
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/../ffva_dfu/src/host
+        ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/telemetry
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/tuning
+)
+
+target_link_libraries(test_audio_pipeline_telemetry
+    PRIVATE
+        Threads::Threads
+        m
+)
@@ -0,0 +1,705 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "servicer.h"
+#include "telemetry_servicer.h"
+#include "telemetry_cmds.h"
+#include "audio_pipeline_telemetry.h"
+#include "platform/platform_conf.h"
+
+#define appconfAUDIO_PIPELINE_FRAME_ADVANCE     (240)
+#define SAMPLE_RATE                             (16000)
+#define FRAME_TICKS     AUDIO_PIPELINE_TELEMETRY_FRAME_TICKS(appconfAUDIO_PIPELINE_FRAME_ADVANCE, SAMPLE_RATE)
+
+#define ECHO_FRAMES         (400)
+#define SILENT_REF_FRAMES   (50)
+#define CHECKPOINT_FRAMES   (25)
+#define DROP_FRAMES         (2000)
+#define CONCURRENT_UPDATES  (100000)
+
+#define SMOOTHING           (0.125)     // As the telemetry smooths
+#define AEC_TAPS            (16)
+#define AEC_MU              (0.002)
+#define MIC_DELAY_SAMPLES   (37)
+#define IC_SCALE            (0.5)
+#define NS_SCALE            (0.25)
+#define AGC_GAIN            (2.0f)
+#define VNR_INPUT           (0.25f)
+#define VNR_OUTPUT          (0.75f)
+
+/* The reference pipelines' frame, reduced to what the telemetry and the stand-in stages use */
+typedef struct {
+    uint32_t index;
+    int32_t samples[2][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+    int32_t aec_reference_audio_samples[2][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+    int32_t mic_samples_passthrough[2][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+    audio_pipeline_telemetry_frame_t telemetry;
+} frame_data_t;
+
+/* Expected telemetry, kept in double precision from the same frame records */
+typedef struct {
+    unsigned frames;
+    double erle_mic_energy;
+    double erle_aec_energy;
+    double stage_energy[AUDIO_PIPELINE_NUM_STAGES];
+    double vnr_input;
+    double vnr_output;
+    double stage_ticks[AUDIO_PIPELINE_NUM_STAGES];
+} model_t;
+
+static const double echo_path[] = { 0.6, -0.3, 0.2, 0.1, -0.05, 0.03, 0.02, -0.01 };
+#define ECHO_PATH_LENGTH    ((int)(sizeof(echo_path) / sizeof(echo_path[0])))
+#define ECHO_PATH_DELAY     (3)
+
+static servicer_t servicer;
+
+static uint32_t reference_time;
+static uint32_t rand_state;
+
+/* The AEC's state, and the last reference samples for it and the echo path */
+static double aec_w[AEC_TAPS];
+static double ref_history[AEC_TAPS + ECHO_PATH_DELAY + ECHO_PATH_LENGTH];
+
+uint32_t get_reference_time(void)
+{
+    return reference_time;
+}
+
+// telemetry_servicer() is not run, as the test calls the servicer callbacks directly
+control_ret_t device_control_servicer_register(device_control_servicer_t *ctx, device_control_t *device_control_ctx[],
+                                               size_t device_control_ctx_count, const control_resid_t resources[],
+                                               size_t num_resources)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t device_control_servicer_cmd_recv(device_control_servicer_t *ctx, device_control_read_cmd_cb_t read_cmd_cb,
+                                               device_control_write_cmd_cb_t write_cmd_cb, void *app_data,
+                                               unsigned timeout)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+int rtos_core_id_get(void)
+{
+    return 0;
+}
+
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+// The DFU and tuning servicers' resources aren't this servicer's, so the servicer never routes commands to them
+control_ret_t dfu_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t tuning_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t tuning_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static uint32_t rand_next(void)
+{
+    return xorshift(&rand_state);
+}
+
+static uint32_t get_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static int32_t saturate(double x)
+{
+    return (x > INT32_MAX) ? INT32_MAX : (x < INT32_MIN) ? INT32_MIN : (int32_t)lround(x);
+}
+
+/* Ticks the stand-in stage takes for a frame, varied so the smoothed ticks and peaks have something to follow */
+static uint32_t stage_cost(int stage, uint32_t index)
+{
+    return 1000 * (stage + 1) + (index * 7 + stage * 3) % 50 + ((index % 97 == 13) ? 4000 : 0);
+}
+
+/*
+ * Stand-ins for the reference pipeline stages, which need the fwk_voice libraries. The AEC is an NLMS filter, so its
+ * ERLE rises as it converges on the echo path, and the other stages have fixed gains and VNR estimates, so their
+ * attenuation is known.
+ */
+static void stage_aec(frame_data_t *frame_data)
+{
+    const int history = sizeof(ref_history) / sizeof(ref_history[0]);
+
+    for (int n = 0; n < appconfAUDIO_PIPELINE_FRAME_ADVANCE; n++) {
+        memmove(&ref_history[1], &ref_history[0], (history - 1) * sizeof(ref_history[0]));
+        ref_history[0] = frame_data->aec_reference_audio_samples[0][n];
+
+        double estimate = 0;
+        double power = 1.0;
+        for (int k = 0; k < AEC_TAPS; k++) {
+            estimate += aec_w[k] * ref_history[k];
+            power += ref_history[k] * ref_history[k];
+        }
+        double error = frame_data->samples[0][n] - estimate;
+        for (int k = 0; k < AEC_TAPS; k++) {
+            aec_w[k] += AEC_MU * error * ref_history[k] / power;
+        }
+        frame_data->samples[0][n] = saturate(error);
+    }
+    frame_data->telemetry.mic_delay_samples = MIC_DELAY_SAMPLES;
+    reference_time += stage_cost(AUDIO_PIPELINE_STAGE_AEC, frame_data->index);
+}
+
+static void scale(int32_t *samples, double gain)
+{
+    for (int n = 0; n < appconfAUDIO_PIPELINE_FRAME_ADVANCE; n++) {
+        samples[n] = saturate(samples[n] * gain);
+    }
+}
+
+static void stage_vnr_and_ic(frame_data_t *frame_data)
+{
+    scale(frame_data->samples[0], IC_SCALE);
+    frame_data->telemetry.vnr_input = VNR_INPUT;
+    frame_data->telemetry.vnr_output = VNR_OUTPUT;
+    reference_time += stage_cost(AUDIO_PIPELINE_STAGE_IC, frame_data->index);
+}
+
+static void stage_ns(frame_data_t *frame_data)
+{
+    scale(frame_data->samples[0], NS_SCALE);
+    reference_time += stage_cost(AUDIO_PIPELINE_STAGE_NS, frame_data->index);
+}
+
+static void stage_agc(frame_data_t *frame_data)
+{
+    scale(frame_data->samples[0], AGC_GAIN);
+    frame_data->telemetry.agc_gain = AGC_GAIN;
+    reference_time += stage_cost(AUDIO_PIPELINE_STAGE_AGC, frame_data->index);
+}
+
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_aec, AUDIO_PIPELINE_STAGE_AEC)
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_vnr_and_ic, AUDIO_PIPELINE_STAGE_IC)
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_ns, AUDIO_PIPELINE_STAGE_NS)
+AUDIO_PIPELINE_TELEMETRY_TIMED_STAGE(stage_agc, AUDIO_PIPELINE_STAGE_AGC)
+
+/* The pipeline input, as audio_pipeline_input_i() in the reference pipelines: an echo of the reference plus noise */
+static void frame_input(frame_data_t *frame_data, uint32_t index, bool ref_active)
+{
+    static double echo_history[ECHO_PATH_DELAY + ECHO_PATH_LENGTH];
+    const int history = sizeof(echo_history) / sizeof(echo_history[0]);
+
+    memset(frame_data, 0, sizeof(*frame_data));
+    frame_data->index = index;
+    for (int n = 0; n < appconfAUDIO_PIPELINE_FRAME_ADVANCE; n++) {
+        int32_t ref = ref_active ? ((int32_t)rand_next() >> 4) : 0;
+        double echo = 0;
+
+        memmove(&echo_history[1], &echo_history[0], (history - 1) * sizeof(echo_history[0]));
+        echo_history[0] = ref;
+        for (int k = 0; k < ECHO_PATH_LENGTH; k++) {
+            echo += echo_path[k] * echo_history[ECHO_PATH_DELAY + k];
+        }
+        frame_data->aec_reference_audio_samples[0][n] = ref;
+        frame_data->aec_reference_audio_samples[1][n] = ref >> 1;
+        frame_data->mic_samples_passthrough[0][n] = saturate(echo) + ((int32_t)rand_next() >> 11);
+        frame_data->mic_samples_passthrough[1][n] = frame_data->mic_samples_passthrough[0][n];
+    }
+
+    frame_data->telemetry.mic_energy = audio_pipeline_telemetry_energy(
+                                            frame_data->mic_samples_passthrough[0],
+                                            appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    for (int ch = 0; ch < 2; ch++) {
+        frame_data->telemetry.ref_energy += audio_pipeline_telemetry_energy(
+                                                frame_data->aec_reference_audio_samples[ch],
+                                                appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    }
+    memcpy(frame_data->samples, frame_data->mic_samples_passthrough, sizeof(frame_data->samples));
+}
+
+/* Runs a frame through the stages and out, each frame output one frame period after the last */
+static void frame_run(frame_data_t *frame_data, uint32_t index, bool ref_active)
+{
+    reference_time = index * FRAME_TICKS;
+    frame_input(frame_data, index, ref_active);
+    stage_aec_timed(frame_data);
+    stage_vnr_and_ic_timed(frame_data);
+    stage_ns_timed(frame_data);
+    stage_agc_timed(frame_data);
+    audio_pipeline_telemetry_update(&frame_data->telemetry, index * FRAME_TICKS + FRAME_TICKS / 2, FRAME_TICKS);
+}
+
+static void model_update(model_t *model, const audio_pipeline_telemetry_frame_t *frame)
+{
+    for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+        double weight = (model->frames == 0) ? 1.0 : SMOOTHING;
+        model->stage_energy[i] += weight * (frame->stage_energy[i] - model->stage_energy[i]);
+        model->stage_ticks[i] += weight * (frame->stage_ticks[i] - model->stage_ticks[i]);
+    }
+    double weight = (model->frames == 0) ? 1.0 : SMOOTHING;
+    model->vnr_input += weight * (frame->vnr_input - model->vnr_input);
+    model->vnr_output += weight * (frame->vnr_output - model->vnr_output);
+    if (frame->ref_energy > AUDIO_PIPELINE_TELEMETRY_REF_ACTIVE_ENERGY) {
+        model->erle_mic_energy += SMOOTHING * (frame->mic_energy - model->erle_mic_energy);
+        model->erle_aec_energy += SMOOTHING * (frame->stage_energy[AUDIO_PIPELINE_STAGE_AEC] - model->erle_aec_energy);
+    }
+    model->frames++;
+}
+
+static double ratio_db(double numerator, double denominator)
+{
+    return 10.0 * log10((numerator + 1e-12) / (denominator + 1e-12));
+}
+
+static void check_db(const char *func, const char *name, int32_t value_q8, double expected_db, double tolerance_db)
+{
+    if (fabs(value_q8 / 256.0 - expected_db) > tolerance_db) {
+        printf("FAIL, %s(): %s is %.3f dB, expected %.3f dB\n", func, name, value_q8 / 256.0, expected_db);
+        xassert(0);
+    }
+}
+
+static void check_model(const char *func, const model_t *model)
+{
+    audio_pipeline_telemetry_t telemetry;
+
+    audio_pipeline_telemetry_read(&telemetry);
+    if (telemetry.frames != model->frames) {
+        printf("FAIL, %s(): %u frames, expected %u\n", func, telemetry.frames, model->frames);
+        xassert(0);
+    }
+    check_db(func, "ERLE", telemetry.aec_erle_db_q8, ratio_db(model->erle_mic_energy, model->erle_aec_energy), 0.01);
+    check_db(func, "IC attenuation", telemetry.ic_attenuation_db_q8,
+             ratio_db(model->stage_energy[AUDIO_PIPELINE_STAGE_AEC], model->stage_energy[AUDIO_PIPELINE_STAGE_IC]), 0.01);
+    check_db(func, "NS attenuation", telemetry.ns_attenuation_db_q8,
+             ratio_db(model->stage_energy[AUDIO_PIPELINE_STAGE_IC], model->stage_energy[AUDIO_PIPELINE_STAGE_NS]), 0.01);
+
+    // The stand-in stages' gains are known, whatever the signal
+    check_db(func, "IC attenuation", telemetry.ic_attenuation_db_q8, -20.0 * log10(IC_SCALE), 0.02);
+    check_db(func, "NS attenuation", telemetry.ns_attenuation_db_q8, -20.0 * log10(NS_SCALE), 0.02);
+    check_db(func, "AGC gain", telemetry.agc_gain_db_q8, 20.0 * log10(AGC_GAIN), 0.01);
+
+    if ((telemetry.vnr_input_q16 != lround(model->vnr_input * 65536)) ||
+        (telemetry.vnr_output_q16 != lround(model->vnr_output * 65536)) ||
+        (telemetry.mic_delay_samples != MIC_DELAY_SAMPLES)) {
+        printf("FAIL, %s(): VNR 0x%x and 0x%x, mic delay %d\n", func, telemetry.vnr_input_q16, telemetry.vnr_output_q16,
+               telemetry.mic_delay_samples);
+        xassert(0);
+    }
+    for (int i = 0; i < AUDIO_PIPELINE_NUM_STAGES; i++) {
+        if (labs((long)telemetry.stage_ticks[i] - lround(model->stage_ticks[i])) > 1) {
+            printf("FAIL, %s(): stage %d takes %u ticks, expected %.1f\n", func, i, telemetry.stage_ticks[i],
+                   model->stage_ticks[i]);
+            xassert(0);
+        }
+    }
+    if (telemetry.dropped_frames != 0) {
+        printf("FAIL, %s(): %u frames dropped\n", func, telemetry.dropped_frames);
+        xassert(0);
+    }
+}
+
+/* The energy of known signals, against a double precision reference */
+static void test_energy(uint32_t seed, bool verbose)
+{
+    int32_t samples[appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+    rand_state = seed;
+
+    memset(samples, 0, sizeof(samples));
+    if (audio_pipeline_telemetry_energy(samples, appconfAUDIO_PIPELINE_FRAME_ADVANCE) != 0.0f) {
+        printf("FAIL, %s(): silence has energy\n", __func__);
+        xassert(0);
+    }
+
+    for (int n = 0; n < appconfAUDIO_PIPELINE_FRAME_ADVANCE; n++) {
+        samples[n] = INT32_MIN;
+    }
+    float energy = audio_pipeline_telemetry_energy(samples, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    if (energy != 1.0f) {
+        printf("FAIL, %s(): full scale has energy %f\n", __func__, energy);
+        xassert(0);
+    }
+
+    // Down to -72 dB relative to full scale, where a sample scaled by 2^-8 still has 11 bits
+    for (int shift = 0; shift <= 12; shift++) {
+        for (int trial = 0; trial < 100; trial++) {
+            double expected = 0;
+            for (int n = 0; n < appconfAUDIO_PIPELINE_FRAME_ADVANCE; n++) {
+                samples[n] = (int32_t)rand_next() >> shift;
+                expected += ((double)samples[n] * samples[n]) / (4.0 * (1u << 30) * (1u << 30));
+            }
+            expected /= appconfAUDIO_PIPELINE_FRAME_ADVANCE;
+            energy = audio_pipeline_telemetry_energy(samples, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+            if (fabs(energy - expected) > 1e-3 * expected) {
+                printf("FAIL, %s(): energy %g, expected %g\n", __func__, energy, expected);
+                xassert(0);
+            }
+        }
+    }
+
+    if (verbose) {
+        printf("%s passes\n", __func__);
+    }
+}
+
+/*
+ * Echo only input, with the reference active, through the stand-in stages. The ERLE must rise as the AEC converges,
+ * every level must match the double precision model of the same frames, and the ERLE must hold while the reference
+ * is silent.
+ */
+static void test_echo_only(uint32_t seed, bool verbose)
+{
+    frame_data_t frame_data;
+    audio_pipeline_telemetry_t telemetry;
+    model_t model;
+    int32_t last_erle_q8 = 0;
+    int32_t first_erle_q8 = 0;
+
+    rand_state = seed;
+    memset(&model, 0, sizeof(model));
+    memset(aec_w, 0, sizeof(aec_w));
+    memset(ref_history, 0, sizeof(ref_history));
+    audio_pipeline_telemetry_reset();
+
+    for (uint32_t i = 0; i < ECHO_FRAMES; i++) {
+        frame_run(&frame_data, i, true);
+        model_update(&model, &frame_data.telemetry);
+
+        if ((i + 1) % CHECKPOINT_FRAMES == 0) {
+            check_model(__func__, &model);
+            audio_pipeline_telemetry_read(&telemetry);
+            if ((i + 1 > CHECKPOINT_FRAMES) && (telemetry.aec_erle_db_q8 < last_erle_q8 - 64)) {
+                printf("FAIL, %s(): ERLE fell from %.2f dB to %.2f dB by frame %u\n", __func__, last_erle_q8 / 256.0,
+                       telemetry.aec_erle_db_q8 / 256.0, i);
+                xassert(0);
+            }
+            if (i + 1 == CHECKPOINT_FRAMES) {
+                first_erle_q8 = telemetry.aec_erle_db_q8;
+            }
+            last_erle_q8 = telemetry.aec_erle_db_q8;
+        }
+    }
+    if ((first_erle_q8 > 10 * 256) || (last_erle_q8 < 30 * 256)) {
+        printf("FAIL, %s(): ERLE only rose from %.2f dB to %.2f dB\n", __func__, first_erle_q8 / 256.0,
+               last_erle_q8 / 256.0);
+        xassert(0);
+    }
+
+    for (uint32_t i = ECHO_FRAMES; i < ECHO_FRAMES + SILENT_REF_FRAMES; i++) {
+        frame_run(&frame_data, i, false);
+        model_update(&model, &frame_data.telemetry);
+    }
+    check_model(__func__, &model);
+    audio_pipeline_telemetry_read(&telemetry);
+    if (telemetry.aec_erle_db_q8 != last_erle_q8) {
+        printf("FAIL, %s(): ERLE changed from %.2f dB to %.2f dB with no reference\n", __func__, last_erle_q8 / 256.0,
+               telemetry.aec_erle_db_q8 / 256.0);
+        xassert(0);
+    }
+
+    if (verbose) {
+        printf("%s passes, ERLE rose from %.2f dB to %.2f dB\n", __func__, first_erle_q8 / 256.0, last_erle_q8 / 256.0);
+    }
+}
+
+/* Output times with jitter, gaps of whole frame periods and a timer wrap. Only the gaps are dropped frames. */
+static void test_dropped_frames(uint32_t seed, bool verbose)
+{
+    audio_pipeline_telemetry_frame_t frame;
+    audio_pipeline_telemetry_t telemetry;
+    uint32_t expected = 0;
+    uint32_t ideal = UINT32_MAX - 100 * FRAME_TICKS;
+    int32_t jitter = 0;
+
+    rand_state = seed;
+    memset(&frame, 0, sizeof(frame));
+    audio_pipeline_telemetry_reset();
+
+    for (uint32_t i = 0; i < DROP_FRAMES; i++) {
+        if ((i > 0) && (rand_next() % 10 == 0)) {
+            uint32_t missed = 1 + rand_next() % 4;
+            ideal += missed * FRAME_TICKS;
+            expected += missed;
+        }
+        // Each frame up to 20% of a frame period late or early, so intervals are within 40% of the period
+        jitter = (int32_t)(rand_next() % (FRAME_TICKS * 2 / 5)) - (int32_t)(FRAME_TICKS / 5);
+        audio_pipeline_telemetry_update(&frame, ideal + jitter, FRAME_TICKS);
+        ideal += FRAME_TICKS;
+    }
+
+    audio_pipeline_telemetry_read(&telemetry);
+    if ((telemetry.frames != DROP_FRAMES) || (telemetry.dropped_frames != expected)) {
+        printf("FAIL, %s(): %u frames and %u dropped, expected %u and %u\n", __func__, telemetry.frames,
+               telemetry.dropped_frames, DROP_FRAMES, expected);
+        xassert(0);
+    }
+
+    if (verbose) {
+        printf("%s passes, %u frames dropped\n", __func__, expected);
+    }
+}
+
+/* A stage's peak ticks are held for the rest of their window and all of the next one */
+static void test_stage_peaks(uint32_t seed, bool verbose)
+{
+    audio_pipeline_telemetry_frame_t frame;
+    audio_pipeline_telemetry_t telemetry;
+    const uint32_t spike_frame = 10 + seed % 40;
+
+    memset(&frame, 0, sizeof(frame));
+    audio_pipeline_telemetry_reset();
+
+    for (uint32_t i = 1; i <= 4 * AUDIO_PIPELINE_TELEMETRY_PEAK_FRAMES; i++) {
+        for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+            frame.stage_ticks[s] = 100 * (s + 1) + ((i == spike_frame) ? 5000 : 0);
+        }
+        audio_pipeline_telemetry_update(&frame, i * FRAME_TICKS, FRAME_TICKS);
+        audio_pipeline_telemetry_read(&telemetry);
+
+        bool held = (i >= spike_frame) && (i <= 2 * AUDIO_PIPELINE_TELEMETRY_PEAK_FRAMES);
+        for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+            uint32_t expected = 100 * (s + 1) + (held ? 5000 : 0);
+            if (telemetry.stage_ticks_peak[s] != expected) {
+                printf("FAIL, %s(): stage %d peak %u at frame %u, expected %u\n", __func__, s,
+                       telemetry.stage_ticks_peak[s], i, expected);
+                xassert(0);
+            }
+        }
+    }
+
+    if (verbose) {
+        printf("%s passes\n", __func__);
+    }
+}
+
+typedef struct {
+    volatile bool done;
+} writer_args_t;
+
+/* Updates number k, all of whose fields can be checked against each other */
+static void *writer_thread(void *arg)
+{
+    writer_args_t *args = arg;
+    audio_pipeline_telemetry_frame_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    for (uint32_t k = 0; k < CONCURRENT_UPDATES; k++) {
+        frame.mic_delay_samples = k;
+        for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+            frame.stage_ticks[s] = k;
+        }
+        audio_pipeline_telemetry_update(&frame, k * FRAME_TICKS, FRAME_TICKS);
+        if (k % 4 == 0) {
+            sched_yield();
+        }
+    }
+    args->done = true;
+    return NULL;
+}
+
+/* Reads while the pipeline output updates the telemetry must each see one whole update, as must frame reads */
+static void test_concurrent_read(uint32_t seed, bool verbose)
+{
+    writer_args_t args = { false };
+    audio_pipeline_telemetry_t telemetry;
+    audio_pipeline_telemetry_frame_t frame;
+    pthread_t writer;
+    uint32_t last_frames = 0;
+    unsigned reads = 0;
+    unsigned distinct = 0;
+
+    audio_pipeline_telemetry_reset();
+    pthread_create(&writer, NULL, writer_thread, &args);
+
+    while (!args.done) {
+        audio_pipeline_telemetry_read(&telemetry);
+        reads++;
+        if (telemetry.frames != 0) {
+            bool whole = telemetry.mic_delay_samples == (int32_t)(telemetry.frames - 1);
+            for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+                whole = whole && (telemetry.stage_ticks_peak[s] == telemetry.frames - 1);
+            }
+            if (!whole || (telemetry.frames < last_frames) || (telemetry.dropped_frames != 0)) {
+                printf("FAIL, %s(): read %u is torn, %u frames, mic delay %d, peak %u\n", __func__, reads,
+                       telemetry.frames, telemetry.mic_delay_samples, telemetry.stage_ticks_peak[0]);
+                xassert(0);
+            }
+            distinct += telemetry.frames != last_frames;
+            last_frames = telemetry.frames;
+        }
+
+        audio_pipeline_telemetry_read_frame(&frame);
+        for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+            if (frame.stage_ticks[s] != (uint32_t)frame.mic_delay_samples) {
+                printf("FAIL, %s(): frame read %u is torn, mic delay %d, stage %d ticks %u\n", __func__, reads,
+                       frame.mic_delay_samples, s, frame.stage_ticks[s]);
+                xassert(0);
+            }
+        }
+        if (reads % 16 == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(writer, NULL);
+
+    if (distinct < 1000) {
+        printf("FAIL, %s(): only %u of the %u updates were read while they were being made\n", __func__, distinct,
+               CONCURRENT_UPDATES);
+        xassert(0);
+    }
+
+    if (verbose) {
+        printf("%s passes, %u reads saw %u of %u updates\n", __func__, reads, distinct, CONCURRENT_UPDATES);
+    }
+}
+
+static control_ret_t telemetry_read_payload(control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    uint8_t buf[1 + TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES + 1];
+    xassert(payload_len < sizeof(buf));
+
+    control_ret_t ret = read_cmd(TELEMETRY_SERVICER_RESID, CONTROL_CMD_SET_READ(cmd), buf, 1 + payload_len, &servicer);
+    if (buf[0] != ret) {
+        printf("FAIL, %s(): status byte %d, returned %d\n", __func__, buf[0], ret);
+        xassert(0);
+    }
+    memcpy(payload, &buf[1], payload_len);
+    return ret;
+}
+
+static void check_words(const char *func, const char *cmd_name, const uint8_t *payload, const uint32_t *expected,
+                        unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (get_le32(&payload[4 * i]) != expected[i]) {
+            printf("FAIL, %s(): %s word %u is 0x%x, expected 0x%x\n", func, cmd_name, i, get_le32(&payload[4 * i]),
+                   expected[i]);
+            xassert(0);
+        }
+    }
+}
+
+/* Every command reads the telemetry as audio_pipeline_telemetry_read() does, and the resource can't be written */
+static void test_servicer(uint32_t seed, bool verbose)
+{
+    uint8_t payload[TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES + 1];
+    audio_pipeline_telemetry_t telemetry;
+    frame_data_t frame_data;
+    control_ret_t ret;
+
+    rand_state = seed;
+    telemetry_servicer_init(&servicer);
+    audio_pipeline_telemetry_reset();
+    for (uint32_t i = 0; i < 30; i++) {
+        frame_run(&frame_data, i + ((i > 20) ? 3 : 0), true);
+    }
+    audio_pipeline_telemetry_read(&telemetry);
+
+    const uint32_t counters[] = { telemetry.frames, telemetry.dropped_frames };
+    const uint32_t levels[] = {
+        telemetry.aec_erle_db_q8, telemetry.ic_attenuation_db_q8, telemetry.ns_attenuation_db_q8,
+        telemetry.agc_gain_db_q8, telemetry.vnr_input_q16, telemetry.vnr_output_q16, telemetry.mic_delay_samples,
+    };
+    uint32_t stage_ticks[2 * AUDIO_PIPELINE_NUM_STAGES];
+    for (int s = 0; s < AUDIO_PIPELINE_NUM_STAGES; s++) {
+        stage_ticks[s] = telemetry.stage_ticks[s];
+        stage_ticks[AUDIO_PIPELINE_NUM_STAGES + s] = telemetry.stage_ticks_peak[s];
+    }
+    xassert(telemetry.dropped_frames == 3);
+
+    ret = telemetry_read_payload(TELEMETRY_SERVICER_RESID_COUNTERS, payload, TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES);
+    xassert(ret == CONTROL_SUCCESS);
+    check_words(__func__, "COUNTERS", payload, counters, 2);
+
+    ret = telemetry_read_payload(TELEMETRY_SERVICER_RESID_LEVELS, payload, TELEMETRY_SERVICER_RESID_LEVELS_NUM_VALUES);
+    xassert(ret == CONTROL_SUCCESS);
+    check_words(__func__, "LEVELS", payload, levels, 7);
+
+    ret = telemetry_read_payload(TELEMETRY_SERVICER_RESID_STAGE_TICKS, payload,
+                                 TELEMETRY_SERVICER_RESID_STAGE_TICKS_NUM_VALUES);
+    xassert(ret == CONTROL_SUCCESS);
+    check_words(__func__, "STAGE_TICKS", payload, stage_ticks, 2 * AUDIO_PIPELINE_NUM_STAGES);
+
+    ret = telemetry_read_payload(TELEMETRY_SERVICER_RESID_ALL, payload, TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES);
+    xassert(ret == CONTROL_SUCCESS);
+    check_words(__func__, "ALL", payload, counters, 2);
+    check_words(__func__, "ALL", &payload[TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES], levels, 7);
+    check_words(__func__, "ALL",
+                &payload[TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES + TELEMETRY_SERVICER_RESID_LEVELS_NUM_VALUES],
+                stage_ticks, 2 * AUDIO_PIPELINE_NUM_STAGES);
+
+    ret = telemetry_read_payload(TELEMETRY_SERVICER_RESID_ALL, payload, TELEMETRY_SERVICER_RESID_ALL_NUM_VALUES + 1);
+    xassert(ret == SERVICER_WRONG_COMMAND_LEN);
+    ret = telemetry_read_payload(NUM_TELEMETRY_SERVICER_RESID_CMDS, payload, 4);
+    xassert(ret == SERVICER_WRONG_COMMAND_ID);
+
+    memset(payload, 0, sizeof(payload));
+    ret = write_cmd(TELEMETRY_SERVICER_RESID, TELEMETRY_SERVICER_RESID_COUNTERS, payload,
+                    TELEMETRY_SERVICER_RESID_COUNTERS_NUM_VALUES, &servicer);
+    xassert(ret == CONTROL_BAD_COMMAND);
+    audio_pipeline_telemetry_read(&telemetry);
+    xassert((telemetry.frames == counters[0]) && (telemetry.dropped_frames == counters[1]));
+
+    if (verbose) {
+        printf("%s passes\n", __func__);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    uint32_t seed = 0x12345678;
+
+    test_energy(seed++, verbose);
+
+    test_echo_only(seed++, verbose);
+
+    test_dropped_frames(seed++, verbose);
+
+    test_stage_peaks(seed++, verbose);
+
+    test_concurrent_read(seed++, verbose);
+
+    test_servicer(seed++, verbose);
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+
+# Host only test of the runtime audio pipeline tuning: the FFVA tuning servicer's commands, and the settings taking
+# effect at frame boundaries in a threaded pipeline of stand-in stages
+find_package(Threads REQUIRED)
+
+add_executable(test_audio_pipeline_tuning
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference/audio_pipeline_seqlock.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference/audio_pipeline_tuning.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/tuning/tuning_servicer.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control/servicer.c
+)
+
+target_include_directories(test_audio_pipeline_tuning
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/../ffva_dfu/src/host
+        ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/telemetry
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/tuning
+)
+
+target_link_libraries(test_audio_pipeline_tuning
+    PRIVATE
+        Threads::Threads
+)
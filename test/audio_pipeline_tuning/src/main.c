@@ -0,0 +1,912 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "servicer.h"
+#include "tuning_servicer.h"
+#include "tuning_cmds.h"
+#include "audio_pipeline_tuning.h"
+#include "platform/platform_conf.h"
+#include "platform/driver_instances.h"
+
+#define FRAME_ADVANCE       (240)
+#define NUM_STAGES          (4)         // AEC, IC, NS and AGC, as the reference pipelines
+#define QUEUE_LENGTH        (2)
+
+#define BOUNDARY_FRAMES     (500)
+#define CONCURRENT_FRAMES   (4000)
+#define STRESS_REQUESTS     (200000)
+
+#define AGC_TARGET          (1 << 22)
+#define AGC_MAX_GAIN        (1 << 24)
+
+#define MAX_PAYLOAD_LEN     (TUNING_SERVICER_RESID_AGC_LIMITS_NUM_VALUES)
+
+/*
+ * Stand-ins for the reference pipeline stages, which need the fwk_voice libraries. They keep state from frame to
+ * frame as the real stages do, so the output depends on which frame each setting took effect in, and they apply the
+ * settings the same way: from the frame's own copy, and the AGC gain and the forced delay estimation only when their
+ * value changes.
+ */
+typedef struct {
+    uint32_t index;
+    int32_t mics[2][FRAME_ADVANCE];
+    int32_t ref[FRAME_ADVANCE];
+    int32_t samples[FRAME_ADVANCE];
+    int32_t no_aec;
+    audio_pipeline_tuning_t tuning;
+} frame_t;
+
+typedef struct {
+    int32_t aec_w[2];
+    uint32_t adec_force_count;
+    int32_t ic_w;
+    int32_t ns_level;
+    int32_t agc_gain;
+    uint32_t agc_gain_q16;
+} stages_state_t;
+
+typedef void (*stage_t)(stages_state_t *state, frame_t *frame);
+
+typedef struct {
+    frame_t *items[QUEUE_LENGTH];
+    unsigned head;
+    unsigned count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} queue_t;
+
+rtos_intertile_t *intertile_ctx = NULL;
+
+// Read by audio_pipeline_input() in the application
+volatile int mic_from_usb;
+volatile int aec_ref_source;
+
+static servicer_t servicer;
+static unsigned intertile_messages;
+
+// Sources the host expects, as the settings model in the tests
+static uint8_t model_mic_source;
+static uint8_t model_ref_source;
+
+static uint32_t rand_state;
+
+static uint32_t xorshift(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static uint32_t rand_next(void)
+{
+    return xorshift(&rand_state);
+}
+
+/* The intertile message goes straight to the pipeline input tile's tuning_servicer_rx() */
+void rtos_intertile_tx(rtos_intertile_t *ctx, uint8_t port, const void *msg, size_t len)
+{
+    if ((port != appconfAUDIO_PIPELINE_TUNING_PORT) || (len != sizeof(tuning_servicer_msg_t))) {
+        printf("FAIL, rtos_intertile_tx(): port %d, %zu bytes\n", port, len);
+        xassert(0);
+    }
+    intertile_messages++;
+    tuning_servicer_apply(msg);
+}
+
+size_t rtos_intertile_rx_len(rtos_intertile_t *ctx, uint8_t port, unsigned timeout)
+{
+    xassert(0);
+    return 0;
+}
+
+size_t rtos_intertile_rx_data(rtos_intertile_t *ctx, void *data, size_t len)
+{
+    xassert(0);
+    return 0;
+}
+
+// tuning_servicer() is not run, as the test calls the servicer callbacks directly
+control_ret_t device_control_servicer_register(device_control_servicer_t *ctx, device_control_t *device_control_ctx[],
+                                               size_t device_control_ctx_count, const control_resid_t resources[],
+                                               size_t num_resources)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t device_control_servicer_cmd_recv(device_control_servicer_t *ctx, device_control_read_cmd_cb_t read_cmd_cb,
+                                               device_control_write_cmd_cb_t write_cmd_cb, void *app_data,
+                                               unsigned timeout)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+int rtos_core_id_get(void)
+{
+    return 0;
+}
+
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+// The DFU servicer's resource isn't one of this servicer's, so the servicer never routes commands to it
+control_ret_t dfu_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+// Nor is the telemetry servicer's
+control_ret_t telemetry_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+static void put_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static int32_t saturate(int64_t x)
+{
+    return (x > INT32_MAX) ? INT32_MAX : (x < INT32_MIN) ? INT32_MIN : (int32_t)x;
+}
+
+static void stage_aec(stages_state_t *state, frame_t *frame)
+{
+    if (frame->tuning.adec_force_count != state->adec_force_count) {
+        // A delay estimation cycle restarts the filters
+        state->adec_force_count = frame->tuning.adec_force_count;
+        state->aec_w[0] = 0;
+        state->aec_w[1] = 0;
+    }
+    if (frame->tuning.bypass & AUDIO_PIPELINE_BYPASS_AEC) {
+        frame->no_aec = 1;
+        return;
+    }
+
+    int32_t step = (frame->tuning.adec_mode == AUDIO_PIPELINE_ADEC_AUTO) ? 64 : 16;
+    if (frame->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_OFF) {
+        step = 0;
+    } else if (frame->tuning.aec_adaption == AUDIO_PIPELINE_AEC_ADAPTION_FORCE_ON) {
+        step *= 2;
+    }
+    for (int ch = 0; ch < 2; ch++) {
+        for (int n = 0; n < FRAME_ADVANCE; n++) {
+            int32_t e = saturate(frame->mics[ch][n] - (((int64_t)state->aec_w[ch] * frame->ref[n]) >> 15));
+            state->aec_w[ch] += ((e ^ frame->ref[n]) >= 0) ? step : -step;
+            frame->mics[ch][n] = e;
+        }
+    }
+}
+
+static void stage_ic(stages_state_t *state, frame_t *frame)
+{
+    for (int n = 0; n < FRAME_ADVANCE; n++) {
+        if (frame->tuning.bypass & AUDIO_PIPELINE_BYPASS_IC) {
+            frame->samples[n] = frame->mics[0][n];
+        } else {
+            int32_t e = saturate(frame->mics[0][n] - (((int64_t)state->ic_w * frame->mics[1][n]) >> 15));
+            state->ic_w += ((e ^ frame->mics[1][n]) >= 0) ? 4 : -4;
+            frame->samples[n] = e;
+        }
+    }
+}
+
+static void stage_ns(stages_state_t *state, frame_t *frame)
+{
+    if (frame->tuning.bypass & AUDIO_PIPELINE_BYPASS_NS) {
+        return;
+    }
+    for (int n = 0; n < FRAME_ADVANCE; n++) {
+        state->ns_level += (frame->samples[n] - state->ns_level) >> 4;
+        frame->samples[n] -= state->ns_level;
+    }
+}
+
+static void stage_agc(stages_state_t *state, frame_t *frame)
+{
+    if (frame->tuning.agc_gain_q16 != state->agc_gain_q16) {
+        state->agc_gain_q16 = frame->tuning.agc_gain_q16;
+        if (state->agc_gain_q16 != 0) {
+            state->agc_gain = state->agc_gain_q16;
+        }
+    }
+    if (frame->tuning.bypass & AUDIO_PIPELINE_BYPASS_AGC) {
+        return;
+    }
+
+    int32_t peak = 0;
+    for (int n = 0; n < FRAME_ADVANCE; n++) {
+        int32_t mag = (frame->samples[n] < 0) ? -(frame->samples[n] + 1) : frame->samples[n];
+        peak = (mag > peak) ? mag : peak;
+        frame->samples[n] = saturate(((int64_t)frame->samples[n] * state->agc_gain) >> 16);
+    }
+    if (state->agc_gain_q16 == 0) {
+        int32_t max_gain = frame->tuning.agc_max_gain_q16 ? (int32_t)frame->tuning.agc_max_gain_q16 : AGC_MAX_GAIN;
+        int32_t min_gain = frame->tuning.agc_min_gain_q16 ? (int32_t)frame->tuning.agc_min_gain_q16 : 1;
+        int32_t target = frame->no_aec ? AGC_TARGET : AGC_TARGET / 2;
+        if (frame->tuning.agc_upper_threshold_q16) {
+            target = frame->tuning.agc_upper_threshold_q16 << 6;
+        }
+        if ((((int64_t)peak * state->agc_gain) >> 16) > target) {
+            state->agc_gain -= state->agc_gain >> 5;
+        } else if (state->agc_gain < max_gain) {
+            state->agc_gain += (state->agc_gain >> 6) + 1;
+        }
+        state->agc_gain = (state->agc_gain > max_gain) ? max_gain : (state->agc_gain < min_gain) ? min_gain : state->agc_gain;
+    }
+}
+
+static const stage_t stages[NUM_STAGES] = {
+    stage_aec,
+    stage_ic,
+    stage_ns,
+    stage_agc,
+};
+
+static void stages_init(stages_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->agc_gain = 1 << 16;
+}
+
+/* Echo of the reference plus noise on two mics, the same for a given seed and frame index */
+static void frame_make_input(frame_t *frame, uint32_t index, uint32_t seed)
+{
+    uint32_t state = (seed ^ (index * 0x9E3779B9)) | 1;
+
+    for (int i = 0; i < 8; i++) {
+        xorshift(&state);
+    }
+    frame->index = index;
+    frame->no_aec = 0;
+    for (int n = 0; n < FRAME_ADVANCE; n++) {
+        int32_t ref = (int32_t)xorshift(&state) >> 9;
+        frame->ref[n] = ref;
+        frame->mics[0][n] = (ref >> 1) + ((int32_t)xorshift(&state) >> 14);
+        frame->mics[1][n] = (ref >> 2) + ((int32_t)xorshift(&state) >> 14);
+    }
+}
+
+/* The pipeline input, as audio_pipeline_input_i() in the reference pipelines */
+static void frame_input(frame_t *frame, uint32_t index, uint32_t seed)
+{
+    memset(frame, 0, sizeof(*frame));
+    audio_pipeline_tuning_latch(&frame->tuning);
+    frame_make_input(frame, index, seed);
+}
+
+/* Runs the frames offline one at a time, each with the settings in schedule[] */
+static void run_reference(int32_t (*output)[FRAME_ADVANCE], const audio_pipeline_tuning_t *schedule, unsigned frames,
+                          uint32_t seed)
+{
+    stages_state_t state;
+    frame_t frame;
+
+    stages_init(&state);
+    for (unsigned i = 0; i < frames; i++) {
+        memset(&frame, 0, sizeof(frame));
+        frame_make_input(&frame, i, seed);
+        frame.tuning = schedule[i];
+        for (int s = 0; s < NUM_STAGES; s++) {
+            stages[s](&state, &frame);
+        }
+        memcpy(output[i], frame.samples, sizeof(frame.samples));
+    }
+}
+
+static void check_output(const char *func, int32_t (*output)[FRAME_ADVANCE], const audio_pipeline_tuning_t *schedule,
+                         unsigned frames, uint32_t seed)
+{
+    int32_t (*expected)[FRAME_ADVANCE] = malloc(frames * sizeof(*expected));
+    xassert(expected != NULL);
+
+    run_reference(expected, schedule, frames, seed);
+    for (unsigned i = 0; i < frames; i++) {
+        if (memcmp(output[i], expected[i], sizeof(expected[i])) != 0) {
+            printf("FAIL, %s(): frame %u differs from the offline run with the same settings\n", func, i);
+            xassert(0);
+        }
+    }
+    free(expected);
+}
+
+/* Sets up the servicer, and all the settings to their defaults for the next frame */
+static void tuning_setup(void)
+{
+    audio_pipeline_tuning_t tuning;
+
+    tuning_servicer_init(&servicer);
+    memset(&tuning, 0, sizeof(tuning));
+    audio_pipeline_tuning_request(&tuning);
+    intertile_messages = 0;
+    mic_from_usb = (appconfMIC_SRC_DEFAULT == appconfMIC_SRC_USB);
+    aec_ref_source = appconfAEC_REF_DEFAULT;
+    model_mic_source = appconfMIC_SRC_DEFAULT;
+    model_ref_source = appconfAEC_REF_DEFAULT;
+}
+
+static control_ret_t tuning_write(control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    return write_cmd(TUNING_SERVICER_RESID, cmd, payload, payload_len, &servicer);
+}
+
+static control_ret_t tuning_read(control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    uint8_t buf[1 + MAX_PAYLOAD_LEN];
+    xassert(payload_len < sizeof(buf));
+
+    control_ret_t ret = read_cmd(TUNING_SERVICER_RESID, CONTROL_CMD_SET_READ(cmd), buf, 1 + payload_len, &servicer);
+    memcpy(payload, &buf[1], payload_len);
+    return ret;
+}
+
+static void check_settings(const char *func, const audio_pipeline_tuning_t *expected)
+{
+    uint8_t payload[TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES];
+    uint8_t settings[TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES];
+    audio_pipeline_tuning_t latched;
+
+    settings[0] = expected->bypass;
+    settings[1] = expected->adec_mode;
+    put_le32(&settings[2], expected->agc_gain_q16);
+
+    control_ret_t ret = tuning_read(TUNING_SERVICER_RESID_SETTINGS, payload, sizeof(payload));
+    if ((ret != CONTROL_SUCCESS) || (memcmp(payload, settings, sizeof(settings)) != 0)) {
+        printf("FAIL, %s(): settings read back as %d %d 0x%02x%02x%02x%02x, returned %d\n", func,
+               payload[0], payload[1], payload[5], payload[4], payload[3], payload[2], ret);
+        xassert(0);
+    }
+    uint8_t limits[TUNING_SERVICER_RESID_AGC_LIMITS_NUM_VALUES];
+    put_le32(&limits[0], expected->agc_max_gain_q16);
+    put_le32(&limits[4], expected->agc_min_gain_q16);
+    put_le32(&limits[8], expected->agc_upper_threshold_q16);
+    put_le32(&limits[12], expected->agc_lower_threshold_q16);
+    uint8_t limits_payload[TUNING_SERVICER_RESID_AGC_LIMITS_NUM_VALUES];
+    ret = tuning_read(TUNING_SERVICER_RESID_AGC_LIMITS, limits_payload, sizeof(limits_payload));
+    if ((ret != CONTROL_SUCCESS) || (memcmp(limits_payload, limits, sizeof(limits)) != 0)) {
+        printf("FAIL, %s(): AGC limits read back wrong, returned %d\n", func, ret);
+        xassert(0);
+    }
+
+    uint8_t byte;
+    ret = tuning_read(TUNING_SERVICER_RESID_AEC_ADAPTION, &byte, 1);
+    if ((ret != CONTROL_SUCCESS) || (byte != expected->aec_adaption)) {
+        printf("FAIL, %s(): AEC adaption read back as %d, returned %d\n", func, byte, ret);
+        xassert(0);
+    }
+    ret = tuning_read(TUNING_SERVICER_RESID_MIC_SOURCE, &byte, 1);
+    if ((ret != CONTROL_SUCCESS) || (byte != model_mic_source)) {
+        printf("FAIL, %s(): mic source read back as %d, returned %d\n", func, byte, ret);
+        xassert(0);
+    }
+    ret = tuning_read(TUNING_SERVICER_RESID_AEC_REF_SOURCE, &byte, 1);
+    if ((ret != CONTROL_SUCCESS) || (byte != model_ref_source)) {
+        printf("FAIL, %s(): AEC reference source read back as %d, returned %d\n", func, byte, ret);
+        xassert(0);
+    }
+    if ((mic_from_usb != (model_mic_source == appconfMIC_SRC_USB)) || (aec_ref_source != model_ref_source)) {
+        printf("FAIL, %s(): the pipeline input tile has mic from USB %d, AEC reference source %d\n", func,
+               mic_from_usb, aec_ref_source);
+        xassert(0);
+    }
+
+    audio_pipeline_tuning_latch(&latched);
+    if (memcmp(&latched, expected, sizeof(latched)) != 0) {
+        printf("FAIL, %s(): the next frame latched bypass 0x%x, ADEC mode %u, force count %u, AGC gain 0x%x, "
+               "AEC adaption %u, AGC limits 0x%x 0x%x 0x%x 0x%x\n", func,
+               latched.bypass, latched.adec_mode, latched.adec_force_count, latched.agc_gain_q16, latched.aec_adaption,
+               latched.agc_max_gain_q16, latched.agc_min_gain_q16, latched.agc_upper_threshold_q16,
+               latched.agc_lower_threshold_q16);
+        xassert(0);
+    }
+}
+
+/*
+ * Writes a random tuning command, updating the settings model[] the host expects. Some of the commands are invalid,
+ * and must be rejected without changing anything.
+ */
+static void random_command(const char *func, audio_pipeline_tuning_t *model)
+{
+    uint8_t payload[MAX_PAYLOAD_LEN];
+    audio_pipeline_tuning_t next = *model;
+    uint8_t next_mic_source = model_mic_source;
+    uint8_t next_ref_source = model_ref_source;
+    uint32_t limits[4];
+    control_cmd_t cmd;
+    size_t len;
+    bool valid = true;
+    uint32_t gain = (rand_next() % 4 == 0) ? 0 : 0x4000 + rand_next() % 0x40000;
+
+    switch (rand_next() % 10) {
+    case 0:
+        cmd = TUNING_SERVICER_RESID_BYPASS;
+        payload[0] = rand_next() % 0x12;
+        valid = payload[0] <= AUDIO_PIPELINE_BYPASS_ALL;
+        next.bypass = payload[0];
+        len = 1;
+        break;
+    case 1:
+        cmd = TUNING_SERVICER_RESID_ADEC_MODE;
+        payload[0] = rand_next() % (AUDIO_PIPELINE_NUM_ADEC_MODES + 1);
+        valid = payload[0] < AUDIO_PIPELINE_NUM_ADEC_MODES;
+        next.adec_mode = payload[0];
+        len = 1;
+        break;
+    case 2:
+        cmd = TUNING_SERVICER_RESID_ADEC_FORCE;
+        payload[0] = 1;
+        next.adec_force_count++;
+        len = 1;
+        break;
+    case 3:
+        cmd = TUNING_SERVICER_RESID_AGC_GAIN;
+        put_le32(&payload[0], gain);
+        next.agc_gain_q16 = gain;
+        len = 4;
+        break;
+    case 4:
+        cmd = TUNING_SERVICER_RESID_MIC_SOURCE;
+        payload[0] = rand_next() % 3;
+        valid = payload[0] <= appconfMIC_SRC_USB;
+        next_mic_source = payload[0];
+        len = 1;
+        break;
+    case 5:
+        cmd = TUNING_SERVICER_RESID_AEC_REF_SOURCE;
+        payload[0] = rand_next() % 3;
+        valid = payload[0] <= appconfAEC_REF_I2S;
+        next_ref_source = payload[0];
+        len = 1;
+        break;
+    case 6:
+        cmd = TUNING_SERVICER_RESID_AEC_ADAPTION;
+        payload[0] = rand_next() % (AUDIO_PIPELINE_NUM_AEC_ADAPTIONS + 1);
+        valid = payload[0] < AUDIO_PIPELINE_NUM_AEC_ADAPTIONS;
+        next.aec_adaption = payload[0];
+        len = 1;
+        break;
+    case 7:
+        // Each limit 0 for the profile's, and sometimes a minimum above the maximum
+        cmd = TUNING_SERVICER_RESID_AGC_LIMITS;
+        for (int i = 0; i < 4; i++) {
+            limits[i] = (rand_next() % 3 == 0) ? 0 : 0x4000 + rand_next() % 0x400000;
+            put_le32(&payload[4 * i], limits[i]);
+        }
+        valid = ((limits[0] == 0) || (limits[1] <= limits[0])) && ((limits[2] == 0) || (limits[3] <= limits[2]));
+        next.agc_max_gain_q16 = limits[0];
+        next.agc_min_gain_q16 = limits[1];
+        next.agc_upper_threshold_q16 = limits[2];
+        next.agc_lower_threshold_q16 = limits[3];
+        len = TUNING_SERVICER_RESID_AGC_LIMITS_NUM_VALUES;
+        break;
+    default:
+        cmd = TUNING_SERVICER_RESID_SETTINGS;
+        payload[0] = rand_next() % (AUDIO_PIPELINE_BYPASS_ALL + 1);
+        payload[1] = rand_next() % (AUDIO_PIPELINE_NUM_ADEC_MODES + (rand_next() % 8 == 0));
+        put_le32(&payload[2], gain);
+        valid = payload[1] < AUDIO_PIPELINE_NUM_ADEC_MODES;
+        next.bypass = payload[0];
+        next.adec_mode = payload[1];
+        next.agc_gain_q16 = gain;
+        len = TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES;
+        break;
+    }
+
+    unsigned messages = intertile_messages;
+    control_ret_t ret = tuning_write(cmd, payload, len);
+    if ((ret != (valid ? CONTROL_SUCCESS : CONTROL_ERROR)) || (intertile_messages != messages + valid)) {
+        printf("FAIL, %s(): command %d %s returned %d, sent %u messages\n", func, cmd, valid ? "valid" : "invalid",
+               ret, intertile_messages - messages);
+        xassert(0);
+    }
+    if (valid) {
+        *model = next;
+        model_mic_source = next_mic_source;
+        model_ref_source = next_ref_source;
+    }
+}
+
+static void test_commands(uint32_t seed, bool verbose)
+{
+    uint8_t payload[MAX_PAYLOAD_LEN];
+    audio_pipeline_tuning_t model;
+    control_ret_t ret;
+
+    rand_state = seed;
+    tuning_setup();
+    memset(&model, 0, sizeof(model));
+    check_settings(__func__, &model);
+
+    for (int i = 0; i < 2000; i++) {
+        random_command(__func__, &model);
+        check_settings(__func__, &model);
+    }
+
+    // The lengths are checked by the servicer, before the tuning servicer sees the command
+    ret = tuning_write(TUNING_SERVICER_RESID_AGC_GAIN, payload, 2);
+    if (ret != SERVICER_WRONG_COMMAND_LEN) {
+        printf("FAIL, %s(): short AGC gain write returned %d\n", __func__, ret);
+        xassert(0);
+    }
+    ret = tuning_read(TUNING_SERVICER_RESID_ADEC_FORCE, payload, 1);
+    if (ret == CONTROL_SUCCESS) {
+        printf("FAIL, %s(): the write only ADEC force command was read\n", __func__);
+        xassert(0);
+    }
+    check_settings(__func__, &model);
+
+    // A source changed by the buttons is kept by the commands that don't set the sources
+    mic_from_usb = !mic_from_usb;
+    payload[0] = model.bypass;
+    ret = tuning_write(TUNING_SERVICER_RESID_BYPASS, payload, 1);
+    if ((ret != CONTROL_SUCCESS) || (mic_from_usb != (model_mic_source != appconfMIC_SRC_USB))) {
+        printf("FAIL, %s(): a bypass write changed the mic source the buttons set\n", __func__);
+        xassert(0);
+    }
+    payload[0] = model_mic_source;
+    ret = tuning_write(TUNING_SERVICER_RESID_MIC_SOURCE, payload, 1);
+    xassert(ret == CONTROL_SUCCESS);
+    check_settings(__func__, &model);
+
+    if (verbose) {
+        printf("%s passes\n", __func__);
+    }
+}
+
+/*
+ * Steps the frames through the stages as the generic pipeline does, with one frame in each stage, and writes
+ * commands between the stages. Every frame must be processed with the settings requested before its input, however
+ * many changes are made while it is in the pipeline.
+ */
+static void test_frame_boundary(uint32_t seed, bool verbose)
+{
+    frame_t *in_flight[NUM_STAGES] = {NULL};
+    audio_pipeline_tuning_t *schedule = malloc(BOUNDARY_FRAMES * sizeof(*schedule));
+    int32_t (*output)[FRAME_ADVANCE] = malloc(BOUNDARY_FRAMES * sizeof(*output));
+    audio_pipeline_tuning_t model;
+    stages_state_t state;
+    unsigned changes = 0;
+    unsigned outputs = 0;
+
+    xassert((schedule != NULL) && (output != NULL));
+    rand_state = seed;
+    tuning_setup();
+    memset(&model, 0, sizeof(model));
+    stages_init(&state);
+
+    for (unsigned tick = 0; tick < BOUNDARY_FRAMES + NUM_STAGES; tick++) {
+        // The input makes the next frame
+        for (int s = NUM_STAGES - 1; s > 0; s--) {
+            in_flight[s] = in_flight[s - 1];
+        }
+        in_flight[0] = NULL;
+        if (tick < BOUNDARY_FRAMES) {
+            in_flight[0] = malloc(sizeof(frame_t));
+            xassert(in_flight[0] != NULL);
+            frame_input(in_flight[0], tick, seed);
+            schedule[tick] = model;
+            if (memcmp(&in_flight[0]->tuning, &model, sizeof(model)) != 0) {
+                printf("FAIL, %s(): frame %u latched settings other than the last requested\n", __func__, tick);
+                xassert(0);
+            }
+        }
+
+        // Each stage processes its frame, with commands written before, between and after them
+        for (int s = NUM_STAGES - 1; s >= 0; s--) {
+            if (rand_next() % 3 == 0) {
+                random_command(__func__, &model);
+                changes++;
+            }
+
+            if (in_flight[s] != NULL) {
+                stages[s](&state, in_flight[s]);
+            }
+        }
+
+        frame_t *frame = in_flight[NUM_STAGES - 1];
+        if (frame != NULL) {
+            xassert(frame->index == outputs);
+            memcpy(output[outputs++], frame->samples, sizeof(frame->samples));
+            free(frame);
+        }
+    }
+    xassert(outputs == BOUNDARY_FRAMES);
+
+    check_output(__func__, output, schedule, BOUNDARY_FRAMES, seed);
+
+    free(schedule);
+    free(output);
+
+    if (verbose) {
+        printf("%s passes, %u commands while frames were in the pipeline\n", __func__, changes);
+    }
+}
+
+static void queue_init(queue_t *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+}
+
+static void queue_send(queue_t *queue, frame_t *frame)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == QUEUE_LENGTH) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+    queue->items[(queue->head + queue->count) % QUEUE_LENGTH] = frame;
+    queue->count++;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static frame_t *queue_receive(queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+    frame_t *frame = queue->items[queue->head];
+    queue->head = (queue->head + 1) % QUEUE_LENGTH;
+    queue->count--;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return frame;
+}
+
+typedef struct {
+    queue_t queues[NUM_STAGES + 1];
+    stages_state_t state;
+    uint32_t seed;
+    volatile bool done;
+} pipeline_t;
+
+typedef struct {
+    pipeline_t *pipeline;
+    int stage;
+} stage_thread_args_t;
+
+static void *input_thread(void *arg)
+{
+    pipeline_t *pipeline = arg;
+
+    for (unsigned i = 0; i < CONCURRENT_FRAMES; i++) {
+        frame_t *frame = malloc(sizeof(frame_t));
+        xassert(frame != NULL);
+        frame_input(frame, i, pipeline->seed);
+        queue_send(&pipeline->queues[0], frame);
+    }
+    return NULL;
+}
+
+static void *stage_thread(void *arg)
+{
+    stage_thread_args_t *args = arg;
+    pipeline_t *pipeline = args->pipeline;
+
+    for (unsigned i = 0; i < CONCURRENT_FRAMES; i++) {
+        frame_t *frame = queue_receive(&pipeline->queues[args->stage]);
+        stages[args->stage](&pipeline->state, frame);
+        queue_send(&pipeline->queues[args->stage + 1], frame);
+    }
+    return NULL;
+}
+
+/* Settings number k, all of whose fields can be checked against each other */
+static void settings_payload(uint8_t *payload, uint32_t k)
+{
+    payload[0] = k & AUDIO_PIPELINE_BYPASS_ALL;
+    payload[1] = (k >> 4) % AUDIO_PIPELINE_NUM_ADEC_MODES;
+    put_le32(&payload[2], 0x8000 + k);
+}
+
+static void *writer_thread(void *arg)
+{
+    pipeline_t *pipeline = arg;
+    uint8_t payload[TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES];
+    uint32_t state = pipeline->seed;
+
+    for (uint32_t k = 1; !pipeline->done; k++) {
+        settings_payload(payload, k);
+        control_ret_t ret = tuning_write(TUNING_SERVICER_RESID_SETTINGS, payload, sizeof(payload));
+        xassert(ret == CONTROL_SUCCESS);
+        if (k % 3 == 0) {
+            ret = tuning_write(TUNING_SERVICER_RESID_ADEC_FORCE, payload, 1);
+            xassert(ret == CONTROL_SUCCESS);
+        }
+        nanosleep(&(struct timespec){ .tv_nsec = (xorshift(&state) % 100) * 1000 }, NULL);
+    }
+    return NULL;
+}
+
+/*
+ * Runs the stages in threads, as the generic pipeline does, while another thread writes settings at random times.
+ * Every frame must have whole settings, each no older than those of the frame before, and the output must be the
+ * same as the offline run with the settings each frame had.
+ */
+static void test_concurrent(uint32_t seed, bool verbose)
+{
+    pipeline_t *pipeline = malloc(sizeof(pipeline_t));
+    audio_pipeline_tuning_t *schedule = malloc(CONCURRENT_FRAMES * sizeof(*schedule));
+    int32_t (*output)[FRAME_ADVANCE] = malloc(CONCURRENT_FRAMES * sizeof(*output));
+    stage_thread_args_t stage_args[NUM_STAGES];
+    pthread_t input, writer, stage_threads[NUM_STAGES];
+    unsigned changes = 0;
+
+    xassert((pipeline != NULL) && (schedule != NULL) && (output != NULL));
+    tuning_setup();
+    memset(pipeline, 0, sizeof(*pipeline));
+    for (int q = 0; q <= NUM_STAGES; q++) {
+        queue_init(&pipeline->queues[q]);
+    }
+    stages_init(&pipeline->state);
+    pipeline->seed = seed;
+
+    pthread_create(&writer, NULL, writer_thread, pipeline);
+    pthread_create(&input, NULL, input_thread, pipeline);
+    for (int s = 0; s < NUM_STAGES; s++) {
+        stage_args[s] = (stage_thread_args_t){ pipeline, s };
+        pthread_create(&stage_threads[s], NULL, stage_thread, &stage_args[s]);
+    }
+
+    for (unsigned i = 0; i < CONCURRENT_FRAMES; i++) {
+        frame_t *frame = queue_receive(&pipeline->queues[NUM_STAGES]);
+        xassert(frame->index == i);
+        schedule[i] = frame->tuning;
+        memcpy(output[i], frame->samples, sizeof(frame->samples));
+        free(frame);
+    }
+    pipeline->done = true;
+
+    pthread_join(writer, NULL);
+    pthread_join(input, NULL);
+    for (int s = 0; s < NUM_STAGES; s++) {
+        pthread_join(stage_threads[s], NULL);
+    }
+
+    for (unsigned i = 0; i < CONCURRENT_FRAMES; i++) {
+        const audio_pipeline_tuning_t *tuning = &schedule[i];
+        uint32_t k = tuning->agc_gain_q16 ? tuning->agc_gain_q16 - 0x8000 : 0;
+        uint8_t payload[TUNING_SERVICER_RESID_SETTINGS_NUM_VALUES];
+
+        settings_payload(payload, k);
+        bool whole = (k == 0) ? (tuning->bypass == 0) && (tuning->adec_mode == 0)
+                              : (tuning->bypass == payload[0]) && (tuning->adec_mode == payload[1]);
+        if (!whole || (tuning->adec_force_count > k / 3)) {
+            printf("FAIL, %s(): frame %u has torn settings, bypass 0x%x, ADEC mode %u, force count %u, AGC gain 0x%x\n",
+                   __func__, i, tuning->bypass, tuning->adec_mode, tuning->adec_force_count, tuning->agc_gain_q16);
+            xassert(0);
+        }
+        if (i > 0) {
+            const audio_pipeline_tuning_t *prev = &schedule[i - 1];
+            if ((tuning->agc_gain_q16 < prev->agc_gain_q16) || (tuning->adec_force_count < prev->adec_force_count)) {
+                printf("FAIL, %s(): frame %u has older settings than frame %u\n", __func__, i, i - 1);
+                xassert(0);
+            }
+            changes += memcmp(tuning, prev, sizeof(*tuning)) != 0;
+        }
+    }
+    if (changes < 20) {
+        printf("FAIL, %s(): the settings only changed %u times while the pipeline ran\n", __func__, changes);
+        xassert(0);
+    }
+
+    check_output(__func__, output, schedule, CONCURRENT_FRAMES, seed);
+
+    free(pipeline);
+    free(schedule);
+    free(output);
+
+    if (verbose) {
+        printf("%s passes, settings changed at %u of %u frames\n", __func__, changes, CONCURRENT_FRAMES);
+    }
+}
+
+static void *stress_writer_thread(void *arg)
+{
+    audio_pipeline_tuning_t tuning;
+
+    for (uint32_t k = 1; k <= STRESS_REQUESTS; k++) {
+        tuning = (audio_pipeline_tuning_t){ k, k, k, k, k, k, k, k, k };
+        audio_pipeline_tuning_request(&tuning);
+        if (k % 4 == 0) {
+            // Let the latches in between requests, even on one core
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* Latches as fast as possible while another thread requests as fast as possible */
+static void test_latch_stress(uint32_t seed, bool verbose)
+{
+    audio_pipeline_tuning_t tuning;
+    pthread_t writer;
+    uint32_t last = 0;
+    unsigned latches = 0;
+    unsigned distinct = 0;
+
+    tuning_setup();
+    pthread_create(&writer, NULL, stress_writer_thread, NULL);
+
+    do {
+        audio_pipeline_tuning_latch(&tuning);
+        latches++;
+        if ((tuning.adec_mode != tuning.bypass) || (tuning.adec_force_count != tuning.bypass) ||
+            (tuning.agc_gain_q16 != tuning.bypass) || (tuning.aec_adaption != tuning.bypass) ||
+            (tuning.agc_max_gain_q16 != tuning.bypass) || (tuning.agc_min_gain_q16 != tuning.bypass) ||
+            (tuning.agc_upper_threshold_q16 != tuning.bypass) || (tuning.agc_lower_threshold_q16 != tuning.bypass)) {
+            printf("FAIL, %s(): latched torn settings %u %u %u %u\n", __func__,
+                   tuning.bypass, tuning.adec_mode, tuning.adec_force_count, tuning.agc_gain_q16);
+            xassert(0);
+        }
+        if (tuning.bypass < last) {
+            printf("FAIL, %s(): latched settings %u after %u\n", __func__, tuning.bypass, last);
+            xassert(0);
+        }
+        distinct += tuning.bypass != last;
+        last = tuning.bypass;
+        if (latches % 16 == 0) {
+            sched_yield();
+        }
+    } while (last != STRESS_REQUESTS);
+
+    pthread_join(writer, NULL);
+
+    if (distinct < 1000) {
+        printf("FAIL, %s(): only %u of the %u requests were latched while they were being made\n", __func__, distinct,
+               STRESS_REQUESTS);
+        xassert(0);
+    }
+
+    if (verbose) {
+        printf("%s passes, %u latches saw %u of %u requests\n", __func__, latches, distinct, STRESS_REQUESTS);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    uint32_t seed = 0x12345678;
+
+    test_commands(seed++, verbose);
+
+    test_frame_boundary(seed++, verbose);
+
+    test_concurrent(seed++, verbose);
+
+    test_latch_stress(seed++, verbose);
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,17 @@
+
+# Host only test of the FFVA device control servicer's command lookup and batch command, calling the servicer
+# callbacks directly with a store of parameters in place of the DFU servicer's commands
+add_executable(test_ffva_control
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control/servicer.c
+)
+
+target_include_directories(test_ffva_control
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/../ffva_dfu/src/host
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/telemetry
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/tuning
+        ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference
+)
@@ -0,0 +1,501 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "servicer.h"
+#include "dfu_servicer.h"
+
+#define NUM_PARAMS          (60)        // Parameters of the servicer's resource, each a read write command
+#define PARAM_BYTES         (4)
+#define STATUS_CMD          (127)       // Read only command of the servicer's resource
+#define OTHER_RESID         (17)        // A second resource of the servicer, which it doesn't handle itself
+
+#define LOOKUPS             (4000000)
+#define LOOKUP_IDS          (4096)
+
+// Device control over I2C, as test/ffva_dfu/src/int_sim/dfu_int_host.c. A write is the device address, resource ID,
+// command ID and length followed by the payload, then a second transaction reads back the device address and status.
+// A read writes the same header, then reads back the device address, a status byte and the payload.
+#define WRITE_HEADER_BYTES  (4)
+#define WRITE_STATUS_BYTES  (2)
+#define READ_HEADER_BYTES   (4 + 2)
+#define BYTE_US             (9 / 0.4)
+#define TRANSACTION_US      (100)
+
+static control_cmd_info_t servicer_cmd_map[NUM_PARAMS + 1];
+static control_cmd_info_t other_cmd_map[] = {
+    { 0, 1, sizeof(uint8_t), CMD_READ_WRITE },
+};
+static control_resource_info_t res_info[2];
+static servicer_t servicer;
+
+static uint8_t params[SERVICER_NUM_CMD_IDS][PARAM_BYTES];
+static uint8_t model[SERVICER_NUM_CMD_IDS][PARAM_BYTES];
+static unsigned handler_calls;
+static volatile uintptr_t lookup_sink;
+
+typedef struct {
+    unsigned transactions;
+    double time_us;
+} bus_stats_t;
+
+static uint32_t rand_state;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+/* The servicer's resource is a store of parameters. Their IDs are the odd command IDs, spread over the ID space. */
+static uint8_t param_cmd_id(unsigned i)
+{
+    return i * 2 + 1;
+}
+
+// The servicer routes commands for its own resource here
+control_ret_t dfu_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    uint8_t cmd_id = CONTROL_CMD_CLEAR_READ(cmd);
+
+    handler_calls++;
+    if (cmd_id == STATUS_CMD) {
+        memset(payload, 0xA5, payload_len);
+        return CONTROL_SUCCESS;
+    }
+    memcpy(payload, params[cmd_id], payload_len);
+    return CONTROL_SUCCESS;
+}
+
+control_ret_t dfu_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    handler_calls++;
+    memcpy(params[CONTROL_CMD_CLEAR_READ(cmd)], payload, payload_len);
+    return CONTROL_SUCCESS;
+}
+
+// The tuning servicer's resource isn't one of this servicer's, so the servicer never routes commands to it
+control_ret_t tuning_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t tuning_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+// Nor is the telemetry servicer's
+control_ret_t telemetry_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+static void servicer_setup(void)
+{
+    for (unsigned i = 0; i < NUM_PARAMS; i++) {
+        servicer_cmd_map[i] = (control_cmd_info_t){ param_cmd_id(i), PARAM_BYTES, sizeof(uint8_t), CMD_READ_WRITE };
+    }
+    servicer_cmd_map[NUM_PARAMS] = (control_cmd_info_t){ STATUS_CMD, 2, sizeof(uint8_t), CMD_READ_ONLY };
+
+    memset(&servicer, 0, sizeof(servicer));
+    servicer.id = DFU_CONTROLLER_SERVICER_RESID;
+    servicer.num_resources = 2;
+    servicer.res_info = res_info;
+    res_info[0].resource = DFU_CONTROLLER_SERVICER_RESID;
+    res_info[0].command_map.num_commands = NUM_PARAMS + 1;
+    res_info[0].command_map.commands = servicer_cmd_map;
+    res_info[1].resource = OTHER_RESID;
+    res_info[1].command_map.num_commands = sizeof(other_cmd_map) / sizeof(other_cmd_map[0]);
+    res_info[1].command_map.commands = other_cmd_map;
+    servicer_index_init(&servicer);
+
+    memset(params, 0, sizeof(params));
+    memset(model, 0, sizeof(model));
+}
+
+/* The lookups as they were before the command maps were indexed */
+static control_cmd_info_t *linear_cmd_info(uint8_t cmd_id, const control_resource_info_t *res_info)
+{
+    for (int i = 0; i < res_info->command_map.num_commands; i++) {
+        if (res_info->command_map.commands[i].cmd_id == cmd_id) {
+            return &res_info->command_map.commands[i];
+        }
+    }
+    return NULL;
+}
+
+static control_resource_info_t *linear_res_info(control_resid_t resource, const servicer_t *servicer)
+{
+    for (int res = 0; res < servicer->num_resources; res++) {
+        if (servicer->res_info[res].resource == resource) {
+            return &servicer->res_info[res];
+        }
+    }
+    return NULL;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bus_write(bus_stats_t *bus, size_t payload_len)
+{
+    bus->transactions += 2;
+    bus->time_us += 2 * TRANSACTION_US + (WRITE_HEADER_BYTES + payload_len + WRITE_STATUS_BYTES) * BYTE_US;
+}
+
+static void bus_read(bus_stats_t *bus, size_t payload_len)
+{
+    bus->transactions += 1;
+    bus->time_us += TRANSACTION_US + (READ_HEADER_BYTES + payload_len) * BYTE_US;
+}
+
+/* A batch list being built by the host, and the length of the result it expects */
+typedef struct {
+    uint8_t list[SERVICER_BATCH_MAX_BYTES];
+    size_t list_len;
+    size_t result_len;
+} batch_t;
+
+static bool batch_add(batch_t *batch, control_resid_t resid, control_cmd_t cmd, const uint8_t *payload, uint8_t len)
+{
+    bool read = (cmd & 0x80) != 0;
+    size_t list_len = batch->list_len + SERVICER_BATCH_ITEM_HEADER_BYTES + (read ? 0 : len);
+    size_t result_len = batch->result_len + 1 + (read ? len : 0);
+
+    if ((list_len > SERVICER_BATCH_MAX_BYTES) || (result_len > SERVICER_BATCH_MAX_BYTES)) {
+        return false;
+    }
+    uint8_t *item = &batch->list[batch->list_len];
+    item[0] = resid;
+    item[1] = cmd;
+    item[2] = len;
+    if (!read) {
+        memcpy(&item[SERVICER_BATCH_ITEM_HEADER_BYTES], payload, len);
+    }
+    batch->list_len = list_len;
+    batch->result_len = result_len;
+    return true;
+}
+
+/* Writes the batch list and reads back its result into result[], which starts with the read status byte */
+static void batch_run(batch_t *batch, uint8_t *result, bus_stats_t *bus)
+{
+    control_ret_t ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch->list, batch->list_len,
+                                  &servicer);
+    if (ret != CONTROL_SUCCESS) {
+        printf("FAIL, batch_run(): batch write returned %d\n", ret);
+        xassert(0);
+    }
+    ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(SERVICER_CMD_BATCH), result,
+                   1 + batch->result_len, &servicer);
+    if ((ret != CONTROL_SUCCESS) || (result[0] != CONTROL_SUCCESS)) {
+        printf("FAIL, batch_run(): batch read returned %d, status %d\n", ret, result[0]);
+        xassert(0);
+    }
+    if (bus != NULL) {
+        bus_write(bus, batch->list_len);
+        bus_read(bus, batch->result_len);
+    }
+    batch->list_len = 0;
+    batch->result_len = 0;
+}
+
+static void check_status(const char *test, unsigned item, uint8_t status, control_ret_t expected)
+{
+    if (status != expected) {
+        printf("FAIL, %s(): item %u status %d, expected %d\n", test, item, status, expected);
+        xassert(0);
+    }
+}
+
+/*
+ * Checks that the indexed get_cmd_info() and get_res_info() find the same entry as a linear search of the command
+ * map and resources, for every command ID and resource ID.
+ */
+void test_lookup(uint32_t seed, bool verbose)
+{
+    (void)seed;
+    servicer_setup();
+
+    for (unsigned res = 0; res < 2; res++) {
+        for (unsigned id = 0; id < 0x100; id++) {
+            if (get_cmd_info(id, &res_info[res]) != linear_cmd_info(id, &res_info[res])) {
+                printf("FAIL, test_lookup(): resource %u command %u\n", res_info[res].resource, id);
+                xassert(0);
+            }
+        }
+    }
+    for (unsigned resid = 0; resid < SERVICER_NUM_RES_IDS; resid++) {
+        if (get_res_info(resid, &servicer) != linear_res_info(resid, &servicer)) {
+            printf("FAIL, test_lookup(): resource %u\n", resid);
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("lookup passes\n");
+    }
+}
+
+/*
+ * Runs random batches of parameter reads and writes, and checks that each item succeeds and each read returns the
+ * value of the last write before it, as if the commands had been sent one at a time. Batches also hold commands that
+ * fail, which report their own status without stopping the rest of the batch.
+ */
+void test_batch(uint32_t seed, bool verbose)
+{
+    uint8_t result[1 + SERVICER_BATCH_MAX_BYTES];
+    batch_t batch = {0};
+
+    rand_state = seed;
+    servicer_setup();
+
+    for (unsigned round = 0; round < 1000; round++) {
+        const uint8_t *expected[SERVICER_BATCH_MAX_BYTES];
+        control_ret_t expected_status[SERVICER_BATCH_MAX_BYTES];
+        uint8_t expected_len[SERVICER_BATCH_MAX_BYTES];
+        uint8_t reads[SERVICER_BATCH_MAX_BYTES][PARAM_BYTES];
+        unsigned items = 0;
+
+        for (;;) {
+            uint8_t id = param_cmd_id(rand_next() % NUM_PARAMS);
+            uint8_t value[PARAM_BYTES] = {0};
+            unsigned kind = rand_next() % 16;
+            bool added;
+
+            if (kind < 7) {
+                added = batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(id), NULL, PARAM_BYTES);
+                memcpy(reads[items], model[id], PARAM_BYTES);
+                expected[items] = reads[items];
+                expected_status[items] = CONTROL_SUCCESS;
+                expected_len[items] = PARAM_BYTES;
+            } else if (kind < 13) {
+                for (unsigned i = 0; i < PARAM_BYTES; i++) {
+                    value[i] = rand_next();
+                }
+                added = batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, id, value, PARAM_BYTES);
+                if (added) {
+                    memcpy(model[id], value, PARAM_BYTES);
+                }
+                expected[items] = NULL;
+                expected_status[items] = CONTROL_SUCCESS;
+                expected_len[items] = 0;
+            } else if (kind == 13) {
+                // Wrong length
+                added = batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(id), NULL, 2);
+                expected[items] = NULL;
+                expected_status[items] = SERVICER_WRONG_COMMAND_LEN;
+                expected_len[items] = 2;
+            } else if (kind == 14) {
+                // A command ID that isn't in the map, or a batch inside the batch
+                uint8_t cmd = (rand_next() & 1) ? id - 1 : SERVICER_CMD_BATCH;
+                added = batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, cmd, value, 1);
+                expected[items] = NULL;
+                expected_status[items] = SERVICER_WRONG_COMMAND_ID;
+                expected_len[items] = 0;
+            } else {
+                // A resource the servicer doesn't have, or one it has but doesn't handle
+                bool other = rand_next() & 1;
+                added = batch_add(&batch, other ? OTHER_RESID : OTHER_RESID + 1, CONTROL_CMD_SET_READ(0), NULL, 1);
+                expected[items] = NULL;
+                expected_status[items] = other ? CONTROL_ERROR : SERVICER_RESOURCE_ERROR;
+                expected_len[items] = 1;
+            }
+            if (!added) {
+                break;
+            }
+            items++;
+        }
+
+        batch_run(&batch, result, NULL);
+
+        const uint8_t *r = &result[1];
+        for (unsigned item = 0; item < items; item++) {
+            check_status("test_batch", item, r[0], expected_status[item]);
+            if ((expected[item] != NULL) && (memcmp(&r[1], expected[item], PARAM_BYTES) != 0)) {
+                printf("FAIL, test_batch(): round %u item %u read the wrong value\n", round, item);
+                xassert(0);
+            }
+            r += 1 + expected_len[item];
+        }
+        if (memcmp(params, model, sizeof(params)) != 0) {
+            printf("FAIL, test_batch(): round %u parameters don't match\n", round);
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("batch passes\n");
+    }
+}
+
+/*
+ * Checks that a batch list that is cut short, or would have too long a result, is refused without running any of
+ * it, and that the result must be read with its exact length.
+ */
+void test_batch_errors(uint32_t seed, bool verbose)
+{
+    uint8_t result[1 + SERVICER_BATCH_MAX_BYTES];
+    uint8_t value[PARAM_BYTES] = {1, 2, 3, 4};
+    batch_t batch = {0};
+    control_ret_t ret;
+
+    (void)seed;
+    servicer_setup();
+
+    // Cut short in an item's payload
+    batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, param_cmd_id(0), value, PARAM_BYTES);
+    handler_calls = 0;
+    ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch.list, batch.list_len - 1, &servicer);
+    xassert(ret == CONTROL_DATA_LENGTH_ERROR);
+
+    // Cut short in the next item's header
+    batch.list[batch.list_len++] = DFU_CONTROLLER_SERVICER_RESID;
+    ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch.list, batch.list_len, &servicer);
+    xassert(ret == CONTROL_DATA_LENGTH_ERROR);
+
+    // Too long a result
+    batch.list_len = 0;
+    for (unsigned i = 0; i < 2; i++) {
+        batch.list[batch.list_len++] = DFU_CONTROLLER_SERVICER_RESID;
+        batch.list[batch.list_len++] = CONTROL_CMD_SET_READ(STATUS_CMD);
+        batch.list[batch.list_len++] = 200;
+    }
+    ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch.list, batch.list_len, &servicer);
+    xassert(ret == CONTROL_DATA_LENGTH_ERROR);
+    if ((handler_calls != 0) || (params[param_cmd_id(0)][0] != 0)) {
+        printf("FAIL, test_batch_errors(): a batch that was refused ran %u commands\n", handler_calls);
+        xassert(0);
+    }
+
+    // The result is read with its exact length
+    batch.list_len = 0;
+    batch.result_len = 0;
+    batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(STATUS_CMD), NULL, 2);
+    ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch.list, batch.list_len, &servicer);
+    xassert(ret == CONTROL_SUCCESS);
+    ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(SERVICER_CMD_BATCH), result,
+                   batch.result_len, &servicer);
+    xassert((ret == SERVICER_WRONG_COMMAND_LEN) && (result[0] == SERVICER_WRONG_COMMAND_LEN));
+    ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(SERVICER_CMD_BATCH), result,
+                   1 + batch.result_len, &servicer);
+    xassert((ret == CONTROL_SUCCESS) && (result[1] == CONTROL_SUCCESS) && (result[2] == 0xA5) && (result[3] == 0xA5));
+
+    // An empty batch has an empty result
+    ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, SERVICER_CMD_BATCH, batch.list, 0, &servicer);
+    xassert(ret == CONTROL_SUCCESS);
+    ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(SERVICER_CMD_BATCH), result, 1, &servicer);
+    xassert(ret == CONTROL_SUCCESS);
+    if (verbose) {
+        printf("batch errors passes\n");
+    }
+}
+
+/*
+ * Reports the time of a command lookup with the indexes and with a linear search, and the I2C transactions and bus
+ * time to write and then read back every parameter one command at a time and in batches.
+ */
+void test_benchmark(uint32_t seed, bool verbose)
+{
+    uint8_t result[1 + SERVICER_BATCH_MAX_BYTES];
+    uint8_t response[1 + PARAM_BYTES];
+    uint8_t value[PARAM_BYTES] = {0};
+    bus_stats_t single = {0};
+    bus_stats_t batched = {0};
+    batch_t batch = {0};
+    uint8_t ids[LOOKUP_IDS];
+    uintptr_t sum = 0;
+    control_ret_t ret;
+    double start;
+
+    rand_state = seed;
+    servicer_setup();
+    for (unsigned i = 0; i < LOOKUP_IDS; i++) {
+        ids[i] = param_cmd_id(rand_next() % NUM_PARAMS);
+    }
+
+    start = now_ns();
+    for (unsigned i = 0; i < LOOKUPS; i++) {
+        sum += (uintptr_t)get_cmd_info(ids[i % LOOKUP_IDS], get_res_info(DFU_CONTROLLER_SERVICER_RESID, &servicer));
+    }
+    double indexed_ns = (now_ns() - start) / LOOKUPS;
+    start = now_ns();
+    for (unsigned i = 0; i < LOOKUPS; i++) {
+        sum -= (uintptr_t)linear_cmd_info(ids[i % LOOKUP_IDS], linear_res_info(DFU_CONTROLLER_SERVICER_RESID, &servicer));
+    }
+    double linear_ns = (now_ns() - start) / LOOKUPS;
+    lookup_sink = sum;
+    if (sum != 0) {
+        printf("FAIL, test_benchmark(): indexed and linear lookups found different entries\n");
+        xassert(0);
+    }
+
+    for (unsigned i = 0; i < NUM_PARAMS; i++) {
+        ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, param_cmd_id(i), value, PARAM_BYTES, &servicer);
+        xassert(ret == CONTROL_SUCCESS);
+        bus_write(&single, PARAM_BYTES);
+    }
+    for (unsigned i = 0; i < NUM_PARAMS; i++) {
+        ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(param_cmd_id(i)), response, 1 + PARAM_BYTES,
+                       &servicer);
+        xassert(ret == CONTROL_SUCCESS);
+        bus_read(&single, PARAM_BYTES);
+    }
+
+    for (unsigned i = 0; i < NUM_PARAMS; i++) {
+        if (!batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, param_cmd_id(i), value, PARAM_BYTES)) {
+            batch_run(&batch, result, &batched);
+            i--;
+        }
+    }
+    batch_run(&batch, result, &batched);
+    for (unsigned i = 0; i < NUM_PARAMS; i++) {
+        if (!batch_add(&batch, DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(param_cmd_id(i)), NULL,
+                       PARAM_BYTES)) {
+            batch_run(&batch, result, &batched);
+            i--;
+        }
+    }
+    batch_run(&batch, result, &batched);
+
+    printf("%u command map entries: lookup %.1f ns indexed, %.1f ns linear\n", NUM_PARAMS + 1, indexed_ns, linear_ns);
+    printf("write and read %u parameters: one at a time %u transactions, %.1f ms; batched %u transactions, %.1f ms\n",
+           NUM_PARAMS, single.transactions, single.time_us * 1e-3, batched.transactions, batched.time_us * 1e-3);
+    if (batched.transactions >= single.transactions || batched.time_us >= single.time_us) {
+        printf("FAIL, test_benchmark(): batches take no fewer transactions or less time\n");
+        xassert(0);
+    }
+    if (verbose) {
+        printf("benchmark passes\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    uint32_t seed = 0x12345678;
+
+    test_lookup(seed++, verbose);
+
+    test_batch(seed++, verbose);
+
+    test_batch_errors(seed++, verbose);
+
+    test_benchmark(seed++, verbose);
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,62 @@
+
+# Host only test of the FFVA DFU flash write path, against a file backed stand-in for the QSPI flash
+add_executable(test_ffva_dfu
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/flash_file.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_common.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_delta.c
+    ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_delta_mkimage/dfu_delta_make.c
+)
+
+target_include_directories(test_ffva_dfu
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/src
+        ${CMAKE_CURRENT_LIST_DIR}/src/host
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_delta_mkimage
+)
+
+# Host only simulation of the FFVA I2C DFU servicer and state machine, driven by a model of the host over the device
+# control transport, with the flash writes pipelined and, for comparison, done in the DNBUSY state
+foreach(PIPELINED 1 0)
+    if(PIPELINED)
+        set(TARGET_NAME test_ffva_dfu_int)
+    else()
+        set(TARGET_NAME test_ffva_dfu_int_serial)
+    endif()
+
+    add_executable(${TARGET_NAME}
+        ${CMAKE_CURRENT_LIST_DIR}/src/int_sim/main.c
+        ${CMAKE_CURRENT_LIST_DIR}/src/int_sim/rtos_sim.c
+        ${CMAKE_CURRENT_LIST_DIR}/src/int_sim/dfu_int_host.c
+        ${CMAKE_CURRENT_LIST_DIR}/src/flash_file.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_common.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_delta.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_delta_mkimage/dfu_delta_make.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_lz.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_lz_mkimage/dfu_lz_compress.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_state_machine.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int/dfu_servicer.c
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control/servicer.c
+    )
+
+    target_include_directories(${TARGET_NAME}
+        PRIVATE
+            ${CMAKE_CURRENT_LIST_DIR}/src
+            ${CMAKE_CURRENT_LIST_DIR}/src/int_sim
+            ${CMAKE_CURRENT_LIST_DIR}/src/host
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/dfu_int
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/control
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/telemetry
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/src/tuning
+            ${CMAKE_CURRENT_LIST_DIR}/../../modules/audio_pipelines/reference
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_delta_mkimage
+            ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/host/dfu_lz_mkimage
+    )
+
+    target_compile_definitions(${TARGET_NAME}
+        PRIVATE
+            DFU_INT_PIPELINED_WRITE=${PIPELINED}
+            FFVA_FILESYSTEM_DIR="${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva/filesystem_support"
+    )
+endforeach()
@@ -0,0 +1,143 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdlib.h>
+#include <string.h>
+
+#include "flash_file.h"
+
+const flash_file_timing_t flash_file_typical_timing = {
+    .read_us_per_byte = 0.04,
+    .erase_sector_us = 45000,
+    .program_page_us = 700,
+    .command_us = 2,
+};
+
+static void flash_busy(flash_file_t *flash, double us)
+{
+    flash->stats.busy_us += us;
+    if (flash->busy != NULL) {
+        flash->busy(us);
+    }
+}
+
+static void file_io(flash_file_t *flash, unsigned address, void *data, size_t len, int write)
+{
+    int seek_ret;
+    size_t io_len;
+
+    xassert(address + len <= flash->size);
+    seek_ret = fseek(flash->file, address, SEEK_SET);
+    xassert(seek_ret == 0);
+    if (write) {
+        io_len = fwrite(data, 1, len, flash->file);
+    } else {
+        io_len = fread(data, 1, len, flash->file);
+    }
+    xassert(io_len == len);
+    (void)seek_ret;
+    (void)io_len;
+}
+
+void flash_file_open(flash_file_t *flash, const char *path, size_t size)
+{
+    static uint8_t erased[FLASH_FILE_SECTOR_SIZE];
+
+    xassert((size % FLASH_FILE_SECTOR_SIZE) == 0);
+    memset(flash, 0, sizeof(flash_file_t));
+    flash->file = (path != NULL) ? fopen(path, "w+b") : tmpfile();
+    xassert(flash->file != NULL);
+    flash->size = size;
+    flash->timing = flash_file_typical_timing;
+
+    memset(erased, 0xFF, sizeof(erased));
+    for (unsigned addr = 0; addr < size; addr += FLASH_FILE_SECTOR_SIZE) {
+        file_io(flash, addr, erased, FLASH_FILE_SECTOR_SIZE, 1);
+    }
+}
+
+void flash_file_close(flash_file_t *flash)
+{
+    fclose(flash->file);
+    flash->file = NULL;
+}
+
+void flash_file_stats_reset(flash_file_t *flash)
+{
+    memset(&flash->stats, 0, sizeof(flash_file_stats_t));
+}
+
+void flash_file_poke(flash_file_t *flash, unsigned address, const uint8_t *data, size_t len)
+{
+    file_io(flash, address, (void *)data, len, 1);
+}
+
+void flash_file_peek(flash_file_t *flash, unsigned address, uint8_t *data, size_t len)
+{
+    file_io(flash, address, data, len, 0);
+}
+
+void rtos_qspi_flash_lock(rtos_qspi_flash_t *ctx)
+{
+    ctx->lock_depth++;
+}
+
+void rtos_qspi_flash_unlock(rtos_qspi_flash_t *ctx)
+{
+    xassert(ctx->lock_depth > 0);
+    ctx->lock_depth--;
+}
+
+void rtos_qspi_flash_read(rtos_qspi_flash_t *ctx, uint8_t *data, unsigned address, size_t len)
+{
+    ctx->stats.reads++;
+    ctx->stats.read_bytes += len;
+    flash_busy(ctx, ctx->timing.command_us + len * ctx->timing.read_us_per_byte);
+    file_io(ctx, address, data, len, 0);
+}
+
+void rtos_qspi_flash_write(rtos_qspi_flash_t *ctx, const uint8_t *data, unsigned address, size_t len)
+{
+    unsigned pages = (address + len + FLASH_FILE_PAGE_SIZE - 1) / FLASH_FILE_PAGE_SIZE - address / FLASH_FILE_PAGE_SIZE;
+    xassert(ctx->lock_depth > 0); // Programming without the lock races the other flash users
+    ctx->stats.programs++;
+    ctx->stats.program_bytes += len;
+    /* The data is taken at the end of the operation, so changing it while it is in progress is caught */
+    flash_busy(ctx, pages * (ctx->timing.command_us + ctx->timing.program_page_us));
+
+    /* NOR flash programming can only clear bits */
+    uint8_t *cur = malloc(len);
+    file_io(ctx, address, cur, len, 0);
+    for (size_t i = 0; i < len; i++) {
+        cur[i] &= data[i];
+    }
+    file_io(ctx, address, cur, len, 1);
+    free(cur);
+}
+
+void rtos_qspi_flash_erase(rtos_qspi_flash_t *ctx, unsigned address, size_t len)
+{
+    static uint8_t erased[FLASH_FILE_SECTOR_SIZE];
+
+    xassert(ctx->lock_depth > 0); // Erasing without the lock races the other flash users
+
+    /* Erase whole sectors, as the driver does */
+    memset(erased, 0xFF, sizeof(erased));
+    unsigned first = address / FLASH_FILE_SECTOR_SIZE;
+    unsigned last = (address + len - 1) / FLASH_FILE_SECTOR_SIZE;
+    for (unsigned sector = first; sector <= last; sector++) {
+        file_io(ctx, sector * FLASH_FILE_SECTOR_SIZE, erased, FLASH_FILE_SECTOR_SIZE, 1);
+        ctx->stats.erases++;
+        flash_busy(ctx, ctx->timing.command_us + ctx->timing.erase_sector_us);
+    }
+}
+
+size_t rtos_qspi_flash_sector_size_get(rtos_qspi_flash_t *ctx)
+{
+    (void)ctx;
+    return FLASH_FILE_SECTOR_SIZE;
+}
+
+size_t rtos_qspi_flash_size_get(rtos_qspi_flash_t *ctx)
+{
+    return ctx->size;
+}
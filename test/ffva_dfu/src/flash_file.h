@@ -0,0 +1,64 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "rtos_qspi_flash.h"
+
+// File backed stand-in for the QSPI flash, implementing the rtos_qspi_flash_* calls made by the DFU code. It behaves
+// as NOR flash: an erase sets a sector to 0xFF and a program can only clear bits, so a missing erase corrupts the data.
+// Every operation is counted, and timed with a model of a typical QSPI NOR flash.
+
+#define FLASH_FILE_SECTOR_SIZE  (4096)
+#define FLASH_FILE_PAGE_SIZE    (256)
+
+typedef struct {
+    double read_us_per_byte;    // Read time per byte
+    double erase_sector_us;     // Erase time per sector
+    double program_page_us;     // Program time per (part of a) page
+    double command_us;          // Command and address overhead per operation
+} flash_file_timing_t;
+
+typedef struct {
+    unsigned reads;             // rtos_qspi_flash_read() calls
+    unsigned erases;            // Sectors erased
+    unsigned programs;          // rtos_qspi_flash_write() calls
+    size_t read_bytes;
+    size_t program_bytes;
+    double busy_us;             // Modelled time the flash was busy
+} flash_file_stats_t;
+
+struct flash_file_struct {
+    FILE *file;
+    size_t size;
+    flash_file_timing_t timing;
+    flash_file_stats_t stats;
+    unsigned lock_depth;
+    void (*busy)(double us);    // If set, called with the modelled time of each operation, to wait for it
+};
+
+typedef struct flash_file_struct flash_file_t;
+
+/// @brief Typical QSPI NOR flash timing: 4 bit reads at 50MHz, 45ms sector erase and 0.7ms page program
+extern const flash_file_timing_t flash_file_typical_timing;
+
+/// @brief Create a flash of size bytes, erased
+/// @param flash    Flash state
+/// @param path     Backing file, or NULL for an anonymous temporary file
+/// @param size     Flash size in bytes, a multiple of FLASH_FILE_SECTOR_SIZE
+void flash_file_open(flash_file_t *flash, const char *path, size_t size);
+
+/// @brief Close the backing file
+void flash_file_close(flash_file_t *flash);
+
+/// @brief Zero the operation counters and modelled time
+void flash_file_stats_reset(flash_file_t *flash);
+
+/// @brief Set flash contents directly, without counting or timing it
+void flash_file_poke(flash_file_t *flash, unsigned address, const uint8_t *data, size_t len);
+
+/// @brief Get flash contents directly, without counting or timing it
+void flash_file_peek(flash_file_t *flash, unsigned address, uint8_t *data, size_t len);
@@ -0,0 +1,54 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the FreeRTOS API used by the FFVA DFU code, implemented by int_sim/rtos_sim.c
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef struct sim_task *TaskHandle_t;
+typedef struct sim_queue *QueueHandle_t;
+typedef struct sim_queue *SemaphoreHandle_t;
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement
+} eNotifyAction;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  1
+#define pdFAIL  0
+
+#define portMAX_DELAY   0xFFFFFFFF
+
+#define RTOS_THREAD_STACK_SIZE(thread_entry) 0
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack_words, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear_on_exit, TickType_t ticks);
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *ptr);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+#define xSemaphoreGive(sem)         xQueueSend((sem), NULL, 0)
+#define xSemaphoreTake(sem, ticks)  xQueueReceive((sem), NULL, (ticks))
+#define uxSemaphoreGetCount(sem)    uxQueueMessagesWaiting(sem)
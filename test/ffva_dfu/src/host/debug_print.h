@@ -0,0 +1,6 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdio.h>
+#define debug_printf(...) ((void)0)
@@ -0,0 +1,35 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the device side device control API. The simulated host calls the servicer callbacks directly,
+// so the transport and servicer registration functions are never used.
+
+#include <stddef.h>
+
+#include "device_control_shared.h"
+#include "rtos_osal.h"
+#include "xassert.h"
+
+#define DEVICE_CONTROL_CALLBACK_ATTR
+
+typedef struct {
+    int unused;
+} device_control_t;
+
+typedef struct {
+    int unused;
+} device_control_servicer_t;
+
+typedef control_ret_t (*device_control_read_cmd_cb_t)(control_resid_t resid, control_cmd_t cmd, uint8_t *payload,
+                                                      size_t payload_len, void *app_data);
+typedef control_ret_t (*device_control_write_cmd_cb_t)(control_resid_t resid, control_cmd_t cmd,
+                                                       const uint8_t *payload, size_t payload_len, void *app_data);
+
+control_ret_t device_control_servicer_register(device_control_servicer_t *ctx, device_control_t *device_control_ctx[],
+                                               size_t device_control_ctx_count, const control_resid_t resources[],
+                                               size_t num_resources);
+
+control_ret_t device_control_servicer_cmd_recv(device_control_servicer_t *ctx, device_control_read_cmd_cb_t read_cmd_cb,
+                                               device_control_write_cmd_cb_t write_cmd_cb, void *app_data,
+                                               unsigned timeout);
@@ -0,0 +1,27 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the device control types shared by the device and the host
+
+#include <stdint.h>
+
+typedef uint8_t control_resid_t;
+typedef uint8_t control_cmd_t;
+
+typedef enum {
+    CONTROL_SUCCESS = 0,
+    CONTROL_REGISTRATION_FAILED,
+    CONTROL_BAD_COMMAND,
+    CONTROL_DATA_LENGTH_ERROR,
+    CONTROL_OTHER_TRANSPORT_ERROR,
+    CONTROL_ERROR,
+    SERVICER_COMMAND_RETRY,
+    SERVICER_WRONG_COMMAND_ID,
+    SERVICER_WRONG_COMMAND_LEN,
+    SERVICER_WRONG_PAYLOAD,
+    SERVICER_QUEUE_FULL,
+    SERVICER_RESOURCE_ERROR,
+} control_ret_t;
+
+#define CONTROL_CMD_SET_READ(c) ((c) | 0x80)
@@ -0,0 +1,8 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the xcore platform header, as a single tile
+
+#define THIS_XCORE_TILE     0
+#define ON_TILE(t)          ((t) == THIS_XCORE_TILE)
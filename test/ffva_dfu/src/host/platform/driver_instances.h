@@ -0,0 +1,30 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include "rtos_qspi_flash.h"
+#include "rtos_dfu_image.h"
+#include "rtos_intertile.h"
+
+extern rtos_qspi_flash_t *qspi_flash_ctx;
+extern rtos_dfu_image_t *dfu_image_ctx;
+extern rtos_intertile_t *intertile_ctx;
+
+/* The watchdog writes in reboot() are counted and otherwise ignored */
+extern unsigned host_reboot_count;
+
+#define XS1_SSWITCH_WATCHDOG_PRESCALER_WRAP_NUM 0
+#define XS1_SSWITCH_WATCHDOG_COUNT_NUM          1
+#define XS1_SSWITCH_WATCHDOG_PRESCALER_NUM      2
+#define XS1_SSWITCH_WATCHDOG_CFG_NUM            3
+#define XS1_WATCHDOG_COUNT_ENABLE_SHIFT         0
+#define XS1_WATCHDOG_TRIGGER_ENABLE_SHIFT       1
+
+static inline unsigned get_local_tile_id(void) { return 0; }
+static inline void write_sswitch_reg_no_ack(unsigned tile, unsigned reg, unsigned value)
+{
+    (void)tile; (void)value;
+    if (reg == XS1_SSWITCH_WATCHDOG_CFG_NUM) {
+        host_reboot_count++;
+    }
+}
@@ -0,0 +1,22 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#define appconfI2C_DFU_ENABLED  1
+#define APP_CONTROL_TRANSPORT_COUNT appconfI2C_DFU_ENABLED
+#define I2C_CTRL_TILE_NO        0
+
+#define appconfAUDIO_PIPELINE_TUNING_PORT   9
+
+#define appconfUSB_ENABLED      1
+#define appconfI2S_ENABLED      1
+#define appconfAEC_REF_USB      0
+#define appconfAEC_REF_I2S      1
+#define appconfAEC_REF_DEFAULT  appconfAEC_REF_I2S
+#define appconfMIC_SRC_MICS     0
+#define appconfMIC_SRC_USB      1
+#define appconfMIC_SRC_DEFAULT  appconfMIC_SRC_MICS
+
+#define APP_VERSION_MAJOR       255
+#define APP_VERSION_MINOR       254
+#define APP_VERSION_PATCH       253
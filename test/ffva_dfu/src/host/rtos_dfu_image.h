@@ -0,0 +1,19 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the RTOS DFU image API used by the FFVA DFU code. The test sets the flash layout.
+
+typedef struct {
+    unsigned factory_addr;
+    unsigned factory_size;
+    unsigned upgrade_addr;
+    unsigned upgrade_size;
+    unsigned data_partition_addr;
+} rtos_dfu_image_t;
+
+static inline unsigned rtos_dfu_image_get_factory_addr(rtos_dfu_image_t *ctx) { return ctx->factory_addr; }
+static inline unsigned rtos_dfu_image_get_factory_size(rtos_dfu_image_t *ctx) { return ctx->factory_size; }
+static inline unsigned rtos_dfu_image_get_upgrade_addr(rtos_dfu_image_t *ctx) { return ctx->upgrade_addr; }
+static inline unsigned rtos_dfu_image_get_upgrade_size(rtos_dfu_image_t *ctx) { return ctx->upgrade_size; }
+static inline unsigned rtos_dfu_image_get_data_partition_addr(rtos_dfu_image_t *ctx) { return ctx->data_partition_addr; }
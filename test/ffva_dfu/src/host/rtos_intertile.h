@@ -0,0 +1,16 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the RTOS intertile API used by the FFVA audio pipeline tuning servicer. The test implements it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int unused;
+} rtos_intertile_t;
+
+void rtos_intertile_tx(rtos_intertile_t *ctx, uint8_t port, const void *msg, size_t len);
+size_t rtos_intertile_rx_len(rtos_intertile_t *ctx, uint8_t port, unsigned timeout);
+size_t rtos_intertile_rx_data(rtos_intertile_t *ctx, void *data, size_t len);
@@ -0,0 +1,10 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include "FreeRTOS.h"
+
+#define RTOS_OSAL_WAIT_FOREVER  0xFFFFFFFF
+#define RTOS_OSAL_NO_WAIT       0
+
+int rtos_core_id_get(void);
@@ -0,0 +1,22 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// Host stand-in for the RTOS QSPI flash driver API used by the FFVA DFU code, implemented by flash_file.c
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "xassert.h"
+
+#define rtos_printf(...) ((void)0)
+
+typedef struct flash_file_struct rtos_qspi_flash_t;
+
+void rtos_qspi_flash_lock(rtos_qspi_flash_t *ctx);
+void rtos_qspi_flash_unlock(rtos_qspi_flash_t *ctx);
+void rtos_qspi_flash_read(rtos_qspi_flash_t *ctx, uint8_t *data, unsigned address, size_t len);
+void rtos_qspi_flash_write(rtos_qspi_flash_t *ctx, const uint8_t *data, unsigned address, size_t len);
+void rtos_qspi_flash_erase(rtos_qspi_flash_t *ctx, unsigned address, size_t len);
+size_t rtos_qspi_flash_sector_size_get(rtos_qspi_flash_t *ctx);
+size_t rtos_qspi_flash_size_get(rtos_qspi_flash_t *ctx);
@@ -0,0 +1,11 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdint.h>
+
+// The reference time is the virtual time of the RTOS simulation
+
+#define XS1_TIMER_KHZ   100000
+
+uint32_t get_reference_time(void);
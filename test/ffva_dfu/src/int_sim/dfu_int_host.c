@@ -0,0 +1,290 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+
+#include "xassert.h"
+#include "dfu_cmds.h"
+#include "rtos_sim.h"
+#include "dfu_int_host.h"
+
+// Device control frames a write as the device address, resource ID, command ID and payload length followed by the
+// payload, then a second transaction reads back the device address and a status byte. A read writes the same header,
+// then reads back the device address, a status byte and the payload.
+#define WRITE_HEADER_BYTES  (4)
+#define WRITE_STATUS_BYTES  (2)
+#define READ_HEADER_BYTES   (4 + 2)
+
+#define MAX_PAYLOAD_BYTES   (2 + DFU_DATA_XFER_MAX_SIZE)
+
+const dfu_int_host_timing_t dfu_int_host_i2c_400k = {
+    .byte_us = 9 / 0.4,
+    .transaction_us = 100,
+    .min_poll_us = 1000,
+};
+
+dfu_int_host_timing_t dfu_int_host_timing = {
+    .byte_us = 9 / 0.4,
+    .transaction_us = 100,
+    .min_poll_us = 1000,
+};
+
+dfu_int_host_stats_t dfu_int_host_stats;
+
+uint16_t dfu_int_host_xfer_size = DFU_DATA_XFER_SIZE;
+
+static servicer_t *dfu_servicer_state = NULL;
+
+void dfu_int_host_connect(servicer_t *servicer)
+{
+    dfu_servicer_state = servicer;
+    dfu_int_host_xfer_size = DFU_DATA_XFER_SIZE;
+}
+
+// dfu_servicer() is not run, as the host calls the servicer callbacks directly
+control_ret_t device_control_servicer_register(device_control_servicer_t *ctx, device_control_t *device_control_ctx[],
+                                               size_t device_control_ctx_count, const control_resid_t resources[],
+                                               size_t num_resources)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t device_control_servicer_cmd_recv(device_control_servicer_t *ctx, device_control_read_cmd_cb_t read_cmd_cb,
+                                               device_control_write_cmd_cb_t write_cmd_cb, void *app_data,
+                                               unsigned timeout)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+// The tuning servicer's resource isn't registered in this simulation, so the servicer never routes commands to it
+control_ret_t tuning_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+control_ret_t tuning_servicer_write_cmd(control_resource_info_t *res_info, control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+// Nor is the telemetry servicer's
+control_ret_t telemetry_servicer_read_cmd(control_resource_info_t *res_info, control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    xassert(0);
+    return CONTROL_ERROR;
+}
+
+static control_ret_t i2c_write_cmd(control_cmd_t cmd, const uint8_t *payload, size_t payload_len)
+{
+    rtos_sim_sleep_us(dfu_int_host_timing.transaction_us + (WRITE_HEADER_BYTES + payload_len) * dfu_int_host_timing.byte_us);
+    control_ret_t ret = write_cmd(DFU_CONTROLLER_SERVICER_RESID, cmd, payload, payload_len, dfu_servicer_state);
+    rtos_sim_sleep_us(dfu_int_host_timing.transaction_us + WRITE_STATUS_BYTES * dfu_int_host_timing.byte_us);
+    dfu_int_host_stats.transactions += 2;
+    return ret;
+}
+
+static control_ret_t i2c_read_cmd(control_cmd_t cmd, uint8_t *payload, size_t payload_len)
+{
+    uint8_t response[1 + MAX_PAYLOAD_BYTES];
+
+    xassert(payload_len <= MAX_PAYLOAD_BYTES);
+    rtos_sim_sleep_us(dfu_int_host_timing.transaction_us + WRITE_HEADER_BYTES * dfu_int_host_timing.byte_us);
+    control_ret_t ret = read_cmd(DFU_CONTROLLER_SERVICER_RESID, CONTROL_CMD_SET_READ(cmd), response, 1 + payload_len,
+                                 dfu_servicer_state);
+    rtos_sim_sleep_us((READ_HEADER_BYTES - WRITE_HEADER_BYTES + payload_len) * dfu_int_host_timing.byte_us);
+    dfu_int_host_stats.transactions += 1;
+    xassert(response[0] == ret);
+    memcpy(payload, &response[1], payload_len);
+    return ret;
+}
+
+control_ret_t dfu_int_host_set_alternate(uint8_t alt)
+{
+    control_ret_t ret = i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE, &alt, 1);
+    if (ret == CONTROL_SUCCESS) {
+        dfu_int_host_xfer_size = DFU_DATA_XFER_SIZE;
+    }
+    return ret;
+}
+
+control_ret_t dfu_int_host_set_transfer_size(uint16_t size)
+{
+    uint8_t payload[2] = {size & 0xFF, (size >> 8) & 0xFF};
+
+    return i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE, payload, sizeof(payload));
+}
+
+uint16_t dfu_int_host_get_transfer_size(void)
+{
+    uint8_t payload[2];
+
+    control_ret_t ret = i2c_read_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_TRANSFERSIZE, payload, sizeof(payload));
+    xassert(ret == CONTROL_SUCCESS);
+    return payload[0] + (payload[1] << 8);
+}
+
+control_ret_t dfu_int_host_set_payload_format(uint8_t format)
+{
+    return i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT, &format, 1);
+}
+
+uint8_t dfu_int_host_get_payload_format(void)
+{
+    uint8_t format;
+
+    control_ret_t ret = i2c_read_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_PAYLOADFORMAT, &format, 1);
+    xassert(ret == CONTROL_SUCCESS);
+    return format;
+}
+
+control_ret_t dfu_int_host_dnload(const uint8_t *data, uint16_t length)
+{
+    uint8_t payload[MAX_PAYLOAD_BYTES] = {0};
+
+    payload[0] = length & 0xFF;
+    payload[1] = (length >> 8) & 0xFF;
+    if (length > 0) {
+        memcpy(&payload[2], data, (length < dfu_int_host_xfer_size) ? length : dfu_int_host_xfer_size);
+    }
+    dfu_int_host_stats.dnloads++;
+    return i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_DNLOAD, payload, 2 + dfu_int_host_xfer_size);
+}
+
+void dfu_int_host_get_status(dfu_int_get_status_packet_t *status)
+{
+    uint8_t payload[5];
+
+    control_ret_t ret = i2c_read_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_GETSTATUS, payload, sizeof(payload));
+    xassert(ret == CONTROL_SUCCESS);
+    status->current_status = payload[0];
+    status->timeout_ms = payload[1] + (payload[2] << 8) + (payload[3] << 16);
+    status->next_state = payload[4];
+    dfu_int_host_stats.getstatus++;
+}
+
+dfu_int_state_t dfu_int_host_get_state(void)
+{
+    uint8_t state;
+
+    control_ret_t ret = i2c_read_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_GETSTATE, &state, 1);
+    xassert(ret == CONTROL_SUCCESS);
+    return state;
+}
+
+void dfu_int_host_abort(void)
+{
+    uint8_t unused = 0;
+
+    control_ret_t ret = i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_ABORT, &unused, 1);
+    xassert(ret == CONTROL_SUCCESS);
+}
+
+void dfu_int_host_clear_status(void)
+{
+    uint8_t unused = 0;
+
+    control_ret_t ret = i2c_write_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_CLRSTATUS, &unused, 1);
+    xassert(ret == CONTROL_SUCCESS);
+}
+
+size_t dfu_int_host_upload(uint8_t *data)
+{
+    uint8_t payload[MAX_PAYLOAD_BYTES];
+
+    control_ret_t ret = i2c_read_cmd(DFU_CONTROLLER_SERVICER_RESID_DFU_UPLOAD, payload, 2 + dfu_int_host_xfer_size);
+    xassert(ret == CONTROL_SUCCESS);
+    memcpy(data, &payload[2], dfu_int_host_xfer_size);
+    return payload[0] + (payload[1] << 8);
+}
+
+uint16_t dfu_int_host_negotiate(uint16_t size)
+{
+    if ((size != DFU_DATA_XFER_SIZE) && (dfu_int_host_set_transfer_size(size) == CONTROL_SUCCESS)) {
+        dfu_int_host_xfer_size = dfu_int_host_get_transfer_size();
+    }
+    return dfu_int_host_xfer_size;
+}
+
+dfu_int_get_status_packet_t dfu_int_host_wait_idle(void)
+{
+    dfu_int_get_status_packet_t status;
+
+    while (1) {
+        dfu_int_host_get_status(&status);
+        if ((status.next_state != DFU_INT_DFU_DNBUSY) && (status.next_state != DFU_INT_DFU_MANIFEST) &&
+            (status.next_state != DFU_INT_DFU_MANIFEST_SYNC)) {
+            return status;
+        }
+        double wait_us = (status.timeout_ms > 0) ? status.timeout_ms * 1000.0 : dfu_int_host_timing.min_poll_us;
+        rtos_sim_sleep_us(wait_us);
+        dfu_int_host_stats.wait_us += wait_us;
+    }
+}
+
+/* Sends len bytes of data in DNLOAD payloads of the current transfer size, and ends the download */
+static dfu_int_get_status_packet_t dnload_all(const uint8_t *data, size_t len, unsigned stop_after)
+{
+    dfu_int_get_status_packet_t status;
+    unsigned payloads = 0;
+    const uint16_t xfer_size = dfu_int_host_xfer_size;
+
+    for (size_t offset = 0; offset < len; offset += xfer_size) {
+        size_t payload_len = (len - offset < xfer_size) ? (len - offset) : xfer_size;
+        control_ret_t ret = dfu_int_host_dnload(&data[offset], payload_len);
+        xassert(ret == CONTROL_SUCCESS);
+        status = dfu_int_host_wait_idle();
+        if (status.next_state != DFU_INT_DFU_DNLOAD_IDLE) {
+            return status;
+        }
+        if (++payloads == stop_after) {
+            return status;
+        }
+    }
+    dfu_int_host_dnload(NULL, 0);
+    return dfu_int_host_wait_idle();
+}
+
+dfu_int_get_status_packet_t dfu_int_host_download(uint8_t alt, uint16_t xfer_size, const uint8_t *image, size_t len,
+                                                  unsigned stop_after)
+{
+    control_ret_t ret = dfu_int_host_set_alternate(alt);
+    xassert(ret == CONTROL_SUCCESS);
+    dfu_int_host_negotiate(xfer_size);
+    return dnload_all(image, len, stop_after);
+}
+
+dfu_int_get_status_packet_t dfu_int_host_download_compressed(uint8_t alt, uint16_t xfer_size,
+                                                             const uint8_t *compressed, size_t len)
+{
+    control_ret_t ret = dfu_int_host_set_alternate(alt);
+    xassert(ret == CONTROL_SUCCESS);
+    dfu_int_host_negotiate(xfer_size);
+    ret = dfu_int_host_set_payload_format(DFU_INT_PAYLOAD_FORMAT_LZ);
+    xassert(ret == CONTROL_SUCCESS);
+    return dnload_all(compressed, len, 0);
+}
+
+size_t dfu_int_host_upload_all(uint8_t alt, uint16_t xfer_size, uint8_t *image, size_t max_len)
+{
+    uint8_t payload[DFU_DATA_XFER_MAX_SIZE];
+    size_t total = 0;
+
+    control_ret_t ret = dfu_int_host_set_alternate(alt);
+    xassert(ret == CONTROL_SUCCESS);
+    xfer_size = dfu_int_host_negotiate(xfer_size);
+    while (1) {
+        size_t len = dfu_int_host_upload(payload);
+        if (total + len > max_len) {
+            break;
+        }
+        memcpy(&image[total], payload, len);
+        total += len;
+        if (len < xfer_size) {
+            break;
+        }
+    }
+    return total;
+}
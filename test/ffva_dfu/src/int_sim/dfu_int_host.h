@@ -0,0 +1,89 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "servicer.h"
+#include "dfu_servicer.h"
+#include "dfu_state_machine.h"
+
+// Model of a host driving the DFU state machine over the device control I2C transport. Each command takes the time
+// to transfer its bytes on the bus, in virtual time, and is looped back to the DFU servicer's device control read and
+// write callbacks, so it goes through the servicer's command validation as it would on the device. Must be called
+// from an rtos_sim task.
+
+typedef struct {
+    double byte_us;             // Time per byte on the bus, including the ACK bit
+    double transaction_us;      // Host overhead per I2C transaction
+    double min_poll_us;         // Time between GETSTATUS polls when the device asks for no wait
+} dfu_int_host_timing_t;
+
+typedef struct {
+    unsigned transactions;      // I2C transactions, a write command takes two and a read command one
+    unsigned dnloads;           // DNLOAD requests, including the zero length one
+    unsigned getstatus;         // GETSTATUS requests
+    double wait_us;             // Time spent waiting for the timeouts the device asked for
+} dfu_int_host_stats_t;
+
+/// @brief 400kHz I2C, with 100us of host overhead per transaction and 1ms polls
+extern const dfu_int_host_timing_t dfu_int_host_i2c_400k;
+
+extern dfu_int_host_timing_t dfu_int_host_timing;
+extern dfu_int_host_stats_t dfu_int_host_stats;
+
+/// @brief Size of the data in the DNLOAD and UPLOAD payloads the host sends and expects. Reset to DFU_DATA_XFER_SIZE
+/// by dfu_int_host_set_alternate(), as the device does, and set by dfu_int_host_negotiate().
+extern uint16_t dfu_int_host_xfer_size;
+
+/// @brief Connect the host to a DFU servicer, initialised with dfu_servicer_init()
+void dfu_int_host_connect(servicer_t *servicer);
+
+control_ret_t dfu_int_host_set_alternate(uint8_t alt);
+control_ret_t dfu_int_host_set_transfer_size(uint16_t size);
+uint16_t dfu_int_host_get_transfer_size(void);
+control_ret_t dfu_int_host_set_payload_format(uint8_t format);
+uint8_t dfu_int_host_get_payload_format(void);
+control_ret_t dfu_int_host_dnload(const uint8_t *data, uint16_t length);
+void dfu_int_host_get_status(dfu_int_get_status_packet_t *status);
+dfu_int_state_t dfu_int_host_get_state(void);
+void dfu_int_host_abort(void);
+void dfu_int_host_clear_status(void);
+size_t dfu_int_host_upload(uint8_t *data);
+
+/// @brief Ask the device for a transfer size, as a host that negotiates does after setting the alternate. A device
+/// that does not support the TRANSFERSIZE command, or refuses the size, keeps DFU_DATA_XFER_SIZE.
+/// @param size             Transfer size wanted. DFU_DATA_XFER_SIZE sends nothing, as a host that does not negotiate.
+/// @return uint16_t        Transfer size in use
+uint16_t dfu_int_host_negotiate(uint16_t size);
+
+/// @brief Wait out the timeout of a DNLOAD, polling GETSTATUS until the state machine reaches a state it won't leave
+/// on its own
+/// @return dfu_int_get_status_packet_t     Last status received
+dfu_int_get_status_packet_t dfu_int_host_wait_idle(void);
+
+/// @brief Download len bytes of image to alt, as the host application does, one payload at a time
+/// @param alt              Alternate setting
+/// @param xfer_size        Transfer size to negotiate, see dfu_int_host_negotiate()
+/// @param image            Image data
+/// @param len              Image length in bytes
+/// @param stop_after       If non-zero, stop without ending the download after this many payloads
+/// @return dfu_int_get_status_packet_t     Last status received. next_state is DFU_INT_DFU_IDLE if the download
+///                                         completed, or DFU_INT_DFU_DNLOAD_IDLE if it was stopped
+dfu_int_get_status_packet_t dfu_int_host_download(uint8_t alt, uint16_t xfer_size, const uint8_t *image, size_t len,
+                                                  unsigned stop_after);
+
+/// @brief Download an image compressed by dfu_lz_compress() to alt, with DFU_PAYLOADFORMAT set to compressed
+/// @param alt              Alternate setting
+/// @param xfer_size        Transfer size to negotiate, see dfu_int_host_negotiate()
+/// @param compressed       Compressed image data
+/// @param len              Compressed image length in bytes
+/// @return dfu_int_get_status_packet_t     Last status received
+dfu_int_get_status_packet_t dfu_int_host_download_compressed(uint8_t alt, uint16_t xfer_size,
+                                                             const uint8_t *compressed, size_t len);
+
+/// @brief Upload alt, as the host application does
+/// @param xfer_size        Transfer size to negotiate, see dfu_int_host_negotiate()
+/// @return size_t          Bytes uploaded
+size_t dfu_int_host_upload_all(uint8_t alt, uint16_t xfer_size, uint8_t *image, size_t max_len);
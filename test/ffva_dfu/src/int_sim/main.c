@@ -0,0 +1,735 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "flash_file.h"
+#include "platform/driver_instances.h"
+#include "dfu_cmds.h"
+#include "rtos_sim.h"
+#include "dfu_int_host.h"
+#include "dfu_delta_make.h"
+#include "dfu_lz_compress.h"
+
+#define FLASH_SIZE          (0x200000)
+#define UPGRADE_ADDR        (0x80000)
+#define DATA_PARTITION_ADDR (0x180000)
+#define SECTOR              (FLASH_FILE_SECTOR_SIZE)
+#define UPGRADE_SECTORS     ((DATA_PARTITION_ADDR - UPGRADE_ADDR) / SECTOR)
+#define PAYLOADS_PER_SECTOR (SECTOR / DFU_DATA_XFER_SIZE)
+
+#if DFU_INT_PIPELINED_WRITE
+#define MODE "pipelined"
+#else
+#define MODE "serial"
+#endif
+
+static flash_file_t flash;
+static rtos_dfu_image_t dfu_image;
+static servicer_t servicer;
+rtos_qspi_flash_t *qspi_flash_ctx = &flash;
+rtos_dfu_image_t *dfu_image_ctx = &dfu_image;
+unsigned host_reboot_count = 0;
+
+static uint8_t image[(UPGRADE_SECTORS + 1) * SECTOR];
+static uint8_t readback[(UPGRADE_SECTORS + 1) * SECTOR];
+static uint8_t current[UPGRADE_SECTORS * SECTOR];
+static uint8_t delta[DFU_DELTA_HEADER_SIZE + UPGRADE_SECTORS * (DFU_DELTA_RECORD_SIZE + SECTOR) + SECTOR];
+static size_t delta_len;
+static uint8_t compressed[(UPGRADE_SECTORS + 2) * SECTOR];
+static size_t compressed_len;
+
+static uint32_t rand_state;
+
+static void rand_fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 17;
+        rand_state ^= rand_state << 5;
+        buf[i] = rand_state >> 24;
+    }
+}
+
+/* Fills the flash with random data, as left by earlier images */
+static void flash_reset(uint32_t seed, const flash_file_timing_t *timing)
+{
+    static uint8_t junk[SECTOR];
+
+    rand_state = seed | 1;
+    for (unsigned addr = 0; addr < FLASH_SIZE; addr += SECTOR) {
+        rand_fill(junk, SECTOR);
+        flash_file_poke(&flash, addr, junk, SECTOR);
+    }
+    flash.timing = *timing;
+    flash.busy = rtos_sim_sleep_us;
+    flash_file_stats_reset(&flash);
+    memset(&dfu_int_host_stats, 0, sizeof(dfu_int_host_stats));
+    dfu_image.factory_addr = 0;
+    dfu_image.factory_size = UPGRADE_ADDR;
+    dfu_image.upgrade_addr = UPGRADE_ADDR;
+    dfu_image.upgrade_size = 0;
+    dfu_image.data_partition_addr = DATA_PARTITION_ADDR;
+}
+
+/* Starts the DFU servicer and its state machine, and lets it initialise */
+static void device_start(void)
+{
+    dfu_servicer_init(&servicer);
+    dfu_int_host_connect(&servicer);
+    xTaskCreate(dfu_int_state_machine, "DFU state machine task", 0, NULL, 0, NULL);
+    rtos_sim_sleep_us(1);
+}
+
+static void check_download(const char *test, dfu_int_get_status_packet_t status, const uint8_t *data, size_t len)
+{
+    if ((status.next_state != DFU_INT_DFU_IDLE) || (status.current_status != DFU_INT_DFU_STATUS_OK)) {
+        printf("FAIL, %s(): download ended in state %d, status %d\n", test, status.next_state, status.current_status);
+        xassert(0);
+    }
+    flash_file_peek(&flash, UPGRADE_ADDR, readback, len);
+    if (memcmp(readback, data, len) != 0) {
+        printf("FAIL, %s(): flash does not match the image\n", test);
+        xassert(0);
+    }
+}
+
+static void check_stats(const char *test, unsigned reads, unsigned erases, unsigned programs)
+{
+    if ((flash.stats.reads != reads) || (flash.stats.erases != erases) || (flash.stats.programs != programs)) {
+        printf("FAIL, %s(): %u reads, %u erases, %u programs, expected %u, %u, %u\n", test,
+               flash.stats.reads, flash.stats.erases, flash.stats.programs, reads, erases, programs);
+        xassert(0);
+    }
+}
+
+typedef struct {
+    size_t len;
+    uint16_t xfer_size;     // Transfer size the host negotiates
+    double time_us;
+    unsigned transactions;
+} download_result_t;
+
+static void download_task(void *arg)
+{
+    download_result_t *result = arg;
+
+    device_start();
+    double start = rtos_sim_time_us();
+    dfu_int_get_status_packet_t status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, result->xfer_size, image,
+                                                               result->len, 0);
+    result->time_us = rtos_sim_time_us() - start;
+    result->transactions = dfu_int_host_stats.transactions;
+    check_download("download_task", status, image, result->len);
+}
+
+static void upload_task(void *arg)
+{
+    download_result_t *result = arg;
+
+    device_start();
+    dfu_image.upgrade_size = result->len;
+    size_t uploaded = dfu_int_host_upload_all(DFU_INT_ALTERNATE_UPGRADE, result->xfer_size, readback, sizeof(readback));
+    if ((uploaded != result->len) || (memcmp(readback, image, result->len) != 0)) {
+        printf("FAIL, upload_task(): uploaded %zu bytes, expected %zu\n", uploaded, result->len);
+        xassert(0);
+    }
+}
+
+/*
+ * Downloads an image and checks that each sector is erased and programmed once, and the only read is the one that
+ * flushes the writes at manifestation. Then uploads it again. Reports the download time, and how much of it is spent
+ * waiting for the flash by comparing with a flash that takes no time.
+ */
+void test_download_time(uint32_t seed, bool verbose)
+{
+    const unsigned sectors = 64;
+    const flash_file_timing_t no_time = {0};
+    download_result_t with_flash = {.len = sectors * SECTOR, .xfer_size = DFU_DATA_XFER_SIZE};
+    download_result_t without_flash = {.len = sectors * SECTOR, .xfer_size = DFU_DATA_XFER_SIZE};
+
+    flash_reset(seed, &no_time);
+    rand_fill(image, with_flash.len);
+    rtos_sim_run(download_task, &without_flash);
+
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, with_flash.len);
+    rtos_sim_run(download_task, &with_flash);
+    check_stats("test_download_time", 1, sectors, sectors);
+    unsigned getstatus = dfu_int_host_stats.getstatus;
+
+    rtos_sim_run(upload_task, &with_flash);
+
+    const double flash_us = with_flash.time_us - without_flash.time_us;
+    printf("%s: %zu kB download %.2f s, %.1f kB/s, %u GETSTATUS, waiting for flash %.2f s (%.0f%%)\n", MODE,
+           with_flash.len / 1024, with_flash.time_us * 1e-6, with_flash.len / with_flash.time_us * 1e3, getstatus,
+           flash_us * 1e-6, 100 * flash_us / with_flash.time_us);
+#if DFU_INT_PIPELINED_WRITE
+    /* Only the program of the last sector can't overlap the transfer */
+    const double last_sector_us = flash_file_typical_timing.erase_sector_us +
+                                  (SECTOR / FLASH_FILE_PAGE_SIZE) * flash_file_typical_timing.program_page_us;
+    if (flash_us > last_sector_us + 2 * dfu_int_host_timing.min_poll_us) {
+        printf("FAIL, test_download_time(): %.1f ms waiting for the flash, expected at most %.1f ms\n",
+               flash_us * 1e-3, last_sector_us * 1e-3);
+        xassert(0);
+    }
+#endif
+    if (verbose) {
+        printf("download time passes\n");
+    }
+}
+
+/*
+ * Downloads over a bus fast enough for the flash to be the bottleneck, so each complete sector has to wait for the
+ * previous one to be programmed before it can be handed over.
+ */
+void test_flash_bound(uint32_t seed, bool verbose)
+{
+    download_result_t result = {.len = 16 * SECTOR, .xfer_size = DFU_DATA_XFER_SIZE};
+
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, result.len);
+    dfu_int_host_timing.byte_us = 9 / 3.4;
+    dfu_int_host_timing.transaction_us = 10;
+    rtos_sim_run(download_task, &result);
+    dfu_int_host_timing = dfu_int_host_i2c_400k;
+
+    check_stats("test_flash_bound", 1, 16, 16);
+    if (verbose) {
+        printf("%s: %zu kB download over 3.4MHz I2C %.2f s, %.1f kB/s\n", MODE,
+               result.len / 1024, result.time_us * 1e-6, result.len / result.time_us * 1e3);
+        printf("flash bound passes\n");
+    }
+}
+
+typedef struct {
+    unsigned stop_after;    // Payloads of the first image sent before the abort
+    size_t len;             // Length of the second image
+} abort_params_t;
+
+static void abort_task(void *arg)
+{
+    abort_params_t *params = arg;
+    static uint8_t first[UPGRADE_SECTORS * SECTOR];
+
+    device_start();
+    rand_fill(first, params->stop_after * DFU_DATA_XFER_SIZE);
+    dfu_int_get_status_packet_t status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, first,
+                                                               sizeof(first), params->stop_after);
+    xassert(status.next_state == DFU_INT_DFU_DNLOAD_IDLE);
+    dfu_int_host_abort();
+    if (dfu_int_host_get_state() != DFU_INT_DFU_IDLE) {
+        printf("FAIL, abort_task(): not idle after abort after %u payloads\n", params->stop_after);
+        xassert(0);
+    }
+
+    status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, image, params->len, 0);
+    check_download("abort_task", status, image, params->len);
+}
+
+/*
+ * Aborts a download part way through a sector, just after a sector completes while it is being programmed, and just
+ * after the first payload of a sector while it is being erased. Each time, checks that the next download starts
+ * again from the start of the partition and is written correctly.
+ */
+void test_abort_mid_block(uint32_t seed, bool verbose)
+{
+    const abort_params_t params[] = {
+        {.stop_after = 10 * PAYLOADS_PER_SECTOR + PAYLOADS_PER_SECTOR / 2, .len = 12 * SECTOR},
+        {.stop_after = 10 * PAYLOADS_PER_SECTOR, .len = 3 * SECTOR},
+        {.stop_after = 10 * PAYLOADS_PER_SECTOR + 1, .len = 11 * SECTOR},
+        {.stop_after = 1, .len = 2 * SECTOR},
+    };
+
+    for (unsigned i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+        abort_params_t p = params[i];
+        flash_reset(seed + i, &flash_file_typical_timing);
+        rand_fill(image, p.len);
+        rtos_sim_run(abort_task, &p);
+    }
+    if (verbose) {
+        printf("abort mid block passes\n");
+    }
+}
+
+static void error_task(void *arg)
+{
+    (void)arg;
+
+    device_start();
+    dfu_int_get_status_packet_t status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, image,
+                                                               (UPGRADE_SECTORS + 1) * SECTOR, 0);
+    if ((status.next_state != DFU_INT_DFU_ERROR) || (status.current_status != DFU_INT_DFU_STATUS_ERR_ADDRESS)) {
+        printf("FAIL, error_task(): oversized download ended in state %d, status %d\n",
+               status.next_state, status.current_status);
+        xassert(0);
+    }
+    dfu_int_host_clear_status();
+    if (dfu_int_host_get_state() != DFU_INT_DFU_IDLE) {
+        printf("FAIL, error_task(): not idle after clearing the error\n");
+        xassert(0);
+    }
+
+    status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, image, 4 * SECTOR, 0);
+    check_download("error_task", status, image, 4 * SECTOR);
+}
+
+/*
+ * Downloads an image larger than the upgrade partition and checks that the error writing past the end is reported,
+ * and that a download after clearing it works.
+ */
+void test_error_reported(uint32_t seed, bool verbose)
+{
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, (UPGRADE_SECTORS + 1) * SECTOR);
+    rtos_sim_run(error_task, NULL);
+    if (verbose) {
+        printf("error reported passes\n");
+    }
+}
+
+/*
+ * Downloads and uploads a representative image with the default transfer size, as a host that does not negotiate
+ * does, and with larger ones, including one that does not divide the sector size, so payloads span two sectors.
+ * Checks that each payload takes one DNLOAD and that the image is written and read back intact. Reports the
+ * transactions and time taken for each size.
+ */
+void test_transfer_size(uint32_t seed, bool verbose)
+{
+    const uint16_t sizes[] = {DFU_DATA_XFER_SIZE, 200, DFU_DATA_XFER_MAX_SIZE};
+    const size_t len = 128 * SECTOR;
+    download_result_t results[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        download_result_t *result = &results[i];
+        *result = (download_result_t){.len = len, .xfer_size = sizes[i]};
+
+        flash_reset(seed + i, &flash_file_typical_timing);
+        rand_fill(image, len);
+        rtos_sim_run(download_task, result);
+        check_stats("test_transfer_size", 1, len / SECTOR, len / SECTOR);
+
+        unsigned expected_dnloads = (len + sizes[i] - 1) / sizes[i] + 1;
+        if (dfu_int_host_stats.dnloads != expected_dnloads) {
+            printf("FAIL, test_transfer_size(): %u DNLOADs with transfer size %u, expected %u\n",
+                   dfu_int_host_stats.dnloads, sizes[i], expected_dnloads);
+            xassert(0);
+        }
+        rtos_sim_run(upload_task, result);
+
+        printf("%s: %zu kB download with %u byte transfers, %u transactions, %.2f s, %.1f kB/s\n", MODE, len / 1024,
+               sizes[i], result->transactions, result->time_us * 1e-6, len / result->time_us * 1e3);
+    }
+
+    const download_result_t *base = &results[0];
+    const download_result_t *max = &results[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    printf("%s: %u byte transfers take %.0f%% fewer transactions and %.0f%% less time than %u byte transfers\n",
+           MODE, max->xfer_size, 100 * (1 - (double)max->transactions / base->transactions),
+           100 * (1 - max->time_us / base->time_us), base->xfer_size);
+    if (max->time_us >= base->time_us) {
+        printf("FAIL, test_transfer_size(): %u byte transfers are no faster than %u byte transfers\n",
+               max->xfer_size, base->xfer_size);
+        xassert(0);
+    }
+    if (verbose) {
+        printf("transfer size passes\n");
+    }
+}
+
+static void check_ret(const char *what, control_ret_t ret, control_ret_t expected)
+{
+    if (ret != expected) {
+        printf("FAIL, transfer_size_task(): %s returned %d, expected %d\n", what, ret, expected);
+        xassert(0);
+    }
+}
+
+static void check_value(const char *what, unsigned value, unsigned expected)
+{
+    if (value != expected) {
+        printf("FAIL, transfer_size_task(): %s was %u, expected %u\n", what, value, expected);
+        xassert(0);
+    }
+}
+
+static void transfer_size_task(void *arg)
+{
+    (void)arg;
+    const uint16_t size = DFU_DATA_XFER_MAX_SIZE;
+
+    device_start();
+    check_ret("SETALTERNATE", dfu_int_host_set_alternate(DFU_INT_ALTERNATE_UPGRADE), CONTROL_SUCCESS);
+    check_ret("TRANSFERSIZE 0", dfu_int_host_set_transfer_size(0), CONTROL_ERROR);
+    check_ret("TRANSFERSIZE too large", dfu_int_host_set_transfer_size(DFU_DATA_XFER_MAX_SIZE + 1), CONTROL_ERROR);
+    check_value("transfer size", dfu_int_host_get_transfer_size(), DFU_DATA_XFER_SIZE);
+
+    /* A payload of the old size is refused once a larger size is negotiated */
+    check_value("negotiated size", dfu_int_host_negotiate(size), size);
+    dfu_int_host_xfer_size = DFU_DATA_XFER_SIZE;
+    check_ret("DNLOAD of the default size", dfu_int_host_dnload(image, DFU_DATA_XFER_SIZE), SERVICER_WRONG_COMMAND_LEN);
+    dfu_int_host_xfer_size = size;
+
+    /* A length marker larger than the payload is refused */
+    check_ret("DNLOAD with a bad length", dfu_int_host_dnload(image, size + 1), CONTROL_DATA_LENGTH_ERROR);
+    check_value("state", dfu_int_host_get_state(), DFU_INT_DFU_IDLE);
+
+    /* The size can't change during a download */
+    check_ret("DNLOAD", dfu_int_host_dnload(image, size), CONTROL_SUCCESS);
+    check_value("state", dfu_int_host_wait_idle().next_state, DFU_INT_DFU_DNLOAD_IDLE);
+    check_ret("TRANSFERSIZE during a download", dfu_int_host_set_transfer_size(DFU_DATA_XFER_SIZE), CONTROL_ERROR);
+
+    /*
+     * Setting the alternate during a download abandons it, and the next download is framed at the default size by
+     * both the servicer and the state machine
+     */
+    check_ret("SETALTERNATE during a download", dfu_int_host_set_alternate(DFU_INT_ALTERNATE_UPGRADE),
+              CONTROL_SUCCESS);
+    check_value("state", dfu_int_host_get_state(), DFU_INT_DFU_IDLE);
+    check_value("transfer size", dfu_int_host_get_transfer_size(), DFU_DATA_XFER_SIZE);
+    dfu_int_host_xfer_size = size;
+    check_ret("DNLOAD of the old size", dfu_int_host_dnload(image, size), SERVICER_WRONG_COMMAND_LEN);
+    dfu_int_host_xfer_size = DFU_DATA_XFER_SIZE;
+    check_ret("DNLOAD of the default size", dfu_int_host_dnload(image, DFU_DATA_XFER_SIZE), CONTROL_SUCCESS);
+    check_value("state", dfu_int_host_wait_idle().next_state, DFU_INT_DFU_DNLOAD_IDLE);
+    dfu_int_host_abort();
+
+    /* A host that does not negotiate after one that did gets the default size back */
+    dfu_int_get_status_packet_t status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, image,
+                                                               3 * SECTOR, 0);
+    check_download("transfer_size_task", status, image, 3 * SECTOR);
+}
+
+/*
+ * Checks that the servicer refuses transfer sizes out of range or during a download, that the DNLOAD length check
+ * follows the negotiated size, and that setting the alternate, including during a download, restores the default
+ * size for hosts that don't negotiate.
+ */
+void test_transfer_size_negotiation(uint32_t seed, bool verbose)
+{
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, 3 * SECTOR);
+    rtos_sim_run(transfer_size_task, NULL);
+    if (verbose) {
+        printf("transfer size negotiation passes\n");
+    }
+}
+
+typedef struct {
+    size_t len;             // Bytes in the new image
+    double time_us;
+    unsigned transactions;
+} delta_result_t;
+
+static void delta_task(void *arg)
+{
+    delta_result_t *result = arg;
+
+    device_start();
+    double start = rtos_sim_time_us();
+    dfu_int_get_status_packet_t status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_MAX_SIZE,
+                                                               delta, delta_len, 0);
+    result->time_us = rtos_sim_time_us() - start;
+    result->transactions = dfu_int_host_stats.transactions;
+    check_download("delta_task", status, image, result->len);
+}
+
+/*
+ * Upgrades an image with a few sectors changed, first with the full image and then with a delta image against the
+ * image already in the upgrade partition. Reports the bytes transferred, sectors erased and time taken for each.
+ */
+void test_delta_download(uint32_t seed, bool verbose)
+{
+    const size_t len = 128 * SECTOR;
+    const unsigned changed[] = {0, 1, 2, 40, 41, 100, 127};
+    const unsigned num_changed = sizeof(changed) / sizeof(changed[0]);
+    download_result_t full = {.len = len, .xfer_size = DFU_DATA_XFER_MAX_SIZE};
+    delta_result_t delta_result = {.len = len};
+    dfu_delta_stats_t stats;
+
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, len);
+    rtos_sim_run(download_task, &full);
+    unsigned full_erases = flash.stats.erases;
+
+    memcpy(current, image, len);
+    for (unsigned i = 0; i < num_changed; i++) {
+        rand_fill(&image[changed[i] * SECTOR], SECTOR);
+    }
+    delta_len = dfu_delta_make(delta, image, len, current, len, NULL, 0, &stats);
+    xassert(stats.sent == num_changed);
+
+    flash_file_stats_reset(&flash);
+    memset(&dfu_int_host_stats, 0, sizeof(dfu_int_host_stats));
+    rtos_sim_run(delta_task, &delta_result);
+    if (flash.stats.erases != num_changed) {
+        printf("FAIL, test_delta_download(): %u erases, expected %u\n", flash.stats.erases, num_changed);
+        xassert(0);
+    }
+
+    printf("%s: %zu kB upgrade with %u sectors changed: full image %zu bytes, %u erases, %u transactions, %.2f s; "
+           "delta image %zu bytes, %u erases, %u transactions, %.2f s\n", MODE, len / 1024, num_changed, len,
+           full_erases, full.transactions, full.time_us * 1e-6, delta_len, flash.stats.erases,
+           delta_result.transactions, delta_result.time_us * 1e-6);
+    if (verbose) {
+        printf("delta download passes\n");
+    }
+}
+
+/*
+ * Lays out the files of the FFVA filesystem one to a cluster of a sector, as a FAT image, until len bytes are full.
+ * The unused parts of the clusters are zero.
+ */
+static void make_filesystem_image(uint8_t *data, size_t len)
+{
+    size_t pos = 0;
+
+    memset(data, 0, len);
+    for (unsigned i = 0; i <= 50; i++) {
+        char path[256];
+        if (i == 0) {
+            snprintf(path, sizeof(path), "%s/demo.txt", FFVA_FILESYSTEM_DIR);
+        } else {
+            snprintf(path, sizeof(path), "%s/english_usa/%u.wav", FFVA_FILESYSTEM_DIR, i);
+        }
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        pos += fread(&data[pos], 1, len - pos, f);
+        fclose(f);
+        pos = (pos + SECTOR - 1) / SECTOR * SECTOR;
+        if (pos >= len) {
+            break;
+        }
+    }
+    xassert(pos > len / 2);
+}
+
+typedef struct {
+    uint8_t alt;
+    size_t len;             // Bytes in the image
+    bool compressed;        // Download compressed[] instead of image[]
+    double time_us;
+    unsigned transactions;
+    unsigned erases;
+    unsigned programs;
+} format_result_t;
+
+static void format_task(void *arg)
+{
+    format_result_t *result = arg;
+    unsigned addr = (result->alt == DFU_INT_ALTERNATE_UPGRADE) ? UPGRADE_ADDR : DATA_PARTITION_ADDR;
+    dfu_int_get_status_packet_t status;
+
+    device_start();
+    double start = rtos_sim_time_us();
+    if (result->compressed) {
+        status = dfu_int_host_download_compressed(result->alt, DFU_DATA_XFER_MAX_SIZE, compressed, compressed_len);
+    } else {
+        status = dfu_int_host_download(result->alt, DFU_DATA_XFER_MAX_SIZE, image, result->len, 0);
+    }
+    result->time_us = rtos_sim_time_us() - start;
+    result->transactions = dfu_int_host_stats.transactions;
+    result->erases = flash.stats.erases;
+    result->programs = flash.stats.programs;
+    if ((status.next_state != DFU_INT_DFU_IDLE) || (status.current_status != DFU_INT_DFU_STATUS_OK)) {
+        printf("FAIL, format_task(): download ended in state %d, status %d\n", status.next_state, status.current_status);
+        xassert(0);
+    }
+    flash_file_peek(&flash, addr, readback, result->len);
+    if (memcmp(readback, image, result->len) != 0) {
+        printf("FAIL, format_task(): flash does not match the image\n");
+        xassert(0);
+    }
+
+    /* Uploads are uncompressed, and the payload format is back to raw after setting the alternate */
+    dfu_image.upgrade_size = result->len;
+    size_t uploaded = dfu_int_host_upload_all(result->alt, DFU_DATA_XFER_MAX_SIZE, readback, sizeof(readback));
+    if ((uploaded != result->len) || (memcmp(readback, image, result->len) != 0)) {
+        printf("FAIL, format_task(): uploaded %zu bytes, expected %zu\n", uploaded, result->len);
+        xassert(0);
+    }
+    if (dfu_int_host_get_payload_format() != DFU_INT_PAYLOAD_FORMAT_RAW) {
+        printf("FAIL, format_task(): payload format not reset by setting the alternate\n");
+        xassert(0);
+    }
+}
+
+/*
+ * Downloads a filesystem image of the FFVA's files to the data partition raw and then compressed, and an
+ * incompressible upgrade image compressed. Checks that each is written to flash and uploads intact, with each sector
+ * erased and programmed once, and reports the compression and the download time of each.
+ */
+void test_compressed_download(uint32_t seed, bool verbose)
+{
+    const size_t fs_len = FLASH_SIZE - DATA_PARTITION_ADDR;
+    const size_t random_len = 64 * SECTOR;
+    format_result_t raw = {.alt = 2, .len = fs_len};
+    format_result_t lz = {.alt = 2, .len = fs_len, .compressed = true};
+    format_result_t random = {.alt = DFU_INT_ALTERNATE_UPGRADE, .len = random_len, .compressed = true};
+
+    flash_reset(seed, &flash_file_typical_timing);
+    make_filesystem_image(image, fs_len);
+    rtos_sim_run(format_task, &raw);
+
+    flash_reset(seed, &flash_file_typical_timing);
+    compressed_len = dfu_lz_compress(compressed, image, fs_len);
+    rtos_sim_run(format_task, &lz);
+    if ((lz.erases != fs_len / SECTOR) || (lz.programs != fs_len / SECTOR)) {
+        printf("FAIL, test_compressed_download(): %u erases, %u programs, expected %zu\n", lz.erases, lz.programs,
+               fs_len / SECTOR);
+        xassert(0);
+    }
+
+    printf("%s: %zu kB filesystem image: raw %.2f s, %.1f kB/s; compressed to %.0f%%, %.2f s, %.1f kB/s of image\n",
+           MODE, fs_len / 1024, raw.time_us * 1e-6, fs_len / raw.time_us * 1e3, 100.0 * compressed_len / fs_len,
+           lz.time_us * 1e-6, fs_len / lz.time_us * 1e3);
+    if (lz.time_us >= raw.time_us) {
+        printf("FAIL, test_compressed_download(): compressed download is no faster\n");
+        xassert(0);
+    }
+
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, random_len);
+    compressed_len = dfu_lz_compress(compressed, image, random_len);
+    rtos_sim_run(format_task, &random);
+    printf("%s: %zu kB random image: compressed to %.1f%%, %.2f s\n", MODE, random_len / 1024,
+           100.0 * compressed_len / random_len, random.time_us * 1e-6);
+    if (verbose) {
+        printf("compressed download passes\n");
+    }
+}
+
+/*
+ * Downloads an image that ends part way through a sector raw and then compressed, as the host tools send it without
+ * padding. Checks that the last block is written at the end of the download, with the rest of its sector left erased,
+ * and that each sector is erased and programmed once.
+ */
+void test_partial_last_block(uint32_t seed, bool verbose)
+{
+    static uint8_t erased[SECTOR];
+    const unsigned sectors = 40;
+    const size_t len = sectors * SECTOR + 1000;
+    format_result_t results[] = {
+        {.alt = DFU_INT_ALTERNATE_UPGRADE, .len = len},
+        {.alt = DFU_INT_ALTERNATE_UPGRADE, .len = len, .compressed = true},
+    };
+
+    memset(erased, 0xFF, SECTOR);
+    for (unsigned i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        flash_reset(seed, &flash_file_typical_timing);
+        rand_fill(image, len);
+        compressed_len = dfu_lz_compress(compressed, image, len);
+        rtos_sim_run(format_task, &results[i]);
+        if ((results[i].erases != sectors + 1) || (results[i].programs != sectors + 1)) {
+            printf("FAIL, test_partial_last_block(): %u erases, %u programs, expected %u\n", results[i].erases,
+                   results[i].programs, sectors + 1);
+            xassert(0);
+        }
+        flash_file_peek(&flash, UPGRADE_ADDR + len, readback, SECTOR - len % SECTOR);
+        if (memcmp(readback, erased, SECTOR - len % SECTOR) != 0) {
+            printf("FAIL, test_partial_last_block(): rest of the last sector not erased\n");
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("partial last block passes\n");
+    }
+}
+
+static void compressed_errors_task(void *arg)
+{
+    (void)arg;
+    const uint8_t bad_distance[] = {0x00, 0xAA, DFU_LZ_MATCH_FLAG, 0x01, 0x00};
+    dfu_int_get_status_packet_t status;
+
+    device_start();
+
+    /* The format can only be set in dfuIDLE, and only to a known one */
+    check_ret("SETALTERNATE", dfu_int_host_set_alternate(DFU_INT_ALTERNATE_UPGRADE), CONTROL_SUCCESS);
+    check_ret("PAYLOADFORMAT unknown", dfu_int_host_set_payload_format(DFU_INT_NUM_PAYLOAD_FORMATS), CONTROL_ERROR);
+    check_ret("PAYLOADFORMAT", dfu_int_host_set_payload_format(DFU_INT_PAYLOAD_FORMAT_LZ), CONTROL_SUCCESS);
+    check_ret("DNLOAD", dfu_int_host_dnload(compressed, 3), CONTROL_SUCCESS);
+    status = dfu_int_host_wait_idle();
+    if (status.next_state != DFU_INT_DFU_DNLOAD_IDLE) {
+        printf("FAIL, compressed_errors_task(): first DNLOAD ended in state %d\n", status.next_state);
+        xassert(0);
+    }
+    check_ret("PAYLOADFORMAT during a download", dfu_int_host_set_payload_format(DFU_INT_PAYLOAD_FORMAT_RAW),
+              CONTROL_ERROR);
+    dfu_int_host_abort();
+
+    /* A download that ends part way through a token is not done */
+    status = dfu_int_host_download_compressed(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, compressed,
+                                              compressed_len - 1);
+    if ((status.next_state != DFU_INT_DFU_ERROR) || (status.current_status != DFU_INT_DFU_STATUS_ERR_NOTDONE)) {
+        printf("FAIL, compressed_errors_task(): truncated download ended in state %d, status %d\n",
+               status.next_state, status.current_status);
+        xassert(0);
+    }
+    dfu_int_host_clear_status();
+
+    /* A match before the start of the image is not valid */
+    status = dfu_int_host_download_compressed(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, bad_distance,
+                                              sizeof(bad_distance));
+    if ((status.next_state != DFU_INT_DFU_ERROR) || (status.current_status != DFU_INT_DFU_STATUS_ERR_FILE)) {
+        printf("FAIL, compressed_errors_task(): bad match ended in state %d, status %d\n",
+               status.next_state, status.current_status);
+        xassert(0);
+    }
+    dfu_int_host_clear_status();
+
+    /* The device still takes a raw download */
+    status = dfu_int_host_download(DFU_INT_ALTERNATE_UPGRADE, DFU_DATA_XFER_SIZE, image, 2 * SECTOR, 0);
+    check_download("compressed_errors_task", status, image, 2 * SECTOR);
+}
+
+/*
+ * Checks that the payload format can't be changed during a download, and that a truncated compressed download and
+ * one that is not valid are reported with errNOTDONE and errFILE.
+ */
+void test_compressed_errors(uint32_t seed, bool verbose)
+{
+    flash_reset(seed, &flash_file_typical_timing);
+    rand_fill(image, 2 * SECTOR);
+    compressed_len = dfu_lz_compress(compressed, image, 2 * SECTOR);
+    rtos_sim_run(compressed_errors_task, NULL);
+    if (verbose) {
+        printf("compressed errors passes\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    uint32_t seed = 0x2468ace0;
+
+    flash_file_open(&flash, NULL, FLASH_SIZE);
+
+    test_download_time(seed++, verbose);
+
+    test_flash_bound(seed++, verbose);
+
+    test_abort_mid_block(seed++, verbose);
+
+    test_error_reported(seed++, verbose);
+
+    test_transfer_size(seed++, verbose);
+
+    test_transfer_size_negotiation(seed++, verbose);
+
+    test_delta_download(seed++, verbose);
+
+    test_compressed_download(seed++, verbose);
+
+    test_partial_last_block(seed++, verbose);
+
+    test_compressed_errors(seed++, verbose);
+
+    flash_file_close(&flash);
+    printf("PASS\n");
+    return 0;
+}
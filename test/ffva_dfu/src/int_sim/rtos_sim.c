@@ -0,0 +1,298 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "FreeRTOS.h"
+#include "rtos_osal.h"
+#include "xcore/hwtimer.h"
+#include "xassert.h"
+#include "rtos_sim.h"
+
+#define SIM_MAX_TASKS       (8)
+#define SIM_STACK_SIZE      (256 * 1024)
+#define SIM_NOTIFY_INDICES  (3)
+
+typedef enum {
+    SIM_TASK_UNUSED,
+    SIM_TASK_RUNNABLE,      // Ready, or blocked and to recheck its wait condition
+    SIM_TASK_SLEEPING,
+    SIM_TASK_DONE
+} sim_task_state_t;
+
+struct sim_task {
+    ucontext_t ctx;
+    void *stack;
+    void (*entry)(void *);
+    void *arg;
+    sim_task_state_t state;
+    bool progressed;        // Ran past a wait or a sleep since it was last resumed
+    uint64_t wake_ns;
+    uint32_t notify_value[SIM_NOTIFY_INDICES];
+    bool notify_pending[SIM_NOTIFY_INDICES];
+};
+
+struct sim_queue {
+    uint8_t *items;
+    size_t item_size;
+    unsigned length;
+    unsigned head;
+    unsigned count;
+};
+
+static struct sim_task tasks[SIM_MAX_TASKS];
+static struct sim_task *current = NULL;
+static ucontext_t scheduler_ctx;
+static uint64_t now_ns = 0;
+
+static void task_entry(void)
+{
+    current->entry(current->arg);
+    current->state = SIM_TASK_DONE;
+    swapcontext(&current->ctx, &scheduler_ctx);
+}
+
+/* Returns to the scheduler until cond(arg) is true. Only NO_WAIT and WAIT_FOREVER are supported. */
+static bool wait_for(bool (*cond)(void *), void *arg, TickType_t ticks)
+{
+    xassert((ticks == RTOS_OSAL_NO_WAIT) || (ticks == RTOS_OSAL_WAIT_FOREVER));
+    while (!cond(arg)) {
+        if (ticks == RTOS_OSAL_NO_WAIT) {
+            return false;
+        }
+        swapcontext(&current->ctx, &scheduler_ctx);
+    }
+    current->progressed = true;
+    return true;
+}
+
+void rtos_sim_sleep_us(double us)
+{
+    current->state = SIM_TASK_SLEEPING;
+    current->wake_ns = now_ns + (uint64_t)(us * 1000);
+    swapcontext(&current->ctx, &scheduler_ctx);
+    current->progressed = true;
+}
+
+double rtos_sim_time_us(void)
+{
+    return now_ns * 1e-3;
+}
+
+uint32_t get_reference_time(void)
+{
+    return (uint32_t)(now_ns / 10);
+}
+
+void rtos_sim_run(void (*main_task)(void *), void *arg)
+{
+    TaskHandle_t main_handle;
+
+    memset(tasks, 0, sizeof(tasks));
+    now_ns = 0;
+    xTaskCreate(main_task, "main", 0, arg, 0, &main_handle);
+
+    while (main_handle->state != SIM_TASK_DONE) {
+        bool progress = false;
+        uint64_t next_wake = UINT64_MAX;
+
+        for (unsigned i = 0; i < SIM_MAX_TASKS; i++) {
+            struct sim_task *task = &tasks[i];
+            if ((task->state == SIM_TASK_SLEEPING) && (task->wake_ns <= now_ns)) {
+                task->state = SIM_TASK_RUNNABLE;
+            }
+            if (task->state == SIM_TASK_RUNNABLE) {
+                current = task;
+                task->progressed = false;
+                swapcontext(&scheduler_ctx, &task->ctx);
+                current = NULL;
+                progress |= task->progressed || (task->state != SIM_TASK_RUNNABLE);
+            }
+            if ((task->state == SIM_TASK_SLEEPING) && (task->wake_ns < next_wake)) {
+                next_wake = task->wake_ns;
+            }
+        }
+
+        if (!progress) {
+            if (next_wake == UINT64_MAX) {
+                printf("FAIL, rtos_sim_run(): every task is blocked at %.3f ms\n", now_ns * 1e-6);
+                xassert(0);
+            }
+            now_ns = next_wake;
+        }
+    }
+
+    for (unsigned i = 0; i < SIM_MAX_TASKS; i++) {
+        free(tasks[i].stack);
+    }
+    memset(tasks, 0, sizeof(tasks));
+}
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack_words, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name; (void)stack_words; (void)priority;
+    for (unsigned i = 0; i < SIM_MAX_TASKS; i++) {
+        struct sim_task *t = &tasks[i];
+        if (t->state == SIM_TASK_UNUSED) {
+            t->stack = malloc(SIM_STACK_SIZE);
+            xassert(t->stack != NULL);
+            getcontext(&t->ctx);
+            t->ctx.uc_stack.ss_sp = t->stack;
+            t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+            t->ctx.uc_link = NULL;
+            makecontext(&t->ctx, task_entry, 0);
+            t->entry = task;
+            t->arg = arg;
+            t->state = SIM_TASK_RUNNABLE;
+            if (handle != NULL) {
+                *handle = t;
+            }
+            return pdPASS;
+        }
+    }
+    xassert(0);
+    return pdFAIL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if (action == eSetBits) {
+        task->notify_value[0] |= value;
+    } else if (action == eIncrement) {
+        task->notify_value[0]++;
+    }
+    task->notify_pending[0] = true;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index)
+{
+    task->notify_value[index]++;
+    task->notify_pending[index] = true;
+    return pdPASS;
+}
+
+static bool notify_pending(void *arg)
+{
+    return current->notify_pending[(uintptr_t)arg];
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    if (!current->notify_pending[0]) {
+        current->notify_value[0] &= ~clear_on_entry;
+    }
+    if (!wait_for(notify_pending, (void *)0, ticks)) {
+        return pdFALSE;
+    }
+    if (value != NULL) {
+        *value = current->notify_value[0];
+    }
+    current->notify_value[0] &= ~clear_on_exit;
+    current->notify_pending[0] = false;
+    return pdTRUE;
+}
+
+static bool notify_count(void *arg)
+{
+    return current->notify_value[(uintptr_t)arg] != 0;
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear_on_exit, TickType_t ticks)
+{
+    wait_for(notify_count, (void *)(uintptr_t)index, ticks);
+    uint32_t value = current->notify_value[index];
+    if (value != 0) {
+        current->notify_value[index] = clear_on_exit ? 0 : value - 1;
+    }
+    current->notify_pending[index] = false;
+    return value;
+}
+
+int rtos_core_id_get(void)
+{
+    return 0;
+}
+
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *queue = calloc(1, sizeof(struct sim_queue));
+    xassert(queue != NULL);
+    queue->items = calloc(length, item_size ? item_size : 1);
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+static bool queue_not_full(void *arg)
+{
+    struct sim_queue *queue = arg;
+    return queue->count < queue->length;
+}
+
+static bool queue_not_empty(void *arg)
+{
+    struct sim_queue *queue = arg;
+    return queue->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    if (!wait_for(queue_not_full, queue, ticks)) {
+        return pdFAIL;
+    }
+    unsigned tail = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0) {
+        memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+    }
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    if (!wait_for(queue_not_empty, queue, ticks)) {
+        return pdFAIL;
+    }
+    if (queue->item_size > 0) {
+        memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
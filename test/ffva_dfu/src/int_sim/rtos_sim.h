@@ -0,0 +1,20 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdint.h>
+
+// Single threaded simulation of the RTOS tasks used by the DFU state machine. Tasks are coroutines run one at a time
+// in virtual time: a task runs until it blocks on a notification, queue or semaphore, or sleeps. Time only advances
+// when every task is blocked or sleeping, to the earliest wake up.
+
+/// @brief Run main_task as a task, along with any tasks it creates, until main_task returns
+/// @param main_task    First task
+/// @param arg          Argument passed to main_task
+void rtos_sim_run(void (*main_task)(void *), void *arg);
+
+/// @brief Block the calling task for us microseconds of virtual time
+void rtos_sim_sleep_us(double us);
+
+/// @brief Virtual time since rtos_sim_run() was called, in microseconds
+double rtos_sim_time_us(void);
@@ -0,0 +1,390 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "flash_file.h"
+#include "platform/driver_instances.h"
+#include "dfu_common.h"
+#include "dfu_delta_make.h"
+
+#define FLASH_SIZE          (0x200000)
+#define FACTORY_ADDR        (0)
+#define FACTORY_SIZE        (0x80000)
+#define UPGRADE_ADDR        (0x80000)
+#define DATA_PARTITION_ADDR (0x180000)
+#define SECTOR              (FLASH_FILE_SECTOR_SIZE)
+
+#define DFU_STATUS_OK           0
+#define DFU_STATUS_ERR_WRITE    3
+#define DFU_STATUS_ERR_VERIFY   7
+#define DFU_STATUS_ERR_ADDRESS  8
+#define DFU_STATUS_ERR_NOTDONE  9
+
+static flash_file_t flash;
+static rtos_dfu_image_t dfu_image;
+rtos_qspi_flash_t *qspi_flash_ctx = &flash;
+rtos_dfu_image_t *dfu_image_ctx = &dfu_image;
+unsigned host_reboot_count = 0;
+
+static uint8_t image[DATA_PARTITION_ADDR - UPGRADE_ADDR];
+static uint8_t readback[DATA_PARTITION_ADDR - UPGRADE_ADDR];
+static uint8_t current[DATA_PARTITION_ADDR - UPGRADE_ADDR];
+static uint8_t factory[FACTORY_SIZE];
+static uint8_t delta[DFU_DELTA_HEADER_SIZE + (DATA_PARTITION_ADDR - UPGRADE_ADDR) / SECTOR * DFU_DELTA_RECORD_SIZE +
+                     DATA_PARTITION_ADDR - UPGRADE_ADDR + SECTOR];
+
+static uint32_t rand_state;
+
+static uint8_t rand_byte(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state >> 24;
+}
+
+static void rand_fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand_byte();
+    }
+}
+
+/* Fills the whole flash with random data, as left by earlier images */
+static void flash_reset(uint32_t seed)
+{
+    static uint8_t junk[SECTOR];
+
+    rand_state = seed | 1;
+    for (unsigned addr = 0; addr < FLASH_SIZE; addr += SECTOR) {
+        rand_fill(junk, SECTOR);
+        flash_file_poke(&flash, addr, junk, SECTOR);
+    }
+    flash_file_stats_reset(&flash);
+    dfu_image.factory_addr = FACTORY_ADDR;
+    dfu_image.factory_size = FACTORY_SIZE;
+    dfu_image.upgrade_addr = UPGRADE_ADDR;
+    dfu_image.upgrade_size = 0;
+    dfu_image.data_partition_addr = DATA_PARTITION_ADDR;
+}
+
+/*
+ * Downloads len bytes of data in sector sized blocks, as the DFU host tools do, and manifests it. Returns the first
+ * error.
+ */
+static uint32_t download(uint8_t alt, const uint8_t *data, size_t len)
+{
+    uint32_t status = DFU_STATUS_OK;
+    for (size_t offset = 0; (offset < len) && (status == DFU_STATUS_OK); offset += SECTOR) {
+        size_t block_len = (len - offset < SECTOR) ? (len - offset) : SECTOR;
+        status = dfu_common_write_to_flash(alt, offset / SECTOR, &data[offset], block_len);
+    }
+    uint32_t manifest_status = dfu_common_make_manifest();
+    return (status != DFU_STATUS_OK) ? status : manifest_status;
+}
+
+static void check_stats(const char *test, unsigned reads, unsigned erases, unsigned programs)
+{
+    if ((flash.stats.reads != reads) || (flash.stats.erases != erases) || (flash.stats.programs != programs)) {
+        printf("FAIL, %s(): %u reads, %u erases, %u programs, expected %u, %u, %u\n", test,
+               flash.stats.reads, flash.stats.erases, flash.stats.programs, reads, erases, programs);
+        xassert(0);
+    }
+}
+
+static void check_flash(const char *test, unsigned addr, const uint8_t *expected, size_t len)
+{
+    flash_file_peek(&flash, addr, readback, len);
+    for (size_t i = 0; i < len; i++) {
+        if (readback[i] != expected[i]) {
+            printf("FAIL, %s(): flash 0x%zx is 0x%02x, expected 0x%02x\n", test, addr + i, readback[i], expected[i]);
+            xassert(0);
+        }
+    }
+}
+
+/*
+ * Downloads an upgrade image of whole sectors over a flash holding an older image. Each sector is erased and
+ * programmed once, and the only read is the one that flushes the writes at manifestation. Then uploads the image.
+ */
+void test_whole_sectors(uint32_t seed, bool verbose)
+{
+    const size_t len = 96 * SECTOR;
+
+    flash_reset(seed);
+    rand_fill(image, len);
+
+    if (download(1, image, len) != DFU_STATUS_OK) {
+        printf("FAIL, test_whole_sectors(): download failed\n");
+        xassert(0);
+    }
+    check_stats("test_whole_sectors", 1, len / SECTOR, len / SECTOR);
+    check_flash("test_whole_sectors", UPGRADE_ADDR, image, len);
+
+    dfu_image.upgrade_size = len;
+    for (unsigned block = 0; block < len / SECTOR; block++) {
+        if (dfu_common_read_from_flash(1, block, &readback[block * SECTOR], SECTOR) != SECTOR) {
+            printf("FAIL, test_whole_sectors(): upload of block %u failed\n", block);
+            xassert(0);
+        }
+    }
+    if ((dfu_common_read_from_flash(1, len / SECTOR, readback, SECTOR) != 0) || (memcmp(readback, image, SECTOR) != 0)) {
+        printf("FAIL, test_whole_sectors(): upload does not match the image, or does not end with it\n");
+        xassert(0);
+    }
+    if (verbose) {
+        printf("whole sectors passes\n");
+    }
+}
+
+/*
+ * Downloads an image ending in a partial sector, with its last sector erased as the block is written and then ahead
+ * of it, as the pipelined I2C DFU does. Either way nothing is read back and the rest of the last sector is left
+ * erased.
+ */
+void test_partial_trailing_sector(uint32_t seed, bool verbose)
+{
+    static uint8_t tail[SECTOR];
+    const unsigned sectors = 40;
+    const size_t tail_len = 1000;
+    const size_t len = sectors * SECTOR + tail_len;
+
+    flash_reset(seed);
+    rand_fill(image, len);
+    memset(tail, 0xFF, SECTOR);
+    memcpy(tail, &image[sectors * SECTOR], tail_len);
+
+    if (download(1, image, len) != DFU_STATUS_OK) {
+        printf("FAIL, test_partial_trailing_sector(): download failed\n");
+        xassert(0);
+    }
+    check_stats("test_partial_trailing_sector", 1, sectors + 1, sectors + 1);
+    check_flash("test_partial_trailing_sector", UPGRADE_ADDR, image, sectors * SECTOR);
+    check_flash("test_partial_trailing_sector", UPGRADE_ADDR + sectors * SECTOR, tail, SECTOR);
+
+    flash_reset(seed);
+    uint32_t status = DFU_STATUS_OK;
+    for (unsigned block = 0; (block < sectors) && (status == DFU_STATUS_OK); block++) {
+        status = dfu_common_write_to_flash(1, block, &image[block * SECTOR], SECTOR);
+    }
+    flash_file_stats_reset(&flash);
+    if (status == DFU_STATUS_OK) {
+        status = dfu_common_pre_erase(1, sectors);
+    }
+    if (status == DFU_STATUS_OK) {
+        status = dfu_common_write_to_flash(1, sectors, &image[sectors * SECTOR], tail_len);
+    }
+    if ((status != DFU_STATUS_OK) || (dfu_common_make_manifest() != DFU_STATUS_OK)) {
+        printf("FAIL, test_partial_trailing_sector(): download to a pre-erased sector failed\n");
+        xassert(0);
+    }
+    check_stats("test_partial_trailing_sector", 1, 1, 1);
+    check_flash("test_partial_trailing_sector", UPGRADE_ADDR + sectors * SECTOR, tail, SECTOR);
+    if (verbose) {
+        printf("partial trailing sector passes\n");
+    }
+}
+
+/*
+ * Fills the data partition to the end of the flash, checks that one more block is refused without touching the
+ * flash, and that alt 0, the factory image, cannot be written.
+ */
+void test_data_partition(uint32_t seed, bool verbose)
+{
+    const size_t len = FLASH_SIZE - DATA_PARTITION_ADDR;
+
+    flash_reset(seed);
+    rand_fill(image, len);
+
+    if (download(2, image, len) != DFU_STATUS_OK) {
+        printf("FAIL, test_data_partition(): download failed\n");
+        xassert(0);
+    }
+    check_flash("test_data_partition", DATA_PARTITION_ADDR, image, len);
+
+    flash_file_stats_reset(&flash);
+    for (unsigned block = 0; block < len / SECTOR; block++) {
+        if (dfu_common_write_to_flash(2, block, &image[block * SECTOR], SECTOR) != DFU_STATUS_OK) {
+            printf("FAIL, test_data_partition(): block %u refused\n", block);
+            xassert(0);
+        }
+    }
+    if (dfu_common_write_to_flash(2, len / SECTOR, image, SECTOR) != DFU_STATUS_ERR_ADDRESS) {
+        printf("FAIL, test_data_partition(): block past the end of the flash not refused\n");
+        xassert(0);
+    }
+    dfu_common_make_manifest();
+    check_stats("test_data_partition", 1, len / SECTOR, len / SECTOR);
+
+    flash_file_stats_reset(&flash);
+    if (download(0, image, SECTOR) != DFU_STATUS_ERR_WRITE) {
+        printf("FAIL, test_data_partition(): factory image write not refused\n");
+        xassert(0);
+    }
+    check_stats("test_data_partition", 1, 0, 0);
+    check_flash("test_data_partition", DATA_PARTITION_ADDR, image, len);
+    if (verbose) {
+        printf("data partition passes\n");
+    }
+}
+
+/*
+ * Reports the modelled flash time of a full size upgrade, and the time the sector read-back used to add to it.
+ */
+void test_upgrade_time(uint32_t seed, bool verbose)
+{
+    const size_t len = DATA_PARTITION_ADDR - UPGRADE_ADDR;
+    const unsigned sectors = len / SECTOR;
+    struct timespec start, end;
+
+    flash_reset(seed);
+    rand_fill(image, len);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint32_t status = download(1, image, len);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (status != DFU_STATUS_OK) {
+        printf("FAIL, test_upgrade_time(): download failed\n");
+        xassert(0);
+    }
+
+    check_stats("test_upgrade_time", 1, sectors, sectors);
+    double host_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+    double read_back_ms = sectors * (flash.timing.command_us + SECTOR * flash.timing.read_us_per_byte) * 1e-3;
+    printf("%zu kB upgrade: %u erases, %u programs, %u reads, flash busy %.1f ms, sector read-back would add %.1f ms, "
+           "host %.1f ms\n", len / 1024, flash.stats.erases, flash.stats.programs, flash.stats.reads,
+           flash.stats.busy_us * 1e-3, read_back_ms, host_ms);
+    if (verbose) {
+        printf("upgrade time passes\n");
+    }
+}
+
+/*
+ * Makes an upgrade image from the one in the upgrade partition, with some sectors changed, some taken from the
+ * factory image and a new partial last sector, as a firmware update typically does.
+ */
+static void make_delta_upgrade(size_t len, unsigned changed, unsigned from_factory)
+{
+    flash_file_peek(&flash, FACTORY_ADDR, factory, FACTORY_SIZE);
+    flash_file_peek(&flash, UPGRADE_ADDR, current, len);
+    memcpy(image, current, len);
+    for (unsigned i = 0; i < changed; i++) {
+        rand_fill(&image[(rand_byte() % (len / SECTOR)) * SECTOR], SECTOR);
+    }
+    for (unsigned i = 0; i < from_factory; i++) {
+        unsigned sector = rand_byte() % (len / SECTOR);
+        memcpy(&image[sector * SECTOR], &factory[(sector + 5) % (FACTORY_SIZE / SECTOR) * SECTOR], SECTOR);
+    }
+    rand_fill(&image[len - len % SECTOR], len % SECTOR);
+}
+
+/*
+ * Downloads a delta image of an upgrade against the image already in the upgrade partition and the factory image.
+ * Checks that the new image is written, that only the sectors that changed are erased and programmed, and that the
+ * only reads are of the copied factory sectors and the CRC check at manifestation. Reports the bytes transferred and
+ * sectors erased against a full upgrade.
+ */
+void test_delta_upgrade(uint32_t seed, bool verbose)
+{
+    const size_t len = 192 * SECTOR + 1000;
+    const unsigned sectors = len / SECTOR + 1;
+    dfu_delta_stats_t stats;
+
+    flash_reset(seed);
+    make_delta_upgrade(len, 10, 4);
+    size_t delta_len = dfu_delta_make(delta, image, len, current, len, factory, FACTORY_SIZE, &stats);
+    xassert(stats.kept + stats.copied + stats.sent == sectors);
+    xassert((stats.copied > 0) && (stats.sent > 1));
+
+    if (download(1, delta, delta_len) != DFU_STATUS_OK) {
+        printf("FAIL, test_delta_upgrade(): download failed\n");
+        xassert(0);
+    }
+    check_stats("test_delta_upgrade", stats.copied + sectors + 1, stats.copied + stats.sent,
+                stats.copied + stats.sent);
+    check_flash("test_delta_upgrade", UPGRADE_ADDR, image, len);
+    double delta_busy_us = flash.stats.busy_us;
+
+    flash_reset(seed);
+    if (download(1, image, len) != DFU_STATUS_OK) {
+        printf("FAIL, test_delta_upgrade(): full image download failed\n");
+        xassert(0);
+    }
+    printf("%zu kB upgrade with %u of %u sectors changed: delta image %zu bytes, %u erases, flash busy %.1f ms; "
+           "full image %zu bytes, %u erases, flash busy %.1f ms\n", len / 1024, stats.copied + stats.sent, sectors,
+           delta_len, stats.copied + stats.sent, delta_busy_us * 1e-3, len, flash.stats.erases,
+           flash.stats.busy_us * 1e-3);
+    if (verbose) {
+        printf("delta upgrade passes\n");
+    }
+}
+
+/*
+ * Checks that a delta image made against an image other than the one in the partition fails its CRC check and
+ * leaves the first sector erased, so it is never booted, and that truncated and malformed delta images are refused.
+ */
+void test_delta_verify(uint32_t seed, bool verbose)
+{
+    const size_t len = 64 * SECTOR;
+    static uint8_t erased[SECTOR];
+
+    memset(erased, 0xFF, SECTOR);
+    flash_reset(seed);
+    make_delta_upgrade(len, 4, 0);
+    size_t delta_len = dfu_delta_make(delta, image, len, current, len, NULL, 0, NULL);
+    flash_file_poke(&flash, UPGRADE_ADDR + len - 1, (const uint8_t *)"", 1);
+    if (download(1, delta, delta_len) != DFU_STATUS_ERR_VERIFY) {
+        printf("FAIL, test_delta_verify(): delta against a different image not refused\n");
+        xassert(0);
+    }
+    check_flash("test_delta_verify", UPGRADE_ADDR, erased, SECTOR);
+
+    flash_reset(seed);
+    make_delta_upgrade(len, 4, 0);
+    delta_len = dfu_delta_make(delta, image, len, current, len, NULL, 0, NULL);
+    if (download(1, delta, delta_len - SECTOR) != DFU_STATUS_ERR_NOTDONE) {
+        printf("FAIL, test_delta_verify(): truncated delta not refused\n");
+        xassert(0);
+    }
+    check_flash("test_delta_verify", UPGRADE_ADDR, erased, SECTOR);
+
+    /* A record past the end of the image */
+    dfu_delta_record_t record = {.op = DFU_DELTA_OP_KEEP, .count = len / SECTOR + 1};
+    dfu_delta_write_record(&delta[DFU_DELTA_HEADER_SIZE], &record);
+    if (download(1, delta, DFU_DELTA_HEADER_SIZE + DFU_DELTA_RECORD_SIZE) != DFU_STATUS_ERR_ADDRESS) {
+        printf("FAIL, test_delta_verify(): record past the end of the image not refused\n");
+        xassert(0);
+    }
+    if (verbose) {
+        printf("delta verify passes\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    uint32_t seed = 0x12345678;
+
+    flash_file_open(&flash, NULL, FLASH_SIZE);
+
+    test_whole_sectors(seed++, verbose);
+
+    test_partial_trailing_sector(seed++, verbose);
+
+    test_data_partition(seed++, verbose);
+
+    test_upgrade_time(seed++, verbose);
+
+    test_delta_upgrade(seed++, verbose);
+
+    test_delta_verify(seed++, verbose);
+
+    flash_file_close(&flash);
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,38 @@
+
+set(FFVA_EXAMPLE_PATH ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva)
+
+add_executable(test_i2s_rate_conversion
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src/pseudo_rand.c
+    ${FFVA_EXAMPLE_PATH}/src/i2s_rate_conversion/i2s_rate_conversion.c
+)
+
+target_include_directories(test_i2s_rate_conversion
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/src
+        ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src
+        ${FFVA_EXAMPLE_PATH}/src/i2s_rate_conversion
+)
+
+if(${CMAKE_SYSTEM_NAME} STREQUAL XCORE_XS3A)
+    target_link_libraries(test_i2s_rate_conversion PRIVATE lib_src)
+
+    target_compile_options(test_i2s_rate_conversion
+        PRIVATE "-target=XCORE-AI-EXPLORER")
+
+    target_link_options(test_i2s_rate_conversion
+        PRIVATE
+            "-target=XCORE-AI-EXPLORER"
+            "-report")
+else()
+    # lib_src is only built for xcore. Use a model of the fixed factor of 3 voice filters
+    target_sources(test_i2s_rate_conversion
+        PRIVATE
+            ${CMAKE_CURRENT_LIST_DIR}/src/x86/src_ff3v_model.c
+    )
+    target_include_directories(test_i2s_rate_conversion
+        PRIVATE
+            ${CMAKE_CURRENT_LIST_DIR}/src/x86
+    )
+    target_compile_definitions(test_i2s_rate_conversion PRIVATE X86_BUILD=1)
+endif()
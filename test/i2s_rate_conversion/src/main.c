@@ -0,0 +1,207 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if !X86_BUILD
+    #include <platform.h>
+    #include <xs1.h>
+    #include <xcore/assert.h>
+#else
+    #include <assert.h>
+    #define xassert assert
+#endif
+#include "pseudo_rand.h"
+#include "i2s_rate_conversion.h"
+
+#define FRAME_ADVANCE   (240)
+#define NUM_FRAMES      (16)
+
+/*
+ * Reference: the per sample I2S filter callbacks that the frame based
+ * conversion replaces, with their static state moved into a structure.
+ */
+typedef struct {
+    int i;
+    int32_t src_data[2][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned(8)));
+} ref_upsample_state_t;
+
+typedef struct {
+    int i;
+    int64_t sum[2];
+    int32_t src_data[2][SRC_FF3V_FIR_NUM_PHASES][SRC_FF3V_FIR_TAPS_PER_PHASE] __attribute__((aligned (8)));
+} ref_downsample_state_t;
+
+static size_t ref_upsample_cb(ref_upsample_state_t *s, int32_t *i2s_frame, const int32_t *send_buf, size_t samples_available)
+{
+    switch (s->i) {
+    case 0:
+        s->i = 1;
+        if (samples_available >= 2) {
+            i2s_frame[0] = src_us3_voice_input_sample(s->src_data[0], src_ff3v_fir_coefs[2], send_buf[0]);
+            i2s_frame[1] = src_us3_voice_input_sample(s->src_data[1], src_ff3v_fir_coefs[2], send_buf[1]);
+            return 2;
+        } else {
+            i2s_frame[0] = src_us3_voice_input_sample(s->src_data[0], src_ff3v_fir_coefs[2], 0);
+            i2s_frame[1] = src_us3_voice_input_sample(s->src_data[1], src_ff3v_fir_coefs[2], 0);
+            return 0;
+        }
+    case 1:
+        s->i = 2;
+        i2s_frame[0] = src_us3_voice_get_next_sample(s->src_data[0], src_ff3v_fir_coefs[1]);
+        i2s_frame[1] = src_us3_voice_get_next_sample(s->src_data[1], src_ff3v_fir_coefs[1]);
+        return 0;
+    case 2:
+        s->i = 0;
+        i2s_frame[0] = src_us3_voice_get_next_sample(s->src_data[0], src_ff3v_fir_coefs[0]);
+        i2s_frame[1] = src_us3_voice_get_next_sample(s->src_data[1], src_ff3v_fir_coefs[0]);
+        return 0;
+    default:
+        xassert(0);
+        return 0;
+    }
+}
+
+static size_t ref_downsample_cb(ref_downsample_state_t *s, const int32_t *i2s_frame, int32_t *receive_buf, size_t sample_spaces_free)
+{
+    switch (s->i) {
+    case 0:
+        s->i = 1;
+        s->sum[0] = src_ds3_voice_add_sample(0, s->src_data[0][0], src_ff3v_fir_coefs[0], i2s_frame[0]);
+        s->sum[1] = src_ds3_voice_add_sample(0, s->src_data[1][0], src_ff3v_fir_coefs[0], i2s_frame[1]);
+        return 0;
+    case 1:
+        s->i = 2;
+        s->sum[0] = src_ds3_voice_add_sample(s->sum[0], s->src_data[0][1], src_ff3v_fir_coefs[1], i2s_frame[0]);
+        s->sum[1] = src_ds3_voice_add_sample(s->sum[1], s->src_data[1][1], src_ff3v_fir_coefs[1], i2s_frame[1]);
+        return 0;
+    case 2:
+        s->i = 0;
+        if (sample_spaces_free >= 2) {
+            receive_buf[0] = src_ds3_voice_add_final_sample(s->sum[0], s->src_data[0][2], src_ff3v_fir_coefs[2], i2s_frame[0]);
+            receive_buf[1] = src_ds3_voice_add_final_sample(s->sum[1], s->src_data[1][2], src_ff3v_fir_coefs[2], i2s_frame[1]);
+            return 2;
+        } else {
+            (void) src_ds3_voice_add_final_sample(s->sum[0], s->src_data[0][2], src_ff3v_fir_coefs[2], i2s_frame[0]);
+            (void) src_ds3_voice_add_final_sample(s->sum[1], s->src_data[1][2], src_ff3v_fir_coefs[2], i2s_frame[1]);
+            return 0;
+        }
+    default:
+        xassert(0);
+        return 0;
+    }
+}
+
+static int32_t test_sample(unsigned *seed, int frame)
+{
+    // Mix full scale frames in, to exercise the saturation
+    if ((frame % 4) == 3) {
+        return (pseudo_rand_int32(seed) >= 0) ? INT32_MAX : INT32_MIN;
+    }
+    return pseudo_rand_int32(seed);
+}
+
+void test_upsample(unsigned seed, bool verbose)
+{
+    static ref_upsample_state_t ref_state;
+    static i2s_upsampler_t dut_state;
+    static int32_t pipeline_frame[2][FRAME_ADVANCE];
+    static int32_t ref_out[3 * FRAME_ADVANCE][2];
+    static int32_t dut_out[3 * FRAME_ADVANCE][2];
+
+    memset(&ref_state, 0, sizeof(ref_state));
+    i2s_upsampler_init(&dut_state);
+
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        for (int i = 0; i < FRAME_ADVANCE; i++) {
+            pipeline_frame[0][i] = test_sample(&seed, frame);
+            pipeline_frame[1][i] = test_sample(&seed, frame);
+        }
+
+        // The I2S driver calls the send filter once per I2S sample. It consumes a stereo pipeline sample when it returns 2
+        int32_t send_buf[FRAME_ADVANCE][2];
+        for (int i = 0; i < FRAME_ADVANCE; i++) {
+            send_buf[i][0] = pipeline_frame[0][i];
+            send_buf[i][1] = pipeline_frame[1][i];
+        }
+        size_t consumed = 0;
+        for (int i = 0; i < 3 * FRAME_ADVANCE; i++) {
+            size_t available = 2 * (FRAME_ADVANCE - (consumed / 2));
+            consumed += ref_upsample_cb(&ref_state, ref_out[i], &send_buf[consumed / 2][0], available);
+        }
+        xassert(consumed == 2 * FRAME_ADVANCE);
+
+        const int32_t *input[I2S_RATE_CONVERSION_CHANNELS] = {pipeline_frame[0], pipeline_frame[1]};
+        i2s_upsample_frame(&dut_state, dut_out, input, FRAME_ADVANCE);
+
+        for (int i = 0; i < 3 * FRAME_ADVANCE; i++) {
+            for (int ch = 0; ch < 2; ch++) {
+                if (dut_out[i][ch] != ref_out[i][ch]) {
+                    printf("FAIL, test_upsample(): frame %d, sample %d, ch %d: dut = %ld, ref = %ld\n", frame, i, ch, (long)dut_out[i][ch], (long)ref_out[i][ch]);
+                    xassert(0);
+                }
+            }
+        }
+        if (verbose) {
+            printf("upsample: frame %d bit exact\n", frame);
+        }
+    }
+}
+
+void test_downsample(unsigned seed, bool verbose)
+{
+    static ref_downsample_state_t ref_state;
+    static i2s_downsampler_t dut_state;
+    static int32_t i2s_frame[3 * FRAME_ADVANCE][2];
+    static int32_t ref_out[FRAME_ADVANCE][2];
+    static int32_t dut_out[2][FRAME_ADVANCE];
+
+    memset(&ref_state, 0, sizeof(ref_state));
+    i2s_downsampler_init(&dut_state);
+
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        for (int i = 0; i < 3 * FRAME_ADVANCE; i++) {
+            i2s_frame[i][0] = test_sample(&seed, frame);
+            i2s_frame[i][1] = test_sample(&seed, frame);
+        }
+
+        // The I2S driver calls the receive filter once per I2S sample. It produces a stereo pipeline sample when it returns 2
+        size_t produced = 0;
+        for (int i = 0; i < 3 * FRAME_ADVANCE; i++) {
+            produced += ref_downsample_cb(&ref_state, i2s_frame[i], &ref_out[produced / 2][0], 2 * FRAME_ADVANCE - produced);
+        }
+        xassert(produced == 2 * FRAME_ADVANCE);
+
+        int32_t *output[I2S_RATE_CONVERSION_CHANNELS] = {dut_out[0], dut_out[1]};
+        i2s_downsample_frame(&dut_state, output, i2s_frame, FRAME_ADVANCE);
+
+        for (int i = 0; i < FRAME_ADVANCE; i++) {
+            for (int ch = 0; ch < 2; ch++) {
+                if (dut_out[ch][i] != ref_out[i][ch]) {
+                    printf("FAIL, test_downsample(): frame %d, sample %d, ch %d: dut = %ld, ref = %ld\n", frame, i, ch, (long)dut_out[ch][i], (long)ref_out[i][ch]);
+                    xassert(0);
+                }
+            }
+        }
+        if (verbose) {
+            printf("downsample: frame %d bit exact\n", frame);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned seed = 98765;
+
+    bool verbose = false;
+
+    test_upsample(seed, verbose);
+
+    test_downsample(seed, verbose);
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,20 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+// x86 stand-in for the lib_src fixed factor of 3 voice API, which lib_src only builds for xcore.
+// The filter structure (phases, taps per phase, history handling and call sequence) matches lib_src. The coefficients and
+// the output scaling are a model, so x86 results are not numerically equal to the xcore build.
+
+#include <stdint.h>
+
+#define SRC_FF3V_FIR_NUM_PHASES         (3)
+#define SRC_FF3V_FIR_TAPS_PER_PHASE     (24)
+
+extern const int32_t src_ff3v_fir_coefs[SRC_FF3V_FIR_NUM_PHASES][SRC_FF3V_FIR_TAPS_PER_PHASE];
+
+int32_t src_us3_voice_input_sample(int32_t data[], const int32_t coefs[], int32_t sample);
+int32_t src_us3_voice_get_next_sample(int32_t data[], const int32_t coefs[]);
+
+int64_t src_ds3_voice_add_sample(int64_t sum, int32_t data[], const int32_t coefs[], int32_t sample);
+int32_t src_ds3_voice_add_final_sample(int64_t sum, int32_t data[], const int32_t coefs[], int32_t sample);
@@ -0,0 +1,65 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include "src.h"
+
+#define SRC_FF3V_MODEL_COEF_Q   (30)
+
+// 72 tap windowed sinc, cut off at a sixth of the input rate, split into 3 phases. Q30.
+const int32_t src_ff3v_fir_coefs[SRC_FF3V_FIR_NUM_PHASES][SRC_FF3V_FIR_TAPS_PER_PHASE] = {
+    {-385634, 506089, -831467, 1409999, -2300363, 3582400, -5379943, 7912881, -11631299, 17633593, -29451574, 67682624, 342096299, -47822681, 24378051, -15253386, 10214267, -6966329, 4712801, -3105180, 1964610, -1185704, 697411, -445366},
+    {-811481, 1179081, -1987142, 3337559, -5358600, 8232359, -12254249, 17973437, -26574839, 41177088, -73317978, 227243574, 227243574, -73317978, 41177088, -26574839, 17973437, -12254249, 8232359, -5358600, 3337559, -1987142, 1179081, -811481},
+    {-445366, 697411, -1185704, 1964610, -3105180, 4712801, -6966329, 10214267, -15253386, 24378051, -47822681, 342096299, 67682624, -29451574, 17633593, -11631299, 7912881, -5379943, 3582400, -2300363, 1409999, -831467, 506089, -385634},
+};
+
+static int32_t extract_sat(int64_t acc)
+{
+    acc = (acc + (1LL << (SRC_FF3V_MODEL_COEF_Q - 1))) >> SRC_FF3V_MODEL_COEF_Q;
+    if (acc > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (acc < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)acc;
+}
+
+static void push_sample(int32_t data[], int32_t sample)
+{
+    for (int i = SRC_FF3V_FIR_TAPS_PER_PHASE - 1; i > 0; i--) {
+        data[i] = data[i - 1];
+    }
+    data[0] = sample;
+}
+
+static int64_t dot(const int32_t data[], const int32_t coefs[])
+{
+    int64_t acc = 0;
+    for (int i = 0; i < SRC_FF3V_FIR_TAPS_PER_PHASE; i++) {
+        acc += (int64_t)data[i] * coefs[i];
+    }
+    return acc;
+}
+
+int32_t src_us3_voice_input_sample(int32_t data[], const int32_t coefs[], int32_t sample)
+{
+    push_sample(data, sample);
+    return src_us3_voice_get_next_sample(data, coefs);
+}
+
+int32_t src_us3_voice_get_next_sample(int32_t data[], const int32_t coefs[])
+{
+    // Gain of 3 to make up for the zero stuffing
+    return extract_sat(3 * dot(data, coefs));
+}
+
+int64_t src_ds3_voice_add_sample(int64_t sum, int32_t data[], const int32_t coefs[], int32_t sample)
+{
+    push_sample(data, sample);
+    return sum + dot(data, coefs);
+}
+
+int32_t src_ds3_voice_add_final_sample(int64_t sum, int32_t data[], const int32_t coefs[], int32_t sample)
+{
+    return extract_sat(src_ds3_voice_add_sample(sum, data, coefs, sample));
+}
@@ -0,0 +1,27 @@
+
+set(FFVA_EXAMPLE_PATH ${CMAKE_CURRENT_LIST_DIR}/../../examples/ffva)
+
+add_executable(test_i2s_tdm_output
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src/pseudo_rand.c
+    ${FFVA_EXAMPLE_PATH}/src/i2s_tdm_output/i2s_tdm_output.c
+)
+
+target_include_directories(test_i2s_tdm_output
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/src
+        ${CMAKE_CURRENT_LIST_DIR}/../asrc_unit_tests/src
+        ${FFVA_EXAMPLE_PATH}/src/i2s_tdm_output
+)
+
+if(${CMAKE_SYSTEM_NAME} STREQUAL XCORE_XS3A)
+    target_compile_options(test_i2s_tdm_output
+        PRIVATE "-target=XCORE-AI-EXPLORER")
+
+    target_link_options(test_i2s_tdm_output
+        PRIVATE
+            "-target=XCORE-AI-EXPLORER"
+            "-report")
+else()
+    target_compile_definitions(test_i2s_tdm_output PRIVATE X86_BUILD=1)
+endif()
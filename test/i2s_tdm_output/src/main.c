@@ -0,0 +1,164 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if !X86_BUILD
+    #include <platform.h>
+    #include <xs1.h>
+    #include <xcore/assert.h>
+    #include <xcore/hwtimer.h>
+#else
+    #include <assert.h>
+    #define xassert assert
+#endif
+#include "pseudo_rand.h"
+#include "i2s_tdm_output.h"
+
+#define FRAME_ADVANCE   (240)
+#define NUM_CHANNELS    (6)
+#define MAX_SLOTS       (8)
+
+/*
+ * Reference: the per sample TDM packing that the batched packer replaces,
+ * writing one pipeline sample's 6 slots at a time.
+ */
+static void ref_tdm_pack_sample(int32_t tdm_output[6], const int32_t *tmpptr, int i, size_t frame_count)
+{
+    tdm_output[0] = *(tmpptr + i + (4 * frame_count)) & ~0x1;   // mic 0
+    tdm_output[1] = *(tmpptr + i + (5 * frame_count)) & ~0x1;   // mic 1
+    tdm_output[2] = *(tmpptr + i + (2 * frame_count)) & ~0x1;   // ref 0
+    tdm_output[3] = *(tmpptr + i + (3 * frame_count)) & ~0x1;   // ref 1
+    tdm_output[4] = *(tmpptr + i) | 0x1;                        // proc 0
+    tdm_output[5] = *(tmpptr + i + frame_count) | 0x1;          // proc 1
+}
+
+static const i2s_tdm_slot_t default_slot_map[] = {
+    I2S_TDM_SLOT(4, 0),     /* mic 0 */
+    I2S_TDM_SLOT(5, 0),     /* mic 1 */
+    I2S_TDM_SLOT(2, 0),     /* ref 0 */
+    I2S_TDM_SLOT(3, 0),     /* ref 1 */
+    I2S_TDM_SLOT(0, 1),     /* proc 0 */
+    I2S_TDM_SLOT(1, 1),     /* proc 1 */
+};
+
+static int32_t frame[NUM_CHANNELS][FRAME_ADVANCE];
+static int32_t dut_out[FRAME_ADVANCE * MAX_SLOTS + 1];  // One past the end, to check for overruns
+static int32_t ref_out[FRAME_ADVANCE * MAX_SLOTS];
+
+static void random_frame(unsigned *seed)
+{
+    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+        for (int i = 0; i < FRAME_ADVANCE; i++) {
+            frame[ch][i] = pseudo_rand_int32(seed);
+        }
+    }
+}
+
+void test_default_slot_map(unsigned seed, bool verbose)
+{
+    for (int test = 0; test < 10; test++) {
+        random_frame(&seed);
+        for (int i = 0; i < FRAME_ADVANCE; i++) {
+            ref_tdm_pack_sample(&ref_out[6 * i], &frame[0][0], i, FRAME_ADVANCE);
+        }
+        i2s_tdm_output_pack(dut_out, &frame[0][0], FRAME_ADVANCE, default_slot_map, 6);
+
+        if (memcmp(dut_out, ref_out, FRAME_ADVANCE * 6 * sizeof(int32_t)) != 0) {
+            printf("FAIL, test_default_slot_map(): test %d\n", test);
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("default slot map matches the per sample packing\n");
+    }
+}
+
+void test_random_slot_map(unsigned seed, bool verbose)
+{
+    i2s_tdm_slot_t slot_map[MAX_SLOTS];
+
+    for (int test = 0; test < 100; test++) {
+        size_t num_slots = 2 * pseudo_rand_uint(&seed, 1, (MAX_SLOTS / 2) + 1);
+        for (int s = 0; s < num_slots; s++) {
+            slot_map[s].channel = pseudo_rand_uint(&seed, 0, NUM_CHANNELS);
+            slot_map[s].lsb_tag = pseudo_rand_uint(&seed, 0, 2);
+        }
+        random_frame(&seed);
+        size_t frame_count = pseudo_rand_uint(&seed, 1, FRAME_ADVANCE + 1);
+
+        /* The frame is in channel sample format with frame_count samples per channel */
+        static int32_t packed_frame[NUM_CHANNELS * FRAME_ADVANCE];
+        for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+            memcpy(&packed_frame[ch * frame_count], frame[ch], frame_count * sizeof(int32_t));
+        }
+
+        dut_out[num_slots * frame_count] = 0x5A5A5A5A;
+        i2s_tdm_output_pack(dut_out, packed_frame, frame_count, slot_map, num_slots);
+
+        for (int i = 0; i < frame_count; i++) {
+            for (int s = 0; s < num_slots; s++) {
+                int32_t ref = (frame[slot_map[s].channel][i] & ~0x1) | slot_map[s].lsb_tag;
+                if (dut_out[i * num_slots + s] != ref) {
+                    printf("FAIL, test_random_slot_map(): test %d, sample %d, slot %d: dut = %ld, ref = %ld\n", test, i, s, (long)dut_out[i * num_slots + s], (long)ref);
+                    xassert(0);
+                }
+            }
+        }
+        /* Nothing written past the end of the packed frame */
+        xassert(dut_out[num_slots * frame_count] == 0x5A5A5A5A);
+    }
+    if (verbose) {
+        printf("random slot maps pass\n");
+    }
+}
+
+#if !X86_BUILD
+/*
+ * Cycles spent packing one frame, the per sample way and batched. This
+ * excludes the driver calls, of which the per sample way makes one per
+ * sample and the batched way one per frame.
+ */
+void measure_pack_time(unsigned seed)
+{
+    int32_t tdm_output[6];
+    volatile int32_t sink;
+
+    random_frame(&seed);
+
+    uint32_t start = get_reference_time();
+    for (int i = 0; i < FRAME_ADVANCE; i++) {
+        ref_tdm_pack_sample(tdm_output, &frame[0][0], i, FRAME_ADVANCE);
+        sink = tdm_output[5];
+    }
+    uint32_t per_sample_time = get_reference_time() - start;
+    (void) sink;
+
+    start = get_reference_time();
+    i2s_tdm_output_pack(dut_out, &frame[0][0], FRAME_ADVANCE, default_slot_map, 6);
+    uint32_t batched_time = get_reference_time() - start;
+
+    printf("TDM pack ticks per frame: per sample %lu, batched %lu\n", (unsigned long)per_sample_time, (unsigned long)batched_time);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    unsigned seed = 24680;
+
+    bool verbose = false;
+
+    test_default_slot_map(seed, verbose);
+
+    test_random_slot_map(seed, verbose);
+
+#if !X86_BUILD
+    measure_pack_time(seed);
+#endif
+
+    printf("PASS\n");
+    return 0;
+}
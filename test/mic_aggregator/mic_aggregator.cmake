@@ -0,0 +1,23 @@
+
+# Host only test of the mic aggregator 32 mic configuration, against a model of the PDM front end and decimators
+add_executable(test_mic_aggregator
+    ${CMAKE_CURRENT_LIST_DIR}/src/main.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/decimator_model.c
+)
+
+target_include_directories(test_mic_aggregator
+    PRIVATE
+        ${CMAKE_CURRENT_LIST_DIR}/src
+        ${CMAKE_CURRENT_LIST_DIR}/../../examples/mic_aggregator/src
+)
+
+target_compile_definitions(test_mic_aggregator
+    PRIVATE
+        MIC_ARRAY_CONFIG_MIC_COUNT=32
+        MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME=4
+)
+
+target_link_libraries(test_mic_aggregator
+    PRIVATE
+        m
+)
@@ -0,0 +1,176 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <string.h>
+
+#include "decimator_model.h"
+
+// The stage 1 coefficients are 16 bit planes of 256 taps, least significant plane first. Each plane is 8 words with
+// the oldest tap in the MSb of the first word. A set bit is -1 and a clear bit is +1, weighted by the plane.
+static const uint32_t stage1_coef[128] = STAGE_1_48K_COEFFS;
+static const int32_t stage2_coef[MIC_ARRAY_STAGE_2_NUM_TAPS] = STAGE_2_48K_COEFFS;
+
+// Stage 1 output contribution of each byte of the history, for every value of that byte
+static int32_t stage1_lut[DECIMATOR_MODEL_STAGE1_BYTES][256];
+static bool stage1_lut_done = false;
+
+static int32_t stage1_tap(unsigned t)
+{
+    int32_t tap = 0;
+    for(unsigned plane = 0; plane < 16; plane++)
+    {
+        uint32_t bit = (stage1_coef[plane * DECIMATOR_MODEL_STAGE1_WORDS + t / 32] >> (31 - (t % 32))) & 1;
+        tap += (bit ? -1 : 1) * (1 << plane);
+    }
+    return tap;
+}
+
+static void stage1_lut_init(void)
+{
+    if(stage1_lut_done)
+    {
+        return;
+    }
+    for(unsigned pos = 0; pos < DECIMATOR_MODEL_STAGE1_BYTES; pos++)
+    {
+        for(unsigned byte = 0; byte < 256; byte++)
+        {
+            int32_t acc = 0;
+            for(unsigned k = 0; k < 8; k++)
+            {
+                // PDM bit 1 is +1, 0 is -1
+                acc += stage1_tap(pos * 8 + k) * (((byte >> (7 - k)) & 1) ? 1 : -1);
+            }
+            stage1_lut[pos][byte] = acc;
+        }
+    }
+    stage1_lut_done = true;
+}
+
+void decimator_model_init(decimator_model_t *model)
+{
+    stage1_lut_init();
+    memset(model, 0, sizeof(decimator_model_t));
+    // Idle PDM history of alternating bits
+    for(unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++)
+    {
+        for(unsigned w = 0; w < DECIMATOR_MODEL_STAGE1_WORDS; w++)
+        {
+            model->mic[mic].pdm_history[w] = 0x55555555;
+        }
+    }
+    for(unsigned t = 0; t <= MIC_ARRAY_NUM_DECIMATOR_TASKS; t++)
+    {
+        model->first_mic[t] = (t * MIC_ARRAY_CONFIG_MIC_COUNT) / MIC_ARRAY_NUM_DECIMATOR_TASKS;
+    }
+}
+
+void decimator_model_port_capture(uint32_t port[DECIMATOR_MODEL_PORT_SAMPLES], const uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT])
+{
+    for(unsigned clk = 0; clk < DECIMATOR_MODEL_BLOCK_CLOCKS; clk++)
+    {
+        const unsigned shift = DECIMATOR_MODEL_BLOCK_CLOCKS - 1 - clk;
+        uint32_t rising = 0;
+        uint32_t falling = 0;
+        for(unsigned line = 0; line < DECIMATOR_MODEL_NUM_LINES; line++)
+        {
+            rising |= ((pdm[line] >> shift) & 1) << line;
+            falling |= ((pdm[DECIMATOR_MODEL_NUM_LINES + line] >> shift) & 1) << line;
+        }
+        port[2 * clk] = rising;
+        port[2 * clk + 1] = falling;
+    }
+}
+
+void decimator_model_pdm_rx(uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT], const uint32_t port[DECIMATOR_MODEL_PORT_SAMPLES])
+{
+    memset(pdm, 0, MIC_ARRAY_CONFIG_MIC_COUNT * sizeof(uint32_t));
+    for(unsigned clk = 0; clk < DECIMATOR_MODEL_BLOCK_CLOCKS; clk++)
+    {
+        for(unsigned line = 0; line < DECIMATOR_MODEL_NUM_LINES; line++)
+        {
+            pdm[line] = (pdm[line] << 1) | ((port[2 * clk] >> line) & 1);
+            pdm[DECIMATOR_MODEL_NUM_LINES + line] = (pdm[DECIMATOR_MODEL_NUM_LINES + line] << 1) | ((port[2 * clk + 1] >> line) & 1);
+        }
+    }
+}
+
+static int32_t stage1(decimator_model_mic_t *mic, uint32_t pdm)
+{
+    memmove(&mic->pdm_history[0], &mic->pdm_history[1], (DECIMATOR_MODEL_STAGE1_WORDS - 1) * sizeof(uint32_t));
+    mic->pdm_history[DECIMATOR_MODEL_STAGE1_WORDS - 1] = pdm;
+
+    int32_t acc = 0;
+    for(unsigned w = 0; w < DECIMATOR_MODEL_STAGE1_WORDS; w++)
+    {
+        for(unsigned b = 0; b < 4; b++)
+        {
+            acc += stage1_lut[w * 4 + b][(mic->pdm_history[w] >> (24 - 8 * b)) & 0xff];
+        }
+    }
+    return acc;
+}
+
+// Returns true and sets *out when a stage 2 output is due
+static bool stage2(decimator_model_mic_t *mic, int32_t in, int32_t *out)
+{
+    memmove(&mic->stage2_history[1], &mic->stage2_history[0], (MIC_ARRAY_STAGE_2_NUM_TAPS - 1) * sizeof(int32_t));
+    mic->stage2_history[0] = in;
+    if(++mic->stage2_phase < MIC_ARRAY_CONFIG_STG2_DEC_FACTOR)
+    {
+        return false;
+    }
+    mic->stage2_phase = 0;
+
+    int64_t acc = 0;
+    for(unsigned k = 0; k < MIC_ARRAY_STAGE_2_NUM_TAPS; k++)
+    {
+        acc += (int64_t)stage2_coef[k] * mic->stage2_history[k];
+    }
+    *out = (int32_t)(acc >> (30 + MIC_ARRAY_CONFIG_STG2_RIGHT_SHIFT));
+    return true;
+}
+
+bool decimator_model_process(decimator_model_t *model, const uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT], mic_frame_t *frame)
+{
+    bool have_sample = false;
+    for(unsigned task = 0; task < MIC_ARRAY_NUM_DECIMATOR_TASKS; task++)
+    {
+        for(unsigned mic = model->first_mic[task]; mic < model->first_mic[task + 1]; mic++)
+        {
+            int32_t sample;
+            model->task_of_mic[mic] = task;
+            // All the mics are in step, so they all produce a sample on the same block
+            have_sample = stage2(&model->mic[mic], stage1(&model->mic[mic], pdm[mic]), &sample);
+            if(have_sample)
+            {
+                model->frame.data[mic][model->frame_fill] = sample;
+            }
+        }
+    }
+    if(!have_sample)
+    {
+        return false;
+    }
+    if(++model->frame_fill < MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME)
+    {
+        return false;
+    }
+    model->frame_fill = 0;
+    *frame = model->frame;
+    return true;
+}
+
+double decimator_model_dc_gain(void)
+{
+    double stage1_gain = 0;
+    for(unsigned t = 0; t < DECIMATOR_MODEL_STAGE1_WORDS * 32; t++)
+    {
+        stage1_gain += stage1_tap(t);
+    }
+    double stage2_gain = 0;
+    for(unsigned k = 0; k < MIC_ARRAY_STAGE_2_NUM_TAPS; k++)
+    {
+        stage2_gain += stage2_coef[k];
+    }
+    return stage1_gain * stage2_gain / (double)(1ull << (30 + MIC_ARRAY_CONFIG_STG2_RIGHT_SHIFT));
+}
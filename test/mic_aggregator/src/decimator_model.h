@@ -0,0 +1,66 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_config.h"
+#include "app_main.h"   // mic_frame_t
+#include "mic_array_48k_decimator_coeffs.h"
+
+// Host model of the mic aggregator PDM front end, from the samples read from the PDM data port to the frames received
+// by the hub. It follows the structure of the firmware rather than matching lib_mic_array bit for bit:
+//
+// - The mics are DDR connected, two per data line. Mics 0..(L-1) are captured on the rising edge of the PDM clock
+//   and mics L..(2L-1) on the falling edge, on the L = MIC_ARRAY_CONFIG_MIC_COUNT / 2 line data port.
+// - The PDM rx stage deinterleaves a block of 32 PDM clocks into one 32 bit word per mic, oldest bit in the MSb.
+// - The decimation is split across MIC_ARRAY_NUM_DECIMATOR_TASKS tasks, each running a contiguous group of mics.
+//   Each mic has a 256 tap 1 bit stage 1 filter decimating by 32 with the application's STAGE_1_48K_COEFFS, followed
+//   by the stage 2 filter decimating by MIC_ARRAY_CONFIG_STG2_DEC_FACTOR with STAGE_2_48K_COEFFS.
+// - The output samples are assembled into mic_frame_t frames of MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME samples.
+
+#define DECIMATOR_MODEL_NUM_LINES       (MIC_ARRAY_CONFIG_MIC_COUNT / 2)    // PDM data lines, two mics per line
+#define DECIMATOR_MODEL_BLOCK_CLOCKS    (32)                                // PDM clocks per PDM rx block
+#define DECIMATOR_MODEL_PORT_SAMPLES    (2 * DECIMATOR_MODEL_BLOCK_CLOCKS)  // Port samples per block, one per clock edge
+#define DECIMATOR_MODEL_STAGE1_WORDS    (8)                                 // 256 tap stage 1 history
+#define DECIMATOR_MODEL_STAGE1_BYTES    (DECIMATOR_MODEL_STAGE1_WORDS * 4)
+
+typedef struct {
+    uint32_t pdm_history[DECIMATOR_MODEL_STAGE1_WORDS];     // Last 256 PDM bits, oldest word first
+    int32_t stage2_history[MIC_ARRAY_STAGE_2_NUM_TAPS];     // Stage 1 outputs, newest first
+    unsigned stage2_phase;                                  // Stage 1 outputs since the last stage 2 output
+} decimator_model_mic_t;
+
+typedef struct {
+    decimator_model_mic_t mic[MIC_ARRAY_CONFIG_MIC_COUNT];
+    unsigned first_mic[MIC_ARRAY_NUM_DECIMATOR_TASKS + 1];  // Mics first_mic[t]..first_mic[t + 1] - 1 run in task t
+    unsigned task_of_mic[MIC_ARRAY_CONFIG_MIC_COUNT];       // Task that last processed each mic, for checking the split
+    mic_frame_t frame;                                      // Frame being assembled
+    unsigned frame_fill;                                    // Samples per mic in frame so far
+} decimator_model_t;
+
+/// @brief Initialise the model
+/// @param model    Model state
+void decimator_model_init(decimator_model_t *model);
+
+/// @brief Capture a block of PDM data on the data port
+/// @param port     Set to the DECIMATOR_MODEL_PORT_SAMPLES port samples, in capture order
+/// @param pdm      One word of 32 PDM bits per mic, oldest bit in the MSb
+void decimator_model_port_capture(uint32_t port[DECIMATOR_MODEL_PORT_SAMPLES], const uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT]);
+
+/// @brief Deinterleave a block of port samples into PDM words, as the PDM rx stage does
+/// @param pdm      Set to one word of 32 PDM bits per mic, oldest bit in the MSb
+/// @param port     DECIMATOR_MODEL_PORT_SAMPLES port samples, in capture order
+void decimator_model_pdm_rx(uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT], const uint32_t port[DECIMATOR_MODEL_PORT_SAMPLES]);
+
+/// @brief Run the decimators over a block of PDM data
+/// @param model    Model state
+/// @param pdm      One word of 32 PDM bits per mic, oldest bit in the MSb
+/// @param frame    Set to the completed frame, when one completes
+/// @return bool    true if a frame was completed
+bool decimator_model_process(decimator_model_t *model, const uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT], mic_frame_t *frame);
+
+/// @brief Gain of the decimators at DC, from the PDM bits as +-1 to the output samples
+/// @return double  DC gain
+double decimator_model_dc_gain(void);
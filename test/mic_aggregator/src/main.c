@@ -0,0 +1,395 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#define xassert assert
+
+#include "decimator_model.h"
+
+#define PDM_RATE            (MIC_ARRAY_CONFIG_PDM_FREQ)
+#define OUT_RATE            (PDM_RATE / (DECIMATOR_MODEL_BLOCK_CLOCKS * MIC_ARRAY_CONFIG_STG2_DEC_FACTOR))
+#define SETTLE_SAMPLES      (256)       // Output samples skipped while the filters fill
+#define MEASURE_SAMPLES     (4800)      // Output samples measured. The test tones are on bins of this length
+#define TOTAL_SAMPLES       (SETTLE_SAMPLES + MEASURE_SAMPLES)
+
+#define TONE_BASE_HZ        (250)
+#define TONE_STEP_HZ        (150)
+#define PHASE_TONE_HZ       (1000)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef enum {
+    INPUT_TONE_PER_MIC,     // A different frequency and amplitude on each mic
+    INPUT_SAME,             // The same PDM stream on every mic
+    INPUT_DELAYED,          // The same PDM stream on every mic, delayed by the mic number of PDM clocks
+} input_t;
+
+typedef struct {
+    double acc1, acc2, err;
+    int y;
+} sdm_t;
+
+typedef struct {
+    double coef, cos_w, sin_w;
+    double s1, s2;
+} goertzel_t;
+
+/* Second order sigma-delta modulator, returns the PDM bit for x in -1..1 */
+static unsigned sdm_step(sdm_t *sdm, double x)
+{
+    sdm->acc1 += x - sdm->y;
+    sdm->acc2 += sdm->acc1 - sdm->y;
+    sdm->y = (sdm->acc2 >= 0) ? 1 : -1;
+    return sdm->y > 0;
+}
+
+static void goertzel_init(goertzel_t *g, double freq)
+{
+    double w = 2 * M_PI * freq / OUT_RATE;
+    memset(g, 0, sizeof(goertzel_t));
+    g->cos_w = cos(w);
+    g->sin_w = sin(w);
+    g->coef = 2 * g->cos_w;
+}
+
+static void goertzel_step(goertzel_t *g, double x)
+{
+    double s = x + g->coef * g->s1 - g->s2;
+    g->s2 = g->s1;
+    g->s1 = s;
+}
+
+static double goertzel_amplitude(const goertzel_t *g)
+{
+    double re = g->s1 - g->s2 * g->cos_w;
+    double im = g->s2 * g->sin_w;
+    return 2 * sqrt(re * re + im * im) / MEASURE_SAMPLES;
+}
+
+static double goertzel_phase(const goertzel_t *g)
+{
+    return atan2(g->s2 * g->sin_w, g->s1 - g->s2 * g->cos_w);
+}
+
+static double tone_freq(unsigned mic)
+{
+    return TONE_BASE_HZ + TONE_STEP_HZ * mic;
+}
+
+static double tone_amplitude(unsigned mic)
+{
+    return 0.2 + 0.01 * mic;
+}
+
+static goertzel_t own[MIC_ARRAY_CONFIG_MIC_COUNT];
+static goertzel_t neighbour[MIC_ARRAY_CONFIG_MIC_COUNT];
+
+/*
+ * Generates PDM for every mic, and runs it through the port capture, PDM rx and decimator model and then the hub gain
+ * stage and frame snapshot used by the TDM output, with unity gain. Each output sample of every mic is passed to the
+ * Goertzel filters once the filters have settled. For INPUT_SAME, also checks that every mic outputs the same sample.
+ */
+static void run(input_t input, bool verbose)
+{
+    static decimator_model_t model;
+    static mic_frame_t mic_frame;
+    static audio_frame_t audio_frames[NUM_AUDIO_BUFFERS];
+    audio_frame_t *read_buffer = NULL;
+    frame_snapshot_t snapshot;
+    uint16_t gains[MIC_ARRAY_CONFIG_MIC_COUNT];
+    sdm_t sdm[MIC_ARRAY_CONFIG_MIC_COUNT];
+    uint64_t delay_line = 0;
+    unsigned write_buffer_idx = 0;
+    unsigned samples = 0;
+    uint64_t clk = 0;
+
+    decimator_model_init(&model);
+    frame_snapshot_init(&snapshot, &read_buffer);
+    memset(sdm, 0, sizeof(sdm));
+    for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+        gains[mic] = 1;
+        sdm[mic].y = 1;
+        goertzel_init(&own[mic], (input == INPUT_TONE_PER_MIC) ? tone_freq(mic) : PHASE_TONE_HZ);
+        goertzel_init(&neighbour[mic], tone_freq((mic + 1) % MIC_ARRAY_CONFIG_MIC_COUNT));
+    }
+
+    while (samples < TOTAL_SAMPLES) {
+        uint32_t pdm[MIC_ARRAY_CONFIG_MIC_COUNT] = {0};
+        uint32_t port[DECIMATOR_MODEL_PORT_SAMPLES];
+        uint32_t rx_pdm[MIC_ARRAY_CONFIG_MIC_COUNT];
+
+        for (unsigned i = 0; i < DECIMATOR_MODEL_BLOCK_CLOCKS; i++, clk++) {
+            double t = (double)clk / PDM_RATE;
+            if (input == INPUT_TONE_PER_MIC) {
+                for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+                    double x = tone_amplitude(mic) * sin(2 * M_PI * tone_freq(mic) * t);
+                    pdm[mic] = (pdm[mic] << 1) | sdm_step(&sdm[mic], x);
+                }
+            } else {
+                delay_line = (delay_line << 1) | sdm_step(&sdm[0], 0.5 * sin(2 * M_PI * PHASE_TONE_HZ * t));
+                for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+                    unsigned delay = (input == INPUT_DELAYED) ? mic : 0;
+                    pdm[mic] = (pdm[mic] << 1) | ((delay_line >> delay) & 1);
+                }
+            }
+        }
+
+        decimator_model_port_capture(port, pdm);
+        decimator_model_pdm_rx(rx_pdm, port);
+        if (memcmp(rx_pdm, pdm, sizeof(pdm)) != 0) {
+            printf("FAIL, run(): PDM rx does not recover the captured PDM data\n");
+            xassert(0);
+        }
+
+        if (!decimator_model_process(&model, rx_pdm, &mic_frame)) {
+            continue;
+        }
+
+        /* As the hub and the TDM slave */
+        audio_frame_t *frame = &audio_frames[write_buffer_idx];
+        hub_apply_gains(frame, &mic_frame, gains);
+        read_buffer = frame;
+        write_buffer_idx = (write_buffer_idx + 1) % NUM_AUDIO_BUFFERS;
+
+        for (unsigned s = 0; s < MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME; s++, samples++) {
+            const int32_t *out = frame_snapshot_get(&snapshot, samples);
+            xassert(out != NULL);
+            if (samples < SETTLE_SAMPLES || samples >= TOTAL_SAMPLES) {
+                continue;
+            }
+            for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+                if ((input == INPUT_SAME) && (out[mic] != out[0])) {
+                    printf("FAIL, run(): sample %u: mic %u output %ld, mic 0 output %ld\n", samples, mic, (long)out[mic], (long)out[0]);
+                    xassert(0);
+                }
+                goertzel_step(&own[mic], out[mic]);
+                goertzel_step(&neighbour[mic], out[mic]);
+            }
+        }
+    }
+
+    /* Every mic is decimated by exactly one task, and each task has some mics */
+    for (unsigned task = 0; task < MIC_ARRAY_NUM_DECIMATOR_TASKS; task++) {
+        xassert(model.first_mic[task + 1] > model.first_mic[task]);
+        for (unsigned mic = model.first_mic[task]; mic < model.first_mic[task + 1]; mic++) {
+            xassert(model.task_of_mic[mic] == task);
+        }
+    }
+    xassert(model.first_mic[MIC_ARRAY_NUM_DECIMATOR_TASKS] == MIC_ARRAY_CONFIG_MIC_COUNT);
+    (void)verbose;
+}
+
+/*
+ * Puts a different tone on each mic and checks that each mic's output has its own tone at the right level, and not its
+ * neighbour's, so no mic is swapped with, or leaks into, another.
+ */
+void test_tone_per_mic(bool verbose)
+{
+    const double dc_gain = decimator_model_dc_gain();
+
+    run(INPUT_TONE_PER_MIC, verbose);
+
+    for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+        double amplitude = goertzel_amplitude(&own[mic]);
+        double error_db = 20 * log10(amplitude / (tone_amplitude(mic) * dc_gain));
+        double leak_db = 20 * log10(goertzel_amplitude(&neighbour[mic]) / amplitude);
+        if (verbose) {
+            printf("mic %2u: %6.0f Hz, level error %6.3f dB, neighbour tone %7.1f dB\n", mic, tone_freq(mic), error_db, leak_db);
+        }
+        if (fabs(error_db) > 0.5 || leak_db > -60) {
+            printf("FAIL, test_tone_per_mic(): mic %u: level error %.3f dB, neighbour tone %.1f dB\n", mic, error_db, leak_db);
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("tone per mic passes\n");
+    }
+}
+
+/*
+ * Puts the same PDM stream on every mic, on both clock edges of every data line, and checks that every mic outputs
+ * the same samples.
+ */
+void test_same_input(bool verbose)
+{
+    run(INPUT_SAME, verbose);
+    if (verbose) {
+        printf("same input passes\n");
+    }
+}
+
+/*
+ * Delays the PDM stream on each mic by the mic number of PDM clocks and checks that the phase of each mic's output
+ * relative to mic 0 matches the delay, so the mics stay aligned to within a fraction of a PDM clock.
+ */
+void test_phase_alignment(bool verbose)
+{
+    const double deg_per_clk = 360.0 * PHASE_TONE_HZ / PDM_RATE;
+    const double tolerance_deg = 0.1 * deg_per_clk;
+
+    run(INPUT_DELAYED, verbose);
+
+    double phase0 = goertzel_phase(&own[0]);
+    for (unsigned mic = 0; mic < MIC_ARRAY_CONFIG_MIC_COUNT; mic++) {
+        double lag_deg = (phase0 - goertzel_phase(&own[mic])) * 180 / M_PI;
+        double error_deg = lag_deg - mic * deg_per_clk;
+        if (verbose) {
+            printf("mic %2u: lag %7.4f deg, error %8.5f deg\n", mic, lag_deg, error_deg);
+        }
+        if (fabs(error_deg) > tolerance_deg) {
+            printf("FAIL, test_phase_alignment(): mic %u: lag %.4f deg, expected %.4f deg\n", mic, lag_deg, mic * deg_per_clk);
+            xassert(0);
+        }
+    }
+    if (verbose) {
+        printf("phase alignment passes\n");
+    }
+}
+
+#define ALIGN_FRAMES        (64)    // Frames published by the hub in each alignment run
+#define ALIGN_SAMPLES       (ALIGN_FRAMES * MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME)
+
+typedef enum {
+    PUBLISH_BEFORE,         // The hub publishes a frame before any line takes the first sample of the frame
+    PUBLISH_AFTER_FIRST,    // After the first line has taken it
+    PUBLISH_AFTER,          // After all the lines have taken it
+} publish_order_t;
+
+/* Value the hub puts in channel ch of sample s of frame number frame_num. The sample number is in the upper bits */
+static int32_t align_value(unsigned frame_num, unsigned s, unsigned ch)
+{
+    return (int32_t)(((frame_num * MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME + s) << 8) | ch);
+}
+
+/* The TDM data lines sharing a frame snapshot, and the sample numbers each has sent */
+typedef struct {
+    frame_snapshot_t snapshot;
+    unsigned sample_num[TDM_SLAVE_NUM_DATA_LINES];
+    int64_t sent[TDM_SLAVE_NUM_DATA_LINES][ALIGN_SAMPLES + 1];  // Sample number sent, or -1 for silence
+} align_lines_t;
+
+/* As i2s_send(), checking that the line's channels are all of one sample */
+static void align_send(align_lines_t *lines, unsigned line)
+{
+    const int32_t *samples = frame_snapshot_get(&lines->snapshot, lines->sample_num[line]);
+    int64_t num = -1;
+    if (samples != NULL) {
+        num = samples[16 * line] >> 8;
+        for (unsigned ch = 16 * line; ch < 16 * (line + 1); ch++) {
+            if (((samples[ch] & 0xff) != (int32_t)ch) || ((samples[ch] >> 8) != num)) {
+                printf("FAIL, align_send(): line %u sends channel %ld of sample %ld as channel %u of sample %lld\n",
+                       line, (long)(samples[ch] & 0xff), (long)(samples[ch] >> 8), ch, (long long)num);
+                xassert(0);
+            }
+        }
+    }
+    lines->sent[line][lines->sample_num[line]++] = num;
+}
+
+/*
+ * Runs the hub publishing frames against the TDM data lines sharing a frame snapshot, taking turns in the given order.
+ * first is the line that gets to each sample first, and if lead is set, it is a whole sample ahead of the others.
+ * Checks that for every sample, every line sends its channels of the same sample of the same frame, and that once the
+ * first frame is in, the lines send every sample of every frame in turn.
+ */
+static void run_line_alignment(publish_order_t order, unsigned first, bool lead, bool verbose)
+{
+    static audio_frame_t audio_frames[NUM_AUDIO_BUFFERS];
+    static align_lines_t lines;
+    audio_frame_t *read_buffer = NULL;
+    unsigned write_buffer_idx = 0;
+    unsigned frame_num = 0;
+    unsigned publish_step = (order == PUBLISH_BEFORE) ? 0 : (order == PUBLISH_AFTER_FIRST) ? 1 : TDM_SLAVE_NUM_DATA_LINES;
+
+    memset(&lines, 0, sizeof(lines));
+    frame_snapshot_init(&lines.snapshot, &read_buffer);
+    if (lead) {
+        align_send(&lines, first);
+    }
+
+    for (unsigned n = 0; n < ALIGN_SAMPLES; n++) {
+        bool publish = (n % MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME) == 0;
+        for (unsigned step = 0; step <= TDM_SLAVE_NUM_DATA_LINES; step++) {
+            if (publish && (step == publish_step)) {
+                audio_frame_t *frame = &audio_frames[write_buffer_idx];
+                for (unsigned s = 0; s < MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME; s++) {
+                    for (unsigned ch = 0; ch < MIC_ARRAY_CONFIG_MIC_COUNT; ch++) {
+                        frame->data[s][ch] = align_value(frame_num, s, ch);
+                    }
+                }
+                read_buffer = frame;
+                write_buffer_idx = (write_buffer_idx + 1) % NUM_AUDIO_BUFFERS;
+                frame_num++;
+            }
+            if (step < TDM_SLAVE_NUM_DATA_LINES) {
+                align_send(&lines, (first + step) % TDM_SLAVE_NUM_DATA_LINES);
+            }
+        }
+    }
+
+    int64_t prev = -1;
+    for (unsigned n = 0; n < ALIGN_SAMPLES; n++) {
+        for (unsigned line = 1; line < TDM_SLAVE_NUM_DATA_LINES; line++) {
+            if (lines.sent[line][n] != lines.sent[0][n]) {
+                printf("FAIL, run_line_alignment(): sample %u: line 0 sends sample %lld, line %u sends sample %lld\n",
+                       n, (long long)lines.sent[0][n], line, (long long)lines.sent[line][n]);
+                xassert(0);
+            }
+        }
+        if ((prev >= 0) && (lines.sent[0][n] != prev + 1)) {
+            printf("FAIL, run_line_alignment(): sample %u: sample %lld follows sample %lld\n", n, (long long)lines.sent[0][n], (long long)prev);
+            xassert(0);
+        }
+        prev = (lines.sent[0][n] >= 0) ? lines.sent[0][n] : prev;
+    }
+    if (prev < 0) {
+        printf("FAIL, run_line_alignment(): no frame was sent\n");
+        xassert(0);
+    }
+    if (verbose) {
+        printf("publish order %d, line %u first%s: aligned up to sample %lld\n", (int)order, first, lead ? " and a sample ahead" : "", (long long)prev);
+    }
+}
+
+/*
+ * Checks that the TDM16 data lines send the same sample of the same frame, whichever line gets to each sample first,
+ * with any line a sample ahead of the others, and wherever the hub publishes a frame relative to the lines.
+ */
+void test_tdm_line_alignment(bool verbose)
+{
+    for (unsigned order = PUBLISH_BEFORE; order <= PUBLISH_AFTER; order++) {
+        for (unsigned first = 0; first < TDM_SLAVE_NUM_DATA_LINES; first++) {
+            run_line_alignment((publish_order_t)order, first, false, verbose);
+            run_line_alignment((publish_order_t)order, first, true, verbose);
+        }
+    }
+    if (verbose) {
+        printf("TDM line alignment passes\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+
+    printf("%u mics, %u decimator tasks, %u samples per frame\n",
+           MIC_ARRAY_CONFIG_MIC_COUNT, MIC_ARRAY_NUM_DECIMATOR_TASKS, MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME);
+
+    test_tone_per_mic(verbose);
+
+    test_same_input(verbose);
+
+    test_phase_alignment(verbose);
+
+    test_tdm_line_alignment(verbose);
+
+    printf("PASS\n");
+    return 0;
+}
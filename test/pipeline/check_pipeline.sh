@@ -54,6 +54,7 @@ done < ${INPUT_LIST}
 
 # discern repository root
 SLN_VOICE_ROOT=`git rev-parse --show-toplevel`
+COMMIT=`git rev-parse HEAD`
 
 DIST_HOST="${SLN_VOICE_ROOT}/dist_host"
 
@@ -68,6 +69,8 @@ mkdir -p ${OUTPUT_DIR}
 # fresh logs
 RESULTS="${OUTPUT_DIR}/results.csv"
 rm -rf ${RESULTS}
+METRICS="${OUTPUT_DIR}/metrics.json"
+rm -f ${METRICS}
 
 # fresh list.txt for amazon_ww_filesim
 rm -f "${OUTPUT_DIR}/list.txt"
@@ -75,6 +78,7 @@ echo "${AMAZON_WAV}" >> "${OUTPUT_DIR}/list.txt"
 
 echo "***********************************"
 echo "Log file: ${RESULTS}"
+echo "Metrics file: ${METRICS}"
 echo "***********************************"
 
 # Writes the XS3 TestMode register in the JTAG domain to reboot the device into JTAG-boot mode. 
@@ -111,8 +115,10 @@ for ((j = 0; j < ${#INPUT_ARRAY[@]}; j += 1)); do
     OUTPUT_LOG="${OUTPUT_DIR}/${FILE_NAME}.log"
     INPUT_WAV="${INPUT_DIR}/${FILE_NAME}.wav"
     OUTPUT_WAV="${OUTPUT_DIR}/processed_${FILE_NAME}.wav"
+    OUTPUT_METRICS="${OUTPUT_DIR}/metrics_${FILE_NAME}.bin"
     XSCOPE_FILEIO_INPUT_WAV="${OUTPUT_DIR}/input.wav"
     XSCOPE_FILEIO_OUTPUT_WAV="${OUTPUT_DIR}/output.wav"
+    XSCOPE_FILEIO_METRICS="${OUTPUT_DIR}/metrics.bin"
 
     # ensure input file exists
     if [ ! -f "${INPUT_WAV}" ]; then
@@ -139,8 +145,12 @@ for ((j = 0; j < ${#INPUT_ARRAY[@]}; j += 1)); do
     # wait for xrun to exit
     sleep 1
 
-    # the firmware saves output.wav, rename to the desired output name
+    # the firmware saves output.wav and metrics.bin, rename to the desired output names
     cp ${XSCOPE_FILEIO_OUTPUT_WAV} ${OUTPUT_WAV}
+    cp ${XSCOPE_FILEIO_METRICS} ${OUTPUT_METRICS}
+
+    # compute ERLE, latency and MIPS
+    python3 ${SLN_VOICE_ROOT}/test/pipeline/pipeline_metrics.py --input ${XSCOPE_FILEIO_INPUT_WAV} --output ${OUTPUT_WAV} --metrics ${OUTPUT_METRICS} --name ${FILE_NAME} --results ${METRICS} --commit ${COMMIT}
 
     # check wakeword detections
     # amazon_ww_filesim wants a 16bit, single channel input file
@@ -163,6 +173,7 @@ for ((j = 0; j < ${#INPUT_ARRAY[@]}; j += 1)); do
     rm "${OUTPUT_DIR}/${AMAZON_WAV}"
     rm ${XSCOPE_FILEIO_INPUT_WAV}
     rm ${XSCOPE_FILEIO_OUTPUT_WAV}
+    rm ${XSCOPE_FILEIO_METRICS}
 
 done 
 
@@ -2,10 +2,27 @@
 # This Software is subject to the terms of the XMOS Public Licence: Version 1.
 # XMOS Public License: Version 1
 
+import pytest
+
 def pytest_addoption(parser):
     parser.addoption("--log", action="store", default="log")
+    parser.addoption("--metrics", action="store", default=None, help="JSON metrics results of the run")
+    parser.addoption("--baseline", action="store", default=None, help="JSON baseline to compare the metrics with")
+    parser.addoption("--update-baseline", action="store_true", help="replace the baseline's results with the metrics")
 
 def pytest_generate_tests(metafunc):
     option_value = metafunc.config.option.log
     if 'log' in metafunc.fixturenames and option_value is not None:
-        metafunc.parametrize("log", [option_value])
\ No newline at end of file
+        metafunc.parametrize("log", [option_value])
+
+@pytest.fixture
+def metrics(request):
+    return request.config.getoption("--metrics")
+
+@pytest.fixture
+def baseline(request):
+    return request.config.getoption("--baseline")
+
+@pytest.fixture
+def update_baseline(request):
+    return request.config.getoption("--update-baseline")
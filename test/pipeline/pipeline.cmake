@@ -25,6 +25,7 @@ if(${TEST_PIPELINE} STREQUAL "FFVA_ALT_ARCH")
     set(AUDIO_PIPELINE_INPUT_TILE_NO 1)
     set(AUDIO_PIPELINE_OUTPUT_TILE_NO 0)
     set(AUDIO_PIPELINE_SUPPORTS_TRACE 0)
+    set(AUDIO_PIPELINE_SUPPORTS_TELEMETRY 1)
     set(TEST_PIPELINE_NAME test_pipeline_ffva_adec_altarch)
 elseif(${TEST_PIPELINE} STREQUAL "FFD")
     message(STATUS "Building FFD pipeline test")
@@ -38,6 +39,7 @@ elseif(${TEST_PIPELINE} STREQUAL "FFD")
     set(AUDIO_PIPELINE_INPUT_TILE_NO 1)
     set(AUDIO_PIPELINE_OUTPUT_TILE_NO 1)
     set(AUDIO_PIPELINE_SUPPORTS_TRACE 1)
+    set(AUDIO_PIPELINE_SUPPORTS_TELEMETRY 0)
     set(TEST_PIPELINE_NAME test_pipeline_ffd)
 else()
     message(FATAL_ERROR "Unable to build ${TEST_PIPELINE} pipeline test")
@@ -67,6 +69,7 @@ set(APP_COMPILE_DEFINITIONS
     appconfAUDIO_PIPELINE_INPUT_TILE_NO=${AUDIO_PIPELINE_INPUT_TILE_NO}
     appconfAUDIO_PIPELINE_OUTPUT_TILE_NO=${AUDIO_PIPELINE_OUTPUT_TILE_NO}
     appconfAUDIO_PIPELINE_SUPPORTS_TRACE=${AUDIO_PIPELINE_SUPPORTS_TRACE}
+    appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY=${AUDIO_PIPELINE_SUPPORTS_TELEMETRY}
 )
 
 set(APP_LINK_OPTIONS
@@ -78,6 +81,7 @@ set(APP_LINK_OPTIONS
 set(APP_COMMON_LINK_LIBRARIES
     rtos::freertos
     xscope_fileio
+    sln_voice::app::audio_format
     sln_voice_test_pipeline_board_support_xk_voice_l71
 )
 
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+"""
+Compute the performance metrics of one recording processed by a pipeline test
+firmware, and add them to the run's results file.
+
+The metrics are:
+    erle_db          Echo return loss enhancement of the AEC, over the segments
+                     in which there is echo but no near-end speech
+    latency_samples  Delay from the input mic to the processed output, found by
+                     cross-correlation
+    mips             Mean and peak MIPS of each pipeline stage, and of the whole
+                     round trip of a frame through the pipeline
+
+ERLE and the stage MIPS need the pipeline's telemetry, so they are only
+computed for firmware built with it, and are otherwise left out.
+"""
+
+import argparse
+import json
+import os
+
+import numpy as np
+import scipy.signal
+import soundfile as sf
+
+REFERENCE_CLOCK_HZ = 100000000
+INSTRUCTIONS_PER_THREAD_CYCLE = 1 / 5  # Each hardware thread issues at most every fifth core clock cycle
+
+STAGES = ("aec", "ic", "ns", "agc")
+
+# One frame's telemetry, as laid out by audio_pipeline_telemetry_frame_t
+TELEMETRY_DTYPE = np.dtype([
+    ("mic_energy", "<f4"),
+    ("ref_energy", "<f4"),
+    ("stage_energy", "<f4", (len(STAGES),)),
+    ("vnr_input", "<f4"),
+    ("vnr_output", "<f4"),
+    ("agc_gain", "<f4"),
+    ("mic_delay_samples", "<i4"),
+    ("stage_ticks", "<u4", (len(STAGES),)),
+])
+
+REF_ACTIVE_ENERGY = 1e-6    # AUDIO_PIPELINE_TELEMETRY_REF_ACTIVE_ENERGY
+NEAR_END_VNR = 0.5          # VNR of the AEC output above which there may be near-end speech
+MIN_SEGMENT_FRAMES = 20     # Shortest echo-only segment measured, 300 ms at 16 kHz
+MAX_LATENCY_S = 0.5         # Longest latency searched for
+
+
+def read_metrics(path):
+    """Read the metrics file, and return its header and per-frame records"""
+    header = np.fromfile(path, dtype="<u4", count=3)
+    frame_advance, sample_rate, telemetry_words = (int(x) for x in header)
+    fields = [("round_trip_ticks", "<u4")]
+    if telemetry_words:
+        if telemetry_words * 4 != TELEMETRY_DTYPE.itemsize:
+            raise ValueError(f"{path} has {telemetry_words} telemetry words, expected {TELEMETRY_DTYPE.itemsize // 4}")
+        fields.append(("telemetry", TELEMETRY_DTYPE))
+    records = np.fromfile(path, dtype=np.dtype(fields), offset=header.nbytes)
+    return frame_advance, sample_rate, records
+
+
+def segments(mask, min_length):
+    """Return the mask with only its runs of at least min_length frames set"""
+    kept = np.zeros_like(mask)
+    edges = np.flatnonzero(np.diff(np.concatenate(([0], mask.astype(np.int8), [0]))))
+    for start, end in zip(edges[::2], edges[1::2]):
+        if end - start >= min_length:
+            kept[start:end] = True
+    return kept
+
+
+def echo_only_erle_db(telemetry):
+    """ERLE over the echo-only segments, or None if there are none"""
+    echo_only = (telemetry["ref_energy"] > REF_ACTIVE_ENERGY) & (telemetry["vnr_input"] < NEAR_END_VNR)
+    echo_only = segments(echo_only, MIN_SEGMENT_FRAMES)
+    if not echo_only.any():
+        return None
+    mic_energy = np.sum(telemetry["mic_energy"][echo_only], dtype=np.float64)
+    aec_energy = np.sum(telemetry["stage_energy"][echo_only, STAGES.index("aec")], dtype=np.float64)
+    return float(10 * np.log10((mic_energy + 1e-12) / (aec_energy + 1e-12)))
+
+
+def latency_samples(mic, output, sample_rate):
+    """Delay of the output relative to the mic, at the peak of their cross-correlation"""
+    correlation = scipy.signal.correlate(output, mic, mode="full", method="fft")
+    lags = scipy.signal.correlation_lags(len(output), len(mic), mode="full")
+    searched = (lags >= 0) & (lags <= MAX_LATENCY_S * sample_rate)
+    return int(lags[searched][np.argmax(np.abs(correlation[searched]))])
+
+
+def mips(ticks, frame_ticks, thread_mips):
+    """Mean and peak MIPS of a thread that is busy for the given ticks of each frame"""
+    load = ticks.astype(np.float64) / frame_ticks
+    return {"mean": float(np.mean(load) * thread_mips), "peak": float(np.max(load) * thread_mips)}
+
+
+def compute(input_wav, output_wav, metrics_path, core_clock_mhz):
+    frame_advance, sample_rate, records = read_metrics(metrics_path)
+    frame_ticks = frame_advance * REFERENCE_CLOCK_HZ / sample_rate
+    thread_mips = core_clock_mhz * INSTRUCTIONS_PER_THREAD_CYCLE
+
+    # The mics follow the reference channels, if there are any, in the input
+    input_audio, _ = sf.read(input_wav, dtype="float64", always_2d=True)
+    output_audio, _ = sf.read(output_wav, dtype="float64", always_2d=True)
+    mic = input_audio[:, input_audio.shape[1] - 2]
+
+    results = {
+        "frames": len(records),
+        "latency_samples": latency_samples(mic, output_audio[:, 0], sample_rate),
+        "mips": {"round_trip": mips(records["round_trip_ticks"], frame_ticks, thread_mips)},
+    }
+    if "telemetry" in records.dtype.names:
+        telemetry = records["telemetry"]
+        results["erle_db"] = echo_only_erle_db(telemetry)
+        for i, stage in enumerate(STAGES):
+            results["mips"][stage] = mips(telemetry["stage_ticks"][:, i], frame_ticks, thread_mips)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compute the metrics of a pipeline test recording")
+    parser.add_argument("--input", required=True, help="input wav file, as played to the firmware")
+    parser.add_argument("--output", required=True, help="processed output wav file")
+    parser.add_argument("--metrics", required=True, help="metrics file saved by the firmware")
+    parser.add_argument("--name", required=True, help="name of the recording")
+    parser.add_argument("--results", required=True, help="JSON results file of the run, to add the metrics to")
+    parser.add_argument("--commit", default=None, help="commit the firmware was built from")
+    parser.add_argument("--core-clock-mhz", type=float, default=600, help="xcore core clock frequency")
+    args = parser.parse_args()
+
+    results = {"commit": args.commit, "results": {}}
+    if os.path.exists(args.results):
+        with open(args.results, "r") as f:
+            results = json.load(f)
+
+    metrics = compute(args.input, args.output, args.metrics, args.core_clock_mhz)
+    results["results"][args.name] = metrics
+
+    with open(args.results, "w") as f:
+        json.dump(results, f, indent=4, sort_keys=True)
+        f.write("\n")
+
+    print(f"{args.name}: {json.dumps(metrics, sort_keys=True)}")
+
+
+if __name__ == "__main__":
+    main()
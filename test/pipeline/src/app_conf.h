@@ -34,6 +34,10 @@
 #define appconfAUDIO_PIPELINE_SUPPORTS_TRACE    0
 #endif
 
+#ifndef appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY
+#define appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY    0
+#endif
+
 #ifdef appconfPIPELINE_BYPASS
 #define appconfAUDIO_PIPELINE_SKIP_STATIC_DELAY  1
 #define appconfAUDIO_PIPELINE_SKIP_AEC           1
@@ -75,6 +79,7 @@
 #define appconfOUTPUT_CHANNELS                  2
 #define appconfOUTPUT_BRICK_SIZE_BYTES          (appconfAUDIO_PIPELINE_FRAME_ADVANCE * appconfOUTPUT_CHANNELS * appconfSAMPLE_SIZE_BYTES)
 #define appconfOUTPUT_TRACE_SIZE_BYTES          (2048)
+#define appconfMETRICS_FILENAME                 "metrics.bin"
 
 /* Task Priorities */
 #define appconfSTARTUP_TASK_PRIORITY            (configMAX_PRIORITIES / 2)
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include <xcore/assert.h>
+#include <xcore/hwtimer.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -19,11 +20,36 @@
 #include "xscope_fileio_task.h"
 #include "xscope_io_device.h"
 #include "wav_utils.h"
+#include "audio_format.h"
+#if appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY
+#include "audio_pipeline_telemetry.h"
+#endif
 
 #ifndef DWORD_ALIGNED
 #define DWORD_ALIGNED     __attribute__ ((aligned(8)))
 #endif
 
+#if appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY
+#if (appconfAUDIO_PIPELINE_OUTPUT_TILE_NO != XSCOPE_HOST_IO_TILE)
+#error The pipeline telemetry is only readable on the pipeline output tile
+#endif
+#endif
+
+/*
+ * The metrics file starts with the frame advance, the sample rate and the
+ * number of telemetry words in each record. Each frame's record is then its
+ * round trip ticks, from sending the frame to the pipeline to receiving its
+ * output, followed by the pipeline's telemetry of the frame. Only one frame is
+ * in the pipeline at a time, so the round trip is the pipeline's processing
+ * time of the frame, including the transfers between tiles.
+ */
+typedef struct {
+    uint32_t round_trip_ticks;
+#if appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY
+    audio_pipeline_telemetry_frame_t telemetry;
+#endif
+} frame_metrics_t;
+
 static TaskHandle_t xscope_fileio_task_handle;
 QueueHandle_t tx_audio_to_host_queue;
 QueueHandle_t rx_audio_from_host_queue;
@@ -32,6 +58,7 @@ QueueHandle_t tx_trace_from_app_queue;
 static xscope_file_t audio_infile;
 static xscope_file_t audio_outfile;
 static xscope_file_t trace_outfile;
+static xscope_file_t metrics_outfile;
 
 #if ON_TILE(XSCOPE_HOST_IO_TILE)
 static SemaphoreHandle_t mutex_xscope_fileio;
@@ -78,6 +105,8 @@ void xscope_fileio_task(void *arg) {
     uint32_t DWORD_ALIGNED in_buf_int[appconfAUDIO_PIPELINE_INPUT_CHANNELS * appconfAUDIO_PIPELINE_FRAME_ADVANCE];
     uint32_t DWORD_ALIGNED out_buf_raw[appconfOUTPUT_CHANNELS * appconfAUDIO_PIPELINE_FRAME_ADVANCE];
     uint32_t DWORD_ALIGNED out_buf_int[appconfAUDIO_PIPELINE_FRAME_ADVANCE * appconfOUTPUT_CHANNELS];
+    uint32_t metrics_header[3];
+    frame_metrics_t metrics;
 
     size_t bytes_read = 0;
 
@@ -91,6 +120,7 @@ void xscope_fileio_task(void *arg) {
         audio_infile = xscope_open_file(appconfINPUT_FILENAME, "rb");
         audio_outfile = xscope_open_file(appconfOUTPUT_FILENAME, "wb");
         trace_outfile = xscope_open_file(appconfTRACE_FILENAME, "wt");
+        metrics_outfile = xscope_open_file(appconfMETRICS_FILENAME, "wb");
         // Validate input wav file
         if(get_wav_header_details(&audio_infile, &input_header_struct, &input_header_size) != 0){
             rtos_printf("Error: error in get_wav_header_details()\n");
@@ -127,6 +157,11 @@ void xscope_fileio_task(void *arg) {
 
     xscope_fwrite(&audio_outfile, (uint8_t*)(&output_header_struct), WAV_HEADER_BYTES);
 
+    metrics_header[0] = appconfAUDIO_PIPELINE_FRAME_ADVANCE;
+    metrics_header[1] = input_header_struct.sample_rate;
+    metrics_header[2] = (sizeof(metrics) - sizeof(metrics.round_trip_ticks)) / sizeof(uint32_t);
+    xscope_fwrite(&metrics_outfile, (uint8_t *) &metrics_header[0], sizeof(metrics_header));
+
     // ensure the write above has time to complete before performing any reads
     vTaskDelay(pdMS_TO_TICKS(1000));
 
@@ -151,14 +186,12 @@ void xscope_fileio_task(void *arg) {
 
         // De-interleave input
         //  wav files are in frame-major order, pipeline expects sample-major order
-        for(unsigned f=0; f<appconfAUDIO_PIPELINE_FRAME_ADVANCE; f++){
-            for(unsigned ch=0; ch<appconfAUDIO_PIPELINE_INPUT_CHANNELS; ch++) {
-                in_buf_int[ch * appconfAUDIO_PIPELINE_FRAME_ADVANCE + f] = in_buf_raw[f * appconfAUDIO_PIPELINE_INPUT_CHANNELS + ch];
-            }
-        }
+        audio_format_deinterleave((int32_t *)in_buf_int, appconfAUDIO_PIPELINE_FRAME_ADVANCE,
+                                  (const int32_t *)in_buf_raw, appconfAUDIO_PIPELINE_INPUT_CHANNELS, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
 
         // Send audio to pipeline
         size_t bytes_sent = 0;
+        uint32_t send_time = get_reference_time();
         bytes_sent = tx_to_audio_pipeline((uint8_t *)&in_buf_int[0], appconfINPUT_BRICK_SIZE_BYTES);
         xassert(bytes_sent == appconfINPUT_BRICK_SIZE_BYTES);
 
@@ -166,18 +199,24 @@ void xscope_fileio_task(void *arg) {
         size_t bytes_received = 0;
         bytes_received = rx_from_audio_pipeline((uint8_t **)&out_buf_raw[0], appconfOUTPUT_BRICK_SIZE_BYTES);
         xassert(bytes_received == appconfOUTPUT_BRICK_SIZE_BYTES);
+        metrics.round_trip_ticks = get_reference_time() - send_time;
+
+#if appconfAUDIO_PIPELINE_SUPPORTS_TELEMETRY
+        // The pipeline output updated the telemetry before it sent the frame
+        audio_pipeline_telemetry_read_frame(&metrics.telemetry);
+#endif
 
         // Interleaved output
         //  pipeline outputs sample-major order, wav files are in frame-major order
-        for (unsigned ch=0; ch<appconfOUTPUT_CHANNELS; ch++){
-            for(unsigned f=0; f<appconfAUDIO_PIPELINE_FRAME_ADVANCE; f++) {
-                out_buf_int[f * appconfOUTPUT_CHANNELS + ch] = out_buf_raw[ch * appconfAUDIO_PIPELINE_FRAME_ADVANCE + f];
-            }
-        }
+        audio_format_interleave((int32_t *)out_buf_int, (const int32_t *)out_buf_raw, appconfAUDIO_PIPELINE_FRAME_ADVANCE,
+                                appconfOUTPUT_CHANNELS, appconfAUDIO_PIPELINE_FRAME_ADVANCE);
 
         // Write brick to output wav file
         xscope_fwrite(&audio_outfile, (uint8_t *) &out_buf_int[0], appconfOUTPUT_BRICK_SIZE_BYTES);
 
+        // Write the frame's metrics
+        xscope_fwrite(&metrics_outfile, (uint8_t *) &metrics, sizeof(metrics));
+
 #if appconfAUDIO_PIPELINE_SUPPORTS_TRACE
         uint8_t trace_buf[appconfOUTPUT_TRACE_SIZE_BYTES];
 
@@ -2,6 +2,10 @@
 # This Software is subject to the terms of the XMOS Public Licence: Version 1.
 # XMOS Public License: Version 1
 
+import json
+
+import pytest
+
 def test_results(log):
     errors = []
     with open(log, 'r+') as f:
@@ -24,4 +28,58 @@ def test_results(log):
             if not detections <= max_detect:
                 errors.append(filename + " failed with " + str(detections) + " detections.")
 
-    assert not errors, "Test failed:\n{}".format("\n".join(errors))
\ No newline at end of file
+    assert not errors, "Test failed:\n{}".format("\n".join(errors))
+
+def compare_metrics(name, result, base, tolerances):
+    """Return the regressions of a recording's metrics from its baseline"""
+    errors = []
+    # ERLE may only fall by the tolerance, and the latency may only move by it
+    if base.get("erle_db") is not None:
+        if result.get("erle_db") is None:
+            errors.append(f"{name} has no echo-only segments, the baseline ERLE is {base['erle_db']:.2f} dB.")
+        elif result["erle_db"] < base["erle_db"] - tolerances["erle_db"]:
+            errors.append(f"{name} ERLE fell to {result['erle_db']:.2f} dB from {base['erle_db']:.2f} dB.")
+    if abs(result["latency_samples"] - base["latency_samples"]) > tolerances["latency_samples"]:
+        errors.append(f"{name} latency moved to {result['latency_samples']} samples "
+                      f"from {base['latency_samples']} samples.")
+    # Each stage's MIPS may only rise by the tolerance, as a fraction of the baseline
+    for stage, base_mips in base["mips"].items():
+        for statistic in ("mean", "peak"):
+            limit = base_mips[statistic] * (1 + tolerances[f"mips_{statistic}"])
+            value = result["mips"].get(stage, {}).get(statistic)
+            if value is None or value > limit:
+                errors.append(f"{name} {stage} {statistic} MIPS rose to {value} from {base_mips[statistic]:.2f}.")
+    return errors
+
+def test_metrics(metrics, baseline, update_baseline):
+    if metrics is None or baseline is None:
+        pytest.skip("the --metrics and --baseline options are needed to compare metrics")
+
+    with open(metrics, 'r') as f:
+        run = json.load(f)
+    with open(baseline, 'r') as f:
+        base = json.load(f)
+
+    if update_baseline:
+        base["commit"] = run["commit"]
+        base["results"] = run["results"]
+        with open(baseline, 'w') as f:
+            json.dump(base, f, indent=4, sort_keys=True)
+            f.write("\n")
+        return
+
+    # An empty baseline would let every regression through, so it fails until its results are recorded
+    if not base["results"]:
+        pytest.fail(f"{baseline} has no results, record them from a run on hardware with --update-baseline")
+
+    errors = []
+    for name, base_result in base["results"].items():
+        if name not in run["results"]:
+            errors.append(f"{name} has no metrics.")
+            continue
+        errors += compare_metrics(name, run["results"][name], base_result, base["tolerances"])
+    for name in run["results"]:
+        if name not in base["results"]:
+            errors.append(f"{name} has no baseline, record it with --update-baseline.")
+
+    assert not errors, "Metrics regressed from commit {}:\n{}".format(base["commit"], "\n".join(errors))
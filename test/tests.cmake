@@ -1,7 +1,16 @@
 include(${CMAKE_CURRENT_LIST_DIR}/asrc_unit_tests/asrc_unit_tests.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/i2s_rate_conversion/i2s_rate_conversion.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/i2s_tdm_output/i2s_tdm_output.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/audio_format/audio_format.cmake)
 if(${CMAKE_SYSTEM_NAME} STREQUAL XCORE_XS3A)
     include(${CMAKE_CURRENT_LIST_DIR}/asr/asr.cmake)
     include(${CMAKE_CURRENT_LIST_DIR}/ffd_gpio/gpio.cmake)
     include(${CMAKE_CURRENT_LIST_DIR}/ffd_low_power_audio_buffer/low_power_audio_buffer.cmake)
     include(${CMAKE_CURRENT_LIST_DIR}/pipeline/pipeline.cmake)
+else()
+    include(${CMAKE_CURRENT_LIST_DIR}/mic_aggregator/mic_aggregator.cmake)
+    include(${CMAKE_CURRENT_LIST_DIR}/ffva_dfu/ffva_dfu.cmake)
+    include(${CMAKE_CURRENT_LIST_DIR}/ffva_control/ffva_control.cmake)
+    include(${CMAKE_CURRENT_LIST_DIR}/audio_pipeline_tuning/audio_pipeline_tuning.cmake)
+    include(${CMAKE_CURRENT_LIST_DIR}/audio_pipeline_telemetry/audio_pipeline_telemetry.cmake)
 endif()
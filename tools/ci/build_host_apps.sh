@@ -27,6 +27,8 @@ host_apps=(
     "datapartition_mkimage      modules/rtos/tools/datapartition_mkimage"
     "xscope_host_endpoint       modules/xscope_fileio/xscope_fileio/host"
     "nibble_swap                modules/lib_qspi_fast_read/tools/nibble_swap"
+    "dfu_delta_mkimage          ."
+    "dfu_lz_mkimage             ."
 )
 
 # copy applications to dist